@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+# Copyright (c) 2015-2017 The Lux developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+'''
+Decode a binlog.dat written by luxd -binlog into readable text.
+
+Usage:
+    binlog-reader.py <datadir>/binlog.dat [category ...]
+
+With no categories given, every event is printed. Category names match the
+-debug categories; LogPrintf output has the empty category, selectable as "-".
+
+Record types (all integers little-endian):
+    0x01 define: u16 id, u8 namelen, name        (maps id -> category name)
+    0x02 event:  u16 id, u64 time_us, u16 len, payload
+    0x03 drops:  u64 total                       (cumulative events lost)
+'''
+import struct
+import sys
+import time
+
+MAGIC = b'LUXBLOG\x01'
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
+    wanted = set(sys.argv[2:])
+    categories = {}
+    last_drops = 0
+    with open(sys.argv[1], 'rb') as f:
+        if f.read(8) != MAGIC:
+            sys.stderr.write('not a lux binary log\n')
+            sys.exit(1)
+        while True:
+            rectype = f.read(1)
+            if not rectype:
+                break
+            rectype = ord(rectype)
+            if rectype == 0x01:
+                catid, namelen = struct.unpack('<HB', f.read(3))
+                categories[catid] = f.read(namelen).decode('utf-8', 'replace')
+            elif rectype == 0x02:
+                catid, time_us, msglen = struct.unpack('<HQH', f.read(12))
+                msg = f.read(msglen).decode('utf-8', 'replace')
+                name = categories.get(catid, 'cat%d' % catid)
+                if wanted and (name if name else '-') not in wanted:
+                    continue
+                stamp = time.strftime('%Y-%m-%d %H:%M:%S', time.gmtime(time_us // 1000000))
+                sys.stdout.write('%s.%06d [%s] %s' % (stamp, time_us % 1000000, name, msg))
+                if not msg.endswith('\n'):
+                    sys.stdout.write('\n')
+            elif rectype == 0x03:
+                (drops,) = struct.unpack('<Q', f.read(8))
+                if drops != last_drops:
+                    sys.stderr.write('warning: %d events dropped so far\n' % drops)
+                    last_drops = drops
+            else:
+                sys.stderr.write('corrupt record type 0x%02x, stopping\n' % rectype)
+                break
+
+
+if __name__ == '__main__':
+    main()
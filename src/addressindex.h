@@ -0,0 +1,151 @@
+// Copyright (c) 2015-2017 The Lux developers                      -*- c++ -*-
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+//! Address types stored in the index key; only standard single-address
+//! scripts are indexed.
+enum {
+    ADDRESS_INDEX_TYPE_PUBKEYHASH = 1,
+    ADDRESS_INDEX_TYPE_SCRIPTHASH = 2,
+};
+
+//! Height, tx position and output index serialize big-endian so LevelDB's
+//! lexicographic key order doubles as chronological order within an address.
+template <typename Stream>
+inline void SerializeBE32(Stream& s, uint32_t n)
+{
+    unsigned char buf[4];
+    buf[0] = (n >> 24) & 0xff;
+    buf[1] = (n >> 16) & 0xff;
+    buf[2] = (n >> 8) & 0xff;
+    buf[3] = n & 0xff;
+    s.write((char*)buf, 4);
+}
+
+template <typename Stream>
+inline uint32_t UnserializeBE32(Stream& s)
+{
+    unsigned char buf[4];
+    s.read((char*)buf, 4);
+    return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | (uint32_t)buf[3];
+}
+
+/**
+ * One entry of the -addressindex: every output to and every spend from an
+ * indexed script gets a record, keyed so that a single iterator sweep over
+ * an (type, hash160) prefix returns the address history in block order.
+ * The value stored under the key is the delta in satoshis (negative for
+ * spends).
+ */
+struct CAddressIndexKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int txindex;
+    uint256 txhash;
+    unsigned int index;
+    bool spending;
+
+    CAddressIndexKey()
+    {
+        SetNull();
+    }
+
+    CAddressIndexKey(unsigned char addressType, const uint160& addressHash, int height, unsigned int blockindex, const uint256& txid, unsigned int indexValue, bool isSpending) : type(addressType), hashBytes(addressHash), blockHeight(height), txindex(blockindex), txhash(txid), index(indexValue), spending(isSpending)
+    {
+    }
+
+    void SetNull()
+    {
+        type = 0;
+        hashBytes.SetNull();
+        blockHeight = 0;
+        txindex = 0;
+        txhash.SetNull();
+        index = 0;
+        spending = false;
+    }
+
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + 20 + 4 + 4 + 32 + 4 + 1;
+    }
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, type, nType, nVersion);
+        hashBytes.Serialize(s, nType, nVersion);
+        SerializeBE32(s, (uint32_t)blockHeight);
+        SerializeBE32(s, txindex);
+        txhash.Serialize(s, nType, nVersion);
+        SerializeBE32(s, index);
+        char f = spending;
+        ::Serialize(s, f, nType, nVersion);
+    }
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, type, nType, nVersion);
+        hashBytes.Unserialize(s, nType, nVersion);
+        blockHeight = (int)UnserializeBE32(s);
+        txindex = UnserializeBE32(s);
+        txhash.Unserialize(s, nType, nVersion);
+        index = UnserializeBE32(s);
+        char f;
+        ::Unserialize(s, f, nType, nVersion);
+        spending = f;
+    }
+};
+
+/** Seek key for the start of one address's index entries. */
+struct CAddressIndexIteratorKey {
+    unsigned char type;
+    uint160 hashBytes;
+
+    CAddressIndexIteratorKey(unsigned char addressType, const uint160& addressHash) : type(addressType), hashBytes(addressHash)
+    {
+    }
+
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + 20;
+    }
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, type, nType, nVersion);
+        hashBytes.Serialize(s, nType, nVersion);
+    }
+};
+
+/** Seek key for one address's index entries starting at a given height. */
+struct CAddressIndexIteratorHeightKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight;
+
+    CAddressIndexIteratorHeightKey(unsigned char addressType, const uint160& addressHash, int height) : type(addressType), hashBytes(addressHash), blockHeight(height)
+    {
+    }
+
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + 20 + 4;
+    }
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, type, nType, nVersion);
+        hashBytes.Serialize(s, nType, nVersion);
+        SerializeBE32(s, (uint32_t)blockHeight);
+    }
+};
+
+#endif // BITCOIN_ADDRESSINDEX_H
@@ -5,6 +5,7 @@
 #ifndef BITCOIN_ADDRMAN_H
 #define BITCOIN_ADDRMAN_H
 
+#include "memusage.h"
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
@@ -162,6 +163,9 @@ public:
 //! the maximum number of nodes to return in a getaddr call
 #define ADDRMAN_GETADDR_MAX 2500
 
+//! how long (in seconds) a cached GetAddr() selection may be served before it is rebuilt
+#define ADDRMAN_GETADDR_CACHE_SECONDS 600
+
 /** 
  * Stochastical (IP) address manager 
  */
@@ -198,6 +202,14 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! number of modifications since startup, compared against the count already
+    //! persisted so periodic dumps can be skipped while the table is idle
+    int nChanges;
+
+    //! cached GetAddr() selection and when it was built
+    std::vector<CAddress> vAddrCache;
+    int64_t nAddrCacheTime;
+
 protected:
     //! Find an entry.
     CAddrInfo* Find(const CNetAddr& addr, int* pnId = NULL);
@@ -443,6 +455,9 @@ public:
         nIdCount = 0;
         nTried = 0;
         nNew = 0;
+        nChanges = 0;
+        std::vector<CAddress>().swap(vAddrCache);
+        nAddrCacheTime = 0;
     }
 
     CAddrMan()
@@ -462,6 +477,13 @@ public:
         return vRandom.size();
     }
 
+    //! Approximate dynamic memory usage of the address tables.
+    size_t DynamicMemoryUsage()
+    {
+        LOCK(cs);
+        return memusage::DynamicUsage(mapInfo) + memusage::DynamicUsage(mapAddr) + memusage::DynamicUsage(vRandom);
+    }
+
     //! Consistency check
     void Check()
     {
@@ -485,8 +507,10 @@ public:
             fRet |= Add_(addr, source, nTimePenalty);
             Check();
         }
-        if (fRet)
+        if (fRet) {
+            nChanges++;
             LogPrint("addrman", "Added %s from %s: %i tried, %i new\n", addr.ToStringIPPort(), source.ToString(), nTried, nNew);
+        }
         return fRet;
     }
 
@@ -501,8 +525,10 @@ public:
                 nAdd += Add_(*it, source, nTimePenalty) ? 1 : 0;
             Check();
         }
-        if (nAdd)
+        if (nAdd) {
+            nChanges++;
             LogPrint("addrman", "Added %i addresses from %s: %i tried, %i new\n", nAdd, source.ToString(), nTried, nNew);
+        }
         return nAdd > 0;
     }
 
@@ -512,6 +538,7 @@ public:
             LOCK(cs);
             Check();
             Good_(addr, nTime);
+            nChanges++;
             Check();
     }
 
@@ -521,6 +548,7 @@ public:
             LOCK(cs);
             Check();
             Attempt_(addr, nTime);
+            nChanges++;
             Check();
     }
 
@@ -541,24 +569,40 @@ public:
     }
 
     //! Return a bunch of addresses, selected at random.
+    //! The selection is cached for ADDRMAN_GETADDR_CACHE_SECONDS, so bursts
+    //! of getaddr requests do not repeat the random draw over the whole table.
     std::vector<CAddress> GetAddr()
     {
         Check();
         std::vector<CAddress> vAddr;
         {
             LOCK(cs);
-            GetAddr_(vAddr);
+            int64_t nNow = GetAdjustedTime();
+            if (vAddrCache.empty() || nNow - nAddrCacheTime > ADDRMAN_GETADDR_CACHE_SECONDS) {
+                std::vector<CAddress>().swap(vAddrCache);
+                GetAddr_(vAddrCache);
+                nAddrCacheTime = nNow;
+            }
+            vAddr = vAddrCache;
         }
         Check();
         return vAddr;
     }
 
+    //! Number of modifications so far; lets callers skip persisting an unchanged table.
+    int GetChangeCount()
+    {
+        LOCK(cs);
+        return nChanges;
+    }
+
     //! Mark an entry as currently-connected-to.
     void Connected(const CService& addr, int64_t nTime = GetAdjustedTime())
     {
             LOCK(cs);
             Check();
             Connected_(addr, nTime);
+            nChanges++;
             Check();
     }
 };
@@ -0,0 +1,49 @@
+// Copyright (c) 2016-2017 The Lux developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "sync.h"
+
+#include "checkqueue.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+namespace {
+
+//! A check that does no work, so the benchmark measures pure queue
+//! overhead: batching, hand-off and the master/worker synchronization.
+struct FakeCheck {
+    bool operator()() { return true; }
+    void swap(FakeCheck& check) {}
+};
+
+} // anon namespace
+
+static const unsigned int QUEUE_BATCH_SIZE = 128;
+static const int QUEUE_WORKERS = 3;
+
+static void CCheckQueueThroughput(benchmark::State& state)
+{
+    CCheckQueue<FakeCheck> queue(QUEUE_BATCH_SIZE);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < QUEUE_WORKERS; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<FakeCheck>::Thread, &queue));
+
+    while (state.KeepRunning()) {
+        CCheckQueueControl<FakeCheck> control(&queue);
+        for (int nBatch = 0; nBatch < 8; nBatch++) {
+            std::vector<FakeCheck> vChecks(QUEUE_BATCH_SIZE);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BENCHMARK(CCheckQueueThroughput);
@@ -0,0 +1,41 @@
+// Copyright (c) 2016-2017 The Lux developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "coins.h"
+
+#include <string.h>
+
+static const unsigned int COINS_PER_FLUSH = 1000;
+
+// Time a batch write of freshly modified coins into a parent cache, the
+// pattern ConnectBlock/FlushStateToDisk produce.
+static void CCoinsViewCacheFlush(benchmark::State& state)
+{
+    CCoinsView base;
+    CCoinsViewCache parent(&base);
+    CCoinsViewCache cache(&parent);
+
+    uint64_t nNonce = 0;
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < COINS_PER_FLUSH; i++) {
+            uint256 txid;
+            nNonce++;
+            memcpy(txid.begin(), &nNonce, sizeof(nNonce));
+            CCoinsModifier coins = cache.ModifyCoins(txid);
+            coins->vout.resize(2);
+            coins->vout[0].nValue = 1000;
+            coins->vout[1].nValue = 2000;
+            coins->nHeight = 1;
+        }
+        cache.Flush();
+
+        // Keep the parent from growing without bound; its backing
+        // CCoinsView discards the batch.
+        parent.Flush();
+    }
+}
+
+BENCHMARK(CCoinsViewCacheFlush);
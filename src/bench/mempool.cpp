@@ -0,0 +1,49 @@
+// Copyright (c) 2016-2017 The Lux developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "amount.h"
+#include "policy/policy.h"
+#include "script/script.h"
+#include "txmempool.h"
+
+#include <string.h>
+#include <vector>
+
+static const unsigned int MEMPOOL_BATCH = 1000;
+
+// Time addUnchecked for a batch of independent transactions; this is the
+// per-transaction bookkeeping cost of AcceptToMemoryPool minus validation.
+static void MempoolInsertion(benchmark::State& state)
+{
+    CTxMemPool pool(CFeeRate(1000));
+
+    std::vector<CTransaction> vtx;
+    std::vector<CTxMemPoolEntry> ventry;
+    vtx.reserve(MEMPOOL_BATCH);
+    ventry.reserve(MEMPOOL_BATCH);
+    for (unsigned int i = 0; i < MEMPOOL_BATCH; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        uint64_t nNonce = i + 1;
+        memcpy(mtx.vin[0].prevout.hash.begin(), &nNonce, sizeof(nNonce));
+        mtx.vin[0].prevout.n = 0;
+        mtx.vin[0].scriptSig = CScript() << OP_1;
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = i * CENT;
+        mtx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        vtx.push_back(CTransaction(mtx));
+        ventry.push_back(CTxMemPoolEntry(MakeTransactionRef(vtx.back()), 1000, 0, 0.0, 1,
+                                         0, false, 1, LockPoints(), true));
+    }
+
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < MEMPOOL_BATCH; i++)
+            pool.addUnchecked(vtx[i].GetHash(), ventry[i], false);
+        pool.clear();
+    }
+}
+
+BENCHMARK(MempoolInsertion);
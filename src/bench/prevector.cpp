@@ -0,0 +1,84 @@
+// Copyright (c) 2016-2017 The Lux developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "prevector.h"
+
+// Script-sized prevectors: 36 bytes (the CScriptBase specialization) stays in
+// the direct (inline) buffer, 256 forces the heap-allocated indirect
+// representation.
+
+static void PrevectorDirectPushBack(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        prevector<36, unsigned char> v;
+        for (unsigned int i = 0; i < 36; i++)
+            v.push_back(i);
+    }
+}
+
+static void PrevectorIndirectPushBack(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        prevector<36, unsigned char> v;
+        for (unsigned int i = 0; i < 256; i++)
+            v.push_back(i & 0xff);
+    }
+}
+
+static void PrevectorCopy(benchmark::State& state)
+{
+    prevector<36, unsigned char> v;
+    v.resize(256);
+    while (state.KeepRunning()) {
+        prevector<36, unsigned char> w(v);
+        if (w.size() != v.size())
+            break;
+    }
+}
+
+static void PrevectorResize(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        prevector<36, unsigned char> v;
+        v.resize(36);
+        v.resize(256);
+        v.resize(0);
+    }
+}
+
+// Output script sizes as seen in a mainnet mempool/chainstate sample:
+// P2WPKH (22), P2SH (23), P2PKH (25), P2WSH (34), P2PK (35, every coinstake
+// and coinbase output on this chain), bare multisig (71) and a large
+// contract-call script standing in for the heap-bound tail.
+static const unsigned int SCRIPT_SIZE_SAMPLE[] = {22, 23, 25, 25, 25, 34, 35, 35, 35, 71, 201};
+
+// Construct and copy a realistic mix of script-sized vectors. With a 28-byte
+// inline buffer every 34/35-byte entry allocates; with 36 only the tail does.
+template <unsigned int N>
+static void PrevectorScriptSizeMix(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        size_t total = 0;
+        for (unsigned int size : SCRIPT_SIZE_SAMPLE) {
+            prevector<N, unsigned char> v;
+            v.resize(size);
+            prevector<N, unsigned char> w(v);
+            total += w.size();
+        }
+        if (total == 0)
+            break;
+    }
+}
+
+static void PrevectorScriptSizeMix28(benchmark::State& state) { PrevectorScriptSizeMix<28>(state); }
+static void PrevectorScriptSizeMix36(benchmark::State& state) { PrevectorScriptSizeMix<36>(state); }
+
+BENCHMARK(PrevectorDirectPushBack);
+BENCHMARK(PrevectorIndirectPushBack);
+BENCHMARK(PrevectorCopy);
+BENCHMARK(PrevectorResize);
+BENCHMARK(PrevectorScriptSizeMix28);
+BENCHMARK(PrevectorScriptSizeMix36);
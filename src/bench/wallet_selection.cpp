@@ -0,0 +1,129 @@
+// Copyright (c) 2016-2017 The Lux developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "amount.h"
+#include "utilmoneystr.h"
+#include "wallet.h"
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <boost/foreach.hpp>
+
+// Deterministic LCG so replay runs are comparable between builds; the
+// shuffle inside SelectCoinsMinConf still uses the global RNG, which is
+// the behaviour we want to measure anyway.
+static uint32_t nReplaySeed = 0x5eed5eed;
+static uint32_t ReplayRand(uint32_t nMax)
+{
+    nReplaySeed = nReplaySeed * 1664525 + 1013904223;
+    return (nReplaySeed >> 8) % nMax;
+}
+
+// Add a single-output wallet transaction and expose it for selection.
+// The caller owns the CWalletTx and frees it once the output is spent.
+static void AddReplayCoin(const CWallet& wallet, const CAmount& nValue, std::vector<COutput>& vCoins)
+{
+    static uint32_t nUniqueLockTime = 0;
+    CMutableTransaction tx;
+    tx.nLockTime = nUniqueLockTime++; // so every synthetic tx hashes differently
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    CWalletTx* wtx = new CWalletTx(&wallet, CTransaction(tx));
+    vCoins.push_back(COutput(wtx, 0, 6 * 24, true));
+}
+
+static void FreeReplayCoins(std::vector<COutput>& vCoins)
+{
+    BOOST_FOREACH (const COutput& out, vCoins)
+        delete out.tx;
+    vCoins.clear();
+}
+
+// Time one SelectCoinsMinConf pass over a fixed-size synthetic UTXO set,
+// the hot inner loop of CreateTransaction.
+static void CoinSelection(benchmark::State& state)
+{
+    const CWallet wallet;
+    std::vector<COutput> vCoins;
+    for (int i = 0; i < 1000; i++)
+        AddReplayCoin(wallet, (1 + ReplayRand(1000)) * CENT, vCoins);
+
+    while (state.KeepRunning()) {
+        std::set<std::pair<const CWalletTx*, unsigned int> > setCoinsRet;
+        CAmount nValueRet;
+        wallet.SelectCoinsMinConf("", 5 * COIN, 1, 6, vCoins, setCoinsRet, nValueRet);
+    }
+
+    FreeReplayCoins(vCoins);
+}
+
+// Replay a synthetic deposit/withdrawal stream through coin selection,
+// maintaining the UTXO set as spends consume outputs and change returns.
+// Prints selection quality stats alongside the timing row: withdrawals
+// serviced, inputs per spend, change output sizes and the UTXO set
+// trajectory, so wallet changes can be compared offline.
+static void CoinSelectionReplay(benchmark::State& state)
+{
+    const CWallet wallet;
+    std::vector<COutput> vCoins;
+    for (int i = 0; i < 500; i++)
+        AddReplayCoin(wallet, (1 + ReplayRand(1000)) * CENT, vCoins);
+
+    uint64_t nWithdrawals = 0, nFailed = 0, nInputsTotal = 0, nInputsMax = 0;
+    uint64_t nChangeOutputs = 0;
+    CAmount nChangeTotal = 0;
+    size_t nUtxoPeak = vCoins.size(), nUtxoLow = vCoins.size();
+
+    while (state.KeepRunning()) {
+        if (ReplayRand(100) < 60) {
+            // Deposit: a fresh output between 0.01 and 10 LUX.
+            AddReplayCoin(wallet, (1 + ReplayRand(1000)) * CENT, vCoins);
+        } else {
+            // Withdrawal: select coins for a random target and give change back.
+            CAmount nTarget = (1 + ReplayRand(500)) * CENT;
+            std::set<std::pair<const CWalletTx*, unsigned int> > setCoinsRet;
+            CAmount nValueRet;
+            nWithdrawals++;
+            if (!wallet.SelectCoinsMinConf("", nTarget, 1, 6, vCoins, setCoinsRet, nValueRet)) {
+                nFailed++;
+            } else {
+                nInputsTotal += setCoinsRet.size();
+                nInputsMax = std::max<uint64_t>(nInputsMax, setCoinsRet.size());
+                for (std::vector<COutput>::iterator it = vCoins.begin(); it != vCoins.end();) {
+                    if (setCoinsRet.count(std::make_pair(it->tx, (unsigned int)it->i))) {
+                        delete it->tx;
+                        it = vCoins.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                CAmount nChange = nValueRet - nTarget;
+                if (nChange > CENT / 10) {
+                    nChangeOutputs++;
+                    nChangeTotal += nChange;
+                    AddReplayCoin(wallet, nChange, vCoins);
+                }
+            }
+        }
+        nUtxoPeak = std::max(nUtxoPeak, vCoins.size());
+        nUtxoLow = std::min(nUtxoLow, vCoins.size());
+    }
+
+    printf("# CoinSelectionReplay: %llu withdrawals (%llu unfunded), %.2f inputs/spend (max %llu), "
+           "%llu change outputs avg %s, utxos %u..%u end %u\n",
+        (unsigned long long)nWithdrawals, (unsigned long long)nFailed,
+        nWithdrawals > nFailed ? (double)nInputsTotal / (nWithdrawals - nFailed) : 0.0,
+        (unsigned long long)nInputsMax, (unsigned long long)nChangeOutputs,
+        FormatMoney(nChangeOutputs ? nChangeTotal / (CAmount)nChangeOutputs : 0).c_str(),
+        (unsigned)nUtxoLow, (unsigned)nUtxoPeak, (unsigned)vCoins.size());
+
+    FreeReplayCoins(vCoins);
+}
+
+BENCHMARK(CoinSelection);
+BENCHMARK(CoinSelectionReplay);
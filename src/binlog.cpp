@@ -0,0 +1,269 @@
+// Copyright (c) 2015-2017 The Lux developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "binlog.h"
+
+#include "sync.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <map>
+#include <vector>
+
+#include <atomic>
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+bool fBinaryLog = false;
+
+namespace {
+
+//! Per-thread ring capacity in bytes; must be a power of two. 256KB absorbs
+//! several thousand events between 50ms drain cycles.
+static const uint32_t BINLOG_RING_BYTES = 1 << 18;
+
+//! Per-event overhead in the ring: u32 header (category id + payload length)
+//! followed by the i64 microsecond timestamp.
+static const uint32_t BINLOG_EVENT_OVERHEAD = 4 + 8;
+
+//! File magic written at the start of a fresh binlog.dat.
+static const char BINLOG_MAGIC[8] = {'L', 'U', 'X', 'B', 'L', 'O', 'G', '\x01'};
+
+/**
+ * Single-producer single-consumer byte ring. The owning thread is the only
+ * writer and the drain thread the only reader, so a pair of free-running
+ * atomic offsets is all the synchronization needed. Rings are leaked on
+ * thread exit: the drain thread may still hold a pointer, and a handful of
+ * 256KB buffers is cheap next to a dangling read.
+ */
+struct CBinLogRing {
+    unsigned char vchData[BINLOG_RING_BYTES];
+    std::atomic<uint32_t> nWrite; // producer-owned, free-running
+    std::atomic<uint32_t> nRead;  // consumer-owned, free-running
+    std::atomic<uint64_t> nDropped;
+
+    CBinLogRing() : nWrite(0), nRead(0), nDropped(0) {}
+
+    void Put(uint32_t nPos, const void* pData, uint32_t nLen)
+    {
+        uint32_t nOffset = nPos & (BINLOG_RING_BYTES - 1);
+        uint32_t nFirst = std::min(nLen, BINLOG_RING_BYTES - nOffset);
+        memcpy(vchData + nOffset, pData, nFirst);
+        if (nFirst < nLen)
+            memcpy(vchData, (const unsigned char*)pData + nFirst, nLen - nFirst);
+    }
+
+    void Get(uint32_t nPos, void* pData, uint32_t nLen) const
+    {
+        uint32_t nOffset = nPos & (BINLOG_RING_BYTES - 1);
+        uint32_t nFirst = std::min(nLen, BINLOG_RING_BYTES - nOffset);
+        memcpy(pData, vchData + nOffset, nFirst);
+        if (nFirst < nLen)
+            memcpy((unsigned char*)pData + nFirst, vchData, nLen - nFirst);
+    }
+};
+
+CCriticalSection cs_binlog;
+//! All rings ever created, drained in turn by the writer thread.
+std::vector<CBinLogRing*> vpBinLogRings;
+//! Category name to numeric id, assigned on first use.
+std::map<std::string, uint16_t> mapCategoryIds;
+
+//! Rings outlive their threads (see CBinLogRing), so cleanup is a no-op.
+void NoopRingCleanup(CBinLogRing*) {}
+boost::thread_specific_ptr<CBinLogRing> ptrThreadRing(&NoopRingCleanup);
+
+CBinLogRing* GetThreadRing()
+{
+    CBinLogRing* pring = ptrThreadRing.get();
+    if (pring == NULL) {
+        pring = new CBinLogRing();
+        ptrThreadRing.reset(pring);
+        LOCK(cs_binlog);
+        vpBinLogRings.push_back(pring);
+    }
+    return pring;
+}
+
+uint16_t GetCategoryId(const char* category)
+{
+    // Category strings are almost always literals, so a thread-local cache
+    // keyed by pointer keeps the steady state free of locks.
+    static boost::thread_specific_ptr<std::map<const void*, uint16_t> > ptrCache;
+    if (ptrCache.get() == NULL)
+        ptrCache.reset(new std::map<const void*, uint16_t>());
+    std::map<const void*, uint16_t>::const_iterator it = ptrCache->find(category);
+    if (it != ptrCache->end())
+        return it->second;
+
+    std::string strName(category ? category : "");
+    uint16_t nId;
+    {
+        LOCK(cs_binlog);
+        std::map<std::string, uint16_t>::const_iterator mi = mapCategoryIds.find(strName);
+        if (mi != mapCategoryIds.end())
+            nId = mi->second;
+        else {
+            nId = (uint16_t)mapCategoryIds.size();
+            mapCategoryIds[strName] = nId;
+        }
+    }
+    (*ptrCache)[category] = nId;
+    return nId;
+}
+
+void WriteLE16(FILE* file, uint16_t n)
+{
+    unsigned char buf[2] = {(unsigned char)(n & 0xff), (unsigned char)(n >> 8)};
+    fwrite(buf, 1, 2, file);
+}
+
+void WriteLE64(FILE* file, uint64_t n)
+{
+    unsigned char buf[8];
+    for (int i = 0; i < 8; i++)
+        buf[i] = (unsigned char)((n >> (8 * i)) & 0xff);
+    fwrite(buf, 1, 8, file);
+}
+
+} // anon namespace
+
+void BinaryLogWrite(const char* category, const std::string& str)
+{
+    CBinLogRing* pring = GetThreadRing();
+
+    uint32_t nLen = (uint32_t)std::min(str.size(), (size_t)0xffff);
+    uint32_t nNeeded = BINLOG_EVENT_OVERHEAD + nLen;
+    uint32_t nWrite = pring->nWrite.load(std::memory_order_relaxed);
+    uint32_t nRead = pring->nRead.load(std::memory_order_acquire);
+    if (BINLOG_RING_BYTES - (nWrite - nRead) < nNeeded) {
+        // Never block the producer; the writer reports drop totals.
+        pring->nDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint32_t nHeader = ((uint32_t)GetCategoryId(category) << 16) | nLen;
+    int64_t nTimeUs = GetTimeMicros();
+    pring->Put(nWrite, &nHeader, 4);
+    pring->Put(nWrite + 4, &nTimeUs, 8);
+    pring->Put(nWrite + 12, str.data(), nLen);
+    pring->nWrite.store(nWrite + nNeeded, std::memory_order_release);
+}
+
+namespace {
+
+//! Emit a category-define record (type 0x01) the first time an id reaches disk.
+void EnsureCategoryDefined(FILE* file, uint16_t nId, std::map<uint16_t, bool>& mapEmitted)
+{
+    if (mapEmitted.count(nId))
+        return;
+    std::string strName;
+    {
+        LOCK(cs_binlog);
+        for (std::map<std::string, uint16_t>::const_iterator it = mapCategoryIds.begin(); it != mapCategoryIds.end(); ++it) {
+            if (it->second == nId) {
+                strName = it->first;
+                break;
+            }
+        }
+    }
+    fputc(0x01, file);
+    WriteLE16(file, nId);
+    fputc((unsigned char)std::min(strName.size(), (size_t)0xff), file);
+    fwrite(strName.data(), 1, std::min(strName.size(), (size_t)0xff), file);
+    mapEmitted[nId] = true;
+}
+
+//! Copy every complete record out of one ring. Returns bytes drained.
+uint32_t DrainRing(FILE* file, CBinLogRing* pring, std::map<uint16_t, bool>& mapEmitted)
+{
+    uint32_t nRead = pring->nRead.load(std::memory_order_relaxed);
+    uint32_t nWrite = pring->nWrite.load(std::memory_order_acquire);
+    uint32_t nDrained = 0;
+    std::vector<unsigned char> vchPayload;
+    while (nWrite - nRead >= BINLOG_EVENT_OVERHEAD) {
+        uint32_t nHeader;
+        int64_t nTimeUs;
+        pring->Get(nRead, &nHeader, 4);
+        pring->Get(nRead + 4, &nTimeUs, 8);
+        uint16_t nId = (uint16_t)(nHeader >> 16);
+        uint32_t nLen = nHeader & 0xffff;
+        vchPayload.resize(nLen);
+        if (nLen)
+            pring->Get(nRead + 12, &vchPayload[0], nLen);
+
+        EnsureCategoryDefined(file, nId, mapEmitted);
+        fputc(0x02, file);
+        WriteLE16(file, nId);
+        WriteLE64(file, (uint64_t)nTimeUs);
+        WriteLE16(file, (uint16_t)nLen);
+        if (nLen)
+            fwrite(&vchPayload[0], 1, nLen, file);
+
+        nRead += BINLOG_EVENT_OVERHEAD + nLen;
+        nDrained += BINLOG_EVENT_OVERHEAD + nLen;
+    }
+    pring->nRead.store(nRead, std::memory_order_release);
+    return nDrained;
+}
+
+uint32_t DrainAllRings(FILE* file, std::map<uint16_t, bool>& mapEmitted, uint64_t& nDroppedTotal)
+{
+    std::vector<CBinLogRing*> vpRings;
+    {
+        LOCK(cs_binlog);
+        vpRings = vpBinLogRings;
+    }
+    uint32_t nDrained = 0;
+    uint64_t nDropped = 0;
+    for (size_t i = 0; i < vpRings.size(); i++) {
+        nDrained += DrainRing(file, vpRings[i], mapEmitted);
+        nDropped += vpRings[i]->nDropped.load(std::memory_order_relaxed);
+    }
+    if (nDropped != nDroppedTotal) {
+        // Drop-notice record (type 0x03): cumulative events lost to full rings.
+        fputc(0x03, file);
+        WriteLE64(file, nDropped);
+        nDroppedTotal = nDropped;
+    }
+    if (nDrained)
+        fflush(file);
+    return nDrained;
+}
+
+} // anon namespace
+
+void ThreadBinaryLog()
+{
+    RenameThread("lux-binlog");
+
+    boost::filesystem::path pathBinLog = GetDataDir() / "binlog.dat";
+    bool fNewFile = !boost::filesystem::exists(pathBinLog) || boost::filesystem::file_size(pathBinLog) == 0;
+    FILE* file = fopen(pathBinLog.string().c_str(), "ab");
+    if (!file) {
+        LogPrintf("%s: cannot open %s, binary logging disabled\n", __func__, pathBinLog.string());
+        fBinaryLog = false;
+        return;
+    }
+    if (fNewFile)
+        fwrite(BINLOG_MAGIC, 1, sizeof(BINLOG_MAGIC), file);
+
+    std::map<uint16_t, bool> mapEmitted;
+    uint64_t nDroppedTotal = 0;
+    try {
+        while (true) {
+            MilliSleep(50);
+            DrainAllRings(file, mapEmitted, nDroppedTotal);
+        }
+    } catch (boost::thread_interrupted&) {
+        // Final drain so events logged during shutdown are not lost.
+        fBinaryLog = false;
+        DrainAllRings(file, mapEmitted, nDroppedTotal);
+        fflush(file);
+        fclose(file);
+        throw;
+    }
+}
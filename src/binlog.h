@@ -0,0 +1,33 @@
+// Copyright (c) 2015-2017 The Lux developers                      -*- c++ -*-
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BINLOG_H
+#define BITCOIN_BINLOG_H
+
+#include <string>
+
+//! Set from -binlog; while true, LogPrint output bypasses debug.log and is
+//! captured into the binary event log instead.
+extern bool fBinaryLog;
+
+/**
+ * Structured binary logging backend. Each producer thread appends records
+ * (microsecond timestamp, numeric category id, formatted message) into its
+ * own lock-free ring buffer; a single writer thread drains the rings to
+ * binlog.dat in the data directory. Producers never take a lock or touch
+ * the filesystem on the hot path, so full-category logging stays cheap
+ * enough to leave enabled in production for incident forensics. When a
+ * ring fills faster than the writer drains it, records are dropped and
+ * counted rather than blocking the producer.
+ *
+ * The on-disk format is decoded by contrib/binlog/binlog-reader.py.
+ */
+
+/** Append one event to the calling thread's ring buffer. */
+void BinaryLogWrite(const char* category, const std::string& str);
+
+/** Drain the per-thread rings to binlog.dat until interrupted. */
+void ThreadBinaryLog();
+
+#endif // BITCOIN_BINLOG_H
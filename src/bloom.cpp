@@ -6,6 +6,7 @@
 
 #include "hash.h"
 #include "primitives/transaction.h"
+#include "random.h"
 #include "script/script.h"
 #include "script/standard.h"
 #include "streams.h"
@@ -113,7 +114,45 @@ bool CBloomFilter::IsWithinSizeConstraints() const
     return vData.size() <= MAX_BLOOM_FILTER_SIZE && nHashFuncs <= MAX_HASH_FUNCS;
 }
 
+static void ExtractScriptPushes(const CScript& script, vector<vector<unsigned char> >& vPushes)
+{
+    CScript::const_iterator pc = script.begin();
+    vector<unsigned char> data;
+    while (pc < script.end()) {
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode, data))
+            break;
+        if (data.size() != 0)
+            vPushes.push_back(data);
+    }
+}
+
+CTxMatchCandidates::CTxMatchCandidates(const CTransaction& tx)
+{
+    vOutputPushes.resize(tx.vout.size());
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+        ExtractScriptPushes(tx.vout[i].scriptPubKey, vOutputPushes[i]);
+
+    vInputPushes.resize(tx.vin.size());
+    vPrevOutData.resize(tx.vin.size());
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        ExtractScriptPushes(tx.vin[i].scriptSig, vInputPushes[i]);
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << tx.vin[i].prevout;
+        vPrevOutData[i].assign(stream.begin(), stream.end());
+    }
+}
+
 bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return IsRelevantAndUpdate(tx, CTxMatchCandidates(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx, const CTxMatchCandidates& cand)
 {
     bool fFound = false;
     // Match if the filter contains the hash of tx
@@ -126,26 +165,20 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (contains(hash))
         fFound = true;
 
-    for (unsigned int i = 0; i < tx.vout.size(); i++) {
-        const CTxOut& txout = tx.vout[i];
+    for (unsigned int i = 0; i < cand.vOutputPushes.size(); i++) {
         // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        vector<unsigned char> data;
-        while (pc < txout.scriptPubKey.end()) {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data)) {
+        BOOST_FOREACH (const vector<unsigned char>& data, cand.vOutputPushes[i]) {
+            if (contains(data)) {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
                     insert(COutPoint(hash, i));
                 else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY) {
                     txnouttype type;
                     vector<vector<unsigned char> > vSolutions;
-                    if (Solver(txout.scriptPubKey, type, vSolutions) &&
+                    if (Solver(tx.vout[i].scriptPubKey, type, vSolutions) &&
                         (type == TX_PUBKEY || type == TX_MULTISIG))
                         insert(COutPoint(hash, i));
                 }
@@ -157,19 +190,14 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (fFound)
         return true;
 
-    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+    for (unsigned int i = 0; i < cand.vPrevOutData.size(); i++) {
         // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+        if (contains(cand.vPrevOutData[i]))
             return true;
 
         // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        vector<unsigned char> data;
-        while (pc < txin.scriptSig.end()) {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+        BOOST_FOREACH (const vector<unsigned char>& data, cand.vInputPushes[i]) {
+            if (contains(data))
                 return true;
         }
     }
@@ -188,3 +216,56 @@ void CBloomFilter::UpdateEmptyFull()
     isFull = full;
     isEmpty = empty;
 }
+
+CRollingBloomFilter::CRollingBloomFilter(unsigned int nElements, double nFPRate) :
+    b1(nElements * 2, nFPRate, (unsigned int)GetRand(std::numeric_limits<unsigned int>::max()), BLOOM_UPDATE_NONE),
+    b2(nElements * 2, nFPRate, (unsigned int)GetRand(std::numeric_limits<unsigned int>::max()), BLOOM_UPDATE_NONE)
+{
+    // Both filters are sized for 2 * nElements. They are filled in parallel
+    // and cleared alternately every nElements insertions, so whichever one
+    // was cleared less recently covers at least the last nElements items.
+    nBloomSize = nElements * 2;
+    nInsertions = 0;
+}
+
+void CRollingBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    if (nInsertions == 0) {
+        b1.clear();
+    } else if (nInsertions == nBloomSize / 2) {
+        b2.clear();
+    }
+    b1.insert(vKey);
+    b2.insert(vKey);
+    if (++nInsertions == nBloomSize) {
+        nInsertions = 0;
+    }
+}
+
+void CRollingBloomFilter::insert(const uint256& hash)
+{
+    vector<unsigned char> data(hash.begin(), hash.end());
+    insert(data);
+}
+
+bool CRollingBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    // The filter cleared less recently has seen the most history.
+    if (nInsertions < nBloomSize / 2) {
+        return b2.contains(vKey);
+    }
+    return b1.contains(vKey);
+}
+
+bool CRollingBloomFilter::contains(const uint256& hash) const
+{
+    vector<unsigned char> data(hash.begin(), hash.end());
+    return contains(data);
+}
+
+void CRollingBloomFilter::reset()
+{
+    nInsertions = 0;
+    b1.clear();
+    b2.clear();
+}
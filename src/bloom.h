@@ -29,6 +29,24 @@ enum bloomflags {
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * Pre-extracted matchable elements of one transaction: the data pushes of
+ * every scriptPubKey and scriptSig plus each serialized spent outpoint.
+ * Extracting once and testing the result against every SPV peer's filter
+ * avoids re-parsing the scripts and re-serializing the outpoints per peer.
+ */
+class CTxMatchCandidates
+{
+public:
+    //! Data pushes per output / per input, in script order
+    std::vector<std::vector<std::vector<unsigned char> > > vOutputPushes;
+    std::vector<std::vector<std::vector<unsigned char> > > vInputPushes;
+    //! Serialized prevout per input
+    std::vector<std::vector<unsigned char> > vPrevOutData;
+
+    explicit CTxMatchCandidates(const CTransaction& tx);
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we sends them.
@@ -93,8 +111,40 @@ public:
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
 
+    //! Same, against pre-extracted elements; use when one tx is tested
+    //! against many peer filters so the scripts are only parsed once.
+    bool IsRelevantAndUpdate(const CTransaction& tx, const CTxMatchCandidates& cand);
+
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
 };
 
+/**
+ * RollingBloomFilter is a probabilistic "keep track of most recently inserted
+ * items" set. Construct it with the number of items to keep track of, and a
+ * false-positive rate.
+ *
+ * contains(item) will always return true if item was one of the last
+ * nElements inserted; older items are forgotten gradually. Implemented with
+ * two staggered bloom filters that are cleared alternately, so at least one
+ * of them always covers the last nElements insertions.
+ */
+class CRollingBloomFilter
+{
+public:
+    CRollingBloomFilter(unsigned int nElements, double nFPRate);
+
+    void insert(const std::vector<unsigned char>& vKey);
+    void insert(const uint256& hash);
+    bool contains(const std::vector<unsigned char>& vKey) const;
+    bool contains(const uint256& hash) const;
+
+    void reset();
+
+private:
+    unsigned int nBloomSize;
+    unsigned int nInsertions;
+    CBloomFilter b1, b2;
+};
+
 #endif // BITCOIN_BLOOM_H
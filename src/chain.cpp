@@ -25,28 +25,41 @@ void CChain::SetTip(CBlockIndex* pindex)
 
 CBlockLocator CChain::GetLocator(const CBlockIndex* pindex) const
 {
-    int nStep = 1;
     std::vector<uint256> vHave;
     vHave.reserve(32);
 
     if (!pindex)
         pindex = Tip();
-    while (pindex) {
-        vHave.push_back(pindex->GetBlockHash());
-        // Stop when we have added the genesis block.
-        if (pindex->nHeight == 0)
+    if (!pindex)
+        return CBlockLocator(vHave);
+
+    // The locator heights only depend on the starting height, so compute
+    // them up front and resolve them in one descending batch: an off-chain
+    // starting point (the usual case while syncing headers) then costs a
+    // single skiplist descent instead of one per locator entry.
+    int nStep = 1;
+    std::vector<int> vHeights;
+    vHeights.reserve(32);
+    int nHeight = pindex->nHeight;
+    while (true) {
+        vHeights.push_back(nHeight);
+        if (nHeight == 0)
             break;
         // Exponentially larger steps back, plus the genesis block.
-        int nHeight = std::max(pindex->nHeight - nStep, 0);
-        if (Contains(pindex)) {
-            // Use O(1) CChain index if possible.
-            pindex = (*this)[nHeight];
-        } else {
-            // Otherwise, use O(log n) skiplist.
-            pindex = pindex->GetAncestor(nHeight);
-        }
-        if (vHave.size() > 10)
+        if (vHeights.size() > 10)
             nStep *= 2;
+        nHeight = std::max(nHeight - nStep, 0);
+    }
+
+    if (Contains(pindex)) {
+        // Active-chain starting point: O(1) array hits all the way down.
+        for (std::vector<int>::const_iterator it = vHeights.begin(); it != vHeights.end(); ++it)
+            vHave.push_back(vChain[*it]->GetBlockHash());
+    } else {
+        std::vector<const CBlockIndex*> vAncestors;
+        pindex->GetAncestors(vHeights, vAncestors);
+        for (std::vector<const CBlockIndex*>::const_iterator it = vAncestors.begin(); it != vAncestors.end(); ++it)
+            vHave.push_back((*it)->GetBlockHash());
     }
 
     return CBlockLocator(vHave);
@@ -56,8 +69,28 @@ const CBlockIndex* CChain::FindFork(const CBlockIndex* pindex) const
 {
     if (pindex->nHeight > Height())
         pindex = pindex->GetAncestor(Height());
-    while (pindex && !Contains(pindex))
+    // Recent forks are a few blocks deep, so chase pprev first; past that,
+    // binary-search the fork height over the skiplist rather than walking
+    // one cold block index entry at a time.
+    int nWalked = 0;
+    while (pindex && !Contains(pindex)) {
+        if (++nWalked > 32) {
+            if (!Contains(pindex->GetAncestor(0)))
+                return NULL; // different genesis
+            // Invariant: the ancestor at nLow is in this chain, at nHigh is not.
+            int nLow = 0;
+            int nHigh = pindex->nHeight;
+            while (nHigh - nLow > 1) {
+                int nMid = (nLow + nHigh) / 2;
+                if (Contains(pindex->GetAncestor(nMid)))
+                    nLow = nMid;
+                else
+                    nHigh = nMid;
+            }
+            return (*this)[nLow];
+        }
         pindex = pindex->pprev;
+    }
     return pindex;
 }
 
@@ -68,6 +101,26 @@ CBlockIndex* CChain::FindEarliestAtLeast(int64_t nTime) const
     return (lower == vChain.end() ? nullptr : *lower);
 }
 
+CBlockIndex* CChain::FindEarliestAtLeastWork(const uint256& nWork) const
+{
+    std::vector<CBlockIndex*>::const_iterator lower = std::lower_bound(vChain.begin(), vChain.end(), nWork,
+        [](CBlockIndex* pBlock, const uint256& work) -> bool { return pBlock->nChainWork < work; });
+    return (lower == vChain.end() ? nullptr : *lower);
+}
+
+void CBlockIndex::GetAncestors(const std::vector<int>& vHeights, std::vector<const CBlockIndex*>& vAncestorsRet) const
+{
+    vAncestorsRet.clear();
+    vAncestorsRet.reserve(vHeights.size());
+    const CBlockIndex* pindexWalk = this;
+    for (std::vector<int>::const_iterator it = vHeights.begin(); it != vHeights.end(); ++it) {
+        // Each step starts from the previous (lower) ancestor, so the whole
+        // batch shares one descent.
+        pindexWalk = pindexWalk ? pindexWalk->GetAncestor(*it) : NULL;
+        vAncestorsRet.push_back(pindexWalk);
+    }
+}
+
 
 uint256 CBlockIndex::GetBlockTrust() const
 {
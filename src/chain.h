@@ -418,6 +418,12 @@ public:
     //! Efficiently find an ancestor of this block.
     CBlockIndex* GetAncestor(int height);
     const CBlockIndex* GetAncestor(int height) const;
+
+    //! Resolve several ancestor heights in one descending skiplist walk.
+    //! vHeights must be sorted in descending order; the whole batch costs
+    //! about as much as a single GetAncestor to the lowest height, instead
+    //! of one full descent per query.
+    void GetAncestors(const std::vector<int>& vHeights, std::vector<const CBlockIndex*>& vAncestorsRet) const;
 };
 
 /** Used to marshal pointers into hashes for db storage. */
@@ -589,6 +595,11 @@ public:
 
      /** Find the earliest block with timestamp equal or greater than the given. */
     CBlockIndex* FindEarliestAtLeast(int64_t nTime) const;
+
+    /** Find the earliest block whose cumulative chain work is equal or greater
+     *  than the given; chain work is monotone along the chain, so this is a
+     *  binary search over the height array. */
+    CBlockIndex* FindEarliestAtLeastWork(const uint256& nWork) const;
 };
 
 #endif // BITCOIN_CHAIN_H
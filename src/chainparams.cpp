@@ -645,10 +645,21 @@ CChainParams* CreateChainParams(CBaseChainParams::Network network)
     }
 }
 
+CFrozenChainParams frozenParams;
+
 void SelectParams(CBaseChainParams::Network network)
 {
     SelectBaseParams(network);
     pCurrentParams = &Params(network);
+
+    // Capture the hot constants validation reads per transaction/block.
+    frozenParams.nFirstSCBlock = pCurrentParams->FirstSCBlock();
+    frozenParams.nSwitchPhi2Block = pCurrentParams->SwitchPhi2Block();
+    frozenParams.nLastPOWBlock = pCurrentParams->LAST_POW_BLOCK();
+    frozenParams.nCoinbaseMaturity = pCurrentParams->COINBASE_MATURITY();
+    frozenParams.nMaxReorganizationDepth = pCurrentParams->MaxReorganizationDepth();
+    frozenParams.nPruneAfterHeight = pCurrentParams->PruneAfterHeight();
+    frozenParams.fRequireStandard = pCurrentParams->RequireStandard();
 }
 
 bool SelectParamsFromCommandLine()
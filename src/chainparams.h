@@ -170,6 +170,28 @@ public:
 };
 
 
+/**
+ * Hot consensus constants frozen at SelectParams time.
+ *
+ * Every Params() call is a cross-translation-unit function call plus an
+ * assert, which the compiler cannot fold away inside per-transaction and
+ * per-block validation loops. The fields below never change after network
+ * selection (the unit-test setters touch none of them), so validation code
+ * reads them from this plain struct instead: a direct load the optimizer can
+ * hoist out of loops. Anything not on a hot path should keep using Params().
+ */
+struct CFrozenChainParams {
+    int nFirstSCBlock;
+    int nSwitchPhi2Block;
+    int nLastPOWBlock;
+    int nCoinbaseMaturity;
+    int nMaxReorganizationDepth;
+    uint64_t nPruneAfterHeight;
+    bool fRequireStandard;
+};
+
+extern CFrozenChainParams frozenParams;
+
 /**
  * Return the currently selected parameters. This won't change after app startup
  * outside of the unit tests.
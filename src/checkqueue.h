@@ -6,6 +6,8 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <stdint.h>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -16,7 +18,7 @@
 template <typename T>
 class CCheckQueueControl;
 
-/** 
+/**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
   * operator(), returning a bool.
@@ -25,104 +27,171 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Work distribution is epoch based and lock free on the hot path: the
+  * master moves checks into chunk slots and publishes them through an
+  * atomic counter, workers claim chunks with a compare-exchange on a
+  * packed (epoch, index) word, and failure is published through a relaxed
+  * atomic flag that all workers poll to short-circuit. The mutex and
+  * condition variables are only touched to go to sleep and wake up, so
+  * small batches no longer pay a mutex handoff per chunk.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
-    boost::mutex mutex;
+    //! Number of chunk slots per epoch. With per-transaction Add() calls this
+    //! bounds the transactions per block we can spread over workers; anything
+    //! beyond it is executed inline by the master (correct, just serial).
+    static const uint32_t MAX_CHUNKS = 16384;
 
-    //! Worker threads block on this when out of work
-    boost::condition_variable condWorker;
+    //! Idle iterations on the claim path before a thread gives up spinning
+    //! and sleeps on its condition variable.
+    static const unsigned int IDLE_SPINS_BEFORE_WAIT = 5000;
 
-    //! Master thread blocks on this when out of work
-    boost::condition_variable condMaster;
+    //! Chunk slots for the current epoch. Slot i is filled by the master
+    //! before index i is published through nAddedWord, and read only by the
+    //! worker that claims index i, so the slots themselves need no lock.
+    std::vector<T> vChunks[MAX_CHUNKS];
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! Claim word: epoch in the high 32 bits, next unclaimed chunk index in
+    //! the low 32 bits. The epoch makes a stale compare-exchange from a
+    //! worker that was preempted across an epoch boundary fail harmlessly.
+    std::atomic<uint64_t> nClaimWord;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! Published word: epoch in the high 32 bits, number of chunk slots
+    //! published this epoch in the low 32 bits.
+    std::atomic<uint64_t> nAddedWord;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! Number of chunks fully processed in the current epoch.
+    std::atomic<uint32_t> nDone;
 
-    //! The temporary evaluation result.
-    bool fAllOk;
+    //! Set by any worker whose check fails; polled (relaxed) by the others
+    //! to short-circuit the remainder of the epoch.
+    std::atomic<bool> fFailed;
 
-    /**
-     * Number of verifications that haven't completed yet.
-     * This includes elements that are not anymore in queue, but still in
-     * worker's own batches.
-     */
-    unsigned int nTodo;
+    //! Number of workers currently committed to sleeping; lets Add() skip
+    //! the mutex entirely when everyone is busy.
+    std::atomic<int> nSleeping;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! Only guard going to sleep and waking up; never held while working.
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condMaster;
 
-    //! The maximum number of elements to be processed in one batch
+    //! The maximum number of elements per chunk
     unsigned int nBatchSize;
 
+    static uint32_t EpochPart(uint64_t nWord) { return (uint32_t)(nWord >> 32); }
+    static uint32_t IndexPart(uint64_t nWord) { return (uint32_t)(nWord & 0xffffffffu); }
+    static uint64_t MakeWord(uint32_t nEpoch, uint32_t nIndex) { return ((uint64_t)nEpoch << 32) | nIndex; }
+
+    //! Execute one chunk of checks, honoring failure published by others.
+    void RunChunk(std::vector<T>& vChecks)
+    {
+        bool fOk = true;
+        BOOST_FOREACH (T& check, vChecks) {
+            if (fFailed.load(std::memory_order_relaxed))
+                break;
+            if (!check()) {
+                fOk = false;
+                break;
+            }
+        }
+        if (!fOk)
+            fFailed.store(true, std::memory_order_relaxed);
+        vChecks.clear();
+        nDone.fetch_add(1);
+    }
+
+    //! Try to claim and run one published chunk; false if none claimable.
+    bool ClaimAndRun()
+    {
+        uint64_t nClaim = nClaimWord.load();
+        do {
+            uint64_t nAdded = nAddedWord.load();
+            // A transient epoch mismatch means a reset is in progress.
+            if (EpochPart(nClaim) != EpochPart(nAdded))
+                return false;
+            uint32_t nIndex = IndexPart(nClaim);
+            if (nIndex >= IndexPart(nAdded))
+                return false;
+            // On failure nClaim is refreshed by compare_exchange; the epoch
+            // may have moved, so the published word is re-read as well.
+            if (nClaimWord.compare_exchange_weak(nClaim, MakeWord(EpochPart(nClaim), nIndex + 1))) {
+                RunChunk(vChunks[nIndex]);
+                return true;
+            }
+        } while (true);
+    }
+
+    //! After finishing a chunk, wake the master if that was the last one.
+    void MaybeNotifyMaster()
+    {
+        if (nDone.load() == IndexPart(nAddedWord.load())) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            condMaster.notify_one();
+        }
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
-        std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
+        unsigned int nIdleSpins = 0;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master he can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
+            if (ClaimAndRun()) {
+                nIdleSpins = 0;
+                MaybeNotifyMaster();
+                continue;
+            }
+
+            if (fMaster) {
+                // Out of claimable work: wait for the stragglers, spinning
+                // first since small batches drain in microseconds.
+                uint32_t nTarget = IndexPart(nAddedWord.load());
+                while (nDone.load() != nTarget) {
+                    if (++nIdleSpins < IDLE_SPINS_BEFORE_WAIT) {
+                        if ((nIdleSpins & 63) == 0)
+                            boost::this_thread::interruption_point();
+                        continue;
                     }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    while (nDone.load() != nTarget)
+                        condMaster.wait(lock);
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+                bool fRet = !fFailed.load(std::memory_order_relaxed);
+                // Reset for the next epoch. Bumping the epoch in both words
+                // invalidates any claim a stale worker might still attempt.
+                uint32_t nEpoch = EpochPart(nClaimWord.load()) + 1;
+                nDone.store(0);
+                fFailed.store(false, std::memory_order_relaxed);
+                nAddedWord.store(MakeWord(nEpoch, 0));
+                nClaimWord.store(MakeWord(nEpoch, 0));
+                return fRet;
+            }
+
+            // Worker: spin briefly, then sleep until new work is published.
+            if (++nIdleSpins < IDLE_SPINS_BEFORE_WAIT) {
+                if ((nIdleSpins & 63) == 0)
+                    boost::this_thread::interruption_point();
+                continue;
+            }
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                nSleeping.fetch_add(1);
+                // Re-check under the lock: Add() notifies under it too, so a
+                // publish cannot slip between this check and the wait.
+                uint64_t nClaim = nClaimWord.load();
+                uint64_t nAdded = nAddedWord.load();
+                while (EpochPart(nClaim) != EpochPart(nAdded) ||
+                       IndexPart(nClaim) >= IndexPart(nAdded)) {
+                    condWorker.wait(lock);
+                    nClaim = nClaimWord.load();
+                    nAdded = nAddedWord.load();
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                nSleeping.fetch_sub(1);
             }
-            // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
+            nIdleSpins = 0;
         } while (true);
     }
 
@@ -132,7 +201,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : nClaimWord(0), nAddedWord(0), nDone(0), fFailed(false), nSleeping(0), nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
@@ -149,31 +218,49 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        if (vChecks.empty())
+            return;
+        // Only the master writes here; the slots become visible to workers
+        // through the publish below.
+        uint32_t nEpoch = EpochPart(nAddedWord.load());
+        uint32_t nCount = IndexPart(nAddedWord.load());
+        size_t nFrom = 0;
+        while (nFrom < vChecks.size()) {
+            if (nCount >= MAX_CHUNKS) {
+                // Slots exhausted (not expected with real blocks): run the
+                // remainder inline rather than growing unbounded state.
+                for (size_t i = nFrom; i < vChecks.size(); i++) {
+                    if (fFailed.load(std::memory_order_relaxed))
+                        break;
+                    if (!vChecks[i]())
+                        fFailed.store(true, std::memory_order_relaxed);
+                }
+                break;
+            }
+            size_t nTake = std::min<size_t>(vChecks.size() - nFrom, nBatchSize);
+            std::vector<T>& chunk = vChunks[nCount];
+            for (size_t i = 0; i < nTake; i++) {
+                // Swap jobs into the chunk instead of copying.
+                chunk.push_back(T());
+                chunk.back().swap(vChecks[nFrom + i]);
+            }
+            nCount++;
+            nFrom += nTake;
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        nAddedWord.store(MakeWord(nEpoch, nCount));
+        // Skip the wakeup entirely while every worker is busy or spinning.
+        if (nSleeping.load() > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
             condWorker.notify_all();
+        }
     }
 
     ~CCheckQueue()
     {
     }
-#if 0
-    bool IsIdle()
-    {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
-    }
-#endif
 };
 
-/** 
+/**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
@@ -4,9 +4,11 @@
 
 #include "coins.h"
 
+#include "core_memusage.h"
 #include "random.h"
 
 #include <assert.h>
+#include <atomic>
 
 /**
  * calculate number of bytes for the bitmask, and its number of non-zero bytes
@@ -58,6 +60,16 @@ bool CCoins::Spend(int nPos)
 }
 
 
+uint256 CUtxoSetHasher::CoinHash(const COutPoint& outpoint, const CTxOut& txout, int nHeight, bool fCoinBase, bool fCoinStake)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << outpoint;
+    ss << VARINT(nHeight);
+    ss << (unsigned char)((fCoinBase ? 1 : 0) | (fCoinStake ? 2 : 0));
+    ss << txout;
+    return ss.GetHash();
+}
+
 bool CCoinsView::GetCoins(const uint256& txid, CCoins& coins) const { return false; }
 bool CCoinsView::HaveCoins(const uint256& txid) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(0); }
@@ -101,20 +113,34 @@ bool CCoinsViewBacked::GetStats(CCoinsStats& stats) const
     return base->GetStats(stats);
 }
 
-CCoinsKeyHasher::CCoinsKeyHasher() : salt(GetRandHash()) {}
-
-CCoinsViewCache::CCoinsViewCache(CCoinsView* baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), hashBlock(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView* baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), hashBlock(0), nDirtyEntries(0) {}
 
 CCoinsViewCache::~CCoinsViewCache()
 {
     assert(!hasModifier);
 }
 
+static std::atomic<uint64_t> nCoinsCacheLookups(0);
+static std::atomic<uint64_t> nCoinsCacheHits(0);
+
+uint64_t GetCoinsCacheLookups()
+{
+    return nCoinsCacheLookups;
+}
+
+uint64_t GetCoinsCacheHits()
+{
+    return nCoinsCacheHits;
+}
+
 CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256& txid) const
 {
+    nCoinsCacheLookups++;
     CCoinsMap::iterator it = cacheCoins.find(txid);
-    if (it != cacheCoins.end())
+    if (it != cacheCoins.end()) {
+        nCoinsCacheHits++;
         return it;
+    }
     CCoins tmp;
     if (!base->GetCoins(txid, tmp))
         return cacheCoins.end();
@@ -153,6 +179,8 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256& txid)
         }
     }
     // Assume that whenever ModifyCoins is called, the entry will be modified.
+    if (!(ret.first->second.flags & CCoinsCacheEntry::DIRTY))
+        nDirtyEntries++;
     ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
     return CCoinsModifier(*this, ret.first);
 }
@@ -205,15 +233,20 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlockIn
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
                     entry.coins.swap(it->second.coins);
                     entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+                    nDirtyEntries++;
                 }
             } else {
                 if ((itUs->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
                     // The grandparent does not have an entry, and the child is
                     // modified and being pruned. This means we can just delete
                     // it from the parent.
+                    if (itUs->second.flags & CCoinsCacheEntry::DIRTY)
+                        nDirtyEntries--;
                     cacheCoins.erase(itUs);
                 } else {
                     // A normal modification.
+                    if (!(itUs->second.flags & CCoinsCacheEntry::DIRTY))
+                        nDirtyEntries++;
                     itUs->second.coins.swap(it->second.coins);
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                 }
@@ -230,6 +263,7 @@ bool CCoinsViewCache::Flush()
 {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    nDirtyEntries = 0;
     return fOk;
 }
 
@@ -238,6 +272,23 @@ unsigned int CCoinsViewCache::GetCacheSize() const
     return cacheCoins.size();
 }
 
+unsigned int CCoinsViewCache::GetDirtyCacheSize() const
+{
+    return nDirtyEntries;
+}
+
+size_t CCoinsViewCache::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(cacheCoins);
+    for (CCoinsMap::const_iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
+        const CCoins& coins = it->second.coins;
+        nUsage += memusage::DynamicUsage(coins.vout);
+        for (unsigned int i = 0; i < coins.vout.size(); i++)
+            nUsage += RecursiveDynamicUsage(coins.vout[i].scriptPubKey);
+    }
+    return nUsage;
+}
+
 const CTxOut& CCoinsViewCache::GetOutputFor(const CTxIn& input) const
 {
     const CCoins* coins = AccessCoins(input.prevout.hash);
@@ -301,6 +352,8 @@ CCoinsModifier::~CCoinsModifier()
     cache.hasModifier = false;
     it->second.coins.Cleanup();
     if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY)
+            cache.nDirtyEntries--;
         cache.cacheCoins.erase(it);
     }
 }
@@ -7,6 +7,7 @@
 #define BITCOIN_COINS_H
 
 #include "compressor.h"
+#include "hash.h"
 #include "consensus/consensus.h"
 #include "policy/policy.h"
 #include "script/standard.h"
@@ -287,25 +288,6 @@ public:
     }
 };
 
-class CCoinsKeyHasher
-{
-private:
-    uint256 salt;
-
-public:
-    CCoinsKeyHasher();
-
-    /**
-     * This *must* return size_t. With Boost 1.46 on 32-bit systems the
-     * unordered_map will behave unpredictably if the custom hasher returns a
-     * uint64_t, resulting in failures when syncing the chain (#4634).
-     */
-    size_t operator()(const uint256& key) const
-    {
-        return key.GetHash(salt);
-    }
-};
-
 struct CCoinsCacheEntry {
     CCoins coins; // The actual cached data.
     unsigned char flags;
@@ -318,7 +300,7 @@ struct CCoinsCacheEntry {
     CCoinsCacheEntry() : coins(), flags(0) {}
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
+typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
 
 struct CCoinsStats {
     int nHeight;
@@ -332,6 +314,44 @@ struct CCoinsStats {
     CCoinsStats() : nHeight(0), hashBlock(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), hashSerialized(0), nTotalAmount(0) {}
 };
 
+/** Incrementally-maintained rolling hash of the UTXO set.
+ *
+ * Each unspent output is hashed to a 256-bit term and the set hash is the sum
+ * of all terms modulo 2^256, so adding and removing a coin are O(1) and the
+ * operations commute: two nodes holding the same UTXO set report the same
+ * hash regardless of the order of blocks and reorgs that produced it. The
+ * accumulator is updated on tip connect/disconnect (under cs_main), persisted
+ * with the chainstate at every flush, and rebuilt by a full database scan
+ * when the stored copy is missing or stale.
+ */
+class CUtxoSetHasher
+{
+    uint256 acc;
+    bool fValid;
+
+public:
+    CUtxoSetHasher() : acc(0), fValid(false) {}
+
+    //! Hash one unspent output into its accumulator term.
+    static uint256 CoinHash(const COutPoint& outpoint, const CTxOut& txout, int nHeight, bool fCoinBase, bool fCoinStake);
+
+    void Add(const uint256& term) { acc += term; }
+    void Remove(const uint256& term) { acc -= term; }
+
+    bool IsValid() const { return fValid; }
+    void Invalidate()
+    {
+        acc = 0;
+        fValid = false;
+    }
+    void SetHash(const uint256& hash)
+    {
+        acc = hash;
+        fValid = true;
+    }
+    uint256 GetHash() const { return acc; }
+};
+
 
 /** Abstract view on the open txout dataset. */
 class CCoinsView
@@ -410,6 +430,10 @@ protected:
     mutable uint256 hashBlock;
     mutable CCoinsMap cacheCoins;
 
+    /* Running count of entries carrying the DIRTY flag, so flush policy can
+     * look at the unwritten backlog without walking the whole map. */
+    size_t nDirtyEntries;
+
 public:
     CCoinsViewCache(CCoinsView* baseIn);
     ~CCoinsViewCache();
@@ -445,6 +469,13 @@ public:
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
+    //! Number of cached entries with unflushed changes
+    unsigned int GetDirtyCacheSize() const;
+
+    //! Calculate the dynamic memory usage of the cache by walking all entries.
+    //! Intended for diagnostics (getmemoryinfo), not hot paths.
+    size_t DynamicMemoryUsage() const;
+
     /** 
      * Amount of lux coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of previous transactions,
@@ -470,4 +501,9 @@ private:
     CCoinsMap::const_iterator FetchCoins(const uint256& txid) const;
 };
 
+/** Global coins cache lookup telemetry (all CCoinsViewCache instances),
+ *  consumed by the cache rebalancer in main.cpp. */
+uint64_t GetCoinsCacheLookups();
+uint64_t GetCoinsCacheHits();
+
 #endif // BITCOIN_COINS_H
@@ -0,0 +1,50 @@
+// Copyright (c) 2015-2018 The LUX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "compress.h"
+
+#include "cryptopp/filters.h"
+#include "cryptopp/zdeflate.h"
+#include "cryptopp/zinflate.h"
+
+#include <exception>
+#include <string>
+
+bool DeflateData(const std::vector<unsigned char>& vchIn, std::vector<unsigned char>& vchOut)
+{
+    try {
+        std::string strOut;
+        CryptoPP::StringSource(vchIn.empty() ? NULL : &vchIn[0], vchIn.size(), true,
+            new CryptoPP::Deflator(new CryptoPP::StringSink(strOut)));
+        vchOut.assign(strOut.begin(), strOut.end());
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool InflateData(const std::vector<unsigned char>& vchIn, std::vector<unsigned char>& vchOut, size_t nMaxSize)
+{
+    try {
+        std::string strOut;
+        CryptoPP::StringSource source(vchIn.empty() ? NULL : &vchIn[0], vchIn.size(), false,
+            new CryptoPP::Inflator(new CryptoPP::StringSink(strOut)));
+        // Pump in slices so a corrupt length field cannot balloon the output
+        // far past the caller's bound before we notice.
+        CryptoPP::lword nChunk;
+        do {
+            nChunk = 16384;
+            source.Pump2(nChunk);
+            if (strOut.size() > nMaxSize)
+                return false;
+        } while (nChunk != 0);
+        source.PumpAll();
+        if (strOut.size() > nMaxSize)
+            return false;
+        vchOut.assign(strOut.begin(), strOut.end());
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
@@ -0,0 +1,27 @@
+// Copyright (c) 2015-2018 The LUX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_COMPRESS_H
+#define BITCOIN_COMPRESS_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Thin wrappers around the vendored crypto++ raw-DEFLATE coder, for bulk
+ * disk records whose redundancy is across entries rather than within one
+ * (block undo data is the main user: the same scriptPubKeys recur for
+ * every spend of an address, and DEFLATE's LZ77 window folds the repeats
+ * into back-references).  Not suitable for untrusted network input — the
+ * caller must bound the decompressed size via nMaxSize.
+ */
+
+//! Compress vchIn into vchOut. Returns false only on internal coder failure;
+//! the caller should fall back to storing the data uncompressed.
+bool DeflateData(const std::vector<unsigned char>& vchIn, std::vector<unsigned char>& vchOut);
+
+//! Decompress vchIn into vchOut, failing if the output would exceed nMaxSize.
+//! Returns false on corrupt or oversized input.
+bool InflateData(const std::vector<unsigned char>& vchIn, std::vector<unsigned char>& vchOut, size_t nMaxSize);
+
+#endif // BITCOIN_COMPRESS_H
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_COMPRESSOR_H
 #define BITCOIN_COMPRESSOR_H
 
+#include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "script/script.h"
 #include "serialize.h"
@@ -126,4 +127,112 @@ public:
     }
 };
 
+/** First payload byte of a compressed on-disk block record (-compressblockfiles).
+ *
+ *  A raw block record starts with the little-endian header nVersion. Nothing
+ *  in validation bounds the version's low byte, so the writer keeps the marker
+ *  unambiguous by construction: WriteBlockToDisk stores any block whose raw
+ *  serialization would begin with this byte in the compressed format, whatever
+ *  -compressblockfiles says. Readers may therefore treat a leading marker byte
+ *  as a compressed record unconditionally.
+ */
+static const unsigned char COMPRESSED_BLOCK_MARKER = 0xCB;
+
+/** Compact serializer for whole blocks, backing the opt-in
+ *  -compressblockfiles on-disk format.
+ *
+ *  The header, prevout hashes, scriptSigs and witness stacks round-trip
+ *  verbatim; output amounts and scripts go through CTxOutCompressor and
+ *  counts, sequence numbers and lock times use VARINT, which is where the
+ *  savings come from (a P2PKH output shrinks from 34+8 to 21+1..9 bytes).
+ *  Decompression reproduces the original transactions bit-exactly, so
+ *  block and merkle hashes are unchanged.
+ */
+class CBlockCompressor
+{
+private:
+    CBlock& block;
+
+public:
+    CBlockCompressor(CBlock& blockIn) : block(blockIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(*(CBlockHeader*)&block);
+        if (ser_action.ForRead()) {
+            uint64_t nTx = 0;
+            READWRITE(VARINT(nTx));
+            block.vtx.clear();
+            block.vtx.reserve(nTx);
+            for (uint64_t t = 0; t < nTx; t++) {
+                CMutableTransaction mtx;
+                uint32_t nTxVersion = 0;
+                READWRITE(VARINT(nTxVersion));
+                mtx.nVersion = (int32_t)nTxVersion;
+                READWRITE(VARINT(mtx.nTime));
+                READWRITE(VARINT(mtx.nLockTime));
+                unsigned char nFlags = 0;
+                READWRITE(nFlags);
+                uint64_t nVin = 0;
+                READWRITE(VARINT(nVin));
+                mtx.vin.resize(nVin);
+                for (uint64_t i = 0; i < nVin; i++) {
+                    READWRITE(mtx.vin[i].prevout.hash);
+                    READWRITE(VARINT(mtx.vin[i].prevout.n));
+                    READWRITE(*(CScriptBase*)(&mtx.vin[i].scriptSig));
+                    READWRITE(VARINT(mtx.vin[i].nSequence));
+                }
+                uint64_t nVout = 0;
+                READWRITE(VARINT(nVout));
+                mtx.vout.resize(nVout);
+                for (uint64_t i = 0; i < nVout; i++)
+                    READWRITE(REF(CTxOutCompressor(REF(mtx.vout[i]))));
+                if (nFlags & 1) {
+                    mtx.wit.vtxinwit.resize(nVin);
+                    for (uint64_t i = 0; i < nVin; i++)
+                        READWRITE(mtx.wit.vtxinwit[i].scriptWitness.stack);
+                }
+                block.vtx.push_back(CTransaction(mtx));
+            }
+        } else {
+            uint64_t nTx = block.vtx.size();
+            READWRITE(VARINT(nTx));
+            for (uint64_t t = 0; t < nTx; t++) {
+                // CTransaction members are const; casting them away for
+                // writing is the same trick SerializeTransaction uses.
+                const CTransaction& tx = block.vtx[t];
+                uint32_t nTxVersion = (uint32_t)tx.nVersion;
+                READWRITE(VARINT(nTxVersion));
+                READWRITE(VARINT(*const_cast<uint32_t*>(&tx.nTime)));
+                READWRITE(VARINT(*const_cast<uint32_t*>(&tx.nLockTime)));
+                unsigned char nFlags = tx.HasWitness() ? 1 : 0;
+                READWRITE(nFlags);
+                uint64_t nVin = tx.vin.size();
+                READWRITE(VARINT(nVin));
+                for (uint64_t i = 0; i < nVin; i++) {
+                    CTxIn& txin = *const_cast<CTxIn*>(&tx.vin[i]);
+                    READWRITE(txin.prevout.hash);
+                    READWRITE(VARINT(txin.prevout.n));
+                    READWRITE(*(CScriptBase*)(&txin.scriptSig));
+                    READWRITE(VARINT(txin.nSequence));
+                }
+                uint64_t nVout = tx.vout.size();
+                READWRITE(VARINT(nVout));
+                for (uint64_t i = 0; i < nVout; i++)
+                    READWRITE(REF(CTxOutCompressor(REF(*const_cast<CTxOut*>(&tx.vout[i])))));
+                if (nFlags & 1) {
+                    // wit is not const (changing it does not invalidate the txid)
+                    const_cast<CTransaction&>(tx).wit.vtxinwit.resize(nVin);
+                    for (uint64_t i = 0; i < nVin; i++)
+                        READWRITE(const_cast<CTransaction&>(tx).wit.vtxinwit[i].scriptWitness.stack);
+                }
+            }
+        }
+        READWRITE(block.vchBlockSig);
+    }
+};
+
 #endif // BITCOIN_COMPRESSOR_H
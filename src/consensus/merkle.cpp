@@ -3,9 +3,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "merkle.h"
+#include "crypto/sha256.h"
 #include "hash.h"
+#include "util.h"
 #include "utilstrencodings.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 /*     WARNING! If you're reading this because you're learning about crypto
        and/or designing a new system that will use merkle trees, keep in mind
        that the following merkle tree algorithm has a serious flaw related to
@@ -130,10 +135,111 @@ static void MerkleComputation(const std::vector<uint256>& leaves, uint256* proot
     if (proot) *proot = h;
 }
 
+//! Pairs per layer below which spawning threads costs more than it saves;
+//! above it, a layer is split across cores on top of the per-call SIMD.
+static const size_t MERKLE_PARALLEL_MIN_PAIRS = 1024;
+
+static void HashLayerRange(unsigned char* out, const unsigned char* in, size_t pairs)
+{
+    SHA256D64(out, in, pairs);
+}
+
+/** Hash a padded (even-sized) layer in place, leaving the parent layer.
+ *  Pairs are independent, so big layers are split across cores; each worker
+ *  gets a multiple of eight pairs to keep the 8-way SIMD path fed. Workers
+ *  write into a separate buffer, since the in-place write of one range would
+ *  clobber the input of the one before it. */
+static void HashLayer(std::vector<uint256>& hashes)
+{
+    const size_t pairs = hashes.size() / 2;
+    int nThreads = GetNumCores();
+    if (pairs >= MERKLE_PARALLEL_MIN_PAIRS && nThreads > 1) {
+        nThreads = std::min(nThreads, (int)(pairs / MERKLE_PARALLEL_MIN_PAIRS) + 1);
+        std::vector<uint256> parent(pairs);
+        const size_t nPerThread = ((pairs + nThreads - 1) / nThreads + 7) & ~(size_t)7;
+        boost::thread_group group;
+        for (size_t nBegin = 0; nBegin < pairs; nBegin += nPerThread)
+            group.create_thread(boost::bind(&HashLayerRange, parent[nBegin].begin(),
+                hashes[2 * nBegin].begin(), std::min(nPerThread, pairs - nBegin)));
+        group.join_all();
+        hashes.swap(parent);
+    } else {
+        SHA256D64(hashes[0].begin(), hashes[0].begin(), pairs);
+        hashes.resize(pairs);
+    }
+}
+
 uint256 ComputeMerkleRoot(const std::vector<uint256>& leaves, bool* mutated) {
-    uint256 hash;
-    MerkleComputation(leaves, &hash, mutated, -1, NULL);
-    return hash;
+    // Compute the root level by level so each level is hashed as one
+    // SHA256D64 batch, letting the SIMD specializations in crypto/sha256
+    // do several nodes per call. MerkleComputation is kept for branches.
+    bool mutation = false;
+    std::vector<uint256> hashes(leaves);
+    while (hashes.size() > 1) {
+        if (mutated) {
+            for (size_t pos = 0; pos + 1 < hashes.size(); pos += 2) {
+                if (hashes[pos] == hashes[pos + 1]) mutation = true;
+            }
+        }
+        if (hashes.size() & 1) {
+            hashes.push_back(hashes.back());
+        }
+        HashLayer(hashes);
+    }
+    if (mutated) *mutated = mutation;
+    if (hashes.size() == 0) return uint256();
+    return hashes[0];
+}
+
+void CMerkleLayerCache::Build(const std::vector<uint256>& leaves)
+{
+    vLayers.clear();
+    vLayers.push_back(leaves);
+    while (vLayers.back().size() > 1) {
+        std::vector<uint256> layer = vLayers.back();
+        if (layer.size() & 1)
+            layer.push_back(layer.back());
+        HashLayer(layer);
+        vLayers.push_back(std::move(layer));
+    }
+}
+
+uint256 CMerkleLayerCache::UpdateLeaf(size_t position, const uint256& hash)
+{
+    assert(!vLayers.empty() && position < vLayers[0].size());
+    uint256 h = hash;
+    size_t pos = position;
+    for (size_t level = 0;; level++) {
+        std::vector<uint256>& layer = vLayers[level];
+        layer[pos] = h;
+        if (layer.size() == 1)
+            return h;
+        // An odd node at the end of a layer pairs with itself.
+        const uint256& l = (pos & 1) ? layer[pos - 1] : layer[pos];
+        const uint256& r = (pos & 1) ? layer[pos] : layer[pos + 1 < layer.size() ? pos + 1 : pos];
+        h = Hash(BEGIN(l), END(l), BEGIN(r), END(r));
+        pos >>= 1;
+    }
+}
+
+std::vector<uint256> CMerkleLayerCache::GetBranch(size_t position) const
+{
+    std::vector<uint256> ret;
+    size_t pos = position;
+    for (size_t level = 0; level + 1 < vLayers.size(); level++) {
+        const std::vector<uint256>& layer = vLayers[level];
+        size_t sibling = (pos ^ 1) < layer.size() ? (pos ^ 1) : pos;
+        ret.push_back(layer[sibling]);
+        pos >>= 1;
+    }
+    return ret;
+}
+
+uint256 CMerkleLayerCache::GetRoot() const
+{
+    if (vLayers.empty() || vLayers.back().empty())
+        return uint256();
+    return vLayers.back()[0];
 }
 
 std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position) {
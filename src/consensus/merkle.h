@@ -16,6 +16,30 @@ uint256 ComputeMerkleRoot(const std::vector<uint256>& leaves, bool* mutated = NU
 std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position);
 uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint256>& branch, uint32_t position);
 
+/**
+ * All layers of a merkle tree, kept so that replacing one leaf (the miner's
+ * coinbase between extranonce rolls) only rehashes the path to the root
+ * instead of rebuilding the whole tree. Uses the same duplicate-last-node
+ * rule for odd layers as ComputeMerkleRoot.
+ */
+class CMerkleLayerCache
+{
+private:
+    //! vLayers[0] is the leaves; each following layer holds the pair hashes
+    //! of the one below (without the odd-node padding, which is implicit).
+    std::vector<std::vector<uint256> > vLayers;
+
+public:
+    //! Hash all layers from the given leaves.
+    void Build(const std::vector<uint256>& leaves);
+    //! Replace the leaf at position and rehash its path; returns the new root.
+    uint256 UpdateLeaf(size_t position, const uint256& hash);
+    //! Collect the branch for a position (ComputeMerkleRootFromBranch order).
+    std::vector<uint256> GetBranch(size_t position) const;
+    uint256 GetRoot() const;
+    size_t GetLeafCount() const { return vLayers.empty() ? 0 : vLayers[0].size(); }
+};
+
 /*
  * Compute the Merkle root of the transactions in a block.
  * *mutated is set to true if a duplicated subtree was found.
@@ -0,0 +1,74 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ArenaAllocator.cpp
+ */
+
+#include "ArenaAllocator.h"
+
+using namespace std;
+using namespace dev;
+
+void* StateCacheArena::allocate(size_t _n)
+{
+	lock_guard<mutex> l(x_this);
+
+	// Keep everything maximally aligned; the waste is irrelevant next to the
+	// map nodes this serves.
+	_n = (_n + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+	if (_n > c_chunkSize)
+	{
+		m_oversized.push_back(new char[_n]);
+		return m_oversized.back();
+	}
+	if (m_chunks.empty() || m_used + _n > c_chunkSize)
+	{
+		m_chunks.push_back(new char[c_chunkSize]);
+		m_used = 0;
+	}
+	void* ret = m_chunks.back() + m_used;
+	m_used += _n;
+	return ret;
+}
+
+void StateCacheArena::reset()
+{
+	lock_guard<mutex> l(x_this);
+	for (size_t i = 1; i < m_chunks.size(); ++i)
+		delete[] m_chunks[i];
+	if (m_chunks.size() > 1)
+		m_chunks.resize(1);
+	for (char* p: m_oversized)
+		delete[] p;
+	m_oversized.clear();
+	m_used = 0;
+}
+
+void StateCacheArena::releaseRetainedChunk()
+{
+	lock_guard<mutex> l(x_this);
+	for (char* p: m_chunks)
+		delete[] p;
+	m_chunks.clear();
+	m_used = 0;
+}
+
+StateCacheArena& StateCacheArena::global()
+{
+	static StateCacheArena s_arena;
+	return s_arena;
+}
@@ -0,0 +1,90 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ArenaAllocator.h
+ * Bump-pointer arena backing the state overlay caches.
+ *
+ * Trie nodes churn through the overlay as small short-lived heap blocks
+ * (map nodes, node RLP strings); a contract-heavy block makes hundreds of
+ * thousands of such allocations that are all dead once the overlay commits,
+ * fragmenting the heap. The arena hands them out from large chunks instead
+ * and gives the memory back in one piece when the embedder recycles it at a
+ * block boundary (once every overlay is empty).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dev
+{
+
+class StateCacheArena
+{
+public:
+	StateCacheArena() = default;
+	StateCacheArena(StateCacheArena const&) = delete;
+	StateCacheArena& operator=(StateCacheArena const&) = delete;
+	~StateCacheArena() { reset(); releaseRetainedChunk(); }
+
+	/// Carve _n bytes out of the current chunk; never freed individually.
+	void* allocate(size_t _n);
+
+	/// Drop everything allocated so far. The first chunk is retained for
+	/// reuse. Only valid once no container node allocated from the arena is
+	/// still alive - in practice, after the overlays have committed or
+	/// rolled back at a block boundary.
+	void reset();
+
+	/// The arena behind the global state overlays.
+	static StateCacheArena& global();
+
+private:
+	void releaseRetainedChunk();
+
+	static const size_t c_chunkSize = 1024 * 1024;
+
+	std::vector<char*> m_chunks;		///< Chunks of c_chunkSize; bump-allocated front to back.
+	std::vector<char*> m_oversized;	///< Allocations too big for a chunk; one block each.
+	size_t m_used = 0;				///< Bytes used in m_chunks.back().
+	std::mutex x_this;
+};
+
+/// Minimal std allocator handing out memory from the global StateCacheArena.
+/// deallocate() is a no-op: memory comes back via StateCacheArena::reset().
+template <class T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	ArenaAllocator() noexcept {}
+	template <class U> ArenaAllocator(ArenaAllocator<U> const&) noexcept {}
+
+	T* allocate(size_t _n) { return static_cast<T*>(StateCacheArena::global().allocate(_n * sizeof(T))); }
+	void deallocate(T*, size_t) noexcept {}
+};
+
+template <class T, class U> bool operator==(ArenaAllocator<T> const&, ArenaAllocator<U> const&) noexcept { return true; }
+template <class T, class U> bool operator!=(ArenaAllocator<T> const&, ArenaAllocator<U> const&) noexcept { return false; }
+
+/// std::string layout with arena-backed storage.
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+}
@@ -38,7 +38,7 @@ std::unordered_map<h256, std::string> MemoryDB::get() const
 	std::unordered_map<h256, std::string> ret;
 	for (auto const& i: m_main)
 		if (!m_enforceRefs || i.second.second > 0)
-			ret.insert(make_pair(i.first, i.second.first));
+			ret.insert(make_pair(i.first, std::string(i.second.first.data(), i.second.first.size())));
 	return ret;
 }
 
@@ -64,7 +64,7 @@ std::string MemoryDB::lookup(h256 const& _h) const
 	if (it != m_main.end())
 	{
 		if (!m_enforceRefs || it->second.second > 0)
-			return it->second.first;
+			return std::string(it->second.first.data(), it->second.first.size());
 		else
 			cwarn << "Lookup required for value with refcount == 0. This is probably a critical trie issue" << _h;
 	}
@@ -90,11 +90,11 @@ void MemoryDB::insert(h256 const& _h, bytesConstRef _v)
 	auto it = m_main.find(_h);
 	if (it != m_main.end())
 	{
-		it->second.first = _v.toString();
+		it->second.first.assign(reinterpret_cast<char const*>(_v.data()), _v.size());
 		it->second.second++;
 	}
 	else
-		m_main[_h] = make_pair(_v.toString(), 1);
+		m_main[_h] = make_pair(ArenaString(reinterpret_cast<char const*>(_v.data()), _v.size()), 1);
 #if ETH_PARANOIA
 	dbdebug << "INST" << _h << "=>" << m_main[_h].second;
 #endif
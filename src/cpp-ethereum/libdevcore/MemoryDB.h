@@ -27,6 +27,7 @@
 #include "FixedHash.h"
 #include "Log.h"
 #include "RLP.h"
+#include "ArenaAllocator.h"
 #include "SHA3.h"
 
 namespace dev
@@ -43,6 +44,13 @@ class MemoryDB
 	friend class EnforceRefs;
 
 public:
+	/// Node payloads and the map nodes themselves come from the global
+	/// StateCacheArena: they only live until the overlay commits or rolls
+	/// back, so the embedder can recycle the arena wholesale at block
+	/// boundaries instead of freeing every trie node individually.
+	using MainMap = std::unordered_map<h256, std::pair<ArenaString, unsigned>, std::hash<h256>, std::equal_to<h256>,
+		ArenaAllocator<std::pair<const h256, std::pair<ArenaString, unsigned>>>>;
+
 	MemoryDB() {}
 	MemoryDB(MemoryDB const& _c) { operator=(_c); }
 
@@ -67,7 +75,7 @@ protected:
 #if DEV_GUARDED_DB
 	mutable SharedMutex x_this;
 #endif
-	std::unordered_map<h256, std::pair<std::string, unsigned>> m_main;
+	MainMap m_main;
 	std::unordered_map<h256, std::pair<bytes, bool>> m_aux;
 
 	mutable bool m_enforceRefs = false;
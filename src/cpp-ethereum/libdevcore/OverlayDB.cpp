@@ -20,9 +20,13 @@
  */
 #if !defined(ETH_EMSCRIPTEN)
 
+#include <atomic>
+#include <list>
 #include <thread>
+#include <unordered_map>
 #include <libdevcore/db.h>
 #include <libdevcore/Common.h>
+#include <libdevcore/Guards.h>
 #include "OverlayDB.h"
 using namespace std;
 using namespace dev;
@@ -32,6 +36,109 @@ namespace dev
 
 h256 const EmptyTrie = sha3(rlp(""));
 
+namespace
+{
+
+// Shared LRU over the backing LevelDB, keyed by node hash. Both trie nodes
+// and contract code are keyed by the sha3 of their payload, so an entry can
+// never hold stale data and the cache is safe to share across databases.
+struct NodeCache
+{
+	Mutex x_this;
+	list<h256> lru;	// most recently used at the front
+	unordered_map<h256, pair<string, list<h256>::iterator>> entries;
+	size_t capacity = 0;
+	size_t memory = 0;
+	atomic<uint64_t> hits{0};
+	atomic<uint64_t> misses{0};
+};
+
+NodeCache& nodeCache()
+{
+	static NodeCache s_cache;
+	return s_cache;
+}
+
+void nodeCacheTrim(NodeCache& _c)
+{
+	while (_c.memory > _c.capacity && !_c.lru.empty())
+	{
+		auto it = _c.entries.find(_c.lru.back());
+		_c.memory -= sizeof(h256) + it->second.first.size();
+		_c.entries.erase(it);
+		_c.lru.pop_back();
+	}
+}
+
+bool nodeCacheLookup(h256 const& _h, string& o_value)
+{
+	NodeCache& c = nodeCache();
+	if (!c.capacity)
+		return false;
+	Guard l(c.x_this);
+	auto it = c.entries.find(_h);
+	if (it == c.entries.end())
+	{
+		c.misses++;
+		return false;
+	}
+	c.hits++;
+	c.lru.splice(c.lru.begin(), c.lru, it->second.second);
+	o_value = it->second.first;
+	return true;
+}
+
+void nodeCacheInsert(h256 const& _h, string const& _value)
+{
+	NodeCache& c = nodeCache();
+	if (!c.capacity)
+		return;
+	Guard l(c.x_this);
+	if (c.entries.count(_h))
+		return;
+	c.lru.push_front(_h);
+	c.entries[_h] = make_pair(_value, c.lru.begin());
+	c.memory += sizeof(h256) + _value.size();
+	nodeCacheTrim(c);
+}
+
+void nodeCacheErase(h256 const& _h)
+{
+	NodeCache& c = nodeCache();
+	if (!c.capacity)
+		return;
+	Guard l(c.x_this);
+	auto it = c.entries.find(_h);
+	if (it == c.entries.end())
+		return;
+	c.memory -= sizeof(h256) + it->second.first.size();
+	c.lru.erase(it->second.second);
+	c.entries.erase(it);
+}
+
+}
+
+void setOverlayDBCacheSize(size_t _capacity)
+{
+	NodeCache& c = nodeCache();
+	Guard l(c.x_this);
+	c.capacity = _capacity;
+	nodeCacheTrim(c);
+}
+
+OverlayDBCacheStats overlayDBCacheStats()
+{
+	NodeCache& c = nodeCache();
+	OverlayDBCacheStats stats;
+	Guard l(c.x_this);
+	stats.hits = c.hits;
+	stats.misses = c.misses;
+	stats.entries = c.entries.size();
+	stats.memory = c.memory;
+	stats.capacity = c.capacity;
+	return stats;
+}
+
 OverlayDB::~OverlayDB()
 {
 	if (m_db.use_count() == 1 && m_db.get())
@@ -57,7 +164,12 @@ void OverlayDB::commit()
 			for (auto const& i: m_main)
 			{
 				if (i.second.second)
+				{
 					batch.Put(ldb::Slice((char const*)i.first.data(), i.first.size), ldb::Slice(i.second.first.data(), i.second.first.size()));
+					// write through: freshly committed nodes are the ones the
+					// next block is most likely to read back
+					nodeCacheInsert(i.first, string(i.second.first.data(), i.second.first.size()));
+				}
 //				cnote << i.first << "#" << m_main[i.first].second;
 			}
 			for (auto const& i: m_aux)
@@ -121,7 +233,13 @@ std::string OverlayDB::lookup(h256 const& _h) const
 {
 	std::string ret = MemoryDB::lookup(_h);
 	if (ret.empty() && m_db)
+	{
+		if (nodeCacheLookup(_h, ret))
+			return ret;
 		m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
+		if (!ret.empty())
+			nodeCacheInsert(_h, ret);
+	}
 	return ret;
 }
 
@@ -131,7 +249,13 @@ bool OverlayDB::exists(h256 const& _h) const
 		return true;
 	std::string ret;
 	if (m_db)
+	{
+		if (nodeCacheLookup(_h, ret))
+			return true;
 		m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
+		if (!ret.empty())
+			nodeCacheInsert(_h, ret);
+	}
 	return !ret.empty();
 }
 
@@ -159,6 +283,7 @@ bool OverlayDB::deepkill(h256 const& _h)
 {
 	// kill in memoryDB
 	kill(_h);
+	nodeCacheErase(_h);
 
 	//kill in overlayDB
 	ldb::Status s = m_db->Delete(m_writeOptions, ldb::Slice((char const*)_h.data(), 32));
@@ -30,6 +30,23 @@
 namespace dev
 {
 
+/// Statistics for the shared node read cache backing every OverlayDB.
+struct OverlayDBCacheStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	size_t entries = 0;
+	size_t memory = 0;
+	size_t capacity = 0;
+};
+
+/// Set the capacity in bytes of the shared node read cache; 0 disables it.
+/// Trie nodes and contract code are content-addressed, so cached entries
+/// never go stale and the cache can safely be shared by all instances.
+void setOverlayDBCacheSize(size_t _capacity);
+
+OverlayDBCacheStats overlayDBCacheStats();
+
 class OverlayDB: public MemoryDB
 {
 public:
@@ -71,6 +71,16 @@ public:
 	bytes const& memory() const { return m_mem; }
 	u256s stack() const { assert(m_stack <= m_SP + 1); return u256s(m_stack, m_SP + 1); };
 
+	// Analysis artifacts shared across calls through the code cache in
+	// VMOpt.cpp, keyed by code hash. When set, m_code aliases
+	// m_analysis->codeSpace: the transformed code is never written after
+	// optimize(), so every VM instance can execute the shared copy.
+	struct CodeAnalysis
+	{
+		bytes codeSpace;
+		std::vector<uint64_t> jumpDests;
+	};
+
 private:
 
 	u256* io_gas = 0;
@@ -100,6 +110,7 @@ private:
 	// space for code and pointer to data
 	bytes m_codeSpace;
 	byte* m_code = nullptr;
+	std::shared_ptr<CodeAnalysis const> m_analysis;
 
 	// space for stack and pointer to data
 	u256 m_stackSpace[1025];
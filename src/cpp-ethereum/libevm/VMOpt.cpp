@@ -16,13 +16,19 @@
 */
 
 
+#include <libdevcore/Guards.h>
 #include <libethereum/ExtVM.h>
 #include "VMConfig.h"
 #include "VM.h"
+
+#include <list>
+#include <unordered_map>
+
 using namespace std;
 using namespace dev;
 using namespace dev::eth;
 
+
 void VM::reportStackUse()
 {
 	static intptr_t p = 0;
@@ -61,8 +67,39 @@ void VM::copyCode(int _extraBytes)
 	m_code = m_codeSpace.data();
 }
 
+// LRU cache of per-code analysis (scrubbed code copy plus JUMPDEST table) so
+// contracts called in every block stop paying the O(code size) passes below
+// on each call. Keyed by code hash; a handful of MB worst case.
+// NOTE: only valid while the analysis is independent of the call context -
+// EVM_USE_CONSTANT_POOL writes the per-VM constant pool and would need the
+// pool captured in CodeAnalysis before it could be turned on.
+size_t const c_codeCacheEntries = 64;
+static Mutex x_codeCache;
+static list<h256> s_codeCacheRecency;
+static unordered_map<h256, pair<shared_ptr<VM::CodeAnalysis const>, list<h256>::iterator>> s_codeCache;
+
 void VM::optimize()
 {
+	if (m_ext->codeHash)
+	{
+		DEV_GUARDED(x_codeCache)
+		{
+			auto it = s_codeCache.find(m_ext->codeHash);
+			if (it != s_codeCache.end())
+			{
+				s_codeCacheRecency.splice(s_codeCacheRecency.begin(), s_codeCacheRecency, it->second.second);
+				m_analysis = it->second.first;
+			}
+		}
+		if (m_analysis)
+		{
+			// Nothing writes the code after analysis, so execute the shared copy.
+			m_code = const_cast<byte*>(m_analysis->codeSpace.data());
+			m_jumpDests = m_analysis->jumpDests;
+			return;
+		}
+	}
+
 	copyCode(33);
 
 	size_t const nBytes = m_ext->code.size();
@@ -248,7 +285,25 @@ void VM::optimize()
 		
 	}
 	TRACE_STR(1, "Finished optimizations")
-#endif	
+#endif
+
+	if (m_ext->codeHash)
+	{
+		auto analysis = make_shared<CodeAnalysis>();
+		analysis->codeSpace = m_codeSpace;
+		analysis->jumpDests = m_jumpDests;
+		DEV_GUARDED(x_codeCache)
+			if (!s_codeCache.count(m_ext->codeHash))
+			{
+				s_codeCacheRecency.push_front(m_ext->codeHash);
+				s_codeCache[m_ext->codeHash] = make_pair(analysis, s_codeCacheRecency.begin());
+				while (s_codeCache.size() > c_codeCacheEntries)
+				{
+					s_codeCache.erase(s_codeCacheRecency.back());
+					s_codeCacheRecency.pop_back();
+				}
+			}
+	}
 }
 
 
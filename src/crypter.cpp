@@ -212,6 +212,7 @@ bool CCryptoKeyStore::Lock()
     {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
+        mapDecryptedKeys.clear();
     }
 
     NotifyStatusChanged(this);
@@ -290,6 +291,7 @@ bool CCryptoKeyStore::AddCryptedKey(const CPubKey& vchPubKey, const std::vector<
         return false;
 
     mapCryptedKeys[vchPubKey.GetID()] = make_pair(vchPubKey, vchCryptedSecret);
+    mapDecryptedKeys.erase(vchPubKey.GetID());
     ImplicitlyLearnRelatedKeyScripts(vchPubKey);
     return true;
 }
@@ -309,6 +311,14 @@ bool CCryptoKeyStore::GetKey(const CKeyID& address, CKey& keyOut) const
     if (!IsCrypted())
         return CBasicKeyStore::GetKey(address, keyOut);
 
+    // Served from the decrypted-key cache while unlocked; signing a batch
+    // of inputs then decrypts each key once instead of once per signature.
+    KeyMap::const_iterator di = mapDecryptedKeys.find(address);
+    if (di != mapDecryptedKeys.end()) {
+        keyOut = (*di).second;
+        return true;
+    }
+
     CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
     if (mi != mapCryptedKeys.end()) {
         const CPubKey& vchPubKey = (*mi).second.first;
@@ -319,6 +329,7 @@ bool CCryptoKeyStore::GetKey(const CKeyID& address, CKey& keyOut) const
         if (vchSecret.size() != 32)
             return false;
         keyOut.Set(vchSecret.begin(), vchSecret.end(), vchPubKey.IsCompressed());
+        mapDecryptedKeys[address] = keyOut;
         return true;
     }
     return false;
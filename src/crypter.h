@@ -123,6 +123,11 @@ class CCryptoKeyStore : public CBasicKeyStore
 private:
     CryptedKeyMap mapCryptedKeys;
 
+    //! Keys already decrypted while the wallet is unlocked, so bulk signing
+    //! doesn't redo the AES decryption per signature. Wiped on Lock();
+    //! the CKey secure allocator cleanses the secrets on erase.
+    mutable KeyMap mapDecryptedKeys;
+
     CKeyingMaterial vMasterKey;
 
     //! if fUseCrypto is true, mapKeys must be empty
@@ -0,0 +1,144 @@
+// Copyright (c) 2018 The Luxcore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/cubehash_simd.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__))
+
+#include "crypto/sph_cubehash.h"
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#define CUBEHASH_AVX2 __attribute__((target("avx2")))
+
+namespace {
+
+/* Same IV as sph_cubehash512_init (CubeHash16/32-512). */
+const uint32_t IV512[32] __attribute__((aligned(32))) = {
+    0x2AEA2A61, 0x50F494D4, 0x2D538B8B, 0x4167D83E,
+    0x3FEE2313, 0xC701CF8C, 0xCC39968E, 0x50AC5695,
+    0x4D42C787, 0xA647A8B3, 0x97CF0BEF, 0x825B4537,
+    0xEEF864D2, 0xF22090C4, 0xD0E5CD33, 0xA23911AE,
+    0xFCD398D9, 0x148FE485, 0x1B017BEF, 0xB6444532,
+    0x6A536159, 0x2FF5781C, 0x91FA7934, 0x0DBADEA9,
+    0xD65C8A2B, 0xA5A70E75, 0xB1C62456, 0xBC796576,
+    0x1921C8F7, 0xE7989AF1, 0x7795D246, 0xD43E3B44
+};
+
+CUBEHASH_AVX2 inline __m256i Rotl(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+/* One canonical CubeHash round. The state is y0..y3 with y0 holding words
+ * 0-7, y1 words 8-15, y2 words 16-23 and y3 words 24-31, so each of the
+ * spec's "swap words differing in bit b" steps is either a register swap
+ * (bit 3), a cross-lane half swap (bit 2) or an in-lane shuffle (bits 1/0). */
+CUBEHASH_AVX2 inline void Round(__m256i& y0, __m256i& y1, __m256i& y2, __m256i& y3)
+{
+    __m256i t;
+    y2 = _mm256_add_epi32(y2, y0);
+    y3 = _mm256_add_epi32(y3, y1);
+    y0 = Rotl(y0, 7);
+    y1 = Rotl(y1, 7);
+    t = y0; y0 = y1; y1 = t;                      /* swap on bit 3 */
+    y0 = _mm256_xor_si256(y0, y2);
+    y1 = _mm256_xor_si256(y1, y3);
+    y2 = _mm256_shuffle_epi32(y2, 0x4e);          /* swap on bit 1 */
+    y3 = _mm256_shuffle_epi32(y3, 0x4e);
+    y2 = _mm256_add_epi32(y2, y0);
+    y3 = _mm256_add_epi32(y3, y1);
+    y0 = Rotl(y0, 11);
+    y1 = Rotl(y1, 11);
+    y0 = _mm256_permute4x64_epi64(y0, 0x4e);      /* swap on bit 2 */
+    y1 = _mm256_permute4x64_epi64(y1, 0x4e);
+    y0 = _mm256_xor_si256(y0, y2);
+    y1 = _mm256_xor_si256(y1, y3);
+    y2 = _mm256_shuffle_epi32(y2, 0xb1);          /* swap on bit 0 */
+    y3 = _mm256_shuffle_epi32(y3, 0xb1);
+}
+
+CUBEHASH_AVX2 inline void SixteenRounds(__m256i& y0, __m256i& y1, __m256i& y2, __m256i& y3)
+{
+    for (int i = 0; i < 16; i++)
+        Round(y0, y1, y2, y3);
+}
+
+CUBEHASH_AVX2 void Hash512(const unsigned char* data, size_t len, unsigned char* out64)
+{
+    __m256i y0 = _mm256_load_si256((const __m256i*)(IV512 + 0));
+    __m256i y1 = _mm256_load_si256((const __m256i*)(IV512 + 8));
+    __m256i y2 = _mm256_load_si256((const __m256i*)(IV512 + 16));
+    __m256i y3 = _mm256_load_si256((const __m256i*)(IV512 + 24));
+
+    /* A 32-byte message block is xored into words 0-7, i.e. all of y0. */
+    while (len >= 32) {
+        y0 = _mm256_xor_si256(y0, _mm256_loadu_si256((const __m256i*)data));
+        SixteenRounds(y0, y1, y2, y3);
+        data += 32;
+        len -= 32;
+    }
+
+    unsigned char buf[32];
+    memcpy(buf, data, len);
+    buf[len] = 0x80;
+    memset(buf + len + 1, 0, 32 - len - 1);
+    y0 = _mm256_xor_si256(y0, _mm256_loadu_si256((const __m256i*)buf));
+    SixteenRounds(y0, y1, y2, y3);
+
+    /* Finalization: flip the last state bit, then ten more block rounds. */
+    y3 = _mm256_xor_si256(y3, _mm256_set_epi32(1, 0, 0, 0, 0, 0, 0, 0));
+    for (int i = 0; i < 10; i++)
+        SixteenRounds(y0, y1, y2, y3);
+
+    _mm256_storeu_si256((__m256i*)(out64 + 0), y0);
+    _mm256_storeu_si256((__m256i*)(out64 + 32), y1);
+}
+
+/* Differential check against the sph reference covering the empty message,
+ * a partial block, an exact block boundary and a multi-block message. It
+ * runs once before the AVX2 path can be selected, so on a machine where
+ * this kernel miscompiles the node degrades to the scalar code instead of
+ * hashing blocks differently from the rest of the network. */
+CUBEHASH_AVX2 bool SelfTest()
+{
+    static const size_t vLen[] = {0, 17, 32, 64, 200};
+    unsigned char data[200];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (unsigned char)(i * 251 + 17);
+    for (size_t n = 0; n < sizeof(vLen) / sizeof(vLen[0]); n++) {
+        unsigned char hashAvx[64], hashRef[64];
+        Hash512(data, vLen[n], hashAvx);
+        sph_cubehash512_context ctx;
+        sph_cubehash512_init(&ctx);
+        sph_cubehash512(&ctx, data, vLen[n]);
+        sph_cubehash512_close(&ctx, hashRef);
+        if (memcmp(hashAvx, hashRef, 64) != 0)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool CubeHash512SIMD(const void* data, size_t len, void* out64)
+{
+    static const bool fUseAVX2 = __builtin_cpu_supports("avx2") && SelfTest();
+    if (!fUseAVX2)
+        return false;
+    Hash512((const unsigned char*)data, len, (unsigned char*)out64);
+    return true;
+}
+
+#else
+
+bool CubeHash512SIMD(const void* data, size_t len, void* out64)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,23 @@
+// Copyright (c) 2018 The Luxcore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_CUBEHASH_SIMD_H
+#define BITCOIN_CRYPTO_CUBEHASH_SIMD_H
+
+#include <stdlib.h>
+
+/** Vectorized CubeHash16/32-512, bit-identical to sph_cubehash512.
+ *
+ *  CubeHash keeps its whole 1024-bit state live across every round, which
+ *  makes the plain-C sph implementation the hottest stage of the PHI1612
+ *  and PHI2 header chains. This variant holds the state in four AVX2
+ *  registers and performs the ten round steps with register-wide shuffles.
+ *
+ *  Returns false without touching the output when the running CPU lacks
+ *  AVX2; callers fall back to the sph code path. Writes the 64-byte digest
+ *  to out64 and returns true otherwise.
+ */
+bool CubeHash512SIMD(const void* data, size_t len, void* out64);
+
+#endif // BITCOIN_CRYPTO_CUBEHASH_SIMD_H
@@ -0,0 +1,24 @@
+// Copyright (c) 2018 The Luxcore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_GOST_SIMD_H
+#define BITCOIN_CRYPTO_GOST_SIMD_H
+
+#include <stdlib.h>
+
+/** Vectorized GOST R 34.11-2012 (Streebog) 512, bit-identical to sph_gost512.
+ *
+ *  The table-driven substitution step has to stay scalar (64 lookups per
+ *  round), but each compression also performs two dozen 512-bit xors and a
+ *  state copy per round; this variant keeps the working state in AVX2
+ *  registers, does those in two ops each and ping-pongs between buffers so
+ *  the round function never copies the state.
+ *
+ *  Returns false without touching the output when the running CPU lacks
+ *  AVX2; callers fall back to the sph code path. Writes the 64-byte digest
+ *  to out64 and returns true otherwise.
+ */
+bool Gost512SIMD(const void* data, size_t len, void* out64);
+
+#endif // BITCOIN_CRYPTO_GOST_SIMD_H
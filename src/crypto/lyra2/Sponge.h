@@ -92,6 +92,21 @@ void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint
 //---- Misc
 void printArray(unsigned char *array, unsigned int size, char *name);
 
+//---- Runtime dispatch (Sponge_avx2.c)
+//The sponge operations Lyra2 spends its time in, selectable at runtime so a
+//vectorized implementation can be used when the CPU supports it. Results must
+//be bit-exact with the scalar functions above: they feed consensus hashing.
+typedef struct {
+    void (*absorbBlock)(uint64_t *state, const uint64_t *in);
+    void (*absorbBlockBlake2Safe)(uint64_t *state, const uint64_t *in);
+    void (*reducedSqueezeRow0)(uint64_t *state, uint64_t *rowOut, uint64_t nCols);
+    void (*reducedDuplexRow1)(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols);
+    void (*reducedDuplexRowSetup)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+    void (*reducedDuplexRow)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+} lyra2_sponge_ops;
+
+const lyra2_sponge_ops *lyra2_sponge_get_ops(void);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 
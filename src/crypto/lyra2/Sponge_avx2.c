@@ -0,0 +1,320 @@
+/**
+ * AVX2 implementation of Blake2b's internal permutation in the form of a
+ * sponge, plus runtime dispatch between it and the scalar code in Sponge.c.
+ *
+ * The sponge state is kept in four 256-bit registers of four lanes each
+ * (v[0..3], v[4..7], v[8..11], v[12..15]), so the column step of ROUND_LYRA
+ * is four G functions evaluated lane-parallel and the diagonal step is the
+ * same after rotating the b/c/d registers by one, two and three lanes.
+ * Every function here must remain bit-exact with its scalar counterpart:
+ * the output feeds Phi2_hash, which is consensus critical.
+ *
+ * This software is hereby placed in the public domain.
+ */
+#include <string.h>
+#include "Sponge.h"
+#include "Lyra2.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__))
+#define LYRA2_HAVE_AVX2 1
+
+#include <immintrin.h>
+
+#define SPONGE_AVX2 __attribute__((target("avx2")))
+
+/*64-bit rotations by 32, 24 and 16 are byte moves; by 63 is shift+add*/
+SPONGE_AVX2 static inline __m256i rotr64_32(__m256i x) {
+    return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+SPONGE_AVX2 static inline __m256i rotr64_24(__m256i x) {
+    return _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+}
+
+SPONGE_AVX2 static inline __m256i rotr64_16(__m256i x) {
+    return _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+}
+
+SPONGE_AVX2 static inline __m256i rotr64_63(__m256i x) {
+    return _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x));
+}
+
+/*Blake2b's G function over four lanes at once*/
+#define G4(a, b, c, d) \
+  do { \
+    a = _mm256_add_epi64(a, b); d = rotr64_32(_mm256_xor_si256(d, a)); \
+    c = _mm256_add_epi64(c, d); b = rotr64_24(_mm256_xor_si256(b, c)); \
+    a = _mm256_add_epi64(a, b); d = rotr64_16(_mm256_xor_si256(d, a)); \
+    c = _mm256_add_epi64(c, d); b = rotr64_63(_mm256_xor_si256(b, c)); \
+  } while (0)
+
+/*One ROUND_LYRA: column step, rotate into diagonals, diagonal step, undo*/
+#define ROUND_LYRA_AVX2(s0, s1, s2, s3) \
+  do { \
+    G4(s0, s1, s2, s3); \
+    s1 = _mm256_permute4x64_epi64(s1, _MM_SHUFFLE(0, 3, 2, 1)); \
+    s2 = _mm256_permute4x64_epi64(s2, _MM_SHUFFLE(1, 0, 3, 2)); \
+    s3 = _mm256_permute4x64_epi64(s3, _MM_SHUFFLE(2, 1, 0, 3)); \
+    G4(s0, s1, s2, s3); \
+    s1 = _mm256_permute4x64_epi64(s1, _MM_SHUFFLE(2, 1, 0, 3)); \
+    s2 = _mm256_permute4x64_epi64(s2, _MM_SHUFFLE(1, 0, 3, 2)); \
+    s3 = _mm256_permute4x64_epi64(s3, _MM_SHUFFLE(0, 3, 2, 1)); \
+  } while (0)
+
+#define LOAD_STATE(state, s0, s1, s2, s3) \
+  do { \
+    s0 = _mm256_loadu_si256((const __m256i*)&(state)[0]); \
+    s1 = _mm256_loadu_si256((const __m256i*)&(state)[4]); \
+    s2 = _mm256_loadu_si256((const __m256i*)&(state)[8]); \
+    s3 = _mm256_loadu_si256((const __m256i*)&(state)[12]); \
+  } while (0)
+
+#define STORE_STATE(state, s0, s1, s2, s3) \
+  do { \
+    _mm256_storeu_si256((__m256i*)&(state)[0], s0); \
+    _mm256_storeu_si256((__m256i*)&(state)[4], s1); \
+    _mm256_storeu_si256((__m256i*)&(state)[8], s2); \
+    _mm256_storeu_si256((__m256i*)&(state)[12], s3); \
+  } while (0)
+
+SPONGE_AVX2 static void absorbBlock_avx2(uint64_t *state, const uint64_t *in) {
+    __m256i s0, s1, s2, s3;
+    int i;
+    LOAD_STATE(state, s0, s1, s2, s3);
+    s0 = _mm256_xor_si256(s0, _mm256_loadu_si256((const __m256i*)&in[0]));
+    s1 = _mm256_xor_si256(s1, _mm256_loadu_si256((const __m256i*)&in[4]));
+    s2 = _mm256_xor_si256(s2, _mm256_loadu_si256((const __m256i*)&in[8]));
+    for (i = 0; i < 12; i++)
+        ROUND_LYRA_AVX2(s0, s1, s2, s3);
+    STORE_STATE(state, s0, s1, s2, s3);
+}
+
+SPONGE_AVX2 static void absorbBlockBlake2Safe_avx2(uint64_t *state, const uint64_t *in) {
+    __m256i s0, s1, s2, s3;
+    int i;
+    LOAD_STATE(state, s0, s1, s2, s3);
+    s0 = _mm256_xor_si256(s0, _mm256_loadu_si256((const __m256i*)&in[0]));
+    s1 = _mm256_xor_si256(s1, _mm256_loadu_si256((const __m256i*)&in[4]));
+    for (i = 0; i < 12; i++)
+        ROUND_LYRA_AVX2(s0, s1, s2, s3);
+    STORE_STATE(state, s0, s1, s2, s3);
+}
+
+SPONGE_AVX2 static void reducedSqueezeRow0_avx2(uint64_t *state, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWord = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    __m256i s0, s1, s2, s3;
+    uint64_t i;
+    LOAD_STATE(state, s0, s1, s2, s3);
+    for (i = 0; i < nCols; i++) {
+        _mm256_storeu_si256((__m256i*)&ptrWord[0], s0);
+        _mm256_storeu_si256((__m256i*)&ptrWord[4], s1);
+        _mm256_storeu_si256((__m256i*)&ptrWord[8], s2);
+        ptrWord -= BLOCK_LEN_INT64;
+        ROUND_LYRA_AVX2(s0, s1, s2, s3);
+    }
+    STORE_STATE(state, s0, s1, s2, s3);
+}
+
+SPONGE_AVX2 static void reducedDuplexRow1_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    __m256i s0, s1, s2, s3, in0, in1, in2;
+    uint64_t i;
+    LOAD_STATE(state, s0, s1, s2, s3);
+    for (i = 0; i < nCols; i++) {
+        in0 = _mm256_loadu_si256((const __m256i*)&ptrWordIn[0]);
+        in1 = _mm256_loadu_si256((const __m256i*)&ptrWordIn[4]);
+        in2 = _mm256_loadu_si256((const __m256i*)&ptrWordIn[8]);
+        s0 = _mm256_xor_si256(s0, in0);
+        s1 = _mm256_xor_si256(s1, in1);
+        s2 = _mm256_xor_si256(s2, in2);
+        ROUND_LYRA_AVX2(s0, s1, s2, s3);
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[0], _mm256_xor_si256(in0, s0));
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[4], _mm256_xor_si256(in1, s1));
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[8], _mm256_xor_si256(in2, s2));
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    STORE_STATE(state, s0, s1, s2, s3);
+}
+
+/* The rotW feedback XORs state word (i+11) mod 12 into M[row*][i]. With the
+ * rate in registers a=[0..3], b=[4..7], c=[8..11], the rotated vectors are
+ * [11,0,1,2], [3,4,5,6] and [7,8,9,10]: rotate each register right by one
+ * lane and pull the crossing word in from the neighbour via a blend. */
+#define ROTW_FEEDBACK(ptr, a, b, c) \
+  do { \
+    __m256i pa = _mm256_permute4x64_epi64(a, _MM_SHUFFLE(2, 1, 0, 3)); \
+    __m256i pb = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 3)); \
+    __m256i pc = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(2, 1, 0, 3)); \
+    _mm256_storeu_si256((__m256i*)&(ptr)[0], _mm256_xor_si256( \
+        _mm256_loadu_si256((const __m256i*)&(ptr)[0]), _mm256_blend_epi32(pa, pc, 0x03))); \
+    _mm256_storeu_si256((__m256i*)&(ptr)[4], _mm256_xor_si256( \
+        _mm256_loadu_si256((const __m256i*)&(ptr)[4]), _mm256_blend_epi32(pb, pa, 0x03))); \
+    _mm256_storeu_si256((__m256i*)&(ptr)[8], _mm256_xor_si256( \
+        _mm256_loadu_si256((const __m256i*)&(ptr)[8]), _mm256_blend_epi32(pc, pb, 0x03))); \
+  } while (0)
+
+SPONGE_AVX2 static void reducedDuplexRowSetup_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordInOut = rowInOut;
+    uint64_t *ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    __m256i s0, s1, s2, s3, in0, in1, in2;
+    uint64_t i;
+    LOAD_STATE(state, s0, s1, s2, s3);
+    for (i = 0; i < nCols; i++) {
+        in0 = _mm256_loadu_si256((const __m256i*)&ptrWordIn[0]);
+        in1 = _mm256_loadu_si256((const __m256i*)&ptrWordIn[4]);
+        in2 = _mm256_loadu_si256((const __m256i*)&ptrWordIn[8]);
+        s0 = _mm256_xor_si256(s0, _mm256_add_epi64(in0, _mm256_loadu_si256((const __m256i*)&ptrWordInOut[0])));
+        s1 = _mm256_xor_si256(s1, _mm256_add_epi64(in1, _mm256_loadu_si256((const __m256i*)&ptrWordInOut[4])));
+        s2 = _mm256_xor_si256(s2, _mm256_add_epi64(in2, _mm256_loadu_si256((const __m256i*)&ptrWordInOut[8])));
+        ROUND_LYRA_AVX2(s0, s1, s2, s3);
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[0], _mm256_xor_si256(in0, s0));
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[4], _mm256_xor_si256(in1, s1));
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[8], _mm256_xor_si256(in2, s2));
+        ROTW_FEEDBACK(ptrWordInOut, s0, s1, s2);
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    STORE_STATE(state, s0, s1, s2, s3);
+}
+
+SPONGE_AVX2 static void reducedDuplexRow_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordInOut = rowInOut;
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordOut = rowOut;
+    __m256i s0, s1, s2, s3;
+    uint64_t i;
+    LOAD_STATE(state, s0, s1, s2, s3);
+    for (i = 0; i < nCols; i++) {
+        s0 = _mm256_xor_si256(s0, _mm256_add_epi64(
+            _mm256_loadu_si256((const __m256i*)&ptrWordIn[0]),
+            _mm256_loadu_si256((const __m256i*)&ptrWordInOut[0])));
+        s1 = _mm256_xor_si256(s1, _mm256_add_epi64(
+            _mm256_loadu_si256((const __m256i*)&ptrWordIn[4]),
+            _mm256_loadu_si256((const __m256i*)&ptrWordInOut[4])));
+        s2 = _mm256_xor_si256(s2, _mm256_add_epi64(
+            _mm256_loadu_si256((const __m256i*)&ptrWordIn[8]),
+            _mm256_loadu_si256((const __m256i*)&ptrWordInOut[8])));
+        ROUND_LYRA_AVX2(s0, s1, s2, s3);
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[0], _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i*)&ptrWordOut[0]), s0));
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[4], _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i*)&ptrWordOut[4]), s1));
+        _mm256_storeu_si256((__m256i*)&ptrWordOut[8], _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i*)&ptrWordOut[8]), s2));
+        ROTW_FEEDBACK(ptrWordInOut, s0, s1, s2);
+        ptrWordOut += BLOCK_LEN_INT64;
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordIn += BLOCK_LEN_INT64;
+    }
+    STORE_STATE(state, s0, s1, s2, s3);
+}
+
+static const lyra2_sponge_ops avx2_ops = {
+    absorbBlock_avx2,
+    absorbBlockBlake2Safe_avx2,
+    reducedSqueezeRow0_avx2,
+    reducedDuplexRow1_avx2,
+    reducedDuplexRowSetup_avx2,
+    reducedDuplexRow_avx2
+};
+
+/*Differential check of every vectorized op against its scalar counterpart
+  on deterministic pseudo-random data. It runs once before the avx2 table
+  can be selected, so a machine where this code misbehaves (a compiler or
+  target-attribute quirk, say) falls back to the scalar sponge instead of
+  computing different Phi2 hashes than the rest of the network.*/
+static uint64_t self_test_next(uint64_t *seed) {
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *seed;
+}
+
+static int lyra2_sponge_self_test(void) {
+    enum { TEST_COLS = 8, ROW_LEN = TEST_COLS * BLOCK_LEN_INT64 };
+    uint64_t stateA[16], stateB[16];
+    uint64_t inBlock[BLOCK_LEN_INT64];
+    uint64_t rowInA[ROW_LEN], rowInB[ROW_LEN];
+    uint64_t rowIoA[ROW_LEN], rowIoB[ROW_LEN];
+    uint64_t rowOutA[ROW_LEN], rowOutB[ROW_LEN];
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        stateA[i] = stateB[i] = self_test_next(&seed);
+    for (i = 0; i < BLOCK_LEN_INT64; i++)
+        inBlock[i] = self_test_next(&seed);
+    for (i = 0; i < ROW_LEN; i++) {
+        rowInA[i] = rowInB[i] = self_test_next(&seed);
+        rowIoA[i] = rowIoB[i] = self_test_next(&seed);
+        rowOutA[i] = rowOutB[i] = self_test_next(&seed);
+    }
+
+    absorbBlock_avx2(stateA, inBlock);
+    absorbBlock(stateB, inBlock);
+    if (memcmp(stateA, stateB, sizeof(stateA)) != 0)
+        return 0;
+
+    absorbBlockBlake2Safe_avx2(stateA, inBlock);
+    absorbBlockBlake2Safe(stateB, inBlock);
+    if (memcmp(stateA, stateB, sizeof(stateA)) != 0)
+        return 0;
+
+    reducedSqueezeRow0_avx2(stateA, rowOutA, TEST_COLS);
+    reducedSqueezeRow0(stateB, rowOutB, TEST_COLS);
+    if (memcmp(stateA, stateB, sizeof(stateA)) != 0 ||
+        memcmp(rowOutA, rowOutB, sizeof(rowOutA)) != 0)
+        return 0;
+
+    reducedDuplexRow1_avx2(stateA, rowInA, rowOutA, TEST_COLS);
+    reducedDuplexRow1(stateB, rowInB, rowOutB, TEST_COLS);
+    if (memcmp(stateA, stateB, sizeof(stateA)) != 0 ||
+        memcmp(rowOutA, rowOutB, sizeof(rowOutA)) != 0)
+        return 0;
+
+    reducedDuplexRowSetup_avx2(stateA, rowInA, rowIoA, rowOutA, TEST_COLS);
+    reducedDuplexRowSetup(stateB, rowInB, rowIoB, rowOutB, TEST_COLS);
+    if (memcmp(stateA, stateB, sizeof(stateA)) != 0 ||
+        memcmp(rowIoA, rowIoB, sizeof(rowIoA)) != 0 ||
+        memcmp(rowOutA, rowOutB, sizeof(rowOutA)) != 0)
+        return 0;
+
+    reducedDuplexRow_avx2(stateA, rowInA, rowIoA, rowOutA, TEST_COLS);
+    reducedDuplexRow(stateB, rowInB, rowIoB, rowOutB, TEST_COLS);
+    if (memcmp(stateA, stateB, sizeof(stateA)) != 0 ||
+        memcmp(rowIoA, rowIoB, sizeof(rowIoA)) != 0 ||
+        memcmp(rowOutA, rowOutB, sizeof(rowOutA)) != 0)
+        return 0;
+
+    return 1;
+}
+
+#endif /* x86-64 gcc/clang */
+
+static const lyra2_sponge_ops scalar_ops = {
+    absorbBlock,
+    absorbBlockBlake2Safe,
+    reducedSqueezeRow0,
+    reducedDuplexRow1,
+    reducedDuplexRowSetup,
+    reducedDuplexRow
+};
+
+const lyra2_sponge_ops *lyra2_sponge_get_ops(void) {
+#if defined(LYRA2_HAVE_AVX2)
+    /*Resolved once; __builtin_cpu_supports caches the cpuid result itself,
+      but keep our own flag so the check is a single load*/
+    static int haveAvx2 = -1;
+    if (haveAvx2 < 0)
+        haveAvx2 = (__builtin_cpu_supports("avx2") && lyra2_sponge_self_test()) ? 1 : 0;
+    if (haveAvx2)
+        return &avx2_ops;
+#endif
+    return &scalar_ops;
+}
@@ -36,6 +36,10 @@
 #include <string.h>
 #include <stdint.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #ifndef __FreeBSD__
 static inline void be32enc(void *pp, uint32_t x)
 {
@@ -359,8 +363,195 @@ void SMix(uint8_t *B, unsigned int r, unsigned int N, void* _V, void* XY)
         le32enc_2(&B[4 * k], X[k]);
 }
 
+#if defined(__SSE2__)
+/**
+ * salsa20_8_sse2(B):
+ * Apply the salsa20/8 core to the provided block, kept in the column-shuffled
+ * vector layout used by SMix_sse2.
+ */
+static void
+salsa20_8_sse2(__m128i B[4])
+{
+    __m128i X0, X1, X2, X3;
+    __m128i T;
+    size_t i;
+
+    X0 = B[0];
+    X1 = B[1];
+    X2 = B[2];
+    X3 = B[3];
+
+    for (i = 0; i < 8; i += 2) {
+        /* Operate on "columns". */
+        T = _mm_add_epi32(X0, X3);
+        X1 = _mm_xor_si128(X1, _mm_slli_epi32(T, 7));
+        X1 = _mm_xor_si128(X1, _mm_srli_epi32(T, 25));
+        T = _mm_add_epi32(X1, X0);
+        X2 = _mm_xor_si128(X2, _mm_slli_epi32(T, 9));
+        X2 = _mm_xor_si128(X2, _mm_srli_epi32(T, 23));
+        T = _mm_add_epi32(X2, X1);
+        X3 = _mm_xor_si128(X3, _mm_slli_epi32(T, 13));
+        X3 = _mm_xor_si128(X3, _mm_srli_epi32(T, 19));
+        T = _mm_add_epi32(X3, X2);
+        X0 = _mm_xor_si128(X0, _mm_slli_epi32(T, 18));
+        X0 = _mm_xor_si128(X0, _mm_srli_epi32(T, 14));
+
+        /* Rearrange data. */
+        X1 = _mm_shuffle_epi32(X1, 0x93);
+        X2 = _mm_shuffle_epi32(X2, 0x4E);
+        X3 = _mm_shuffle_epi32(X3, 0x39);
+
+        /* Operate on "rows". */
+        T = _mm_add_epi32(X0, X1);
+        X3 = _mm_xor_si128(X3, _mm_slli_epi32(T, 7));
+        X3 = _mm_xor_si128(X3, _mm_srli_epi32(T, 25));
+        T = _mm_add_epi32(X3, X0);
+        X2 = _mm_xor_si128(X2, _mm_slli_epi32(T, 9));
+        X2 = _mm_xor_si128(X2, _mm_srli_epi32(T, 23));
+        T = _mm_add_epi32(X2, X3);
+        X1 = _mm_xor_si128(X1, _mm_slli_epi32(T, 13));
+        X1 = _mm_xor_si128(X1, _mm_srli_epi32(T, 19));
+        T = _mm_add_epi32(X1, X2);
+        X0 = _mm_xor_si128(X0, _mm_slli_epi32(T, 18));
+        X0 = _mm_xor_si128(X0, _mm_srli_epi32(T, 14));
+
+        /* Rearrange data. */
+        X1 = _mm_shuffle_epi32(X1, 0x39);
+        X2 = _mm_shuffle_epi32(X2, 0x4E);
+        X3 = _mm_shuffle_epi32(X3, 0x93);
+    }
+
+    B[0] = _mm_add_epi32(B[0], X0);
+    B[1] = _mm_add_epi32(B[1], X1);
+    B[2] = _mm_add_epi32(B[2], X2);
+    B[3] = _mm_add_epi32(B[3], X3);
+}
+
+static void
+blockmix_salsa8_sse2(const __m128i * Bin, __m128i * Bout, __m128i * X, size_t r)
+{
+    size_t i;
+
+    /* 1: X <-- B_{2r - 1} */
+    blkcpy(X, &Bin[8 * r - 4], 64);
+
+    /* 2: for i = 0 to 2r - 1 do */
+    for (i = 0; i < r; i++) {
+        /* 3: X <-- H(X \xor B_i) */
+        blkxor(X, &Bin[i * 8], 64);
+        salsa20_8_sse2(X);
+
+        /* 4: Y_i <-- X */
+        /* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+        blkcpy(&Bout[i * 4], X, 64);
+
+        /* 3: X <-- H(X \xor B_i) */
+        blkxor(X, &Bin[i * 8 + 4], 64);
+        salsa20_8_sse2(X);
+
+        /* 4: Y_i <-- X */
+        /* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+        blkcpy(&Bout[(r + i) * 4], X, 64);
+    }
+}
+
+/**
+ * In the shuffled layout word 1 of the last sub-block sits at index 13.
+ */
+static uint64_t
+integerify_sse2(const void * B, size_t r)
+{
+    const uint32_t * X = (const uint32_t *)((uintptr_t)(B) + (2 * r - 1) * 64);
+
+    return (((uint64_t)(X[13]) << 32) + X[0]);
+}
+
+void SMix_sse2(uint8_t *B, unsigned int r, unsigned int N, void* _V, void* XY)
+{
+    __m128i* X = (__m128i*)XY;
+    __m128i* Y = (__m128i*)((uint8_t*)(XY) + 128 * r);
+    __m128i* Z = (__m128i*)((uint8_t*)(XY) + 256 * r);
+    __m128i* V = (__m128i*)_V;
+    uint32_t* X32 = (uint32_t*)X;
+
+    uint64_t j;
+    uint32_t k, i;
+
+    /* 1: X <-- B, shuffling each 64-byte sub-block into column order */
+    for (k = 0; k < 2 * r; k++)
+        for (i = 0; i < 16; i++)
+            X32[k * 16 + i] = le32dec_2(&B[(k * 16 + (i * 5 % 16)) * 4]);
+
+    /* 2: for i = 0 to N - 1 do */
+    for (unsigned int n = 0; n < N; n += 2)
+    {
+        /* 3: V_i <-- X */
+        blkcpy(&V[n * (8 * r)], X, 128 * r);
+
+        /* 4: X <-- H(X) */
+        blockmix_salsa8_sse2(X, Y, Z, r);
+
+        /* 3: V_i <-- X */
+        blkcpy(&V[(n + 1) * (8 * r)], Y, 128 * r);
+
+        /* 4: X <-- H(X) */
+        blockmix_salsa8_sse2(Y, X, Z, r);
+    }
+
+    /* 6: for i = 0 to N - 1 do */
+    for (unsigned int n = 0; n < N; n += 2)
+    {
+        /* 7: j <-- Integerify(X) mod N */
+        j = integerify_sse2(X, r) & (N - 1);
+
+        /* 8: X <-- H(X \xor V_j) */
+        blkxor(X, &V[j * (8 * r)], 128 * r);
+        blockmix_salsa8_sse2(X, Y, Z, r);
+
+        /* 7: j <-- Integerify(X) mod N */
+        j = integerify_sse2(Y, r) & (N - 1);
+
+        /* 8: X <-- H(X \xor V_j) */
+        blkxor(Y, &V[j * (8 * r)], 128 * r);
+        blockmix_salsa8_sse2(Y, X, Z, r);
+    }
+
+    /* 10: B' <-- X, undoing the shuffle */
+    for (k = 0; k < 2 * r; k++)
+        for (i = 0; i < 16; i++)
+            le32enc_2(&B[(k * 16 + (i * 5 % 16)) * 4], X32[k * 16 + i]);
+}
+#endif // __SSE2__
+
+typedef void (*SMixFn)(uint8_t*, unsigned int, unsigned int, void*, void*);
+
+/* Pick the SMix core once, mirroring the sha256 dispatch: the vector path is
+ * only used after it reproduces the scalar result on a fixed input. */
+static SMixFn SMixSelect()
+{
+#if defined(__SSE2__)
+    uint8_t ref[128], vec[128];
+    for (int i = 0; i < 128; i++)
+        ref[i] = vec[i] = (uint8_t)(i * 89);
+    void* V0 = malloc(128 * 16 + 63);
+    void* XY0 = malloc(256 + 64 + 63);
+    void* V = (void*)(((uintptr_t)(V0) + 63) & ~(uintptr_t)(63));
+    void* XY = (void*)(((uintptr_t)(XY0) + 63) & ~(uintptr_t)(63));
+    SMix(ref, 1, 16, V, XY);
+    SMix_sse2(vec, 1, 16, V, XY);
+    bool fMatch = memcmp(ref, vec, 128) == 0;
+    free(V0);
+    free(XY0);
+    if (fMatch)
+        return SMix_sse2;
+#endif
+    return SMix;
+}
+
 void scrypt(const char* pass, unsigned int pLen, const char* salt, unsigned int sLen, char *output, unsigned int N, unsigned int r, unsigned int p, unsigned int dkLen)
 {
+    static const SMixFn smix = SMixSelect();
+
     //containers
     void* V0 = malloc(128 * r * N + 63);
     void* XY0 = malloc(256 * r + 64 + 63);
@@ -373,7 +564,7 @@ void scrypt(const char* pass, unsigned int pLen, const char* salt, unsigned int
 
     for(unsigned int i = 0; i < p; i++)
     {
-        SMix(&B[i * 128 * r], r, N, V, XY);
+        smix(&B[i * 128 * r], r, N, V, XY);
     }
 
     PBKDF2_SHA256((const uint8_t *)pass, pLen, B, p * 128 * r, 1, (uint8_t *)output, dkLen);
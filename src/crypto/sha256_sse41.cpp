@@ -0,0 +1,198 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// 4-way double-SHA256 of 64-byte inputs using SSE4.1, one message per
+// 32-bit lane. Selected at runtime by SHA256AutoDetect() in sha256.cpp.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+
+#include "crypto/common.h"
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#define SSE41_TARGET __attribute__((target("sse4.1")))
+
+namespace sha256d64_sse41 {
+namespace {
+
+SSE41_TARGET inline __m128i K(uint32_t x) { return _mm_set1_epi32(x); }
+
+SSE41_TARGET inline __m128i Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+SSE41_TARGET inline __m128i Add(__m128i x, __m128i y, __m128i z) { return Add(Add(x, y), z); }
+SSE41_TARGET inline __m128i Add(__m128i x, __m128i y, __m128i z, __m128i w) { return Add(Add(x, y), Add(z, w)); }
+SSE41_TARGET inline __m128i Inc(__m128i& x, __m128i y, __m128i z, __m128i w) { x = Add(x, y, z, w); return x; }
+SSE41_TARGET inline __m128i Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+SSE41_TARGET inline __m128i Xor(__m128i x, __m128i y, __m128i z) { return Xor(Xor(x, y), z); }
+SSE41_TARGET inline __m128i Or(__m128i x, __m128i y) { return _mm_or_si128(x, y); }
+SSE41_TARGET inline __m128i And(__m128i x, __m128i y) { return _mm_and_si128(x, y); }
+SSE41_TARGET inline __m128i ShR(__m128i x, int n) { return _mm_srli_epi32(x, n); }
+SSE41_TARGET inline __m128i ShL(__m128i x, int n) { return _mm_slli_epi32(x, n); }
+
+SSE41_TARGET inline __m128i Ch(__m128i x, __m128i y, __m128i z) { return Xor(z, And(x, Xor(y, z))); }
+SSE41_TARGET inline __m128i Maj(__m128i x, __m128i y, __m128i z) { return Or(And(x, y), And(z, Or(x, y))); }
+SSE41_TARGET inline __m128i Sigma0(__m128i x) { return Xor(Or(ShR(x, 2), ShL(x, 30)), Or(ShR(x, 13), ShL(x, 19)), Or(ShR(x, 22), ShL(x, 10))); }
+SSE41_TARGET inline __m128i Sigma1(__m128i x) { return Xor(Or(ShR(x, 6), ShL(x, 26)), Or(ShR(x, 11), ShL(x, 21)), Or(ShR(x, 25), ShL(x, 7))); }
+SSE41_TARGET inline __m128i sigma0(__m128i x) { return Xor(Or(ShR(x, 7), ShL(x, 25)), Or(ShR(x, 18), ShL(x, 14)), ShR(x, 3)); }
+SSE41_TARGET inline __m128i sigma1(__m128i x) { return Xor(Or(ShR(x, 17), ShL(x, 15)), Or(ShR(x, 19), ShL(x, 13)), ShR(x, 10)); }
+
+/** One round of SHA-256, on four messages at once. */
+SSE41_TARGET inline void Round(__m128i a, __m128i b, __m128i c, __m128i& d, __m128i e, __m128i f, __m128i g, __m128i& h, __m128i k)
+{
+    __m128i t1 = Add(h, Sigma1(e), Ch(e, f, g), k);
+    __m128i t2 = Add(Sigma0(a), Maj(a, b, c));
+    d = Add(d, t1);
+    h = Add(t1, t2);
+}
+
+/** Perform one SHA-256 transformation on four interleaved messages;
+ *  w[16] holds one big-endian 32-bit word of each message per lane and is
+ *  clobbered by the message expansion. */
+SSE41_TARGET inline void Transform(__m128i* s, __m128i* w)
+{
+    __m128i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    Round(a, b, c, d, e, f, g, h, Add(K(0x428a2f98), w[0]));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x71374491), w[1]));
+    Round(g, h, a, b, c, d, e, f, Add(K(0xb5c0fbcf), w[2]));
+    Round(f, g, h, a, b, c, d, e, Add(K(0xe9b5dba5), w[3]));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x3956c25b), w[4]));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x59f111f1), w[5]));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x923f82a4), w[6]));
+    Round(b, c, d, e, f, g, h, a, Add(K(0xab1c5ed5), w[7]));
+    Round(a, b, c, d, e, f, g, h, Add(K(0xd807aa98), w[8]));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x12835b01), w[9]));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x243185be), w[10]));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x550c7dc3), w[11]));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x72be5d74), w[12]));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x80deb1fe), w[13]));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x9bdc06a7), w[14]));
+    Round(b, c, d, e, f, g, h, a, Add(K(0xc19bf174), w[15]));
+
+    Round(a, b, c, d, e, f, g, h, Add(K(0xe49b69c1), Inc(w[0], sigma1(w[14]), w[9], sigma0(w[1]))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0xefbe4786), Inc(w[1], sigma1(w[15]), w[10], sigma0(w[2]))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x0fc19dc6), Inc(w[2], sigma1(w[0]), w[11], sigma0(w[3]))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x240ca1cc), Inc(w[3], sigma1(w[1]), w[12], sigma0(w[4]))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x2de92c6f), Inc(w[4], sigma1(w[2]), w[13], sigma0(w[5]))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x4a7484aa), Inc(w[5], sigma1(w[3]), w[14], sigma0(w[6]))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x5cb0a9dc), Inc(w[6], sigma1(w[4]), w[15], sigma0(w[7]))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x76f988da), Inc(w[7], sigma1(w[5]), w[0], sigma0(w[8]))));
+    Round(a, b, c, d, e, f, g, h, Add(K(0x983e5152), Inc(w[8], sigma1(w[6]), w[1], sigma0(w[9]))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0xa831c66d), Inc(w[9], sigma1(w[7]), w[2], sigma0(w[10]))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0xb00327c8), Inc(w[10], sigma1(w[8]), w[3], sigma0(w[11]))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0xbf597fc7), Inc(w[11], sigma1(w[9]), w[4], sigma0(w[12]))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0xc6e00bf3), Inc(w[12], sigma1(w[10]), w[5], sigma0(w[13]))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0xd5a79147), Inc(w[13], sigma1(w[11]), w[6], sigma0(w[14]))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x06ca6351), Inc(w[14], sigma1(w[12]), w[7], sigma0(w[15]))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x14292967), Inc(w[15], sigma1(w[13]), w[8], sigma0(w[0]))));
+
+    Round(a, b, c, d, e, f, g, h, Add(K(0x27b70a85), Inc(w[0], sigma1(w[14]), w[9], sigma0(w[1]))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x2e1b2138), Inc(w[1], sigma1(w[15]), w[10], sigma0(w[2]))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x4d2c6dfc), Inc(w[2], sigma1(w[0]), w[11], sigma0(w[3]))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x53380d13), Inc(w[3], sigma1(w[1]), w[12], sigma0(w[4]))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x650a7354), Inc(w[4], sigma1(w[2]), w[13], sigma0(w[5]))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x766a0abb), Inc(w[5], sigma1(w[3]), w[14], sigma0(w[6]))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x81c2c92e), Inc(w[6], sigma1(w[4]), w[15], sigma0(w[7]))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x92722c85), Inc(w[7], sigma1(w[5]), w[0], sigma0(w[8]))));
+    Round(a, b, c, d, e, f, g, h, Add(K(0xa2bfe8a1), Inc(w[8], sigma1(w[6]), w[1], sigma0(w[9]))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0xa81a664b), Inc(w[9], sigma1(w[7]), w[2], sigma0(w[10]))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0xc24b8b70), Inc(w[10], sigma1(w[8]), w[3], sigma0(w[11]))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0xc76c51a3), Inc(w[11], sigma1(w[9]), w[4], sigma0(w[12]))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0xd192e819), Inc(w[12], sigma1(w[10]), w[5], sigma0(w[13]))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0xd6990624), Inc(w[13], sigma1(w[11]), w[6], sigma0(w[14]))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0xf40e3585), Inc(w[14], sigma1(w[12]), w[7], sigma0(w[15]))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x106aa070), Inc(w[15], sigma1(w[13]), w[8], sigma0(w[0]))));
+
+    Round(a, b, c, d, e, f, g, h, Add(K(0x19a4c116), Inc(w[0], sigma1(w[14]), w[9], sigma0(w[1]))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x1e376c08), Inc(w[1], sigma1(w[15]), w[10], sigma0(w[2]))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x2748774c), Inc(w[2], sigma1(w[0]), w[11], sigma0(w[3]))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x34b0bcb5), Inc(w[3], sigma1(w[1]), w[12], sigma0(w[4]))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x391c0cb3), Inc(w[4], sigma1(w[2]), w[13], sigma0(w[5]))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0x4ed8aa4a), Inc(w[5], sigma1(w[3]), w[14], sigma0(w[6]))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0x5b9cca4f), Inc(w[6], sigma1(w[4]), w[15], sigma0(w[7]))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0x682e6ff3), Inc(w[7], sigma1(w[5]), w[0], sigma0(w[8]))));
+    Round(a, b, c, d, e, f, g, h, Add(K(0x748f82ee), Inc(w[8], sigma1(w[6]), w[1], sigma0(w[9]))));
+    Round(h, a, b, c, d, e, f, g, Add(K(0x78a5636f), Inc(w[9], sigma1(w[7]), w[2], sigma0(w[10]))));
+    Round(g, h, a, b, c, d, e, f, Add(K(0x84c87814), Inc(w[10], sigma1(w[8]), w[3], sigma0(w[11]))));
+    Round(f, g, h, a, b, c, d, e, Add(K(0x8cc70208), Inc(w[11], sigma1(w[9]), w[4], sigma0(w[12]))));
+    Round(e, f, g, h, a, b, c, d, Add(K(0x90befffa), Inc(w[12], sigma1(w[10]), w[5], sigma0(w[13]))));
+    Round(d, e, f, g, h, a, b, c, Add(K(0xa4506ceb), Inc(w[13], sigma1(w[11]), w[6], sigma0(w[14]))));
+    Round(c, d, e, f, g, h, a, b, Add(K(0xbef9a3f7), Add(w[14], sigma1(w[12]), w[7], sigma0(w[15]))));
+    Round(b, c, d, e, f, g, h, a, Add(K(0xc67178f2), Add(w[15], sigma1(w[13]), w[8], sigma0(w[0]))));
+
+    s[0] = Add(s[0], a);
+    s[1] = Add(s[1], b);
+    s[2] = Add(s[2], c);
+    s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e);
+    s[5] = Add(s[5], f);
+    s[6] = Add(s[6], g);
+    s[7] = Add(s[7], h);
+}
+
+SSE41_TARGET inline __m128i Read4(const unsigned char* chunk, int offset)
+{
+    __m128i ret = _mm_set_epi32(ReadLE32(chunk + 0 + offset), ReadLE32(chunk + 64 + offset), ReadLE32(chunk + 128 + offset), ReadLE32(chunk + 192 + offset));
+    return _mm_shuffle_epi8(ret, _mm_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+}
+
+SSE41_TARGET inline void Write4(unsigned char* out, int offset, __m128i v)
+{
+    v = _mm_shuffle_epi8(v, _mm_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+    WriteLE32(out + 0 + offset, _mm_extract_epi32(v, 3));
+    WriteLE32(out + 32 + offset, _mm_extract_epi32(v, 2));
+    WriteLE32(out + 64 + offset, _mm_extract_epi32(v, 1));
+    WriteLE32(out + 96 + offset, _mm_extract_epi32(v, 0));
+}
+
+} // namespace
+
+SSE41_TARGET void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    __m128i s[8], w[16];
+
+    // Transform 1: the four 64-byte inputs.
+    s[0] = K(0x6a09e667ul);
+    s[1] = K(0xbb67ae85ul);
+    s[2] = K(0x3c6ef372ul);
+    s[3] = K(0xa54ff53aul);
+    s[4] = K(0x510e527ful);
+    s[5] = K(0x9b05688cul);
+    s[6] = K(0x1f83d9abul);
+    s[7] = K(0x5be0cd19ul);
+    for (int i = 0; i < 16; i++)
+        w[i] = Read4(in, 4 * i);
+    Transform(s, w);
+
+    // Transform 2: the shared padding block of a 64-byte message.
+    w[0] = K(0x80000000ul);
+    for (int i = 1; i < 15; i++)
+        w[i] = K(0);
+    w[15] = K(512);
+    Transform(s, w);
+
+    // Transform 3: the second hash, over the 32-byte digests plus padding.
+    for (int i = 0; i < 8; i++)
+        w[i] = s[i];
+    w[8] = K(0x80000000ul);
+    for (int i = 9; i < 15; i++)
+        w[i] = K(0);
+    w[15] = K(256);
+    s[0] = K(0x6a09e667ul);
+    s[1] = K(0xbb67ae85ul);
+    s[2] = K(0x3c6ef372ul);
+    s[3] = K(0xa54ff53aul);
+    s[4] = K(0x510e527ful);
+    s[5] = K(0x9b05688cul);
+    s[6] = K(0x1f83d9abul);
+    s[7] = K(0x5be0cd19ul);
+    Transform(s, w);
+
+    for (int i = 0; i < 8; i++)
+        Write4(out, 4 * i, s[i]);
+}
+
+} // namespace sha256d64_sse41
+
+#endif
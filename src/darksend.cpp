@@ -2091,20 +2091,21 @@ bool CDarksendQueue::CheckSignature() {
 
 
 //TODO: Rename/move to core
-void ThreadCheckDarkSendPool() {
-    // Make this thread recognisable as the wallet flushing thread
-    RenameThread("Lux-darksend");
-
-    unsigned int c = 0;
+// One pass of masternode/darksend maintenance, run every 2.5 seconds off
+// the shared scheduler (was a dedicated thread with its own sleep loop).
+void CheckDarkSendPool() {
+    static unsigned int c = 0;
     std::string errorMessage;
 
-    while (true) {
+    {
         c++;
 
-        MilliSleep(2500);
-        //LogPrintf("ThreadCheckDarkSendPool::check timeout\n");
+        //LogPrintf("CheckDarkSendPool::check timeout\n");
         darkSendPool.CheckTimeout();
 
+        // verify and apply masternode broadcasts queued by the message handler
+        ProcessPendingMasternodeSigChecks();
+
         if (c % 60 == 0) {
             LOCK(cs_main);
             /*
@@ -2138,15 +2139,18 @@ void ThreadCheckDarkSendPool() {
                 }
 
                 //remove inactive
+                bool fRemoved = false;
                 it = vecMasternodes.begin();
                 while (it != vecMasternodes.end()) {
                     if ((*it).enabled == 4 || (*it).enabled == 3) {
                         LogPrintf("Removing inactive masternode %s\n", (*it).addr.ToString().c_str());
                         it = vecMasternodes.erase(it);
+                        fRemoved = true;
                     } else {
                         ++it;
                     }
                 }
+                if (fRemoved) RebuildMasternodeIndex();
 
             }
 
@@ -425,6 +425,6 @@ public:
 
 void ConnectToDarkSendMasterNodeWinner();
 
-void ThreadCheckDarkSendPool();
+void CheckDarkSendPool();
 
 #endif
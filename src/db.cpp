@@ -239,7 +239,7 @@ void CDBEnv::CheckpointLSN(const std::string& strFile)
 }
 
 
-CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL)
+CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), plog(NULL), fLogTxn(false), activeTxn(NULL)
 {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
@@ -248,6 +248,33 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
         return;
 
     bool fCreate = strchr(pszMode, 'c') != NULL;
+
+    // Existing append-log files keep their format; new files pick it up
+    // from -walletlog. Everything else stays on Berkeley DB.
+    {
+        std::string strPath = (GetDataDir() / strFilename).string();
+        bool fFileExists = boost::filesystem::exists(strPath);
+        if ((fFileExists && CWalletRecordLog::IsLogFile(strPath)) ||
+            (!fFileExists && fCreate && GetBoolArg("-walletlog", false))) {
+            strFile = strFilename;
+            plog = CWalletRecordLog::Get(strFile);
+            std::string strError;
+            if (!plog->Open(fCreate, strError)) {
+                plog->Release();
+                plog = NULL;
+                strFile = "";
+                throw runtime_error(strprintf("CDB : %s", strError));
+            }
+            if (fCreate && !Exists(string("version"))) {
+                bool fTmp = fReadOnly;
+                fReadOnly = false;
+                WriteVersion(CLIENT_VERSION);
+                fReadOnly = fTmp;
+            }
+            return;
+        }
+    }
+
     unsigned int nFlags = DB_THREAD;
     if (fCreate)
         nFlags |= DB_CREATE;
@@ -298,8 +325,46 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
     }
 }
 
+static CCriticalSection cs_flushDefer;
+static int nFlushGuards = 0;
+static bool fFlushDeferred = false;
+
+CDBFlushGuard::CDBFlushGuard()
+{
+    LOCK(cs_flushDefer);
+    nFlushGuards++;
+}
+
+CDBFlushGuard::~CDBFlushGuard()
+{
+    bool fCheckpoint = false;
+    {
+        LOCK(cs_flushDefer);
+        if (--nFlushGuards == 0 && fFlushDeferred) {
+            fFlushDeferred = false;
+            fCheckpoint = true;
+        }
+    }
+    if (fCheckpoint)
+        bitdb.dbenv.txn_checkpoint(0, 0, 0);
+}
+
+void DBFlushBarrier()
+{
+    {
+        LOCK(cs_flushDefer);
+        fFlushDeferred = false;
+    }
+    bitdb.dbenv.txn_checkpoint(0, 0, 0);
+}
+
 void CDB::Flush()
 {
+    if (plog) {
+        if (!fLogTxn)
+            plog->Flush();
+        return;
+    }
     if (activeTxn)
         return;
 
@@ -308,11 +373,33 @@ void CDB::Flush()
     if (fReadOnly)
         nMinutes = 1;
 
+    if (nMinutes == 0) {
+        // Inside a CDBFlushGuard scope the writes stay journalled in the
+        // database log; the guard issues one combined checkpoint when the
+        // whole batch is done.
+        LOCK(cs_flushDefer);
+        if (nFlushGuards > 0) {
+            fFlushDeferred = true;
+            return;
+        }
+    }
+
     bitdb.dbenv.txn_checkpoint(nMinutes ? GetArg("-dblogsize", 100) * 1024 : 0, nMinutes, 0);
 }
 
 void CDB::Close()
 {
+    if (plog) {
+        if (fLogTxn) {
+            plog->TxnAbort();
+            fLogTxn = false;
+        }
+        if (fFlushOnClose)
+            plog->Flush();
+        plog->Release();
+        plog = NULL;
+        return;
+    }
     if (!pdb)
         return;
     if (activeTxn)
@@ -354,6 +441,40 @@ bool CDBEnv::RemoveDb(const string& strFile)
 
 bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 {
+    // Log-format files have no fragmentation to rewrite away beyond their
+    // superseded records: erase the skipped keys, refresh the version
+    // record like the copy loop below does, and compact.
+    {
+        std::string strPath = (GetDataDir() / strFile).string();
+        if (CWalletRecordLog::IsLogFile(strPath)) {
+            CWalletRecordLog* plog = CWalletRecordLog::Get(strFile);
+            std::string strError;
+            bool fOk = plog->Open(false, strError);
+            if (fOk) {
+                CWalletRecordLog::Cursor* pcursor = plog->NewCursor();
+                CWalletRecordLog::LogKey vchKey;
+                CWalletRecordLog::LogValue vchValue;
+                while (plog->CursorNext(pcursor, vchKey, vchValue)) {
+                    if (pszSkip && vchKey.size() >= strlen(pszSkip) &&
+                        memcmp(&vchKey[0], pszSkip, strlen(pszSkip)) == 0)
+                        plog->Erase(vchKey);
+                }
+                delete pcursor;
+
+                CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+                ssKey << std::string("version");
+                CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+                ssValue << CLIENT_VERSION;
+                plog->Write(CWalletRecordLog::LogKey(ssKey.begin(), ssKey.end()),
+                    CWalletRecordLog::LogValue(ssValue.begin(), ssValue.end()), true);
+
+                fOk = plog->Compact();
+            }
+            plog->Release();
+            return fOk;
+        }
+    }
+
     while (true) {
         {
             LOCK(bitdb.cs_db);
@@ -11,6 +11,7 @@
 #include "streams.h"
 #include "sync.h"
 #include "version.h"
+#include "walletlog.h"
 
 #include <map>
 #include <string>
@@ -89,12 +90,37 @@ public:
 
 extern CDBEnv bitdb;
 
+/**
+ * RAII guard that coalesces wallet database checkpoints.  While at least one
+ * guard is alive, CDB::Flush() only records that a checkpoint is owed instead
+ * of issuing one; the last guard to be destroyed writes the single combined
+ * checkpoint.  Wrap per-block wallet processing in one of these so a block
+ * with many wallet transactions costs one disk sync instead of one per
+ * transaction.
+ */
+class CDBFlushGuard
+{
+public:
+    CDBFlushGuard();
+    ~CDBFlushGuard();
+};
+
+/** Durability barrier: immediately checkpoint any flush deferred by a
+ * CDBFlushGuard.  Used before broadcasting a freshly committed wallet
+ * transaction. */
+void DBFlushBarrier();
+
 
 /** RAII class that provides access to a Berkeley database */
 class CDB
 {
 protected:
     Db* pdb;
+    //! Non-NULL when this file uses the append-log backend instead of
+    //! Berkeley DB; the template accessors below branch on it after
+    //! serializing, so record semantics are identical either way.
+    CWalletRecordLog* plog;
+    bool fLogTxn;
     std::string strFile;
     DbTxn* activeTxn;
     bool fReadOnly;
@@ -115,6 +141,25 @@ protected:
     template <typename K, typename T>
     bool Read(const K& key, T& value)
     {
+        if (plog) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey.reserve(1000);
+            ssKey << key;
+            CWalletRecordLog::LogValue vchValue;
+            if (!plog->Read(CWalletRecordLog::LogKey(ssKey.begin(), ssKey.end()), vchValue))
+                return false;
+            try {
+                CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+                if (!vchValue.empty())
+                    ssValue.write((const char*)&vchValue[0], vchValue.size());
+                ssValue >> value;
+            } catch (const std::exception&) {
+                return false;
+            }
+            if (!vchValue.empty())
+                memset(&vchValue[0], 0, vchValue.size());
+            return true;
+        }
         if (!pdb)
             return false;
 
@@ -149,6 +194,22 @@ protected:
     template <typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite = true)
     {
+        if (plog) {
+            if (fReadOnly)
+                assert(!"Write called on database in read-only mode");
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey.reserve(1000);
+            ssKey << key;
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            ssValue.reserve(10000);
+            ssValue << value;
+            bool fOk = plog->Write(CWalletRecordLog::LogKey(ssKey.begin(), ssKey.end()),
+                CWalletRecordLog::LogValue(ssValue.begin(), ssValue.end()), fOverwrite);
+            // Clear memory in case it was a private key
+            memset(&ssKey[0], 0, ssKey.size());
+            memset(&ssValue[0], 0, ssValue.size());
+            return fOk;
+        }
         if (!pdb)
             return false;
         if (fReadOnly)
@@ -178,6 +239,16 @@ protected:
     template <typename K>
     bool Erase(const K& key)
     {
+        if (plog) {
+            if (fReadOnly)
+                assert(!"Erase called on database in read-only mode");
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey.reserve(1000);
+            ssKey << key;
+            bool fOk = plog->Erase(CWalletRecordLog::LogKey(ssKey.begin(), ssKey.end()));
+            memset(&ssKey[0], 0, ssKey.size());
+            return fOk;
+        }
         if (!pdb)
             return false;
         if (fReadOnly)
@@ -200,6 +271,14 @@ protected:
     template <typename K>
     bool Exists(const K& key)
     {
+        if (plog) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey.reserve(1000);
+            ssKey << key;
+            bool fFound = plog->Exists(CWalletRecordLog::LogKey(ssKey.begin(), ssKey.end()));
+            memset(&ssKey[0], 0, ssKey.size());
+            return fFound;
+        }
         if (!pdb)
             return false;
 
@@ -219,6 +298,11 @@ protected:
 
     Dbc* GetCursor()
     {
+        if (plog) {
+            // In log mode the handle is really a CWalletRecordLog::Cursor;
+            // it only round-trips through ReadAtCursor/CloseCursor below.
+            return reinterpret_cast<Dbc*>(plog->NewCursor());
+        }
         if (!pdb)
             return NULL;
         Dbc* pcursor = NULL;
@@ -228,8 +312,36 @@ protected:
         return pcursor;
     }
 
+    void CloseCursor(Dbc* pcursor)
+    {
+        if (plog)
+            delete reinterpret_cast<CWalletRecordLog::Cursor*>(pcursor);
+        else
+            pcursor->close();
+    }
+
     int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags = DB_NEXT)
     {
+        if (plog) {
+            CWalletRecordLog::Cursor* plogCursor = reinterpret_cast<CWalletRecordLog::Cursor*>(pcursor);
+            if (fFlags == DB_SET_RANGE)
+                plog->CursorSeek(plogCursor, CWalletRecordLog::LogKey(ssKey.begin(), ssKey.end()));
+            else if (fFlags != DB_NEXT)
+                return 99999; // flag combination not used on wallet records
+            CWalletRecordLog::LogKey vchKey;
+            CWalletRecordLog::LogValue vchValue;
+            if (!plog->CursorNext(plogCursor, vchKey, vchValue))
+                return DB_NOTFOUND;
+            ssKey.SetType(SER_DISK);
+            ssKey.clear();
+            if (!vchKey.empty())
+                ssKey.write((const char*)&vchKey[0], vchKey.size());
+            ssValue.SetType(SER_DISK);
+            ssValue.clear();
+            if (!vchValue.empty())
+                ssValue.write((const char*)&vchValue[0], vchValue.size());
+            return 0;
+        }
         // Read at cursor
         Dbt datKey;
         if (fFlags == DB_SET || fFlags == DB_SET_RANGE || fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE) {
@@ -268,6 +380,12 @@ protected:
 public:
     bool TxnBegin()
     {
+        if (plog) {
+            if (fLogTxn)
+                return false;
+            fLogTxn = plog->TxnBegin();
+            return fLogTxn;
+        }
         if (!pdb || activeTxn)
             return false;
         DbTxn* ptxn = bitdb.TxnBegin();
@@ -279,6 +397,12 @@ public:
 
     bool TxnCommit()
     {
+        if (plog) {
+            if (!fLogTxn)
+                return false;
+            fLogTxn = false;
+            return plog->TxnCommit();
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->commit(0);
@@ -288,6 +412,12 @@ public:
 
     bool TxnAbort()
     {
+        if (plog) {
+            if (!fLogTxn)
+                return false;
+            fLogTxn = false;
+            return plog->TxnAbort();
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->abort();
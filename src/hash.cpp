@@ -5,6 +5,9 @@
 #include "hash.h"
 #include "crypto/hmac_sha512.h"
 #include "crypto/scrypt.h"
+#include "random.h"
+
+#include <limits>
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
 {
@@ -174,4 +177,6 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
-}
\ No newline at end of file
+}
+
+SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
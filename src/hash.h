@@ -22,6 +22,8 @@
 #include "crypto/sph_gost.h"
 #include "crypto/sph_echo.h"
 #include "crypto/lyra2/Lyra2.h"
+#include "crypto/cubehash_simd.h"
+#include "crypto/gost_simd.h"
 
 #include "crypto/common.h"
 
@@ -294,9 +296,11 @@ inline uint256 phi2_hash(const T1 pbegin, const T1 pend)
     sph_echo512_context ctx_echo;
     sph_skein512_context ctx_skein;
 
-    sph_cubehash512_init(&ctx_cubehash);
-    sph_cubehash512(&ctx_cubehash, (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), len);
-    sph_cubehash512_close(&ctx_cubehash, (void*)hashB);
+    if (!CubeHash512SIMD((pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), len, (void*)hashB)) {
+        sph_cubehash512_init(&ctx_cubehash);
+        sph_cubehash512(&ctx_cubehash, (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), len);
+        sph_cubehash512_close(&ctx_cubehash, (void*)hashB);
+    }
 
     LYRA2(&hashA[ 0], 32, &hashB[ 0], 32, &hashB[ 0], 32, 1, 8, 8);
     LYRA2(&hashA[32], 32, &hashB[32], 32, &hashB[32], 32, 1, 8, 8);
@@ -306,9 +310,11 @@ inline uint256 phi2_hash(const T1 pbegin, const T1 pend)
     sph_jh512_close(&ctx_jh, (void*)hash);
 
     if (hash[0] & 1) {
-        sph_gost512_init(&ctx_gost);
-        sph_gost512(&ctx_gost, (const void*)hash, 64);
-        sph_gost512_close(&ctx_gost, (void*)hash);
+        if (!Gost512SIMD((const void*)hash, 64, (void*)hash)) {
+            sph_gost512_init(&ctx_gost);
+            sph_gost512(&ctx_gost, (const void*)hash, 64);
+            sph_gost512_close(&ctx_gost, (void*)hash);
+        }
     } else {
         sph_echo512_init(&ctx_echo);
         sph_echo512(&ctx_echo, (const void*)hash, 64);
@@ -350,17 +356,21 @@ inline uint256 Phi1612(const T1 pbegin, const T1 pend)
     sph_jh512 (&ctx_jh, static_cast<const void*>(&hash[0]), 64);
     sph_jh512_close(&ctx_jh, static_cast<void*>(&hash[1]));
 
-    sph_cubehash512_init(&ctx_cubehash);
-    sph_cubehash512 (&ctx_cubehash, static_cast<const void*>(&hash[1]), 64);
-    sph_cubehash512_close(&ctx_cubehash, static_cast<void*>(&hash[2]));
+    if (!CubeHash512SIMD(static_cast<const void*>(&hash[1]), 64, static_cast<void*>(&hash[2]))) {
+        sph_cubehash512_init(&ctx_cubehash);
+        sph_cubehash512 (&ctx_cubehash, static_cast<const void*>(&hash[1]), 64);
+        sph_cubehash512_close(&ctx_cubehash, static_cast<void*>(&hash[2]));
+    }
 
     sph_fugue512_init(&ctx_fugue);
     sph_fugue512 (&ctx_fugue, static_cast<const void*>(&hash[2]), 64);
     sph_fugue512_close(&ctx_fugue, static_cast<void*>(&hash[3]));
 
-    sph_gost512_init(&ctx_gost);
-    sph_gost512 (&ctx_gost, static_cast<const void*>(&hash[3]), 64);
-    sph_gost512_close(&ctx_gost, static_cast<void*>(&hash[4]));
+    if (!Gost512SIMD(static_cast<const void*>(&hash[3]), 64, static_cast<void*>(&hash[4]))) {
+        sph_gost512_init(&ctx_gost);
+        sph_gost512 (&ctx_gost, static_cast<const void*>(&hash[3]), 64);
+        sph_gost512_close(&ctx_gost, static_cast<void*>(&hash[4]));
+    }
 
     sph_echo512_init(&ctx_echo);
     sph_echo512 (&ctx_echo, static_cast<const void*>(&hash[4]), 64);
@@ -385,4 +395,23 @@ void scrypt_hash(const char* pass, unsigned int pLen, const char* salt, unsigned
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/**
+ * SipHash-based hasher for uint256 keys in unordered containers. Each
+ * instance draws a random salt so an attacker cannot precompute a set of
+ * txids that collide in our hash tables.
+ */
+class SaltedTxidHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedTxidHasher();
+
+    size_t operator()(const uint256& txid) const {
+        return SipHashUint256(k0, k1, txid);
+    }
+};
+
 #endif // BITCOIN_HASH_H
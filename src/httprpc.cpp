@@ -89,6 +89,34 @@ static bool RPCAuthorized(const std::string& strAuth)
     return TimingResistantEqual(strUserPass, strRPCUserColonPass);
 }
 
+//! Batch sizes from which replies are streamed instead of buffered whole
+static const unsigned int STREAM_BATCH_THRESHOLD = 16;
+
+/** Decide from a cheap scan of the body which admission class a request
+ * belongs on. A full JSON parse on the event loop thread would defeat the
+ * purpose; for batches the first classified method decides, and a
+ * misclassification merely schedules the call on a more restricted pool.
+ */
+static std::string HTTPReqAdmissionClass(const std::string& strBody)
+{
+    size_t pos = 0;
+    while ((pos = strBody.find("\"method\"", pos)) != std::string::npos) {
+        pos += 8;
+        while (pos < strBody.size() && (isspace((unsigned char)strBody[pos]) || strBody[pos] == ':'))
+            pos++;
+        if (pos >= strBody.size() || strBody[pos] != '"')
+            continue;
+        size_t end = strBody.find('"', pos + 1);
+        if (end == std::string::npos)
+            break;
+        std::string cls = RPCMethodAdmissionClass(strBody.substr(pos + 1, end - pos - 1));
+        if (!cls.empty())
+            return cls;
+        pos = end + 1;
+    }
+    return std::string();
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -127,15 +155,37 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+            // Methods with a streaming serializer write the reply buffer
+            // directly and skip the UniValue round trip.
+            if (!RPCExecuteStreaming(jreq, strReply)) {
+                UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+                // Send reply
+                strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            }
 
         // array of requests
-        } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
-        else
+        } else if (valRequest.isArray()) {
+            const UniValue& vReq = valRequest.get_array();
+            // Stream large batches chunk by chunk so the response never has
+            // to be buffered whole: each sub-reply is serialized, sent and
+            // released before the next one is executed.
+            if (vReq.size() >= STREAM_BATCH_THRESHOLD) {
+                req->WriteHeader("Content-Type", "application/json");
+                req->ChunkedReplyStart(HTTP_OK);
+                req->ChunkedReplyChunk("[");
+                for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++) {
+                    std::string strEntry = JSONRPCExecOne(vReq[reqIdx]).write();
+                    if (reqIdx + 1 < vReq.size())
+                        strEntry += ",";
+                    req->ChunkedReplyChunk(strEntry);
+                }
+                req->ChunkedReplyChunk("]\n");
+                req->ChunkedReplyEnd();
+                return true;
+            }
+            strReply = JSONRPCExecBatch(vReq);
+        } else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
         req->WriteHeader("Content-Type", "application/json");
@@ -174,6 +224,9 @@ bool StartHTTPRPC()
         return false;
 
     RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    for (const CRPCAdmissionClass& cls : RPCAdmissionClasses())
+        RegisterHTTPWorkClass(cls.name, cls.nThreads, cls.nQueueDepth, cls.nQueueTimeoutMs);
+    RegisterHTTPClassifier(HTTPReqAdmissionClass);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
@@ -20,7 +20,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <deque>
 #include <future>
+#include <map>
 
 #include <event2/event.h>
 #include <event2/http.h>
@@ -51,6 +53,10 @@ public:
     {
         func(req.get(), path);
     }
+    void Expire()
+    {
+        req->WriteReply(HTTP_SERVUNAVAIL, "Work queue wait timeout exceeded");
+    }
 
     std::unique_ptr<HTTPRequest> req;
 
@@ -69,9 +75,12 @@ private:
     /** Mutex protects entire object */
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    //! Queued items with the time they were enqueued, so stale ones can be
+    //! expired instead of executed
+    std::deque<std::pair<int64_t, std::unique_ptr<WorkItem>>> queue;
     bool running;
     size_t maxDepth;
+    int64_t maxWaitUs;
     int numThreads;
 
     /** RAII object to keep track of number of running worker threads */
@@ -93,8 +102,9 @@ private:
     };
 
 public:
-    WorkQueue(size_t maxDepth) : running(true),
+    WorkQueue(size_t maxDepth, int64_t maxWaitMs = 0) : running(true),
                                  maxDepth(maxDepth),
+                                 maxWaitUs(maxWaitMs * 1000),
                                  numThreads(0)
     {
     }
@@ -111,7 +121,7 @@ public:
         if (queue.size() >= maxDepth) {
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(GetTimeMicros(), std::unique_ptr<WorkItem>(item));
         cond.notify_one();
         return true;
     }
@@ -121,16 +131,21 @@ public:
         ThreadCounter count(*this);
         while (running) {
             std::unique_ptr<WorkItem> i;
+            int64_t nQueuedTime = 0;
             {
                 std::unique_lock<std::mutex> lock(cs);
                 while (running && queue.empty())
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
+                nQueuedTime = queue.front().first;
+                i = std::move(queue.front().second);
                 queue.pop_front();
             }
-            (*i)();
+            if (maxWaitUs > 0 && GetTimeMicros() - nQueuedTime > maxWaitUs)
+                i->Expire();
+            else
+                (*i)();
         }
     }
     /** Interrupt and exit loops */
@@ -178,6 +193,16 @@ struct evhttp* eventHTTP = 0;
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Additional worker classes keyed by name (see RegisterHTTPWorkClass), each
+//! with its own bounded queue and dedicated workers, so long-running calls
+//! can only exhaust the threads of their own class
+struct HTTPWorkClass {
+    WorkQueue<HTTPClosure>* queue;
+    int nThreads;
+};
+static std::map<std::string, HTTPWorkClass> workQueueClasses;
+//! Maps a request body to the worker class it belongs on (empty = default)
+static std::function<std::string(const std::string&)> workClassifier;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 std::vector<evhttp_bound_socket *> boundSockets;
@@ -279,9 +304,15 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        WorkQueue<HTTPClosure>* queue = workQueue;
+        if (!workQueueClasses.empty() && workClassifier) {
+            std::map<std::string, HTTPWorkClass>::const_iterator cls = workQueueClasses.find(workClassifier(hreq->PeekBody(MAX_HEADERS_SIZE)));
+            if (cls != workQueueClasses.end())
+                queue = cls->second.queue;
+        }
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
-        assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        assert(queue);
+        if (queue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else {
             LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
@@ -451,6 +482,14 @@ bool StartHTTPServer()
         std::thread rpc_worker(HTTPWorkQueueRun, workQueue);
         rpc_worker.detach();
     }
+
+    for (std::map<std::string, HTTPWorkClass>::const_iterator it = workQueueClasses.begin(); it != workQueueClasses.end(); ++it) {
+        LogPrintf("HTTP: starting %d worker threads for class %s\n", it->second.nThreads, it->first);
+        for (int i = 0; i < it->second.nThreads; i++) {
+            std::thread rpc_worker(HTTPWorkQueueRun, it->second.queue);
+            rpc_worker.detach();
+        }
+    }
     return true;
 }
 
@@ -470,6 +509,8 @@ void InterruptHTTPServer()
     }
     if (workQueue)
         workQueue->Interrupt();
+    for (std::map<std::string, HTTPWorkClass>::const_iterator it = workQueueClasses.begin(); it != workQueueClasses.end(); ++it)
+        it->second.queue->Interrupt();
 }
 
 void StopHTTPServer()
@@ -480,6 +521,12 @@ void StopHTTPServer()
         workQueue->WaitExit();
         delete workQueue;
     }
+    for (std::map<std::string, HTTPWorkClass>::const_iterator it = workQueueClasses.begin(); it != workQueueClasses.end(); ++it) {
+        LogPrint("http", "Waiting for HTTP worker threads of class %s to exit\n", it->first);
+        it->second.queue->WaitExit();
+        delete it->second.queue;
+    }
+    workQueueClasses.clear();
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
         // Give event loop a few seconds to exit (to send back last RPC responses), then break it
@@ -581,6 +628,18 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t maxLen)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    size_t size = std::min(maxLen, evbuffer_get_length(buf));
+    const char* data = (const char*)evbuffer_pullup(buf, size);
+    if (!data)
+        return "";
+    return std::string(data, size);
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -607,6 +666,47 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/* The chunked-reply calls below follow the same pattern as WriteReply: the
+ * actual evhttp work must happen on the main http thread, so each call posts
+ * a closure there. Closures on one event base are activated in posting
+ * order, which keeps start/chunks/end correctly sequenced.
+ */
+void HTTPRequest::ChunkedReplyStart(int nStatus)
+{
+    assert(!replySent && req);
+    struct evhttp_request* req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]() {
+        evhttp_send_reply_start(req_copy, nStatus, NULL);
+    });
+    ev->trigger(0);
+}
+
+void HTTPRequest::ChunkedReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && req);
+    struct evhttp_request* req_copy = req;
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb]() {
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+}
+
+void HTTPRequest::ChunkedReplyEnd()
+{
+    assert(!replySent && req);
+    struct evhttp_request* req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]() {
+        evhttp_send_reply_end(req_copy);
+    });
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -647,6 +747,23 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
+void RegisterHTTPClassifier(const std::function<std::string(const std::string&)>& classifier)
+{
+    workClassifier = classifier;
+}
+
+void RegisterHTTPWorkClass(const std::string& name, int nThreads, size_t nQueueDepth, int64_t nQueueTimeoutMs)
+{
+    if (name.empty() || nThreads <= 0 || workQueueClasses.count(name))
+        return;
+    LogPrint("http", "Registering HTTP work class %s (%d threads, depth %u, timeout %dms)\n",
+             name, nThreads, (unsigned int)nQueueDepth, nQueueTimeoutMs);
+    HTTPWorkClass cls;
+    cls.queue = new WorkQueue<HTTPClosure>(nQueueDepth, nQueueTimeoutMs);
+    cls.nThreads = nThreads;
+    workQueueClasses[name] = cls;
+}
+
 void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
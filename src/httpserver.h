@@ -11,6 +11,7 @@
 #include <functional>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_HEAVY_THREADS=2;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
@@ -95,6 +96,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Look at up to maxLen bytes of the request body without consuming it.
+     * Used to classify a request before it is dispatched to a worker pool.
+     */
+    std::string PeekBody(size_t maxLen);
+
     /**
      * Write output header.
      *
@@ -111,14 +118,45 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Begin a chunked (streaming) HTTP reply. Follow with any number of
+     * ChunkedReplyChunk calls and exactly one ChunkedReplyEnd, after which
+     * the same restrictions as after WriteReply apply. Lets large replies
+     * go out piecewise instead of being buffered whole in memory.
+     */
+    void ChunkedReplyStart(int nStatus);
+
+    /** Queue one chunk of a reply started with ChunkedReplyStart. */
+    void ChunkedReplyChunk(const std::string& strChunk);
+
+    /** Finish a chunked reply and hand the request back to the main thread. */
+    void ChunkedReplyEnd();
 };
 
+/** Register a classifier that maps the (partial) request body to the name of
+ * the worker class the request should run on (empty = default pool), so that
+ * long-running calls do not starve cheap ones.
+ */
+void RegisterHTTPClassifier(const std::function<std::string(const std::string&)>& classifier);
+
+/** Register an additional worker class. Must be called between InitHTTPServer
+ * and StartHTTPServer. Requests the classifier assigns to this class get their
+ * own queue of the given depth, served by nThreads dedicated workers; a
+ * request that waited in the queue longer than nQueueTimeoutMs is answered
+ * 503 instead of being served stale.
+ */
+void RegisterHTTPWorkClass(const std::string& name, int nThreads, size_t nQueueDepth, int64_t nQueueTimeoutMs);
+
 /** Event handler closure.
  */
 class HTTPClosure
 {
 public:
     virtual void operator()() = 0;
+    /** Called instead of operator() when the item waited in a work queue
+     * longer than the queue's admission timeout allows. */
+    virtual void Expire() {}
     virtual ~HTTPClosure() {}
 };
 
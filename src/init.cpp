@@ -14,11 +14,13 @@
 #include "activemasternode.h"
 #include "addrman.h"
 #include "amount.h"
+#include "binlog.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/sha256.h"
 #include "key.h"
 #include "main.h"
 #include "stake.h"
@@ -26,6 +28,7 @@
 #include "masternode.h"
 #include "miner.h"
 #include "net.h"
+#include "perf.h"
 #include "policy/policy.h"
 #include "rpcserver.h"
 #include "script/standard.h"
@@ -72,6 +75,7 @@ CWallet* pwalletMain = NULL;
 int nWalletBackups = 10;
 #endif
 bool fFeeEstimatesInitialized = false;
+static bool fDumpMempoolLater = false;
 std::atomic<bool> fRestartRequested(false); // true: restart false: shutdown
 unsigned int nMinerSleep;
 
@@ -97,6 +101,9 @@ enum BindFlags {
 };
 
 static const char* FEE_ESTIMATES_FILENAME = "fee_estimates.dat";
+
+//! -evmcachesize default (MiB), shared trie-node/code cache for the EVM state
+static const int64_t DEFAULT_EVM_CACHE_SIZE_MB = 64;
 CClientUIInterface uiInterface;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -161,7 +168,7 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB* pcoinsdbview = NULL;
+CCoinsViewDB* pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher* pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -191,6 +198,11 @@ void PrepareShutdown()
     StopNode();
     UnregisterNodeSignals(GetNodeSignals());
 
+    if (fDumpMempoolLater && GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        DumpMempool();
+        fDumpMempoolLater = false;
+    }
+
     if (fFeeEstimatesInitialized) {
         boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
         CAutoFile est_fileout(fopen(est_path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
@@ -217,8 +229,12 @@ void PrepareShutdown()
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        if (pstorageresult)
+            pstorageresult->commitResults();
 //        delete pstorageresult;
 //        pstorageresult = NULL;
+        delete globalCallState.release();
+        globalCallSealEngine.reset();
         delete globalState.release();
         globalSealEngine.reset();
     }
@@ -332,9 +348,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -?                     " + _("This help message") + "\n";
     strUsage += "  -alertnotify=<cmd>     " + _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)") + "\n";
     strUsage += "  -alerts                " + strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS);
+    strUsage += "  -assumevalid=<hex>     " + _("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: none)") + "\n";
     strUsage += "  -blocknotify=<cmd>     " + _("Execute command when the best block changes (%s in cmd is replaced by block hash)") + "\n";
     strUsage += "  -checkblocks=<n>       " + strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 500) + "\n";
     strUsage += "  -checklevel=<n>        " + strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3) + "\n";
+    strUsage += "  -compressundo          " + strprintf(_("Compress newly written block undo data, cutting rev*.dat size and write bandwidth; old records stay readable either way (default: %u)"), 1) + "\n";
     strUsage += "  -conf=<file>           " + strprintf(_("Specify configuration file (default: %s)"), "lux.conf") + "\n";
     if (mode == HMM_BITCOIND) {
 #if !defined(WIN32)
@@ -343,9 +361,22 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += "  -datadir=<dir>         " + _("Specify data directory") + "\n";
     strUsage += "  -dbcache=<n>           " + strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache) + "\n";
+    strUsage += "  -evmcachesize=<n>      " + strprintf(_("Set EVM state trie node and contract code cache size in megabytes, 0 to disable (default: %d)"), DEFAULT_EVM_CACHE_SIZE_MB) + "\n";
+    strUsage += "  -ldbbloombits=<n>      " + strprintf(_("Bloom filter bits per key for the leveldb databases, 0 to disable (default: %u)"), DEFAULT_LDB_BLOOM_BITS) + "\n";
+    strUsage += "  -ldbblocksize=<n>      " + _("Uncompressed block size for the leveldb databases in bytes (default: leveldb default)") + "\n";
+    strUsage += "  -blockfilesyncwindow=<n> " + _("Batch block file fsyncs to at most one per <n> seconds; a crash inside the window may require -reindex (0 = sync every flush, default: 0)") + "\n";
+    strUsage += "  -ldbcompress           " + _("Store leveldb blocks snappy-compressed (default: 0)") + "\n";
+    strUsage += "  -ldbmaxopenfiles=<n>   " + strprintf(_("Max open files per leveldb database (default: %u)"), DEFAULT_LDB_MAX_OPEN_FILES) + "\n";
+    strUsage += "  -ldb<db>-<opt>=<n>     " + _("Override one of the -ldb* options for a single database (chainstate, blockindex or storageresults), e.g. -ldbchainstate-bloombits=16") + "\n";
     strUsage += "  -loadblock=<file>      " + _("Imports blocks from external blk000??.dat file") + " " + _("on startup") + "\n";
+    strUsage += "  -maxmempool=<n>        " + strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE) + "\n";
     strUsage += "  -maxorphantx=<n>       " + strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS) + "\n";
-    strUsage += "  -par=<n>               " + strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS) + "\n";
+    strUsage += "  -mempoolexpiry=<n>     " + strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY) + "\n";
+    strUsage += "  -numanodenet=<n>       " + _("Pin networking threads to NUMA node <n> (Linux only, default: no pinning)") + "\n";
+    strUsage += "  -numanodevalidation=<n> " + _("Pin script verification threads to NUMA node <n> (Linux only, default: no pinning)") + "\n";
+    strUsage += "  -par=<n>               " + strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS) + "\n";
+    strUsage += "  -schedulerthreads=<n>  " + strprintf(_("Set the number of threads servicing the background task scheduler (default: %u)"), 2) + "\n";
+    strUsage += "  -persistmempool        " + strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL) + "\n";
 #ifndef WIN32
     strUsage += "  -pid=<file>            " + strprintf(_("Specify pid file (default: %s)"), "luxd.pid") + "\n";
 #endif
@@ -356,10 +387,14 @@ std::string HelpMessage(HelpMessageMode mode)
                                               strprintf(_(">%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024) + "\n";
     strUsage += "  -reindex-chainstate    " + _("Rebuild chain state from the currently indexed blocks") + "\n";
     strUsage += "  -reindex               " + _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup") + "\n";
+    strUsage += "  -reindexthreads=<n>    " + strprintf(_("Number of threads used to decode blocks during -reindex and -loadblock (0 = auto, default: %u)"), 0) + "\n";
 #if !defined(WIN32)
     strUsage += "  -sysperms              " + _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)") + "\n";
 #endif
     strUsage += "  -txindex               " + strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), 0) + "\n";
+    strUsage += "  -addressindex          " + strprintf(_("Maintain a full address index, used by the getaddresstxids, getaddressdeltas and getaddressbalance rpc calls (default: %u)"), 0) + "\n";
+    strUsage += "  -spentindex            " + strprintf(_("Maintain a full spent index, used by the getspentinfo rpc call (default: %u)"), 0) + "\n";
+    strUsage += "  -utxosethash           " + strprintf(_("Maintain a rolling hash of the UTXO set, reported by the gettxoutsetinfo rpc call (default: %u)"), 0) + "\n";
 
     strUsage += "  -logevents             " + strprintf(_("Maintain a full EVM log index, used by searchlogs and gettransactionreceipt rpc calls (default: %u)"), false) + "\n";
 
@@ -369,6 +404,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -bantime=<n>           " + strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), 86400) + "\n";
     strUsage += "  -bind=<addr>           " + _("Bind to given address and always listen on it. Use [host]:port notation for IPv6") + "\n";
     strUsage += "  -connect=<ip>          " + _("Connect only to the specified node(s)") + "\n";
+    strUsage += "  -connectbatch=<n>      " + strprintf(_("Number of outbound connection attempts to run in parallel (default: %u)"), 4) + "\n";
     strUsage += "  -discover              " + _("Discover own IP address (default: 1 when listening and no -externalip)") + "\n";
     strUsage += "  -dns                   " + _("Allow DNS lookups for -addnode, -seednode and -connect") + " " + _("(default: 1)") + "\n";
     strUsage += "  -dnsseed               " + _("Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect)") + "\n";
@@ -378,6 +414,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -maxconnections=<n>    " + strprintf(_("Maintain at most <n> connections to peers (default: %u)"), 125) + "\n";
     strUsage += "  -maxreceivebuffer=<n>  " + strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000) + "\n";
     strUsage += "  -maxsendbuffer=<n>     " + strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000) + "\n";
+    strUsage += "  -maxuploadtarget=<n>   " + strprintf(_("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %u). Historical block serving is cut off first; whitelisted peers are exempt"), 0) + "\n";
+    strUsage += "  -msghandlerthreads=<n> " + strprintf(_("Number of message handler threads peers are sharded across (1 to %d, default: %d)"), MAX_MSGHANDLER_THREADS, DEFAULT_MSGHANDLER_THREADS) + "\n";
     strUsage += "  -onion=<ip:port>       " + strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy") + "\n";
     strUsage += "  -onlynet=<net>         " + _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)") + "\n";
     strUsage += "  -permitbaremultisig    " + strprintf(_("Relay non-P2SH multisig (default: %u)"), 1) + "\n";
@@ -385,7 +423,13 @@ std::string HelpMessage(HelpMessageMode mode)
                 strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), 26969, 28333) + "\n";
     strUsage += "  -proxy=<ip:port>       " + _("Connect through SOCKS5 proxy") + "\n";
     strUsage += "  -seednode=<ip>         " + _("Connect to a node to retrieve peer addresses, and disconnect") + "\n";
+    strUsage += "  -tcpfastopen           " + _("Use TCP Fast Open for outgoing connections where the kernel supports it (default: 0)") + "\n";
+    strUsage += "  -tcprcvbuf=<n>         " + _("Socket receive buffer size for peer connections in bytes (default: OS default)") + "\n";
+    strUsage += "  -tcpsndbuf=<n>         " + _("Socket send buffer size for peer connections in bytes (default: OS default)") + "\n";
+    strUsage += "  -mntcprcvbuf=<n>       " + _("Socket receive buffer size for masternode links in bytes (default: -tcprcvbuf)") + "\n";
+    strUsage += "  -mntcpsndbuf=<n>       " + _("Socket send buffer size for masternode links in bytes (default: -tcpsndbuf)") + "\n";
     strUsage += "  -timeout=<n>           " + strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT) + "\n";
+    strUsage += "  -trustedleader=<netmask> " + _("Hot-standby follower mode: blocks relayed by peers in the given netmask connect without re-executing scripts. All other consensus checks still run. Only point this at your own validators over a private, authenticated link. Can be specified multiple times.") + "\n";
 #ifdef USE_UPNP
 #if USE_UPNP
     strUsage += "  -upnp                  " + _("Use UPnP to map the listening port (default: 1 when listening)") + "\n";
@@ -395,6 +439,8 @@ std::string HelpMessage(HelpMessageMode mode)
 #endif
     strUsage += "  -whitebind=<addr>      " + _("Bind to given address and whitelist peers connecting to it. Use [host]:port notation for IPv6") + "\n";
     strUsage += "  -whitelist=<netmask>   " + _("Whitelist peers connecting from the given netmask or IP address. Can be specified multiple times.") + "\n";
+    strUsage += "  -cutthroughrelay       " + strprintf(_("Relay accepted blocks to whitelisted peers before connect validation finishes. Only for private topologies where both ends are trusted (default: %u)"), 0) + "\n";
+    strUsage += "  -mempoolsync           " + strprintf(_("Periodically reconcile the mempool with whitelisted peers over short transaction ids, so a fleet of trusted nodes converges without full re-relay (default: %u)"), 0) + "\n";
     strUsage += "                         " + _("Whitelisted peers cannot be DoS banned and their transactions are always relayed, even if they are already in the mempool, useful e.g. for a gateway") + "\n";
 
 #ifdef ENABLE_WALLET
@@ -406,14 +452,18 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += "  -mintxfee=<amt>          " + strprintf(_("Fees (in LUX/Kb) smaller than this are considered zero fee for transaction creation (default: %s)"), FormatMoney(CWallet::minTxFee.GetFeePerK())) + "\n";
     strUsage += "  -paytxfee=<amt>          " + strprintf(_("Fee (in LUX/kB) to add to transactions you send (default: %s)"), FormatMoney(payTxFee.GetFeePerK())) + "\n";
     strUsage += "  -rescan                  " + _("Rescan the block chain for missing wallet transactions") + " " + _("on startup") + "\n";
+    strUsage += "  -rescanthreads=<n>       " + strprintf(_("Number of threads used to scan blocks during a wallet rescan (0 = auto, default: %u)"), 0) + "\n";
     strUsage += "  -salvagewallet           " + _("Attempt to recover private keys from a corrupt wallet.dat") + " " + _("on startup") + "\n";
     strUsage += "  -sendfreetransactions    " + strprintf(_("Send transactions as zero-fee transactions if possible (default: %u)"), 0) + "\n";
     strUsage += "  -spendzeroconfchange     " + strprintf(_("Spend unconfirmed change when sending transactions (default: %u)"), 1) + "\n";
     strUsage += "  -staking                 " + strprintf(_("Stake your coins to support network and gain reward (default: %s)"), DEFAULT_STAKE ? "true":"false") + "\n";
+    strUsage += "  -stakesweep              " + strprintf(_("Precompute the kernel timestamp schedule once per tip so the staking thread idles between blocks (default: %u)"), 1) + "\n";
     strUsage += "  -txconfirmtarget=<n>     " + strprintf(_("If paytxfee is not set, include enough fee so transactions begin confirmation on average within n blocks (default: %u)"), 1) + "\n";
     strUsage += "  -maxtxfee=<amt>          " + strprintf(_("Maximum total fees to use in a single wallet transaction, setting too low may abort large transactions (default: %s)"), FormatMoney(maxTxFee)) + "\n";
     strUsage += "  -upgradewallet           " + _("Upgrade wallet to latest format") + " " + _("on startup") + "\n";
     strUsage += "  -wallet=<file>           " + _("Specify wallet file (within data directory)") + " " + strprintf(_("(default: %s)"), "wallet.dat") + "\n";
+    strUsage += "  -walletlog               " + _("Create new wallet files in the append-log format (loads much faster on large wallets; existing files keep their format)") + strprintf(" (default: %u)", 0) + "\n";
+    strUsage += "  -walletreadonly          " + _("Open the wallet as an immutable snapshot: queries are served, anything that would modify the wallet is refused (default: 0)") + "\n";
     strUsage += "  -walletnotify=<cmd>      " + _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)") + "\n";
     if (mode == HMM_BITCOIN_QT)
         strUsage += "  -windowtitle=<name>  " + _("Wallet window title") + "\n";
@@ -457,11 +507,21 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -help-debug            " + _("Show all debugging options (usage: --help -help-debug)") + "\n";
     strUsage += "  -logips                " + strprintf(_("Include IP addresses in debug output (default: %u)"), 0) + "\n";
     strUsage += "  -logtimestamps         " + strprintf(_("Prepend debug output with timestamp (default: %u)"), 1) + "\n";
+    strUsage += "  -binlog                " + strprintf(_("Capture all debug categories into a binary event log (binlog.dat) instead of debug.log; decode with contrib/binlog/binlog-reader.py (default: %u)"), 0) + "\n";
+    strUsage += "  -asyncnotify           " + strprintf(_("Deliver wallet, ZMQ and GUI notifications from a background thread instead of inside validation (default: %u)"), 0) + "\n";
+    strUsage += "  -txtrace               " + strprintf(_("Emit per-transaction correlation spans (net receive, mempool, relay, wallet sync, zmq) to the trace log category (default: %u)"), 0) + "\n";
     if (GetBoolArg("-help-debug", false)) {
         strUsage += "  -limitfreerelay=<n>    " + strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), 15) + "\n";
         strUsage += "  -relaypriority         " + strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), 1) + "\n";
         strUsage += "  -maxsigcachesize=<n>   " + strprintf(_("Limit size of signature cache to <n> entries (default: %u)"), 50000) + "\n";
     }
+    strUsage += "  -compressblockfiles    " + strprintf(_("Store newly written blocks in a compact compressed format to save disk space; existing block files stay readable either way (default: %u)"), DEFAULT_COMPRESS_BLOCK_FILES) + "\n";
+    strUsage += "  -undocachedepth=<n>    " + strprintf(_("Keep the undo data of the last <n> blocks in memory so short reorgs avoid disk reads, 0 to disable (default: %u)"), DEFAULT_UNDO_CACHE_DEPTH) + "\n";
+    strUsage += "  -perfstats             " + strprintf(_("Collect timing counters for instrumented hot paths, readable via getperfstats (default: %u)"), 0) + "\n";
+    if (GetBoolArg("-help-debug", false)) {
+        strUsage += "  -statsd=<host:port>    " + _("Emit perf counters to a statsd daemon over UDP (requires -perfstats)") + "\n";
+        strUsage += "  -statsdinterval=<n>    " + strprintf(_("Interval between statsd flushes, in seconds (default: %u)"), 60) + "\n";
+    }
     strUsage += "  -minrelaytxfee=<amt>   " + strprintf(_("Fees (in LUX/Kb) smaller than this are considered zero fee for relaying (default: %s)"), FormatMoney(::minRelayTxFee.GetFeePerK())) + "\n";
     strUsage += "  -printtoconsole        " + strprintf(_("Send trace/debug info to console instead of debug.log file (default: %u)"), 0) + "\n";
     if (GetBoolArg("-help-debug", false)) {
@@ -480,6 +540,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -mnconf=<file>             " + strprintf(_("Specify masternode configuration file (default: %s)"), "masternode.conf") + "\n";
     strUsage += "  -mnconflock=<n>            " + strprintf(_("Lock masternodes from masternode configuration file (default: %u)"), 1) + "\n";
     strUsage += "  -masternodeprivkey=<n>     " + _("Set the masternode private key") + "\n";
+    strUsage += "  -mnrelaypriority=<n>       " + strprintf(_("Relay inventory to masternode peers immediately instead of trickling (default: %u)"), 1) + "\n";
     strUsage += "  -masternodeaddr=<n>        " + strprintf(_("Set external address:port to get to this masternode (example: %s)"), "128.127.106.235:51472") + "\n";
     strUsage += "  -budgetvotemode=<mode>     " + _("Change automatic finalized budget voting behavior. mode=auto: Vote for only exact finalized budget match to my generated budget. (string, default: auto)") + "\n";
 
@@ -511,6 +572,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -rpcport=<port>        " + strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), 51473, 51475) + "\n";
     strUsage += "  -rpcallowip=<ip>       " + _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times") + "\n";
     strUsage += "  -rpcthreads=<n>        " + strprintf(_("Set the number of threads to service RPC calls (default: %d)"), 4) + "\n";
+    strUsage += "  -rpcheavythreads=<n>   " + strprintf(_("Set the number of threads reserved for long-running RPC calls, 0 to serve them from the regular threads (default: %d)"), 2) + "\n";
     strUsage += "  -rpckeepalive          " + strprintf(_("RPC support for HTTP persistent connections (default: %d)"), 1) + "\n";
 
     strUsage += "\n" + _("RPC SSL options: (see the Bitcoin Wiki for SSL setup instructions)") + "\n";
@@ -637,6 +699,11 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         LogPrintf("Stopping after block import\n");
         StartShutdown();
     }
+
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        LoadMempool();
+        fDumpMempoolLater = !fRequestShutdown;
+    }
 }
 
 static bool LockDataDirectory(bool probeOnly, bool try_lock = true)
@@ -680,6 +747,186 @@ bool InitSanityCheck(void)
 }
 
 
+#ifdef ENABLE_WALLET
+/**
+ * Backup the wallet file and verify the wallet database environment.
+ * Split out of AppInit2 so the (I/O bound) BDB verification can run
+ * concurrently with the block index load; only touches the database
+ * environment, never the wallet or the block index. On failure returns
+ * false with strErrorRet set; strWarningRet carries non-fatal salvage
+ * warnings. Both are displayed by the main thread after the join.
+ */
+static bool VerifyWalletDatabase(const std::string& strWalletFile, std::string& strWarningRet, std::string& strErrorRet)
+{
+    std::string strDataDir = GetDataDir().string();
+    filesystem::path backupDir = GetDataDir() / "backups";
+    if (!filesystem::exists(backupDir)) {
+        // Always create backup folder to not confuse the operating system's file browser
+        filesystem::create_directories(backupDir);
+    }
+    nWalletBackups = GetArg("-createwalletbackups", 10);
+    nWalletBackups = std::max(0, std::min(10, nWalletBackups));
+    if (nWalletBackups > 0) {
+        if (filesystem::exists(backupDir)) {
+            // Create backup of the wallet
+            std::string dateTimeStr = DateTimeStrFormat(".%Y-%m-%d-%H-%M", GetTime());
+            std::string backupPathStr = backupDir.string();
+            backupPathStr += "/" + strWalletFile;
+            std::string sourcePathStr = GetDataDir().string();
+            sourcePathStr += "/" + strWalletFile;
+            boost::filesystem::path sourceFile = sourcePathStr;
+            boost::filesystem::path backupFile = backupPathStr + dateTimeStr;
+            sourceFile.make_preferred();
+            backupFile.make_preferred();
+            if (boost::filesystem::exists(sourceFile)) {
+#if BOOST_VERSION >= 158000
+                try {
+                    boost::filesystem::copy_file(sourceFile, backupFile);
+                    LogPrintf("Creating backup of %s -> %s\n", sourceFile, backupFile);
+                } catch (boost::filesystem::filesystem_error& error) {
+                    LogPrintf("Failed to create backup %s\n", error.what());
+                }
+#else
+                std::ifstream src(sourceFile.string(), std::ios::binary);
+                std::ofstream dst(backupFile.string(), std::ios::binary);
+                dst << src.rdbuf();
+#endif
+            }
+            // Keep only the last 10 backups, including the new one of course
+            typedef std::multimap<std::time_t, boost::filesystem::path> folder_set_t;
+            folder_set_t folder_set;
+            boost::filesystem::directory_iterator end_iter;
+            boost::filesystem::path backupFolder = backupDir.string();
+            backupFolder.make_preferred();
+            // Build map of backup files for current(!) wallet sorted by last write time
+            boost::filesystem::path currentFile;
+            for (boost::filesystem::directory_iterator dir_iter(backupFolder); dir_iter != end_iter; ++dir_iter) {
+                // Only check regular files
+                if (boost::filesystem::is_regular_file(dir_iter->status())) {
+                    currentFile = dir_iter->path().filename();
+                    // Only add the backups for the current wallet, e.g. wallet.dat.*
+                    if (dir_iter->path().stem().string() == strWalletFile) {
+                        folder_set.insert(folder_set_t::value_type(boost::filesystem::last_write_time(dir_iter->path()), *dir_iter));
+                    }
+                }
+            }
+            // Loop backward through backup files and keep the N newest ones (1 <= N <= 10)
+            int counter = 0;
+            BOOST_REVERSE_FOREACH (PAIRTYPE(const std::time_t, boost::filesystem::path) file, folder_set) {
+                counter++;
+                if (counter > nWalletBackups) {
+                    // More than nWalletBackups backups: delete oldest one(s)
+                    try {
+                        boost::filesystem::remove(file.second);
+                        LogPrintf("Old backup deleted: %s\n", file.second);
+                    } catch (boost::filesystem::filesystem_error& error) {
+                        LogPrintf("Failed to delete backup %s\n", error.what());
+                    }
+                }
+            }
+        }
+    }
+
+    if (CWalletRecordLog::IsLogFile((GetDataDir() / strWalletFile).string())) {
+        // Append-log wallets checksum every record and drop partial tails on
+        // load; Berkeley DB salvage and verification do not apply to them.
+        return true;
+    }
+
+    if (!bitdb.Open(GetDataDir())) {
+        // try moving the database env out of the way
+        boost::filesystem::path pathDatabase = GetDataDir() / "database";
+        boost::filesystem::path pathDatabaseBak = GetDataDir() / strprintf("database.%d.bak", GetTime());
+        try {
+            boost::filesystem::rename(pathDatabase, pathDatabaseBak);
+            LogPrintf("Moved old %s to %s. Retrying.\n", pathDatabase.string(), pathDatabaseBak.string());
+        } catch (boost::filesystem::filesystem_error& error) {
+            // failure is ok (well, not really, but it's not worse than what we started with)
+        }
+
+        int max_tries = 10;
+        bool isSuccess = false;
+        // try again
+        while (max_tries > 0)
+        {
+            if (bitdb.Open(GetDataDir())) {
+                isSuccess = true;
+                break;
+            }
+
+            max_tries--;
+            MilliSleep(300);
+        }
+
+        if (!isSuccess)
+        {
+            // if it still fails, it probably means we can't even create the database env
+            strErrorRet = strprintf(_("Error initializing wallet database environment %s!"), strDataDir);
+            return false;
+        }
+    }
+
+    if (GetBoolArg("-salvagewallet", false)) {
+        // Recover readable keypairs:
+        if (!CWalletDB::Recover(bitdb, strWalletFile, true))
+            return false;
+    }
+
+    if (filesystem::exists(GetDataDir() / strWalletFile)) {
+        CDBEnv::VerifyResult r = bitdb.Verify(strWalletFile, CWalletDB::Recover);
+        if (r == CDBEnv::RECOVER_OK) {
+            strWarningRet = strprintf(_("Warning: wallet.dat corrupt, data salvaged!"
+                                        " Original wallet.dat saved as wallet.{timestamp}.bak in %s; if"
+                                        " your balance or transactions are incorrect you should"
+                                        " restore from a backup."),
+                strDataDir);
+        }
+        if (r == CDBEnv::RECOVER_FAIL) {
+            strErrorRet = _("wallet.dat corrupt, salvage failed");
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif // ENABLE_WALLET
+
+/**
+ * Startup reads that do not depend on the block index: the fee estimate
+ * file and (when enabled) the wallet database verification. Run on a side
+ * thread so they overlap the block index load; AppInit2 joins this thread
+ * before the wallet itself is loaded.
+ */
+static void ThreadSideLoad(bool fVerifyWallet, std::string strWalletFile, bool* pfWalletOkRet, std::string* pstrWarningRet, std::string* pstrErrorRet)
+{
+    RenameThread("lux-sideload");
+
+    boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
+    CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    // Allowed to fail as this file IS missing on first startup.
+    if (!est_filein.IsNull())
+        mempool.ReadFeeEstimates(est_filein);
+
+#ifdef ENABLE_WALLET
+    if (fVerifyWallet)
+        *pfWalletOkRet = VerifyWalletDatabase(strWalletFile, *pstrWarningRet, *pstrErrorRet);
+#endif
+}
+
+namespace
+{
+//! Joins the side-load thread on every path out of AppInit2, so early
+//! error returns never leave it running against stack-allocated results.
+struct CSideLoadJoiner {
+    boost::thread thread;
+    ~CSideLoadJoiner()
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+};
+} // anon namespace
+
 /** Initialize lux.
  *  @pre Parameters should be parsed and config file should be read.
  */
@@ -811,6 +1058,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             LogPrintf("AppInit2 : parameter interaction: -zapwallettxes=<mode> -> setting -rescan=1\n");
     }
 
+    // a read-only wallet cannot stake, rewrite itself or be flushed
+    if (GetBoolArg("-walletreadonly", false)) {
+        if (GetBoolArg("-zapwallettxes", false) || GetBoolArg("-salvagewallet", false) || GetBoolArg("-rescan", false) || GetBoolArg("-upgradewallet", false))
+            return InitError(_("-walletreadonly is incompatible with -zapwallettxes, -salvagewallet, -rescan and -upgradewallet."));
+        if (SoftSetBoolArg("-staking", false))
+            LogPrintf("AppInit2 : parameter interaction: -walletreadonly -> setting -staking=0\n");
+        if (SoftSetBoolArg("-flushwallet", false))
+            LogPrintf("AppInit2 : parameter interaction: -walletreadonly -> setting -flushwallet=0\n");
+    }
+
     if (!GetBoolArg("-enableinstantx", fEnableInstanTX)) {
         if (SoftSetArg("-instantxdepth", 0))
             LogPrintf("AppInit2 : parameter interaction: -enableinstantx=false -> setting -nInstanTXDepth=0\n");
@@ -836,9 +1093,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (nFD - MIN_CORE_FILEDESCRIPTORS < nMaxConnections)
         nMaxConnections = nFD - MIN_CORE_FILEDESCRIPTORS;
 
+    CNode::SetMaxOutboundTarget(GetArg("-maxuploadtarget", 0) * 1024 * 1024);
+
     if (GetArg("-prune", 0)) {
         if (GetBoolArg("-txindex", false))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (GetBoolArg("-addressindex", false) || GetBoolArg("-spentindex", false))
+            return InitError(_("Prune mode is incompatible with -addressindex and -spentindex."));
 #ifdef ENABLE_WALLET
         if (!GetBoolArg("-disablewallet", false)) {
             if (SoftSetBoolArg("-disablewallet", true))
@@ -878,18 +1139,37 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     Checkpoints::fEnabled = GetBoolArg("-checkpoints", true);
 
+    if (IsArgSet("-assumevalid")) {
+        hashAssumeValid = uint256S(GetArg("-assumevalid", ""));
+        if (!hashAssumeValid.IsNull())
+            LogPrintf("Assuming ancestors of block %s have valid signatures.\n", hashAssumeValid.GetHex());
+        else
+            LogPrintf("Validating signatures for all blocks.\n");
+    }
+
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (nScriptCheckThreads <= 0)
-        nScriptCheckThreads += boost::thread::hardware_concurrency();
+        nScriptCheckThreads += GetNumCores();
     if (nScriptCheckThreads <= 1)
         nScriptCheckThreads = 0;
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
     fServer = GetBoolArg("-server", false);
+    fPerfStats = GetBoolArg("-perfstats", false);
+    fBinaryLog = GetBoolArg("-binlog", false);
+    fQueuedNotifications = GetBoolArg("-asyncnotify", false);
+    fUtxoSetHash = GetBoolArg("-utxosethash", false);
+    fTxTrace = GetBoolArg("-txtrace", false);
     setvbuf(stdout, NULL, _IOLBF, 0); /// ***TODO*** do we still need this after -printtoconsole is gone?
 
+    // -maxmempool must leave room for at least a few non-trivial packages,
+    // otherwise every transaction is immediately evicted again.
+    int64_t nMempoolSizeLimit = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE);
+    if (nMempoolSizeLimit < 1)
+        return InitError(_("-maxmempool must be at least 1 MB"));
+
     int64_t nSignedPruneTarget = GetArg("-prune", 0) * 1024 * 1024;
     if (nSignedPruneTarget < 0) {
         return InitError(_("Prune cannot be configured with a negative value."));
@@ -991,6 +1271,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
 
+    // Pick the fastest SHA256 implementation the CPU supports
+    LogPrintf("Using the '%s' SHA256 implementation\n", SHA256AutoDetect());
+
     // Sanity check
     if (!InitSanityCheck())
         return InitError(_("Initialization sanity check failed. Luxcore is shutting down."));
@@ -1048,9 +1331,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             return InitError(_("Unable to sign spork message, wrong key?"));
     }
 
-    // Start the lightweight task scheduler thread
+    // Start the task scheduler worker pool. Two threads by default so a
+    // slow low-priority task (wallet flush, addrman dump) cannot delay a
+    // due high-priority one.
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    int nSchedulerThreads = std::max<int64_t>(1, GetArg("-schedulerthreads", 2));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
@@ -1078,134 +1365,27 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nStart = 0;
 
 // ********************************************************* Step 5: Backup wallet and verify wallet database integrity
+    // The wallet database verification and the fee estimate read only touch
+    // their own files and are independent of the block index load in Step 7;
+    // run them on a side thread and join before the wallet is loaded in
+    // Step 8, so the serialized I/O of the two biggest startup steps
+    // overlaps instead of adding up.
 #ifdef ENABLE_WALLET
-    if (!fDisableWallet) {
-        filesystem::path backupDir = GetDataDir() / "backups";
-        if (!filesystem::exists(backupDir)) {
-            // Always create backup folder to not confuse the operating system's file browser
-            filesystem::create_directories(backupDir);
-        }
-        nWalletBackups = GetArg("-createwalletbackups", 10);
-        nWalletBackups = std::max(0, std::min(10, nWalletBackups));
-        if (nWalletBackups > 0) {
-            if (filesystem::exists(backupDir)) {
-                // Create backup of the wallet
-                std::string dateTimeStr = DateTimeStrFormat(".%Y-%m-%d-%H-%M", GetTime());
-                std::string backupPathStr = backupDir.string();
-                backupPathStr += "/" + strWalletFile;
-                std::string sourcePathStr = GetDataDir().string();
-                sourcePathStr += "/" + strWalletFile;
-                boost::filesystem::path sourceFile = sourcePathStr;
-                boost::filesystem::path backupFile = backupPathStr + dateTimeStr;
-                sourceFile.make_preferred();
-                backupFile.make_preferred();
-                if (boost::filesystem::exists(sourceFile)) {
-#if BOOST_VERSION >= 158000
-                    try {
-                        boost::filesystem::copy_file(sourceFile, backupFile);
-                        LogPrintf("Creating backup of %s -> %s\n", sourceFile, backupFile);
-                    } catch (boost::filesystem::filesystem_error& error) {
-                        LogPrintf("Failed to create backup %s\n", error.what());
-                    }
-#else
-                    std::ifstream src(sourceFile.string(), std::ios::binary);
-                    std::ofstream dst(backupFile.string(), std::ios::binary);
-                    dst << src.rdbuf();
-#endif
-                }
-                // Keep only the last 10 backups, including the new one of course
-                typedef std::multimap<std::time_t, boost::filesystem::path> folder_set_t;
-                folder_set_t folder_set;
-                boost::filesystem::directory_iterator end_iter;
-                boost::filesystem::path backupFolder = backupDir.string();
-                backupFolder.make_preferred();
-                // Build map of backup files for current(!) wallet sorted by last write time
-                boost::filesystem::path currentFile;
-                for (boost::filesystem::directory_iterator dir_iter(backupFolder); dir_iter != end_iter; ++dir_iter) {
-                    // Only check regular files
-                    if (boost::filesystem::is_regular_file(dir_iter->status())) {
-                        currentFile = dir_iter->path().filename();
-                        // Only add the backups for the current wallet, e.g. wallet.dat.*
-                        if (dir_iter->path().stem().string() == strWalletFile) {
-                            folder_set.insert(folder_set_t::value_type(boost::filesystem::last_write_time(dir_iter->path()), *dir_iter));
-                        }
-                    }
-                }
-                // Loop backward through backup files and keep the N newest ones (1 <= N <= 10)
-                int counter = 0;
-                BOOST_REVERSE_FOREACH (PAIRTYPE(const std::time_t, boost::filesystem::path) file, folder_set) {
-                    counter++;
-                    if (counter > nWalletBackups) {
-                        // More than nWalletBackups backups: delete oldest one(s)
-                        try {
-                            boost::filesystem::remove(file.second);
-                            LogPrintf("Old backup deleted: %s\n", file.second);
-                        } catch (boost::filesystem::filesystem_error& error) {
-                            LogPrintf("Failed to delete backup %s\n", error.what());
-                        }
-                    }
-                }
-            }
-        }
-
+    bool fVerifyWallet = !fDisableWallet;
+    if (fVerifyWallet) {
         LogPrintf("Using wallet %s\n", strWalletFile);
         uiInterface.InitMessage(_("Verifying wallet..."));
+    }
+#else
+    bool fVerifyWallet = false;
+    std::string strWalletFile;
+#endif
+    bool fWalletVerifyOk = true;
+    std::string strWalletWarning;
+    std::string strWalletError;
+    CSideLoadJoiner sideLoad;
+    sideLoad.thread = boost::thread(boost::bind(ThreadSideLoad, fVerifyWallet, strWalletFile, &fWalletVerifyOk, &strWalletWarning, &strWalletError));
 
-        if (!bitdb.Open(GetDataDir())) {
-            // try moving the database env out of the way
-            boost::filesystem::path pathDatabase = GetDataDir() / "database";
-            boost::filesystem::path pathDatabaseBak = GetDataDir() / strprintf("database.%d.bak", GetTime());
-            try {
-                boost::filesystem::rename(pathDatabase, pathDatabaseBak);
-                LogPrintf("Moved old %s to %s. Retrying.\n", pathDatabase.string(), pathDatabaseBak.string());
-            } catch (boost::filesystem::filesystem_error& error) {
-                // failure is ok (well, not really, but it's not worse than what we started with)
-            }
-
-            int max_tries = 10;
-            bool isSuccess = false;
-            // try again
-            while (max_tries > 0)
-            {
-                if (bitdb.Open(GetDataDir())) {
-                    isSuccess = true;
-                    break;
-                }
-
-                max_tries--;
-                MilliSleep(300);
-            }
-
-            if (!isSuccess)
-            {
-                // if it still fails, it probably means we can't even create the database env
-                string msg = strprintf(_("Error initializing wallet database environment %s!"), strDataDir);
-                return InitError(msg);
-            }
-        }
-
-        if (GetBoolArg("-salvagewallet", false)) {
-            // Recover readable keypairs:
-            if (!CWalletDB::Recover(bitdb, strWalletFile, true))
-                return false;
-        }
-
-        if (filesystem::exists(GetDataDir() / strWalletFile)) {
-            CDBEnv::VerifyResult r = bitdb.Verify(strWalletFile, CWalletDB::Recover);
-            if (r == CDBEnv::RECOVER_OK) {
-                string msg = strprintf(_("Warning: wallet.dat corrupt, data salvaged!"
-                                         " Original wallet.dat saved as wallet.{timestamp}.bak in %s; if"
-                                         " your balance or transactions are incorrect you should"
-                                         " restore from a backup."),
-                    strDataDir);
-                InitWarning(msg);
-            }
-            if (r == CDBEnv::RECOVER_FAIL)
-                return InitError(_("wallet.dat corrupt, salvage failed"));
-        }
-
-    }  // (!fDisableWallet)
-#endif // ENABLE_WALLET
     // ********************************************************* Step 6: network initialization
 
     RegisterNodeSignals(GetNodeSignals());
@@ -1234,6 +1414,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    if (mapArgs.count("-trustedleader")) {
+        BOOST_FOREACH (const std::string& net, mapMultiArgs["-trustedleader"]) {
+            CSubNet subnet(net);
+            if (!subnet.IsValid())
+                return InitError(strprintf(_("Invalid netmask specified in -trustedleader: '%s'"), net));
+            CNode::AddTrustedLeaderRange(subnet);
+            LogPrintf("Following trusted leader range %s: blocks it relays connect without script re-execution\n", subnet.ToString());
+        }
+    }
+
     CService addrProxy;
     bool fProxy = false;
     if (mapArgs.count("-proxy")) {
@@ -1265,6 +1455,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     fListen = GetBoolArg("-listen", DEFAULT_LISTEN);
     fDiscover = GetBoolArg("-discover", true);
     fNameLookup = GetBoolArg("-dns", true);
+    fMasternodeRelayPriority = GetBoolArg("-mnrelaypriority", true);
 
     bool fBound = false;
     if (fListen) {
@@ -1316,7 +1507,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // ********************************************************* Step 7: load block chain
 
     fReindex = GetBoolArg("-reindex", false);
-    bool fReindexChainState = GetBoolArg("-reindex-chainstate", false);
+    fReindexChainState = GetBoolArg("-reindex-chainstate", false);
 
     // Upgrading to 0.8; hard-link the old blknnnn.dat files into /blocks/
     filesystem::path blocksDir = GetDataDir() / "blocks";
@@ -1381,6 +1572,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
+                // A leftover mid-flush marker means the last coin cache flush
+                // was interrupted between batches; the chainstate is not
+                // self-consistent and must be rebuilt.
+                if (!fReindex && !fReindexChainState && pcoinsdbview->WasFlushInterrupted()) {
+                    strLoadError = _("The coin database flush was interrupted. You need to rebuild the database using -reindex-chainstate.");
+                    break;
+                }
+
                 if (fReindex) {
                     boost::filesystem::path stateDir = GetDataDir() / "stateLux";
                     StorageResults storageRes(stateDir.string());
@@ -1420,6 +1619,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
                 dev::eth::Ethash::init();
 
+                // size the shared trie-node/code cache before the state DBs open
+                dev::setOverlayDBCacheSize(std::max((int64_t)0, GetArg("-evmcachesize", DEFAULT_EVM_CACHE_SIZE_MB)) << 20);
+
                 boost::filesystem::path luxStateDir = GetDataDir() / "stateLux";
 
                 bool fStatus = boost::filesystem::exists(luxStateDir);
@@ -1443,6 +1645,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 globalState->db().commit();
                 globalState->dbUtxo().commit();
 
+                // detached copy for read-only contract calls: shares the
+                // LevelDB handles but keeps its own overlay and caches
+                globalCallState = std::unique_ptr<LuxState>(new LuxState(dev::u256(0), globalState->db(), globalState->dbUtxo()));
+                globalCallSealEngine = std::shared_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
+                PublishEVMSnapshot();
+
 
                 fRecordLogOpcodes = GetBoolArg("-record-log-opcodes", true);
                 fIsVMlogFile = boost::filesystem::exists(GetDataDir() / "vmExecLogs.json");
@@ -1460,6 +1668,18 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                // Check for changed -addressindex state
+                if (fAddressIndex != GetBoolArg("-addressindex", false)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -addressindex");
+                    break;
+                }
+
+                // Check for changed -spentindex state
+                if (fSpentIndex != GetBoolArg("-spentindex", false)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -spentindex");
+                    break;
+                }
+
                 // Check for changed -logevents state
                 if (fLogEvents != GetBoolArg("-logevents", false) && !fLogEvents) {
                     strLoadError = _("You need to rebuild the database using -reindex-chainstate to enable -logevents");
@@ -1493,6 +1713,27 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     strLoadError = _("Corrupted block database detected");
                     break;
                 }
+
+                if (fUtxoSetHash) {
+                    // Load the persisted rolling UTXO hash; if it is missing
+                    // or belongs to a different chainstate, rebuild it with a
+                    // one-time full scan.
+                    uint256 hashStored, hashBlockStored;
+                    if (pcoinsdbview->ReadUtxoSetHash(hashStored, hashBlockStored) &&
+                        hashBlockStored == pcoinsdbview->GetBestBlock()) {
+                        utxoSetHash.SetHash(hashStored);
+                    } else {
+                        uiInterface.InitMessage(_("Building UTXO set hash..."));
+                        LogPrintf("No UTXO set hash for this chainstate, rebuilding from a full scan...\n");
+                        int64_t nHashStart = GetTimeMillis();
+                        if (pcoinsdbview->ComputeUtxoSetHash(utxoSetHash)) {
+                            pcoinsdbview->WriteUtxoSetHash(utxoSetHash.GetHash(), pcoinsdbview->GetBestBlock());
+                            LogPrintf(" UTXO set hash %15dms\n", GetTimeMillis() - nHashStart);
+                        } else {
+                            LogPrintf("Failed to build the UTXO set hash; gettxoutsetinfo will not report one\n");
+                        }
+                    }
+                }
             } catch (std::exception& e) {
                 LogPrintf("%s\n", e.what());
                 strLoadError = _("Error opening block database");
@@ -1530,17 +1771,20 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
-    boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
-    CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
-    // Allowed to fail as this file IS missing on first startup.
-    if (!est_filein.IsNull())
-        mempool.ReadFeeEstimates(est_filein);
+    // Wait for the Step 5 side thread; its results were written before the join.
+    sideLoad.thread.join();
     fFeeEstimatesInitialized = true;
+#ifdef ENABLE_WALLET
+    if (!strWalletWarning.empty())
+        InitWarning(strWalletWarning);
+    if (!fWalletVerifyOk)
+        return strWalletError.empty() ? false : InitError(strWalletError);
+#endif
 
-    // if prune mode, unset NODE_NETWORK and prune block files
+    // if prune mode, replace NODE_NETWORK with NODE_NETWORK_LIMITED and prune block files
     if (fPruneMode) {
         LogPrintf("Unsetting NODE_NETWORK on prune mode\n");
-        nLocalServices = ServiceFlags(nLocalServices | NODE_NETWORK);
+        nLocalServices = ServiceFlags((nLocalServices & ~NODE_NETWORK) | NODE_NETWORK_LIMITED);
         if (!fReindex) {
             uiInterface.InitMessage(_("Pruning blockstore..."));
             PruneAndFlush();
@@ -1575,6 +1819,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         nStart = GetTimeMillis();
         bool fFirstRun = true;
         pwalletMain = new CWallet(strWalletFile);
+        pwalletMain->fReadOnly = GetBoolArg("-walletreadonly", false);
         DBErrors nLoadWalletRet = pwalletMain->LoadWallet(fFirstRun);
         if (nLoadWalletRet != DB_LOAD_OK) {
             if (nLoadWalletRet == DB_CORRUPT)
@@ -1593,6 +1838,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 strErrors << _("Error loading wallet.dat") << "\n";
         }
 
+        if (pwalletMain->fReadOnly && fFirstRun)
+            return InitError(_("-walletreadonly requires an existing wallet file."));
+
         if (GetBoolArg("-upgradewallet", fFirstRun)) {
             int nMaxVersion = GetArg("-upgradewallet", 0);
             if (nMaxVersion == 0) // the -upgradewallet without argument case
@@ -1624,7 +1872,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         LogPrintf("%s", strErrors.str());
         LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
 
-        RegisterValidationInterface(pwalletMain);
+        // A read-only wallet is never registered for chain notifications and
+        // never caught up to the tip: what was loaded is exactly what is served.
+        if (!pwalletMain->fReadOnly)
+            RegisterValidationInterface(pwalletMain);
+        else
+            LogPrintf("Wallet opened read-only; skipping chain sync\n");
 
         CBlockIndex* pindexRescan = chainActive.Tip();
         if (GetBoolArg("-rescan", false))
@@ -1637,7 +1890,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             else
                 pindexRescan = chainActive.Genesis();
         }
-        if (chainActive.Tip() && chainActive.Tip() != pindexRescan) {
+        if (!pwalletMain->fReadOnly && chainActive.Tip() && chainActive.Tip() != pindexRescan) {
             uiInterface.InitMessage(_("Rescanning..."));
             LogPrintf("Rescanning last %i blocks (from block %i)...\n", chainActive.Height() - pindexRescan->nHeight, pindexRescan->nHeight);
             nStart = GetTimeMillis();
@@ -1789,7 +2042,19 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     darkSendPool.InitCollateralAddress();
 
-    threadGroup.create_thread(boost::bind(&ThreadCheckDarkSendPool));
+    scheduler.scheduleEvery(&CheckDarkSendPool, 2500, "masternode-maint", CScheduler::PRIO_NORMAL, 2000);
+
+    // Move chainstate flushes into idle inter-block gaps where possible so
+    // the hard thresholds in FlushStateToDisk rarely fire mid-validation.
+    scheduler.scheduleEvery(&AdaptiveFlushCheck, 15 * 1000, "adaptive-flush", CScheduler::PRIO_LOW, 1000);
+
+    if (fPerfStats && mapArgs.count("-statsd"))
+        threadGroup.create_thread(&ThreadStatsd);
+
+    if (fBinaryLog)
+        threadGroup.create_thread(&ThreadBinaryLog);
+    if (fQueuedNotifications)
+        threadGroup.create_thread(&ThreadValidationNotifier);
 
     // ********************************************************* Step 11: start node
 
@@ -1825,8 +2090,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         std::atomic<bool> fFlushScheduled(false);
         // Run a thread to flush wallet periodically
         if (!fFlushScheduled.exchange(true)) {
-        scheduler.scheduleEvery(MaybeFlushWalletDB, 500);
+        scheduler.scheduleEvery(MaybeFlushWalletDB, 500, "wallet-flush", CScheduler::PRIO_LOW, 1000);
     }
+        // Cross-check one cached balance aggregate per minute against a full
+        // recomputation; a mismatch means an invalidation was missed somewhere.
+        scheduler.scheduleEvery(boost::bind(&CWallet::VerifyBalanceCaches, pwalletMain), 60 * 1000,
+                                "balance-verify", CScheduler::PRIO_LOW, 1000);
     }
 #endif
 
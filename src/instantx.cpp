@@ -24,6 +24,37 @@ std::map<COutPoint, uint256> mapLockedInputs;
 std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
 int nCompleteTXLocks;
 
+// top-INSTANTX_SIGNATURES_TOTAL quorum per block height, tagged with the
+// masternode list generation it was built from. A flood of ix votes then
+// validates with one map lookup per vote instead of re-ranking the whole
+// masternode list every time.
+static CCriticalSection cs_quorumCache;
+static std::map<int64_t, std::pair<uint64_t, std::map<COutPoint, int> > > mapQuorumCache;
+
+// rank of this masternode within the voting quorum for nBlockHeight, or -1
+// if it isn't a quorum member (unknown, outdated or below the top ranks)
+static int GetQuorumRank(const CTxIn& vinMasternode, int64_t nBlockHeight) {
+    LOCK(cs_quorumCache);
+    uint64_t nGeneration = GetMasternodeListGeneration();
+
+    std::map<int64_t, std::pair<uint64_t, std::map<COutPoint, int> > >::iterator it = mapQuorumCache.find(nBlockHeight);
+    if (it == mapQuorumCache.end() || (*it).second.first != nGeneration) {
+        std::map<COutPoint, int> mapQuorum;
+        for (int rank = 1; rank <= INSTANTX_SIGNATURES_TOTAL; rank++) {
+            int n = GetMasternodeByRank(rank, nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+            if (n == -1) break;
+            LOCK(cs_masternodes);
+            mapQuorum[vecMasternodes[n].vin.prevout] = rank;
+        }
+        it = mapQuorumCache.insert(make_pair(nBlockHeight, make_pair(nGeneration, mapQuorum))).first;
+        (*it).second = make_pair(nGeneration, mapQuorum);
+    }
+
+    std::map<COutPoint, int>::const_iterator mi = (*it).second.second.find(vinMasternode.prevout);
+    if (mi == (*it).second.second.end()) return -1;
+    return (*mi).second;
+}
+
 //txlock - Locks transaction
 //
 //step 1.) Broadcast intention to lock transaction inputs, "txlreg", CTransaction
@@ -255,15 +286,10 @@ int64_t CreateNewLock(CTransaction tx) {
 void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight) {
     if (!fMasterNode) return;
 
-    int n = GetMasternodeRank(activeMasternode.vin, nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+    int n = GetQuorumRank(activeMasternode.vin, nBlockHeight);
 
     if (n == -1) {
-        if (fDebug) LogPrintf("InstantX::DoConsensusVote - Unknown Masternode\n");
-        return;
-    }
-
-    if (n > INSTANTX_SIGNATURES_TOTAL) {
-        if (fDebug) LogPrintf("InstantX::DoConsensusVote - Masternode not in the top %d (%d)\n", INSTANTX_SIGNATURES_TOTAL, n);
+        if (fDebug) LogPrintf("InstantX::DoConsensusVote - Masternode not in the top %d\n", INSTANTX_SIGNATURES_TOTAL);
         return;
     }
     /*
@@ -300,7 +326,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight) {
 
 //received a consensus vote
 bool ProcessConsensusVote(CConsensusVote& ctx) {
-    int n = GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+    int n = GetQuorumRank(ctx.vinMasternode, ctx.nBlockHeight);
 
     int x = GetMasternodeByVin(ctx.vinMasternode);
     if (x != -1) {
@@ -308,13 +334,8 @@ bool ProcessConsensusVote(CConsensusVote& ctx) {
     }
 
     if (n == -1) {
-        //can be caused by past versions trying to vote with an invalid protocol
-        if (fDebug) LogPrintf("InstantX::ProcessConsensusVote - Unknown Masternode\n");
-        return false;
-    }
-
-    if (n > INSTANTX_SIGNATURES_TOTAL) {
-        if (fDebug) LogPrintf("InstantX::ProcessConsensusVote - Masternode not in the top %d (%d) - %s\n", INSTANTX_SIGNATURES_TOTAL, n, ctx.GetHash().ToString().c_str());
+        //unknown masternode, an outdated protocol, or simply not a quorum member for this height
+        if (fDebug) LogPrintf("InstantX::ProcessConsensusVote - Masternode not in the top %d - %s\n", INSTANTX_SIGNATURES_TOTAL, ctx.GetHash().ToString().c_str());
         return false;
     }
 
@@ -430,6 +451,13 @@ int64_t GetAverageVoteTime() {
 void CleanTransactionLocksList() {
     if (chainActive.Tip() == NULL) return;
 
+    {
+        // quorums for long-buried heights can't receive votes anymore
+        LOCK(cs_quorumCache);
+        while (mapQuorumCache.size() > 100)
+            mapQuorumCache.erase(mapQuorumCache.begin());
+    }
+
     std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
 
     while (it != mapTxLocks.end()) {
@@ -515,15 +543,10 @@ bool CConsensusVote::Sign() {
 bool CTransactionLock::SignaturesValid() {
 
     BOOST_FOREACH(CConsensusVote vote, vecConsensusVotes) {
-        int n = GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+        int n = GetQuorumRank(vote.vinMasternode, vote.nBlockHeight);
 
         if (n == -1) {
-            LogPrintf("InstantX::DoConsensusVote - Unknown Masternode\n");
-            return false;
-        }
-
-        if (n > INSTANTX_SIGNATURES_TOTAL) {
-            LogPrintf("InstantX::DoConsensusVote - Masternode not in the top %s\n", INSTANTX_SIGNATURES_TOTAL);
+            LogPrintf("InstantX::DoConsensusVote - Masternode not in the top %d\n", INSTANTX_SIGNATURES_TOTAL);
             return false;
         }
 
@@ -537,7 +560,12 @@ bool CTransactionLock::SignaturesValid() {
 }
 
 void CTransactionLock::AddSignature(CConsensusVote& cv) {
+    // one vote per masternode per claimed height
+    if (!setVotedMasternodes.insert(make_pair(cv.vinMasternode.prevout, cv.nBlockHeight)).second)
+        return;
+
     vecConsensusVotes.push_back(cv);
+    mapVotesByHeight[cv.nBlockHeight]++;
 }
 
 int CTransactionLock::CountSignatures() {
@@ -548,11 +576,6 @@ int CTransactionLock::CountSignatures() {
 
     if (nBlockHeight == 0) return -1;
 
-    int n = 0;
-    BOOST_FOREACH(CConsensusVote v, vecConsensusVotes) {
-        if (v.nBlockHeight == nBlockHeight) {
-            n++;
-        }
-    }
-    return n;
+    std::map<int, int>::const_iterator it = mapVotesByHeight.find(nBlockHeight);
+    return it == mapVotesByHeight.end() ? 0 : (*it).second;
 }
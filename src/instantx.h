@@ -83,6 +83,10 @@ public:
     int nBlockHeight;
     uint256 txHash;
     std::vector<CConsensusVote> vecConsensusVotes;
+    // running vote tally per claimed height plus per-masternode dedup, so
+    // CountSignatures doesn't rescan the vote vector for every incoming vote
+    std::map<int, int> mapVotesByHeight;
+    std::set<std::pair<COutPoint, int> > setVotedMasternodes;
     int nExpiration;
     int nTimeout;
 
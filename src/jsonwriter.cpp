@@ -0,0 +1,124 @@
+// Copyright (c) 2015-2017 The Bitcoin Core developers
+// Copyright (c) 2017 The LUX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonwriter.h"
+
+#include "tinyformat.h"
+
+#include "univalue/univalue_escapes.h"
+
+#include <iomanip>
+#include <sstream>
+
+JSONWriter::JSONWriter(std::string& buf, size_t nReserve) : buffer(buf), fAfterKey(false)
+{
+    if (nReserve)
+        buffer.reserve(buffer.size() + nReserve);
+    // Root scope, so top-level siblings (rare, but legal) get separated too.
+    vfFirstInScope.push_back(true);
+}
+
+void JSONWriter::ValueSeparator()
+{
+    if (fAfterKey) {
+        // Key() already placed the separator for this value.
+        fAfterKey = false;
+        return;
+    }
+    if (vfFirstInScope.back())
+        vfFirstInScope.back() = false;
+    else
+        buffer += ',';
+}
+
+void JSONWriter::WriteEscaped(const std::string& value)
+{
+    for (unsigned int i = 0; i < value.size(); i++) {
+        unsigned char ch = value[i];
+        const char* escStr = escapes[ch];
+        if (escStr)
+            buffer += escStr;
+        else
+            buffer += (char)ch;
+    }
+}
+
+void JSONWriter::BeginObject()
+{
+    ValueSeparator();
+    buffer += '{';
+    vfFirstInScope.push_back(true);
+}
+
+void JSONWriter::EndObject()
+{
+    vfFirstInScope.pop_back();
+    buffer += '}';
+}
+
+void JSONWriter::BeginArray()
+{
+    ValueSeparator();
+    buffer += '[';
+    vfFirstInScope.push_back(true);
+}
+
+void JSONWriter::EndArray()
+{
+    vfFirstInScope.pop_back();
+    buffer += ']';
+}
+
+void JSONWriter::Key(const std::string& name)
+{
+    if (vfFirstInScope.back())
+        vfFirstInScope.back() = false;
+    else
+        buffer += ',';
+    buffer += '"';
+    WriteEscaped(name);
+    buffer += "\":";
+    fAfterKey = true;
+}
+
+void JSONWriter::String(const std::string& value)
+{
+    ValueSeparator();
+    buffer += '"';
+    WriteEscaped(value);
+    buffer += '"';
+}
+
+void JSONWriter::Int(int64_t value)
+{
+    ValueSeparator();
+    buffer += strprintf("%d", value);
+}
+
+void JSONWriter::Double(double value)
+{
+    ValueSeparator();
+    std::ostringstream oss;
+    oss << std::setprecision(16) << value;
+    buffer += oss.str();
+}
+
+void JSONWriter::Bool(bool value)
+{
+    ValueSeparator();
+    buffer += (value ? "true" : "false");
+}
+
+void JSONWriter::Null()
+{
+    ValueSeparator();
+    buffer += "null";
+}
+
+void JSONWriter::Raw(const std::string& json)
+{
+    ValueSeparator();
+    buffer += json;
+}
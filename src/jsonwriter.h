@@ -0,0 +1,59 @@
+// Copyright (c) 2015-2017 The Bitcoin Core developers
+// Copyright (c) 2017 The LUX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_JSONWRITER_H
+#define BITCOIN_JSONWRITER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Append-only JSON serializer writing straight into a caller-owned buffer.
+ *
+ * UniValue builds a full value tree and then re-serializes it recursively,
+ * copying every string at least twice; on large replies (verbose blocks and
+ * their transactions) that allocation churn dominates the RPC handler. A
+ * JSONWriter instead emits tokens into a single string that the caller can
+ * preallocate, so the hot explorer paths serialize in one pass.
+ *
+ * Output is byte-compatible with UniValue::write(): the same escape table is
+ * used and numbers are formatted identically. The writer only tracks enough
+ * state to place separators; callers must emit well-formed sequences, the
+ * same discipline the ported UniValue code already followed.
+ */
+class JSONWriter
+{
+public:
+    //! All output is appended to buf; nReserve preallocates the buffer.
+    explicit JSONWriter(std::string& buf, size_t nReserve = 0);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    //! Emit an object key; must be followed by exactly one value.
+    void Key(const std::string& name);
+
+    void String(const std::string& value);
+    void Int(int64_t value);
+    //! Formats like UniValue::setFloat (ostringstream, setprecision(16)).
+    void Double(double value);
+    void Bool(bool value);
+    void Null();
+    //! Emit pre-serialized JSON verbatim, e.g. UniValue::write() output.
+    void Raw(const std::string& json);
+
+private:
+    //! Emit a comma if a value already preceded this one in the open scope.
+    void ValueSeparator();
+    void WriteEscaped(const std::string& value);
+
+    std::string& buffer;
+    std::vector<bool> vfFirstInScope;
+    bool fAfterKey;
+};
+
+#endif // BITCOIN_JSONWRITER_H
@@ -12,7 +12,40 @@
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 
-static secp256k1_context* secp256k1_context_sign = nullptr;
+#include <boost/thread/tss.hpp>
+
+static void DestroySignContext(secp256k1_context* ctx)
+{
+    if (ctx)
+        secp256k1_context_destroy(ctx);
+}
+
+/**
+ * Signing contexts are per thread: each carries its own randomized blinding
+ * for the generator multiplication tables, so concurrent signers neither
+ * share side-channel state nor make any assumption about the library being
+ * safe to call on one context from several threads at once. Contexts are
+ * created lazily on first use and freed when their thread exits.
+ */
+static boost::thread_specific_ptr<secp256k1_context> ptrSignContext(&DestroySignContext);
+
+static secp256k1_context* GetSignContext()
+{
+    secp256k1_context* ctx = ptrSignContext.get();
+    if (ctx == nullptr) {
+        ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+        assert(ctx != nullptr);
+        {
+            // Pass in a random blinding seed to the secp256k1 context.
+            std::vector<unsigned char, secure_allocator<unsigned char>> vseed(32);
+            GetRandBytes(vseed.data(), 32);
+            bool ret = secp256k1_context_randomize(ctx, vseed.data());
+            assert(ret);
+        }
+        ptrSignContext.reset(ctx);
+    }
+    return ctx;
+}
 
 /** These functions are taken from the libsecp256k1 distribution and are very ugly. */
 static int ec_privkey_import_der(const secp256k1_context* ctx, unsigned char *out32, const unsigned char *privkey, size_t privkeylen) {
@@ -125,7 +158,7 @@ static int ec_privkey_export_der(const secp256k1_context *ctx, unsigned char *pr
 }
 
 bool CKey::Check(const unsigned char* vch) {
-    return secp256k1_ec_seckey_verify(secp256k1_context_sign, vch);
+    return secp256k1_ec_seckey_verify(GetSignContext(), vch);
 }
 
 void CKey::MakeNewKey(bool fCompressedIn) {
@@ -138,7 +171,7 @@ void CKey::MakeNewKey(bool fCompressedIn) {
 
 bool CKey::SetPrivKey(const CPrivKey& privkey, bool fCompressedIn)
 {
-    if (!ec_privkey_import_der(secp256k1_context_sign, (unsigned char*)begin(), &privkey[0], privkey.size()))
+    if (!ec_privkey_import_der(GetSignContext(), (unsigned char*)begin(), &privkey[0], privkey.size()))
         return false;
     fCompressed = fCompressedIn;
     fValid = true;
@@ -158,7 +191,7 @@ CPrivKey CKey::GetPrivKey() const {
     size_t privkeylen;
     privkey.resize(PRIVATE_KEY_SIZE);
     privkeylen = PRIVATE_KEY_SIZE;
-    int ret = ec_privkey_export_der(secp256k1_context_sign, (unsigned char*)&privkey[0], &privkeylen, begin(), fCompressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED);
+    int ret = ec_privkey_export_der(GetSignContext(), (unsigned char*)&privkey[0], &privkeylen, begin(), fCompressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED);
     assert(ret);
     privkey.resize(privkeylen);
     return privkey;
@@ -169,9 +202,9 @@ CPubKey CKey::GetPubKey() const {
     secp256k1_pubkey pubkey;
     CPubKey result;
     size_t clen = 65;
-    int ret = secp256k1_ec_pubkey_create(secp256k1_context_sign, &pubkey, begin());
+    int ret = secp256k1_ec_pubkey_create(GetSignContext(), &pubkey, begin());
     assert(ret);
-    secp256k1_ec_pubkey_serialize(secp256k1_context_sign, (unsigned char*)result.begin(), &clen, &pubkey, fCompressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED);
+    secp256k1_ec_pubkey_serialize(GetSignContext(), (unsigned char*)result.begin(), &clen, &pubkey, fCompressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED);
     assert(result.size() == clen);
     assert(result.IsValid());
     return result;
@@ -185,9 +218,9 @@ bool CKey::Sign(const uint256& hash, std::vector<unsigned char>& vchSig, uint32_
     unsigned char extra_entropy[32] = {0};
     WriteLE32(extra_entropy, test_case);
     secp256k1_ecdsa_signature sig;
-    int ret = secp256k1_ecdsa_sign(secp256k1_context_sign, &sig, hash.begin(), begin(), secp256k1_nonce_function_rfc6979, test_case ? extra_entropy : nullptr);
+    int ret = secp256k1_ecdsa_sign(GetSignContext(), &sig, hash.begin(), begin(), secp256k1_nonce_function_rfc6979, test_case ? extra_entropy : nullptr);
     assert(ret);
-    secp256k1_ecdsa_signature_serialize_der(secp256k1_context_sign, (unsigned char*)vchSig.data(), &nSigLen, &sig);
+    secp256k1_ecdsa_signature_serialize_der(GetSignContext(), (unsigned char*)vchSig.data(), &nSigLen, &sig);
     vchSig.resize(nSigLen);
     return true;
 }
@@ -212,9 +245,9 @@ bool CKey::SignCompact(const uint256& hash, std::vector<unsigned char>& vchSig)
     vchSig.resize(CPubKey::COMPACT_SIGNATURE_SIZE);
     int rec = -1;
     secp256k1_ecdsa_recoverable_signature sig;
-    int ret = secp256k1_ecdsa_sign_recoverable(secp256k1_context_sign, &sig, hash.begin(), begin(), secp256k1_nonce_function_rfc6979, nullptr);
+    int ret = secp256k1_ecdsa_sign_recoverable(GetSignContext(), &sig, hash.begin(), begin(), secp256k1_nonce_function_rfc6979, nullptr);
     assert(ret);
-    secp256k1_ecdsa_recoverable_signature_serialize_compact(secp256k1_context_sign, (unsigned char*)&vchSig[1], &rec, &sig);
+    secp256k1_ecdsa_recoverable_signature_serialize_compact(GetSignContext(), (unsigned char*)&vchSig[1], &rec, &sig);
     assert(ret);
     assert(rec != -1);
     vchSig[0] = 27 + rec + (fCompressed ? 4 : 0);
@@ -222,7 +255,7 @@ bool CKey::SignCompact(const uint256& hash, std::vector<unsigned char>& vchSig)
 }
 
 bool CKey::Load(const CPrivKey& privkey, const CPubKey& vchPubKey, bool fSkipCheck = false) {
-    if (!ec_privkey_import_der(secp256k1_context_sign, (unsigned char*)begin(), privkey.data(), privkey.size()))
+    if (!ec_privkey_import_der(GetSignContext(), (unsigned char*)begin(), privkey.data(), privkey.size()))
         return false;
     fCompressed = vchPubKey.IsCompressed();
     fValid = true;
@@ -247,7 +280,7 @@ bool CKey::Derive(CKey& keyChild, ChainCode &ccChild, unsigned int nChild, const
     }
     memcpy(ccChild.begin(), vout.data()+32, 32);
     memcpy((unsigned char*)keyChild.begin(), begin(), 32);
-    bool ret = secp256k1_ec_privkey_tweak_add(secp256k1_context_sign, (unsigned char*)keyChild.begin(), vout.data());
+    bool ret = secp256k1_ec_privkey_tweak_add(GetSignContext(), (unsigned char*)keyChild.begin(), vout.data());
     keyChild.fCompressed = true;
     keyChild.fValid = ret;
     return ret;
@@ -312,27 +345,15 @@ bool ECC_InitSanityCheck() {
 }
 
 void ECC_Start() {
-    assert(secp256k1_context_sign == NULL);
-
-    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
-    assert(ctx != NULL);
-
-    {
-        // Pass in a random blinding seed to the secp256k1 context.
-        std::vector<unsigned char, secure_allocator<unsigned char>> vseed(32);
-        GetRandBytes(vseed.data(), 32);
-        bool ret = secp256k1_context_randomize(ctx, vseed.data());
-        assert(ret);
-    }
-
-    secp256k1_context_sign = ctx;
+    // Build and blind the calling thread's signing context up front so a
+    // broken RNG or a miscompiled library fails at startup, not mid-signing.
+    // Other threads get their own context lazily on first key operation.
+    assert(ptrSignContext.get() == NULL);
+    GetSignContext();
 }
 
 void ECC_Stop() {
-    secp256k1_context *ctx = secp256k1_context_sign;
-    secp256k1_context_sign = nullptr;
-
-    if (ctx) {
-        secp256k1_context_destroy(ctx);
-    }
+    // Frees the calling thread's context; contexts owned by other threads
+    // are released by boost::thread_specific_ptr when those threads exit.
+    ptrSignContext.reset();
 }
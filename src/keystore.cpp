@@ -104,6 +104,21 @@ bool CBasicKeyStore::AddCScript(const CScript& redeemScript)
     return true;
 }
 
+void CBasicKeyStore::GetCScripts(std::set<CScriptID>& setScript) const
+{
+    LOCK(cs_KeyStore);
+    setScript.clear();
+    for (const auto& mi : mapScripts) {
+        setScript.insert(mi.first);
+    }
+}
+
+void CBasicKeyStore::GetWatchOnly(std::set<CScript>& setScriptRet) const
+{
+    LOCK(cs_KeyStore);
+    setScriptRet = setWatchOnly;
+}
+
 bool CBasicKeyStore::HaveCScript(const CScriptID& hash) const
 {
     LOCK(cs_KeyStore);
@@ -73,6 +73,8 @@ public:
     bool AddCScript(const CScript& redeemScript) override;
     bool HaveCScript(const CScriptID& hash) const override;
     bool GetCScript(const CScriptID& hash, CScript& redeemScriptOut) const override;
+    void GetCScripts(std::set<CScriptID>& setScript) const;
+    void GetWatchOnly(std::set<CScript>& setScriptRet) const;
 
     bool AddWatchOnly(const CScript& dest) override;
     bool RemoveWatchOnly(const CScript& dest) override;
@@ -27,14 +27,29 @@ void HandleError(const leveldb::Status& status) throw(leveldb_error)
     throw leveldb_error("Unknown database error");
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+//! Look up a tuning argument, letting the per-database form (-ldbchainstate-bloombits)
+//! override the global one (-ldbbloombits).
+static int64_t GetDbArg(const std::string& strName, const std::string& strOpt, int64_t nDefault)
+{
+    int64_t nValue = GetArg("-ldb" + strOpt, nDefault);
+    if (!strName.empty())
+        nValue = GetArg("-ldb" + strName + "-" + strOpt, nValue);
+    return nValue;
+}
+
+leveldb::Options GetLevelDBOptions(size_t nCacheSize, const std::string& strName)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    int64_t nBloomBits = GetDbArg(strName, "bloombits", DEFAULT_LDB_BLOOM_BITS);
+    if (nBloomBits > 0)
+        options.filter_policy = leveldb::NewBloomFilterPolicy(nBloomBits);
+    int64_t nBlockSize = GetDbArg(strName, "blocksize", 0);
+    if (nBlockSize > 0)
+        options.block_size = nBlockSize;
+    options.compression = GetDbArg(strName, "compress", 0) ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.max_open_files = GetDbArg(strName, "maxopenfiles", DEFAULT_LDB_MAX_OPEN_FILES);
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
@@ -43,14 +58,14 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CLevelDBWrapper::CLevelDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe)
+CLevelDBWrapper::CLevelDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, const std::string& strName)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetLevelDBOptions(nCacheSize, strName);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
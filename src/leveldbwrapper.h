@@ -24,6 +24,20 @@ public:
 
 void HandleError(const leveldb::Status& status) throw(leveldb_error);
 
+//! -ldb*bloombits default (bloom filter bits per key; 0 disables the filter)
+static const int64_t DEFAULT_LDB_BLOOM_BITS = 10;
+//! -ldb*maxopenfiles default
+static const int64_t DEFAULT_LDB_MAX_OPEN_FILES = 64;
+
+/** Build leveldb::Options for a database, honouring the tuning arguments.
+ *
+ * Every knob has a global form (-ldbbloombits, -ldbblocksize, -ldbcompress,
+ * -ldbmaxopenfiles) and a per-database form with the database name inserted
+ * (e.g. -ldbchainstate-bloombits); the per-database form wins. strName may be
+ * empty for databases without their own tuning surface.
+ */
+leveldb::Options GetLevelDBOptions(size_t nCacheSize, const std::string& strName = "");
+
 /** Batch of changes queued to be written to a CLevelDBWrapper */
 class CLevelDBBatch
 {
@@ -31,8 +45,11 @@ class CLevelDBBatch
 
 private:
     leveldb::WriteBatch batch;
+    size_t size_estimate;
 
 public:
+    CLevelDBBatch() : size_estimate(0) {}
+
     template <typename K, typename V>
     void Write(const K& key, const V& value)
     {
@@ -47,6 +64,14 @@ public:
         leveldb::Slice slValue(&ssValue[0], ssValue.size());
 
         batch.Put(slKey, slValue);
+        // LevelDB serializes writes as:
+        // - byte: header
+        // - varint: key length (1 byte up to 127B, 2 bytes up to 16383B, ...)
+        // - byte[]: key
+        // - varint: value length
+        // - byte[]: value
+        // The formula below assumes the key and value are both less than 16k.
+        size_estimate += 3 + (slKey.size() > 127) + slKey.size() + (slValue.size() > 127) + slValue.size();
     }
 
     template <typename K>
@@ -58,7 +83,20 @@ public:
         leveldb::Slice slKey(&ssKey[0], ssKey.size());
 
         batch.Delete(slKey);
+        // LevelDB serializes erases as:
+        // - byte: header
+        // - varint: key length
+        // - byte[]: key
+        size_estimate += 2 + (slKey.size() > 127) + slKey.size();
+    }
+
+    void Clear()
+    {
+        batch.Clear();
+        size_estimate = 0;
     }
+
+    size_t SizeEstimate() const { return size_estimate; }
 };
 
 class CLevelDBWrapper
@@ -86,7 +124,7 @@ private:
     leveldb::DB* pdb;
 
 public:
-    CLevelDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CLevelDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, const std::string& strName = "");
     ~CLevelDBWrapper();
 
     template <typename K, typename V>
@@ -168,6 +206,12 @@ public:
     {
         return pdb->NewIterator(iteroptions);
     }
+
+    //! Query an internal leveldb property ("leveldb.stats", "leveldb.num-files-at-levelN", ...)
+    bool GetProperty(const std::string& strProperty, std::string& strValue) const
+    {
+        return pdb->GetProperty(strProperty, &strValue);
+    }
 };
 
 #endif // BITCOIN_LEVELDBWRAPPER_H
@@ -22,6 +22,8 @@
 
 #include <stdio.h>
 
+#include <iostream>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/assign/list_of.hpp>
 
@@ -29,6 +31,7 @@ using namespace boost::assign;
 using namespace std;
 
 static bool fCreateBlank;
+static bool fBatch;
 static map<string, UniValue> registers;
 //CClientUIInterface uiInterface;
 
@@ -46,6 +49,7 @@ static bool AppInitRawTx(int argc, char* argv[])
     }
 
     fCreateBlank = GetBoolArg("-create", false);
+    fBatch = GetBoolArg("-batch", false);
 
     if (argc < 2 || mapArgs.count("-?") || mapArgs.count("-help")) {
         // First part of help message is specific to this utility
@@ -53,12 +57,14 @@ static bool AppInitRawTx(int argc, char* argv[])
                                _("Usage:") + "\n" +
                                "  lux-tx [options] <hex-tx> [commands]  " + _("Update hex-encoded lux transaction") + "\n" +
                                "  lux-tx [options] -create [commands]   " + _("Create hex-encoded lux transaction") + "\n" +
+                               "  lux-tx [options] -batch               " + _("Process newline-delimited command lines from stdin") + "\n" +
                                "\n";
 
         fprintf(stdout, "%s", strUsage.c_str());
 
         strUsage = _("Options:") + "\n";
         strUsage += "  -?                      " + _("This help message") + "\n";
+        strUsage += "  -batch                  " + _("Read one command line per stdin line; one result (or error:) line is written per input line. Registers and the signing context persist across lines.") + "\n";
         strUsage += "  -create                 " + _("Create new, empty TX.") + "\n";
         strUsage += "  -json                   " + _("Select JSON output") + "\n";
         strUsage += "  -txid                   " + _("Output only the hex-encoded transaction id of the resultant transaction.") + "\n";
@@ -480,9 +486,15 @@ public:
     }
 };
 
+/**
+ * Created lazily on the first "sign" command and kept for the lifetime of the
+ * process. ECC_Start() is by far the most expensive part of a signing run, so
+ * in -batch mode every line after the first signs against the same context.
+ */
+static boost::scoped_ptr<Secp256k1Init> ecc;
+
 static void MutateTx(CMutableTransaction& tx, const string& command, const string& commandVal)
 {
-    boost::scoped_ptr<Secp256k1Init> ecc;
     if (command == "nversion")
         MutateTxVersion(tx, commandVal);
     else if (command == "locktime")
@@ -635,6 +647,85 @@ static int CommandLineRawTx(int argc, char* argv[])
     return nRet;
 }
 
+static void BatchProcessLine(const vector<string>& vArgs)
+{
+    // A line of only register commands updates the persistent registers
+    // (e.g. load the payout keys once up front) and acknowledges with "ok".
+    if (vArgs[0].compare(0, 4, "set=") == 0 || vArgs[0].compare(0, 5, "load=") == 0) {
+        BOOST_FOREACH (const string& arg, vArgs) {
+            size_t eqpos = arg.find('=');
+            if (eqpos == string::npos)
+                throw runtime_error("register command requires key=value");
+            string key = arg.substr(0, eqpos);
+            string value = arg.substr(eqpos + 1);
+            if (key == "set")
+                RegisterSet(value);
+            else if (key == "load")
+                RegisterLoad(value);
+            else
+                throw runtime_error("cannot mix register and TX commands on one line");
+        }
+        fprintf(stdout, "ok\n");
+        return;
+    }
+
+    // The first token is either "-create" or the hex transaction to mutate,
+    // mirroring the single-shot command line.
+    CTransaction txDecodeTmp;
+    if (vArgs[0] != "-create" && !DecodeHexTx(txDecodeTmp, vArgs[0], true))
+        throw runtime_error("invalid transaction encoding");
+
+    CMutableTransaction tx(txDecodeTmp);
+
+    for (unsigned int i = 1; i < vArgs.size(); i++) {
+        const string& arg = vArgs[i];
+        string key, value;
+        size_t eqpos = arg.find('=');
+        if (eqpos == string::npos)
+            key = arg;
+        else {
+            key = arg.substr(0, eqpos);
+            value = arg.substr(eqpos + 1);
+        }
+
+        MutateTx(tx, key, value);
+    }
+
+    OutputTx(tx);
+}
+
+static int BatchRawTx()
+{
+    // One secp256k1 context for the whole stream: starting it per line (let
+    // alone per process) dominates the cost of bulk signing runs.
+    ecc.reset(new Secp256k1Init());
+
+    int nRet = EXIT_SUCCESS;
+    string strLine;
+    while (std::getline(std::cin, strLine)) {
+        boost::algorithm::trim(strLine);
+        // skip blanks and comments without producing an output line
+        if (strLine.empty() || strLine[0] == '#')
+            continue;
+
+        try {
+            vector<string> vArgs;
+            boost::split(vArgs, strLine, boost::is_any_of(" \t"), boost::token_compress_on);
+            BatchProcessLine(vArgs);
+        } catch (boost::thread_interrupted) {
+            throw;
+        } catch (std::exception& e) {
+            // keep the output stream line-aligned with the input so a driving
+            // pipeline can match results to requests; keep going regardless
+            fprintf(stdout, "error: %s\n", e.what());
+            nRet = EXIT_FAILURE;
+        }
+        fflush(stdout);
+    }
+
+    return nRet;
+}
+
 int main(int argc, char* argv[])
 {
     SetupEnvironment();
@@ -652,7 +743,7 @@ int main(int argc, char* argv[])
 
     int ret = EXIT_FAILURE;
     try {
-        ret = CommandLineRawTx(argc, argv);
+        ret = fBatch ? BatchRawTx() : CommandLineRawTx(argc, argv);
     } catch (std::exception& e) {
         PrintExceptionContinue(&e, "CommandLineRawTx()");
     } catch (...) {
@@ -1,5 +1,35 @@
 #include "luxDGP.h"
 
+#include "sync.h"
+
+namespace {
+
+/**
+ * DGP reads resolve through immutable parameter contracts registered in a
+ * governance proxy, so every output is fully determined by the proxy's
+ * storage root and the resolved parameter contract address. Caching under
+ * that key makes invalidation automatic: a governance vote moves the root
+ * and orphans every stale entry, and a reorg onto a chain with different
+ * governance state can never hit an old value. Saves a full EVM call (or a
+ * storage trie walk) per block validated and per block template created.
+ */
+const size_t MAX_DGP_CACHE_SIZE = 64;
+
+CCriticalSection cs_dgpCache;
+std::map<std::pair<dev::Address, dev::h256>, std::vector<std::pair<unsigned int, dev::Address>>> dgpParamsCache;
+std::map<std::tuple<dev::Address, dev::h256, bool>, uint64_t> dgpUint64Cache;
+std::map<std::tuple<dev::Address, dev::h256, bool>, dev::eth::EVMSchedule> dgpScheduleCache;
+
+//! Stale roots are unreachable once governance moves on, so a dumb bound
+//! with full reset is enough to keep reorg leftovers from accumulating.
+template <typename M>
+void LimitDGPCache(M& cache){
+    if(cache.size() > MAX_DGP_CACHE_SIZE)
+        cache.clear();
+}
+
+}
+
 void LuxDGP::initDataEIP158(){
     std::vector<uint32_t> tempData = {dev::eth::EIP158Schedule.tierStepGas[0], dev::eth::EIP158Schedule.tierStepGas[1], dev::eth::EIP158Schedule.tierStepGas[2],
                                       dev::eth::EIP158Schedule.tierStepGas[3], dev::eth::EIP158Schedule.tierStepGas[4], dev::eth::EIP158Schedule.tierStepGas[5],
@@ -34,21 +64,57 @@ bool LuxDGP::checkLimitSchedule(const std::vector<uint32_t>& defaultData, const
 dev::eth::EVMSchedule LuxDGP::getGasSchedule(unsigned int blockHeight){
     clear();
     dev::eth::EVMSchedule schedule = dev::eth::EIP158Schedule;
-    if(initStorages(GasScheduleDGP, blockHeight, ParseHex("26fadbe2"))){
-        schedule = createEVMSchedule();
+    dev::h256 rootDGP;
+    dev::Address address = resolveParamAddress(GasScheduleDGP, blockHeight, rootDGP);
+    if(address == dev::Address()){
+        return schedule;
     }
+    std::tuple<dev::Address, dev::h256, bool> key = std::make_tuple(address, rootDGP, dgpevm);
+    {
+        LOCK(cs_dgpCache);
+        auto it = dgpScheduleCache.find(key);
+        if(it != dgpScheduleCache.end()){
+            return it->second;
+        }
+    }
+    std::vector<unsigned char> data = ParseHex("26fadbe2");
+    if(!dgpevm){
+        initStorageTemplate(address);
+    } else {
+        initDataTemplate(address, data);
+    }
+    schedule = createEVMSchedule();
+    LOCK(cs_dgpCache);
+    LimitDGPCache(dgpScheduleCache);
+    dgpScheduleCache[key] = schedule;
     return schedule;
 }
 
 uint64_t LuxDGP::getUint64FromDGP(unsigned int blockHeight, const dev::Address& contract, std::vector<unsigned char> data){
     uint64_t value = 0;
-    if(initStorages(contract, blockHeight, data)){
-        if(!dgpevm){
-            parseStorageOneUint64(value);
-        } else {
-            parseDataOneUint64(value);
+    dev::h256 rootDGP;
+    dev::Address address = resolveParamAddress(contract, blockHeight, rootDGP);
+    if(address == dev::Address()){
+        return value;
+    }
+    std::tuple<dev::Address, dev::h256, bool> key = std::make_tuple(address, rootDGP, dgpevm);
+    {
+        LOCK(cs_dgpCache);
+        auto it = dgpUint64Cache.find(key);
+        if(it != dgpUint64Cache.end()){
+            return it->second;
         }
     }
+    if(!dgpevm){
+        initStorageTemplate(address);
+        parseStorageOneUint64(value);
+    } else {
+        initDataTemplate(address, data);
+        parseDataOneUint64(value);
+    }
+    LOCK(cs_dgpCache);
+    LimitDGPCache(dgpUint64Cache);
+    dgpUint64Cache[key] = value;
     return value;
 }
 
@@ -82,19 +148,25 @@ uint64_t LuxDGP::getBlockGasLimit(unsigned int blockHeight){
     return result;
 }
 
-bool LuxDGP::initStorages(const dev::Address& addr, unsigned int blockHeight, std::vector<unsigned char> data){
+dev::Address LuxDGP::resolveParamAddress(const dev::Address& addr, unsigned int blockHeight, dev::h256& rootDGP){
+    rootDGP = state->storageRoot(addr);
+    std::pair<dev::Address, dev::h256> key = std::make_pair(addr, rootDGP);
+    {
+        LOCK(cs_dgpCache);
+        auto it = dgpParamsCache.find(key);
+        if(it != dgpParamsCache.end()){
+            paramsInstance = it->second;
+            return getAddressForBlock(blockHeight);
+        }
+    }
     initStorageDGP(addr);
     createParamsInstance();
-    dev::Address address = getAddressForBlock(blockHeight);
-    if(address != dev::Address()){
-        if(!dgpevm){
-            initStorageTemplate(address);
-        } else {
-            initDataTemplate(address, data);
-        }
-        return true;
+    {
+        LOCK(cs_dgpCache);
+        LimitDGPCache(dgpParamsCache);
+        dgpParamsCache[key] = paramsInstance;
     }
-    return false;
+    return getAddressForBlock(blockHeight);
 }
 
 void LuxDGP::initStorageDGP(const dev::Address& addr){
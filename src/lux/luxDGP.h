@@ -40,7 +40,7 @@ public:
 
 private:
 
-    bool initStorages(const dev::Address& addr, unsigned int blockHeight, std::vector<unsigned char> data = std::vector<unsigned char>());
+    dev::Address resolveParamAddress(const dev::Address& addr, unsigned int blockHeight, dev::h256& rootDGP);
 
     void initStorageDGP(const dev::Address& addr);
 
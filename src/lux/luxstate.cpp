@@ -13,6 +13,12 @@ LuxState::LuxState(u256 const& _accountStartNonce, OverlayDB const& _db, const s
 	        stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
 }
 
+LuxState::LuxState(u256 const& _accountStartNonce, OverlayDB const& _db, OverlayDB const& _dbUtxo) :
+        State(_accountStartNonce, _db, BaseState::PreExisting) {
+    dbUTXO = _dbUtxo;
+    stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
+}
+
 LuxState::LuxState() : dev::eth::State(dev::Invalid256, dev::OverlayDB(), dev::eth::BaseState::PreExisting) {
     dbUTXO = OverlayDB();
     stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
@@ -1,8 +1,14 @@
 #include <lux/storageresults.h>
+#include <leveldbwrapper.h>
 #include <boost/filesystem.hpp>
+#include <leveldb/write_batch.h>
+
+//! Cap on cached entries kept for read-through after a flush.
+static const size_t MAX_RESULT_CACHE_ENTRIES = 10000;
 
 StorageResults::StorageResults(std::string const& _path){
 	path = _path + "/resultsDB";
+    options = GetLevelDBOptions(4 << 20, "storageresults");
     options.create_if_missing = true;
     int cnt = 0;
     int MAX_TRIES = 5;
@@ -44,10 +50,22 @@ StorageResults::~StorageResults()
 {
     delete db;
     db = NULL;
+    delete options.filter_policy;
+    options.filter_policy = NULL;
+    delete options.block_cache;
+    options.block_cache = NULL;
+}
+
+bool StorageResults::GetProperty(const std::string& strProperty, std::string& strValue) const
+{
+    return db->GetProperty(strProperty, &strValue);
 }
 
 void StorageResults::addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result){
-	m_cache_result.insert(std::make_pair(hashTx, result));
+    LOCK(cs_results);
+	m_cache_result[hashTx] = result;
+    m_dirty.insert(hashTx);
+    m_pending_deletes.erase(hashTx);
 }
 
 void StorageResults::wipeResults(){
@@ -57,19 +75,22 @@ void StorageResults::wipeResults(){
 
 void StorageResults::deleteResults(std::vector<CTransaction> const& txs){
 
-    for(CTransaction tx : txs){
+    LOCK(cs_results);
+    for(const CTransaction& tx : txs){
         dev::h256 hashTx = uintToh256(tx.GetHash());
         m_cache_result.erase(hashTx);
-
-        std::string keyTemp = hashTx.hex();
-	    leveldb::Slice key(keyTemp);
-        leveldb::Status status = db->Delete(leveldb::WriteOptions(), key);
-        assert(status.ok());
+        m_dirty.erase(hashTx);
+        // The db entry goes with the next batched commit; until then reads
+        // must not resurrect it.
+        m_pending_deletes.insert(hashTx);
     }
 }
 
 std::vector<TransactionReceiptInfo> StorageResults::getResult(dev::h256 const& hashTx){
     std::vector<TransactionReceiptInfo> result;
+    LOCK(cs_results);
+    if (m_pending_deletes.count(hashTx))
+        return result;
 	auto it = m_cache_result.find(hashTx);
 	if (it == m_cache_result.end()){
 		if(readResult(hashTx, result))
@@ -81,45 +102,74 @@ std::vector<TransactionReceiptInfo> StorageResults::getResult(dev::h256 const& h
 }
 
 void StorageResults::commitResults(){
-    if(m_cache_result.size()){
-
-        for (auto const& i: m_cache_result){
-            std::string valueTemp;
-            std::string keyTemp = i.first.hex();
-            leveldb::Slice key(keyTemp);
-            leveldb::Status status = db->Get(leveldb::ReadOptions(), key, &valueTemp);
-
-            if(status.IsNotFound()){
-
-                TransactionReceiptInfoSerialized tris;
-
-                for(size_t j = 0; j < i.second.size(); j++){
-                    tris.blockHashes.push_back(uintToh256(i.second[j].blockHash));
-                    tris.blockNumbers.push_back(i.second[j].blockNumber);
-                    tris.transactionHashes.push_back(uintToh256(i.second[j].transactionHash));
-                    tris.transactionIndexes.push_back(i.second[j].transactionIndex);
-                    tris.senders.push_back(i.second[j].from);
-                    tris.receivers.push_back(i.second[j].to);
-                    tris.cumulativeGasUsed.push_back(dev::u256(i.second[j].cumulativeGasUsed));
-                    tris.gasUsed.push_back(dev::u256(i.second[j].gasUsed));
-                    tris.contractAddresses.push_back(i.second[j].contractAddress);
-                    tris.logs.push_back(logEntriesSerialization(i.second[j].logs));
-                    tris.excepted.push_back(uint32_t(static_cast<int>(i.second[j].excepted)));
-                }
 
-                dev::RLPStream streamRLP(11);
-                streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes << tris.senders;
-                streamRLP << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses << tris.logs << tris.excepted;
+    leveldb::WriteBatch batch;
+    std::vector<dev::h256> vFlushed;
+    {
+        LOCK(cs_results);
+        if(m_dirty.empty() && m_pending_deletes.empty())
+            return;
 
-                dev::bytes data = streamRLP.out();
-                std::string stringData(data.begin(), data.end());
-                leveldb::Slice value(stringData);
-                status = db->Put(leveldb::WriteOptions(), key, value);
-                assert(status.ok());
-            }
+        for (const dev::h256& hashTx : m_pending_deletes){
+            std::string keyTemp = hashTx.hex();
+            batch.Delete(leveldb::Slice(keyTemp));
+        }
+        m_pending_deletes.clear();
+
+        for (const dev::h256& hashTx : m_dirty){
+            auto it = m_cache_result.find(hashTx);
+            if (it == m_cache_result.end())
+                continue;
+            std::string keyTemp = hashTx.hex();
+            std::string stringData = serializeResult(it->second);
+            batch.Put(leveldb::Slice(keyTemp), leveldb::Slice(stringData));
+            vFlushed.push_back(hashTx);
         }
-        m_cache_result.clear();
+        m_dirty.clear();
     }
+
+    // One batched write per flush; the default WriteOptions make it an
+    // in-memory memtable append, not a per-key synchronous commit.
+    leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+    assert(status.ok());
+
+    LOCK(cs_results);
+    if (m_cache_result.size() > MAX_RESULT_CACHE_ENTRIES){
+        // Flushed entries can be re-read from db; keep the cache bounded.
+        for (const dev::h256& hashTx : vFlushed)
+            m_cache_result.erase(hashTx);
+        for (auto it = m_cache_result.begin(); m_cache_result.size() > MAX_RESULT_CACHE_ENTRIES && it != m_cache_result.end(); )
+            if (!m_dirty.count(it->first))
+                it = m_cache_result.erase(it);
+            else
+                ++it;
+    }
+}
+
+std::string StorageResults::serializeResult(std::vector<TransactionReceiptInfo> const& _result){
+
+    TransactionReceiptInfoSerialized tris;
+
+    for(size_t j = 0; j < _result.size(); j++){
+        tris.blockHashes.push_back(uintToh256(_result[j].blockHash));
+        tris.blockNumbers.push_back(_result[j].blockNumber);
+        tris.transactionHashes.push_back(uintToh256(_result[j].transactionHash));
+        tris.transactionIndexes.push_back(_result[j].transactionIndex);
+        tris.senders.push_back(_result[j].from);
+        tris.receivers.push_back(_result[j].to);
+        tris.cumulativeGasUsed.push_back(dev::u256(_result[j].cumulativeGasUsed));
+        tris.gasUsed.push_back(dev::u256(_result[j].gasUsed));
+        tris.contractAddresses.push_back(_result[j].contractAddress);
+        tris.logs.push_back(logEntriesSerialization(_result[j].logs));
+        tris.excepted.push_back(uint32_t(static_cast<int>(_result[j].excepted)));
+    }
+
+    dev::RLPStream streamRLP(11);
+    streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes << tris.senders;
+    streamRLP << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses << tris.logs << tris.excepted;
+
+    dev::bytes data = streamRLP.out();
+    return std::string(data.begin(), data.end());
 }
 
 bool StorageResults::readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result){
@@ -1,9 +1,15 @@
+#ifndef LUX_STORAGERESULTS_H
+#define LUX_STORAGERESULTS_H
+
 #include <uint256.h>
 #include <primitives/transaction.h>
 #include <libethereum/State.h>
 #include <libethereum/Transaction.h>
+#include "sync.h"
 #include "util.h"
 
+#include <unordered_set>
+
 using logEntriesSerializ = std::vector<std::pair<dev::Address, std::pair<dev::h256s, dev::bytes>>>;
 
 struct TransactionReceiptInfo{
@@ -47,14 +53,23 @@ public:
 
     std::vector<TransactionReceiptInfo> getResult(dev::h256 const& hashTx);
 
+    /** Flush buffered results (and pending deletions) to LevelDB in one
+     * batched write. Safe to call from outside cs_main; reads are served
+     * from the in-memory buffer until the batch lands.
+     */
 	void commitResults();
 
     void wipeResults();
 
+    //! Query an internal leveldb property of the results database.
+    bool GetProperty(std::string const& strProperty, std::string& strValue) const;
+
 private:
 
 	bool readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result);
 
+	std::string serializeResult(std::vector<TransactionReceiptInfo> const& _result);
+
 	logEntriesSerializ logEntriesSerialization(dev::eth::LogEntries const& _logs);
 
 	dev::eth::LogEntries logEntriesDeserialize(logEntriesSerializ const& _logs);
@@ -65,5 +80,16 @@ private:
 
     leveldb::Options options;
 
+    //! Guards the buffer below; db itself is internally synchronized.
+    mutable CCriticalSection cs_results;
+
 	std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_cache_result;
+
+    //! Keys in m_cache_result not yet written to db.
+    std::unordered_set<dev::h256> m_dirty;
+
+    //! Keys deleted (disconnected blocks) but not yet removed from db.
+    std::unordered_set<dev::h256> m_pending_deletes;
 };
+
+#endif // LUX_STORAGERESULTS_H
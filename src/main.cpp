@@ -9,12 +9,16 @@
 
 #include "addrman.h"
 #include "alert.h"
+#include "blockencodings.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "compress.h"
+#include "compressor.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "db.h"
 #include "hash.h"
 #include "init.h"
 #include "stake.h"
@@ -23,6 +27,7 @@
 #include "net.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
+#include "perf.h"
 #include "pow.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
@@ -32,6 +37,7 @@
 #include "script/sigcache.h"
 #include "script/standard.h"
 #include "timedata.h"
+#include "trace.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -43,7 +49,16 @@
 
 #include "univalue/univalue.h"
 #include <atomic>
+#include <list>
 #include <sstream>
+#include <unordered_map>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -84,6 +99,8 @@ static const int POS_REWARD_CHANGED_BLOCK = 300000;
 
 std::unique_ptr<LuxState> globalState;
 std::shared_ptr<dev::eth::SealEngineFace> globalSealEngine;
+std::unique_ptr<LuxState> globalCallState;
+std::shared_ptr<dev::eth::SealEngineFace> globalCallSealEngine;
 bool fRecordLogOpcodes = false;
 bool fIsVMlogFile = false;
 bool fGettingValuesDGP = false;
@@ -129,14 +146,20 @@ CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
+std::atomic_bool fReindexChainState(false);
 bool fLogEvents = false;
 bool fTxIndex = true;
+bool fUtxoSetHash = false;
+CUtxoSetHasher utxoSetHash;
+bool fAddressIndex = false;
+bool fSpentIndex = false;
 bool fIsBareMultisigStd = true;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 unsigned int nCoinCacheSize = 5000;
 unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 bool fAlerts = DEFAULT_ALERTS;
+uint256 hashAssumeValid;
 
 bool fHavePruned = false;
 bool fPruneMode = false;
@@ -158,9 +181,30 @@ struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
     int64_t nTimeExpire;
+    size_t nListPos; //! Position in vOrphanEvictionCandidates, for O(1) random eviction
 };
-map<uint256, COrphanTx> mapOrphanTransactions;
-map<uint256, set<uint256> > mapOrphanTransactionsByPrev;
+std::unordered_map<uint256, COrphanTx, SaltedTxidHasher> mapOrphanTransactions;
+std::unordered_map<uint256, set<uint256>, SaltedTxidHasher> mapOrphanTransactionsByPrev;
+//! Orphan txids in insertion-agnostic order; lets LimitOrphanTxSize pick a
+//! uniformly random victim without walking the table.
+static std::vector<uint256> vOrphanEvictionCandidates;
+//! Orphans grouped by originating peer, so disconnecting a peer only touches
+//! its own entries instead of sweeping the whole pool under cs_main.
+static std::map<NodeId, std::set<uint256> > mapOrphanTransactionsByPeer;
+
+/**
+ * Filter for transactions that were recently rejected by AcceptToMemoryPool,
+ * so the same transaction is not validated (or re-requested) again and again.
+ * Entries are keyed by witness hash, which identifies the exact bytes we
+ * validated: a malleated resubmission of rejected garbage hits the filter,
+ * while a differently-witnessed — possibly valid — version of the same txid
+ * does not. The txid is added as a second key only when the failure could
+ * not have been caused by a malleated witness. Reset when the chain tip
+ * changes, as previously rejected transactions may become valid then.
+ * Protected by cs_main; lazily created in AlreadyHave.
+ */
+static std::unique_ptr<CRollingBloomFilter> recentRejects;
+static uint256 hashRecentRejectsChainTip;
 
 void EraseOrphansFor(NodeId peer);
 
@@ -244,6 +288,11 @@ map<uint256, pair<NodeId, list<QueuedBlock>::iterator> > mapBlocksInFlight;
 /** Number of blocks in flight with validated headers. */
 int nQueuedValidatedHeaders = 0;
 
+/** Block fetch stall metrics since startup, exported via getnettotals. Protected by cs_main. */
+int64_t nBlockStallDisconnects = 0;
+int64_t nBlockTimeoutDisconnects = 0;
+int64_t nBlocksReassigned = 0;
+
 /** Number of preferable block download peers. */
 int nPreferredDownload = 0;
 
@@ -303,12 +352,23 @@ struct CNodeState {
     bool fSyncStarted;
     //! Since when we're stalling block download progress (in microseconds), or 0.
     int64_t nStallingSince;
+    //! EWMA of getdata-to-delivery latency for blocks from this peer (in microseconds), or 0 if no
+    //! block has been delivered yet. Drives the adaptive download timeout and reassignment decisions.
+    int64_t nBlockLatencyEwmaUs;
     list<QueuedBlock> vBlocksInFlight;
     int nBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer can give us witnesses
     bool fHaveWitness;
+    //! Whether this peer can serve us compact blocks (it sent us "sendcmpct").
+    bool fProvidesCompactBlocks;
+    //! Whether this peer asked to be announced to via cmpctblock messages.
+    bool fWantsCompactBlocks;
+    //! Hash of the compact block we are currently reconstructing from this peer, if any.
+    uint256 hashPartialBlock;
+    //! In-progress compact block reconstruction, if any.
+    std::unique_ptr<PartiallyDownloadedBlock> partialBlock;
 
     CNodeState()
     {
@@ -320,9 +380,13 @@ struct CNodeState {
         pindexLastCommonBlock = NULL;
         fSyncStarted = false;
         nStallingSince = 0;
+        nBlockLatencyEwmaUs = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
         fHaveWitness = false;
+        fProvidesCompactBlocks = false;
+        fWantsCompactBlocks = false;
+        hashPartialBlock = uint256(0);
     }
 };
 
@@ -388,6 +452,11 @@ void MarkBlockAsReceived(const uint256& hash)
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
     if (itInFlight != mapBlocksInFlight.end()) {
         CNodeState* state = State(itInFlight->second.first);
+        int64_t nLatencyUs = GetTimeMicros() - itInFlight->second.second->nTime;
+        RecordPeerBlockLatency(state->address, nLatencyUs / 1000);
+        // 3:1 EWMA so the adaptive timeout tracks the peer's recent delivery rate
+        // without overreacting to a single slow block.
+        state->nBlockLatencyEwmaUs = state->nBlockLatencyEwmaUs == 0 ? nLatencyUs : (3 * state->nBlockLatencyEwmaUs + nLatencyUs) / 4;
         nQueuedValidatedHeaders -= itInFlight->second.second->fValidatedHeaders;
         state->vBlocksInFlight.erase(itInFlight->second.second);
         state->nBlocksInFlight--;
@@ -396,6 +465,21 @@ void MarkBlockAsReceived(const uint256& hash)
     }
 }
 
+// Requires cs_main.
+// Drop an in-flight entry without crediting the source peer with a delivery
+// (the block never arrived); used when reassigning a stalled request.
+void MarkBlockAsAbandoned(const uint256& hash)
+{
+    map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight != mapBlocksInFlight.end()) {
+        CNodeState* state = State(itInFlight->second.first);
+        nQueuedValidatedHeaders -= itInFlight->second.second->fValidatedHeaders;
+        state->vBlocksInFlight.erase(itInFlight->second.second);
+        state->nBlocksInFlight--;
+        mapBlocksInFlight.erase(itInFlight);
+    }
+}
+
 // Requires cs_main.
 // returns false, still setting pit, if the block was already in flight from the same peer
 // pit will only be valid as long as the same cs_main lock is being held
@@ -414,6 +498,38 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
 }
 
+// Requires cs_main.
+// Timeout (in microseconds) for the oldest block in flight from a peer. The
+// block-interval heuristic is the ceiling; once the peer has a delivery
+// history we tighten to a multiple of its own observed latency so a dead
+// peer is cut loose in seconds rather than minutes.
+int64_t BlockDownloadTimeoutUs(const CNodeState& state, const QueuedBlock& block)
+{
+    int64_t nDefault = 500000 * Params().TargetSpacing() * (4 + block.nValidatedQueuedBefore);
+    if (state.nBlockLatencyEwmaUs == 0)
+        return nDefault;
+    // Allow ten typical deliveries plus queueing headroom for the blocks
+    // requested ahead of this one, but never less than five seconds.
+    int64_t nAdaptive = 10 * state.nBlockLatencyEwmaUs + 250000 * block.nValidatedQueuedBefore;
+    return std::min(nDefault, std::max(nAdaptive, (int64_t)5000000));
+}
+
+// Requires cs_main.
+// Find the queued block gating the download window: the lowest-height
+// in-flight block with validated headers. Returns NULL if none.
+const QueuedBlock* FindCriticalBlockInFlight(NodeId& nodeFrom)
+{
+    const QueuedBlock* pcritical = NULL;
+    for (map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::const_iterator it = mapBlocksInFlight.begin(); it != mapBlocksInFlight.end(); it++) {
+        const QueuedBlock& entry = *it->second.second;
+        if (entry.pindex && (pcritical == NULL || entry.pindex->nHeight < pcritical->pindex->nHeight)) {
+            pcritical = &entry;
+            nodeFrom = it->second.first;
+        }
+    }
+    return pcritical;
+}
+
 /** Check whether the last unknown block a peer advertized is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid)
 {
@@ -565,6 +681,7 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats)
     stats.nMisbehavior = state->nMisbehavior;
     stats.nSyncHeight = state->pindexBestKnownBlock ? state->pindexBestKnownBlock->nHeight : -1;
     stats.nCommonHeight = state->pindexLastCommonBlock ? state->pindexLastCommonBlock->nHeight : -1;
+    stats.nBlockLatencyMs = state->nBlockLatencyEwmaUs / 1000;
     BOOST_FOREACH (const QueuedBlock& queue, state->vBlocksInFlight) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
@@ -572,6 +689,14 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats)
     return true;
 }
 
+void GetBlockFetchStats(int64_t& nStallDisconnectsOut, int64_t& nTimeoutDisconnectsOut, int64_t& nReassignedOut)
+{
+    LOCK(cs_main);
+    nStallDisconnectsOut = nBlockStallDisconnects;
+    nTimeoutDisconnectsOut = nBlockTimeoutDisconnects;
+    nReassignedOut = nBlocksReassigned;
+}
+
 void RegisterNodeSignals(CNodeSignals& nodeSignals)
 {
     nodeSignals.GetHeight.connect(&GetHeight);
@@ -630,9 +755,9 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer)
         return false;
     }
 
-    mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME});
-    mapOrphanTransactions[hash].tx = tx;
-    mapOrphanTransactions[hash].fromPeer = peer;
+    mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, vOrphanEvictionCandidates.size()});
+    vOrphanEvictionCandidates.push_back(hash);
+    mapOrphanTransactionsByPeer[peer].insert(hash);
     BOOST_FOREACH (const CTxIn& txin, tx.vin)
         mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
 
@@ -643,28 +768,43 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer)
 
 void static EraseOrphanTx(uint256 hash)
 {
-    map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
+    auto it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
         return;
     BOOST_FOREACH (const CTxIn& txin, it->second.tx.vin) {
-        map<uint256, set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
+        auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
         if (itPrev == mapOrphanTransactionsByPrev.end())
             continue;
         itPrev->second.erase(hash);
         if (itPrev->second.empty())
             mapOrphanTransactionsByPrev.erase(itPrev);
     }
+    auto itPeer = mapOrphanTransactionsByPeer.find(it->second.fromPeer);
+    if (itPeer != mapOrphanTransactionsByPeer.end()) {
+        itPeer->second.erase(hash);
+        if (itPeer->second.empty())
+            mapOrphanTransactionsByPeer.erase(itPeer);
+    }
+    // Swap-and-pop out of the eviction candidate list.
+    size_t nPos = it->second.nListPos;
+    if (nPos + 1 != vOrphanEvictionCandidates.size()) {
+        vOrphanEvictionCandidates[nPos] = vOrphanEvictionCandidates.back();
+        mapOrphanTransactions[vOrphanEvictionCandidates[nPos]].nListPos = nPos;
+    }
+    vOrphanEvictionCandidates.pop_back();
     mapOrphanTransactions.erase(it);
 }
 
 void EraseOrphansFor(NodeId peer)
 {
     int nErased = 0;
-    map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-    while (iter != mapOrphanTransactions.end()) {
-        map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer) {
-            EraseOrphanTx(maybeErase->second.tx.GetHash());
+    auto itPeer = mapOrphanTransactionsByPeer.find(peer);
+    if (itPeer != mapOrphanTransactionsByPeer.end()) {
+        // EraseOrphanTx removes the entry from the peer's set, so copy the
+        // hashes out first rather than iterating the mutating set.
+        std::vector<uint256> vErase(itPeer->second.begin(), itPeer->second.end());
+        BOOST_FOREACH (const uint256& hash, vErase) {
+            EraseOrphanTx(hash);
             ++nErased;
         }
     }
@@ -682,10 +822,10 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
         // Sweep out expired orphan pool entries:
         int nErased = 0;
         int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
+        auto iter = mapOrphanTransactions.begin();
         while (iter != mapOrphanTransactions.end())
         {
-            map<uint256, COrphanTx>::iterator maybeErase = iter++;
+            auto maybeErase = iter++;
             if (maybeErase->second.nTimeExpire <= nNow) {
                 EraseOrphanTx(maybeErase->second.tx.GetHash());
                 ++nErased;
@@ -700,11 +840,7 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
 
     while (mapOrphanTransactions.size() > nMaxOrphans) {
         // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
-        EraseOrphanTx(it->first);
+        EraseOrphanTx(vOrphanEvictionCandidates[GetRand(vOrphanEvictionCandidates.size())]);
         ++nEvicted;
     }
     return nEvicted;
@@ -728,15 +864,52 @@ bool IsFinalTx(const CTransaction& tx, int nBlockHeight, int64_t nBlockTime)
     return true;
 }
 
+// Sigop counts are pure functions of the (immutable) transaction and, for
+// the P2SH half, of prevout scripts that can no longer change once created,
+// so both are memoized by txid: mempool acceptance, block assembly and block
+// validation all re-count the same transactions within minutes of each other.
+static const size_t MAX_SIGOP_COUNT_CACHE = 50000;
+static CCriticalSection cs_sigOpCountCache;
+static std::map<uint256, unsigned int> mapLegacySigOpCache;
+static std::map<uint256, unsigned int> mapP2SHSigOpCache;
+
+static bool SigOpCacheLookup(const std::map<uint256, unsigned int>& mapCache, const uint256& hash, unsigned int& nSigOpsRet)
+{
+    LOCK(cs_sigOpCountCache);
+    std::map<uint256, unsigned int>::const_iterator it = mapCache.find(hash);
+    if (it == mapCache.end())
+        return false;
+    nSigOpsRet = it->second;
+    return true;
+}
+
+static void SigOpCacheInsert(std::map<uint256, unsigned int>& mapCache, const uint256& hash, unsigned int nSigOps)
+{
+    LOCK(cs_sigOpCountCache);
+    while (mapCache.size() >= MAX_SIGOP_COUNT_CACHE) {
+        // Evict a random entry; scanning for age isn't worth it here.
+        std::map<uint256, unsigned int>::iterator it = mapCache.lower_bound(GetRandHash());
+        if (it == mapCache.end())
+            it = mapCache.begin();
+        mapCache.erase(it);
+    }
+    mapCache[hash] = nSigOps;
+}
+
 unsigned int GetLegacySigOpCount(const CTransaction& tx)
 {
     unsigned int nSigOps = 0;
+    if (SigOpCacheLookup(mapLegacySigOpCache, tx.GetHash(), nSigOps))
+        return nSigOps;
+
     BOOST_FOREACH (const CTxIn& txin, tx.vin) {
         nSigOps += txin.scriptSig.GetSigOpCount(false);
     }
     BOOST_FOREACH (const CTxOut& txout, tx.vout) {
         nSigOps += txout.scriptPubKey.GetSigOpCount(false);
     }
+
+    SigOpCacheInsert(mapLegacySigOpCache, tx.GetHash(), nSigOps);
     return nSigOps;
 }
 
@@ -746,11 +919,16 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
         return 0;
 
     unsigned int nSigOps = 0;
+    if (SigOpCacheLookup(mapP2SHSigOpCache, tx.GetHash(), nSigOps))
+        return nSigOps;
+
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
         const CTxOut& prevout = inputs.GetOutputFor(tx.vin[i]);
         if (prevout.scriptPubKey.IsPayToScriptHash())
             nSigOps += prevout.scriptPubKey.GetSigOpCount(tx.vin[i].scriptSig);
     }
+
+    SigOpCacheInsert(mapP2SHSigOpCache, tx.GetHash(), nSigOps);
     return nSigOps;
 }
 
@@ -906,13 +1084,19 @@ bool CheckTransaction(const CTransaction& tx, CValidationState& state)
     }
 
 
-    // Check for duplicate inputs
-    set<COutPoint> vInOutPoints;
-    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-        if (vInOutPoints.count(txin.prevout))
-            return state.DoS(100, error("CheckTransaction() : duplicate inputs"),
-                REJECT_INVALID, "bad-txns-inputs-duplicate");
-        vInOutPoints.insert(txin.prevout);
+    // Check for duplicate inputs with a sort and an adjacent scan; one
+    // allocation instead of a node per input, which matters for
+    // transactions with hundreds of inputs.
+    if (tx.vin.size() > 1) {
+        std::vector<COutPoint> vInOutPoints;
+        vInOutPoints.reserve(tx.vin.size());
+        BOOST_FOREACH (const CTxIn& txin, tx.vin)
+            vInOutPoints.push_back(txin.prevout);
+        std::sort(vInOutPoints.begin(), vInOutPoints.end());
+        for (size_t j = 1; j < vInOutPoints.size(); j++)
+            if (vInOutPoints[j] == vInOutPoints[j - 1])
+                return state.DoS(100, error("CheckTransaction() : duplicate inputs"),
+                    REJECT_INVALID, "bad-txns-inputs-duplicate");
     }
 
     if (tx.IsCoinBase()) {
@@ -988,9 +1172,22 @@ CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowF
 }
 
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+/** Expire old transactions and evict the cheapest packages until the pool fits
+ *  in -maxmempool again. Called after every mempool insertion so the pool can
+ *  never grow past the configured limit by more than one transaction. */
+static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
+{
+    int expired = pool.Expire(GetTime() - age);
+    if (expired != 0)
+        LogPrint("mempool", "Expired %i transactions from the memory pool\n", expired);
+    pool.TrimToSize(limit);
+}
+
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, int64_t nAcceptTime, bool fRejectInsaneFee, bool ignoreFees)
 {
     AssertLockHeld(cs_main);
+    CPerfScope perfscope("AcceptToMemoryPool");
+    CTxTraceScope tracescope("mempool.accept", tx.GetHash());
     if (pfMissingInputs)
         *pfMissingInputs = false;
 
@@ -1204,7 +1401,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
         ////////////////////////////////////////////////////////////
 
         double dPriority = view.GetPriority(tx, chainActive.Height(), inChainInputValue);
-        CTxMemPoolEntry entry(MakeTransactionRef(tx), nFees, GetTime(), dPriority, chainActive.Height(), inChainInputValue, fSpendsCoinbase, nSigOpsCost,  lp, pool.HasNoInputsOf(tx),CAmount(txMinGasPrice));
+        CTxMemPoolEntry entry(MakeTransactionRef(tx), nFees, nAcceptTime, dPriority, chainActive.Height(), inChainInputValue, fSpendsCoinbase, nSigOpsCost,  lp, pool.HasNoInputsOf(tx),CAmount(txMinGasPrice));
 
         // Check that the transaction doesn't have an excessive number of
         // sigops, making it impossible to mine. Since the coinbase transaction
@@ -1218,6 +1415,17 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
             return state.DoS(0, error("AcceptToMemoryPool : too many sigops %s, %d > %d", hash.ToString(), nSigOpsCost, MAX_STANDARD_TX_SIGOPS_COST),
                              REJECT_NONSTANDARD, "bad-txns-too-many-sigops");
 
+        // When the pool has been trimmed recently, require enough fee to beat the
+        // cheapest package that was evicted, otherwise spam can cycle through the
+        // pool for free. This applies even to prioritised dstx: it is a resource
+        // bound, not a relay policy.
+        CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+        if (mempoolRejectFee > 0 && nFees < mempoolRejectFee) {
+            return state.DoS(0, error("AcceptToMemoryPool : mempool min fee not met %s, %d < %d",
+                                    hash.ToString(), nFees, mempoolRejectFee),
+                REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+        }
+
         // Don't accept it if it can't get into a block
         // but prioritise dstx and don't check fees for it
         if (!ignoreFees) {
@@ -1290,8 +1498,18 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
             return error("AcceptToMemoryPool: : BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s", hash.ToString());
         }
 
-        // Store transaction in memory
-        pool.addUnchecked(hash, entry);
+        // Store transaction in memory. Do not feed fee estimates from
+        // transactions accepted while we are still catching up: confirmation
+        // targets measured against stale tips are meaningless.
+        pool.addUnchecked(hash, entry, !IsInitialBlockDownload());
+
+        // Enforce -maxmempool: expire stale transactions and evict the lowest
+        // feerate packages. If that threw out the transaction we just added,
+        // report it as rejected rather than silently dropping it.
+        LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000,
+                         GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+        if (!pool.exists(hash))
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
     }
 
     SyncWithWallets(tx, NULL);
@@ -1299,6 +1517,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
     return true;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+{
+    return AcceptToMemoryPoolWithTime(pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), fRejectInsaneFee, ignoreFees);
+}
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool isDSTX)
 {
     AssertLockHeld(cs_main);
@@ -1417,7 +1640,7 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
         dev::u256 txMinGasPrice = 0;
 
         //////////////////////////////////////////////////////////// // lux
-        if(chainActive.Height() >= Params().FirstSCBlock() && tx.HasCreateOrCall()) {
+        if(chainActive.Height() >= frozenParams.nFirstSCBlock && tx.HasCreateOrCall()) {
 
             if(!CheckSenderScript(view, tx)){
                 return state.DoS(1, false, REJECT_INVALID, "bad-txns-invalid-sender-script");
@@ -1602,10 +1825,150 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 }
 
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
+/** Bounded LRU over txindex lookups (txid -> transaction and block hash).
+ *  Explorer-style RPC loads fetch the same recent transactions over and
+ *  over; serving repeats from here skips the LevelDB seek, the block file
+ *  read and the PHI header hash. Protected by its own lock so hits do not
+ *  contend on cs_main. */
+static const size_t MAX_TXINDEX_CACHE = 10000;
+namespace {
+struct TxIndexCacheEntry {
+    CTransactionRef tx;
+    uint256 hashBlock;
+    std::list<uint256>::iterator itRecency;
+};
+} // anon namespace
+static CCriticalSection cs_txIndexCache;
+static std::list<uint256> listTxIndexRecency;
+static std::map<uint256, TxIndexCacheEntry> mapTxIndexCache;
+
+/** Block hashes by on-disk block position. Distinct transactions from the
+ *  same block would otherwise each pay for a PHI hash of its header. The
+ *  map is simply cleared when full; entries are all the same age class
+ *  (recent blocks), so the precision of an LRU buys nothing here. */
+static const size_t MAX_BLOCKHASH_POS_CACHE = 5000;
+static std::map<std::pair<int, unsigned int>, uint256> mapBlockHashByPos;
+
+static bool TxIndexCacheLookup(const uint256& hash, CTransaction& txOut, uint256& hashBlock)
+{
+    LOCK(cs_txIndexCache);
+    std::map<uint256, TxIndexCacheEntry>::iterator it = mapTxIndexCache.find(hash);
+    if (it == mapTxIndexCache.end())
+        return false;
+    listTxIndexRecency.splice(listTxIndexRecency.begin(), listTxIndexRecency, it->second.itRecency);
+    txOut = *it->second.tx;
+    hashBlock = it->second.hashBlock;
+    return true;
+}
+
+static void TxIndexCacheInsert(const uint256& hash, const CTransaction& tx, const uint256& hashBlock)
+{
+    LOCK(cs_txIndexCache);
+    if (mapTxIndexCache.count(hash))
+        return;
+    listTxIndexRecency.push_front(hash);
+    TxIndexCacheEntry& entry = mapTxIndexCache[hash];
+    entry.tx = std::make_shared<const CTransaction>(tx);
+    entry.hashBlock = hashBlock;
+    entry.itRecency = listTxIndexRecency.begin();
+    while (mapTxIndexCache.size() > MAX_TXINDEX_CACHE) {
+        mapTxIndexCache.erase(listTxIndexRecency.back());
+        listTxIndexRecency.pop_back();
+    }
+}
+
+/** Read a transaction straight from its txindex position. Requires cs_main
+ *  (block index lookups for the phi2 switchover). */
+//! Resolve the hash of the block record at pos, caching by file position.
+//! The header alone doesn't say whether the phi2 hash applies, so the
+//! parent's height decides.
+static uint256 BlockHashForRecord(const std::pair<int, unsigned int>& pos, const CBlockHeader& header)
+{
+    AssertLockHeld(cs_main);
+    std::map<std::pair<int, unsigned int>, uint256>::iterator itHash = mapBlockHashByPos.find(pos);
+    if (itHash != mapBlockHashByPos.end())
+        return itHash->second;
+    CBlockIndex* pindexPrev = LookupBlockIndex(header.hashPrevBlock);
+    bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block : false;
+    uint256 hashBlock = header.GetHash(usePhi2);
+    if (mapBlockHashByPos.size() >= MAX_BLOCKHASH_POS_CACHE)
+        mapBlockHashByPos.clear();
+    mapBlockHashByPos[pos] = hashBlock;
+    return hashBlock;
+}
+
+static bool ReadTransactionFromDisk(const CDiskTxPos& postx, const uint256& hash, CTransaction& txOut, uint256& hashBlock)
+{
+    AssertLockHeld(cs_main);
+
+    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: OpenBlockFile failed", __func__);
+    CBlockHeader header;
+    try {
+        int nFirst = fgetc(file.Get());
+        if (nFirst == EOF)
+            return error("%s: read failed", __func__);
+        if ((unsigned char)nFirst == COMPRESSED_BLOCK_MARKER) {
+            // Compressed record: nTxOffset refers to the raw serialization,
+            // so the whole block has to be decompressed and the transaction
+            // located by hash instead.
+            CBlock block;
+            CBlockCompressor compressor(block);
+            file >> compressor;
+            header = block.GetBlockHeader();
+            bool fFound = false;
+            BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+                if (tx.GetHash() == hash) {
+                    txOut = tx;
+                    fFound = true;
+                    break;
+                }
+            }
+            if (!fFound)
+                return error("%s: tx not found in compressed block", __func__);
+        } else {
+            if (ungetc(nFirst, file.Get()) == EOF)
+                return error("%s: ungetc failed", __func__);
+            file >> header;
+            fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+            file >> txOut;
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    hashBlock = BlockHashForRecord(std::make_pair(postx.nFile, postx.nPos), header);
+
+    if (txOut.GetHash() != hash)
+        return error("%s: txid mismatch", __func__);
+    TxIndexCacheInsert(hash, txOut, hashBlock);
+    return true;
+}
+
+bool GetAddressIndex(const uint160& addressHash, unsigned char type, std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, int start, int end)
+{
+    if (!fAddressIndex)
+        return error("%s: address index not enabled", __func__);
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+        return error("%s: unable to read address index", __func__);
+    return true;
+}
+
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    if (!fSpentIndex)
+        return false;
+    return pblocktree->ReadSpentIndex(key, value);
+}
+
 bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::Params& consensusParams, uint256& hashBlock, bool fAllowSlow)
 {
     CBlockIndex* pindexSlow = NULL;
 
+    if (TxIndexCacheLookup(hash, txOut, hashBlock))
+        return true;
+
     LOCK(cs_main);
 
     CTransactionRef ptx = mempool.get(hash);
@@ -1617,27 +1980,8 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
 
     if (fTxIndex) {
         CDiskTxPos postx;
-        if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
-            CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            }
-
-            CBlockIndex* pindexPrev = LookupBlockIndex(header.hashPrevBlock);
-            bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= Params().SwitchPhi2Block() : false;
-
-            hashBlock = header.GetHash(usePhi2);
-            if (txOut.GetHash() != hash)
-                return error("%s: txid mismatch", __func__);
-            return true;
-        }
+        if (pblocktree->ReadTxIndex(hash, postx))
+            return ReadTransactionFromDisk(postx, hash, txOut, hashBlock);
 
         return false;
     }
@@ -1670,6 +2014,181 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
     return false;
 }
 
+static bool DiskTxPosCompare(const std::pair<CDiskTxPos, size_t>& a, const std::pair<CDiskTxPos, size_t>& b)
+{
+    if (a.first.nFile != b.first.nFile)
+        return a.first.nFile < b.first.nFile;
+    if (a.first.nPos != b.first.nPos)
+        return a.first.nPos < b.first.nPos;
+    return a.first.nTxOffset < b.first.nTxOffset;
+}
+
+//! Read all requested transactions that live in the same block record with a
+//! single open (and, for compressed records, a single inflate). Every entry
+//! in vGroup must share nFile/nPos; the second member indexes vhash/vtxOut.
+static void ReadTransactionsFromDisk(const std::vector<std::pair<CDiskTxPos, size_t> >& vGroup,
+    const std::vector<uint256>& vhash,
+    std::vector<CTransactionRef>& vtxOut,
+    std::vector<uint256>& vhashBlock)
+{
+    AssertLockHeld(cs_main);
+
+    const CDiskTxPos& posFirst = vGroup[0].first;
+    if (vGroup.size() == 1) {
+        const size_t i = vGroup[0].second;
+        CTransaction tx;
+        if (ReadTransactionFromDisk(posFirst, vhash[i], tx, vhashBlock[i]))
+            vtxOut[i] = std::make_shared<const CTransaction>(tx);
+        return;
+    }
+
+    CAutoFile file(OpenBlockFile(posFirst, true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        error("%s: OpenBlockFile failed", __func__);
+        return;
+    }
+
+    const std::pair<int, unsigned int> pos(posFirst.nFile, posFirst.nPos);
+    try {
+        int nFirst = fgetc(file.Get());
+        if (nFirst == EOF) {
+            error("%s: read failed", __func__);
+            return;
+        }
+        if ((unsigned char)nFirst == COMPRESSED_BLOCK_MARKER) {
+            // The record is compressed as a unit, so inflate it once for the
+            // whole group and pick the transactions out by hash.
+            CBlock block;
+            CBlockCompressor compressor(block);
+            file >> compressor;
+            const uint256 hashBlock = BlockHashForRecord(pos, block.GetBlockHeader());
+            std::map<uint256, size_t> mapWanted;
+            BOOST_FOREACH (const PAIRTYPE(CDiskTxPos, size_t) & entry, vGroup)
+                mapWanted[vhash[entry.second]] = entry.second;
+            BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+                std::map<uint256, size_t>::iterator it = mapWanted.find(tx.GetHash());
+                if (it == mapWanted.end())
+                    continue;
+                vtxOut[it->second] = std::make_shared<const CTransaction>(tx);
+                vhashBlock[it->second] = hashBlock;
+                TxIndexCacheInsert(tx.GetHash(), tx, hashBlock);
+            }
+        } else {
+            if (ungetc(nFirst, file.Get()) == EOF) {
+                error("%s: ungetc failed", __func__);
+                return;
+            }
+            CBlockHeader header;
+            file >> header;
+            const long nTxStart = ftell(file.Get());
+            const uint256 hashBlock = BlockHashForRecord(pos, header);
+            BOOST_FOREACH (const PAIRTYPE(CDiskTxPos, size_t) & entry, vGroup) {
+                const size_t i = entry.second;
+                if (fseek(file.Get(), nTxStart + entry.first.nTxOffset, SEEK_SET) != 0) {
+                    error("%s: fseek failed", __func__);
+                    return;
+                }
+                CTransaction tx;
+                file >> tx;
+                if (tx.GetHash() != vhash[i]) {
+                    error("%s: txid mismatch", __func__);
+                    continue;
+                }
+                vtxOut[i] = std::make_shared<const CTransaction>(tx);
+                vhashBlock[i] = hashBlock;
+                TxIndexCacheInsert(vhash[i], tx, hashBlock);
+            }
+        }
+    } catch (const std::exception& e) {
+        error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+}
+
+namespace {
+void PrefetchTxRecordsWorker(const std::vector<std::pair<CDiskTxPos, size_t> >* pvMisses, std::atomic<size_t>* pnNext)
+{
+    RenameThread("lux-txfetch");
+    std::vector<char> vchBuf(65536);
+    size_t n;
+    while ((n = pnNext->fetch_add(1)) < pvMisses->size()) {
+        const CDiskTxPos& postx = (*pvMisses)[n].first;
+        FILE* file = OpenBlockFile(postx, true);
+        if (!file)
+            continue;
+        // The record length isn't known before parsing, so pull a window
+        // covering the header and the transaction into the page cache; the
+        // parsing pass under cs_main then reads from memory.
+        size_t nLeft = (size_t)postx.nTxOffset + MAX_STANDARD_TX_SIZE;
+        while (nLeft > 0) {
+            size_t nRead = fread(&vchBuf[0], 1, std::min(nLeft, vchBuf.size()), file);
+            if (nRead == 0)
+                break;
+            nLeft -= nRead;
+        }
+        fclose(file);
+    }
+}
+} // anon namespace
+
+void GetTransactions(const std::vector<uint256>& vhash, std::vector<CTransactionRef>& vtxOut, std::vector<uint256>& vhashBlock)
+{
+    vtxOut.assign(vhash.size(), CTransactionRef());
+    vhashBlock.assign(vhash.size(), uint256(0));
+
+    // Resolve what we can from the mempool and the lookup cache, and collect
+    // the txindex positions of the rest so the disk reads can be ordered by
+    // file offset instead of request order.
+    std::vector<std::pair<CDiskTxPos, size_t> > vMisses;
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < vhash.size(); i++) {
+            CTransaction tx;
+            if (TxIndexCacheLookup(vhash[i], tx, vhashBlock[i])) {
+                vtxOut[i] = std::make_shared<const CTransaction>(tx);
+                continue;
+            }
+            CTransactionRef ptx = mempool.get(vhash[i]);
+            if (ptx) {
+                vtxOut[i] = ptx;
+                continue;
+            }
+            CDiskTxPos postx;
+            if (fTxIndex && pblocktree->ReadTxIndex(vhash[i], postx))
+                vMisses.push_back(std::make_pair(postx, i));
+        }
+    }
+
+    std::sort(vMisses.begin(), vMisses.end(), DiskTxPosCompare);
+
+    // Warm the page cache for the missing records in parallel with no locks
+    // held, so the disk sees the whole batch at once instead of one request
+    // at a time from under cs_main.
+    if (vMisses.size() > 4) {
+        int nThreads = std::max(1, std::min(GetNumCores(), 8));
+        if (nThreads >= 2) {
+            std::atomic<size_t> nNext(0);
+            boost::thread_group fetchers;
+            for (int i = 0; i < nThreads; i++)
+                fetchers.create_thread(boost::bind(&PrefetchTxRecordsWorker, &vMisses, &nNext));
+            fetchers.join_all();
+        }
+    }
+
+    LOCK(cs_main);
+    size_t n = 0;
+    while (n < vMisses.size()) {
+        // The misses are sorted by position, so transactions sharing a block
+        // record form a contiguous run; read each record once.
+        size_t nEnd = n + 1;
+        while (nEnd < vMisses.size() && vMisses[nEnd].first.nFile == vMisses[n].first.nFile &&
+               vMisses[nEnd].first.nPos == vMisses[n].first.nPos)
+            nEnd++;
+        std::vector<std::pair<CDiskTxPos, size_t> > vGroup(vMisses.begin() + n, vMisses.begin() + nEnd);
+        ReadTransactionsFromDisk(vGroup, vhash, vtxOut, vhashBlock);
+        n = nEnd;
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // CBlock and CBlockIndex
@@ -1682,6 +2201,36 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos)
     if (fileout.IsNull())
         return error("WriteBlockToDisk : OpenBlockFile failed");
 
+    // Readers recognize a compressed record by its leading marker byte, and
+    // a raw record starts with the low byte of the header nVersion, which
+    // consensus does not bound. Force the compressed format for any block
+    // whose raw serialization would collide with the marker, so a hostile
+    // miner cannot craft a version that makes its own record unreadable.
+    bool fCompress = GetBoolArg("-compressblockfiles", DEFAULT_COMPRESS_BLOCK_FILES) ||
+                     (unsigned char)(block.nVersion & 0xff) == COMPRESSED_BLOCK_MARKER;
+
+    if (fCompress) {
+        // Compact record: the marker byte followed by the CBlockCompressor
+        // serialization. The index length field covers the marker, so the
+        // raw-region readers still see a length that matches what is on
+        // disk.
+        CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+        ssBlock << COMPRESSED_BLOCK_MARKER;
+        ssBlock << CBlockCompressor(*const_cast<CBlock*>(&block));
+
+        unsigned int nCompressedSize = ssBlock.size();
+        fileout << FLATDATA(Params().MessageStart()) << nCompressedSize;
+
+        long fileOutPos = ftell(fileout.Get());
+        if (fileOutPos < 0)
+            return error("WriteBlockToDisk : ftell failed");
+
+        pos.nPos = (unsigned int)fileOutPos;
+        fileout.write(&ssBlock[0], ssBlock.size());
+        FileWriteBackHint(fileout.Get());
+        return true;
+    }
+
     // Write index header
     unsigned int nSize = fileout.GetSerializeSize(block);
     fileout << FLATDATA(Params().MessageStart()) << nSize;
@@ -1694,28 +2243,102 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos)
     pos.nPos = (unsigned int)fileOutPos;
     fileout << block;
 
+    // Start writeback now so the periodic FlushBlockFile() fdatasync does
+    // not have to push a whole connect burst of blocks in one go.
+    FileWriteBackHint(fileout.Get());
+
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams)
+#ifndef WIN32
+/**
+ * Deserialize a block straight out of a memory-mapped region of its block
+ * file, avoiding the per-field read()+memcpy cost of going through stdio.
+ * The serialized size is taken from the index header WriteBlockToDisk put
+ * in front of the block. Returns false (without logging) when the mapping
+ * cannot be established, in which case the caller falls back to CAutoFile.
+ */
+static bool ReadBlockFromDiskMmap(CBlock& block, const CDiskBlockPos& pos)
 {
-    block.SetNull();
+    // The 4-byte size prefix sits directly in front of the block data.
+    if (pos.nPos < 4)
+        return false;
 
-    // Open history file to read
     CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
-        return error("ReadBlockFromDisk : OpenBlockFile failed");
+        return false;
 
-    // Read block
+    unsigned int nSize = 0;
+    if (fseek(filein.Get(), pos.nPos - 4, SEEK_SET) != 0)
+        return false;
+    if (fread((char*)&nSize, 1, sizeof(nSize), filein.Get()) != sizeof(nSize))
+        return false;
+    if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+        return false;
+
+    const long nPageSize = sysconf(_SC_PAGESIZE);
+    const size_t nPageOffset = pos.nPos % nPageSize;
+    const size_t nMapSize = nPageOffset + nSize;
+    void* pMap = mmap(NULL, nMapSize, PROT_READ, MAP_PRIVATE, fileno(filein.Get()), pos.nPos - nPageOffset);
+    if (pMap == MAP_FAILED)
+        return false;
+
+    bool fOk = true;
     try {
-        filein >> block;
-    } catch (const std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        const char* pData = (const char*)pMap + nPageOffset;
+        if ((unsigned char)pData[0] == COMPRESSED_BLOCK_MARKER) {
+            CMemoryViewStream stream(pData + 1, nSize - 1, SER_DISK, CLIENT_VERSION);
+            CBlockCompressor compressor(block);
+            stream >> compressor;
+        } else {
+            CMemoryViewStream stream(pData, nSize, SER_DISK, CLIENT_VERSION);
+            stream >> block;
+        }
+    } catch (const std::exception&) {
+        fOk = false;
+    }
+    munmap(pMap, nMapSize);
+    return fOk;
+}
+#endif
+
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams)
+{
+    block.SetNull();
+
+#ifndef WIN32
+    // Fast path: deserialize from a mapping of the block file.
+    if (!ReadBlockFromDiskMmap(block, pos))
+#endif
+    {
+        block.SetNull();
+
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk : OpenBlockFile failed");
+
+        // Read block
+        try {
+            int nFirst = fgetc(filein.Get());
+            if (nFirst == EOF)
+                return error("ReadBlockFromDisk : read failed");
+            if ((unsigned char)nFirst == COMPRESSED_BLOCK_MARKER) {
+                CBlockCompressor compressor(block);
+                filein >> compressor;
+            } else {
+                if (ungetc(nFirst, filein.Get()) == EOF)
+                    return error("ReadBlockFromDisk : ungetc failed");
+                filein >> block;
+            }
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Check the header
     if (block.IsProofOfWork()) {
-        if (!CheckProofOfWork(block.GetHash(nHeight >= Params().SwitchPhi2Block()), block.nBits, consensusParams))
+        if (!CheckProofOfWork(block.GetHash(nHeight >= frozenParams.nSwitchPhi2Block), block.nBits, consensusParams))
             return error("ReadBlockFromDisk : Errors in block header");
     }
 
@@ -1736,6 +2359,70 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+/** Small LRU of recently fetched, fully decoded blocks, with singleflight
+ *  semantics: concurrent requests for the same hash share one disk read and
+ *  deserialization instead of each doing their own. Serving paths (RPC,
+ *  REST, getdata) go through this; validation keeps its own uncached reads.
+ */
+static const size_t MAX_FETCHED_BLOCK_CACHE = 8;
+
+static CWaitableCriticalSection cs_blockFetchCache;
+static CConditionVariable condBlockFetch;
+static std::list<std::pair<uint256, std::shared_ptr<const CBlock> > > listFetchedBlocks;
+static std::set<uint256> setBlockFetchInFlight;
+
+std::shared_ptr<const CBlock> FetchBlockShared(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    const uint256 hash = pindex->GetBlockHash();
+    {
+        boost::unique_lock<boost::mutex> lock(cs_blockFetchCache);
+        while (true) {
+            for (std::list<std::pair<uint256, std::shared_ptr<const CBlock> > >::iterator it = listFetchedBlocks.begin(); it != listFetchedBlocks.end(); ++it) {
+                if (it->first == hash) {
+                    // move to the front so the hot blocks stay cached
+                    listFetchedBlocks.splice(listFetchedBlocks.begin(), listFetchedBlocks, it);
+                    return listFetchedBlocks.front().second;
+                }
+            }
+            if (!setBlockFetchInFlight.count(hash))
+                break;
+            // another thread is already reading this block; wait for it
+            condBlockFetch.wait(lock);
+        }
+        setBlockFetchInFlight.insert(hash);
+    }
+
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    bool fOk = ReadBlockFromDisk(*pblock, pindex, consensusParams);
+
+    {
+        boost::unique_lock<boost::mutex> lock(cs_blockFetchCache);
+        setBlockFetchInFlight.erase(hash);
+        if (fOk) {
+            listFetchedBlocks.push_front(std::make_pair(hash, std::shared_ptr<const CBlock>(pblock)));
+            if (listFetchedBlocks.size() > MAX_FETCHED_BLOCK_CACHE)
+                listFetchedBlocks.pop_back();
+        }
+    }
+    condBlockFetch.notify_all();
+    return fOk ? std::shared_ptr<const CBlock>(pblock) : std::shared_ptr<const CBlock>();
+}
+
+//! Seed the shared fetch cache with a block we already hold in memory, so the
+//! flurry of relay, RPC and wallet reads that follows a tip connection is
+//! served from the cache instead of re-reading the record just written.
+static void CacheBlockShared(const uint256& hash, const CBlock& block)
+{
+    boost::unique_lock<boost::mutex> lock(cs_blockFetchCache);
+    for (std::list<std::pair<uint256, std::shared_ptr<const CBlock> > >::iterator it = listFetchedBlocks.begin(); it != listFetchedBlocks.end(); ++it) {
+        if (it->first == hash)
+            return;
+    }
+    listFetchedBlocks.push_front(std::make_pair(hash, std::make_shared<const CBlock>(block)));
+    if (listFetchedBlocks.size() > MAX_FETCHED_BLOCK_CACHE)
+        listFetchedBlocks.pop_back();
+}
+
 
 double ConvertBitsToDouble(unsigned int nBits)
 {
@@ -2003,6 +2690,70 @@ bool CScriptCheck::operator()()
     return true;
 }
 
+/**
+ * Transactions whose input scripts have already been fully verified, keyed
+ * by witness hash (which commits to every byte the script checks consume)
+ * together with the verify flags they passed under. Fed by mempool
+ * acceptance and consulted before dispatching CScriptCheck work, so in
+ * steady state connecting a block only pays for the scripts of
+ * transactions that were never relayed to us. Script verify flags are
+ * monotonic — each flag only adds constraints — so a hit under a superset
+ * of the required flags is conclusive.
+ */
+static const size_t MAX_SCRIPT_VALIDATION_CACHE = 50000;
+static CCriticalSection cs_scriptValidationCache;
+static std::map<uint256, unsigned int> mapScriptValidationCache;
+
+static bool AreScriptsValidated(const uint256& hashTx, unsigned int flags)
+{
+    LOCK(cs_scriptValidationCache);
+    std::map<uint256, unsigned int>::const_iterator it = mapScriptValidationCache.find(hashTx);
+    return it != mapScriptValidationCache.end() && (it->second & flags) == flags;
+}
+
+static void MarkScriptsValidated(const uint256& hashTx, unsigned int flags)
+{
+    LOCK(cs_scriptValidationCache);
+    while (mapScriptValidationCache.size() >= MAX_SCRIPT_VALIDATION_CACHE) {
+        // Evict around a random key so an attacker cannot target an entry
+        std::map<uint256, unsigned int>::iterator it = mapScriptValidationCache.lower_bound(GetRandHash());
+        if (it == mapScriptValidationCache.end())
+            it = mapScriptValidationCache.begin();
+        mapScriptValidationCache.erase(it);
+    }
+    mapScriptValidationCache[hashTx] |= flags;
+}
+
+/**
+ * Blocks relayed to us by a -trustedleader peer (hot-standby follower
+ * mode). The leader already executed every script; the follower derives
+ * the identical coins/undo deltas from the block itself, so ConnectBlock
+ * skips only the script re-execution for these while amount, UTXO,
+ * signature-of-block and every other consensus check still run. Bounded
+ * so a long-running follower does not accumulate one hash per block.
+ */
+static const size_t MAX_TRUSTED_BLOCK_MARKS = 4096;
+static CCriticalSection cs_trustedBlocks;
+static std::set<uint256> setTrustedBlocks;
+
+static void MarkBlockTrusted(const uint256& hashBlock)
+{
+    LOCK(cs_trustedBlocks);
+    while (setTrustedBlocks.size() >= MAX_TRUSTED_BLOCK_MARKS) {
+        std::set<uint256>::iterator it = setTrustedBlocks.lower_bound(GetRandHash());
+        if (it == setTrustedBlocks.end())
+            it = setTrustedBlocks.begin();
+        setTrustedBlocks.erase(it);
+    }
+    setTrustedBlocks.insert(hashBlock);
+}
+
+static bool IsBlockTrusted(const uint256& hashBlock)
+{
+    LOCK(cs_trustedBlocks);
+    return setTrustedBlocks.count(hashBlock) != 0;
+}
+
 bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck>* pvChecks)
 {
     if (!tx.IsCoinBase()) {
@@ -2041,7 +2792,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 
             // If prev is coinbase, check that it's matured
             if (coins->IsCoinBase() || coins->IsCoinStake()) {
-                if (nSpendHeight - coins->nHeight < Params().COINBASE_MATURITY())
+                if (nSpendHeight - coins->nHeight < frozenParams.nCoinbaseMaturity)
                     return state.Invalid(
                         error("CheckInputs() : tried to spend coinbase at depth %d, coinstake=%d", nSpendHeight - coins->nHeight, coins->IsCoinStake()),
                         REJECT_INVALID, "bad-txns-premature-spend-of-coinbase");
@@ -2078,6 +2829,12 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            // Whole-transaction shortcut: scripts already verified under at
+            // least these flags, typically at mempool acceptance.
+            const uint256 hashFullTx = tx.GetWitnessHash();
+            if (AreScriptsValidated(hashFullTx, flags))
+                return true;
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint& prevout = tx.vin[i].prevout;
                 const CCoins* coins = inputs.AccessCoins(prevout.hash);
@@ -2111,6 +2868,11 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
                     return state.DoS(100, false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
                 }
             }
+
+            // Only record the result when every check ran synchronously and
+            // passed; with pvChecks the work is deferred to the check queue.
+            if (cacheStore && !pvChecks)
+                MarkScriptsValidated(hashFullTx, flags);
         }
     }
 
@@ -2141,6 +2903,71 @@ static bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const CO
     return fClean;
 }
 
+/**
+ * Bounded cache of recent blocks' undo data, keyed by block hash and
+ * populated at ConnectBlock time, so short reorgs never read the
+ * rev?????.dat files. Depth is configurable with -undocachedepth
+ * (0 disables the cache).
+ */
+static CCriticalSection cs_undoCache;
+static std::map<uint256, CBlockUndo> mapUndoCache;
+static std::deque<uint256> dequeUndoCache;
+
+static void UndoCacheAdd(const uint256& hashBlock, const CBlockUndo& blockundo)
+{
+    int nDepth = GetArg("-undocachedepth", DEFAULT_UNDO_CACHE_DEPTH);
+    if (nDepth <= 0)
+        return;
+    LOCK(cs_undoCache);
+    if (mapUndoCache.insert(std::make_pair(hashBlock, blockundo)).second)
+        dequeUndoCache.push_back(hashBlock);
+    while ((int)dequeUndoCache.size() > nDepth) {
+        mapUndoCache.erase(dequeUndoCache.front());
+        dequeUndoCache.pop_front();
+    }
+}
+
+static bool UndoCacheGet(const uint256& hashBlock, CBlockUndo& blockundo)
+{
+    LOCK(cs_undoCache);
+    std::map<uint256, CBlockUndo>::const_iterator it = mapUndoCache.find(hashBlock);
+    if (it == mapUndoCache.end())
+        return false;
+    blockundo = it->second;
+    return true;
+}
+
+/**
+ * Map a scriptPubKey to the (type, hash160) stored in the address index.
+ * Only single-address standard scripts are indexed: P2PKH, P2SH, and P2PK
+ * (filed under the hash of the key so it merges with the P2PKH history).
+ * Returns false and a zero type for anything else.
+ */
+static bool ExtractIndexAddress(const CScript& script, unsigned char& addressType, uint160& hashBytes)
+{
+    if (script.IsPayToScriptHash()) {
+        addressType = ADDRESS_INDEX_TYPE_SCRIPTHASH;
+        hashBytes = uint160(std::vector<unsigned char>(script.begin() + 2, script.begin() + 22));
+        return true;
+    }
+    // pay-to-pubkey-hash: OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+    if (script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 && script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        addressType = ADDRESS_INDEX_TYPE_PUBKEYHASH;
+        hashBytes = uint160(std::vector<unsigned char>(script.begin() + 3, script.begin() + 23));
+        return true;
+    }
+    // pay-to-pubkey: <33 or 65 bytes> OP_CHECKSIG
+    if ((script.size() == 35 && script[0] == 33 && script[34] == OP_CHECKSIG) ||
+        (script.size() == 67 && script[0] == 65 && script[66] == OP_CHECKSIG)) {
+        addressType = ADDRESS_INDEX_TYPE_PUBKEYHASH;
+        hashBytes = Hash160(script.begin() + 1, script.end() - 1);
+        return true;
+    }
+    addressType = 0;
+    hashBytes.SetNull();
+    return false;
+}
+
 bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
@@ -2151,20 +2978,34 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
     bool fClean = true;
 
     CBlockUndo blockUndo;
-    CDiskBlockPos pos = pindex->GetUndoPos();
-    if (pos.IsNull())
-        return error("DisconnectBlock() : no undo data available");
-    if (!blockUndo.ReadFromDisk(pos, pindex->pprev->GetBlockHash()))
-        return error("DisconnectBlock() : failure reading undo data");
+    if (!UndoCacheGet(pindex->GetBlockHash(), blockUndo)) {
+        CDiskBlockPos pos = pindex->GetUndoPos();
+        if (pos.IsNull())
+            return error("DisconnectBlock() : no undo data available");
+        if (!blockUndo.ReadFromDisk(pos, pindex->pprev->GetBlockHash()))
+            return error("DisconnectBlock() : failure reading undo data");
+    }
 
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
         return error("DisconnectBlock() : block and undo data inconsistent");
 
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction& tx = block.vtx[i];
         uint256 hash = tx.GetHash();
 
+        if (fAddressIndex) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                unsigned char addressType;
+                uint160 hashBytes;
+                if (ExtractIndexAddress(tx.vout[k].scriptPubKey, addressType, hashBytes))
+                    addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, hash, k, false), tx.vout[k].nValue));
+            }
+        }
+
         // Check that all outputs are available and match the outputs in the block itself
         // exactly. Note that transactions with only provably unspendable outputs won't
         // have outputs available even in the block itself, so we handle that case
@@ -2196,6 +3037,17 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
                 const CTxInUndo& undo = txundo.vprevout[j];
                 if (!ApplyTxInUndo(undo, view, out))
                     fClean = false;
+
+                if (fAddressIndex || fSpentIndex) {
+                    unsigned char addressType;
+                    uint160 hashBytes;
+                    ExtractIndexAddress(undo.txout.scriptPubKey, addressType, hashBytes);
+                    if (fAddressIndex && addressType > 0)
+                        addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, hash, j, true), undo.txout.nValue * -1));
+                    // A null value makes UpdateSpentIndex erase the entry.
+                    if (fSpentIndex)
+                        spentIndex.push_back(std::make_pair(CSpentIndexKey(out.hash, out.n), CSpentIndexValue()));
+                }
             }
         }
     }
@@ -2203,16 +3055,26 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 //#if 0
-      if (pindex->nHeight > Params().FirstSCBlock()) {
+      if (pindex->nHeight > frozenParams.nFirstSCBlock) {
         globalState->setRoot(uintToh256(pindex->pprev->hashStateRoot)); // lux
         globalState->setRootUTXO(uintToh256(pindex->pprev->hashUTXORoot)); // lux
 
         if (pfClean == NULL && fLogEvents) {
             pstorageresult->deleteResults(block.vtx);
+            pblocktree->EraseLogsBloom(pindex->GetBlockHash());
             //pblocktree->EraseHeightIndex(pindex->nHeight);
         }
    }
 //#endif
+    // Like the log indexes above, only touch the explorer indexes on a real
+    // disconnect, not during -checkblocks style dry runs.
+    if (pfClean == NULL) {
+        if (fAddressIndex && !pblocktree->EraseAddressIndex(addressIndex))
+            return error("DisconnectBlock() : failed to erase address index entries");
+        if (fSpentIndex && !pblocktree->UpdateSpentIndex(spentIndex))
+            return error("DisconnectBlock() : failed to erase spent index entries");
+    }
+
     if (pfClean) {
         *pfClean = fClean;
         return true;
@@ -2224,13 +3086,33 @@ void static FlushBlockFile(bool fFinalize = false)
 {
     LOCK(cs_LastBlockFile);
 
+    // With -blockfilesyncwindow=<seconds> set, periodic flushes within the
+    // window only kick off asynchronous writeback and the blocking fdatasync
+    // is issued at most once per window. A crash inside the window can leave
+    // the block index referring to data that never hit the platter, which
+    // costs a reindex, so this stays opt-in for nodes that can redownload.
+    // Finalizing a file always syncs: its info record is about to go final.
+    static int64_t nLastHardSync = 0;
+    bool fHardSync = true;
+    const int64_t nSyncWindow = GetArg("-blockfilesyncwindow", 0);
+    if (!fFinalize && nSyncWindow > 0) {
+        const int64_t nNow = GetTime();
+        if (nNow < nLastHardSync + nSyncWindow)
+            fHardSync = false;
+        else
+            nLastHardSync = nNow;
+    }
+
     CDiskBlockPos posOld(nLastBlockFile, 0);
 
     FILE* fileOld = OpenBlockFile(posOld);
     if (fileOld) {
         if (fFinalize)
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
-        FileCommit(fileOld);
+        if (fHardSync)
+            FileCommit(fileOld);
+        else
+            FileWriteBackHint(fileOld);
         fclose(fileOld);
     }
 
@@ -2238,7 +3120,10 @@ void static FlushBlockFile(bool fFinalize = false)
     if (fileOld) {
         if (fFinalize)
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
-        FileCommit(fileOld);
+        if (fHardSync)
+            FileCommit(fileOld);
+        else
+            FileWriteBackHint(fileOld);
         fclose(fileOld);
     }
 }
@@ -2250,6 +3135,11 @@ static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 void ThreadScriptCheck()
 {
     RenameThread("lux-scriptch");
+    // Keep the validation workers on one NUMA node when requested; the coins
+    // and script caches they populate follow via the first-touch policy.
+    int nNumaNode = GetArg("-numanodevalidation", -1);
+    if (nNumaNode >= 0 && !BindThreadToNumaNode(nNumaNode))
+        LogPrintf("%s: could not bind to NUMA node %d\n", __func__, nNumaNode);
     scriptcheckqueue.Thread();
 }
 
@@ -2286,7 +3176,7 @@ int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Para
         ThresholdState state = VersionBitsState(pindexPrev, params, (Consensus::DeploymentPos)i, versionbitscache);
         if ((Consensus::DeploymentPos)i == Consensus::SMART_CONTRACTS_HARDFORK) {
             int nextHeight = pindexPrev != nullptr ? pindexPrev->nHeight + 1 : 1;
-            if (nextHeight >= Params().FirstSCBlock()) {
+            if (nextHeight >= frozenParams.nFirstSCBlock) {
                 nVersion |= VersionBitsMask(params, (Consensus::DeploymentPos)i);
             }
         } else {
@@ -2338,9 +3228,26 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/** Discard the EVM's per-block scratch memory. Successful executions commit
+ *  inside performByteCode, so any overlay nodes still cached here belong to a
+ *  reverted state root and can be dropped; afterwards the arena behind the
+ *  overlay caches is recycled in one piece instead of freeing contract-heavy
+ *  blocks back to the heap one trie node at a time.
+ */
+void static ResetEVMStateScratch()
+{
+    AssertLockHeld(cs_main);
+    if (!globalState)
+        return;
+    globalState->db().rollback();
+    globalState->dbUtxo().rollback();
+    dev::StateCacheArena::global().reset();
+}
+
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
 {
     AssertLockHeld(cs_main);
+    CPerfScope perfscope("ConnectBlock");
 
     ///////////////////////////////////////////////// // lux
 #if 0
@@ -2385,15 +3292,43 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         return true;
     }
 
-//    if (pindex->nHeight <= Params().LAST_POW_BLOCK() && block.IsProofOfStake())
+//    if (pindex->nHeight <= frozenParams.nLastPOWBlock && block.IsProofOfStake())
 //        return state.DoS(100, error("%s: PoS period not active", __func__),
 //            REJECT_INVALID, "PoS-early");
 
-    if (pindex->nHeight > Params().LAST_POW_BLOCK() && block.IsProofOfWork())
+    if (pindex->nHeight > frozenParams.nLastPOWBlock && block.IsProofOfWork())
         return state.DoS(100, error("%s: PoW period ended", __func__),
             REJECT_INVALID, "PoW-ended");
 
     bool fScriptChecks = pindex->nHeight >= Checkpoints::GetTotalBlocksEstimate(chainparams.Checkpoints());
+    if (fScriptChecks && !hashAssumeValid.IsNull()) {
+        // Script checks may also be skipped for ancestors of the configured
+        // assumed-valid block, provided the best header chain actually
+        // contains that block and buries this one deeply. Amount, UTXO and
+        // all other consensus checks below still run.
+        BlockMap::const_iterator it = mapBlockIndex.find(hashAssumeValid);
+        if (it != mapBlockIndex.end()) {
+            if (it->second->GetAncestor(pindex->nHeight) == pindex &&
+                pindexBestHeader != NULL &&
+                pindexBestHeader->GetAncestor(pindex->nHeight) == pindex &&
+                pindexBestHeader->nHeight - pindex->nHeight >= ASSUME_VALID_MIN_DEPTH) {
+                fScriptChecks = false;
+            }
+        }
+    }
+    if (fScriptChecks && IsBlockTrusted(pindex->GetBlockHash())) {
+        // Hot-standby follower: the configured leader already executed these
+        // scripts; everything below except script dispatch still runs.
+        fScriptChecks = false;
+    }
+    if (fScriptChecks && fReindexChainState && pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
+        // -reindex-chainstate replays blocks this node fully validated
+        // before; only the UTXO set is being rebuilt from the surviving
+        // block index, so scripts need not be executed again. Blocks that
+        // never reached BLOCK_VALID_SCRIPTS (e.g. arriving from the network
+        // during the rebuild) still take the full path.
+        fScriptChecks = false;
+    }
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
     // unless those are already completely spent.
@@ -2447,6 +3382,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     ///////////////////////////////////////////////////////// // lux
     std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> heightIndexes;
+    dev::eth::LogBloom blockLogsBloom;
     /////////////////////////////////////////////////////////
 
     int64_t nTimeStart = GetTimeMicros();
@@ -2456,6 +3392,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     int64_t nValueOut = 0;
     int64_t nValueIn = 0;
@@ -2465,6 +3403,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     uint64_t blockGasUsed = 0;
     CAmount gasRefunds=0;
 
+    // Accumulate script checks for the whole block and hand them to the
+    // verification queue in large batches instead of one Add() per
+    // transaction; this amortizes the queue mutex over many signatures.
+    static const unsigned int SCRIPT_CHECK_BATCH_SIZE = 128;
+    std::vector<CScriptCheck> vChecks;
+    vChecks.reserve(SCRIPT_CHECK_BATCH_SIZE);
+
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = block.vtx[i];
 
@@ -2503,16 +3448,18 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                 nFees += view.GetValueIn(tx) - tx.GetValueOut();
             }
 
-            std::vector<CScriptCheck> vChecks;
             if (!CheckInputs(tx, state, view, fScriptChecks, flags, false, txdata[i], nScriptCheckThreads ? &vChecks : NULL))
                 return false;
-            control.Add(vChecks);
+            if (vChecks.size() >= SCRIPT_CHECK_BATCH_SIZE) {
+                control.Add(vChecks);
+                vChecks.clear();
+            }
         } else {
             nValueOut += tx.GetValueOut();
         }
 
 ///////////////////////////////////////////////////////////////////////////////////////// lux
-        if (pindex->nHeight >= Params().FirstSCBlock()) {
+        if (pindex->nHeight >= frozenParams.nFirstSCBlock) {
             bool hasOpSpend = tx.HasOpSpend();
 
             if(!hasOpSpend) {
@@ -2612,7 +3559,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                             heightIndexes[key].first = CHeightTxIndexKey(pindex->nHeight, resultExec[k].execRes.newAddress);
                         }
                         heightIndexes[key].second.push_back(tx.GetHash());
-                        tri.push_back(TransactionReceiptInfo{block.GetHash(pindex->nHeight >= Params().SwitchPhi2Block()), uint32_t(pindex->nHeight), tx.GetHash(), uint32_t(i), resultConvertLuxTX.first[k].from(), resultConvertLuxTX.first[k].to(),
+                        blockLogsBloom |= resultExec[k].txRec.bloom();
+                        tri.push_back(TransactionReceiptInfo{block.GetHash(pindex->nHeight >= frozenParams.nSwitchPhi2Block), uint32_t(pindex->nHeight), tx.GetHash(), uint32_t(i), resultConvertLuxTX.first[k].from(), resultConvertLuxTX.first[k].to(),
                                                              countCumulativeGasUsed, uint64_t(resultExec[k].execRes.gasUsed), resultExec[k].execRes.newAddress, resultExec[k].txRec.log(), resultExec[k].execRes.excepted});
                     }
 
@@ -2642,6 +3590,34 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
 /////////////////////////////////////////////////////////////////////////////////////////
 
+        // Collect the explorer index entries while the inputs' coins are
+        // still unspent in the view; UpdateCoins below removes them.
+        if (fAddressIndex || fSpentIndex) {
+            const uint256 txhash = tx.GetHash();
+            if (!tx.IsCoinBase()) {
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const COutPoint& prevout = tx.vin[j].prevout;
+                    const CCoins* coins = view.AccessCoins(prevout.hash);
+                    const CTxOut& txPrevOut = coins->vout[prevout.n];
+                    unsigned char addressType;
+                    uint160 hashBytes;
+                    ExtractIndexAddress(txPrevOut.scriptPubKey, addressType, hashBytes);
+                    if (fAddressIndex && addressType > 0)
+                        addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), txPrevOut.nValue * -1));
+                    if (fSpentIndex)
+                        spentIndex.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, txPrevOut.nValue, addressType, hashBytes)));
+                }
+            }
+            if (fAddressIndex) {
+                for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                    unsigned char addressType;
+                    uint160 hashBytes;
+                    if (ExtractIndexAddress(tx.vout[k].scriptPubKey, addressType, hashBytes))
+                        addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), tx.vout[k].nValue));
+                }
+            }
+        }
+
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
@@ -2652,6 +3628,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
 
+    // Flush the remaining partial batch of script checks.
+    control.Add(vChecks);
+    vChecks.clear();
+
     // ppcoin: track money supply and mint amount info
     pindex->nMint = nValueOut - nValueIn + nFees;
     pindex->nMoneySupply = (pindex->pprev ? pindex->pprev->nMoneySupply : 0) + nValueOut - nValueIn;
@@ -2691,12 +3671,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs - 1), nTimeVerify * 0.000001);
 
     ////////////////////////////////////////////////////////////////// // lux
-    if (pindex->nHeight >= Params().FirstSCBlock()) {
+    if (pindex->nHeight >= frozenParams.nFirstSCBlock) {
         checkBlock.hashMerkleRoot = BlockMerkleRoot(checkBlock);
         checkBlock.hashStateRoot = h256Touint(globalState->rootHash());
         checkBlock.hashUTXORoot = h256Touint(globalState->rootHashUTXO());
 
-        bool usePhi2 = pindex->nHeight >= Params().SwitchPhi2Block();
+        bool usePhi2 = pindex->nHeight >= frozenParams.nSwitchPhi2Block;
         //If this error happens, it probably means that something with AAL created transactions didn't match up to what is expected
         if ((checkBlock.GetHash(usePhi2) != block.GetHash(usePhi2)) && !fJustCheck) {
             LogPrintf("Actual block data does not match block expected by AAL\n");
@@ -2757,7 +3737,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     if (fJustCheck) {
-        if (pindex->nHeight > Params().FirstSCBlock()) {
+        if (pindex->nHeight > frozenParams.nFirstSCBlock) {
             dev::h256 prevHashStateRoot(dev::sha3(dev::rlp("")));
             dev::h256 prevHashUTXORoot(dev::sha3(dev::rlp("")));
             if (pindex->pprev->hashStateRoot != uint256() && pindex->pprev->hashUTXORoot != uint256()) {
@@ -2767,6 +3747,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             globalState->setRoot(prevHashStateRoot);
             globalState->setRootUTXO(prevHashUTXORoot);
         }
+        ResetEVMStateScratch();
         return true;
     }
 //////////////////////////////////////////////////////////////////
@@ -2785,6 +3766,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             pindex->nStatus |= BLOCK_HAVE_UNDO;
         }
 
+        UndoCacheAdd(pindex->GetBlockHash(), blockundo);
+
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
         setDirtyBlockIndex.insert(pindex);
     }
@@ -2793,6 +3776,19 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return state.Error("Failed to write transaction index");
 
+    if (fAddressIndex)
+        if (!pblocktree->WriteAddressIndex(addressIndex))
+            return state.Error("Failed to write address index");
+
+    if (fSpentIndex)
+        if (!pblocktree->UpdateSpentIndex(spentIndex))
+            return state.Error("Failed to write spent index");
+
+    // Absent key means "no logs in this block"; searchlogs skips such blocks.
+    if (fLogEvents && blockLogsBloom != dev::eth::LogBloom())
+        if (!pblocktree->WriteLogsBloom(pindex->GetBlockHash(), blockLogsBloom.asBytes()))
+            return state.Error("Failed to write logs bloom index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2809,6 +3805,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     nTimeCallbacks += nTime4 - nTime3;
     LogPrint("bench", "    - Callbacks: %.2fms [%.2fs]\n", 0.001 * (nTime4 - nTime3), nTimeCallbacks * 0.000001);
 
+    ResetEVMStateScratch();
+
     return true;
 }
 
@@ -2823,17 +3821,87 @@ enum FlushStateMode {
 static bool FlushStateToDisk(CValidationState &state, FlushStateMode mode, int nManualPruneHeight=0);
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 
+/** How often the coins/signature cache split is reconsidered. */
+static const int64_t CACHE_REBALANCE_INTERVAL = 5 * 60;
+
+/**
+ * Shift budget between the in-memory coins cache and the signature cache
+ * based on which one missed more since the last check. The combined budget
+ * is fixed at whatever init handed out; only the split moves. During IBD
+ * almost all signature checks are skipped, so the coins cache naturally
+ * absorbs the budget, and at steady state mempool acceptance pushes it
+ * back. The LevelDB block caches are sized at open and cannot take part.
+ */
+static void RebalanceCacheBudgets()
+{
+    AssertLockHeld(cs_main);
+
+    static int64_t nLastRebalance = 0;
+    static uint64_t nLastCoinLookups = 0, nLastCoinHits = 0;
+    static uint64_t nLastSigLookups = 0, nLastSigHits = 0;
+    static size_t nCombinedBudget = 0;
+
+    int64_t nNow = GetTime();
+    if (nLastRebalance == 0) {
+        // First call: record the total budget and the counter baseline.
+        nCombinedBudget = (size_t)nCoinCacheSize * 300 + GetSignatureCacheSize();
+        nLastCoinLookups = GetCoinsCacheLookups();
+        nLastCoinHits = GetCoinsCacheHits();
+        nLastSigLookups = GetSignatureCacheLookups();
+        nLastSigHits = GetSignatureCacheHits();
+        nLastRebalance = nNow;
+        return;
+    }
+    if (nNow - nLastRebalance < CACHE_REBALANCE_INTERVAL || nCombinedBudget == 0)
+        return;
+
+    uint64_t nCoinMisses = (GetCoinsCacheLookups() - nLastCoinLookups) - (GetCoinsCacheHits() - nLastCoinHits);
+    uint64_t nSigMisses = (GetSignatureCacheLookups() - nLastSigLookups) - (GetSignatureCacheHits() - nLastSigHits);
+    nLastCoinLookups = GetCoinsCacheLookups();
+    nLastCoinHits = GetCoinsCacheHits();
+    nLastSigLookups = GetSignatureCacheLookups();
+    nLastSigHits = GetSignatureCacheHits();
+    nLastRebalance = nNow;
+
+    size_t nSigBudget = GetSignatureCacheSize();
+    if (nSigBudget > nCombinedBudget)
+        nSigBudget = nCombinedBudget;
+    size_t nFloor = nCombinedBudget / 10;
+    size_t nStep = nCombinedBudget / 10;
+
+    // Require a clear imbalance before moving anything, so the split does
+    // not oscillate on noise.
+    if (nCoinMisses > 2 * nSigMisses && nSigBudget > nFloor) {
+        nSigBudget = (nSigBudget > nFloor + nStep) ? nSigBudget - nStep : nFloor;
+    } else if (nSigMisses > 2 * nCoinMisses && nCombinedBudget - nSigBudget > nFloor + nStep) {
+        nSigBudget += nStep;
+    } else {
+        return;
+    }
+
+    SetSignatureCacheSize(nSigBudget);
+    nCoinCacheSize = (nCombinedBudget - nSigBudget) / 300;
+    LogPrint("bench", "%s: coin misses %d sig misses %d -> sigcache %u MiB, coin cache %u entries\n",
+        __func__, nCoinMisses, nSigMisses, nSigBudget >> 20, nCoinCacheSize);
+}
+
 /**
  * Update the on-disk chain state.
  * The caches and indexes are flushed if either they're too large, forceWrite is set, or
  * fast is not set and it's been a while since the last write.
  */
+static void WarmCoinsCacheFromMempool();
+
 static bool FlushStateToDisk(CValidationState& state, FlushStateMode mode, int nManualPruneHeight)
 {
+    CPerfScope perfscope("FlushStateToDisk");
     LOCK2(cs_main, cs_LastBlockFile);
     static int64_t nLastWrite = 0;
+    if (mode == FLUSH_STATE_PERIODIC)
+        RebalanceCacheBudgets();
     int retries = MAX_DATA_FLUSH_RETRY;
     string strErr = "";
+    bool fCoinsCacheFlushed = false;
 
     while (retries > 0)
     {
@@ -2847,7 +3915,7 @@ static bool FlushStateToDisk(CValidationState& state, FlushStateMode mode, int n
                 if (nManualPruneHeight > 0) {
                     FindFilesToPruneManual(setFilesToPrune, nManualPruneHeight);
                 } else {
-                    FindFilesToPrune(setFilesToPrune, Params().PruneAfterHeight());
+                    FindFilesToPrune(setFilesToPrune, frozenParams.nPruneAfterHeight);
                     fCheckForPruning = false;
                 }
 
@@ -2859,7 +3927,7 @@ static bool FlushStateToDisk(CValidationState& state, FlushStateMode mode, int n
                     }
                 }
             }
-		    if ((mode == FLUSH_STATE_ALWAYS) ||
+		    if ((mode == FLUSH_STATE_ALWAYS) || fFlushForPrune ||
 		        ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->GetCacheSize() > nCoinCacheSize) ||
 		        (mode == FLUSH_STATE_PERIODIC && GetTimeMicros() > nLastWrite + DATABASE_WRITE_INTERVAL * 1000000)) {
 		        // Typical CCoins structures on disk are around 100 bytes in size.
@@ -2893,6 +3961,10 @@ static bool FlushStateToDisk(CValidationState& state, FlushStateMode mode, int n
 		        // Finally flush the chainstate (which may refer to block index entries).
 		        if (!pcoinsTip->Flush())
 		            return state.Error("Failed to write to coin database");
+		        fCoinsCacheFlushed = true;
+		        // Persist the rolling UTXO hash with the chainstate it matches.
+		        if (fUtxoSetHash && utxoSetHash.IsValid())
+		            pcoinsdbview->WriteUtxoSetHash(utxoSetHash.GetHash(), pcoinsTip->GetBestBlock());
 
                 // Finally remove any pruned files
                 if (fFlushForPrune) {
@@ -2902,7 +3974,7 @@ static bool FlushStateToDisk(CValidationState& state, FlushStateMode mode, int n
 
 		        // Update best block in wallet (so we can detect restored wallets).
 		        if (mode != FLUSH_STATE_IF_NEEDED) {
-		            GetMainSignals().SetBestChain(chainActive.GetLocator());
+		            NotifySetBestChain(chainActive.GetLocator());
 		        }
 		        nLastWrite = GetTimeMicros();
 		    }
@@ -2915,6 +3987,10 @@ static bool FlushStateToDisk(CValidationState& state, FlushStateMode mode, int n
 
 		if (!isExceptionOccured)
 		{
+			// Flushing emptied the coins cache; refill it with the coins the
+			// next blocks will spend, taken from our own mempool.
+			if (fCoinsCacheFlushed)
+				WarmCoinsCacheFromMempool();
 			return true;
 		}
 		retries--;
@@ -2923,6 +3999,33 @@ static bool FlushStateToDisk(CValidationState& state, FlushStateMode mode, int n
     return state.Error(strErr);
 }
 
+/** Re-pull coins referenced by mempool transactions into the coins cache
+ *  after a full flush dropped them. ConnectBlock needs exactly these entries
+ *  when the transactions confirm, so warming them from our own mempool turns
+ *  most of the next blocks' coin lookups back into cache hits. Highest
+ *  mining-score transactions are warmed first (the ones a block will carry
+ *  soonest) and the walk stops at a quarter of the coin cache entry budget
+ *  so the warm set cannot push the cache back over its flush threshold. */
+static void WarmCoinsCacheFromMempool()
+{
+    AssertLockHeld(cs_main);
+    if (IsInitialBlockDownload())
+        return;
+
+    const unsigned int nBudget = nCoinCacheSize / 4;
+    unsigned int nTxWarmed = 0;
+    LOCK(mempool.cs);
+    for (CTxMemPool::indexed_transaction_set::index<mining_score>::type::iterator it = mempool.mapTx.get<mining_score>().begin();
+         it != mempool.mapTx.get<mining_score>().end() && pcoinsTip->GetCacheSize() < nBudget; ++it) {
+        BOOST_FOREACH (const CTxIn& txin, it->GetTx().vin)
+            pcoinsTip->AccessCoins(txin.prevout.hash);
+        nTxWarmed++;
+    }
+    if (nTxWarmed > 0)
+        LogPrint("bench", "Warmed coins cache from mempool: %u txs, %u cache entries\n",
+                 nTxWarmed, (unsigned int)pcoinsTip->GetCacheSize());
+}
+
 void FlushStateToDisk()
 {
     CValidationState state;
@@ -2935,6 +4038,51 @@ void PruneAndFlush() {
     FlushStateToDisk(state, FLUSH_STATE_NONE);
 }
 
+//! Dirty share of the coin cache budget that makes an early flush worthwhile.
+static const unsigned int ADAPTIVE_FLUSH_DIRTY_PCT = 40;
+//! Defer flushing while LevelDB has this many level-0 files awaiting
+//! compaction; its own write throttling starts at eight.
+static const int ADAPTIVE_FLUSH_MAX_L0_FILES = 4;
+//! How long after the last received block the chain counts as idle.
+static const int64_t ADAPTIVE_FLUSH_IDLE_SECONDS = 30;
+
+/**
+ * Flush opportunistically between blocks instead of letting the size and
+ * timer thresholds in FlushStateToDisk fire while a block is connecting,
+ * which lands the write exactly when it doubles validation latency. Runs
+ * off the scheduler and flushes only when all three line up: enough of the
+ * cache is dirty for the write to be worth its cost, LevelDB is not backed
+ * up with level-0 compaction work (flushing into a backlog is what
+ * stalls), and no block arrived recently so we are inside an inter-block
+ * gap. The hard thresholds in FlushStateToDisk stay as the backstop.
+ */
+void AdaptiveFlushCheck()
+{
+    TRY_LOCK(cs_main, lockMain); // never contend with block validation
+    if (!lockMain)
+        return;
+    if (pcoinsTip == NULL || IsInitialBlockDownload() || fReindex || fImporting)
+        return;
+
+    const unsigned int nDirty = pcoinsTip->GetDirtyCacheSize();
+    if ((uint64_t)nDirty * 100 < (uint64_t)nCoinCacheSize * ADAPTIVE_FLUSH_DIRTY_PCT)
+        return;
+
+    if (GetTime() - nTimeBestReceived < ADAPTIVE_FLUSH_IDLE_SECONDS)
+        return;
+
+    std::string strL0;
+    if (pcoinsdbview != NULL && pcoinsdbview->GetDbProperty("leveldb.num-files-at-level0", strL0) &&
+        atoi(strL0.c_str()) >= ADAPTIVE_FLUSH_MAX_L0_FILES) {
+        LogPrint("coindb", "%s: deferring, %s level-0 files pending compaction\n", __func__, strL0);
+        return;
+    }
+
+    LogPrint("coindb", "%s: flushing %u dirty entries during idle gap\n", __func__, nDirty);
+    CValidationState state;
+    FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex* pindexNew, const CChainParams& chainParams)
 {
@@ -2943,6 +4091,7 @@ void static UpdateTip(CBlockIndex* pindexNew, const CChainParams& chainParams)
     // New best block
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
+    PublishEVMSnapshot();
 
     if (!hideLogMessage)
         LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%u\n",
@@ -2994,21 +4143,73 @@ void static UpdateTip(CBlockIndex* pindexNew, const CChainParams& chainParams)
 }
 
 /** Disconnect chainActive's tip. */
+/** Sum of the rolling-hash terms a block adds to the UTXO set minus the
+ *  terms it spends (modulo 2^256). The view must contain the spent prevouts,
+ *  so call this before ConnectBlock or after DisconnectBlock; outputs created
+ *  and spent within the block never reach the view and are resolved from the
+ *  block itself. Connecting applies the delta with Add, disconnecting with
+ *  Remove. */
+static bool ComputeBlockUtxoHashDelta(const CBlock& block, int nHeight, const CCoinsViewCache& view, uint256& deltaRet)
+{
+    uint256 delta = 0;
+    std::map<uint256, const CTransaction*> mapBlockTx;
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        const uint256 txid = tx.GetHash();
+        if (!tx.IsCoinBase()) {
+            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+                const COutPoint& prevout = txin.prevout;
+                std::map<uint256, const CTransaction*>::const_iterator mi = mapBlockTx.find(prevout.hash);
+                if (mi != mapBlockTx.end()) {
+                    // In-block spend: reconstruct the coin as it briefly existed.
+                    CCoins coinsFromBlock(*mi->second, nHeight);
+                    if (prevout.n >= coinsFromBlock.vout.size() || coinsFromBlock.vout[prevout.n].IsNull())
+                        return error("%s : in-block prevout %s not found", __func__, prevout.ToString());
+                    delta -= CUtxoSetHasher::CoinHash(prevout, coinsFromBlock.vout[prevout.n], nHeight, coinsFromBlock.fCoinBase, coinsFromBlock.fCoinStake);
+                } else {
+                    const CCoins* coins = view.AccessCoins(prevout.hash);
+                    if (!coins || !coins->IsAvailable(prevout.n))
+                        return error("%s : prevout %s not found in view", __func__, prevout.ToString());
+                    delta -= CUtxoSetHasher::CoinHash(prevout, coins->vout[prevout.n], coins->nHeight, coins->fCoinBase, coins->fCoinStake);
+                }
+            }
+        }
+        // Mirror exactly what CCoins stores for this transaction's outputs.
+        CCoins coins(tx, nHeight);
+        for (unsigned int i = 0; i < coins.vout.size(); i++) {
+            if (!coins.vout[i].IsNull())
+                delta += CUtxoSetHasher::CoinHash(COutPoint(txid, i), coins.vout[i], nHeight, coins.fCoinBase, coins.fCoinStake);
+        }
+        mapBlockTx[txid] = &tx;
+    }
+    deltaRet = delta;
+    return true;
+}
+
 static bool DisconnectTip(CValidationState& state, const CChainParams& chainparams)
 {
     CBlockIndex* pindexDelete = chainActive.Tip();
     assert(pindexDelete);
     mempool.check(pcoinsTip);
-    // Read block from disk.
-    CBlock block;
-    if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus()))
+    // Read block from disk; a block being disconnected was usually connected
+    // moments ago, so this is normally served by the recent-block cache.
+    std::shared_ptr<const CBlock> pblockRead = FetchBlockShared(pindexDelete, chainparams.GetConsensus());
+    if (!pblockRead)
         return state.Error("Failed to read block");
+    CBlock block(*pblockRead);
     // Apply the block atomically to the chain state.
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
         if (!DisconnectBlock(block, state, pindexDelete, view))
             return error("DisconnectTip() : DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
+        if (fUtxoSetHash && utxoSetHash.IsValid()) {
+            // The view now holds the restored prevouts the delta needs.
+            uint256 hashDelta = 0;
+            if (ComputeBlockUtxoHashDelta(block, pindexDelete->nHeight, view, hashDelta))
+                utxoSetHash.Remove(hashDelta);
+            else
+                utxoSetHash.Invalidate();
+        }
         assert(view.Flush());
     }
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
@@ -3037,8 +4238,11 @@ static bool DisconnectTip(CValidationState& state, const CChainParams& chainpara
     UpdateTip(pindexDelete->pprev, chainparams);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        SyncWithWallets(tx, NULL);
+    {
+        CDBFlushGuard dbFlushGuard; // one wallet checkpoint for the whole block
+        BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+            SyncWithWallets(tx, NULL);
+        }
     }
     return true;
 }
@@ -3053,6 +4257,24 @@ static int64_t nTimePostConnect = 0;
  * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
  */
+/** Single-entry cache of the most recently connected block's full merkle
+ *  tree (CBlock::BuildMerkleTree layout). Every filtered (SPV) peer asking
+ *  for the new block then shares one tree build; the per-peer work is just
+ *  the masked traversal in CPartialMerkleTree.
+ */
+static CCriticalSection cs_merkleTreeCache;
+static uint256 hashMerkleTreeCache;
+static std::vector<uint256> vMerkleTreeCache;
+
+static void CacheBlockMerkleTree(const CBlock& block, const uint256& hashBlock)
+{
+    if (block.vMerkleTree.empty())
+        block.BuildMerkleTree();
+    LOCK(cs_merkleTreeCache);
+    hashMerkleTreeCache = hashBlock;
+    vMerkleTreeCache = block.vMerkleTree;
+}
+
 bool static ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const CBlock* pblock)
 {
     assert(pindexNew->pprev == chainActive.Tip());
@@ -3081,6 +4303,13 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
             oldHashUTXORoot = dev::h256(globalState->rootHashUTXO()); // lux
         }
 
+        // Compute the rolling-hash delta while the view still holds the
+        // prevouts this block spends; apply it only once the block connects.
+        uint256 hashDelta = 0;
+        bool fHashDeltaOK = false;
+        if (fUtxoSetHash && utxoSetHash.IsValid())
+            fHashDeltaOK = ComputeBlockUtxoHashDelta(*pblock, pindexNew->nHeight, view, hashDelta);
+
         bool rv = ConnectBlock(*pblock, state, pindexNew, view, chainparams);
         GetMainSignals().BlockChecked(*pblock, state);
         if (!rv) {
@@ -3094,6 +4323,12 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
             return error("ConnectTip() : ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
         mapBlockSource.erase(inv.hash);
+        if (fUtxoSetHash && utxoSetHash.IsValid()) {
+            if (fHashDeltaOK)
+                utxoSetHash.Add(hashDelta);
+            else
+                utxoSetHash.Invalidate();
+        }
         nTime3 = GetTimeMicros();
         nTimeConnectTotal += nTime3 - nTime2;
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
@@ -3119,14 +4354,26 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     mempool.check(pcoinsTip);
     // Update chainActive & related variables.
     UpdateTip(pindexNew, chainparams);
-    // Tell wallet about transactions that went from mempool
-    // to conflicted:
-    BOOST_FOREACH (const CTransaction& tx, txConflicted) {
-        SyncWithWallets(tx, NULL);
+    // Prime the shared merkle tree and block fetch caches for the block we
+    // are about to announce; relay, getblock and wallet readers will all want
+    // it within moments, and during initial sync nobody asks for any of it.
+    if (!IsInitialBlockDownload()) {
+        CacheBlockMerkleTree(*pblock, pindexNew->GetBlockHash());
+        CacheBlockShared(pindexNew->GetBlockHash(), *pblock);
     }
-    // ... and about transactions that got confirmed:
-    BOOST_FOREACH (const CTransaction& tx, pblock->vtx) {
-        SyncWithWallets(tx, pblock);
+    {
+        // Coalesce the per-transaction wallet flushes below into a single
+        // database checkpoint per block.
+        CDBFlushGuard dbFlushGuard;
+        // Tell wallet about transactions that went from mempool
+        // to conflicted:
+        BOOST_FOREACH (const CTransaction& tx, txConflicted) {
+            SyncWithWallets(tx, NULL);
+        }
+        // ... and about transactions that got confirmed:
+        BOOST_FOREACH (const CTransaction& tx, pblock->vtx) {
+            SyncWithWallets(tx, pblock);
+        }
     }
 
     int64_t nTime6 = GetTimeMicros();
@@ -3394,7 +4641,7 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
                 return true;
 
             //Active chain's tip will be updated after ActivateBestChainStep, when block is added, so add 1 to active height
-            usePhi2 = chainActive.Height() + 1 >= Params().SwitchPhi2Block();
+            usePhi2 = chainActive.Height() + 1 >= frozenParams.nSwitchPhi2Block;
 
             if (!ActivateBestChainStep(state, chainparams, pindexMostWork, pblock && pblock->GetHash(usePhi2) == pindexMostWork->GetBlockHash() ? pblock : NULL))
                 return false;
@@ -3405,12 +4652,19 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
 
+        // Flush buffered contract execution results as one batched LevelDB
+        // write, off the cs_main critical path.
+        if (pstorageresult)
+            pstorageresult->commitResults();
+
         // Notifications/callbacks that can run without cs_main
         if (!fInitialDownload) {
             uint256 hashNewTip = pindexNewTip->GetBlockHash();
             // Relay inventory, but don't relay old inventory during initial block download.
             int nBlockEstimate = Checkpoints::GetTotalBlocksEstimate(chainparams.Checkpoints());
-            if (nLocalServices & NODE_NETWORK) {
+            // Pruned nodes still announce the new tip: everything within the
+            // retention window can be served, which is all a fresh tip ever is.
+            if (nLocalServices & (NODE_NETWORK | NODE_NETWORK_LIMITED)) {
                 vector<CNode*> vNodesCopy;
                 {
                     //LOCK(cs_vNodes);
@@ -3508,7 +4762,7 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex)
 CBlockIndex* AddToBlockIndex(const CBlock& block)
 {
     CBlockIndex* pindexPrev = LookupBlockIndex(block.hashPrevBlock);
-    bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= Params().SwitchPhi2Block() : false;
+    bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block : false;
 
     // Check for duplicate
     uint256 hash = block.GetHash(usePhi2);
@@ -3713,7 +4967,7 @@ bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigne
     return true;
 }
 
-bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW) {
+bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, const uint256* phashBlock) {
     // Get prev block index
     bool usePhi2 = false;
     int nBlockHeight = 0;
@@ -3732,7 +4986,7 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const
     }
 
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(usePhi2), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckProofOfWork(phashBlock ? *phashBlock : block.GetHash(usePhi2), block.nBits, consensusParams))
         return state.DoS(50, error("%s: proof of work failed", __func__),
             REJECT_INVALID, "high-hash");
     return true;
@@ -3852,20 +5106,67 @@ bool CheckForMasternodePayment(const CTransaction& tx, const CBlockHeader& heade
     return (roundMnAward == masternodePayment);
 }
 
+namespace {
+//! Shared state for the parallel per-transaction sanity checks in CheckBlock.
+//! Workers claim transaction indexes with a fetch-add and record the first
+//! failure; the legacy sigop count is accumulated alongside since it walks
+//! the same scripts.
+struct CBlockTxCheckState {
+    CBlockTxCheckState(const std::vector<CTransaction>& vtxIn) : vtx(vtxIn), nNext(0), nSigOps(0), fFailed(false), nFailedTx(0) {}
+    const std::vector<CTransaction>& vtx;
+    std::atomic<unsigned int> nNext;  //! next transaction index to claim
+    std::atomic<uint64_t> nSigOps;    //! accumulated legacy sigop count
+    std::atomic<bool> fFailed;
+    CCriticalSection cs;              //! guards failState and nFailedTx
+    CValidationState failState;       //! first failure, reported by the caller
+    unsigned int nFailedTx;
+};
+
+void BlockTxCheckWorker(CBlockTxCheckState* pcheck)
+{
+    RenameThread("lux-txcheck");
+    while (true) {
+        unsigned int i = pcheck->nNext.fetch_add(1);
+        if (i >= pcheck->vtx.size() || pcheck->fFailed)
+            return;
+        const CTransaction& tx = pcheck->vtx[i];
+        CValidationState state;
+        if (!CheckTransaction(tx, state)) {
+            LOCK(pcheck->cs);
+            if (!pcheck->fFailed) {
+                pcheck->failState = state;
+                pcheck->nFailedTx = i;
+                pcheck->fFailed = true;
+            }
+            return;
+        }
+        pcheck->nSigOps += GetLegacySigOpCount(tx);
+    }
+}
+} // anon namespace
+
+//! Blocks with at least this many transactions get their sanity checks
+//! spread across worker threads; spawning threads for less is not worth it.
+static const unsigned int PARALLEL_TX_CHECK_MIN_TXS = 16;
+
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig)
 {
-    const char * const s = block.IsProofOfStake() ? "pos" : "pow";
+    // Select the validation pipeline once; the stake flag steers every
+    // type-specific branch below, and the PoS pipeline never touches the
+    // proof-of-work hash check.
+    const bool fProofOfStake = block.IsProofOfStake();
+    const char * const s = fProofOfStake ? "pos" : "pow";
 
     // These are checks that are independent of context.
 
     // Check that the header is valid (particularly PoW). This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (fCheckPOW && !CheckBlockHeader(block, state, consensusParams, fCheckPOW && block.IsProofOfWork()))
+    if (fCheckPOW && !CheckBlockHeader(block, state, consensusParams, !fProofOfStake))
         return state.DoS(100, error("%s: invalid (%s) block header", __func__, s),
             REJECT_INVALID, "bad-header", true);
 
     // 3 minute future drift for PoS
-    auto const nBlockTimeLimit = GetAdjustedTime() + (block.IsProofOfStake() ? 180 : 7200);
+    auto const nBlockTimeLimit = GetAdjustedTime() + (fProofOfStake ? 180 : 7200);
 
     LogPrint("debug", "%s: block=%s (%s %d %d)\n", __func__, block.GetHash().GetHex(), s,
              block.GetBlockTime(), nBlockTimeLimit);
@@ -3912,7 +5213,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
             return state.DoS(100, error("%s: more than one coinbase", __func__),
                 REJECT_INVALID, "bad-cb-multiple");
 
-    if (block.IsProofOfStake()) {
+    if (fProofOfStake) {
         // Coinbase output should be empty if proof-of-stake block
         int commitpos = GetWitnessCommitmentIndex(block);
         if (block.vtx[0].vout.size() != (commitpos == -1 ? 1 : 2) || !block.vtx[0].vout[0].IsEmpty())
@@ -3931,28 +5232,48 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // -------------------------------------------
 
-    // Check transactions
-    unsigned int nTx = 0;
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        if (!CheckTransaction(tx, state)) {
-            LogPrint("debug", "%s: invalid transaction %s", __func__, tx.ToString());
-            return error("%s: CheckTransaction failed (nTx=%d, reason: %s)", __func__, nTx, state.GetRejectReason());
+    // Check transactions. The per-transaction sanity checks are context-free,
+    // so for blocks with many transactions they are spread across worker
+    // threads sized like the script check pool; small blocks stay serial.
+    uint64_t nSigOps = 0;
+    if (nScriptCheckThreads > 1 && block.vtx.size() >= PARALLEL_TX_CHECK_MIN_TXS) {
+        CBlockTxCheckState check(block.vtx);
+        boost::thread_group group;
+        int nWorkers = std::min(nScriptCheckThreads - 1, (int)block.vtx.size() - 1);
+        for (int n = 0; n < nWorkers; n++)
+            group.create_thread(boost::bind(&BlockTxCheckWorker, &check));
+        BlockTxCheckWorker(&check);
+        group.join_all();
+        if (check.fFailed) {
+            state = check.failState;
+            LogPrint("debug", "%s: invalid transaction %s", __func__, block.vtx[check.nFailedTx].ToString());
+            return error("%s: CheckTransaction failed (nTx=%d, reason: %s)", __func__, check.nFailedTx, state.GetRejectReason());
+        }
+        nSigOps = check.nSigOps;
+    } else {
+        unsigned int nTx = 0;
+        BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+            if (!CheckTransaction(tx, state)) {
+                LogPrint("debug", "%s: invalid transaction %s", __func__, tx.ToString());
+                return error("%s: CheckTransaction failed (nTx=%d, reason: %s)", __func__, nTx, state.GetRejectReason());
+            }
+            nSigOps += GetLegacySigOpCount(tx);
+            ++nTx;
         }
-        // ignore first PoS tx for masternode checks, this vout tx type is "nonstandard"
-        if (block.IsProofOfStake() && nTx == 0)
-            continue;
+    }
 
-        if (fCheckPOW && !CheckForMasternodePayment(tx, block)) {
-            LogPrint("debug", "%s: invalid masternode payment in %s", __func__, tx.ToString());
-            return error("%s: CheckForMasternodePayment failed (nTx=%d)", __func__, nTx);
+    // Masternode payments are checked against the whole block, so this
+    // stays serial. Skip the coinbase of proof-of-stake blocks; its vout
+    // shape is "nonstandard".
+    if (fCheckPOW) {
+        for (unsigned int i = fProofOfStake ? 1 : 0; i < block.vtx.size(); i++) {
+            if (!CheckForMasternodePayment(block.vtx[i], block)) {
+                LogPrint("debug", "%s: invalid masternode payment in %s", __func__, block.vtx[i].ToString());
+                return error("%s: CheckForMasternodePayment failed (nTx=%d)", __func__, i);
+            }
         }
-        ++nTx;
     }
 
-    unsigned int nSigOps = 0;
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        nSigOps += GetLegacySigOpCount(tx);
-    }
     if (nSigOps * WITNESS_SCALE_FACTOR > MAX_BLOCK_SIGOPS_COST)
         return state.DoS(100, error("%s: out-of-bounds SigOpCount", __func__),
             REJECT_INVALID, "bad-blk-sigops", true);
@@ -3985,19 +5306,32 @@ bool CheckWork(const CBlock &block, CBlockIndex* const pindexPrev)
     if (block.nBits != nBitsRequired)
         return error("%s: incorrect proof of work at %d", __func__, pindexPrev->nHeight + 1);
 
-    if (block.IsProofOfStake()) {
-        uint256 hashProofOfStake, proof;
-        uint256 hash = block.GetHash(pindexPrev->nHeight + 1 >= chainParams.SwitchPhi2Block());
-        if (!stake->CheckProof(pindexPrev, block, hashProofOfStake)) {
-            return error("%s: invalid proof-of-stake (block %s)\n", __func__, hash.GetHex());
-        }
-        if (stake->GetProof(hash, proof)) {
-            if (proof != hashProofOfStake)
-                return error("%s: diverged stake %s, %s (block %s)\n", __func__,
-                             hashProofOfStake.GetHex(), proof.GetHex(), hash.GetHex());
-        } else {
-            stake->SetProof(hash, hashProofOfStake);
-        }
+    return true;
+}
+
+// Verify the stake kernel of a proof-of-stake block. This is the expensive
+// half of what used to live in CheckWork: it reads the staked input and its
+// block from disk and verifies the coinstake script, so it is kept off the
+// header-critical path and run only after the cheap structural checks pass.
+// No-op for proof-of-work blocks, whose hash was already checked in
+// CheckBlockHeader.
+bool CheckBlockProof(const CBlock& block, CBlockIndex* const pindexPrev)
+{
+    if (!block.IsProofOfStake())
+        return true;
+
+    const CChainParams& chainParams = Params();
+    uint256 hashProofOfStake, proof;
+    uint256 hash = block.GetHash(pindexPrev->nHeight + 1 >= chainParams.SwitchPhi2Block());
+    if (!stake->CheckProof(pindexPrev, block, hashProofOfStake)) {
+        return error("%s: invalid proof-of-stake (block %s)\n", __func__, hash.GetHex());
+    }
+    if (stake->GetProof(hash, proof)) {
+        if (proof != hashProofOfStake)
+            return error("%s: diverged stake %s, %s (block %s)\n", __func__,
+                         hashProofOfStake.GetHex(), proof.GetHex(), hash.GetHex());
+    } else {
+        stake->SetProof(hash, hashProofOfStake);
     }
     return true;
 }
@@ -4007,7 +5341,7 @@ bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& sta
     const CChainParams& chainParams = Params();
     uint256 hash;
     if (pindexPrev) {
-        hash = block.GetHash(pindexPrev->nHeight + 1 >= Params().SwitchPhi2Block());
+        hash = block.GetHash(pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block);
     } else {
         hash = block.GetHash();
     }
@@ -4019,11 +5353,11 @@ bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& sta
 
     int nHeight = pindexPrev->nHeight + 1;
 
-    if (chainActive.Height() - nHeight >= Params().FirstSCBlock() && !(block.nVersion & (1 << 30)))
+    if (chainActive.Height() - nHeight >= frozenParams.nFirstSCBlock && !(block.nVersion & (1 << 30)))
         return state.DoS(1, error("%s: smart contracts hardfork is not active yet. (height %d)", __func__, nHeight));
 
     //If this is a reorg, check that it is not too depp
-    if (chainActive.Height() - nHeight >= Params().MaxReorganizationDepth())
+    if (chainActive.Height() - nHeight >= frozenParams.nMaxReorganizationDepth)
         return state.DoS(1, error("%s: forked chain older than max reorganization depth (height %d)", __func__, nHeight));
 
 //    // Check timestamp against prev
@@ -4127,7 +5461,7 @@ bool IsWitnessEnabled(const CBlockIndex* pindexPrev, const Consensus::Params& pa
     return (VersionBitsState(pindexPrev, params, Consensus::DEPLOYMENT_SEGWIT, versionbitscache) == THRESHOLD_ACTIVE);
 }
 
-bool AcceptBlockHeader(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool AcceptBlockHeader(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256* phashBlock)
 {
     AssertLockHeld(cs_main);
 
@@ -4135,14 +5469,14 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, const CChai
     CBlockIndex* pindexPrev = LookupBlockIndex(block.hashPrevBlock);
     bool usePhi2 = false;
     if (pindexPrev) {
-        usePhi2 = pindexPrev->nHeight + 1 >= Params().SwitchPhi2Block();
+        usePhi2 = pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block;
     } else {
         if (block.GetHash() != Params().GenesisBlock().GetHash())
             return state.DoS(0, error("%s : prev block %s not found", __func__, block.hashPrevBlock.GetHex()), 0, "bad-prevblk");
     }
 
     // Check for duplicate
-    uint256 hash = block.GetHash(usePhi2);
+    uint256 hash = phashBlock ? *phashBlock : block.GetHash(usePhi2);
     CBlockIndex* pindex = LookupBlockIndex(hash);
 
     // TODO : ENABLE BLOCK CACHE IN SPECIFIC CASES
@@ -4155,7 +5489,7 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, const CChai
         return true;
     }
 
-    if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), block.IsProofOfWork())) {
+    if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), block.IsProofOfWork(), phashBlock)) {
         LogPrintf("%s: CheckBlockHeader failed \n", __func__);
         return false;
     }
@@ -4209,6 +5543,14 @@ bool AcceptBlock(const CBlock& block, CValidationState& state, const CChainParam
         return false;
     }
 
+    // Stake kernel verification involves disk reads and script checks, so it
+    // runs last, once the block has survived all of the cheap checks.
+    if (pindexPrev && !CheckBlockProof(block, pindexPrev)) {
+        pindex->nStatus |= BLOCK_FAILED_VALID;
+        setDirtyBlockIndex.insert(pindex);
+        return state.DoS(100, error("%s: invalid block proof", __func__), REJECT_INVALID, "bad-blk-proof");
+    }
+
     int nHeight = pindex->nHeight;
 
     // Write block to history file
@@ -4340,6 +5682,83 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
+namespace {
+void PrefetchCoinsWorker(const std::vector<uint256>* pvFetch, std::atomic<size_t>* pnNext)
+{
+    RenameThread("lux-prefetch");
+    CCoins coins;
+    size_t n;
+    while ((n = pnNext->fetch_add(1)) < pvFetch->size())
+        pcoinsdbview->GetCoins((*pvFetch)[n], coins);
+}
+} // anon namespace
+
+//! Warm the coins database for a block's inputs before validation starts.
+//! Reads go straight to pcoinsdbview (LevelDB reads are safe concurrently and
+//! nothing here touches pcoinsTip), so ConnectBlock's synchronous misses under
+//! cs_main land in the database cache instead of cold storage.
+static void PrefetchInputCoins(const std::vector<CTransaction>& vtx)
+{
+    if (!pcoinsdbview)
+        return;
+
+    std::set<uint256> setTxIds;
+    BOOST_FOREACH (const CTransaction& tx, vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        BOOST_FOREACH (const CTxIn& txin, tx.vin)
+            setTxIds.insert(txin.prevout.hash);
+    }
+    if (setTxIds.empty())
+        return;
+    std::vector<uint256> vFetch(setTxIds.begin(), setTxIds.end());
+
+    // Small blocks aren't worth the thread churn; a serial warm-up outside
+    // cs_main is still a win over faulting inside ConnectBlock.
+    int nThreads = std::max(1, std::min(GetNumCores(), 8));
+    if (vFetch.size() <= 16 || nThreads < 2) {
+        CCoins coins;
+        BOOST_FOREACH (const uint256& txid, vFetch)
+            pcoinsdbview->GetCoins(txid, coins);
+        return;
+    }
+
+    std::atomic<size_t> nNext(0);
+    boost::thread_group fetchers;
+    for (int i = 0; i < nThreads; i++)
+        fetchers.create_thread(boost::bind(&PrefetchCoinsWorker, &vFetch, &nNext));
+    fetchers.join_all();
+}
+
+static void PrefetchInputCoins(const CBlock& block)
+{
+    PrefetchInputCoins(block.vtx);
+}
+
+/** -cutthroughrelay: push an accepted-but-not-yet-connected block straight to
+ *  whitelisted peers. By the time AcceptBlock returns, the block has passed
+ *  CheckBlock (merkle root, proof checks, signature) and the contextual
+ *  header checks, so nothing structurally invalid is ever forwarded; what the
+ *  receiving end skips waiting for is our script/connect validation, which it
+ *  performs itself anyway. Meant for a private backbone where both ends are
+ *  whitelisted and trusted - each hop saves roughly its own connect time. */
+static void CutThroughRelayBlock(const CBlock& block, const uint256& hashBlock, CNode* pfrom)
+{
+    CInv inv(MSG_BLOCK, hashBlock);
+    LOCK(cs_vNodes);
+    BOOST_FOREACH (CNode* pnode, vNodes) {
+        if (pnode == pfrom || !pnode->fWhitelisted || !pnode->fSuccessfullyConnected || pnode->fDisconnect)
+            continue;
+        {
+            LOCK(pnode->cs_inventory);
+            if (pnode->setInventoryKnown.count(inv))
+                continue;
+            pnode->setInventoryKnown.insert(inv);
+        }
+        pnode->PushMessage("block", block);
+    }
+}
+
 bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, CNode* pfrom, const CBlock* pblock, CDiskBlockPos* dbp)
 {
     int nHeight = chainActive.Height() + 1;
@@ -4366,7 +5785,7 @@ bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, C
             return false;
         } else {
             nHeight = pindexPrev->nHeight + 1;
-            usePhi2 = nHeight >= Params().SwitchPhi2Block();
+            usePhi2 = nHeight >= frozenParams.nSwitchPhi2Block;
         }
     }
 
@@ -4376,6 +5795,15 @@ bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, C
                 __func__, nHeight, pblock->nTime, pblock->GetHash().GetHex());
     }
 
+    // Blocks sourced from a trusted leader connect without re-executing
+    // scripts (hot-standby follower mode); the block-level checks above
+    // have already passed.
+    if (pfrom != NULL && CNode::IsTrustedLeaderRange(pfrom->addr))
+        MarkBlockTrusted(pblock->GetHash(usePhi2));
+
+    // Overlap the cold-cache input reads with waiting for cs_main.
+    PrefetchInputCoins(*pblock);
+
     CBlockIndex* pindex = NULL;
     while (true) {
         TRY_LOCK(cs_main, lockMain);
@@ -4401,6 +5829,12 @@ bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, C
         }
     }
 
+    // Forward to the trusted backbone before connect validation runs; the
+    // announcement below still covers everyone else after the block connects.
+    static bool fCutThroughRelay = GetBoolArg("-cutthroughrelay", false);
+    if (fCutThroughRelay && pindex && !IsInitialBlockDownload())
+        CutThroughRelayBlock(*pblock, pindex->GetBlockHash(), pfrom);
+
     if (ActivateBestChain(state, chainparams, pblock)) {
         stake->MarkBlockStaked(pindex->nHeight, pindex->nTime);
     } else {
@@ -4581,7 +6015,7 @@ void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight
     if (chainActive.Tip() == NULL || nPruneTarget == 0) {
         return;
     }
-    if (chainActive.Height() <= Params().PruneAfterHeight()) {
+    if (chainActive.Height() <= frozenParams.nPruneAfterHeight) {
         return;
     }
 
@@ -4869,6 +6303,12 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have the explorer-style indexes
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
+
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -4888,6 +6328,80 @@ bool static LoadBlockIndexDB()
     return true;
 }
 
+namespace {
+
+/** Work queue shared by the VerifyDB worker threads. Workers claim block
+ *  indexes one at a time and run the per-block checks (levels 0..2) that
+ *  are independent of chain-state order; the first failure wins. */
+struct CVerifyDBJob {
+    CCriticalSection cs;
+    const std::vector<CBlockIndex*>* pvBlocks;
+    size_t nNext;
+    int nDone;
+    int nCheckLevel;
+    bool fStop;
+    bool fFailed;
+    std::string strFailure;
+};
+
+void VerifyDBWorker(CVerifyDBJob* pjob, const Consensus::Params* pconsensus)
+{
+    RenameThread("lux-verifydb");
+    const CChainParams& chainparams = Params();
+    while (true) {
+        boost::this_thread::interruption_point();
+        CBlockIndex* pindex = NULL;
+        {
+            LOCK(pjob->cs);
+            if (pjob->fStop || pjob->fFailed || pjob->nNext >= pjob->pvBlocks->size())
+                return;
+            pindex = (*pjob->pvBlocks)[pjob->nNext++];
+        }
+
+        std::string strErr;
+        CBlock block;
+        CValidationState state;
+        // check level 0: read from disk (this also checks the PoW hash
+        // against the index entry)
+        if (!ReadBlockFromDisk(block, pindex, *pconsensus)) {
+            strErr = strprintf("ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        } else if (pjob->nCheckLevel >= 1) {
+            // check level 1: verify block validity. fCheckPOW is off because
+            // its extra work needs cs_main (which the coordinating thread
+            // holds): the PoW hash was already checked by ReadBlockFromDisk,
+            // the masternode-payment check accepts any indexed block, and
+            // the smart-contract header checks are redone below with the
+            // height taken from the index instead of a prev-block lookup.
+            bool fOk = CheckBlock(block, state, *pconsensus, false);
+            if (fOk && pindex->nHeight >= chainparams.FirstSCBlock()) {
+                bool isScVersioned = block.nVersion & (1 << pconsensus->vDeployments[Consensus::SMART_CONTRACTS_HARDFORK].bit);
+                if (!isScVersioned || block.hashStateRoot == uint256(0) || block.hashUTXORoot == uint256(0))
+                    fOk = false;
+            }
+            if (!fOk)
+                strErr = strprintf("found bad block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        }
+        // check level 2: verify undo validity
+        if (strErr.empty() && pjob->nCheckLevel >= 2) {
+            CDiskBlockPos pos = pindex->GetUndoPos();
+            if (!pos.IsNull()) {
+                CBlockUndo undo;
+                if (!undo.ReadFromDisk(pos, pindex->pprev->GetBlockHash()))
+                    strErr = strprintf("found bad undo data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            }
+        }
+
+        LOCK(pjob->cs);
+        pjob->nDone++;
+        if (!strErr.empty() && !pjob->fFailed) {
+            pjob->fFailed = true;
+            pjob->strFailure = strErr;
+        }
+    }
+}
+
+} // anon namespace
+
 CVerifyDB::CVerifyDB()
 {
     uiInterface.ShowProgress(_("Verifying blocks..."), 0);
@@ -4926,41 +6440,72 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView* coinsview,
     }
     //////////////////////////////////////////////////////////////////////////
 
+    // Collect the block range once. The per-block checks (levels 0..2) are
+    // independent of each other and are sliced across worker threads; the
+    // disconnect/reconnect replays (levels 3/4) stay sequential because each
+    // replay depends on the coin state the previous one left behind.
+    std::vector<CBlockIndex*> vBlocks;
     for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
-        boost::this_thread::interruption_point();
-        uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
         if (pindex->nHeight < chainActive.Height() - nCheckDepth)
             break;
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB() : *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus()))
-            return error("VerifyDB() : *** found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!undo.ReadFromDisk(pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB() : *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
-            bool fClean = true;
-            if (!DisconnectBlock(block, state, pindex, coins, &fClean))
-                return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            pindexState = pindex->pprev;
-            if (!fClean) {
-                nGoodTransactions = 0;
+        vBlocks.push_back(pindex);
+    }
+
+    {
+        CVerifyDBJob job;
+        job.pvBlocks = &vBlocks;
+        job.nNext = 0;
+        job.nDone = 0;
+        job.nCheckLevel = nCheckLevel;
+        job.fStop = false;
+        job.fFailed = false;
+
+        int nThreads = std::max(1, std::min(GetNumCores(), 8));
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nThreads && (size_t)i < vBlocks.size(); i++)
+            threadGroup.create_thread(boost::bind(&VerifyDBWorker, &job, &chainparams.GetConsensus()));
+
+        while (true) {
+            boost::this_thread::interruption_point();
+            MilliSleep(50);
+            LOCK(job.cs);
+            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)((double)job.nDone / (double)vBlocks.size() * (nCheckLevel >= 4 ? 50 : 100)))));
+            if (ShutdownRequested())
+                job.fStop = true;
+            if (job.fStop || job.fFailed || job.nDone >= (int)vBlocks.size())
+                break;
+        }
+        threadGroup.join_all();
+
+        if (job.fFailed)
+            return error("VerifyDB() : *** %s", job.strFailure);
+        if (job.fStop)
+            return true;
+    }
+
+    // check level 3: check for inconsistencies during memory-only disconnect
+    // of tip blocks. Disconnects are consecutive from the tip; stop once the
+    // coin cache is full.
+    if (nCheckLevel >= 3) {
+        BOOST_FOREACH (CBlockIndex* pindex, vBlocks) {
+            boost::this_thread::interruption_point();
+            if (pindex != pindexState || (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) > nCoinCacheSize)
+                break;
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+                return error("VerifyDB() : *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            bool fClean = true;
+            if (!DisconnectBlock(block, state, pindex, coins, &fClean))
+                return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            pindexState = pindex->pprev;
+            if (!fClean) {
+                nGoodTransactions = 0;
                 pindexFailure = pindex;
             } else
                 nGoodTransactions += block.vtx.size();
+            if (ShutdownRequested())
+                return true;
         }
-        if (ShutdownRequested())
-            return true;
     }
     if (pindexFailure)
         return error("VerifyDB() : *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
@@ -5014,6 +6559,9 @@ void UnloadBlockIndex()
     }
     mapBlockIndex.clear();
     fHavePruned = false;
+    hashRecentRejectsChainTip = uint256(0);
+    if (recentRejects)
+        recentRejects->reset();
 }
 
 bool LoadBlockIndex()
@@ -5035,6 +6583,12 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -txindex in the new database
     fTxIndex = GetBoolArg("-txindex", true);
     pblocktree->WriteFlag("txindex", fTxIndex);
+
+    // Use the provided settings for the explorer-style indexes
+    fAddressIndex = GetBoolArg("-addressindex", false);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
+    fSpentIndex = GetBoolArg("-spentindex", false);
+    pblocktree->WriteFlag("spentindex", fSpentIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -5064,18 +6618,194 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+namespace {
+//! A raw block handed from the file scanner to a decode worker, then to the
+//! ordered connector stage of the reindex pipeline.
+struct CReindexBlock {
+    std::vector<unsigned char> vch; //! serialized block as found in the file
+    CDiskBlockPos pos;              //! on-disk position (only valid if fHavePos)
+    bool fHavePos;
+    CBlock block;                   //! filled in by a decode worker
+    uint256 hash;                   //! default header hash, filled in by a worker
+    bool fGood;                     //! deserialization succeeded
+};
+
+//! Shared state for the pipelined LoadExternalBlockFile: the scanning thread
+//! feeds raw blocks into queueRaw, decode workers deserialize and hash them,
+//! and the connector drains mapDecoded strictly in input order.
+struct CReindexPipeline {
+    CReindexPipeline() : nQueuedBytes(0), nNextSeq(0), nNextConnect(0), fNoMoreInput(false) {}
+    std::deque<std::pair<uint64_t, CReindexBlock*> > queueRaw;
+    std::map<uint64_t, CReindexBlock*> mapDecoded;
+    size_t nQueuedBytes;
+    uint64_t nNextSeq;
+    uint64_t nNextConnect;
+    bool fNoMoreInput;
+    CWaitableCriticalSection cs;
+    CConditionVariable condWork;  //! signalled when queueRaw grows or input ends
+    CConditionVariable condDone;  //! signalled when a decoded block is delivered
+};
+
+//! Bounds on raw blocks in flight, to cap pipeline memory during a reindex.
+static const size_t REINDEX_QUEUE_DEPTH = 64;
+static const size_t REINDEX_QUEUE_BYTES = 32 * 1024 * 1024;
+
+void ReindexWorker(CReindexPipeline* pipe)
+{
+    RenameThread("lux-reindex");
+    while (true) {
+        std::pair<uint64_t, CReindexBlock*> item;
+        {
+            boost::unique_lock<boost::mutex> lock(pipe->cs);
+            while (pipe->queueRaw.empty() && !pipe->fNoMoreInput)
+                pipe->condWork.wait(lock);
+            if (pipe->queueRaw.empty())
+                return;
+            item = pipe->queueRaw.front();
+            pipe->queueRaw.pop_front();
+            pipe->nQueuedBytes -= item.second->vch.size();
+        }
+        CReindexBlock* entry = item.second;
+        entry->fGood = false;
+        try {
+            CDataStream ssBlock(entry->vch, SER_DISK, CLIENT_VERSION);
+            if (!entry->vch.empty() && (unsigned char)entry->vch[0] == COMPRESSED_BLOCK_MARKER) {
+                // -compressblockfiles record: skip the marker and inflate
+                uint8_t chFirst;
+                ssBlock >> chFirst;
+                CBlockCompressor compressor(entry->block);
+                ssBlock >> compressor;
+            } else {
+                ssBlock >> entry->block;
+            }
+            entry->hash = entry->block.GetHash();
+            entry->fGood = true;
+        } catch (const std::exception& e) {
+            LogPrintf("LoadExternalBlockFile : Deserialize error - %s", e.what());
+        }
+        {
+            boost::unique_lock<boost::mutex> lock(pipe->cs);
+            pipe->mapDecoded[item.first] = entry;
+            pipe->condDone.notify_all();
+        }
+    }
+}
+} // anon namespace
+
+//! Connector stage of a reindex: link one decoded block (and any earlier
+//! encountered descendants) into the chain. Returns false on a state error.
+static bool ReindexProcessBlock(const CChainParams& chainparams, CBlock& block, uint256 hash, CDiskBlockPos* dbp,
+                                std::multimap<uint256, CDiskBlockPos>& mapBlocksUnknownParent, int& nLoaded)
+{
+    // detect out of order blocks, and store them for later
+    CBlockIndex* pindexPrev = LookupBlockIndex(block.hashPrevBlock);
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && pindexPrev == NULL) {
+        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+            block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+
+    bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block : false;
+    if (usePhi2) {
+        hash = block.GetHash(usePhi2);
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        CValidationState state;
+        if (ProcessNewBlock(state, chainparams, NULL, &block, dbp))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Recursively process earlier encountered successors of this block
+    deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            pindexPrev = LookupBlockIndex(block.hashPrevBlock);
+            usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block : false;
+            hash = block.GetHash(usePhi2);
+            int nHeight = mapBlockIndex[hash]->nHeight;
+            if (ReadBlockFromDisk(block, it->second, nHeight, chainparams.GetConsensus())) {
+                LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash(usePhi2).ToString(),
+                    head.ToString());
+                CValidationState dummy;
+                if (ProcessNewBlock(dummy, chainparams, NULL, &block, &it->second)) {
+                    nLoaded++;
+                    queue.push_back(block.GetHash(usePhi2));
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+        }
+    }
+    return true;
+}
+
+//! Connect every decoded block that is ready, in input order. With fWait the
+//! call blocks until all claimed sequence numbers have been delivered.
+static bool ReindexDrainDecoded(const CChainParams& chainparams, CReindexPipeline& pipe, bool fWait,
+                                std::multimap<uint256, CDiskBlockPos>& mapBlocksUnknownParent, int& nLoaded)
+{
+    while (true) {
+        CReindexBlock* entry = NULL;
+        {
+            boost::unique_lock<boost::mutex> lock(pipe.cs);
+            std::map<uint64_t, CReindexBlock*>::iterator it = pipe.mapDecoded.find(pipe.nNextConnect);
+            while (it == pipe.mapDecoded.end() && fWait && pipe.nNextConnect < pipe.nNextSeq) {
+                pipe.condDone.wait(lock);
+                it = pipe.mapDecoded.find(pipe.nNextConnect);
+            }
+            if (it == pipe.mapDecoded.end())
+                return true;
+            entry = it->second;
+            pipe.mapDecoded.erase(it);
+            pipe.nNextConnect++;
+        }
+        bool fOk = true;
+        if (entry->fGood)
+            fOk = ReindexProcessBlock(chainparams, entry->block, entry->hash, entry->fHavePos ? &entry->pos : NULL, mapBlocksUnknownParent, nLoaded);
+        delete entry;
+        if (!fOk)
+            return false;
+    }
+}
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos* dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
+    int nThreads = GetArg("-reindexthreads", 0);
+    if (nThreads <= 0)
+        nThreads = GetNumCores();
+    // the scanner/connector stage runs on this thread; the rest decode
+    int nWorkers = std::min(nThreads, 16) - 1;
+
     int nLoaded = 0;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE + 8, SER_DISK, CLIENT_VERSION);
+        CReindexPipeline pipe;
+        boost::thread_group workers;
+        for (int i = 0; i < nWorkers; i++)
+            workers.create_thread(boost::bind(&ReindexWorker, &pipe));
+
+        bool fStop = false;
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        try {
+        while (!fStop && !blkdat.eof()) {
             boost::this_thread::interruption_point();
 
             blkdat.SetPos(nRewind);
@@ -5105,67 +6835,75 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                     dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                CBlockIndex* pindexPrev = LookupBlockIndex(block.hashPrevBlock);
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && pindexPrev == NULL) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                        block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                if (nWorkers < 1) {
+                    // single-threaded: decode and connect in place
+                    CBlock block;
+                    uint8_t chFirst;
+                    blkdat >> chFirst;
+                    if (chFirst == COMPRESSED_BLOCK_MARKER) {
+                        CBlockCompressor compressor(block);
+                        blkdat >> compressor;
+                    } else {
+                        blkdat.SetPos(nBlockPos);
+                        blkdat >> block;
+                    }
+                    nRewind = blkdat.GetPos();
+                    if (!ReindexProcessBlock(chainparams, block, block.GetHash(), dbp, mapBlocksUnknownParent, nLoaded))
+                        break;
                     continue;
                 }
 
-                bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= Params().SwitchPhi2Block() : false;
-                if (usePhi2) {
-                    hash = block.GetHash(usePhi2);
-                }
+                CReindexBlock* entry = new CReindexBlock;
+                entry->vch.resize(nSize);
+                blkdat.read((char*)&entry->vch[0], nSize);
+                nRewind = blkdat.GetPos();
+                entry->fHavePos = (dbp != NULL);
+                if (dbp)
+                    entry->pos = *dbp;
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    CValidationState state;
-                    if (ProcessNewBlock(state, chainparams, NULL, &block, dbp))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+                {
+                    boost::unique_lock<boost::mutex> lock(pipe.cs);
+                    while (pipe.queueRaw.size() >= REINDEX_QUEUE_DEPTH || pipe.nQueuedBytes >= REINDEX_QUEUE_BYTES)
+                        pipe.condDone.wait(lock);
+                    pipe.nQueuedBytes += entry->vch.size();
+                    pipe.queueRaw.push_back(std::make_pair(pipe.nNextSeq++, entry));
+                    pipe.condWork.notify_one();
                 }
 
-                // Recursively process earlier encountered successors of this block
-                deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        pindexPrev = LookupBlockIndex(block.hashPrevBlock);
-                        usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= Params().SwitchPhi2Block() : false;
-                        hash = block.GetHash(usePhi2);
-                        int nHeight = mapBlockIndex[hash]->nHeight;
-                        if (ReadBlockFromDisk(block, it->second, nHeight, chainparams.GetConsensus())) {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash(usePhi2).ToString(),
-                                head.ToString());
-                            CValidationState dummy;
-                            if (ProcessNewBlock(dummy, chainparams, NULL, &block, &it->second)) {
-                                nLoaded++;
-                                queue.push_back(block.GetHash(usePhi2));
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                    }
-                }
+                // Connect whatever the workers have finished so far.
+                if (!ReindexDrainDecoded(chainparams, pipe, false, mapBlocksUnknownParent, nLoaded))
+                    fStop = true;
             } catch (std::exception& e) {
                 LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
             }
         }
+        } catch (...) {
+            // don't leave workers pointing at a destroyed pipeline (e.g. on
+            // a shutdown interruption) -- wind them down first
+            {
+                boost::unique_lock<boost::mutex> lock(pipe.cs);
+                pipe.fNoMoreInput = true;
+                pipe.condWork.notify_all();
+            }
+            workers.join_all();
+            throw;
+        }
+
+        if (nWorkers >= 1) {
+            {
+                boost::unique_lock<boost::mutex> lock(pipe.cs);
+                pipe.fNoMoreInput = true;
+                pipe.condWork.notify_all();
+            }
+            workers.join_all();
+            if (!fStop)
+                ReindexDrainDecoded(chainparams, pipe, true, mapBlocksUnknownParent, nLoaded);
+            // drop anything left undelivered after an error
+            for (auto& item : pipe.mapDecoded)
+                delete item.second;
+            pipe.mapDecoded.clear();
+        }
     } catch (std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
@@ -5421,9 +7159,19 @@ bool static AlreadyHave(const CInv& inv)
     case MSG_TX:
     case MSG_WITNESS_TX:
         {
-        bool txInMap = false;
-        txInMap = mempool.exists(inv.hash);
-        return txInMap || mapOrphanTransactions.count(inv.hash) ||
+        if (!recentRejects)
+            recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+        if (chainActive.Tip() && chainActive.Tip()->GetBlockHash() != hashRecentRejectsChainTip) {
+            // If the chain tip has changed previously rejected transactions
+            // might now be valid, e.g. due to a nLockTime'd tx becoming
+            // valid, or a double-spend. Reset the filter and give those
+            // txs a second chance.
+            hashRecentRejectsChainTip = chainActive.Tip()->GetBlockHash();
+            recentRejects->reset();
+        }
+        return mempool.exists(inv.hash) ||
+               recentRejects->contains(inv.hash) ||
+               mapOrphanTransactions.count(inv.hash) ||
                pcoinsTip->HaveCoins(inv.hash);
         }
     case MSG_BLOCK:
@@ -5444,6 +7192,57 @@ bool static AlreadyHave(const CInv& inv)
 }
 
 
+static bool DiskBlockPosCmp(const CDiskBlockPos& a, const CDiskBlockPos& b)
+{
+    return a.nFile != b.nFile ? a.nFile < b.nFile : a.nPos < b.nPos;
+}
+
+/**
+ * Hint the kernel about every block the peer's pending getdata is about to
+ * read. Requests arrive in peer-chosen (effectively random) disk order;
+ * sorting the positions by (file, offset) and issuing WILLNEED readahead
+ * turns the seek-per-block pattern a syncing peer produces into
+ * near-sequential access, while the replies still go out in request order.
+ * Caller holds cs_main.
+ */
+static void PrefetchGetDataBlocks(CNode* pfrom)
+{
+#ifdef POSIX_FADV_WILLNEED
+    static const size_t MAX_PREFETCH_BLOCKS = 128;
+    std::vector<CDiskBlockPos> vPositions;
+    size_t nScanned = 0;
+    for (std::deque<CInv>::const_iterator it = pfrom->vRecvGetData.begin();
+         it != pfrom->vRecvGetData.end() && nScanned < MAX_PREFETCH_BLOCKS; ++it, ++nScanned) {
+        const CInv& inv = *it;
+        if (inv.type != MSG_BLOCK && inv.type != MSG_FILTERED_BLOCK && inv.type != MSG_WITNESS_BLOCK && inv.type != MSG_CMPCT_BLOCK)
+            continue;
+        CBlockIndex* pindex = LookupBlockIndex(inv.hash);
+        if (pindex && (pindex->nStatus & BLOCK_HAVE_DATA))
+            vPositions.push_back(pindex->GetBlockPos());
+    }
+    if (vPositions.size() < 2)
+        return;
+    std::sort(vPositions.begin(), vPositions.end(), DiskBlockPosCmp);
+
+    int nLastFile = -1;
+    FILE* file = NULL;
+    BOOST_FOREACH (const CDiskBlockPos& pos, vPositions) {
+        if (pos.nFile != nLastFile) {
+            if (file)
+                fclose(file);
+            file = OpenBlockFile(pos, true);
+            nLastFile = pos.nFile;
+        }
+        // The index does not record block sizes, so hint a maximal window;
+        // overlapping hints within one file are cheap and coalesce.
+        if (file)
+            posix_fadvise(fileno(file), pos.nPos, MAX_BLOCK_SERIALIZED_SIZE, POSIX_FADV_WILLNEED);
+    }
+    if (file)
+        fclose(file);
+#endif
+}
+
 void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
@@ -5452,6 +7251,8 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
     LOCK(cs_main);
 
+    PrefetchGetDataBlocks(pfrom);
+
     while (it != pfrom->vRecvGetData.end()) {
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->nSendSize >= SendBufferSize())
@@ -5462,7 +7263,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_WITNESS_BLOCK) {
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_WITNESS_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
                 bool send = false;
                 CBlockIndex* pindex = LookupBlockIndex(inv.hash);
                 if (pindex) {
@@ -5473,26 +7274,62 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                         // chain if they are valid, and no more than a max reorg depth than the best header
                         // chain we know about.
                         send = pindex->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
-                               (chainActive.Height() - pindex->nHeight < Params().MaxReorganizationDepth());
+                               (chainActive.Height() - pindex->nHeight < frozenParams.nMaxReorganizationDepth);
                         if (!send) {
                             LogPrintf("ProcessGetData(): ignoring request from peer=%i for old block that isn't in the main chain\n", pfrom->GetId());
                         }
                     }
                 }
+                // Disconnect peers that request week-old blocks once the
+                // upload budget for historical serving is spent; tip relay
+                // and whitelisted peers (the quorum links) are unaffected.
+                static const int nOneWeek = 7 * 24 * 60 * 60;
+                if (send && CNode::OutboundTargetReached(true) && (((pindexBestHeader != NULL) && (pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() > nOneWeek)) || inv.type == MSG_FILTERED_BLOCK) && !pfrom->fWhitelisted) {
+                    LogPrint("net", "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
+                    pfrom->fDisconnect = true;
+                    send = false;
+                }
+                // A pruned node only advertises NODE_NETWORK_LIMITED; refuse
+                // requests beyond its retention depth outright so a syncing
+                // peer reselects a full node instead of stalling on us.
+                if (send && fPruneMode && !pfrom->fWhitelisted &&
+                    chainActive.Height() - pindex->nHeight > MIN_BLOCKS_TO_KEEP) {
+                    LogPrint("net", "block beyond pruned depth requested, disconnect peer=%d\n", pfrom->GetId());
+                    pfrom->fDisconnect = true;
+                    send = false;
+                }
                 if (send && pindex && (pindex->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, pindex, consensusParams))
+                    // Send block from disk, through the shared fetch cache so
+                    // peers requesting the same block coalesce into one read
+                    std::shared_ptr<const CBlock> pblockRead = FetchBlockShared(pindex, consensusParams);
+                    if (!pblockRead)
                         assert(!"cannot load block from disk");
+                    const CBlock& block = *pblockRead;
                     if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage("block", block); //TODO: push message with flag NO_WITNESS
                     else if (inv.type == MSG_WITNESS_BLOCK)
                         pfrom->PushMessage("block", block);
+                    else if (inv.type == MSG_CMPCT_BLOCK) {
+                        // Only serve the short-ID form near the tip, where the
+                        // peer has a chance of reconstructing from its mempool;
+                        // deeper blocks go out in full.
+                        if (chainActive.Contains(pindex) && pindex->nHeight >= chainActive.Height() - 10) {
+                            CBlockHeaderAndShortTxIDs cmpctblock(block);
+                            pfrom->PushMessage("cmpctblock", cmpctblock);
+                        } else
+                            pfrom->PushMessage("block", block);
+                    }
                     else // MSG_FILTERED_BLOCK)
                     {
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
-                            CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+                            // Build (or reuse) the block's full merkle tree once;
+                            // each peer only pays for the masked traversal.
+                            LOCK(cs_merkleTreeCache);
+                            if (hashMerkleTreeCache != inv.hash) {
+                                CacheBlockMerkleTree(block, inv.hash);
+                            }
+                            CMerkleBlock merkleBlock(block, *pfrom->pfilter, vMerkleTreeCache);
                             pfrom->PushMessage("merkleblock", merkleBlock);
                             // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
                             // This avoids hurting performance by pointlessly requiring a round-trip
@@ -5525,22 +7362,27 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 bool pushed = false;
                 {
                     LOCK(cs_mapRelay);
-                    map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
+                    map<CInv, CTransactionRef>::iterator mi = mapRelay.find(inv);
                     if (mi != mapRelay.end()) {
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second); //TODO: push message with flags
+                        // Build the framed wire message on the first getdata;
+                        // every further peer requesting this inv gets the same
+                        // buffer instead of re-serializing and re-checksumming.
+                        map<CInv, CSerializeData>::iterator miMsg = mapRelayMsg.find(inv);
+                        if (miMsg == mapRelayMsg.end()) {
+                            CDataStream ssPayload(SER_NETWORK, PROTOCOL_VERSION);
+                            ssPayload << *(*mi).second;
+                            miMsg = mapRelayMsg.insert(std::make_pair(inv, CSerializeData())).first;
+                            BuildNetMessage(miMsg->second, inv.GetCommand(), ssPayload);
+                        }
+                        pfrom->PushSharedMessage(miMsg->second);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_TX) { //TODO: probably should check for MSG_TX_WITNESS too
-                    CTransaction tx;
                     CTransactionRef ptx = mempool.get(inv.hash);
                     if (ptx) {
-                        tx = *ptx.get();
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000); //TODO: if we check for MSG_TX_WITNESS, should this value be changed?
-                        ss << tx;
-                        pfrom->PushMessage("tx", ss);
+                        pfrom->PushMessage("tx", *ptx);
                         pushed = true;
                     }
                 }
@@ -5588,7 +7430,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             }
 
             // Track requests for our stuff.
-            GetMainSignals().Inventory(inv.hash);
+            NotifyInventory(inv.hash);
 
             if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_WITNESS_BLOCK)
                 break;
@@ -5641,8 +7483,27 @@ int GetMajorVersionFromVersion(const string& cleanVersion) {
     }
 }
 
+/** Mempool reconciliation between trusted peers (-mempoolsync): every
+ * MEMPOOL_SYNC_INTERVAL seconds a node sends a whitelisted peer the 8-byte
+ * short ids (low 64 bits of the txid) of its whole mempool in one "mempsync"
+ * message; the peer requests the ids it lacks with "mempget" and receives the
+ * full transactions back. Rounds run in both directions, so two RPC-tier
+ * nodes converge on the union of their mempools without continuous re-relay.
+ * The short id is only a lookup key between peers that already trust each
+ * other, so the plain txid prefix suffices; a collision just means one
+ * transaction is skipped until the next round.
+ */
+static const int64_t MEMPOOL_SYNC_INTERVAL = 60;
+static const size_t MAX_MEMPOOL_SYNC_IDS = 50000;
+
+static inline uint64_t MempoolShortId(const uint256& txid)
+{
+    return txid.GetLow64();
+}
+
 static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams)
 {
+    CPerfScope perfscope("ProcessMessage");
     RandAddSeedPerfmon();
     if (fDebug) {
         LogPrintf("received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -5764,6 +7625,12 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
             addrman.Good(pfrom->addr);
         }
 
+        // Queue the first ping now instead of waiting for the ping interval:
+        // SendMessages runs right after this handler, so verack, getaddr and
+        // ping all leave in the same initial socket write and we get an RTT
+        // sample for the peer as soon as the handshake completes.
+        pfrom->fPingQueued = true;
+
         // Relay alerts
         {
             LOCK(cs_mapAlerts);
@@ -5801,6 +7668,28 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+
+        if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
+            // Tell our peer we are willing to provide version-1 compact blocks.
+            bool fAnnounceUsingCMPCTBLOCK = false;
+            uint64_t nCMPCTBLOCKVersion = 1;
+            pfrom->PushMessage("sendcmpct", fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion);
+        }
+    }
+
+
+    else if (strCommand == "sendcmpct") {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == 1) {
+            LOCK(cs_main);
+            CNodeState* state = State(pfrom->GetId());
+            if (state) {
+                state->fProvidesCompactBlocks = true;
+                state->fWantsCompactBlocks = fAnnounceUsingCMPCTBLOCK;
+            }
+        }
     }
 
 
@@ -5894,6 +7783,7 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
 
             bool fAlreadyHave = AlreadyHave(inv);
             LogPrint("net", "got inv: %s  %s peer=%d\n", inv.ToString(), fAlreadyHave ? "have" : "new", pfrom->id);
+            RecordPeerInv(pfrom->addr, !fAlreadyHave);
 
             if (!fAlreadyHave && !fImporting && !fReindex && inv.type != MSG_BLOCK)
                 pfrom->AskFor(inv);
@@ -5902,14 +7792,33 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
-                    // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
+                    // Add this to the list of blocks to request. When the peer
+                    // can serve compact blocks and we are caught up (so the
+                    // mempool is useful for reconstruction), fetch the short-ID
+                    // form instead of the full block.
+                    CNodeState* state = State(pfrom->GetId());
+                    if (state != NULL && state->fProvidesCompactBlocks && !IsInitialBlockDownload()) {
+                        vToFetch.push_back(CInv(MSG_CMPCT_BLOCK, inv.hash));
+                    } else if (state != NULL && state->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                        // This peer's request pipe is full. Put the block on
+                        // the generic AskFor rotation instead, which spaces
+                        // repeat requests and lets another announcing peer
+                        // pick it up, rather than piling the whole inventory
+                        // batch onto one peer.
+                        pfrom->AskFor(inv);
+                    } else {
+                        // Track the request so the in-flight dedupe above,
+                        // the per-peer cap and the stall/timeout machinery
+                        // in SendMessages cover inv-driven fetches too.
+                        MarkBlockAsInFlight(pfrom->GetId(), inv.hash, chainparams.GetConsensus());
+                        vToFetch.push_back(inv);
+                    }
                     LogPrint("net", "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
                 }
             }
 
             // Track requests for our stuff
-            GetMainSignals().Inventory(inv.hash);
+            NotifyInventory(inv.hash);
 
             if (pfrom->nSendSize > (SendBufferSize() * 2)) {
                 Misbehaving(pfrom->GetId(), 50);
@@ -6025,6 +7934,9 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
 
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
+        // Queueing delay between the message being fully received and us
+        // getting to it.
+        TraceTxSpan("net.recv", inv.hash, GetTimeMicros() - nTimeReceived);
 
         LOCK(cs_main);
 
@@ -6037,9 +7949,24 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
         DEBUG_DUMP_Message_TX();
 #       endif
 
-        if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees)) {
+        bool fAlreadyHave = AlreadyHave(inv); // also refreshes recentRejects
+        // A rejected transaction resubmitted with a malleated witness hashes
+        // to the same txid but a different wtxid; the wtxid check catches the
+        // exact copy we already validated without blocking a
+        // differently-witnessed valid version.
+        if (!fAlreadyHave && recentRejects->contains(tx.GetWitnessHash())) {
+            LogPrint("mempool", "ignoring recently rejected tx %s from peer=%d\n", tx.GetHash().ToString(), pfrom->id);
+            fAlreadyHave = true;
+        }
+
+        if (!fAlreadyHave && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees)) {
             mempool.check(pcoinsTip);
-            RelayTransaction(tx);
+            // Relay the mempool's copy so the relay map shares its storage.
+            CTransactionRef ptx = mempool.get(inv.hash);
+            if (ptx)
+                RelayTransaction(ptx);
+            else
+                RelayTransaction(tx);
             vWorkQueue.push_back(inv.hash);
             vEraseQueue.push_back(inv.hash);
 
@@ -6051,7 +7978,7 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
             // Recursively process any orphan transactions that depended on this one
             set<NodeId> setMisbehaving;
             for (unsigned int i = 0; i < vWorkQueue.size(); i++) {
-                map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
+                auto itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
                 if (itByPrev == mapOrphanTransactionsByPrev.end())
                     continue;
                 for (set<uint256>::iterator mi = itByPrev->second.begin();
@@ -6072,7 +7999,11 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
                         continue;
                     if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2)) {
                         LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx);
+                        CTransactionRef porphan = mempool.get(orphanHash);
+                        if (porphan)
+                            RelayTransaction(porphan);
+                        else
+                            RelayTransaction(orphanTx);
                         vWorkQueue.push_back(orphanHash);
                         vEraseQueue.push_back(orphanHash);
                     } else if (!fMissingInputs2) {
@@ -6087,6 +8018,9 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
                         // Probably non-standard or insufficient fee/priority
                         LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
                         vEraseQueue.push_back(orphanHash);
+                        recentRejects->insert(orphanTx.GetWitnessHash());
+                        if (!stateDummy.CorruptionPossible())
+                            recentRejects->insert(orphanHash);
 
                     }
                     mempool.check(pcoinsTip);
@@ -6104,6 +8038,11 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
             if (nEvicted > 0)
                 LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
         } else {
+            if (!fAlreadyHave) {
+                recentRejects->insert(tx.GetWitnessHash());
+                if (!state.CorruptionPossible())
+                    recentRejects->insert(tx.GetHash());
+            }
 
             if (pfrom->fWhitelisted && GetBoolArg("-whitelistalwaysrelay", DEFAULT_WHITELISTALWAYSRELAY)) {
             int nDoS = 0;
@@ -6144,6 +8083,26 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // The PHI hash of each header is by far the most expensive part of
+        // AcceptBlockHeader and the hashes are all independent, so compute
+        // them for the whole batch via the bulk backend before taking
+        // cs_main, which is then only held to link the headers into
+        // mapBlockIndex. The phi2 switchover is keyed on height, which can
+        // be walked from the first header's parent because the continuity of
+        // the sequence is enforced below before each precomputed hash is used.
+        std::vector<uint256> vHeaderHashes;
+        if (nCount > 1) {
+            int nFirstHeight = -1;
+            {
+                LOCK(cs_main);
+                const CBlockIndex* pindexFirstPrev = LookupBlockIndex(headers[0].hashPrevBlock);
+                if (pindexFirstPrev)
+                    nFirstHeight = pindexFirstPrev->nHeight + 1;
+            }
+            if (nFirstHeight >= 0)
+                HashBlockHeaderBatch(headers, nFirstHeight, vHeaderHashes);
+        }
+
         LOCK(cs_main);
 
         if (nCount == 0) {
@@ -6151,7 +8110,8 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
             return true;
         }
         CBlockIndex* pindexLast = NULL;
-        BOOST_FOREACH (const CBlockHeader& header, headers) {
+        for (unsigned int n = 0; n < nCount; n++) {
+            const CBlockHeader& header = headers[n];
             CValidationState state;
             if (pindexLast != NULL && header.hashPrevBlock != pindexLast->GetBlockHash()) {
                 Misbehaving(pfrom->GetId(), 20);
@@ -6161,7 +8121,7 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
             /*TODO: this has a CBlock cast on it so that it will compile. There should be a solution for this
              * before headers are reimplemented on mainnet
              */
-            if (!AcceptBlockHeader((CBlock)header, state, chainparams, &pindexLast)) {
+            if (!AcceptBlockHeader((CBlock)header, state, chainparams, &pindexLast, vHeaderHashes.empty() ? NULL : &vHeaderHashes[n])) {
                 int nDoS;
                 if (state.IsInvalid(nDoS)) {
                     if (nDoS > 0)
@@ -6187,12 +8147,199 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
     }
 
 
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) { // Ignore blocks received while importing
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        CBlockIndex* pindexPrev = LookupBlockIndex(cmpctblock.header.hashPrevBlock);
+        if (!pindexPrev) {
+            // We cannot place (or even hash, because of the PHI2 switch) this
+            // header; let the normal getblocks/headers sync catch us up first.
+            LogPrint("cmpctblock", "cmpctblock with unknown parent %s from peer=%d, ignoring\n", cmpctblock.header.hashPrevBlock.ToString(), pfrom->id);
+            return true;
+        }
+        bool usePhi2 = pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block;
+        uint256 hashBlock = cmpctblock.header.GetHash(usePhi2);
+
+        bool fAllAvailable = false;
+        std::vector<CTransaction> vAvailableTxn;
+        {
+            LOCK(cs_main);
+            if (mapBlockIndex.count(hashBlock) && (mapBlockIndex[hashBlock]->nStatus & BLOCK_HAVE_DATA))
+                return true; // already have it
+
+            CNodeState* nodestate = State(pfrom->GetId());
+            if (!nodestate)
+                return true;
+
+            nodestate->partialBlock.reset(new PartiallyDownloadedBlock(&mempool));
+            ReadStatus status = nodestate->partialBlock->InitData(cmpctblock);
+            if (status == READ_STATUS_INVALID) {
+                nodestate->partialBlock.reset();
+                Misbehaving(pfrom->GetId(), 100);
+                return error("invalid cmpctblock %s from peer=%d", hashBlock.ToString(), pfrom->id);
+            }
+            if (status == READ_STATUS_FAILED) {
+                // Short ID collision or similar; just get the full block.
+                nodestate->partialBlock.reset();
+                vector<CInv> vInv(1, CInv(MSG_BLOCK, hashBlock));
+                pfrom->PushMessage("getdata", vInv);
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                if (!nodestate->partialBlock->IsTxAvailable(i))
+                    req.indexes.push_back(i);
+            }
+            if (req.indexes.empty()) {
+                fAllAvailable = true;
+            } else {
+                nodestate->hashPartialBlock = hashBlock;
+                req.blockhash = hashBlock;
+                pfrom->PushMessage("getblocktxn", req);
+                nodestate->partialBlock->GetAvailableTxns(vAvailableTxn);
+            }
+        }
+
+        if (!fAllAvailable && !vAvailableTxn.empty()) {
+            // Speculative warm-up during the getblocktxn round trip: the
+            // mempool-reconstructed part of the block is already known, and
+            // its script checks are typically cached from mempool acceptance,
+            // so prefetching its input coins now leaves mostly the missing
+            // transactions to validate once blocktxn arrives.
+            PrefetchInputCoins(vAvailableTxn);
+        }
+
+        if (fAllAvailable) {
+            // Everything was in our mempool; reconstruct and process right away.
+            CBlock block;
+            ReadStatus status;
+            {
+                LOCK(cs_main);
+                CNodeState* nodestate = State(pfrom->GetId());
+                status = nodestate->partialBlock->FillBlock(block, std::vector<CTransaction>());
+                nodestate->partialBlock.reset();
+                nodestate->hashPartialBlock = uint256(0);
+            }
+            if (status != READ_STATUS_OK) {
+                vector<CInv> vInv(1, CInv(MSG_BLOCK, hashBlock));
+                pfrom->PushMessage("getdata", vInv);
+                return true;
+            }
+
+            CValidationState state;
+            ProcessNewBlock(state, chainparams, pfrom, &block);
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                if (state.GetRejectReason() == "bad-txnmrklroot") {
+                    // Reconstruction picked a wrong mempool transaction for a
+                    // short ID; this is not the peer's fault. Refetch in full.
+                    vector<CInv> vInv(1, CInv(MSG_BLOCK, hashBlock));
+                    pfrom->PushMessage("getdata", vInv);
+                    return true;
+                }
+                pfrom->PushMessage("reject", (string) "block", state.GetRejectCode(),
+                    state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), hashBlock);
+                if (nDoS > 0) {
+                    TRY_LOCK(cs_main, lockMain);
+                    if (lockMain) Misbehaving(pfrom->GetId(), nDoS);
+                }
+            }
+        }
+    }
+
+
+    else if (strCommand == "getblocktxn") {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+
+        CBlockIndex* pindex = LookupBlockIndex(req.blockhash);
+        if (!pindex || !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "peer=%d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+        if (!chainActive.Contains(pindex) || pindex->nHeight < chainActive.Height() - 10) {
+            // A peer needing such an old block should be requesting it in full.
+            LogPrint("net", "peer=%d sent us a getblocktxn for a block > 10 deep\n", pfrom->id);
+            return true;
+        }
+
+        std::shared_ptr<const CBlock> pblockRead = FetchBlockShared(pindex, chainparams.GetConsensus());
+        if (!pblockRead)
+            assert(!"cannot load block from disk");
+        const CBlock& block = *pblockRead;
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("peer=%d sent us a getblocktxn with out-of-bounds tx indices", pfrom->id);
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) { // Ignore blocks received while importing
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        bool fBlockRead = false;
+        {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            if (!nodestate || !nodestate->partialBlock || nodestate->hashPartialBlock != resp.blockhash) {
+                LogPrint("net", "peer=%d sent us blocktxn for an unexpected block\n", pfrom->id);
+                return true;
+            }
+
+            ReadStatus status = nodestate->partialBlock->FillBlock(block, resp.txn);
+            nodestate->partialBlock.reset();
+            nodestate->hashPartialBlock = uint256(0);
+            if (status == READ_STATUS_INVALID) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("invalid blocktxn %s from peer=%d", resp.blockhash.ToString(), pfrom->id);
+            }
+            if (status == READ_STATUS_FAILED) {
+                vector<CInv> vInv(1, CInv(MSG_BLOCK, resp.blockhash));
+                pfrom->PushMessage("getdata", vInv);
+                return true;
+            }
+            fBlockRead = true;
+        }
+
+        if (fBlockRead) {
+            CValidationState state;
+            ProcessNewBlock(state, chainparams, pfrom, &block);
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                if (state.GetRejectReason() == "bad-txnmrklroot") {
+                    vector<CInv> vInv(1, CInv(MSG_BLOCK, resp.blockhash));
+                    pfrom->PushMessage("getdata", vInv);
+                    return true;
+                }
+                pfrom->PushMessage("reject", (string) "block", state.GetRejectCode(),
+                    state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), resp.blockhash);
+                if (nDoS > 0) {
+                    TRY_LOCK(cs_main, lockMain);
+                    if (lockMain) Misbehaving(pfrom->GetId(), nDoS);
+                }
+            }
+        }
+    }
+
+
     else if (strCommand == "block" && !fImporting && !fReindex) { // Ignore blocks received while importing
         CBlock block;
         vRecv >> block;
 
         CBlockIndex* pindexPrev = LookupBlockIndex(block.hashPrevBlock);
-        bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= Params().SwitchPhi2Block() : false;
+        bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block : false;
 
         uint256 hashBlock = block.GetHash(usePhi2);
         CInv inv(MSG_BLOCK, hashBlock);
@@ -6234,10 +8381,29 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
     // Making users (which are behind NAT and can only make outgoing connections) ignore
     // getaddr message mitigates the attack.
     else if ((strCommand == "getaddr") && (pfrom->fInbound)) {
-        pfrom->vAddrToSend.clear();
-        vector<CAddress> vAddr = addrman.GetAddr();
-        BOOST_FOREACH (const CAddress& addr, vAddr)
-            pfrom->PushAddress(addr);
+        // Only answer one getaddr per connection; crawlers re-requesting the
+        // table account for most of the addr traffic on well-known nodes.
+        if (pfrom->fSentAddr) {
+            LogPrint("net", "ignoring repeated getaddr peer=%d\n", pfrom->id);
+        } else {
+            pfrom->fSentAddr = true;
+
+            // Serve every requester the same snapshot for a while instead of
+            // drawing a fresh random sample from addrman per request.
+            static CCriticalSection cs_getAddrCache;
+            static std::vector<CAddress> vGetAddrCache;
+            static int64_t nGetAddrCacheTime = 0;
+            static const int64_t GETADDR_CACHE_INTERVAL = 6 * 60 * 60;
+
+            pfrom->vAddrToSend.clear();
+            LOCK(cs_getAddrCache);
+            if (GetTime() - nGetAddrCacheTime > GETADDR_CACHE_INTERVAL || vGetAddrCache.empty()) {
+                vGetAddrCache = addrman.GetAddr();
+                nGetAddrCacheTime = GetTime();
+            }
+            BOOST_FOREACH (const CAddress& addr, vGetAddrCache)
+                pfrom->PushAddress(addr);
+        }
     }
 
 
@@ -6266,6 +8432,68 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
     }
 
 
+    else if (strCommand == "mempsync") {
+        // Mempool reconciliation round from a trusted peer (-mempoolsync):
+        // the message carries the short ids of its whole mempool, we answer
+        // with the ids we lack. Only honored between whitelisted peers; for
+        // anyone else the message is ignored like any unknown command.
+        static bool fMempoolSync = GetBoolArg("-mempoolsync", false);
+        std::vector<uint64_t> vTheirIds;
+        vRecv >> vTheirIds;
+        if (fMempoolSync && pfrom->fWhitelisted && vTheirIds.size() <= MAX_MEMPOOL_SYNC_IDS) {
+            std::vector<uint256> vtxid;
+            mempool.queryHashes(vtxid);
+            std::set<uint64_t> setOurIds;
+            BOOST_FOREACH (const uint256& hash, vtxid)
+                setOurIds.insert(MempoolShortId(hash));
+            std::vector<uint64_t> vWant;
+            BOOST_FOREACH (uint64_t nId, vTheirIds) {
+                if (!setOurIds.count(nId))
+                    vWant.push_back(nId);
+            }
+            LogPrint("mempool", "mempsync: peer=%d has %u txes, we lack %u\n",
+                     pfrom->id, (unsigned int)vTheirIds.size(), (unsigned int)vWant.size());
+            if (!vWant.empty())
+                pfrom->PushMessage("mempget", vWant);
+        }
+    }
+
+
+    else if (strCommand == "mempget") {
+        // Answer a reconciliation round: push the full transactions for the
+        // short ids the trusted peer asked for. A short id that no longer
+        // resolves (evicted or collided) is simply skipped; the next round
+        // covers it.
+        static bool fMempoolSync = GetBoolArg("-mempoolsync", false);
+        std::vector<uint64_t> vWant;
+        vRecv >> vWant;
+        if (fMempoolSync && pfrom->fWhitelisted && vWant.size() <= MAX_MEMPOOL_SYNC_IDS) {
+            std::vector<uint256> vtxid;
+            mempool.queryHashes(vtxid);
+            std::map<uint64_t, uint256> mapShortIds;
+            BOOST_FOREACH (const uint256& hash, vtxid)
+                mapShortIds[MempoolShortId(hash)] = hash;
+            int nSent = 0;
+            BOOST_FOREACH (uint64_t nId, vWant) {
+                std::map<uint64_t, uint256>::const_iterator mi = mapShortIds.find(nId);
+                if (mi == mapShortIds.end())
+                    continue;
+                CTransactionRef ptx = mempool.get(mi->second);
+                if (!ptx)
+                    continue;
+                {
+                    LOCK(pfrom->cs_inventory);
+                    pfrom->setInventoryKnown.insert(CInv(MSG_TX, mi->second));
+                }
+                pfrom->PushMessage("tx", *ptx);
+                nSent++;
+            }
+            LogPrint("mempool", "mempget: sent %d of %u requested txes to peer=%d\n",
+                     nSent, (unsigned int)vWant.size(), pfrom->id);
+        }
+    }
+
+
     else if (strCommand == "ping") {
         if (pfrom->nVersion > BIP0031_VERSION) {
             uint64_t nonce = 0;
@@ -6305,6 +8533,7 @@ static bool ProcessMessage(CNode* pfrom, const string &strCommand, CDataStream&
                     if (pingUsecTime > 0) {
                         // Successful ping time measurement, replace previous
                         pfrom->nPingUsecTime = pingUsecTime;
+                        pfrom->nMinPingUsecTime = std::min(pfrom->nMinPingUsecTime, pingUsecTime);
                     } else {
                         // This should never happen
                         sProblem = "Timing mishap";
@@ -6483,6 +8712,20 @@ int ActiveProtocol()
 }
 
 // requires LOCK(cs_vRecvMsg)
+//! Drain order for a peer's receive queue; lower is processed first. Block
+//! propagation and the handshake preempt transaction relay, which preempts
+//! address gossip, so a freshly mined block is not stuck behind queued spam.
+static int MessagePriority(const std::string& strCommand)
+{
+    if (strCommand == "block" || strCommand == "cmpctblock" || strCommand == "blocktxn" ||
+        strCommand == "headers" || strCommand == "version" || strCommand == "verack" ||
+        strCommand == "ping" || strCommand == "pong")
+        return 0;
+    if (strCommand == "addr" || strCommand == "getaddr")
+        return 2;
+    return 1;
+}
+
 bool ProcessMessages(CNode* pfrom)
 {
     const CChainParams& chainparams = Params();
@@ -6505,30 +8748,43 @@ bool ProcessMessages(CNode* pfrom)
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return fOk;
 
-    std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
-    while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end()) {
+    while (!pfrom->fDisconnect && !pfrom->vRecvMsg.empty()) {
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->nSendSize >= SendBufferSize())
             break;
 
+        // Pick the complete message with the best drain priority instead of
+        // strict FIFO; ties keep their arrival order. Messages fill in
+        // order, so only the last one can be incomplete.
+        std::deque<CNetMessage>::iterator itSel = pfrom->vRecvMsg.end();
+        int nBestPriority = 3;
+        for (std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
+             it != pfrom->vRecvMsg.end() && it->complete(); ++it) {
+            int nPriority = MessagePriority(it->hdr.GetCommand());
+            if (nPriority < nBestPriority) {
+                nBestPriority = nPriority;
+                itSel = it;
+                if (nPriority == 0)
+                    break;
+            }
+        }
+
+        // end, if no complete message was found
+        if (itSel == pfrom->vRecvMsg.end())
+            break;
+
         // get next message
-        CNetMessage& msg = *it;
+        CNetMessage& msg = *itSel;
 
         //if (fDebug)
         //    LogPrintf("ProcessMessages(message %u msgsz, %u bytes, complete:%s)\n",
         //            msg.hdr.nMessageSize, msg.vRecv.size(),
         //            msg.complete() ? "Y" : "N");
 
-        // end, if an incomplete message is found
-        if (!msg.complete())
-            break;
-
-        // at this point, any failure means we can delete the current message
-        it++;
-
         // Scan for message start
         if (memcmp(msg.hdr.pchMessageStart, chainparams.MessageStart(), MESSAGE_START_SIZE) != 0) {
             LogPrintf("PROCESSMESSAGE: INVALID MESSAGESTART %s peer=%d\n", SanitizeString(msg.hdr.GetCommand()), pfrom->id);
+            pfrom->vRecvMsg.erase(itSel);
             fOk = false;
             break;
         }
@@ -6537,6 +8793,7 @@ bool ProcessMessages(CNode* pfrom)
         CMessageHeader& hdr = msg.hdr;
         if (!hdr.IsValid()) {
             LogPrintf("PROCESSMESSAGE: ERRORS IN HEADER %s peer=%d\n", SanitizeString(hdr.GetCommand()), pfrom->id);
+            pfrom->vRecvMsg.erase(itSel);
             continue;
         }
         string strCommand = hdr.GetCommand();
@@ -6552,6 +8809,7 @@ bool ProcessMessages(CNode* pfrom)
         if (nChecksum != hdr.nChecksum) {
             LogPrintf("ProcessMessages(%s, %u bytes): CHECKSUM ERROR nChecksum=%08x hdr.nChecksum=%08x\n",
                 SanitizeString(strCommand), nMessageSize, nChecksum, hdr.nChecksum);
+            pfrom->vRecvMsg.erase(itSel);
             continue;
         }
 
@@ -6582,13 +8840,14 @@ bool ProcessMessages(CNode* pfrom)
         if (!fRet)
             LogPrintf("ProcessMessage(%s, %u bytes) FAILED peer=%d\n", SanitizeString(strCommand), nMessageSize, pfrom->id);
 
+        // In case the connection got shut down inside the handler, the
+        // receive buffer was wiped and the iterator went with it
+        if (!pfrom->fDisconnect)
+            pfrom->vRecvMsg.erase(itSel);
+
         break;
     }
 
-    // In case the connection got shut down, its receive buffer was wiped
-    if (!pfrom->fDisconnect)
-        pfrom->vRecvMsg.erase(pfrom->vRecvMsg.begin(), it);
-
     return fOk;
 }
 
@@ -6714,6 +8973,26 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             GetMainSignals().Broadcast(nTimeBestReceived);
         }
 
+        //
+        // Message: mempool short-id sync round (trusted peers only)
+        //
+        static bool fMempoolSync = GetBoolArg("-mempoolsync", false);
+        if (fMempoolSync && pto->fWhitelisted && pto->fSuccessfullyConnected &&
+            !IsInitialBlockDownload() && GetTime() >= pto->nNextMempoolSync) {
+            pto->nNextMempoolSync = GetTime() + MEMPOOL_SYNC_INTERVAL;
+            std::vector<uint256> vtxid;
+            mempool.queryHashes(vtxid);
+            if (!vtxid.empty() && vtxid.size() <= MAX_MEMPOOL_SYNC_IDS) {
+                std::vector<uint64_t> vIds;
+                vIds.reserve(vtxid.size());
+                BOOST_FOREACH (const uint256& hash, vtxid)
+                    vIds.push_back(MempoolShortId(hash));
+                pto->PushMessage("mempsync", vIds);
+                LogPrint("mempool", "mempsync: sent round with %u ids to peer=%d\n",
+                         (unsigned int)vIds.size(), pto->id);
+            }
+        }
+
         //
         // Message: inventory
         //
@@ -6764,15 +9043,19 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
             // should only happen during initial block download.
             LogPrintf("Peer=%d is stalling block download, disconnecting\n", pto->id);
+            RecordPeerStall(pto->addr);
+            nBlockStallDisconnects++;
             pto->fDisconnect = true;
         }
-        // In case there is a block that has been in flight from this peer for (2 + 0.5 * N) times the block interval
-        // (with N the number of validated blocks that were in flight at the time it was requested), disconnect due to
-        // timeout. We compensate for in-flight blocks to prevent killing off peers due to our own downstream link
-        // being saturated. We only count validated in-flight blocks so peers can't advertize nonexisting block hashes
-        // to unreasonably increase our timeout.
-        if (!pto->fDisconnect && state.vBlocksInFlight.size() > 0 && state.vBlocksInFlight.front().nTime < nNow - 500000 * Params().TargetSpacing() * (4 + state.vBlocksInFlight.front().nValidatedQueuedBefore)) {
+        // In case there is a block that has been in flight from this peer for too long, disconnect due to timeout.
+        // The ceiling is (2 + 0.5 * N) times the block interval (with N the number of validated blocks that were in
+        // flight at the time it was requested), compensating for in-flight blocks so we don't kill off peers when our
+        // own downstream link is saturated; once the peer has delivered blocks, the timeout adapts down to a multiple
+        // of its observed latency instead. We only count validated in-flight blocks so peers can't advertize
+        // nonexisting block hashes to unreasonably increase our timeout.
+        if (!pto->fDisconnect && state.vBlocksInFlight.size() > 0 && state.vBlocksInFlight.front().nTime < nNow - BlockDownloadTimeoutUs(state, state.vBlocksInFlight.front())) {
             LogPrintf("Timeout downloading block %s from peer=%d, disconnecting\n", state.vBlocksInFlight.front().hash.ToString(), pto->id);
+            nBlockTimeoutDisconnects++;
             pto->fDisconnect = true;
         }
 
@@ -6781,6 +9064,32 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         //
         vector<CInv> vGetData;
         if (!pto->fDisconnect && !pto->fClient && fFetch && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            // Fast reassignment of the critical window block: if the lowest-height block in
+            // flight has waited well past its source peer's typical delivery latency, the
+            // whole download window is blocked on it. Re-request it from this peer (if it has
+            // a better delivery record and the block) instead of waiting out the source
+            // peer's full disconnect timeout.
+            NodeId nodeCritical = -1;
+            const QueuedBlock* pcritical = FindCriticalBlockInFlight(nodeCritical);
+            if (pcritical && nodeCritical != pto->GetId() && state.pindexBestKnownBlock &&
+                state.pindexBestKnownBlock->nHeight >= pcritical->pindex->nHeight) {
+                CNodeState* source = State(nodeCritical);
+                int64_t nLateUs = source->nBlockLatencyEwmaUs > 0 ? 4 * source->nBlockLatencyEwmaUs : 1000000 * BLOCK_STALLING_TIMEOUT;
+                nLateUs = std::max(nLateUs, (int64_t)2000000);
+                bool fFaster = state.nBlockLatencyEwmaUs == 0 || source->nBlockLatencyEwmaUs == 0 ||
+                               state.nBlockLatencyEwmaUs < source->nBlockLatencyEwmaUs;
+                if (nNow - pcritical->nTime > nLateUs && fFaster &&
+                    (state.fHaveWitness || !IsWitnessEnabled(pcritical->pindex->pprev, consensusParams))) {
+                    CBlockIndex* pindexCritical = pcritical->pindex;
+                    uint256 hashCritical = pcritical->hash;
+                    LogPrint("net", "Reassigning critical block %s (%d) from peer=%d to peer=%d after %dms\n",
+                             hashCritical.ToString(), pindexCritical->nHeight, nodeCritical, pto->id, (nNow - pcritical->nTime) / 1000);
+                    MarkBlockAsAbandoned(hashCritical);
+                    vGetData.push_back(CInv(MSG_BLOCK | GetFetchFlags(pto, pindexCritical->pprev, consensusParams), hashCritical));
+                    MarkBlockAsInFlight(pto->GetId(), hashCritical, consensusParams, pindexCritical);
+                    nBlocksReassigned++;
+                }
+            }
             vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
             FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
@@ -6831,8 +9140,30 @@ bool CBlockUndo::WriteToDisk(CDiskBlockPos& pos, const uint256& hashBlock)
     if (fileout.IsNull())
         return error("CBlockUndo::WriteToDisk : OpenUndoFile failed");
 
+    // Undo data compresses well (the same scriptPubKeys recur for every
+    // spend of an address, and the script templates repeat across inputs),
+    // so deflate the serialized record and store it behind a 0xff escape
+    // byte: a plain record never starts with 0xff, since that would be a
+    // vtxundo compact size of 2^32 or more.  The checksum stays over the
+    // uncompressed contents, so corruption is caught the same way in both
+    // formats and old records keep verifying.
+    CDataStream ssUndo(SER_DISK, CLIENT_VERSION);
+    ssUndo << *this;
+    uint64_t nRawSize = ssUndo.size();
+    std::vector<unsigned char> vchCompressed;
+    bool fCompressed = false;
+    unsigned int nSize = (unsigned int)nRawSize;
+    if (GetBoolArg("-compressundo", true) &&
+        DeflateData(std::vector<unsigned char>(ssUndo.begin(), ssUndo.end()), vchCompressed)) {
+        unsigned int nCompressedSize = 1 + ::GetSerializeSize(VARINT(nRawSize), SER_DISK, CLIENT_VERSION) +
+                                       ::GetSerializeSize(vchCompressed, SER_DISK, CLIENT_VERSION);
+        if (nCompressedSize < nRawSize) {
+            fCompressed = true;
+            nSize = nCompressedSize;
+        }
+    }
+
     // Write index header
-    unsigned int nSize = fileout.GetSerializeSize(*this);
     fileout << FLATDATA(Params().MessageStart()) << nSize;
 
     // Write undo data
@@ -6840,7 +9171,13 @@ bool CBlockUndo::WriteToDisk(CDiskBlockPos& pos, const uint256& hashBlock)
     if (fileOutPos < 0)
         return error("CBlockUndo::WriteToDisk : ftell failed");
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << *this;
+    if (fCompressed) {
+        fileout << (unsigned char)0xff;
+        fileout << VARINT(nRawSize);
+        fileout << vchCompressed;
+    } else {
+        fileout << *this;
+    }
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
@@ -6861,7 +9198,39 @@ bool CBlockUndo::ReadFromDisk(const CDiskBlockPos& pos, const uint256& hashBlock
     // Read block
     uint256 hashChecksum;
     try {
-        filein >> *this;
+        unsigned char chFirst;
+        filein >> chFirst;
+        if (chFirst == 0xff) {
+            // Compressed record (see WriteToDisk)
+            uint64_t nRawSize = 0;
+            filein >> VARINT(nRawSize);
+            std::vector<unsigned char> vchCompressed;
+            filein >> vchCompressed;
+            std::vector<unsigned char> vchRaw;
+            if (nRawSize > MAX_SIZE || !InflateData(vchCompressed, vchRaw, nRawSize) || vchRaw.size() != nRawSize)
+                return error("CBlockUndo::ReadFromDisk : undo decompression failed");
+            CDataStream ssUndo(vchRaw, SER_DISK, CLIENT_VERSION);
+            ssUndo >> *this;
+        } else {
+            // Plain record; chFirst is the first byte of the vtxundo compact
+            // size, so finish reading it by hand
+            uint64_t nCount = chFirst;
+            if (chFirst == 253) {
+                uint16_t n;
+                filein >> n;
+                nCount = n;
+            } else if (chFirst == 254) {
+                uint32_t n;
+                filein >> n;
+                nCount = n;
+            }
+            vtxundo.clear();
+            for (uint64_t i = 0; i < nCount; i++) {
+                CTxUndo txundo;
+                filein >> txundo;
+                vtxundo.push_back(txundo);
+            }
+        }
         filein >> hashChecksum;
     } catch (std::exception& e) {
         return error("%s : Deserialize or I/O error - %s", __func__, e.what());
@@ -6882,6 +9251,295 @@ std::string CBlockFileInfo::ToString() const
     return strprintf("CBlockFileInfo(blocks=%u, size=%u, heights=%u...%u, time=%s...%s)", nBlocks, nSize, nHeightFirst, nHeightLast, DateTimeStrFormat("%Y-%m-%d", nTimeFirst), DateTimeStrFormat("%Y-%m-%d", nTimeLast));
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+//! Dumped entries older than this are not re-accepted on startup.
+static const int64_t MEMPOOL_DUMP_EXPIRY = 336 * 60 * 60; // 2 weeks
+
+//! Re-accept mempool entries deserialized from stream written by DumpMempool.
+template <typename Stream>
+static bool LoadMempoolStream(Stream& file)
+{
+    int64_t nNow = GetTime();
+
+    uint64_t version;
+    file >> version;
+    if (version != MEMPOOL_DUMP_VERSION)
+        return false;
+    uint64_t num;
+    file >> num;
+    int count = 0;
+    int skipped = 0;
+    int failed = 0;
+    while (num--) {
+        CTransaction tx;
+        int64_t nTime;
+        int64_t nFeeDelta;
+        file >> tx;
+        file >> nTime;
+        file >> nFeeDelta;
+
+        if (nFeeDelta)
+            mempool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), 0, nFeeDelta);
+
+        CValidationState state;
+        if (nTime + MEMPOOL_DUMP_EXPIRY > nNow) {
+            LOCK(cs_main);
+            if (AcceptToMemoryPoolWithTime(mempool, state, tx, true, NULL, nTime))
+                ++count;
+            else
+                ++failed;
+        } else {
+            ++skipped;
+        }
+        if (ShutdownRequested())
+            return false;
+    }
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    file >> mapDeltas;
+
+    for (const auto& i : mapDeltas)
+        mempool.PrioritiseTransaction(i.first, i.first.ToString(), i.second.first, i.second.second);
+
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired\n", count, failed, skipped);
+    return true;
+}
+
+bool LoadMempool()
+{
+    boost::filesystem::path path = GetDataDir() / "mempool.dat";
+
+#ifndef WIN32
+    // Map the dump read-only and deserialize straight out of the mapping;
+    // the file is typically in the page cache from the previous run.
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat sb;
+        if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+            void* pMap = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (pMap != MAP_FAILED) {
+                bool fOk;
+                try {
+                    CMemoryViewStream stream((const char*)pMap, sb.st_size, SER_DISK, CLIENT_VERSION);
+                    fOk = LoadMempoolStream(stream);
+                } catch (const std::exception& e) {
+                    munmap(pMap, sb.st_size);
+                    LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+                    return false;
+                }
+                munmap(pMap, sb.st_size);
+                return fOk;
+            }
+        } else {
+            close(fd);
+        }
+    } else if (errno == ENOENT) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+#endif
+
+    CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+    try {
+        return LoadMempoolStream(file);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+}
+
+void DumpMempool()
+{
+    int64_t start = GetTimeMicros();
+
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    std::vector<TxMempoolInfo> vinfo;
+
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+        vinfo = mempool.infoAll();
+    }
+
+    int64_t mid = GetTimeMicros();
+
+    try {
+        boost::filesystem::path pathTmp = GetDataDir() / "mempool.dat.new";
+        CAutoFile file(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+            return;
+
+        file << MEMPOOL_DUMP_VERSION;
+
+        file << (uint64_t)vinfo.size();
+        for (const auto& i : vinfo) {
+            file << *(i.tx);
+            file << (int64_t)i.nTime;
+            file << (int64_t)i.nFeeDelta;
+            mapDeltas.erase(i.tx->GetHash());
+        }
+
+        file << mapDeltas;
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(pathTmp, GetDataDir() / "mempool.dat");
+        int64_t last = GetTimeMicros();
+        LogPrintf("Dumped mempool: %gs to copy, %gs to dump\n", (mid - start) * 0.000001, (last - mid) * 0.000001);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+    }
+}
+
+static const int UTXO_SNAPSHOT_VERSION = 1;
+
+bool DumpUTXOSnapshot(const std::string& strPath, std::string& strError, int& nHeightOut, uint64_t& nCoinsOut, uint256& hashBaseOut)
+{
+    boost::filesystem::path path(strPath);
+    if (!path.is_complete())
+        path = GetDataDir() / path;
+    boost::filesystem::path pathTmp = path.string() + ".new";
+
+    try {
+        CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull()) {
+            strError = strprintf("Cannot open %s for writing", pathTmp.string());
+            return false;
+        }
+
+        // cs_main is held across the flush and both snapshot passes so the
+        // best block read here matches the coin set streamed out below.
+        LOCK(cs_main);
+        FlushStateToDisk();
+        hashBaseOut = pcoinsdbview->GetBestBlock();
+        CBlockIndex* pindex = LookupBlockIndex(hashBaseOut);
+        if (!pindex) {
+            strError = strprintf("Best block %s not found in block index", hashBaseOut.GetHex());
+            return false;
+        }
+        nHeightOut = pindex->nHeight;
+
+        fileout << UTXO_SNAPSHOT_VERSION;
+        fileout << hashBaseOut;
+        fileout << nHeightOut;
+        if (!pcoinsdbview->WriteSnapshot(fileout, hashBaseOut, nCoinsOut)) {
+            strError = "Failed to write coin records";
+            return false;
+        }
+        FileCommit(fileout.Get());
+        fileout.fclose();
+        RenameOver(pathTmp, path);
+    } catch (const std::exception& e) {
+        strError = e.what();
+        return false;
+    }
+    LogPrintf("%s: wrote %d coins at height %d to %s\n", __func__, nCoinsOut, nHeightOut, path.string());
+    return true;
+}
+
+bool LoadUTXOSnapshot(const std::string& strPath, std::string& strError, int& nHeightOut, uint64_t& nCoinsOut, uint256& hashBaseOut)
+{
+    boost::filesystem::path path(strPath);
+    if (!path.is_complete())
+        path = GetDataDir() / path;
+
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = strprintf("Cannot open %s for reading", path.string());
+        return false;
+    }
+
+    int nVersion;
+    try {
+        filein >> nVersion;
+        if (nVersion != UTXO_SNAPSHOT_VERSION) {
+            strError = strprintf("Unsupported snapshot version %d", nVersion);
+            return false;
+        }
+        filein >> hashBaseOut;
+        filein >> nHeightOut;
+        filein >> nCoinsOut;
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to read snapshot header: %s", e.what());
+        return false;
+    }
+
+    LOCK(cs_main);
+
+    CBlockIndex* pindex = LookupBlockIndex(hashBaseOut);
+    if (!pindex) {
+        strError = strprintf("Snapshot base block %s is not in the header tree; let header sync catch up first", hashBaseOut.GetHex());
+        return false;
+    }
+    if (chainActive.Height() >= nHeightOut) {
+        strError = strprintf("Chainstate is already at height %d, beyond the snapshot height %d", chainActive.Height(), nHeightOut);
+        return false;
+    }
+
+    // From here on the existing chainstate is replaced; a failure below
+    // leaves it inconsistent and requires a -reindex to recover.
+    mempool.clear();
+    FlushStateToDisk();
+    if (!pcoinsdbview->EraseAllCoins()) {
+        strError = "Failed to erase the old coin set; restart with -reindex";
+        return false;
+    }
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << hashBaseOut;
+    try {
+        uint256 txhash;
+        CCoins coins;
+        for (uint64_t i = 0; i < nCoinsOut; i++) {
+            boost::this_thread::interruption_point();
+            filein >> txhash;
+            filein >> coins;
+            ss << txhash << coins;
+            *pcoinsTip->ModifyCoins(txhash) = coins;
+            // Bound the cache: push completed batches down to the database.
+            if (pcoinsTip->GetCacheSize() > 1000000)
+                pcoinsTip->Flush();
+        }
+        uint256 hashChecksum;
+        filein >> hashChecksum;
+        if (ss.GetHash() != hashChecksum) {
+            strError = "Snapshot checksum mismatch; the chainstate is now inconsistent, restart with -reindex";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to read snapshot records: %s; the chainstate is now inconsistent, restart with -reindex", e.what());
+        return false;
+    }
+    pcoinsTip->SetBestBlock(hashBaseOut);
+    pcoinsTip->Flush();
+
+    // Mark the snapshot chain as valid. The block data below the snapshot is
+    // not on disk, so per-block tx counts are unknown; they only feed
+    // estimates, and are filled with a floor of one tx per block.
+    std::vector<CBlockIndex*> vpindexChain;
+    for (CBlockIndex* pindexWalk = pindex; pindexWalk != NULL && !chainActive.Contains(pindexWalk); pindexWalk = pindexWalk->pprev)
+        vpindexChain.push_back(pindexWalk);
+    for (std::vector<CBlockIndex*>::reverse_iterator it = vpindexChain.rbegin(); it != vpindexChain.rend(); ++it) {
+        CBlockIndex* pindexWalk = *it;
+        if (pindexWalk->nTx == 0)
+            pindexWalk->nTx = 1;
+        pindexWalk->nChainTx = (pindexWalk->pprev ? pindexWalk->pprev->nChainTx : 0) + pindexWalk->nTx;
+        pindexWalk->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindexWalk);
+    }
+    chainActive.SetTip(pindex);
+    setBlockIndexCandidates.insert(pindex);
+    if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindex->nChainWork)
+        pindexBestHeader = pindex;
+    FlushStateToDisk();
+
+    LogPrintf("%s: loaded %d coins, new tip %s at height %d\n", __func__, nCoinsOut, hashBaseOut.GetHex(), nHeightOut);
+    return true;
+}
+
 int GetSpendHeight(const CCoinsViewCache& inputs)
 {
     LOCK(cs_main);
@@ -6904,6 +9562,8 @@ public:
         // orphan transactions
         mapOrphanTransactions.clear();
         mapOrphanTransactionsByPrev.clear();
+        mapOrphanTransactionsByPeer.clear();
+        vOrphanEvictionCandidates.clear();
     }
 } instance_of_cmaincleanup;
 
@@ -6917,6 +9577,23 @@ bool CheckSenderScript(const CCoinsViewCache& view, const CTransaction& tx){
     return true;
 }
 
+// EVM state snapshot published at each tip update; read-only contract calls
+// execute against these roots without taking cs_main.
+static CCriticalSection cs_evmSnapshot;
+static CBlockIndex* psnapshotTip = NULL;
+static dev::h256 snapshotStateRoot;
+static dev::h256 snapshotUTXORoot;
+
+void PublishEVMSnapshot()
+{
+    if (!globalState)
+        return;
+    LOCK(cs_evmSnapshot);
+    psnapshotTip = chainActive.Tip();
+    snapshotStateRoot = globalState->rootHash();
+    snapshotUTXORoot = globalState->rootHashUTXO();
+}
+
 std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, const dev::Address& sender, uint64_t gasLimit){
     CBlock block;
     CMutableTransaction tx;
@@ -6951,6 +9628,64 @@ std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::v
     return exec.getResult();
 }
 
+std::vector<ResultExecute> CallContractReadOnly(const dev::Address& addrContract, std::vector<unsigned char> opcode, const dev::Address& sender, uint64_t gasLimit){
+    CBlockIndex* ptip = NULL;
+    dev::h256 hashStateRoot;
+    dev::h256 hashUTXORoot;
+    {
+        LOCK(cs_evmSnapshot);
+        ptip = psnapshotTip;
+        hashStateRoot = snapshotStateRoot;
+        hashUTXORoot = snapshotUTXORoot;
+    }
+    if (!ptip || !globalCallState) {
+        // no snapshot published yet; fall back to the validation state
+        LOCK(cs_main);
+        return CallContract(addrContract, opcode, sender, gasLimit);
+    }
+
+    std::shared_ptr<const CBlock> pblockRead = FetchBlockShared(ptip, Params().GetConsensus());
+    if (!pblockRead) {
+        LOCK(cs_main);
+        return CallContract(addrContract, opcode, sender, gasLimit);
+    }
+    CBlock block(*pblockRead);
+    block.nTime = GetAdjustedTime();
+
+    if(block.IsProofOfStake())
+        block.vtx.erase(block.vtx.begin()+2,block.vtx.end());
+    else
+        block.vtx.erase(block.vtx.begin()+1,block.vtx.end());
+
+    // Calls are serialized against each other here (the call state is a single
+    // mutable object), but never against cs_main or validation.
+    static CCriticalSection cs_callContract;
+    LOCK(cs_callContract);
+    globalCallState->setRoot(hashStateRoot);
+    globalCallState->setRootUTXO(hashUTXORoot);
+
+    // force storage-mode DGP reads so the gas limit comes from the snapshot
+    // state rather than a nested CallContract against globalState
+    LuxDGP luxDGP(globalCallState.get(), false);
+    uint64_t blockGasLimit = luxDGP.getBlockGasLimit(ptip->nHeight + 1);
+
+    if(gasLimit == 0){
+        gasLimit = blockGasLimit - 1;
+    }
+    dev::Address senderAddress = sender == dev::Address() ? dev::Address("ffffffffffffffffffffffffffffffffffffffff") : sender;
+    CMutableTransaction tx;
+    tx.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << senderAddress.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG));
+    block.vtx.push_back(CTransaction(tx));
+
+    LuxTransaction callTransaction(0, 1, dev::u256(gasLimit), addrContract, opcode, dev::u256(0));
+    callTransaction.forceSender(senderAddress);
+    callTransaction.setVersion(VersionVM::GetEVMDefault());
+
+    ByteCodeExec exec(block, std::vector<LuxTransaction>(1, callTransaction), blockGasLimit, globalCallState.get(), globalCallSealEngine.get(), ptip);
+    exec.performByteCode(dev::eth::Permanence::Reverted);
+    return exec.getResult();
+}
+
 bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice){
     for(EthTransactionParams& etp : etps){
         if(etp.gasPrice < dev::u256(minGasPrice))
@@ -7010,7 +9745,7 @@ UniValue vmLogToJSON(const ResultExecute& execRes, const CTransaction& tx, const
     result.push_back(Pair("address", execRes.execRes.newAddress.hex()));
 
     CBlockIndex* pindexPrev = LookupBlockIndex(block.hashPrevBlock);
-    bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= Params().SwitchPhi2Block() : false;
+    bool usePhi2 = pindexPrev ? pindexPrev->nHeight + 1 >= frozenParams.nSwitchPhi2Block : false;
 
     if(block.GetHash(usePhi2) != CBlock().GetHash(usePhi2)){
         result.push_back(Pair("time", block.GetBlockTime()));
@@ -7070,23 +9805,26 @@ void writeVMlog(const std::vector<ResultExecute>& res, const CTransaction& tx, c
 }
 
 bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
+    LuxState* pExecState = state ? state : globalState.get();
+    dev::eth::SealEngineFace* pSealEngine = sealEngine ? sealEngine : globalSealEngine.get();
+    // the environment only depends on the block, not on the transaction
+    dev::eth::EnvInfo envInfo(BuildEVMEnvironment());
     for(LuxTransaction& tx : txs){
         //validate VM version
         if(tx.getVersion().toRaw() != VersionVM::GetEVMDefault().toRaw()){
             return false;
         }
-        dev::eth::EnvInfo envInfo(BuildEVMEnvironment());
-        if(!tx.isCreation() && !globalState->addressInUse(tx.receiveAddress())){
+        if(!tx.isCreation() && !pExecState->addressInUse(tx.receiveAddress())){
             dev::eth::ExecutionResult execRes;
             execRes.excepted = dev::eth::TransactionException::Unknown;
             result.push_back(ResultExecute{execRes, dev::eth::TransactionReceipt(dev::h256(), dev::u256(), dev::eth::LogEntries()), CTransaction()});
             continue;
         }
-        result.push_back(globalState->execute(envInfo, *globalSealEngine.get(), tx, type, OnOpFunc()));
+        result.push_back(pExecState->execute(envInfo, *pSealEngine, tx, type, OnOpFunc()));
     }
-    globalState->db().commit();
-    globalState->dbUtxo().commit();
-    globalSealEngine.get()->deleteAddresses.clear();
+    pExecState->db().commit();
+    pExecState->dbUtxo().commit();
+    pSealEngine->deleteAddresses.clear();
     return true;
 }
 
@@ -7129,22 +9867,38 @@ bool ByteCodeExec::processingResults(ByteCodeExecResult& resultBCE){
     return true;
 }
 
+/**
+ * The EVM BLOCKHASH window covers the 256 ancestors of the current tip. Walking
+ * them is cheap once, but ConnectBlock builds a ByteCodeExec per contract
+ * transaction, so cache the walk keyed on the tip hash. */
+static CCriticalSection cs_lastHashesCache;
+static dev::h256 hashLastHashesCacheTip;
+static dev::eth::LastHashes vLastHashesCache;
+
 dev::eth::EnvInfo ByteCodeExec::BuildEVMEnvironment(){
     dev::eth::EnvInfo env;
-    CBlockIndex* tip = chainActive.Tip();
+    CBlockIndex* tip = ptip ? ptip : chainActive.Tip();
     env.setNumber(dev::u256(tip->nHeight + 1));
     env.setTimestamp(dev::u256(block.nTime));
     env.setDifficulty(dev::u256(block.nBits));
 
-    dev::eth::LastHashes lh;
-    lh.resize(256);
-    for(int i=0;i<256;i++){
-        if(!tip)
-            break;
-        lh[i]= uintToh256(*tip->phashBlock);
-        tip = tip->pprev;
+    {
+        LOCK(cs_lastHashesCache);
+        if (hashLastHashesCacheTip != uintToh256(*tip->phashBlock)) {
+            dev::eth::LastHashes lh;
+            lh.resize(256);
+            CBlockIndex* pwalk = tip;
+            for(int i=0;i<256;i++){
+                if(!pwalk)
+                    break;
+                lh[i]= uintToh256(*pwalk->phashBlock);
+                pwalk = pwalk->pprev;
+            }
+            hashLastHashesCacheTip = uintToh256(*tip->phashBlock);
+            vLastHashesCache = std::move(lh);
+        }
+        env.setLastHashes(dev::eth::LastHashes(vLastHashesCache));
     }
-    env.setLastHashes(std::move(lh));
     env.setGasLimit(blockGasLimit);
     if(block.IsProofOfStake()){
         env.setAuthor(EthAddrFromScript(block.vtx[1].vout[1].scriptPubKey));
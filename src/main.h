@@ -12,8 +12,10 @@
 #include "config/lux-config.h"
 #endif
 
+#include "addressindex.h"
 #include "amount.h"
 #include "chain.h"
+#include "spentindex.h"
 #include "chainparams.h"
 #include "coins.h"
 #include "net.h"
@@ -33,6 +35,7 @@
 #include <algorithm>
 #include <exception>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -57,6 +60,9 @@
 
 extern std::unique_ptr<LuxState> globalState;
 extern std::shared_ptr<dev::eth::SealEngineFace> globalSealEngine;
+//! Detached copy of the EVM state used by read-only snapshot contract calls
+extern std::unique_ptr<LuxState> globalCallState;
+extern std::shared_ptr<dev::eth::SealEngineFace> globalCallSealEngine;
 extern bool fRecordLogOpcodes;
 extern bool fIsVMlogFile;
 extern bool fGettingValuesDGP;
@@ -69,6 +75,7 @@ using ExtractLuxTX = std::pair<std::vector<LuxTransaction>, std::vector<EthTrans
 class CBlockIndex;
 class CBlockTreeDB;
 class CBloomFilter;
+class CCoinsViewDB;
 class CChainParams;
 class CInv;
 class CConnman;
@@ -116,8 +123,12 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** -undocachedepth default (number of recent blocks whose undo data is kept in memory for fast reorgs) */
+static const int DEFAULT_UNDO_CACHE_DEPTH = 50;
+/** -compressblockfiles default (store new blocks in the compact on-disk format) */
+static const bool DEFAULT_COMPRESS_BLOCK_FILES = false;
 /** Maximum number of script-checking threads allowed */
-static const int MAX_SCRIPTCHECK_THREADS = 16;
+static const int MAX_SCRIPTCHECK_THREADS = 32;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
@@ -140,6 +151,10 @@ static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
 static const unsigned int DEFAULT_BYTES_PER_SIGOP = 20;
+/** Default for -persistmempool, saving the mempool to mempool.dat on shutdown and loading it on startup */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
+static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
 
 static const int64_t STATIC_POS_REWARD = 1 * COIN; //Constant reward 8%
 
@@ -201,8 +216,15 @@ extern CWaitableCriticalSection csBestBlock;
 extern CConditionVariable cvBlockChange;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
+extern std::atomic_bool fReindexChainState;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+//! Whether to maintain the rolling UTXO set hash (-utxosethash)
+extern bool fUtxoSetHash;
+//! Rolling UTXO set hash accumulator (protected by cs_main)
+extern CUtxoSetHasher utxoSetHash;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
 extern bool fLogEvents;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
@@ -217,6 +239,12 @@ extern bool fLargeWorkInvalidChainFound;
 
 extern CBlockIndex* pindexBestHeader;
 
+/** Block hash whose ancestors we assume to have valid scripts (-assumevalid). */
+extern uint256 hashAssumeValid;
+/** Minimum number of blocks the best header chain must bury a block before
+ *  -assumevalid may skip its script checks. */
+static const int ASSUME_VALID_MIN_DEPTH = 1000;
+
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
@@ -303,6 +331,14 @@ bool IsInitialBlockDownload();
 std::string GetWarnings(std::string strFor);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransaction& tx, const Consensus::Params& params, uint256& hashBlock, bool fAllowSlow = false);
+/** Retrieve one script's index entries in block order (requires -addressindex); start/end page by height */
+bool GetAddressIndex(const uint160& addressHash, unsigned char type, std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, int start = 0, int end = 0);
+/** Look up where an outpoint was spent (requires -spentindex) */
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+/** Batch form of GetTransaction for explorer-style loads: misses are read
+ *  from the block files in file-offset order. Failed lookups leave a null
+ *  entry in vtxOut; the coin-database fallback is not attempted. */
+void GetTransactions(const std::vector<uint256>& vhash, std::vector<CTransactionRef>& vtxOut, std::vector<uint256>& vhashBlock);
 /** Find the best known block, and make it the tip of the block chain */
 
 bool DisconnectBlocksAndReprocess(int blocks);
@@ -349,20 +385,39 @@ CBlockIndex* InsertBlockIndex(uint256 hash);
 bool AbortNode(const std::string& msg, const std::string& userMessage = "");
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats);
+/** Get block download stall counters (stall/timeout disconnects, reassigned requests) */
+void GetBlockFetchStats(int64_t& nStallDisconnectsOut, int64_t& nTimeoutDisconnectsOut, int64_t& nReassignedOut);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch);
 /** This function is called from the RPC code for pruneblockchain */
 void PruneBlockFilesManual(int nManualPruneHeight);
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+/** Scheduler hook: flush the coin cache during idle inter-block gaps when the dirty backlog warrants it. */
+void AdaptiveFlushCheck();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool ignoreFees = false);
 
+/** (try to) add transaction to memory pool with a specified acceptance time **/
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, int64_t nAcceptTime, bool fRejectInsaneFee = false, bool ignoreFees = false);
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool isDSTX = false);
 
+/** Dump the memory pool to mempool.dat on disk. */
+void DumpMempool();
+/** Load the memory pool from mempool.dat; entries are re-validated through AcceptToMemoryPool. */
+bool LoadMempool();
+
+/** Write a hash-committed snapshot of the chainstate to disk. */
+bool DumpUTXOSnapshot(const std::string& strPath, std::string& strError, int& nHeightOut, uint64_t& nCoinsOut, uint256& hashBaseOut);
+/** Replace the chainstate with a snapshot written by DumpUTXOSnapshot and
+ *  move the active chain to its base block. The snapshot is trusted: blocks
+ *  below its base are not revalidated (nor available on disk afterwards). */
+bool LoadUTXOSnapshot(const std::string& strPath, std::string& strError, int& nHeightOut, uint64_t& nCoinsOut, uint256& hashBaseOut);
+
 
 //////////////////////////////////////////////////////////// // lux
 struct CHeightTxIndexIteratorKey {
@@ -439,6 +494,8 @@ struct CNodeStateStats {
     int nMisbehavior;
     int nSyncHeight;
     int nCommonHeight;
+    //! Smoothed getdata-to-delivery block latency in milliseconds, 0 if no block delivered yet
+    int64_t nBlockLatencyMs;
     std::vector<int> vHeightInFlight;
 };
 
@@ -676,6 +733,11 @@ public:
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read a block through a small shared cache of recently decoded blocks.
+ *  Concurrent requests for the same block coalesce into a single disk read.
+ *  Returns a null pointer on read failure. Meant for serving paths (RPC,
+ *  REST, getdata), not for validation. */
+std::shared_ptr<const CBlock> FetchBlockShared(const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -693,9 +755,11 @@ bool DisconnectBlocksAndReprocess(int blocks);
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, const CChainParams& chainparams, bool fJustCheck = false);
 
 /** Context-independent validity checks */
-bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, const uint256* phashBlock = NULL);
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig = true);
 bool CheckWork(const CBlock &block, CBlockIndex* const pindexPrev);
+/** Verify the stake kernel of a proof-of-stake block (no-op for proof-of-work) */
+bool CheckBlockProof(const CBlock& block, CBlockIndex* const pindexPrev);
 
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, CBlockIndex* pindexPrev);
@@ -806,6 +870,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
+/** Global variable that points to the coin database (protected by cs_main) */
+extern CCoinsViewDB* pcoinsdbview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB* pblocktree;
 
@@ -831,6 +898,15 @@ int GetSpendHeight(const CCoinsViewCache& inputs);
 //////////////////////////////////////////////////////// lux
 std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, const dev::Address& sender = dev::Address(), uint64_t gasLimit=0);
 
+/** Like CallContract, but executed against the EVM state snapshot published at
+ *  the last tip update instead of globalState, so it does not take cs_main.
+ *  Meant for eth-call style RPC traffic; validation keeps using CallContract. */
+std::vector<ResultExecute> CallContractReadOnly(const dev::Address& addrContract, std::vector<unsigned char> opcode, const dev::Address& sender = dev::Address(), uint64_t gasLimit=0);
+
+/** Publish the current tip and EVM state roots as the snapshot that read-only
+ *  contract calls execute against. Caller must hold cs_main. */
+void PublishEVMSnapshot();
+
 bool CheckSenderScript(const CCoinsViewCache& view, const CTransaction& tx);
 
 bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice);
@@ -893,7 +969,9 @@ class ByteCodeExec {
 
 public:
 
-    ByteCodeExec(const CBlock& _block, std::vector<LuxTransaction> _txs, const uint64_t _blockGasLimit) : txs(_txs), block(_block), blockGasLimit(_blockGasLimit) {}
+    ByteCodeExec(const CBlock& _block, const std::vector<LuxTransaction>& _txs, const uint64_t _blockGasLimit,
+                 LuxState* _state = NULL, dev::eth::SealEngineFace* _sealEngine = NULL, CBlockIndex* _tip = NULL)
+        : txs(_txs), block(_block), blockGasLimit(_blockGasLimit), state(_state), sealEngine(_sealEngine), ptip(_tip) {}
 
     bool performByteCode(dev::eth::Permanence type = dev::eth::Permanence::Committed);
 
@@ -915,6 +993,15 @@ private:
 
     const uint64_t blockGasLimit;
 
+    //! State and seal engine to execute against; NULL falls back to the
+    //! globals, keeping the validation path unchanged. ptip pins the EVM
+    //! environment to a snapshot tip for calls made without cs_main.
+    LuxState* state;
+
+    dev::eth::SealEngineFace* sealEngine;
+
+    CBlockIndex* ptip;
+
 };
 ////////////////////////////////////////////////////////
 
@@ -27,6 +27,71 @@ std::map<CNetAddr, int64_t> askedForMasternodeList;
 std::map<COutPoint, int64_t> askedForMasternodeListEntry;
 // cache block hashes as we calculate them
 std::map<int64_t, uint256> mapCacheBlockHashes;
+// index into vecMasternodes by collateral prevout, so dsee/dseep lookups
+// don't rescan the whole list for every broadcast during a cold sync
+static std::map<COutPoint, size_t> mapMasternodeIndex;
+
+// ranked score list shared by GetMasternodeRank and GetMasternodeByRank;
+// recomputed when the list changes (generation bump), the target height or
+// protocol floor differs, or the entry checks have gone stale
+static uint64_t nMasternodeListGeneration = 0;
+static uint64_t nCachedScoresGeneration = 0;
+static int64_t nCachedScoresHeight = -1;
+static int nCachedScoresMinProtocol = 0;
+static int64_t nCachedScoresTime = 0;
+static std::vector<std::pair<unsigned int, int> > vecCachedMasternodeScores;
+
+void AddMasternode(const CMasterNode& mn) {
+    mapMasternodeIndex[mn.vin.prevout] = vecMasternodes.size();
+    vecMasternodes.push_back(mn);
+    InvalidateMasternodeRanks();
+}
+
+void RebuildMasternodeIndex() {
+    mapMasternodeIndex.clear();
+    for (size_t i = 0; i < vecMasternodes.size(); i++)
+        mapMasternodeIndex[vecMasternodes[i].vin.prevout] = i;
+    InvalidateMasternodeRanks();
+}
+
+void InvalidateMasternodeRanks() {
+    nMasternodeListGeneration++;
+}
+
+uint64_t GetMasternodeListGeneration() {
+    return nMasternodeListGeneration;
+}
+
+// Deferred verification of masternode gossip. ProcessMasternode only runs the
+// cheap structural checks on the message-handler thread and queues the rest;
+// CheckDarkSendPool drains the queue, verifies the ECDSA signatures with
+// no locks held and only then applies the state changes, so a gossip storm
+// can't stall block relay behind thousands of inline signature checks.
+struct CPendingMasternodeEntry {
+    NodeId idFrom;
+    CAddress addrFrom;
+    CTxIn vin;
+    CService addr;
+    CPubKey pubkey;
+    CPubKey pubkey2;
+    std::vector<unsigned char> vchSig;
+    int64_t sigTime;
+    int count;
+    int current;
+    int64_t lastUpdated;
+    int protocolVersion;
+    bool isLocal;
+};
+
+struct CPendingMasternodeWinner {
+    NodeId idFrom;
+    CMasternodePaymentWinner winner;
+};
+
+static CCriticalSection cs_pendingMasternodeSigs;
+static std::deque<CPendingMasternodeEntry> queuePendingEntries;
+static std::deque<CPendingMasternodeWinner> queuePendingWinners;
+static const size_t MAX_PENDING_MASTERNODE_SIGS = 10000;
 
 // manage the masternode connections
 void ProcessMasternodeConnections() {
@@ -61,7 +126,6 @@ void ProcessMasternode(CNode* pfrom, const std::string& strCommand, CDataStream&
         int current;
         int64_t lastUpdated;
         int protocolVersion;
-        std::string strMessage;
 
         // 70047 and greater
         vRecv >> vin >> addr >> vchSig >> sigTime >> pubkey >> pubkey2 >> count >> current >> lastUpdated >> protocolVersion;
@@ -75,11 +139,6 @@ void ProcessMasternode(CNode* pfrom, const std::string& strCommand, CDataStream&
         bool isLocal = addr.IsRFC1918() || addr.IsLocal();
         //if(Params().MineBlocksOnDemand()) isLocal = false;
 
-        std::string vchPubKey(pubkey.begin(), pubkey.end());
-        std::string vchPubKey2(pubkey2.begin(), pubkey2.end());
-
-        strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(protocolVersion);
-
         if (protocolVersion < MIN_MN_PROTO_VERSION) {
             LogPrintf("dsee - ignoring outdated masternode %s protocol version %d\n", vin.ToString().c_str(), protocolVersion);
             return;
@@ -103,99 +162,40 @@ void ProcessMasternode(CNode* pfrom, const std::string& strCommand, CDataStream&
             return;
         }
 
-        std::string errorMessage = "";
-        if (!darkSendSigner.VerifyMessage(pubkey, vchSig, strMessage, errorMessage)) {
-            LogPrintf("dsee - Got bad masternode address signature\n");
-            Misbehaving(pfrom->GetId(), 100);
-            return;
-        }
-
-
-        //search existing masternode list, this is where we update existing masternodes with new dsee broadcasts
-        //LOCK(cs_masternodes);
-        BOOST_FOREACH(CMasterNode& mn, vecMasternodes) {
-            if (mn.vin.prevout == vin.prevout) {
-                // count == -1 when it's a new entry
-                //   e.g. We don't want the entry relayed/time updated when we're syncing the list
-                // mn.pubkey = pubkey, IsVinAssociatedWithPubkey is validated once below,
-                //   after that they just need to match
-                if (count == -1 && mn.pubkey == pubkey && !mn.UpdatedWithin(MASTERNODE_MIN_DSEE_SECONDS)) {
-                    mn.UpdateLastSeen();
-
-                    if (mn.now < sigTime) { //take the newest entry
-                        LogPrintf("dsee - Got updated entry for %s\n", addr.ToString().c_str());
-                        mn.pubkey2 = pubkey2;
-                        mn.now = sigTime;
-                        mn.sig = vchSig;
-                        mn.protocolVersion = protocolVersion;
-                        mn.addr = addr;
-
-                        RelayDarkSendElectionEntry(vin, addr, vchSig, sigTime, pubkey, pubkey2, count, current, lastUpdated, protocolVersion);
-                    }
-                }
-
-                return;
-            }
-        }
-
-        // make sure the vout that was signed is related to the transaction that spawned the masternode
-        //  - this is expensive, so it's only done once per masternode
-        if (!darkSendSigner.IsVinAssociatedWithPubkey(vin, pubkey) && !IsInitialBlockDownload()) {
-            LogPrintf("dsee - Got mismatched pubkey and vin\n");
-            if (!IsTestNet()) {
-                Misbehaving(pfrom->GetId(), 100);
-                return;
+        {
+            // if we already have a fresh entry nothing below would change any
+            // state, so don't even queue the signature for verification
+            LOCK(cs_masternodes);
+            std::map<COutPoint, size_t>::iterator mi = mapMasternodeIndex.find(vin.prevout);
+            if (mi != mapMasternodeIndex.end()) {
+                CMasterNode& mn = vecMasternodes[(*mi).second];
+                if (!(count == -1 && mn.pubkey == pubkey && !mn.UpdatedWithin(MASTERNODE_MIN_DSEE_SECONDS)))
+                    return;
             }
         }
 
-        if (fDebug) LogPrintf("dsee - Got NEW masternode entry %s\n", addr.ToString().c_str());
-
-        // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckDarkSendPool()
-
-        CValidationState state;
-        CMutableTransaction tx = CMutableTransaction();
-        CTxOut vout = CTxOut((GetMNCollateral(chainActive.Height()) - 1) * COIN, darkSendPool.collateralPubKey);
-        tx.vin.push_back(vin);
-        tx.vout.push_back(vout);
-        //if(AcceptableInputs(mempool, state, tx)){
-        bool pfMissingInputs;
-        if (AcceptableInputs(mempool, state, CTransaction(tx), false, &pfMissingInputs)) {
-            if (fDebug) LogPrintf("dsee - Accepted masternode entry %i %i\n", count, current);
-
-            if (GetInputAge(vin) < MASTERNODE_MIN_CONFIRMATIONS) {
-                LogPrintf("dsee - Input must have least %d confirmations\n", MASTERNODE_MIN_CONFIRMATIONS);
-                Misbehaving(pfrom->GetId(), 20);
-                return;
-            }
-
-            // use this as a peer
-            addrman.Add(CAddress(addr, NODE_NETWORK), pfrom->addr, 2 * 60 * 60);
-
-            // add our masternode
-            CMasterNode mn(addr, vin, pubkey, vchSig, sigTime, pubkey2, protocolVersion);
-            mn.UpdateLastSeen(lastUpdated);
-            vecMasternodes.push_back(mn);
-
-            // if it matches our masternodeprivkey, then we've been remotely activated
-            if (pubkey2 == activeMasternode.pubKeyMasternode && protocolVersion == PROTOCOL_VERSION) {
-                activeMasternode.EnableHotColdMasterNode(vin, addr);
-            }
-
-            if (count == -1 && !isLocal)
-                RelayDarkSendElectionEntry(vin, addr, vchSig, sigTime, pubkey, pubkey2, count, current, lastUpdated, protocolVersion);
-
-        } else {
-            LogPrintf("dsee - Rejected masternode entry %s\n", addr.ToString().c_str());
-
-            int nDoS = 0;
-            if (state.IsInvalid(nDoS)) {
-                LogPrintf("dsee - %s from %s %s was not accepted into the memory pool\n", tx.GetHash().ToString().c_str(),
-                          pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str());
-                if (nDoS > 0)
-                    Misbehaving(pfrom->GetId(), nDoS);
-            }
+        // hand the expensive part to CheckDarkSendPool
+        CPendingMasternodeEntry entry;
+        entry.idFrom = pfrom->GetId();
+        entry.addrFrom = CAddress(pfrom->addr);
+        entry.vin = vin;
+        entry.addr = addr;
+        entry.pubkey = pubkey;
+        entry.pubkey2 = pubkey2;
+        entry.vchSig = vchSig;
+        entry.sigTime = sigTime;
+        entry.count = count;
+        entry.current = current;
+        entry.lastUpdated = lastUpdated;
+        entry.protocolVersion = protocolVersion;
+        entry.isLocal = isLocal;
+
+        LOCK(cs_pendingMasternodeSigs);
+        if (queuePendingEntries.size() >= MAX_PENDING_MASTERNODE_SIGS) {
+            LogPrintf("dsee - pending verification queue full, dropping entry %s\n", vin.ToString().c_str());
+            return;
         }
+        queuePendingEntries.push_back(entry);
     }
 
     else if (strCommand == "dseep") { //DarkSend Election Entry Ping
@@ -223,10 +223,16 @@ void ProcessMasternode(CNode* pfrom, const std::string& strCommand, CDataStream&
 
         // see if we have this masternode
         LOCK(cs_masternodes);
-        BOOST_FOREACH(CMasterNode& mn, vecMasternodes) {
-            if (mn.vin.prevout == vin.prevout) {
+        std::map<COutPoint, size_t>::iterator mi = mapMasternodeIndex.find(vin.prevout);
+        if (mi != mapMasternodeIndex.end()) {
+            CMasterNode& mn = vecMasternodes[(*mi).second];
+            {
                 // take this only if it's newer
                 if (mn.lastDseep < sigTime) {
+                    // a non-stop ping for an entry seen recently changes nothing,
+                    // so skip the signature check entirely
+                    if (!stop && mn.UpdatedWithin(MASTERNODE_MIN_DSEEP_SECONDS)) return;
+
                     std::string strMessage = mn.addr.ToString() + boost::lexical_cast<std::string>(sigTime) + boost::lexical_cast<std::string>(stop);
 
                     std::string errorMessage = "";
@@ -243,6 +249,7 @@ void ProcessMasternode(CNode* pfrom, const std::string& strCommand, CDataStream&
                         if (stop) {
                             mn.Disable();
                             mn.Check();
+                            InvalidateMasternodeRanks();
                         }
                         RelayDarkSendElectionEntryPing(vin, vchSig, sigTime, stop);
                     }
@@ -346,9 +353,12 @@ void ProcessMasternode(CNode* pfrom, const std::string& strCommand, CDataStream&
         if (chainActive.Tip() == NULL) return;
 
         uint256 hash = winner.GetHash();
-        if (mapSeenMasternodeVotes.count(hash)) {
-            if (fDebug) LogPrintf("mnw - seen vote %s Height %d bestHeight %d\n", hash.ToString().c_str(), winner.nBlockHeight, chainActive.Height());
-            return;
+        {
+            LOCK(cs_masternodes);
+            if (mapSeenMasternodeVotes.count(hash)) {
+                if (fDebug) LogPrintf("mnw - seen vote %s Height %d bestHeight %d\n", hash.ToString().c_str(), winner.nBlockHeight, chainActive.Height());
+                return;
+            }
         }
 
         if (winner.nBlockHeight < chainActive.Height() - 10 || winner.nBlockHeight > chainActive.Height() + 20) {
@@ -364,16 +374,165 @@ void ProcessMasternode(CNode* pfrom, const std::string& strCommand, CDataStream&
 
         LogPrintf("mnw - winning vote  %s Height %d bestHeight %d\n", winner.vin.ToString().c_str(), winner.nBlockHeight, chainActive.Height());
 
-        if (!masternodePayments.CheckSignature(winner)) {
-            LogPrintf("mnw - invalid signature\n");
-            Misbehaving(pfrom->GetId(), 100);
+        // hand the signature check to CheckDarkSendPool
+        CPendingMasternodeWinner pending;
+        pending.idFrom = pfrom->GetId();
+        pending.winner = winner;
+
+        LOCK(cs_pendingMasternodeSigs);
+        if (queuePendingWinners.size() >= MAX_PENDING_MASTERNODE_SIGS) {
+            LogPrintf("mnw - pending verification queue full, dropping vote %s\n", hash.ToString().c_str());
+            return;
+        }
+        queuePendingWinners.push_back(pending);
+    }
+}
+
+// Verify and apply a queued dsee broadcast; the signature has already been
+// checked. This is everything the inline handler used to do after the
+// signature check, with the peer identified by id/address instead of a CNode.
+static void ApplyPendingMasternodeEntry(const CPendingMasternodeEntry& e) {
+    LOCK(cs_main);
+
+    //search existing masternode list, this is where we update existing masternodes with new dsee broadcasts
+    {
+        LOCK(cs_masternodes);
+        std::map<COutPoint, size_t>::iterator mi = mapMasternodeIndex.find(e.vin.prevout);
+        if (mi != mapMasternodeIndex.end()) {
+            CMasterNode& mn = vecMasternodes[(*mi).second];
+            // count == -1 when it's a new entry
+            //   e.g. We don't want the entry relayed/time updated when we're syncing the list
+            // mn.pubkey = pubkey, IsVinAssociatedWithPubkey is validated once below,
+            //   after that they just need to match
+            if (e.count == -1 && mn.pubkey == e.pubkey && !mn.UpdatedWithin(MASTERNODE_MIN_DSEE_SECONDS)) {
+                mn.UpdateLastSeen();
+
+                if (mn.now < e.sigTime) { //take the newest entry
+                    LogPrintf("dsee - Got updated entry for %s\n", e.addr.ToString().c_str());
+                    mn.pubkey2 = e.pubkey2;
+                    mn.now = e.sigTime;
+                    mn.sig = e.vchSig;
+                    mn.protocolVersion = e.protocolVersion;
+                    mn.addr = e.addr;
+                    InvalidateMasternodeRanks();
+
+                    RelayDarkSendElectionEntry(e.vin, e.addr, e.vchSig, e.sigTime, e.pubkey, e.pubkey2, e.count, e.current, e.lastUpdated, e.protocolVersion);
+                }
+            }
+
             return;
         }
+    }
 
-        mapSeenMasternodeVotes.insert(make_pair(hash, winner));
+    // the darksend signer / active masternode interfaces take non-const refs
+    CTxIn vin = e.vin;
+    CService addr = e.addr;
+    CPubKey pubkey = e.pubkey;
 
-        if (masternodePayments.AddWinningMasternode(winner)) {
-            masternodePayments.Relay(winner);
+    // make sure the vout that was signed is related to the transaction that spawned the masternode
+    //  - this is expensive, so it's only done once per masternode
+    if (!darkSendSigner.IsVinAssociatedWithPubkey(vin, pubkey) && !IsInitialBlockDownload()) {
+        LogPrintf("dsee - Got mismatched pubkey and vin\n");
+        if (!IsTestNet()) {
+            Misbehaving(e.idFrom, 100);
+            return;
+        }
+    }
+
+    if (fDebug) LogPrintf("dsee - Got NEW masternode entry %s\n", e.addr.ToString().c_str());
+
+    // make sure it's still unspent
+    //  - this is checked later by .check() in many places and by CheckDarkSendPool()
+
+    CValidationState state;
+    CMutableTransaction tx = CMutableTransaction();
+    CTxOut vout = CTxOut((GetMNCollateral(chainActive.Height()) - 1) * COIN, darkSendPool.collateralPubKey);
+    tx.vin.push_back(vin);
+    tx.vout.push_back(vout);
+    bool pfMissingInputs;
+    if (AcceptableInputs(mempool, state, CTransaction(tx), false, &pfMissingInputs)) {
+        if (fDebug) LogPrintf("dsee - Accepted masternode entry %i %i\n", e.count, e.current);
+
+        if (GetInputAge(vin) < MASTERNODE_MIN_CONFIRMATIONS) {
+            LogPrintf("dsee - Input must have least %d confirmations\n", MASTERNODE_MIN_CONFIRMATIONS);
+            Misbehaving(e.idFrom, 20);
+            return;
+        }
+
+        // use this as a peer
+        addrman.Add(CAddress(e.addr, NODE_NETWORK), e.addrFrom, 2 * 60 * 60);
+
+        // add our masternode
+        CMasterNode mn(e.addr, vin, e.pubkey, e.vchSig, e.sigTime, e.pubkey2, e.protocolVersion);
+        mn.UpdateLastSeen(e.lastUpdated);
+        {
+            LOCK(cs_masternodes);
+            AddMasternode(mn);
+        }
+
+        // if it matches our masternodeprivkey, then we've been remotely activated
+        if (e.pubkey2 == activeMasternode.pubKeyMasternode && e.protocolVersion == PROTOCOL_VERSION) {
+            activeMasternode.EnableHotColdMasterNode(vin, addr);
+        }
+
+        if (e.count == -1 && !e.isLocal)
+            RelayDarkSendElectionEntry(e.vin, e.addr, e.vchSig, e.sigTime, e.pubkey, e.pubkey2, e.count, e.current, e.lastUpdated, e.protocolVersion);
+
+    } else {
+        LogPrintf("dsee - Rejected masternode entry %s\n", e.addr.ToString().c_str());
+
+        int nDoS = 0;
+        if (state.IsInvalid(nDoS)) {
+            LogPrintf("dsee - %s from %s was not accepted into the memory pool\n", tx.GetHash().ToString().c_str(),
+                      e.addrFrom.ToString().c_str());
+            if (nDoS > 0)
+                Misbehaving(e.idFrom, nDoS);
+        }
+    }
+}
+
+void ProcessPendingMasternodeSigChecks() {
+    std::deque<CPendingMasternodeEntry> entries;
+    std::deque<CPendingMasternodeWinner> winners;
+    {
+        LOCK(cs_pendingMasternodeSigs);
+        entries.swap(queuePendingEntries);
+        winners.swap(queuePendingWinners);
+    }
+
+    BOOST_FOREACH(const CPendingMasternodeEntry& e, entries) {
+        // verify with no locks held; misbehaving peers are punished afterwards
+        std::string vchPubKey(e.pubkey.begin(), e.pubkey.end());
+        std::string vchPubKey2(e.pubkey2.begin(), e.pubkey2.end());
+        std::string strMessage = e.addr.ToString() + boost::lexical_cast<std::string>(e.sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(e.protocolVersion);
+
+        std::string errorMessage = "";
+        std::vector<unsigned char> vchSig = e.vchSig;
+        if (!darkSendSigner.VerifyMessage(e.pubkey, vchSig, strMessage, errorMessage)) {
+            LogPrintf("dsee - Got bad masternode address signature\n");
+            LOCK(cs_main);
+            Misbehaving(e.idFrom, 100);
+            continue;
+        }
+
+        ApplyPendingMasternodeEntry(e);
+    }
+
+    BOOST_FOREACH(CPendingMasternodeWinner& w, winners) {
+        if (!masternodePayments.CheckSignature(w.winner)) {
+            LogPrintf("mnw - invalid signature\n");
+            LOCK(cs_main);
+            Misbehaving(w.idFrom, 100);
+            continue;
+        }
+
+        LOCK2(cs_main, cs_masternodes);
+        uint256 hash = w.winner.GetHash();
+        if (mapSeenMasternodeVotes.count(hash)) continue;
+        mapSeenMasternodeVotes.insert(make_pair(hash, w.winner));
+
+        if (masternodePayments.AddWinningMasternode(w.winner)) {
+            masternodePayments.Relay(w.winner);
         }
     }
 }
@@ -406,17 +565,23 @@ int CountMasternodesAboveProtocol(int protocolVersion) {
 
 
 int GetMasternodeByVin(CTxIn& vin) {
-    int i = 0;
     LOCK(cs_masternodes);
-    BOOST_FOREACH(CMasterNode& mn, vecMasternodes) {
-        if (mn.vin == vin) return i;
-        i++;
-    }
+    std::map<COutPoint, size_t>::iterator mi = mapMasternodeIndex.find(vin.prevout);
+    if (mi != mapMasternodeIndex.end()) return (int)(*mi).second;
 
     return -1;
 }
 
+static const std::vector<std::pair<unsigned int, int> >& GetCachedMasternodeScores(int64_t nBlockHeight, int minProtocol);
+
 int GetCurrentMasterNode(int mod, int64_t nBlockHeight, int minProtocol) {
+    if (mod == 1) {
+        // The ranked list is this same election already scored and sorted;
+        // reuse it instead of rescoring every masternode.
+        LOCK(cs_masternodes);
+        const std::vector<std::pair<unsigned int, int> >& vecScores = GetCachedMasternodeScores(nBlockHeight, minProtocol);
+        return vecScores.empty() ? -1 : vecScores[0].second;
+    }
     int i = 0;
     unsigned int score = 0;
     int winner = -1;
@@ -445,17 +610,23 @@ int GetCurrentMasterNode(int mod, int64_t nBlockHeight, int minProtocol) {
     return winner;
 }
 
-int GetMasternodeByRank(int findRank, int64_t nBlockHeight, int minProtocol) {
-    LOCK(cs_masternodes);
-    int i = 0;
+// Recompute the ranked (score, index) list only when something relevant
+// changed; winners processing and mnget replies otherwise re-sorted the whole
+// list for every block. Caller must hold cs_masternodes. The entries go stale
+// as masternodes expire, so a cached list is also dropped after a ping period.
+static const std::vector<std::pair<unsigned int, int> >& GetCachedMasternodeScores(int64_t nBlockHeight, int minProtocol) {
+    AssertLockHeld(cs_masternodes);
 
-    std::vector <pair<unsigned int, int>> vecMasternodeScores;
+    if (nCachedScoresHeight == nBlockHeight && nCachedScoresMinProtocol == minProtocol &&
+        nCachedScoresGeneration == nMasternodeListGeneration &&
+        GetTime() - nCachedScoresTime < MASTERNODE_PING_SECONDS)
+        return vecCachedMasternodeScores;
 
-    i = 0;
-    BOOST_FOREACH(CMasterNode mn, vecMasternodes) {
+    vecCachedMasternodeScores.clear();
+    int i = 0;
+    BOOST_FOREACH(CMasterNode& mn, vecMasternodes) {
         mn.Check();
-        if (mn.protocolVersion < minProtocol) continue;
-        if (!mn.IsEnabled()) {
+        if (mn.protocolVersion < minProtocol || !mn.IsEnabled()) {
             i++;
             continue;
         }
@@ -464,14 +635,25 @@ int GetMasternodeByRank(int findRank, int64_t nBlockHeight, int minProtocol) {
         unsigned int n2 = 0;
         memcpy(&n2, &n, sizeof(n2));
 
-        vecMasternodeScores.push_back(make_pair(n2, i));
+        vecCachedMasternodeScores.push_back(make_pair(n2, i));
         i++;
     }
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareValueOnly2());
+    sort(vecCachedMasternodeScores.rbegin(), vecCachedMasternodeScores.rend(), CompareValueOnly2());
+
+    nCachedScoresHeight = nBlockHeight;
+    nCachedScoresMinProtocol = minProtocol;
+    nCachedScoresGeneration = nMasternodeListGeneration;
+    nCachedScoresTime = GetTime();
+    return vecCachedMasternodeScores;
+}
+
+int GetMasternodeByRank(int findRank, int64_t nBlockHeight, int minProtocol) {
+    LOCK(cs_masternodes);
+    const std::vector<std::pair<unsigned int, int> >& vecMasternodeScores = GetCachedMasternodeScores(nBlockHeight, minProtocol);
 
     int rank = 0;
-    BOOST_FOREACH(PAIRTYPE(unsigned int, int) &s, vecMasternodeScores) {
+    BOOST_FOREACH(const PAIRTYPE(unsigned int, int) &s, vecMasternodeScores) {
         rank++;
         if (rank == findRank) return s.second;
     }
@@ -480,30 +662,13 @@ int GetMasternodeByRank(int findRank, int64_t nBlockHeight, int minProtocol) {
 }
 
 int GetMasternodeRank(CTxIn& vin, int64_t nBlockHeight, int minProtocol) {
-    //LOCK(cs_masternodes);
-    std::vector< pair<unsigned int, CTxIn> > vecMasternodeScores;
-
-    BOOST_FOREACH(CMasterNode & mn, vecMasternodes) {
-        mn.Check();
-
-        if (mn.protocolVersion < minProtocol) continue;
-        if (!mn.IsEnabled()) {
-            continue;
-        }
-
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        unsigned int n2 = 0;
-        memcpy(&n2, &n, sizeof(n2));
-
-        vecMasternodeScores.push_back(make_pair(n2, mn.vin));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareValueOnly());
+    LOCK(cs_masternodes);
+    const std::vector<std::pair<unsigned int, int> >& vecMasternodeScores = GetCachedMasternodeScores(nBlockHeight, minProtocol);
 
     unsigned int rank = 0;
-    BOOST_FOREACH(PAIRTYPE(unsigned int, CTxIn) &s, vecMasternodeScores) {
+    BOOST_FOREACH(const PAIRTYPE(unsigned int, int) &s, vecMasternodeScores) {
         rank++;
-        if (s.second == vin) {
+        if (vecMasternodes[s.second].vin.prevout == vin.prevout) {
             return rank;
         }
     }
@@ -655,23 +820,27 @@ uint64_t CMasternodePayments::CalculateScore(uint256 blockHash, CTxIn& vin) {
     return n4.Get64();
 }
 
+void CMasternodePayments::RebuildWinningIndex() {
+    mapWinningByHeight.clear();
+    for (size_t i = 0; i < vWinning.size(); i++)
+        mapWinningByHeight[vWinning[i].nBlockHeight] = i;
+}
+
 bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee) {
-    BOOST_FOREACH(CMasternodePaymentWinner& winner, vWinning) {
-        if (winner.nBlockHeight == nBlockHeight) {
-            payee = winner.payee;
-            return true;
-        }
+    std::map<int, size_t>::const_iterator mi = mapWinningByHeight.find(nBlockHeight);
+    if (mi != mapWinningByHeight.end()) {
+        payee = vWinning[(*mi).second].payee;
+        return true;
     }
 
     return false;
 }
 
 bool CMasternodePayments::GetWinningMasternode(int nBlockHeight, CTxIn& vinOut) {
-    BOOST_FOREACH(CMasternodePaymentWinner& winner, vWinning) {
-        if (winner.nBlockHeight == nBlockHeight) {
-            vinOut = winner.vin;
-            return true;
-        }
+    std::map<int, size_t>::const_iterator mi = mapWinningByHeight.find(nBlockHeight);
+    if (mi != mapWinningByHeight.end()) {
+        vinOut = vWinning[(*mi).second].vin;
+        return true;
     }
 
     return false;
@@ -685,30 +854,26 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
 
     winnerIn.score = CalculateScore(blockHash, winnerIn.vin);
 
-    bool foundBlock = false;
-    BOOST_FOREACH(CMasternodePaymentWinner& winner, vWinning) {
-        if (winner.nBlockHeight == winnerIn.nBlockHeight) {
-            foundBlock = true;
-            if (winner.score < winnerIn.score) {
-                winner.score = winnerIn.score;
-                winner.vin = winnerIn.vin;
-                winner.payee = winnerIn.payee;
-                winner.vchSig = winnerIn.vchSig;
-
-                return true;
-            }
+    std::map<int, size_t>::const_iterator mi = mapWinningByHeight.find(winnerIn.nBlockHeight);
+    if (mi != mapWinningByHeight.end()) {
+        CMasternodePaymentWinner& winner = vWinning[(*mi).second];
+        if (winner.score < winnerIn.score) {
+            winner.score = winnerIn.score;
+            winner.vin = winnerIn.vin;
+            winner.payee = winnerIn.payee;
+            winner.vchSig = winnerIn.vchSig;
+
+            return true;
         }
+        return false;
     }
 
     // if it's not in the vector
-    if (!foundBlock) {
-        vWinning.push_back(winnerIn);
-        mapSeenMasternodeVotes.insert(make_pair(winnerIn.GetHash(), winnerIn));
+    mapWinningByHeight[winnerIn.nBlockHeight] = vWinning.size();
+    vWinning.push_back(winnerIn);
+    mapSeenMasternodeVotes.insert(make_pair(winnerIn.GetHash(), winnerIn));
 
-        return true;
-    }
-
-    return false;
+    return true;
 }
 
 void CMasternodePayments::CleanPaymentList() {
@@ -722,6 +887,8 @@ void CMasternodePayments::CleanPaymentList() {
         if (chainActive.Height() - (*it).nBlockHeight > nLimit) {
             if (fDebug) LogPrintf("CMasternodePayments::CleanPaymentList - Removing old masternode payment - block %d\n", (*it).nBlockHeight);
             vWinning.erase(it);
+            // erase shifts everything after the removed entry
+            RebuildWinningIndex();
             break;
         }
     }
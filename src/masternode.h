@@ -54,7 +54,21 @@ extern map<int64_t, uint256> mapCacheBlockHashes;
 void ProcessMasternodeConnections();
 int CountMasternodesAboveProtocol(int protocolVersion);
 
+// Add to vecMasternodes and keep the prevout index in step (caller holds cs_masternodes)
+void AddMasternode(const CMasterNode& mn);
+// Rebuild the prevout index after entries were erased from vecMasternodes
+void RebuildMasternodeIndex();
+// Drop the cached ranked score list; call whenever the list or an entry's
+// eligibility changes so GetMasternodeRank/GetMasternodeByRank recompute
+void InvalidateMasternodeRanks();
+// Counter bumped by InvalidateMasternodeRanks; lets other caches tell
+// whether the masternode list has changed since they were built
+uint64_t GetMasternodeListGeneration();
+
 void ProcessMasternode(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, bool &isMasternodeCommand);
+// Drain the queue of dsee/mnw messages whose signatures still need checking;
+// called periodically from CheckDarkSendPool
+void ProcessPendingMasternodeSigChecks();
 
 //
 // The Masternode Class. For managing the darksend process. It contains the input of the 1000Lux, signature to prove
@@ -208,6 +222,12 @@ class CMasternodePayments
 {
 private:
     std::vector<CMasternodePaymentWinner> vWinning;
+    // height -> position in vWinning, so per-block payee checks don't rescan
+    // the whole winner list; maintained by AddWinningMasternode (the mnw
+    // path) and rebuilt when CleanPaymentList shifts the vector
+    std::map<int, size_t> mapWinningByHeight;
+
+    void RebuildWinningIndex();
     int nSyncedFromPeer;
     std::string strMasterPrivKey;
     std::string strTestPubKey;
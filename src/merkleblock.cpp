@@ -34,6 +34,24 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
     txn = CPartialMerkleTree(vHashes, vMatch);
 }
 
+CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter, const std::vector<uint256>& vTree)
+{
+    header = block.GetBlockHeader();
+
+    vector<bool> vMatch;
+    vMatch.reserve(block.vtx.size());
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        if (filter.IsRelevantAndUpdate(block.vtx[i])) {
+            vMatch.push_back(true);
+            vMatchedTxn.push_back(make_pair(i, block.vtx[i].GetHash()));
+        } else
+            vMatch.push_back(false);
+    }
+
+    txn = CPartialMerkleTree(block.vtx.size(), vTree, vMatch);
+}
+
 uint256 CPartialMerkleTree::CalcHash(int height, unsigned int pos, const std::vector<uint256>& vTxid)
 {
     if (height == 0) {
@@ -117,6 +135,45 @@ CPartialMerkleTree::CPartialMerkleTree(const std::vector<uint256>& vTxid, const
     TraverseAndBuild(nHeight, 0, vTxid, vMatch);
 }
 
+void CPartialMerkleTree::TraverseAndBuildCached(int height, unsigned int pos, const std::vector<uint256>& vTree, const std::vector<unsigned int>& vOffset, const std::vector<bool>& vMatch)
+{
+    // determine whether this node is the parent of at least one matched txid
+    bool fParentOfMatch = false;
+    for (unsigned int p = pos << height; p < (pos + 1) << height && p < nTransactions; p++)
+        fParentOfMatch |= vMatch[p];
+    // store as flag bit
+    vBits.push_back(fParentOfMatch);
+    if (height == 0 || !fParentOfMatch) {
+        // if at height 0, or nothing interesting below, look the hash up and stop
+        vHash.push_back(vTree[vOffset[height] + pos]);
+    } else {
+        // otherwise, don't store any hash, but descend into the subtrees
+        TraverseAndBuildCached(height - 1, pos * 2, vTree, vOffset, vMatch);
+        if (pos * 2 + 1 < CalcTreeWidth(height - 1))
+            TraverseAndBuildCached(height - 1, pos * 2 + 1, vTree, vOffset, vMatch);
+    }
+}
+
+CPartialMerkleTree::CPartialMerkleTree(unsigned int nTransactionsIn, const std::vector<uint256>& vTree, const std::vector<bool>& vMatch) : nTransactions(nTransactionsIn), fBad(false)
+{
+    // reset state
+    vBits.clear();
+    vHash.clear();
+
+    // calculate height of tree and the start of each level in the flattened tree
+    int nHeight = 0;
+    std::vector<unsigned int> vOffset;
+    vOffset.push_back(0);
+    while (CalcTreeWidth(nHeight) > 1) {
+        vOffset.push_back(vOffset[nHeight] + CalcTreeWidth(nHeight));
+        nHeight++;
+    }
+    assert(vOffset[nHeight] + CalcTreeWidth(nHeight) == vTree.size());
+
+    // traverse the partial tree
+    TraverseAndBuildCached(nHeight, 0, vTree, vOffset, vMatch);
+}
+
 CPartialMerkleTree::CPartialMerkleTree() : nTransactions(0), fBad(true) {}
 
 uint256 CPartialMerkleTree::ExtractMatches(std::vector<uint256>& vMatch)
@@ -74,6 +74,14 @@ protected:
     /** recursive function that traverses tree nodes, storing the data as bits and hashes */
     void TraverseAndBuild(int height, unsigned int pos, const std::vector<uint256>& vTxid, const std::vector<bool>& vMatch);
 
+    /**
+     * same as TraverseAndBuild, but node hashes are looked up in a
+     * precomputed full tree (flattened level by level, leaves first, as
+     * built by CBlock::BuildMerkleTree) instead of being recomputed;
+     * vOffset[height] is the index of the first node of that level.
+     */
+    void TraverseAndBuildCached(int height, unsigned int pos, const std::vector<uint256>& vTree, const std::vector<unsigned int>& vOffset, const std::vector<bool>& vMatch);
+
     /**
      * recursive function that traverses tree nodes, consuming the bits and hashes produced by TraverseAndBuild.
      * it returns the hash of the respective node.
@@ -108,6 +116,13 @@ public:
     /** Construct a partial merkle tree from a list of transaction id's, and a mask that selects a subset of them */
     CPartialMerkleTree(const std::vector<uint256>& vTxid, const std::vector<bool>& vMatch);
 
+    /**
+     * Construct from a precomputed full merkle tree (CBlock::BuildMerkleTree
+     * layout) so only the masked traversal runs; the tree can be shared
+     * across all peers requesting the same block.
+     */
+    CPartialMerkleTree(unsigned int nTransactionsIn, const std::vector<uint256>& vTree, const std::vector<bool>& vMatch);
+
     CPartialMerkleTree();
 
     /**
@@ -140,6 +155,12 @@ public:
      */
     CMerkleBlock(const CBlock& block, CBloomFilter& filter);
 
+    /**
+     * Same, but reuses a precomputed full merkle tree of the block
+     * (CBlock::BuildMerkleTree layout) instead of rebuilding it.
+     */
+    CMerkleBlock(const CBlock& block, CBloomFilter& filter, const std::vector<uint256>& vTree);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -15,6 +15,7 @@
 #include "hash.h"
 //#include "validation.h"
 #include "net.h"
+#include "perf.h"
 #include "policy/policy.h"
 #include "pow.h"
 #include "stake.h"
@@ -221,8 +222,33 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlockWithKey(CReserveKe
 }
 
 
+namespace
+{
+/**
+ * Cached transaction selection, replayed while the tip and the mempool are
+ * unchanged so the staker loop and getblocktemplate share one selection
+ * instead of each rerunning the full mempool walk every second. Only
+ * selections without contract transactions are cached: replaying a contract
+ * transaction would need the EVM re-run to reproduce the state roots.
+ */
+struct CCachedTxSelection {
+    CCriticalSection cs;
+    bool fValid;
+    uint256 hashTip;
+    unsigned int nTxUpdated;
+    bool fIncludeWitness;
+    std::vector<CTransaction> vtx;
+    std::vector<CAmount> vTxFees;
+    std::vector<int64_t> vTxSigOpsCost;
+
+    CCachedTxSelection() : fValid(false), nTxUpdated(0), fIncludeWitness(false) {}
+};
+CCachedTxSelection cachedSelection;
+} // anon namespace
+
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx, bool fProofOfStake, int64_t* pTotalFees, int32_t txProofTime, int32_t nTimeLimit)
 {
+    CPerfScope perfscope("CreateNewBlock");
     resetBlock();
 
     pblocktemplate.reset(new CBlockTemplate());
@@ -349,13 +375,55 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     dev::h256 oldHashStateRoot(globalState->rootHash());
     dev::h256 oldHashUTXORoot(globalState->rootHashUTXO());
-    addPriorityTxs(minGasPrice);
-    addPackageTxs(minGasPrice);
+
+    // Replay the cached selection when the tip and mempool are unchanged;
+    // a time-limited run may have truncated the selection, so never cache
+    // or replay one.
+    bool fUsedCache = false;
+    const bool fCacheable = (nTimeLimit == 0);
+    if (fCacheable) {
+        LOCK(cachedSelection.cs);
+        if (cachedSelection.fValid &&
+            cachedSelection.hashTip == pindexPrev->GetBlockHash() &&
+            cachedSelection.nTxUpdated == mempool.GetTransactionsUpdated() &&
+            cachedSelection.fIncludeWitness == fIncludeWitness) {
+            for (size_t i = 0; i < cachedSelection.vtx.size(); i++) {
+                pblock->vtx.push_back(cachedSelection.vtx[i]);
+                pblocktemplate->vTxFees.push_back(cachedSelection.vTxFees[i]);
+                pblocktemplate->vTxSigOpsCost.push_back(cachedSelection.vTxSigOpsCost[i]);
+                nFees += cachedSelection.vTxFees[i];
+                nBlockSigOpsCost += cachedSelection.vTxSigOpsCost[i];
+                ++nBlockTx;
+            }
+            fUsedCache = true;
+        }
+    }
+    if (!fUsedCache) {
+        addPriorityTxs(minGasPrice);
+        addPackageTxs(minGasPrice);
+    }
     pblock->hashStateRoot = uint256(h256Touint(dev::h256(globalState->rootHash())));
     pblock->hashUTXORoot = uint256(h256Touint(dev::h256(globalState->rootHashUTXO())));
     globalState->setRoot(oldHashStateRoot);
     globalState->setRootUTXO(oldHashUTXORoot);
 
+    if (fCacheable && !fUsedCache) {
+        const size_t nRewardTxs = fProofOfStake ? 2 : 1;
+        bool fHasContracts = false;
+        for (size_t i = nRewardTxs; i < pblock->vtx.size() && !fHasContracts; i++)
+            fHasContracts = pblock->vtx[i].HasCreateOrCall();
+        if (!fHasContracts) {
+            LOCK(cachedSelection.cs);
+            cachedSelection.hashTip = pindexPrev->GetBlockHash();
+            cachedSelection.nTxUpdated = mempool.GetTransactionsUpdated();
+            cachedSelection.fIncludeWitness = fIncludeWitness;
+            cachedSelection.vtx.assign(pblock->vtx.begin() + nRewardTxs, pblock->vtx.end());
+            cachedSelection.vTxFees.assign(pblocktemplate->vTxFees.begin() + 1, pblocktemplate->vTxFees.end());
+            cachedSelection.vTxSigOpsCost.assign(pblocktemplate->vTxSigOpsCost.begin() + 1, pblocktemplate->vTxSigOpsCost.end());
+            cachedSelection.fValid = true;
+        }
+    }
+
     //this should already be populated by AddBlock in case of contracts, but if no contracts
     //then it won't get populated
     RebuildRefundTransaction();
@@ -385,6 +453,105 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     return std::move(pblocktemplate);
 }
 
+bool BlockAssembler::AppendNewTransactions(CBlockTemplate* ptemplate)
+{
+    LOCK2(cs_main, mempool.cs);
+
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    if (!pindexPrev || ptemplate->block.hashPrevBlock != pindexPrev->GetBlockHash())
+        return false;
+    // Only PoW templates keep vTxFees/vTxSigOpsCost aligned with vtx
+    if (ptemplate->block.IsProofOfStake())
+        return false;
+
+    resetBlock();
+    pblock = &ptemplate->block;
+    nHeight = pindexPrev->nHeight + 1;
+    const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
+    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                      ? nMedianTimePast
+                      : pblock->GetBlockTime();
+    fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus());
+
+    LuxDGP luxDGP(globalState.get(), fGettingValuesDGP);
+    uint32_t blockSizeDGP = luxDGP.getBlockSize(nHeight);
+    nBlockMaxSize = blockSizeDGP ? blockSizeDGP : nBlockMaxSize;
+
+    // Rebuild the size/weight/sigops bookkeeping from the template; the
+    // resetBlock() starting values already reserve the coinbase space.
+    std::set<uint256> setInBlock;
+    for (size_t i = 0; i < pblock->vtx.size(); i++) {
+        const CTransaction& tx = pblock->vtx[i];
+        setInBlock.insert(tx.GetHash());
+        if (i == 0)
+            continue;
+        if (fNeedSizeAccounting)
+            nBlockSize += ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        nBlockWeight += GetTransactionCost(tx);
+        ++nBlockTx;
+        if (i < ptemplate->vTxSigOpsCost.size())
+            nBlockSigOpsCost += ptemplate->vTxSigOpsCost[i];
+        if (i < ptemplate->vTxFees.size())
+            nFees += ptemplate->vTxFees[i];
+    }
+
+    // Append eligible new transactions in ancestor-score order, parents
+    // before children. Contract transactions are skipped: executing them
+    // would change the state roots already baked into the template header.
+    int nAdded = 0;
+    CTxMemPool::indexed_transaction_set::index<ancestor_score_or_gas_price>::type& indexed_by_score = mempool.mapTx.get<ancestor_score_or_gas_price>();
+    CTxMemPool::indexed_transaction_set::index<ancestor_score_or_gas_price>::type::iterator mi = indexed_by_score.begin();
+    for (; mi != indexed_by_score.end() && !blockFinished; ++mi) {
+        CTxMemPool::txiter iter = mempool.mapTx.project<0>(mi);
+        const CTransaction& tx = iter->GetTx();
+        const uint256& txid = tx.GetHash();
+        if (setInBlock.count(txid))
+            continue;
+        if (tx.HasCreateOrCall())
+            continue;
+        // All in-mempool parents must already be in the block
+        bool fMissingParent = false;
+        BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+            if (!setInBlock.count(txin.prevout.hash) && mempool.exists(txin.prevout.hash)) {
+                fMissingParent = true;
+                break;
+            }
+        }
+        if (fMissingParent)
+            continue;
+        if (!TestForBlock(iter))
+            continue;
+
+        pblock->vtx.emplace_back(tx);
+        ptemplate->vTxFees.push_back(iter->GetFee());
+        ptemplate->vTxSigOpsCost.push_back(iter->GetSigOpCost());
+        ptemplate->vTxFees[0] -= iter->GetFee();
+        if (fNeedSizeAccounting)
+            nBlockSize += ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        nBlockWeight += iter->GetTxWeight();
+        ++nBlockTx;
+        nBlockSigOpsCost += iter->GetSigOpCost();
+        nFees += iter->GetFee();
+        setInBlock.insert(txid);
+        nAdded++;
+    }
+
+    if (!nAdded)
+        return true;
+
+    // The appended transactions change nothing the header commits to beyond
+    // the merkle root the miner recomputes anyway, but revalidate the whole
+    // block rather than trust that.
+    CValidationState state;
+    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        LogPrint("miner", "%s: TestBlockValidity failed after appending %d txs\n", __func__, nAdded);
+        return false;
+    }
+
+    LogPrint("miner", "AppendNewTransactions(): appended %d txs, total txs: %u fees: %ld sigops %d\n", nAdded, nBlockTx, nFees, nBlockSigOpsCost);
+    return true;
+}
+
 bool BlockAssembler::isStillDependent(CTxMemPool::txiter iter)
 {
     BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter))
@@ -755,16 +922,18 @@ void BlockAssembler::addPackageTxs(uint64_t minGasPrice)
     // and modifying them for their already included ancestors
     UpdatePackagesForAdded(inBlock, mapModifiedTx);
 
-    CTxMemPool::indexed_transaction_set::index<ancestor_score_or_gas_price>::type::iterator mi = mempool.mapTx.get<ancestor_score_or_gas_price>().begin();
+    // The packages index is consulted on every loop iteration; look it up once.
+    CTxMemPool::indexed_transaction_set::index<ancestor_score_or_gas_price>::type& indexed_by_score = mempool.mapTx.get<ancestor_score_or_gas_price>();
+    CTxMemPool::indexed_transaction_set::index<ancestor_score_or_gas_price>::type::iterator mi = indexed_by_score.begin();
     CTxMemPool::txiter iter;
-    while (mi != mempool.mapTx.get<ancestor_score_or_gas_price>().end() || !mapModifiedTx.empty())
+    while (mi != indexed_by_score.end() || !mapModifiedTx.empty())
     {
         if(nTimeLimit != 0 && GetAdjustedTime() >= nTimeLimit){
             //no more time to add transactions, just exit
             return;
         }
         // First try to find a new transaction in mapTx to evaluate.
-        if (mi != mempool.mapTx.get<ancestor_score_or_gas_price>().end() &&
+        if (mi != indexed_by_score.end() &&
             SkipMapTxEntry(mempool.mapTx.project<0>(mi), mapModifiedTx, failedTx)) {
             ++mi;
             continue;
@@ -775,7 +944,7 @@ void BlockAssembler::addPackageTxs(uint64_t minGasPrice)
         bool fUsingModified = false;
 
         modtxscoreiter modit = mapModifiedTx.get<ancestor_score_or_gas_price>().begin();
-        if (mi == mempool.mapTx.get<ancestor_score_or_gas_price>().end()) {
+        if (mi == indexed_by_score.end()) {
             // We're out of entries in mapTx; use the entry from mapModifiedTx
             iter = modit->iter;
             fUsingModified = true;
@@ -981,6 +1150,9 @@ void BlockAssembler::addPriorityTxs(uint64_t minGasPrice)
 
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
+    static CCriticalSection cs_extraNonce;
+    LOCK(cs_extraNonce);
+
     // Update nExtraNonce
     static uint256 hashPrevBlock;
     if (hashPrevBlock != pblock->hashPrevBlock)
@@ -995,7 +1167,23 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     assert(txCoinbase.vin[0].scriptSig.size() <= 100);
 
     pblock->vtx[0] = std::move(CTransaction(txCoinbase));
-    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+
+    // Only the coinbase changes between extranonce rolls, so keep the whole
+    // layer cache and just rehash the path for position 0 instead of
+    // rebuilding the tree every roll. The cache is invalidated whenever the
+    // rest of the transaction set differs from the one it was built for.
+    static std::vector<uint256> vCachedLeaves;
+    static CMerkleLayerCache cachedTree;
+    std::vector<uint256> leaves(pblock->vtx.size());
+    for (size_t i = 1; i < pblock->vtx.size(); i++)
+        leaves[i] = pblock->vtx[i].GetHash();
+    if (leaves.size() != vCachedLeaves.size() ||
+        !std::equal(leaves.begin() + 1, leaves.end(), vCachedLeaves.begin() + 1)) {
+        leaves[0] = pblock->vtx[0].GetHash();
+        cachedTree.Build(leaves);
+        vCachedLeaves = std::move(leaves);
+    }
+    pblock->hashMerkleRoot = cachedTree.UpdateLeaf(0, pblock->vtx[0].GetHash());
 }
 
 bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
@@ -249,6 +249,10 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true, bool fProofOfStake=false, int64_t* pTotalFees = 0, int32_t nTime=0, int32_t nTimeLimit=0);
     std::unique_ptr<CBlockTemplate> CreateNewBlockWithKey(CReserveKey& reservekey, bool fMineWitnessTx=true, bool fProofOfStake=false, int64_t* pTotalFees = 0, int32_t nTime=0, int32_t nTimeLimit=0);
+    /** Append eligible new (non-contract) mempool transactions to an existing
+     *  template that still builds on the current tip, instead of a full
+     *  reselection. Returns false if the caller should rebuild from scratch. */
+    bool AppendNewTransactions(CBlockTemplate* ptemplate);
 private:
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
@@ -14,10 +14,12 @@
 #include "addrman.h"
 #include "chainparams.h"
 #include "clientversion.h"
+#include "compress.h"
 #include "miner.h"
 #include "darksend.h"
 #include "primitives/transaction.h"
 #include "scheduler.h"
+#include "trace.h"
 #include "ui_interface.h"
 #include "wallet.h"
 #include "miner.h"
@@ -27,6 +29,16 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(__linux__)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define USE_KQUEUE
+#include <sys/event.h>
 #endif
 
 #ifdef USE_UPNP
@@ -37,6 +49,7 @@
 #endif
 
 #include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 // Dump addresses to peers.dat every 15 minutes (900s)
@@ -81,6 +94,7 @@ ServiceFlags nRelevantServices = NODE_NETWORK;
 bool fDiscover = true;
 bool fListen = true;
 bool fNetworkActive = true;
+bool fMasternodeRelayPriority = true;
 ServiceFlags nLocalServices = NODE_NETWORK;
 CCriticalSection cs_mapLocalHost;
 map<CNetAddr, LocalServiceInfo> mapLocalHost;
@@ -95,7 +109,8 @@ bool fAddressesInitialized = false;
 
 vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-map<CInv, CDataStream> mapRelay;
+map<CInv, CTransactionRef> mapRelay;
+map<CInv, CSerializeData> mapRelayMsg;
 deque<pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
@@ -357,6 +372,11 @@ uint64_t CNode::nTotalBytesSent = 0;
 CCriticalSection CNode::cs_totalBytesRecv;
 CCriticalSection CNode::cs_totalBytesSent;
 
+uint64_t CNode::nMaxOutboundLimit = 0;
+uint64_t CNode::nMaxOutboundTotalBytesSentInCycle = 0;
+uint64_t CNode::nMaxOutboundTimeframe = 60 * 60 * 24; // 1 day
+uint64_t CNode::nMaxOutboundCycleStartTime = 0;
+
 CNode* FindNode(const CNetAddr& ip)
 {
     vector<CNode*> vNodesCopy;
@@ -454,6 +474,8 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool darkSendMaste
             return NULL;
         }
 
+        TuneTcpSocket(hSocket, darkSendMaster);
+
         addrman.Attempt(addrConnect);
 
         // Add node
@@ -495,6 +517,10 @@ void CNode::CloseSocketDisconnect()
 
 void CNode::PushVersion()
 {
+    // The subversion string never changes at runtime; format it once instead
+    // of rebuilding it for every outbound attempt.
+    static const std::string strLocalSubVersion = FormatSubVersion(CLIENT_NAME, CLIENT_VERSION, std::vector<string>());
+
     int nBestHeight = g_signals.GetHeight().get_value_or(0);
 
     /// when NTP implemented, change to just nTime = GetAdjustedTime()
@@ -507,7 +533,7 @@ void CNode::PushVersion()
     else
         LogPrint("net", "send version message: version %d, blocks=%d, us=%s, peer=%d\n", PROTOCOL_VERSION, nBestHeight, addrMe.ToString(), id);
     PushMessage("version", PROTOCOL_VERSION, (uint64_t) nLocalServices, nTime, addrYou, addrMe,
-        nLocalHostNonce, FormatSubVersion(CLIENT_NAME, CLIENT_VERSION, std::vector<string>()), nBestHeight, true);
+        nLocalHostNonce, strLocalSubVersion, nBestHeight, true);
 }
 
 
@@ -515,15 +541,96 @@ banmap_t CNode::setBanned;
 CCriticalSection CNode::cs_setBanned;
 bool CNode::setBannedIsDirty;
 
+/** Immutable binary trie over banned subnets, rebuilt on every banlist
+ *  mutation and swapped in with an atomic shared_ptr. The accept path then
+ *  matches an address by walking at most prefix-length bits through a flat
+ *  node array - a few cache lines - without taking cs_setBanned at all.
+ *  Expired entries simply stop matching; SweepBanned still prunes the map. */
+namespace {
+struct CBannedTrie {
+    struct Node {
+        int32_t child[2];
+        int64_t nBanUntil; //!< 0 if no subnet terminates here
+
+        Node() : nBanUntil(0)
+        {
+            child[0] = child[1] = -1;
+        }
+    };
+    std::vector<Node> nodes;
+    bool fFallback; //!< a netmask was not a contiguous prefix; use the map scan
+
+    CBannedTrie() : fFallback(false)
+    {
+        nodes.push_back(Node()); // root
+    }
+
+    void Insert(const unsigned char (&network)[16], unsigned int prefixLen, int64_t nBanUntil)
+    {
+        int32_t cur = 0;
+        for (unsigned int bit = 0; bit < prefixLen && bit < 128; bit++) {
+            int b = (network[bit >> 3] >> (7 - (bit & 7))) & 1;
+            if (nodes[cur].child[b] < 0) {
+                nodes[cur].child[b] = (int32_t)nodes.size();
+                nodes.push_back(Node());
+            }
+            cur = nodes[cur].child[b];
+        }
+        if (nodes[cur].nBanUntil < nBanUntil)
+            nodes[cur].nBanUntil = nBanUntil;
+    }
+
+    bool Match(const CNetAddr& addr, int64_t now) const
+    {
+        if (!addr.IsValid())
+            return false;
+        int32_t cur = 0;
+        for (unsigned int bit = 0; bit < 128; bit++) {
+            if (nodes[cur].nBanUntil > now)
+                return true;
+            // GetByte(n) returns ip[15 - n]; walk network byte order, msb first.
+            int b = ((int)addr.GetByte(15 - (bit >> 3)) >> (7 - (bit & 7))) & 1;
+            cur = nodes[cur].child[b];
+            if (cur < 0)
+                return false;
+        }
+        return nodes[cur].nBanUntil > now;
+    }
+};
+
+std::shared_ptr<const CBannedTrie> pBannedTrie;
+
+//! Rebuild and publish the trie; caller holds cs_setBanned.
+void RebuildBannedTrie(const banmap_t& banned)
+{
+    std::shared_ptr<CBannedTrie> trie(new CBannedTrie());
+    for (banmap_t::const_iterator it = banned.begin(); it != banned.end(); it++) {
+        unsigned char network[16];
+        unsigned int prefixLen = 0;
+        if (!it->first.GetPrefix(network, prefixLen)) {
+            trie->fFallback = true;
+            break;
+        }
+        trie->Insert(network, prefixLen, it->second.nBanUntil);
+    }
+    std::atomic_store(&pBannedTrie, std::shared_ptr<const CBannedTrie>(trie));
+}
+} // namespace
+
 void CNode::ClearBanned()
 {
     LOCK(cs_setBanned);
     setBanned.clear();
     setBannedIsDirty = true;
+    RebuildBannedTrie(setBanned);
 }
 
 bool CNode::IsBanned(CNetAddr ip)
 {
+    std::shared_ptr<const CBannedTrie> trie = std::atomic_load(&pBannedTrie);
+    if (trie && !trie->fFallback)
+        return trie->Match(ip, GetTime());
+
     bool fResult = false;
     {
         LOCK(cs_setBanned);
@@ -576,6 +683,28 @@ void CNode::Ban(const CSubNet& subNet, const BanReason &banReason, int64_t banti
         setBanned[subNet] = banEntry;
 
     setBannedIsDirty = true;
+    RebuildBannedTrie(setBanned);
+}
+
+void CNode::BanList(const std::vector<CSubNet> &vSubNets, const BanReason &banReason, int64_t bantimeoffset, bool sinceUnixEpoch)
+{
+    CBanEntry banEntry(GetTime());
+    banEntry.banReason = banReason;
+    if (bantimeoffset <= 0)
+    {
+        bantimeoffset = GetArg("-bantime", 60*60*24); // Default 24-hour ban
+        sinceUnixEpoch = false;
+    }
+    banEntry.nBanUntil = (sinceUnixEpoch ? 0 : GetTime() )+bantimeoffset;
+
+    // One lock and one matcher rebuild for the whole feed.
+    LOCK(cs_setBanned);
+    BOOST_FOREACH (const CSubNet& subNet, vSubNets) {
+        if (setBanned[subNet].nBanUntil < banEntry.nBanUntil)
+            setBanned[subNet] = banEntry;
+    }
+    setBannedIsDirty = true;
+    RebuildBannedTrie(setBanned);
 }
 
 bool CNode::Unban(const CNetAddr &addr)
@@ -590,6 +719,7 @@ bool CNode::Unban(const CSubNet &subNet)
     if (setBanned.erase(subNet))
     {
         setBannedIsDirty = true;
+        RebuildBannedTrie(setBanned);
         return true;
     }
     return false;
@@ -606,6 +736,7 @@ void CNode::SetBanned(const banmap_t &banMap)
     LOCK(cs_setBanned);
     setBanned = banMap;
     setBannedIsDirty = true;
+    RebuildBannedTrie(setBanned);
 }
 
 void CNode::SweepBanned()
@@ -625,6 +756,7 @@ void CNode::SweepBanned()
         else
             ++it;
     }
+    RebuildBannedTrie(setBanned);
 }
 
 bool CNode::BannedSetIsDirty()
@@ -659,6 +791,25 @@ void CNode::AddWhitelistedRange(const CSubNet& subnet)
     vWhitelistedRange.push_back(subnet);
 }
 
+std::vector<CSubNet> CNode::vTrustedLeaderRange;
+CCriticalSection CNode::cs_vTrustedLeaderRange;
+
+bool CNode::IsTrustedLeaderRange(const CNetAddr& addr)
+{
+    LOCK(cs_vTrustedLeaderRange);
+    BOOST_FOREACH (const CSubNet& subnet, vTrustedLeaderRange) {
+        if (subnet.Match(addr))
+            return true;
+    }
+    return false;
+}
+
+void CNode::AddTrustedLeaderRange(const CSubNet& subnet)
+{
+    LOCK(cs_vTrustedLeaderRange);
+    vTrustedLeaderRange.push_back(subnet);
+}
+
 #undef X
 #define X(name) stats.name = name
 void CNode::copyStats(CNodeStats& stats)
@@ -728,13 +879,34 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
 
         if (msg.complete()) {
             msg.nTime = GetTimeMicros();
-            messageHandlerCondition.notify_one();
+            messageHandlerCondition.notify_all();
         }
     }
 
     return true;
 }
 
+char* CNode::RecvMsgWritePtr(unsigned int& nSpace)
+{
+    nSpace = 0;
+    if (vRecvMsg.empty() || vRecvMsg.back().complete() || !vRecvMsg.back().in_data)
+        return NULL;
+    // Leave oversized messages to ReceiveMsgBytes, which disconnects.
+    if (vRecvMsg.back().hdr.nMessageSize > MAX_PROTOCOL_MESSAGE_LENGTH)
+        return NULL;
+    return vRecvMsg.back().GetRecvPtr(nSpace);
+}
+
+void CNode::MarkBytesReceived(unsigned int nBytes)
+{
+    CNetMessage& msg = vRecvMsg.back();
+    msg.nDataPos += nBytes;
+    if (msg.complete()) {
+        msg.nTime = GetTimeMicros();
+        messageHandlerCondition.notify_all();
+    }
+}
+
 int CNetMessage::readHeader(const char* pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
@@ -781,12 +953,109 @@ int CNetMessage::readData(const char* pch, unsigned int nBytes)
     return nCopy;
 }
 
+char* CNetMessage::GetRecvPtr(unsigned int& nSpace)
+{
+    unsigned int nRemaining = hdr.nMessageSize - nDataPos;
+    if (nRemaining == 0) {
+        nSpace = 0;
+        return NULL;
+    }
+    if (vRecv.size() <= nDataPos) {
+        // Allocate up to 256 KiB ahead, but never more than the total message size.
+        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + 256 * 1024));
+    }
+    nSpace = vRecv.size() - nDataPos;
+    return &vRecv[nDataPos];
+}
+
+
+//! Maximum number of queued messages gathered into one vectored send
+static const int MAX_SEND_IOV = 64;
+
+#ifdef TCP_CORK
+static void SetSocketCork(SOCKET hSocket, bool fCork)
+{
+    int nVal = fCork ? 1 : 0;
+    setsockopt(hSocket, IPPROTO_TCP, TCP_CORK, (const char*)&nVal, sizeof(nVal));
+}
+#endif
 
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode* pnode)
 {
     std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
 
+#ifdef TCP_CORK
+    // With TCP_NODELAY set every send is pushed to the wire immediately;
+    // when the drain needs more than one gather list, cork across the
+    // syscalls so small control messages still share packets. Queues
+    // holding a latency-critical message (block/header relay, ping) skip
+    // the cork — nothing of theirs may sit in the kernel waiting.
+    const bool fCorked = !pnode->fSendUrgent && pnode->vSendMsg.size() > (size_t)MAX_SEND_IOV;
+    if (fCorked)
+        SetSocketCork(pnode->hSocket, true);
+#endif
+
+#ifndef WIN32
+    // Gather as many queued messages as possible into a single sendmsg(),
+    // so draining a queue of small messages costs one syscall instead of
+    // one syscall per message.
+    while (it != pnode->vSendMsg.end()) {
+        struct iovec iov[MAX_SEND_IOV];
+        int nIovs = 0;
+        unsigned int nOffset = pnode->nSendOffset;
+        for (std::deque<CSerializeData>::iterator jt = it; jt != pnode->vSendMsg.end() && nIovs < MAX_SEND_IOV; jt++) {
+            const CSerializeData& data = *jt;
+            assert(data.size() > nOffset);
+            iov[nIovs].iov_base = (void*)&data[nOffset];
+            iov[nIovs].iov_len = data.size() - nOffset;
+            nIovs++;
+            nOffset = 0; // only the first message can be partially sent already
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = nIovs;
+        ssize_t nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (nBytes > 0) {
+            pnode->nLastSend = GetTime();
+            pnode->nSendBytes += nBytes;
+            pnode->RecordBytesSent(nBytes);
+            // Pop the fully sent messages; any remainder becomes the offset
+            // into the first message still queued.
+            size_t nLeft = (size_t)nBytes;
+            while (it != pnode->vSendMsg.end()) {
+                const CSerializeData& data = *it;
+                size_t nUnsent = data.size() - pnode->nSendOffset;
+                if (nLeft < nUnsent) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nUnsent;
+                pnode->nSendOffset = 0;
+                pnode->nSendSize -= data.size();
+                it++;
+            }
+            if (pnode->nSendOffset != 0) {
+                // could not send the full batch; stop sending more
+                break;
+            }
+        } else {
+            if (nBytes < 0) {
+                // error
+                int nErr = WSAGetLastError();
+                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
+                    LogPrintf("socket send error %s\n", NetworkErrorString(nErr));
+                    pnode->CloseSocketDisconnect();
+                }
+            }
+            // couldn't send anything at all
+            break;
+        }
+    }
+#else
+    // WSASend would allow the same batching on Windows but needs the socket
+    // in overlapped mode; keep the one-send-per-message loop there.
     while (it != pnode->vSendMsg.end()) {
         const CSerializeData& data = *it;
         assert(data.size() > pnode->nSendOffset);
@@ -817,16 +1086,138 @@ void SocketSendData(CNode* pnode)
             break;
         }
     }
+#endif
+
+#ifdef TCP_CORK
+    // Uncorking pushes whatever the last send left short of a full segment.
+    if (fCorked && pnode->hSocket != INVALID_SOCKET)
+        SetSocketCork(pnode->hSocket, false);
+#endif
 
     if (it == pnode->vSendMsg.end()) {
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
+        pnode->fSendUrgent = false;
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
 }
 
 static list<CNode*> vNodesDisconnected;
 
+//! Whether ThreadSocketHandler ended up on the select() backend, whose
+//! FD_SETSIZE cap the admission checks below must then respect.
+static bool fSocketEventsSelectBackend = true;
+
+static bool ReverseCompareNodeMinPingTime(CNode* a, CNode* b)
+{
+    return a->nMinPingUsecTime > b->nMinPingUsecTime;
+}
+
+static bool ReverseCompareNodeLastRecv(CNode* a, CNode* b)
+{
+    return a->nLastRecv < b->nLastRecv;
+}
+
+static bool ReverseCompareNodeTimeConnected(CNode* a, CNode* b)
+{
+    return a->nTimeConnected > b->nTimeConnected;
+}
+
+static bool CompareNodeTimeConnected(CNode* a, CNode* b)
+{
+    return a->nTimeConnected < b->nTimeConnected;
+}
+
+/** Try to find a connection to evict when the inbound slots fill up.
+ *  Extreme care must be taken to avoid opening the node to attacker
+ *  triggered network partitioning: peers that score well on hard-to-fake
+ *  characteristics (netgroup diversity, round-trip time, recent traffic,
+ *  connection longevity) keep their slots, and the final victim is the
+ *  youngest member of the netgroup hogging the most of them.
+ */
+static bool AttemptToEvictConnection()
+{
+    std::vector<CNode*> vEvictionCandidates;
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* node, vNodes) {
+            if (!node->fInbound)
+                continue;
+            if (node->fDisconnect)
+                continue;
+            if (node->fWhitelisted)
+                continue;
+            // Quorum participants are worth more than the slot they occupy
+            if (node->fMasternode || node->fDarkSendMaster)
+                continue;
+            vEvictionCandidates.push_back(node);
+        }
+    }
+
+    if (vEvictionCandidates.empty())
+        return false;
+
+    // Protect the longest-connected peer from each of 4 distinct netgroups:
+    // an attacker confined to few netgroups cannot push these out.
+    {
+        std::set<std::vector<unsigned char> > setProtectedGroups;
+        std::vector<CNode*> vRemaining;
+        std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), CompareNodeTimeConnected);
+        BOOST_FOREACH (CNode* node, vEvictionCandidates) {
+            if (setProtectedGroups.size() < 4 && setProtectedGroups.insert(node->addr.GetGroup()).second)
+                continue;
+            vRemaining.push_back(node);
+        }
+        vEvictionCandidates = vRemaining;
+    }
+    if (vEvictionCandidates.empty())
+        return false;
+
+    // Protect the 8 peers with the lowest minimum ping time.
+    // An attacker cannot manipulate this metric without physically moving nodes closer to the target.
+    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), ReverseCompareNodeMinPingTime);
+    vEvictionCandidates.erase(vEvictionCandidates.end() - std::min(8, static_cast<int>(vEvictionCandidates.size())), vEvictionCandidates.end());
+    if (vEvictionCandidates.empty())
+        return false;
+
+    // Protect the 4 peers we heard from most recently: the ones actually feeding us data.
+    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), ReverseCompareNodeLastRecv);
+    vEvictionCandidates.erase(vEvictionCandidates.end() - std::min(4, static_cast<int>(vEvictionCandidates.size())), vEvictionCandidates.end());
+    if (vEvictionCandidates.empty())
+        return false;
+
+    // Protect the half of the remaining nodes which have been connected the longest.
+    // This replicates the non-eviction implicit behavior, and precludes attacks that start later.
+    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), ReverseCompareNodeTimeConnected);
+    vEvictionCandidates.erase(vEvictionCandidates.end() - static_cast<int>(vEvictionCandidates.size() / 2), vEvictionCandidates.end());
+    if (vEvictionCandidates.empty())
+        return false;
+
+    // Identify the netgroup with the most connections; evict its youngest member.
+    std::map<std::vector<unsigned char>, std::vector<CNode*> > mapAddrCounts;
+    BOOST_FOREACH (CNode* node, vEvictionCandidates)
+        mapAddrCounts[node->addr.GetGroup()].push_back(node);
+
+    size_t nMostConnections = 0;
+    int64_t nMostConnectionsTime = 0;
+    std::vector<unsigned char> naMostConnections;
+    for (std::map<std::vector<unsigned char>, std::vector<CNode*> >::iterator it = mapAddrCounts.begin(); it != mapAddrCounts.end(); ++it) {
+        // Candidates are sorted youngest-first, so front() is the youngest in each group
+        int64_t grouptime = it->second.front()->nTimeConnected;
+        if (it->second.size() > nMostConnections || (it->second.size() == nMostConnections && grouptime > nMostConnectionsTime)) {
+            nMostConnections = it->second.size();
+            nMostConnectionsTime = grouptime;
+            naMostConnections = it->first;
+        }
+    }
+
+    vEvictionCandidates = mapAddrCounts[naMostConnections];
+    CNode* pEvicted = vEvictionCandidates.front();
+    LogPrint("net", "evicting peer=%d to make room for a new inbound connection\n", pEvicted->GetId());
+    pEvicted->fDisconnect = true;
+    return true;
+}
+
 static void AcceptConnection(const ListenSocket& hListenSocket) {
 
     struct sockaddr_storage sockaddr;
@@ -834,8 +1225,7 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
     SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr *) &sockaddr, &len);
     CAddress addr;
     int nInbound = 0;
-    int nMaxOutbound = 0;
-    int nMaxInbound = nMaxConnections - (nMaxOutbound);
+    int nMaxInbound = nMaxConnections - MAX_OUTBOUND_CONNECTIONS;
 
     if (hSocket != INVALID_SOCKET)
         if (!addr.SetSockAddr((const struct sockaddr *) &sockaddr))
@@ -860,28 +1250,37 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket)) {
+    // The fd limits below only bind when the select() backend is in use;
+    // epoll and kqueue have no FD_SETSIZE cap.
+    if (fSocketEventsSelectBackend && !IsSelectableSocket(hSocket)) {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
         return;
     }
 
-    if (CNode::IsBanned(addr) && !whitelisted) {
-        LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
+    // Shed inbound load before ThreadSocketHandler's select() loop saturates:
+    // high fd numbers mean the fd sets are nearly full, and every pass over
+    // them then costs more than the marginal anonymous peer is worth. Keep a
+    // reserve for outbound peers, files and RPC; whitelisted peers may use it.
+    if (fSocketEventsSelectBackend && !whitelisted && (int)hSocket >= FD_SETSIZE - 64) {
+        LogPrint("net", "connection from %s dropped: fd headroom exhausted\n", addr.ToString());
         CloseSocket(hSocket);
         return;
     }
 
-    if (nInbound >= nMaxInbound) {
-        LogPrint("net", "connection from %s dropped (full)\n", addr.ToString());
+    if (CNode::IsBanned(addr) && !whitelisted) {
+        LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
         CloseSocket(hSocket);
         return;
     }
 
-    if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
-        LogPrint("net", "connection from %s dropped (full)\n", addr.ToString());
-        CloseSocket(hSocket);
-        return;
+    if (nInbound >= nMaxInbound) {
+        if (!AttemptToEvictConnection()) {
+            // No slot freed up: the new peer scored no better than what we have
+            LogPrint("net", "connection from %s dropped (full)\n", addr.ToString());
+            CloseSocket(hSocket);
+            return;
+        }
     }
 
     if (!fNetworkActive) {
@@ -890,6 +1289,8 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
+        TuneTcpSocket(hSocket, false);
+
         CNode *pnode = new CNode(hSocket, addr, "", true);
         pnode->AddRef();
         pnode->fWhitelisted = whitelisted;
@@ -899,8 +1300,293 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         }
     }
 
+//! Interest flags for CSocketEvents::Wait(). Error readiness is always reported.
+enum {
+    SOCKET_EVENT_RECV = (1 << 0),
+    SOCKET_EVENT_SEND = (1 << 1),
+};
+
+//! Readiness results from one CSocketEvents::Wait() pass.
+struct SocketEvents {
+    std::set<SOCKET> setRecv;
+    std::set<SOCKET> setSend;
+    std::set<SOCKET> setError;
+};
+
+/** Socket readiness backend for ThreadSocketHandler. The caller hands over
+ *  its full interest set on every pass; backends that keep kernel-side state
+ *  (epoll, kqueue) only issue syscalls for sockets whose interest changed,
+ *  so a pass costs O(changes + ready) instead of select()'s O(sockets) scan
+ *  and is not capped at FD_SETSIZE. */
+class CSocketEvents
+{
+public:
+    virtual ~CSocketEvents() {}
+    //! Wait up to nTimeoutUsec for readiness on the given sockets. On backend
+    //! failure every socket is reported recv-ready and false is returned, so
+    //! the caller still makes progress tearing down dead connections.
+    virtual bool Wait(const std::map<SOCKET, uint8_t>& mapInterest, int64_t nTimeoutUsec, SocketEvents& events) = 0;
+};
+
+class CSelectEvents : public CSocketEvents
+{
+public:
+    bool Wait(const std::map<SOCKET, uint8_t>& mapInterest, int64_t nTimeoutUsec, SocketEvents& events)
+    {
+        fd_set fdsetRecv;
+        fd_set fdsetSend;
+        fd_set fdsetError;
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        SOCKET hSocketMax = 0;
+        bool have_fds = false;
+
+        for (std::map<SOCKET, uint8_t>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it) {
+            if (it->second & SOCKET_EVENT_RECV)
+                FD_SET(it->first, &fdsetRecv);
+            if (it->second & SOCKET_EVENT_SEND)
+                FD_SET(it->first, &fdsetSend);
+            FD_SET(it->first, &fdsetError);
+            hSocketMax = max(hSocketMax, it->first);
+            have_fds = true;
+        }
+
+        struct timeval timeout;
+        timeout.tv_sec = nTimeoutUsec / 1000000;
+        timeout.tv_usec = nTimeoutUsec % 1000000;
+
+        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+            &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+
+        if (nSelect == SOCKET_ERROR) {
+            if (have_fds) {
+                int nErr = WSAGetLastError();
+                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+                for (std::map<SOCKET, uint8_t>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it)
+                    events.setRecv.insert(it->first);
+            }
+            MilliSleep(nTimeoutUsec / 1000);
+            return false;
+        }
+
+        for (std::map<SOCKET, uint8_t>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it) {
+            if (FD_ISSET(it->first, &fdsetRecv))
+                events.setRecv.insert(it->first);
+            if (FD_ISSET(it->first, &fdsetSend))
+                events.setSend.insert(it->first);
+            if (FD_ISSET(it->first, &fdsetError))
+                events.setError.insert(it->first);
+        }
+        return true;
+    }
+};
+
+#ifdef USE_EPOLL
+class CEpollEvents : public CSocketEvents
+{
+private:
+    int fdEpoll;
+    //! Interest currently registered with the kernel, to diff against.
+    std::map<SOCKET, uint8_t> mapRegistered;
+
+public:
+    CEpollEvents() : fdEpoll(epoll_create1(0)) {}
+    ~CEpollEvents()
+    {
+        if (fdEpoll != -1)
+            close(fdEpoll);
+    }
+    bool IsValid() const { return fdEpoll != -1; }
+
+    bool Wait(const std::map<SOCKET, uint8_t>& mapInterest, int64_t nTimeoutUsec, SocketEvents& events)
+    {
+        // Drop sockets we no longer care about. Closed sockets are removed by
+        // the kernel on their own, so EPOLL_CTL_DEL failures are harmless.
+        for (std::map<SOCKET, uint8_t>::iterator it = mapRegistered.begin(); it != mapRegistered.end();) {
+            if (mapInterest.count(it->first) == 0) {
+                epoll_ctl(fdEpoll, EPOLL_CTL_DEL, it->first, NULL);
+                mapRegistered.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+
+        // Add new sockets, update the ones whose interest changed. A closed
+        // and reopened fd may still sit in mapRegistered with stale flags, so
+        // fall through between ADD and MOD on EEXIST/ENOENT.
+        for (std::map<SOCKET, uint8_t>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it) {
+            std::map<SOCKET, uint8_t>::iterator reg = mapRegistered.find(it->first);
+            if (reg != mapRegistered.end() && reg->second == it->second)
+                continue;
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.data.fd = it->first;
+            if (it->second & SOCKET_EVENT_RECV)
+                ev.events |= EPOLLIN;
+            if (it->second & SOCKET_EVENT_SEND)
+                ev.events |= EPOLLOUT;
+            int op = (reg == mapRegistered.end()) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            if (epoll_ctl(fdEpoll, op, it->first, &ev) != 0) {
+                op = (op == EPOLL_CTL_ADD) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+                if (epoll_ctl(fdEpoll, op, it->first, &ev) != 0)
+                    continue;
+            }
+            mapRegistered[it->first] = it->second;
+        }
+
+        struct epoll_event ev[64];
+        int nReady = epoll_wait(fdEpoll, ev, 64, nTimeoutUsec / 1000);
+        if (nReady == -1) {
+            if (errno != EINTR) {
+                LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(errno));
+                for (std::map<SOCKET, uint8_t>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it)
+                    events.setRecv.insert(it->first);
+                MilliSleep(nTimeoutUsec / 1000);
+                return false;
+            }
+            return true;
+        }
+
+        for (int i = 0; i < nReady; i++) {
+            if (ev[i].events & (EPOLLIN | EPOLLHUP))
+                events.setRecv.insert(ev[i].data.fd);
+            if (ev[i].events & EPOLLOUT)
+                events.setSend.insert(ev[i].data.fd);
+            if (ev[i].events & EPOLLERR)
+                events.setError.insert(ev[i].data.fd);
+        }
+        return true;
+    }
+};
+#endif
+
+#ifdef USE_KQUEUE
+class CKqueueEvents : public CSocketEvents
+{
+private:
+    int fdKqueue;
+    std::map<SOCKET, uint8_t> mapRegistered;
+
+public:
+    CKqueueEvents() : fdKqueue(kqueue()) {}
+    ~CKqueueEvents()
+    {
+        if (fdKqueue != -1)
+            close(fdKqueue);
+    }
+    bool IsValid() const { return fdKqueue != -1; }
+
+    bool Wait(const std::map<SOCKET, uint8_t>& mapInterest, int64_t nTimeoutUsec, SocketEvents& events)
+    {
+        // Each readiness kind is its own kqueue filter; diff them separately.
+        std::vector<struct kevent> vChanges;
+        for (std::map<SOCKET, uint8_t>::iterator it = mapRegistered.begin(); it != mapRegistered.end();) {
+            std::map<SOCKET, uint8_t>::const_iterator want = mapInterest.find(it->first);
+            uint8_t wanted = (want == mapInterest.end()) ? 0 : want->second;
+            if (wanted == it->second) {
+                ++it;
+                continue;
+            }
+            struct kevent kev;
+            if ((it->second & SOCKET_EVENT_RECV) && !(wanted & SOCKET_EVENT_RECV)) {
+                EV_SET(&kev, it->first, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+                vChanges.push_back(kev);
+            }
+            if ((it->second & SOCKET_EVENT_SEND) && !(wanted & SOCKET_EVENT_SEND)) {
+                EV_SET(&kev, it->first, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+                vChanges.push_back(kev);
+            }
+            if (wanted == 0)
+                mapRegistered.erase(it++);
+            else {
+                it->second &= wanted;
+                ++it;
+            }
+        }
+        for (std::map<SOCKET, uint8_t>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it) {
+            uint8_t registered = mapRegistered.count(it->first) ? mapRegistered[it->first] : 0;
+            struct kevent kev;
+            if ((it->second & SOCKET_EVENT_RECV) && !(registered & SOCKET_EVENT_RECV)) {
+                EV_SET(&kev, it->first, EVFILT_READ, EV_ADD, 0, 0, NULL);
+                vChanges.push_back(kev);
+            }
+            if ((it->second & SOCKET_EVENT_SEND) && !(registered & SOCKET_EVENT_SEND)) {
+                EV_SET(&kev, it->first, EVFILT_WRITE, EV_ADD, 0, 0, NULL);
+                vChanges.push_back(kev);
+            }
+            mapRegistered[it->first] = it->second;
+        }
+
+        struct timespec timeout;
+        timeout.tv_sec = nTimeoutUsec / 1000000;
+        timeout.tv_nsec = (nTimeoutUsec % 1000000) * 1000;
+
+        struct kevent ev[64];
+        int nReady = kevent(fdKqueue, vChanges.empty() ? NULL : &vChanges[0], vChanges.size(), ev, 64, &timeout);
+        if (nReady == -1) {
+            if (errno != EINTR) {
+                LogPrintf("socket kevent error %s\n", NetworkErrorString(errno));
+                for (std::map<SOCKET, uint8_t>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it)
+                    events.setRecv.insert(it->first);
+                MilliSleep(nTimeoutUsec / 1000);
+                return false;
+            }
+            return true;
+        }
+
+        for (int i = 0; i < nReady; i++) {
+            if (ev[i].flags & EV_ERROR)
+                continue; // failed registration for a since-closed socket
+            if (ev[i].filter == EVFILT_READ)
+                events.setRecv.insert(ev[i].ident);
+            if (ev[i].filter == EVFILT_WRITE)
+                events.setSend.insert(ev[i].ident);
+            if (ev[i].flags & EV_EOF)
+                events.setError.insert(ev[i].ident);
+        }
+        return true;
+    }
+};
+#endif
+
+static CSocketEvents* CreateSocketEvents()
+{
+#ifdef USE_EPOLL
+    CEpollEvents* epollEvents = new CEpollEvents();
+    if (epollEvents->IsValid()) {
+        LogPrint("net", "using epoll socket events backend\n");
+        fSocketEventsSelectBackend = false;
+        return epollEvents;
+    }
+    delete epollEvents;
+#endif
+#ifdef USE_KQUEUE
+    CKqueueEvents* kqueueEvents = new CKqueueEvents();
+    if (kqueueEvents->IsValid()) {
+        LogPrint("net", "using kqueue socket events backend\n");
+        fSocketEventsSelectBackend = false;
+        return kqueueEvents;
+    }
+    delete kqueueEvents;
+#endif
+    LogPrint("net", "using select socket events backend\n");
+    return new CSelectEvents();
+}
+
+// Optionally pin a networking thread to one NUMA node (-numanodenet), keeping
+// socket handling and its buffers off the node reserved for validation.
+static void BindNetThreadNumaNode()
+{
+    int nNumaNode = GetArg("-numanodenet", -1);
+    if (nNumaNode >= 0 && !BindThreadToNumaNode(nNumaNode))
+        LogPrint("net", "%s: could not bind to NUMA node %d\n", __func__, nNumaNode);
+}
+
 void ThreadSocketHandler()
 {
+    BindNetThreadNumaNode();
+    boost::scoped_ptr<CSocketEvents> socketEvents(CreateSocketEvents());
     unsigned int nPrevNodeCount = 0;
     while (true) {
         //
@@ -975,24 +1661,12 @@ void ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
+        const int64_t nTimeoutUsec = 50000; // frequency to poll pnode->vSend
 
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
+        std::map<SOCKET, uint8_t> mapInterest;
 
-        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
+        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket)
+            mapInterest[hListenSocket.socket] |= SOCKET_EVENT_RECV;
 
         {
             // Use local variable to avoid the lock the whole processing here.
@@ -1005,9 +1679,7 @@ void ThreadSocketHandler()
             BOOST_FOREACH (CNode* pnode, vNodesCopy) {
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
+                mapInterest[pnode->hSocket] |= 0; // error readiness is always watched
 
                 // Implement the following logic:
                 // * If there is data to send, select() for sending data. As this only
@@ -1027,7 +1699,7 @@ void ThreadSocketHandler()
                 {
                     TRY_LOCK(pnode->cs_vSend, lockSend);
                     if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
+                        mapInterest[pnode->hSocket] |= SOCKET_EVENT_SEND;
                         continue;
                     }
                 }
@@ -1035,32 +1707,20 @@ void ThreadSocketHandler()
                     TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                     if (lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
                                         pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
+                        mapInterest[pnode->hSocket] |= SOCKET_EVENT_RECV;
                 }
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-            &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        SocketEvents events;
+        socketEvents->Wait(mapInterest, nTimeoutUsec, events);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
-        }
-
         //
         // Accept new connections
         //
         BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
+            if (hListenSocket.socket != INVALID_SOCKET && events.setRecv.count(hListenSocket.socket)) {
                 AcceptConnection(hListenSocket);
             }
         }
@@ -1085,15 +1745,27 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
+            if (events.setRecv.count(pnode->hSocket) || events.setError.count(pnode->hSocket)) {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv) {
                     {
+                        // If the current message is mid-payload, recv()
+                        // straight into its buffer and skip the stack-buffer
+                        // copy; otherwise fall back to the parsing path for
+                        // the header bytes.
+                        unsigned int nSpace = 0;
+                        char* pchDirect = pnode->RecvMsgWritePtr(nSpace);
                         // typical socket buffer is 8K-64K
                         char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                        int nBytes;
+                        if (pchDirect)
+                            nBytes = recv(pnode->hSocket, pchDirect, nSpace, MSG_DONTWAIT);
+                        else
+                            nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
                         if (nBytes > 0) {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+                            if (pchDirect)
+                                pnode->MarkBytesReceived(nBytes);
+                            else if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
                                 pnode->CloseSocketDisconnect();
                             pnode->nLastRecv = GetTime();
                             pnode->nRecvBytes += nBytes;
@@ -1121,7 +1793,7 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
+            if (events.setSend.count(pnode->hSocket)) {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
                     SocketSendData(pnode);
@@ -1320,10 +1992,18 @@ void ThreadDNSAddressSeed()
 
 void DumpAddresses()
 {
+    // Skip the dump (a wholesale serialization under addrman's lock) when
+    // nothing changed since the last successful write.
+    static int nLastSavedChanges = -1;
+    int nChanges = addrman.GetChangeCount();
+    if (nChanges == nLastSavedChanges)
+        return;
+
     int64_t nStart = GetTimeMillis();
 
     CAddrDB adb;
-    adb.Write(addrman);
+    if (adb.Write(addrman))
+        nLastSavedChanges = nChanges;
 
     LogPrint("net", "Flushed %d addresses to peers.dat  %dms\n",
         addrman.size(), GetTimeMillis() - nStart);
@@ -1338,6 +2018,8 @@ void DumpData()
         DumpBanlist();
         CNode::SetBannedSetDirty(false);
     }
+
+    DumpPeerPerf();
 }
 
 void static ProcessOneShot()
@@ -1359,6 +2041,7 @@ void static ProcessOneShot()
 }
 
 void ThreadOpenConnections() {
+    BindNetThreadNumaNode();
     // Connect to specific addresses
     if (mapArgs.count("-connect") && mapMultiArgs["-connect"].size() > 0) {
         for (int64_t nLoop = 0;; nLoop++) {
@@ -1395,10 +2078,8 @@ void ThreadOpenConnections() {
         }
 
         //
-        // Choose an address to connect to based on most recently seen
+        // Choose addresses to connect to based on most recently seen
         //
-        CAddress addrConnect;
-
         // Only connect out to one peer per network group (/16 for IPv4).
         // Do this here so we don't have to critsect vNodes inside mapAddresses critsect.
         int nOutbound = 0;
@@ -1418,8 +2099,15 @@ void ThreadOpenConnections() {
 
         int64_t nANow = GetAdjustedTime();
 
+        // Each connect can block for up to nConnectTimeout, so filling the
+        // outbound slots one address per loop iteration takes minutes after a
+        // restart. Select a small batch of candidates (still one per network
+        // group) and issue the blocking connects in parallel.
+        static const int nConnectBatch = std::max((int)GetArg("-connectbatch", 4), 1);
+        std::vector<CAddress> vConnect;
+
         int nTries = 0;
-        while (true) {
+        while ((int)vConnect.size() < nConnectBatch) {
             CAddress addr = addrman.Select();
 
             // if we selected an invalid address, restart
@@ -1452,12 +2140,40 @@ void ThreadOpenConnections() {
             if (addr.GetPort() != Params().GetDefaultPort() && nTries < 50)
                 continue;
 
-            addrConnect = addr;
-            break;
+            // prefer peers with a good recorded track record early in the scan
+            if (!IsPreferredPeer(addr) && nTries < 30)
+                continue;
+
+            vConnect.push_back(addr);
+            setConnected.insert(addr.GetGroup());
         }
 
-        if (addrConnect.IsValid())
-            OpenNetworkConnection(addrConnect, (int)setConnected.size() >= std::min(nMaxConnections - 1, 2), &grant, NULL, false);
+        if (!vConnect.empty()) {
+            bool fCountFailure = (int)setConnected.size() >= std::min(nMaxConnections - 1, 2);
+
+            // One semaphore grant per attempt: the grant held by this loop
+            // covers the first, the rest only go out if more slots are free.
+            std::deque<CSemaphoreGrant> vGrants(vConnect.size());
+            grant.MoveTo(vGrants[0]);
+            boost::thread_group connectGroup;
+            for (size_t i = 0; i < vConnect.size(); i++) {
+                if (i > 0) {
+                    CSemaphoreGrant tryGrant(*semOutbound, true);
+                    if (!tryGrant)
+                        break;
+                    tryGrant.MoveTo(vGrants[i]);
+                }
+                connectGroup.create_thread(boost::bind(&OpenNetworkConnection, vConnect[i], fCountFailure, &vGrants[i], (const char*)NULL, false, false));
+            }
+            // The grants and the thread group live on this stack frame, so
+            // the join must not be skipped by an interruption request; the
+            // workers time out within nConnectTimeout anyway.
+            {
+                boost::this_thread::disable_interruption noInterrupt;
+                connectGroup.join_all();
+            }
+            boost::this_thread::interruption_point();
+        }
     }
 }
 
@@ -1573,25 +2289,58 @@ bool OpenNetworkConnection(const CAddress& addrConnect, bool fCountFailure, CSem
 }
 
 
-void ThreadMessageHandler() {
-    boost::mutex condition_mutex;
-    boost::unique_lock<boost::mutex> lock(condition_mutex);
+// All message handler workers wait on messageHandlerCondition through the
+// same mutex; waiting on one condition variable through per-thread mutexes
+// is undefined behaviour.
+static boost::mutex csMessageHandlerWait;
+
+void WakeMessageHandler()
+{
+    messageHandlerCondition.notify_all();
+}
+
+//! Period of the full send sweep that drives inventory trickling, pings and
+//! sync scheduling; event wake-ups run targeted passes in between.
+static const int64_t MSGHANDLER_SWEEP_MILLIS = 100;
+
+void ThreadMessageHandler(size_t nWorker, size_t nWorkers) {
+    BindNetThreadNumaNode();
+    boost::unique_lock<boost::mutex> lock(csMessageHandlerWait, boost::defer_lock);
 
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
+    int64_t nLastFullSweep = 0;
     while (true) {
+        // A full sweep runs SendMessages for every peer in the shard (it
+        // drives trickling, pings and sync scheduling). Between sweeps an
+        // event wake-up only visits peers flagged by fSendReady, so idle
+        // peers cost nothing and queued blocks go out without waiting for
+        // the polling quantum.
+        int64_t nNow = GetTimeMillis();
+        bool fFullSweep = nNow - nLastFullSweep >= MSGHANDLER_SWEEP_MILLIS;
+        if (fFullSweep)
+            nLastFullSweep = nNow;
+
         vector<CNode*> vNodesCopy;
         {
             //LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
+            // Shard peers across the handler workers by node id, so one
+            // peer feeding us slow-to-process messages (e.g. a masternode
+            // pushing mnw payloads) only stalls its own shard. cs_main is
+            // taken inside the individual message handlers, so work that
+            // needs it is still serialized in a consistent lock order.
+            BOOST_FOREACH (CNode* pnode, vNodes) {
+                if ((size_t)pnode->GetId() % nWorkers == nWorker)
+                    vNodesCopy.push_back(pnode);
+            }
         }
 
         BOOST_FOREACH (CNode* pnode, vNodesCopy) {
             pnode->AddRef();
-        }      
+        }
 
         // Poll the connected nodes for messages
         CNode* pnodeTrickle = NULL;
-        if (!vNodesCopy.empty())
+        if (fFullSweep && !vNodesCopy.empty())
             pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
 
         bool fSleep = true;
@@ -1617,10 +2366,17 @@ void ThreadMessageHandler() {
             boost::this_thread::interruption_point();
 
             // Send messages
-            {
+            if (fFullSweep || pnode->fSendReady.exchange(false)) {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
-                    g_signals.SendMessages(pnode, pnode == pnodeTrickle || pnode->fWhitelisted);
+                    // Masternode peers skip the trickle: darksend/instantx
+                    // quorum rounds are bounded by inventory latency and the
+                    // participants already know each other, so there is no
+                    // privacy to protect between them.
+                    g_signals.SendMessages(pnode, pnode == pnodeTrickle || pnode->fWhitelisted ||
+                                                  (fMasternodeRelayPriority && (pnode->fMasternode || pnode->fDarkSendMaster)));
+                else
+                    pnode->fSendReady = true; // don't lose the edge
             }
             boost::this_thread::interruption_point();
         }
@@ -1630,8 +2386,14 @@ void ThreadMessageHandler() {
                 pnode->Release();
         }
 
-        if (fSleep)
-            messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(100));
+        if (fSleep) {
+            int64_t nWait = nLastFullSweep + MSGHANDLER_SWEEP_MILLIS - GetTimeMillis();
+            if (nWait < 1)
+                nWait = 1;
+            lock.lock();
+            messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(nWait));
+            lock.unlock();
+        }
     }
 }
 
@@ -1800,6 +2562,9 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler) {
     CNode::SetBannedSetDirty(false); //no need to write down just read or nonexistent data
     CNode::SweepBanned(); //sweap out unused entries
 
+    // peer quality records from previous sessions
+    LoadPeerPerf();
+
     LogPrintf("Loaded %i addresses from peers.dat  %dms\n",
         addrman.size(), GetTimeMillis() - nStart);
     fAddressesInitialized = true;
@@ -1836,12 +2601,15 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler) {
     // Initiate outbound connections
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
-    // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    // Process messages, sharding peers by node id across several workers
+    int nMsgHandlers = std::max<int>(1, std::min<int>(MAX_MSGHANDLER_THREADS, GetArg("-msghandlerthreads", DEFAULT_MSGHANDLER_THREADS)));
+    for (int i = 0; i < nMsgHandlers; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msghand",
+            boost::function<void()>(boost::bind(&ThreadMessageHandler, (size_t)i, (size_t)nMsgHandlers))));
 
     // Dump network addresses every 900 secs
     // The second input is milliseconds. So, we must re-calculate the input time interval
-    scheduler.scheduleEvery(&DumpData, DUMP_ADDRESSES_INTERVAL * 1000);
+    scheduler.scheduleEvery(&DumpData, DUMP_ADDRESSES_INTERVAL * 1000, "addrman-dump", CScheduler::PRIO_LOW, 2000);
 
     if (GetBoolArg("-staking", DEFAULT_STAKE) && pwalletMain) {
 #if 1
@@ -1931,25 +2699,25 @@ void CExplicitNetCleanup::callCleanup() {
 }
 
 void RelayTransaction(const CTransaction& tx) {
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss.reserve(10000);
-    ss << tx;
-    RelayTransaction(tx, ss);
+    RelayTransaction(MakeTransactionRef(tx));
 }
 
-void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
+void RelayTransaction(const CTransactionRef& ptx)
 {
+    const CTransaction& tx = *ptx;
     CInv inv(MSG_TX, tx.GetHash());
     {
         LOCK(cs_mapRelay);
         // Expire old relay messages
         while (!vRelayExpiration.empty() && vRelayExpiration.front().first < GetTime()) {
             mapRelay.erase(vRelayExpiration.front().second);
+            mapRelayMsg.erase(vRelayExpiration.front().second);
             vRelayExpiration.pop_front();
         }
 
-        // Save original serialized message so newer versions are preserved
-        mapRelay.insert(std::make_pair(inv, ss));
+        // Keep a shared reference to the transaction itself; getdata
+        // serializes it per peer instead of buffering a copy here.
+        mapRelay.insert(std::make_pair(inv, ptx));
         vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
     }
 
@@ -1959,12 +2727,15 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
         vNodesCopy = vNodes;
     }
     unsigned nRelayed = 0;
+    // Parse the scripts once, then test the extracted elements against
+    // every peer's filter.
+    CTxMatchCandidates cand(tx);
     BOOST_FOREACH (CNode* pnode, vNodesCopy) {
         if (!pnode->fRelayTxes)
             continue;
         if (pnode->nVersion >= ActiveProtocol()) {
             LOCK(pnode->cs_filter);
-            if (pnode->pfilter==nullptr || pnode->pfilter->IsRelevantAndUpdate(tx)) {
+            if (pnode->pfilter==nullptr || pnode->pfilter->IsRelevantAndUpdate(tx, cand)) {
                 pnode->PushInventory(inv);
                 ++nRelayed;
             }
@@ -1973,6 +2744,7 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
     if (nRelayed == 0) {
         LogPrintf("%s: tx %s not relayed\n", __func__, tx.GetHash().GetHex());
     }
+    TraceTxSpan("relay", tx.GetHash());
 }
 
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll)
@@ -2126,6 +2898,70 @@ void CNode::RecordBytesSent(uint64_t bytes)
 {
     LOCK(cs_totalBytesSent);
     nTotalBytesSent += bytes;
+
+    uint64_t now = GetTime();
+    if (nMaxOutboundCycleStartTime + nMaxOutboundTimeframe < now) {
+        // timeframe expired, reset cycle
+        nMaxOutboundCycleStartTime = now;
+        nMaxOutboundTotalBytesSentInCycle = 0;
+    }
+
+    // TODO, exclude whitebind peers
+    nMaxOutboundTotalBytesSentInCycle += bytes;
+}
+
+void CNode::SetMaxOutboundTarget(uint64_t limit)
+{
+    LOCK(cs_totalBytesSent);
+    nMaxOutboundLimit = limit;
+}
+
+uint64_t CNode::GetMaxOutboundTarget()
+{
+    LOCK(cs_totalBytesSent);
+    return nMaxOutboundLimit;
+}
+
+uint64_t CNode::GetMaxOutboundTimeLeftInCycle()
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return 0;
+
+    if (nMaxOutboundCycleStartTime == 0)
+        return nMaxOutboundTimeframe;
+
+    uint64_t cycleEndTime = nMaxOutboundCycleStartTime + nMaxOutboundTimeframe;
+    uint64_t now = GetTime();
+    return (cycleEndTime < now) ? 0 : cycleEndTime - now;
+}
+
+bool CNode::OutboundTargetReached(bool fHistoricalBlockServingLimit)
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return false;
+
+    if (fHistoricalBlockServingLimit) {
+        // Keep a large enough buffer to at least relay each block once to
+        // every peer; historical serving stops well before the hard limit.
+        uint64_t nBuffer = MAX_BLOCK_SIZE * GetArg("-maxconnections", 125);
+        if (nBuffer >= nMaxOutboundLimit ||
+            nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit - nBuffer)
+            return true;
+    } else if (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit)
+        return true;
+
+    return false;
+}
+
+uint64_t CNode::GetOutboundTargetBytesLeft()
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return 0;
+
+    return (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit) ? 0 : nMaxOutboundLimit - nMaxOutboundTotalBytesSentInCycle;
 }
 
 uint64_t CNode::GetTotalBytesRecv()
@@ -2178,6 +3014,13 @@ void CNode::Fuzz(int nChance)
 // CAddrDB
 //
 
+//! Marker byte after the network magic of a peers.dat whose addrman payload
+//! is deflated. Distinct from the addrman serialization versions (0 and 1),
+//! so legacy uncompressed files still load.
+static const unsigned char ADDRDB_DEFLATED_MARKER = 0xAD;
+//! Sanity bound when inflating a peers.dat payload.
+static const size_t MAX_ADDRDB_INFLATED_SIZE = 64 * 1024 * 1024;
+
 CAddrDB::CAddrDB()
 {
     pathAddr = GetDataDir() / "peers.dat";
@@ -2190,10 +3033,21 @@ bool CAddrDB::Write(const CAddrMan& addr)
     GetRandBytes((unsigned char*)&randv, sizeof(randv));
     std::string tmpfn = strprintf("peers.dat.%04x", randv);
 
-    // serialize addresses, checksum data up to that point, then append csum
+    // serialize addresses, deflate the payload (bucketed address records are
+    // highly repetitive, netgroup prefixes and service bits in particular),
+    // checksum data up to that point, then append csum
+    CDataStream ssAddrMan(SER_DISK, CLIENT_VERSION);
+    ssAddrMan << addr;
+    std::vector<unsigned char> vchPayload(ssAddrMan.begin(), ssAddrMan.end());
+    std::vector<unsigned char> vchDeflated;
     CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
     ssPeers << FLATDATA(Params().MessageStart());
-    ssPeers << addr;
+    if (DeflateData(vchPayload, vchDeflated) && vchDeflated.size() < vchPayload.size()) {
+        ssPeers << ADDRDB_DEFLATED_MARKER;
+        ssPeers << vchDeflated;
+    } else {
+        ssPeers << addr;
+    }
     uint256 hash = Hash(ssPeers.begin(), ssPeers.end());
     ssPeers << hash;
 
@@ -2259,8 +3113,21 @@ bool CAddrDB::Read(CAddrMan& addr)
         if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
             return error("%s : Invalid network magic number", __func__);
 
-        // de-serialize address data into one CAddrMan object
-        ssPeers >> addr;
+        // de-serialize address data into one CAddrMan object, inflating the
+        // payload first if this file was written deflated (legacy files keep
+        // the raw addrman serialization here)
+        if (!ssPeers.empty() && (unsigned char)*ssPeers.begin() == ADDRDB_DEFLATED_MARKER) {
+            unsigned char chMarker;
+            std::vector<unsigned char> vchDeflated;
+            ssPeers >> chMarker >> vchDeflated;
+            std::vector<unsigned char> vchPayload;
+            if (!InflateData(vchDeflated, vchPayload, MAX_ADDRDB_INFLATED_SIZE))
+                return error("%s : Failed to inflate address data", __func__);
+            CDataStream ssAddrMan(vchPayload, SER_DISK, CLIENT_VERSION);
+            ssAddrMan >> addr;
+        } else {
+            ssPeers >> addr;
+        }
     } catch (std::exception& e) {
         return error("%s : Deserialize or I/O error - %s", __func__, e.what());
     }
@@ -2296,16 +3163,21 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
+    fSendUrgent = false;
     hashContinue = 0;
     nStartingHeight = -1;
     fGetAddr = false;
+    fSentAddr = false;
     fRelayTxes = false;
+    fSendReady = true;
     setInventoryKnown.max_size(SendBufferSize() / 1000);
     pfilter = new CBloomFilter();
     nPingNonceSent = 0;
     nPingUsecStart = 0;
     nPingUsecTime = 0;
+    nMinPingUsecTime = std::numeric_limits<int64_t>::max();
     fPingQueued = false;
+    nNextMempoolSync = 0;
     fDarkSendMaster = false;
 
     {
@@ -2365,10 +3237,21 @@ void CNode::AskFor(const CInv& inv)
     mapAskFor.insert(std::make_pair(nRequestTime, inv));
 }
 
+//! Message classes whose delivery latency matters more than packing
+//! efficiency; queues holding one are never corked by SocketSendData.
+static bool IsLatencyCriticalCommand(const char* pszCommand)
+{
+    return strcmp(pszCommand, "block") == 0 || strcmp(pszCommand, "headers") == 0 ||
+           strcmp(pszCommand, "cmpctblock") == 0 || strcmp(pszCommand, "blocktxn") == 0 ||
+           strcmp(pszCommand, "ping") == 0 || strcmp(pszCommand, "pong") == 0;
+}
+
 void CNode::BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend)
 {
     ENTER_CRITICAL_SECTION(cs_vSend);
     assert(ssSend.size() == 0);
+    if (IsLatencyCriticalCommand(pszCommand))
+        fSendUrgent = true;
     ssSend << CMessageHeader(pszCommand, 0);
     LogPrint("net", "sending: %s ", SanitizeString(pszCommand));
 }
@@ -2422,6 +3305,39 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
 
+void BuildNetMessage(CSerializeData& msg, const std::string& strCommand, const CDataStream& payload)
+{
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    ssHeader << CMessageHeader(strCommand.c_str(), payload.size());
+
+    // Set the checksum (the header serializes with it zeroed)
+    uint256 hash = Hash(payload.begin(), payload.end());
+    unsigned int nChecksum = 0;
+    memcpy(&nChecksum, &hash, sizeof(nChecksum));
+    memcpy((char*)&ssHeader[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+
+    msg.clear();
+    msg.reserve(ssHeader.size() + payload.size());
+    msg.insert(msg.end(), ssHeader.begin(), ssHeader.end());
+    msg.insert(msg.end(), payload.begin(), payload.end());
+}
+
+void CNode::PushSharedMessage(const CSerializeData& msg)
+{
+    if (mapArgs.count("-dropmessagestest") && GetRand(GetArg("-dropmessagestest", 2)) == 0) {
+        LogPrint("net", "dropmessages DROPPING SEND MESSAGE\n");
+        return;
+    }
+
+    LOCK(cs_vSend);
+    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), msg);
+    nSendSize += (*it).size();
+
+    // If write queue empty, attempt "optimistic write"
+    if (it == vSendMsg.begin())
+        SocketSendData(this);
+}
+
 //
 // CBanListDB
 //
@@ -2537,3 +3453,197 @@ void DumpBanlist()
     LogPrint("net", "Flushed %d banned node ips/subnets to banlist.dat  %dms\n",
              banmap.size(), GetTimeMillis() - nStart);
 }
+
+//
+// Peer performance records
+//
+
+static CCriticalSection cs_peerPerf;
+static peerperfmap_t mapPeerPerf;
+static const size_t MAX_PEER_PERF_RECORDS = 5000;
+
+static CPeerPerfRecord& PeerPerfEntry(const CNetAddr& addr)
+{
+    AssertLockHeld(cs_peerPerf);
+    if (mapPeerPerf.size() >= MAX_PEER_PERF_RECORDS && !mapPeerPerf.count(addr)) {
+        // Evict the record that has gone unused the longest.
+        peerperfmap_t::iterator itOldest = mapPeerPerf.begin();
+        for (peerperfmap_t::iterator it = mapPeerPerf.begin(); it != mapPeerPerf.end(); ++it) {
+            if (it->second.nLastUpdate < itOldest->second.nLastUpdate)
+                itOldest = it;
+        }
+        mapPeerPerf.erase(itOldest);
+    }
+    CPeerPerfRecord& record = mapPeerPerf[addr];
+    record.nLastUpdate = GetTime();
+    return record;
+}
+
+void RecordPeerBlockLatency(const CNetAddr& addr, int64_t nMillis)
+{
+    LOCK(cs_peerPerf);
+    CPeerPerfRecord& record = PeerPerfEntry(addr);
+    record.nBlocksDelivered++;
+    record.nBlockLatencyTotalMs += nMillis;
+}
+
+void RecordPeerInv(const CNetAddr& addr, bool fUseful)
+{
+    LOCK(cs_peerPerf);
+    CPeerPerfRecord& record = PeerPerfEntry(addr);
+    record.nTotalInvs++;
+    if (fUseful)
+        record.nUsefulInvs++;
+}
+
+void RecordPeerStall(const CNetAddr& addr)
+{
+    LOCK(cs_peerPerf);
+    PeerPerfEntry(addr).nStalls++;
+}
+
+bool IsPreferredPeer(const CNetAddr& addr)
+{
+    LOCK(cs_peerPerf);
+    peerperfmap_t::const_iterator it = mapPeerPerf.find(addr);
+    if (it == mapPeerPerf.end())
+        return true; // no record: explore
+    const CPeerPerfRecord& record = it->second;
+
+    // A peer that stalls us once per ten delivered blocks is a liability.
+    if (record.nStalls > 0 && record.nBlocksDelivered < record.nStalls * 10)
+        return false;
+
+    // Demand a reasonable delivery latency once there is enough history.
+    if (record.nBlocksDelivered >= 5 &&
+        record.nBlockLatencyTotalMs / record.nBlocksDelivered > 5000)
+        return false;
+
+    // A peer whose announcements are nearly all stale wastes our bandwidth.
+    if (record.nTotalInvs >= 100 && record.nUsefulInvs * 20 < record.nTotalInvs)
+        return false;
+
+    return true;
+}
+
+CPeerPerfDB::CPeerPerfDB()
+{
+    pathPeerPerf = GetDataDir() / "peerperf.dat";
+}
+
+bool CPeerPerfDB::Write(const peerperfmap_t& mapPerf)
+{
+    // Generate random temporary filename
+    unsigned short randv = 0;
+    GetRandBytes((unsigned char*)&randv, sizeof(randv));
+    std::string tmpfn = strprintf("peerperf.dat.%04x", randv);
+
+    // serialize records, checksum data up to that point, then append csum
+    CDataStream ssPerf(SER_DISK, CLIENT_VERSION);
+    ssPerf << FLATDATA(Params().MessageStart());
+    ssPerf << mapPerf;
+    uint256 hash = Hash(ssPerf.begin(), ssPerf.end());
+    ssPerf << hash;
+
+    // open temp output file, and associate with CAutoFile
+    boost::filesystem::path pathTmp = GetDataDir() / tmpfn;
+    FILE* file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathTmp.string());
+
+    // Write and commit header, data
+    try {
+        fileout << ssPerf;
+    } catch (const std::exception& e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    // replace existing peerperf.dat, if any, with new peerperf.dat.XXXX
+    if (!RenameOver(pathTmp, pathPeerPerf))
+        return error("%s: Rename-into-place failed", __func__);
+
+    return true;
+}
+
+bool CPeerPerfDB::Read(peerperfmap_t& mapPerf)
+{
+    // open input file, and associate with CAutoFile
+    FILE* file = fopen(pathPeerPerf.string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathPeerPerf.string());
+
+    // use file size to size memory buffer
+    uint64_t fileSize = boost::filesystem::file_size(pathPeerPerf);
+    uint64_t dataSize = 0;
+    // Don't try to resize to a negative number if file is small
+    if (fileSize >= sizeof(uint256))
+        dataSize = fileSize - sizeof(uint256);
+    vector<unsigned char> vchData;
+    vchData.resize(dataSize);
+    uint256 hashIn;
+
+    // read data and checksum from file
+    try {
+        filein.read((char*)&vchData[0], dataSize);
+        filein >> hashIn;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    filein.fclose();
+
+    CDataStream ssPerf(vchData, SER_DISK, CLIENT_VERSION);
+
+    // verify stored checksum matches input data
+    uint256 hashTmp = Hash(ssPerf.begin(), ssPerf.end());
+    if (hashIn != hashTmp)
+        return error("%s: Checksum mismatch, data corrupted", __func__);
+
+    unsigned char pchMsgTmp[4];
+    try {
+        // de-serialize file header (network specific magic number) and ..
+        ssPerf >> FLATDATA(pchMsgTmp);
+
+        // ... verify the network matches ours
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            return error("%s: Invalid network magic number", __func__);
+
+        // de-serialize the performance records
+        ssPerf >> mapPerf;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
+
+void DumpPeerPerf()
+{
+    int64_t nStart = GetTimeMillis();
+
+    CPeerPerfDB perfdb;
+    peerperfmap_t mapPerf;
+    {
+        LOCK(cs_peerPerf);
+        mapPerf = mapPeerPerf;
+    }
+    perfdb.Write(mapPerf);
+
+    LogPrint("net", "Flushed %d peer performance records to peerperf.dat  %dms\n",
+             mapPerf.size(), GetTimeMillis() - nStart);
+}
+
+void LoadPeerPerf()
+{
+    CPeerPerfDB perfdb;
+    peerperfmap_t mapPerf;
+    if (!perfdb.Read(mapPerf)) {
+        LogPrintf("Invalid or missing peerperf.dat; recreating\n");
+        return;
+    }
+    LOCK(cs_peerPerf);
+    mapPeerPerf.swap(mapPerf);
+}
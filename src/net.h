@@ -12,6 +12,7 @@
 #include "limitedmap.h"
 #include "mruset.h"
 #include "netbase.h"
+#include "primitives/transaction.h"
 #include "protocol.h"
 #include "random.h"
 #include "streams.h"
@@ -67,6 +68,10 @@ static const bool DEFAULT_UPNP = false;
 #endif
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
+/** -msghandlerthreads default; peers are sharded across the workers by node id */
+static const int DEFAULT_MSGHANDLER_THREADS = 2;
+/** Upper bound for -msghandlerthreads */
+static const int MAX_MSGHANDLER_THREADS = 8;
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
@@ -135,6 +140,9 @@ CAddress GetLocalAddress(const CNetAddr* paddrPeer = NULL);
 extern bool fDiscover;
 extern bool fListen;
 extern bool fNetworkActive;
+/** -mnrelaypriority: flush inventory to masternode peers on every send pass
+ *  instead of waiting for the trickle, to keep quorum round-trips short. */
+extern bool fMasternodeRelayPriority;
 extern ServiceFlags nLocalServices;
 extern ServiceFlags nRelevantServices;
 extern uint64_t nLocalHostNonce;
@@ -144,9 +152,16 @@ extern int nMaxOutbound;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
+extern std::map<CInv, CTransactionRef> mapRelay;
+//! Lazily built wire messages for mapRelay entries (see ProcessGetData):
+//! filled on the first getdata for an inv, expired together with mapRelay.
+extern std::map<CInv, CSerializeData> mapRelayMsg;
 extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 extern CCriticalSection cs_mapRelay;
+
+/** Build a complete wire message (header, size, checksum and payload) that
+ *  can be queued to any number of peers via CNode::PushSharedMessage. */
+void BuildNetMessage(CSerializeData& msg, const std::string& strCommand, const CDataStream& payload);
 extern limitedmap<CInv, int64_t> mapAlreadyAskedFor;
 
 extern std::vector<std::string> vAddedNodes;
@@ -155,6 +170,9 @@ extern CCriticalSection cs_vAddedNodes;
 extern NodeId nLastNodeId;
 extern CCriticalSection cs_nLastNodeId;
 
+/** Wake the message handler workers for an immediate pass. */
+void WakeMessageHandler();
+
 struct LocalServiceInfo {
     int nScore;
     int nPort;
@@ -223,6 +241,11 @@ public:
 
     int readHeader(const char* pch, unsigned int nBytes);
     int readData(const char* pch, unsigned int nBytes);
+
+    // Expose the payload buffer so the socket layer can recv() straight
+    // into it, skipping the intermediate stack buffer. Returns NULL (and
+    // nSpace = 0) while the header is still being parsed.
+    char* GetRecvPtr(unsigned int& nSpace);
 };
 
 
@@ -301,6 +324,9 @@ public:
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
     std::deque<CSerializeData> vSendMsg;
+    // set when vSendMsg holds a latency-critical message (block/header
+    // relay, ping); SocketSendData then skips corking the socket
+    bool fSendUrgent;
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
@@ -333,6 +359,10 @@ public:
     // b) the peer may tell us in their version message that we should not relay tx invs
     //    until they have initialized their bloom filter.
     bool fRelayTxes;
+    // Set when new work is queued for this peer (e.g. an inventory item), so
+    // the message handler can run a send pass for it without waiting for the
+    // next periodic sweep.
+    std::atomic<bool> fSendReady;
     // Should be 'true' only if we connected to this node to actually mix funds.
     // In this case node will be released automatically via CMasternodeMan::ProcessMasternodeConnections().
     // Connecting to verify connectability/status or connecting for sending/relaying single message
@@ -360,6 +390,11 @@ protected:
     static std::vector<CSubNet> vWhitelistedRange;
     static CCriticalSection cs_vWhitelistedRange;
 
+    // Trusted-leader ranges for hot-standby followers. Blocks relayed by a
+    // peer in one of these ranges connect without script re-execution.
+    static std::vector<CSubNet> vTrustedLeaderRange;
+    static CCriticalSection cs_vTrustedLeaderRange;
+
     // Basic fuzz-testing
     void Fuzz(int nChance); // modifies ssSend
 
@@ -371,6 +406,8 @@ public:
     std::vector<CAddress> vAddrToSend;
     mruset<CAddress> setAddrKnown;
     bool fGetAddr;
+    //! Whether a getaddr request was already answered on this connection
+    bool fSentAddr;
     std::set<uint256> setKnown;
 
     // inventory based relay
@@ -387,8 +424,13 @@ public:
     int64_t nPingUsecStart;
     // Last measured round-trip time.
     int64_t nPingUsecTime;
+    // Best measured round-trip time, used when scoring eviction candidates.
+    int64_t nMinPingUsecTime;
     // Whether a ping is requested.
     bool fPingQueued;
+    // Earliest time the next mempool short-id sync round may be sent to this
+    // peer (trusted peers only, see -mempoolsync).
+    int64_t nNextMempoolSync;
 
     CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn = "", bool fInboundIn = false);
     ~CNode();
@@ -400,6 +442,12 @@ private:
     static uint64_t nTotalBytesRecv;
     static uint64_t nTotalBytesSent;
 
+    // Outbound upload budget (-maxuploadtarget), tracked per rolling cycle
+    static uint64_t nMaxOutboundTotalBytesSentInCycle;
+    static uint64_t nMaxOutboundCycleStartTime;
+    static uint64_t nMaxOutboundLimit;
+    static uint64_t nMaxOutboundTimeframe;
+
     CCriticalSection cs_nRefCount;
 
     CNode(const CNode&);
@@ -430,6 +478,15 @@ public:
     // requires LOCK(cs_vRecvMsg)
     bool ReceiveMsgBytes(const char* pch, unsigned int nBytes);
 
+    // requires LOCK(cs_vRecvMsg)
+    // Zero-copy receive: where the payload of the current in-flight message
+    // can be written directly, or NULL if the next wire bytes are a header.
+    char* RecvMsgWritePtr(unsigned int& nSpace);
+
+    // requires LOCK(cs_vRecvMsg)
+    // Account for nBytes written through RecvMsgWritePtr().
+    void MarkBytesReceived(unsigned int nBytes);
+
     // requires LOCK(cs_vRecvMsg)
     void SetRecvVersion(int nVersionIn)
     {
@@ -487,7 +544,11 @@ public:
             LOCK(cs_inventory);
             if (!setInventoryKnown.count(inv))
                 vInventoryToSend.push_back(inv);
+            else
+                return;
         }
+        fSendReady = true;
+        WakeMessageHandler();
     }
 
     void AskFor(const CInv& inv);
@@ -501,6 +562,11 @@ public:
     // TODO: Document the precondition of this function.  Is cs_vSend locked?
     void EndMessage() UNLOCK_FUNCTION(cs_vSend);
 
+    //! Queue a fully framed wire message (header, size, checksum and
+    //! payload already built, see BuildNetMessage). Lets a message shared
+    //! between many peers be serialized and checksummed exactly once.
+    void PushSharedMessage(const CSerializeData& msg);
+
     void PushVersion();
 
 
@@ -721,6 +787,9 @@ public:
     static bool IsBanned(CSubNet subnet);
     static void Ban(const CNetAddr &ip, const BanReason &banReason, int64_t bantimeoffset = 0, bool sinceUnixEpoch = false);
     static void Ban(const CSubNet &subNet, const BanReason &banReason, int64_t bantimeoffset = 0, bool sinceUnixEpoch = false);
+    //! Ban many subnets under one lock with a single matcher rebuild (bulk
+    //! threat-feed imports).
+    static void BanList(const std::vector<CSubNet> &vSubNets, const BanReason &banReason, int64_t bantimeoffset = 0, bool sinceUnixEpoch = false);
     static bool Unban(const CNetAddr &ip);
     static bool Unban(const CSubNet &ip);
     static void GetBanned(banmap_t &banmap);
@@ -738,12 +807,31 @@ public:
     static bool IsWhitelistedRange(const CNetAddr& ip);
     static void AddWhitelistedRange(const CSubNet& subnet);
 
+    static bool IsTrustedLeaderRange(const CNetAddr& ip);
+    static void AddTrustedLeaderRange(const CSubNet& subnet);
+
     // Network stats
     static void RecordBytesRecv(uint64_t bytes);
     static void RecordBytesSent(uint64_t bytes);
 
     static uint64_t GetTotalBytesRecv();
     static uint64_t GetTotalBytesSent();
+
+    //! Set the upload budget per timeframe, in bytes; 0 disables the budget
+    static void SetMaxOutboundTarget(uint64_t limit);
+    static uint64_t GetMaxOutboundTarget();
+
+    //! Returns whether the outbound budget is spent. With
+    //! fHistoricalBlockServingLimit a buffer is kept back so block relay and
+    //! quorum traffic near the tip keep flowing after historical block
+    //! serving has been cut off.
+    static bool OutboundTargetReached(bool fHistoricalBlockServingLimit);
+
+    //! Bytes left in the current cycle, 0 when no budget is set
+    static uint64_t GetOutboundTargetBytesLeft();
+
+    //! Seconds until the current cycle rolls over, 0 when no budget is set
+    static uint64_t GetMaxOutboundTimeLeftInCycle();
 };
 
 class CExplicitNetCleanup
@@ -754,7 +842,7 @@ public:
 
 class CTransaction;
 void RelayTransaction(const CTransaction& tx);
-void RelayTransaction(const CTransaction& tx, const CDataStream& ss);
+void RelayTransaction(const CTransactionRef& ptx);
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll = false);
 void RelayInv(CInv& inv);
 
@@ -792,6 +880,69 @@ public:
 
 void DumpBanlist();
 
+/** Rolling quality record for a peer, persisted in peerperf.dat so connection
+ * selection can prefer historically fast peers across restarts instead of
+ * rediscovering peer quality fresh every session. */
+class CPeerPerfRecord
+{
+public:
+    int64_t nBlocksDelivered;     //! Blocks this peer delivered to us
+    int64_t nBlockLatencyTotalMs; //! Total getdata-to-delivery latency over those blocks
+    int64_t nUsefulInvs;          //! Announcements for data we did not have yet
+    int64_t nTotalInvs;           //! All announcements from this peer
+    int64_t nStalls;              //! Times this peer stalled our block download
+    int64_t nLastUpdate;          //! Unix time of the last change, for eviction
+
+    CPeerPerfRecord() { SetNull(); }
+
+    void SetNull()
+    {
+        nBlocksDelivered = 0;
+        nBlockLatencyTotalMs = 0;
+        nUsefulInvs = 0;
+        nTotalInvs = 0;
+        nStalls = 0;
+        nLastUpdate = 0;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nBlocksDelivered);
+        READWRITE(nBlockLatencyTotalMs);
+        READWRITE(nUsefulInvs);
+        READWRITE(nTotalInvs);
+        READWRITE(nStalls);
+        READWRITE(nLastUpdate);
+    }
+};
+
+typedef std::map<CNetAddr, CPeerPerfRecord> peerperfmap_t;
+
+/** Access to the peer performance database (peerperf.dat) */
+class CPeerPerfDB
+{
+private:
+    boost::filesystem::path pathPeerPerf;
+
+public:
+    CPeerPerfDB();
+    bool Write(const peerperfmap_t& mapPerf);
+    bool Read(peerperfmap_t& mapPerf);
+};
+
+void RecordPeerBlockLatency(const CNetAddr& addr, int64_t nMillis);
+void RecordPeerInv(const CNetAddr& addr, bool fUseful);
+void RecordPeerStall(const CNetAddr& addr);
+/** Whether a candidate's track record (if any) makes it worth connecting to
+ * early in the selection scan; unknown peers are preferred so new addresses
+ * still get explored. */
+bool IsPreferredPeer(const CNetAddr& addr);
+void DumpPeerPerf();
+void LoadPeerPerf();
+
 struct AddedNodeInfo
 {
     std::string strAddedNode;
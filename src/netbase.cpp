@@ -25,6 +25,7 @@
 #include <arpa/inet.h>
 #endif
 #include <fcntl.h>
+#include <netinet/tcp.h>
 #endif
 
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
@@ -92,18 +93,10 @@ void SplitHostPort(std::string in, int& portOut, std::string& hostOut)
         hostOut = in;
 }
 
-bool static LookupIntern(const char* pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup)
+bool static LookupDirect(const char* pszName, std::vector<CNetAddr>& vIP, bool fAllowLookup)
 {
     vIP.clear();
 
-    {
-        CNetAddr addr;
-        if (addr.SetSpecial(std::string(pszName))) {
-            vIP.push_back(addr);
-            return true;
-        }
-    }
-
 /*#ifdef HAVE_GETADDRINFO_A
     struct in_addr ipv4_addr;
 #ifdef HAVE_INET_PTON
@@ -167,7 +160,7 @@ bool static LookupIntern(const char* pszName, std::vector<CNetAddr>& vIP, unsign
         return false;
 
     struct addrinfo* aiTrav = aiRes;
-    while (aiTrav != NULL && (nMaxSolutions == 0 || vIP.size() < nMaxSolutions)) {
+    while (aiTrav != NULL) {
         if (aiTrav->ai_family == AF_INET) {
             assert(aiTrav->ai_addrlen >= sizeof(sockaddr_in));
             vIP.push_back(CNetAddr(((struct sockaddr_in*)(aiTrav->ai_addr))->sin_addr));
@@ -186,6 +179,91 @@ bool static LookupIntern(const char* pszName, std::vector<CNetAddr>& vIP, unsign
     return (vIP.size() > 0);
 }
 
+/**
+ * Resolver cache in front of getaddrinfo. Positive results are kept for
+ * ten minutes and failures for one, so reconnect storms (addnode retry
+ * loops, failover) hit the cache instead of the resolver. Lookups for a
+ * name already being resolved piggyback on the in-flight worker rather
+ * than issuing a second query.
+ */
+static const int64_t DNS_CACHE_TTL = 10 * 60;
+static const int64_t DNS_NEGATIVE_CACHE_TTL = 60;
+//! Longest a caller waits on the resolver before giving up; the worker
+//! keeps running and fills the cache for the next attempt.
+static const int64_t DNS_LOOKUP_TIMEOUT_MS = 10 * 1000;
+
+struct CDNSCacheEntry {
+    std::vector<CNetAddr> vIP;
+    bool fOk;
+    int64_t nExpiry;
+};
+static CCriticalSection cs_dnsCache;
+static std::map<std::string, CDNSCacheEntry> mapDNSCache;
+static std::set<std::string> setDNSInFlight;
+
+static void DNSResolveWorker(std::string strName, bool fAllowLookup)
+{
+    std::vector<CNetAddr> vIP;
+    bool fOk = LookupDirect(strName.c_str(), vIP, fAllowLookup);
+    LOCK(cs_dnsCache);
+    CDNSCacheEntry& entry = mapDNSCache[strName];
+    entry.vIP = vIP;
+    entry.fOk = fOk;
+    entry.nExpiry = GetTime() + (fOk ? DNS_CACHE_TTL : DNS_NEGATIVE_CACHE_TTL);
+    setDNSInFlight.erase(strName);
+}
+
+bool static LookupIntern(const char* pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup)
+{
+    vIP.clear();
+
+    {
+        CNetAddr addr;
+        if (addr.SetSpecial(std::string(pszName))) {
+            vIP.push_back(addr);
+            return true;
+        }
+    }
+
+    if (!fAllowLookup) {
+        // Numeric-only parses never touch the resolver; no point caching.
+        if (!LookupDirect(pszName, vIP, false))
+            return false;
+        if (nMaxSolutions > 0 && vIP.size() > nMaxSolutions)
+            vIP.resize(nMaxSolutions);
+        return true;
+    }
+
+    std::string strName(pszName);
+    const int64_t nDeadline = GetTimeMillis() + DNS_LOOKUP_TIMEOUT_MS;
+    while (true) {
+        {
+            LOCK(cs_dnsCache);
+            std::map<std::string, CDNSCacheEntry>::iterator it = mapDNSCache.find(strName);
+            if (it != mapDNSCache.end() && GetTime() < it->second.nExpiry) {
+                if (!it->second.fOk)
+                    return false;
+                vIP = it->second.vIP;
+                if (nMaxSolutions > 0 && vIP.size() > nMaxSolutions)
+                    vIP.resize(nMaxSolutions);
+                return !vIP.empty();
+            }
+            if (!setDNSInFlight.count(strName)) {
+                setDNSInFlight.insert(strName);
+                boost::thread worker(DNSResolveWorker, strName, fAllowLookup);
+                worker.detach();
+            }
+        }
+        if (GetTimeMillis() >= nDeadline) {
+            // No negative-cache entry for a timeout: the worker is still
+            // running and stores the real answer for the next attempt.
+            return false;
+        }
+        MilliSleep(50);
+        boost::this_thread::interruption_point();
+    }
+}
+
 bool LookupHost(const char* pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup)
 {
     std::string strHost(pszName);
@@ -418,6 +496,16 @@ bool static ConnectSocketDirectly(const CService& addrConnect, SOCKET& hSocketRe
     setsockopt(hSocket, SOL_SOCKET, SO_NOSIGPIPE, (void*)&set, sizeof(int));
 #endif
 
+#ifdef TCP_FASTOPEN_CONNECT
+    if (GetBoolArg("-tcpfastopen", false)) {
+        // Let the kernel carry the first data segment in the SYN when it
+        // holds a Fast Open cookie for this destination; without one this
+        // silently falls back to a normal three-way handshake.
+        int nOne = 1;
+        setsockopt(hSocket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, (const char*)&nOne, sizeof(nOne));
+    }
+#endif
+
     // Set to non-blocking
     if (!SetSocketNonBlocking(hSocket, true))
         return error("ConnectSocketDirectly: Setting socket to non-blocking failed, error %s\n", NetworkErrorString(WSAGetLastError()));
@@ -474,6 +562,32 @@ bool static ConnectSocketDirectly(const CService& addrConnect, SOCKET& hSocketRe
     return true;
 }
 
+void TuneTcpSocket(SOCKET hSocket, bool fMasternodeLink)
+{
+    // Nagle batches exactly the small messages whose latency matters (invs,
+    // headers, masternode votes); our send path already gathers queued
+    // messages into single syscalls, so the algorithm buys nothing here.
+    int nOne = 1;
+    setsockopt(hSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&nOne, sizeof(nOne));
+
+    // Optional per-class buffer sizing: masternode links often span
+    // datacenters and want larger windows than anonymous peers.
+    int64_t nSndBuf = GetArg("-tcpsndbuf", 0);
+    int64_t nRcvBuf = GetArg("-tcprcvbuf", 0);
+    if (fMasternodeLink) {
+        nSndBuf = GetArg("-mntcpsndbuf", nSndBuf);
+        nRcvBuf = GetArg("-mntcprcvbuf", nRcvBuf);
+    }
+    if (nSndBuf > 0) {
+        int nVal = (int)nSndBuf;
+        setsockopt(hSocket, SOL_SOCKET, SO_SNDBUF, (const char*)&nVal, sizeof(nVal));
+    }
+    if (nRcvBuf > 0) {
+        int nVal = (int)nRcvBuf;
+        setsockopt(hSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&nVal, sizeof(nVal));
+    }
+}
+
 bool SetProxy(enum Network net, CService addrProxy)
 {
     assert(net >= 0 && net < NET_MAX);
@@ -1277,6 +1391,35 @@ bool CSubNet::Match(const CNetAddr& addr) const
     return true;
 }
 
+bool CSubNet::GetPrefix(unsigned char (&networkOut)[16], unsigned int& prefixLenOut) const
+{
+    if (!valid)
+        return false;
+    unsigned int bits = 0;
+    bool fSeenZero = false;
+    for (int x = 0; x < 16; ++x) {
+        uint8_t b = netmask[x];
+        if (fSeenZero && b != 0)
+            return false; // set bits after a hole: not a prefix
+        if (b == 0xff) {
+            bits += 8;
+            continue;
+        }
+        // remaining byte must be a contiguous run of high bits
+        uint8_t m = b;
+        while (m & 0x80) {
+            bits++;
+            m <<= 1;
+        }
+        if (m != 0)
+            return false;
+        fSeenZero = true;
+    }
+    memcpy(networkOut, network.ip, 16);
+    prefixLenOut = bits;
+    return true;
+}
+
 std::string CSubNet::ToString() const
 {
     std::string strNetmask;
@@ -123,6 +123,10 @@ public:
 
     bool Match(const CNetAddr& addr) const;
 
+    //! Export the subnet as (network bytes, prefix length). Returns false if
+    //! the netmask is not a contiguous prefix and cannot be represented.
+    bool GetPrefix(unsigned char (&networkOut)[16], unsigned int& prefixLenOut) const;
+
     std::string ToString() const;
     bool IsValid() const;
 
@@ -206,6 +210,8 @@ std::string NetworkErrorString(int err);
 bool CloseSocket(SOCKET& hSocket);
 /** Disable or enable blocking-mode for a socket */
 bool SetSocketNonBlocking(SOCKET& hSocket, bool fNonBlocking);
+/** Apply TCP_NODELAY and the -tcpsndbuf/-tcprcvbuf (or masternode-class) buffer sizes to a peer socket */
+void TuneTcpSocket(SOCKET hSocket, bool fMasternodeLink);
 
 /**
  * Convert milliseconds to a struct timeval for e.g. select.
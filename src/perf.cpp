@@ -0,0 +1,181 @@
+// Copyright (c) 2015-2017 The Lux developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "perf.h"
+
+#include "compat.h"
+#include "sync.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include "univalue/univalue.h"
+
+#include <map>
+
+#ifndef WIN32
+#include <netdb.h>
+#include <sys/socket.h>
+#endif
+
+bool fPerfStats = false;
+
+namespace {
+
+//! Histogram buckets; bucket i counts samples in [2^i, 2^(i+1)) microseconds,
+//! which covers 1us up to about 75 minutes.
+static const int PERF_BUCKETS = 32;
+
+struct CPerfCounter {
+    uint64_t nCount;
+    int64_t nTotalUs;
+    int64_t nMinUs;
+    int64_t nMaxUs;
+    uint64_t vBuckets[PERF_BUCKETS];
+
+    CPerfCounter() : nCount(0), nTotalUs(0), nMinUs(0), nMaxUs(0)
+    {
+        memset(vBuckets, 0, sizeof(vBuckets));
+    }
+
+    void Record(int64_t nDurationUs)
+    {
+        if (nCount == 0 || nDurationUs < nMinUs)
+            nMinUs = nDurationUs;
+        if (nDurationUs > nMaxUs)
+            nMaxUs = nDurationUs;
+        nCount++;
+        nTotalUs += nDurationUs;
+
+        int nBucket = 0;
+        while (nBucket < PERF_BUCKETS - 1 && nDurationUs >= ((int64_t)2 << nBucket))
+            nBucket++;
+        vBuckets[nBucket]++;
+    }
+};
+
+CCriticalSection cs_perf;
+std::map<std::string, CPerfCounter> mapPerfCounters;
+
+} // anon namespace
+
+CPerfScope::CPerfScope(const char* pszNameIn) : pszName(NULL), nStart(0)
+{
+    if (fPerfStats) {
+        pszName = pszNameIn;
+        nStart = GetTimeMicros();
+    }
+}
+
+CPerfScope::~CPerfScope()
+{
+    if (pszName)
+        PerfRecord(pszName, GetTimeMicros() - nStart);
+}
+
+void PerfRecord(const char* pszName, int64_t nDurationUs)
+{
+    if (nDurationUs < 0)
+        nDurationUs = 0;
+    LOCK(cs_perf);
+    mapPerfCounters[pszName].Record(nDurationUs);
+}
+
+UniValue PerfStatsToJSON(bool fReset)
+{
+    UniValue result(UniValue::VOBJ);
+    LOCK(cs_perf);
+    for (std::map<std::string, CPerfCounter>::const_iterator it = mapPerfCounters.begin(); it != mapPerfCounters.end(); ++it) {
+        const CPerfCounter& counter = it->second;
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("count", counter.nCount));
+        entry.push_back(Pair("total_us", counter.nTotalUs));
+        entry.push_back(Pair("avg_us", counter.nCount ? counter.nTotalUs / (int64_t)counter.nCount : 0));
+        entry.push_back(Pair("min_us", counter.nMinUs));
+        entry.push_back(Pair("max_us", counter.nMaxUs));
+        UniValue histogram(UniValue::VARR);
+        int nLast = PERF_BUCKETS - 1;
+        while (nLast > 0 && counter.vBuckets[nLast] == 0)
+            nLast--;
+        for (int i = 0; i <= nLast; i++)
+            histogram.push_back(counter.vBuckets[i]);
+        entry.push_back(Pair("histogram_us_pow2", histogram));
+        result.push_back(Pair(it->first, entry));
+    }
+    if (fReset)
+        mapPerfCounters.clear();
+    return result;
+}
+
+void ThreadStatsd()
+{
+    RenameThread("lux-statsd");
+
+    std::string strTarget = GetArg("-statsd", "");
+    std::string strHost = strTarget;
+    std::string strPort = "8125";
+    size_t nColon = strTarget.rfind(':');
+    if (nColon != std::string::npos) {
+        strHost = strTarget.substr(0, nColon);
+        strPort = strTarget.substr(nColon + 1);
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* aiRes = NULL;
+    if (getaddrinfo(strHost.c_str(), strPort.c_str(), &hints, &aiRes) != 0 || !aiRes) {
+        LogPrintf("%s: cannot resolve statsd target %s\n", __func__, strTarget);
+        return;
+    }
+
+    SOCKET hSocket = socket(aiRes->ai_family, aiRes->ai_socktype, aiRes->ai_protocol);
+    if (hSocket == INVALID_SOCKET || connect(hSocket, aiRes->ai_addr, aiRes->ai_addrlen) != 0) {
+        LogPrintf("%s: cannot create statsd socket\n", __func__);
+        freeaddrinfo(aiRes);
+        return;
+    }
+    freeaddrinfo(aiRes);
+
+    LogPrintf("%s: emitting perf counters to %s:%s\n", __func__, strHost, strPort);
+
+    const int64_t nInterval = GetArg("-statsdinterval", 60);
+    std::map<std::string, CPerfCounter> mapLast;
+    while (true) {
+        MilliSleep(nInterval * 1000);
+
+        std::map<std::string, CPerfCounter> mapNow;
+        {
+            LOCK(cs_perf);
+            mapNow = mapPerfCounters;
+        }
+
+        // statsd datagrams: one counter and one timing gauge per scope,
+        // packed into payloads small enough to avoid fragmentation.
+        std::string strPayload;
+        for (std::map<std::string, CPerfCounter>::const_iterator it = mapNow.begin(); it != mapNow.end(); ++it) {
+            const CPerfCounter& counter = it->second;
+            uint64_t nLastCount = 0;
+            int64_t nLastTotal = 0;
+            std::map<std::string, CPerfCounter>::const_iterator last = mapLast.find(it->first);
+            if (last != mapLast.end()) {
+                nLastCount = last->second.nCount;
+                nLastTotal = last->second.nTotalUs;
+            }
+            uint64_t nCount = counter.nCount - nLastCount;
+            if (nCount == 0)
+                continue;
+            int64_t nAvgUs = (counter.nTotalUs - nLastTotal) / (int64_t)nCount;
+            strPayload += strprintf("lux.perf.%s.count:%d|c\n", it->first, nCount);
+            strPayload += strprintf("lux.perf.%s.time:%d|ms\n", it->first, nAvgUs / 1000);
+            if (strPayload.size() > 1000) {
+                send(hSocket, strPayload.data(), strPayload.size(), 0);
+                strPayload.clear();
+            }
+        }
+        if (!strPayload.empty())
+            send(hSocket, strPayload.data(), strPayload.size(), 0);
+        mapLast.swap(mapNow);
+    }
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2015-2017 The Lux developers                      -*- c++ -*-
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PERF_H
+#define BITCOIN_PERF_H
+
+#include <stdint.h>
+#include <string>
+
+class UniValue;
+
+//! Set from -perfstats; scope timers are no-ops while this is false.
+extern bool fPerfStats;
+
+/**
+ * Lightweight instrumentation for hot paths. A CPerfScope placed at the
+ * top of a function records its wall time into a named counter (count,
+ * total, min, max and a power-of-two microsecond histogram) on scope
+ * exit. Counters are queried via the getperfstats RPC and optionally
+ * flushed to a statsd daemon (-statsd) so production stalls can be
+ * attributed without attaching a debugger.
+ */
+class CPerfScope
+{
+public:
+    CPerfScope(const char* pszNameIn);
+    ~CPerfScope();
+
+private:
+    const char* pszName;
+    int64_t nStart;
+};
+
+/** Record a single sample for the named counter. */
+void PerfRecord(const char* pszName, int64_t nDurationUs);
+
+/** Snapshot all counters as JSON; optionally zero them afterwards. */
+UniValue PerfStatsToJSON(bool fReset);
+
+/** Periodically emit counter deltas to the -statsd target over UDP. */
+void ThreadStatsd();
+
+#endif // BITCOIN_PERF_H
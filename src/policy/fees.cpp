@@ -306,8 +306,12 @@ void CBlockPolicyEstimator::removeTx(uint256 hash)
     mapMemPoolTxs.erase(hash);
 }
 
+/** Marks a memoized fee median slot as not computed yet; EstimateMedianVal
+ *  only ever returns -1 or a real (non-negative) median. */
+static const double CACHED_MEDIAN_UNSET = -2;
+
 CBlockPolicyEstimator::CBlockPolicyEstimator(const CFeeRate& _minRelayFee)
-    : nBestSeenHeight(0)
+    : nBestSeenHeight(0), nCachedMedianHeight(0)
 {
     minTrackedFee = _minRelayFee < CFeeRate(MIN_FEERATE) ? CFeeRate(MIN_FEERATE) : _minRelayFee;
     std::vector<double> vfeelist;
@@ -329,6 +333,22 @@ CBlockPolicyEstimator::CBlockPolicyEstimator(const CFeeRate& _minRelayFee)
     feeLikely = CFeeRate(INF_FEERATE);
     priUnlikely = 0;
     priLikely = INF_PRIORITY;
+
+    cachedFeeMedians.resize(MAX_BLOCK_CONFIRMS, CACHED_MEDIAN_UNSET);
+}
+
+double CBlockPolicyEstimator::estimateFeeMedian(int confTarget)
+{
+    if (nCachedMedianHeight != nBestSeenHeight) {
+        for (unsigned int i = 0; i < cachedFeeMedians.size(); i++)
+            cachedFeeMedians[i] = CACHED_MEDIAN_UNSET;
+        nCachedMedianHeight = nBestSeenHeight;
+    }
+
+    double& median = cachedFeeMedians[confTarget - 1];
+    if (median == CACHED_MEDIAN_UNSET)
+        median = feeStats.EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, MIN_SUCCESS_PCT, true, nBestSeenHeight);
+    return median;
 }
 
 bool CBlockPolicyEstimator::isFeeDataPoint(const CFeeRate &fee, double pri)
@@ -511,7 +531,26 @@ CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget)
     if (confTarget <= 0 || (unsigned int)confTarget > feeStats.GetMaxConfirms())
         return CFeeRate(0);
 
-    double median = feeStats.EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, MIN_SUCCESS_PCT, true, nBestSeenHeight);
+    double median = estimateFeeMedian(confTarget);
+
+    if (median < 0)
+        return CFeeRate(0);
+
+    return CFeeRate(median);
+}
+
+CFeeRate CBlockPolicyEstimator::estimateFeePercentile(int confTarget, double successPct)
+{
+    // Return failure if trying to analyze a target we're not tracking, or if
+    // the requested probability is outside the meaningful range
+    if (confTarget <= 0 || (unsigned int)confTarget > feeStats.GetMaxConfirms())
+        return CFeeRate(0);
+    if (successPct < 0.5 || successPct > 0.99)
+        return CFeeRate(0);
+
+    // Not memoized; callers asking for custom percentiles are rare compared
+    // to the wallet's default-threshold estimateFee traffic
+    double median = feeStats.EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successPct, true, nBestSeenHeight);
 
     if (median < 0)
         return CFeeRate(0);
@@ -529,7 +568,7 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, int *answerFoun
 
     double median = -1;
     while (median < 0 && (unsigned int)confTarget <= feeStats.GetMaxConfirms()) {
-        median = feeStats.EstimateMedianVal(confTarget++, SUFFICIENT_FEETXS, MIN_SUCCESS_PCT, true, nBestSeenHeight);
+        median = estimateFeeMedian(confTarget++);
     }
 
     if (answerFoundAtTarget)
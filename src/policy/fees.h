@@ -246,6 +246,11 @@ public:
     /** Return a fee estimate */
     CFeeRate estimateFee(int confTarget);
 
+    /** Return a fee estimate at a caller-chosen success probability instead
+     *  of the default MIN_SUCCESS_PCT; successPct must be in [0.5, 0.99].
+     */
+    CFeeRate estimateFeePercentile(int confTarget, double successPct);
+
     /** Estimate fee rate needed to get be included in a block within
      *  confTarget blocks. If no answer can be given at confTarget, return an
      *  estimate at the lowest target where one can be given.
@@ -282,6 +287,17 @@ private:
     // map of txids to information about that transaction
     std::map<uint256, TxStatsInfo> mapMemPoolTxs;
 
+    /** Per-target fee medians memoized for the current chain height. The
+     *  wallet calls estimateFee under the mempool lock for every transaction
+     *  it builds, but the moving averages only change once per block, so the
+     *  bucket scan is done at most once per target per block. Slots that
+     *  haven't been computed yet hold CACHED_MEDIAN_UNSET. */
+    std::vector<double> cachedFeeMedians;
+    unsigned int nCachedMedianHeight;
+
+    /** Compute or fetch the memoized fee median for confTarget */
+    double estimateFeeMedian(int confTarget);
+
     /** Classes to track historical data on transaction confirmations */
     TxConfirmStats feeStats, priStats;
 
@@ -13,6 +13,9 @@
 
 #include <math.h>
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 // Lux modified: find last block index up to pindex
 const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfStake)
 {
@@ -96,3 +99,25 @@ uint256 GetBlockProof(const CBlockIndex& block)
     // or ~bnTarget / (nTarget+1) + 1.
     return (~bnTarget / (bnTarget + 1)) + 1;
 }
+
+/** Hash a strided slice of a headers batch. Heights are walked from the
+ *  first header so each header gets the right side of the phi2 switchover. */
+static void HashHeaderRange(const std::vector<CBlockHeader>* pheaders, std::vector<uint256>* pvHashes, int nFirstHeight, int nSwitchPhi2, unsigned int nOffset, unsigned int nStride)
+{
+    for (unsigned int i = nOffset; i < pheaders->size(); i += nStride)
+        (*pvHashes)[i] = (*pheaders)[i].GetHash(nFirstHeight + (int)i >= nSwitchPhi2);
+}
+
+void HashBlockHeaderBatch(const std::vector<CBlockHeader>& headers, int nFirstHeight, std::vector<uint256>& vHashes)
+{
+    vHashes.resize(headers.size());
+    const int nSwitchPhi2 = Params().SwitchPhi2Block();
+    unsigned int nThreads = std::max(1, std::min(GetNumCores(), 8));
+    if (headers.size() < nThreads * 4)
+        nThreads = 1;
+    boost::thread_group hashers;
+    for (unsigned int t = 1; t < nThreads; t++)
+        hashers.create_thread(boost::bind(&HashHeaderRange, &headers, &vHashes, nFirstHeight, nSwitchPhi2, t, nThreads));
+    HashHeaderRange(&headers, &vHashes, nFirstHeight, nSwitchPhi2, 0, nThreads);
+    hashers.join_all();
+}
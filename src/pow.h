@@ -9,6 +9,7 @@
 #include "consensus/params.h"
 #include "chainparams.h"
 #include <stdint.h>
+#include <vector>
 
 class CBlockHeader;
 class CBlockIndex;
@@ -29,4 +30,11 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
 bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params& consensusParams);
 uint256 GetBlockProof(const CBlockIndex& block);
 
+/** Compute the PoW hashes of a batch of consecutive headers starting at
+ *  nFirstHeight. This is the single choke point for bulk header hashing
+ *  during sync, so an accelerated backend (e.g. a GPU kernel) only has to
+ *  replace this function; the default implementation stripes the batch
+ *  across worker threads. vHashes is resized to match headers. */
+void HashBlockHeaderBatch(const std::vector<CBlockHeader>& headers, int nFirstHeight, std::vector<uint256>& vHashes);
+
 #endif // BITCOIN_POW_H
@@ -263,6 +263,22 @@ public:
         return *this;
     }
 
+    //! noexcept so that std::vector reallocation moves elements holding a
+    //! prevector instead of falling back to copying them.
+    prevector(prevector<N, T, Size, Diff>&& other) noexcept : _size(0) {
+        swap(other);
+    }
+
+    prevector& operator=(prevector<N, T, Size, Diff>&& other) noexcept {
+        if (&other == this) {
+            return *this;
+        }
+        // Steal other's storage; our old contents end up in other and are
+        // released whenever it is destroyed or reassigned.
+        swap(other);
+        return *this;
+    }
+
     size_type size() const {
         return is_direct() ? _size : _size - N - 1;
     }
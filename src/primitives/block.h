@@ -26,7 +26,13 @@ class CBlockHeader
 public:
     // header
     static const int32_t CURRENT_VERSION=7;
-    
+
+    // Serialized header sizes, fixed per version class (the contract-era
+    // bit adds the two EVM roots). Lets callers size batches and streams
+    // without a dry-run serialization.
+    static const unsigned int BASE_HEADER_SIZE = 4 + 32 + 32 + 4 + 4 + 4;
+    static const unsigned int EVM_HEADER_SIZE = BASE_HEADER_SIZE + 32 + 32;
+
     int32_t nVersion;
     uint256 hashPrevBlock;
     uint256 hashMerkleRoot;
@@ -62,6 +62,17 @@ public:
 
 };
 
+#ifndef WORDS_BIGENDIAN
+// On little-endian targets an outpoint's serialized form (32 hash bytes
+// followed by a 32-bit LE index) matches its memory layout exactly, so
+// vectors of outpoints take the bulk path in serialize.h.
+static_assert(sizeof(COutPoint) == 36, "COutPoint must pack without padding for the bulk serialization path");
+template <>
+struct TSerializeAsBytes<COutPoint> {
+    static const bool value = true;
+};
+#endif
+
 /** An input of a transaction.  It contains the location of the previous
  * transaction's output that it claims and a signature that matches the
  * output's public key.
@@ -78,6 +78,11 @@ enum ServiceFlags : uint64_t {
     // Indicates that a node can be asked for blocks and transactions including
     // witness data.
     NODE_WITNESS = (1 << 3),
+    // NODE_NETWORK_LIMITED means the same as NODE_NETWORK with the limitation
+    // of only serving the last MIN_BLOCKS_TO_KEEP (288) blocks. Advertised by
+    // pruned nodes, which keep relaying at the tip but have deleted older
+    // block files.
+    NODE_NETWORK_LIMITED = (1 << 10),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
@@ -141,6 +146,9 @@ enum GetDataMsg
     MSG_TXLOCK_VOTE,
     MSG_SPORK,
     MSG_MASTERNODE_WINNER,
+    // Values 8-17 are reserved by the legacy masternode inventory types
+    // listed in ppszTypeName (protocol.cpp).
+    MSG_CMPCT_BLOCK = 18, //! Defined in BIP152
     MSG_WITNESS_BLOCK = MSG_BLOCK | MSG_WITNESS_FLAG,
     MSG_WITNESS_TX = MSG_TX | MSG_WITNESS_FLAG,
     MSG_FILTERED_WITNESS_BLOCK = MSG_FILTERED_BLOCK | MSG_WITNESS_FLAG,
@@ -4,9 +4,14 @@
 
 #include "pubkey.h"
 
+#include "util.h"
+
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 namespace
 {
 /* Global secp256k1_context object used for verification. */
@@ -173,6 +178,51 @@ bool CPubKey::Verify(const uint256& hash, const std::vector<unsigned char>& vchS
     return secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), &pubkey);
 }
 
+namespace
+{
+//! Minimum checks per worker; smaller batches verify inline since thread
+//! startup costs more than a handful of signature checks.
+const size_t VERIFY_BATCH_MIN_PER_THREAD = 8;
+
+void VerifySignatureRange(const std::vector<CSignatureCheck>* pvChecks, std::vector<unsigned char>* pvfResults, size_t nBegin, size_t nEnd)
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        const CSignatureCheck& check = (*pvChecks)[i];
+        (*pvfResults)[i] = check.pubkey.Verify(check.hash, check.vchSig) ? 1 : 0;
+    }
+}
+} // namespace
+
+bool VerifySignatureBatch(const std::vector<CSignatureCheck>& vChecks, std::vector<unsigned char>& vfResults)
+{
+    vfResults.assign(vChecks.size(), 0);
+
+    // The shared verification context is never written after creation, so
+    // workers can use it concurrently; all per-call state (parsed key,
+    // parsed signature) lives on each worker's stack.
+    size_t nThreads = std::min((size_t)GetNumCores(), vChecks.size() / VERIFY_BATCH_MIN_PER_THREAD);
+    if (nThreads > 1) {
+        size_t nPerThread = (vChecks.size() + nThreads - 1) / nThreads;
+        boost::thread_group group;
+        for (size_t i = 0; i < nThreads; i++) {
+            size_t nBegin = i * nPerThread;
+            size_t nEnd = std::min(nBegin + nPerThread, vChecks.size());
+            if (nBegin >= nEnd)
+                break;
+            group.create_thread(boost::bind(&VerifySignatureRange, &vChecks, &vfResults, nBegin, nEnd));
+        }
+        group.join_all();
+    } else {
+        VerifySignatureRange(&vChecks, &vfResults, 0, vChecks.size());
+    }
+
+    for (size_t i = 0; i < vfResults.size(); i++) {
+        if (!vfResults[i])
+            return false;
+    }
+    return true;
+}
+
 bool CPubKey::RecoverCompact(const uint256& hash, const std::vector<unsigned char>& vchSig)
 {
     if (vchSig.size() != COMPACT_SIGNATURE_SIZE)
@@ -210,6 +210,25 @@ public:
     }
 };
 
+/** One (pubkey, hash, signature) triple for VerifySignatureBatch. */
+struct CSignatureCheck {
+    CPubKey pubkey;
+    uint256 hash;
+    std::vector<unsigned char> vchSig;
+
+    CSignatureCheck() {}
+    CSignatureCheck(const CPubKey& pubkeyIn, const uint256& hashIn, const std::vector<unsigned char>& vchSigIn) : pubkey(pubkeyIn), hash(hashIn), vchSig(vchSigIn) {}
+};
+
+/**
+ * Verify a batch of DER signatures, fanning the checks out across cores when
+ * the batch is large enough to pay for the worker threads. vfResults is
+ * resized to match vChecks with one 0/1 entry per check. Returns true only
+ * if every signature in the batch is valid. Intended for burst consumers
+ * such as masternode signature floods during sync.
+ */
+bool VerifySignatureBatch(const std::vector<CSignatureCheck>& vChecks, std::vector<unsigned char>& vfResults);
+
 struct CExtPubKey {
     unsigned char nDepth;
     unsigned char vchFingerprint[4];
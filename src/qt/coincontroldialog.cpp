@@ -32,6 +32,7 @@
 #include <QString>
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
+#include <QtConcurrent/QtConcurrent>
 
 using namespace std;
 QList<CAmount> CoinControlDialog::payAmounts;
@@ -75,6 +76,9 @@ CoinControlDialog::CoinControlDialog(QWidget* parent) : QDialog(parent),
     connect(lockAction, SIGNAL(triggered()), this, SLOT(lockCoin()));
     connect(unlockAction, SIGNAL(triggered()), this, SLOT(unlockCoin()));
 
+    // async coin listing
+    connect(&coinsWatcher, SIGNAL(finished()), this, SLOT(updateViewFinished()));
+
     // clipboard actions
     QAction* clipboardQuantityAction = new QAction(tr("Copy quantity"), this);
     QAction* clipboardAmountAction = new QAction(tr("Copy amount"), this);
@@ -726,11 +730,35 @@ void CoinControlDialog::updateLabels(WalletModel* model, QDialog* dialog)
         label->setVisible(nChange < 0);
 }
 
+// runs on a worker thread; only touches the wallet, never the GUI
+static std::map<QString, std::vector<COutput> > listCoinsBackground(WalletModel* model)
+{
+    std::map<QString, std::vector<COutput> > mapCoins;
+    model->listCoins(mapCoins);
+    return mapCoins;
+}
+
 void CoinControlDialog::updateView()
 {
     if (!model || !model->getOptionsModel() || !model->getAddressTableModel())
         return;
 
+    // Walking a big wallet for its coin listing takes long enough to freeze
+    // the GUI, so fetch it on a worker thread; the view is rebuilt in
+    // updateViewFinished() once the listing arrives.
+    ui->treeWidget->setEnabled(false);
+    coinsWatcher.setFuture(QtConcurrent::run(listCoinsBackground, model));
+}
+
+void CoinControlDialog::updateViewFinished()
+{
+    if (!model || !model->getOptionsModel() || !model->getAddressTableModel())
+        return;
+    populateView(coinsWatcher.result());
+}
+
+void CoinControlDialog::populateView(const std::map<QString, std::vector<COutput> >& mapCoins)
+{
     bool treeMode = ui->radioTreeMode->isChecked();
 
     ui->treeWidget->clear();
@@ -742,9 +770,6 @@ void CoinControlDialog::updateView()
     int nDisplayUnit = model->getOptionsModel()->getDisplayUnit();
     double mempoolEstimatePriority = mempool.estimatePriority(nTxConfirmTarget);
 
-    map<QString, vector<COutput> > mapCoins;
-    model->listCoins(mapCoins);
-
     BOOST_FOREACH (PAIRTYPE(QString, vector<COutput>) coins, mapCoins) {
         QTreeWidgetItem* itemWalletAddress = new QTreeWidgetItem();
         itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
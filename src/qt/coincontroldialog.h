@@ -6,10 +6,15 @@
 #define BITCOIN_QT_COINCONTROLDIALOG_H
 
 #include "amount.h"
+#include "wallet.h" /* for COutput, carried by the async coin listing */
+
+#include <map>
+#include <vector>
 
 #include <QAbstractButton>
 #include <QAction>
 #include <QDialog>
+#include <QFutureWatcher>
 #include <QList>
 #include <QMenu>
 #include <QPoint>
@@ -62,6 +67,10 @@ private:
     QString strPad(QString, int, QString);
     void sortView(int, Qt::SortOrder);
     void updateView();
+    void populateView(const std::map<QString, std::vector<COutput> >& mapCoins);
+
+    /* delivers the coin listing fetched off the GUI thread by updateView() */
+    QFutureWatcher<std::map<QString, std::vector<COutput> > > coinsWatcher;
 
     enum {
         COLUMN_CHECKBOX,
@@ -125,6 +134,7 @@ private slots:
     void buttonSelectAllClicked();
     void buttonToggleLockClicked();
     void updateLabelLocked();
+    void updateViewFinished();
 
 public slots:
     void updateInfoInDialog();
@@ -62,24 +62,99 @@ public:
     CWallet* wallet;
     TransactionTableModel* parent;
 
-    /* Local cache of wallet.
-     * As it is in the same order as the CWallet, by definition
-     * this is sorted by sha256.
+    /* Local cache of wallet, kept sorted by sha256 so updateWallet can
+     * binary-search it. Only a window of the wallet is decomposed at any
+     * time; the rest sits in vPendingTx until the view asks for more.
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Transaction hashes known to the wallet but not yet decomposed into
+     * cachedWallet, sorted ascending. Drained from the back by loadMore().
+     */
+    std::vector<uint256> vPendingTx;
+
+    /* Number of transactions decomposed per fetchMore() call, and the size
+     * of the most-recent seed loaded at startup.
+     */
+    static const int LOAD_CHUNK = 256;
+
+    /* Query the wallet anew from core. Only collects the hashes plus the
+     * most recent transactions; with a large wallet, decomposing the whole
+     * history up front is what used to make GUI startup take minutes.
      */
     void refreshWallet()
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
+        vPendingTx.clear();
         {
             LOCK2(cs_main, wallet->cs_wallet);
+            std::vector<std::pair<int64_t, uint256> > vByTime;
+            vPendingTx.reserve(wallet->mapWallet.size());
+            vByTime.reserve(wallet->mapWallet.size());
             for (std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it) {
-                if (TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+                if (!TransactionRecord::showTransaction(it->second))
+                    continue;
+                vPendingTx.push_back(it->first);
+                vByTime.push_back(std::make_pair(-(int64_t)it->second.nTimeReceived, it->first));
+            }
+
+            // Decompose the most recent transactions up front so the overview
+            // and the first screen of the history are populated; everything
+            // older is pulled in on demand through fetchMore().
+            size_t nSeed = std::min((size_t)LOAD_CHUNK, vByTime.size());
+            std::partial_sort(vByTime.begin(), vByTime.begin() + nSeed, vByTime.end());
+            std::set<uint256> setSeeded;
+            for (size_t i = 0; i < nSeed; i++) {
+                std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(vByTime[i].second);
+                if (mi != wallet->mapWallet.end())
+                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, mi->second));
+                setSeeded.insert(vByTime[i].second);
+            }
+            if (!setSeeded.empty()) {
+                std::vector<uint256> vRemaining;
+                vRemaining.reserve(vPendingTx.size() - setSeeded.size());
+                for (unsigned int i = 0; i < vPendingTx.size(); i++)
+                    if (!setSeeded.count(vPendingTx[i]))
+                        vRemaining.push_back(vPendingTx[i]);
+                vPendingTx.swap(vRemaining);
+            }
+        }
+        // restore the hash order the binary searches in updateWallet rely on
+        qSort(cachedWallet.begin(), cachedWallet.end(), TxLessThan());
+    }
+
+    bool hasPending() const
+    {
+        return !vPendingTx.empty();
+    }
+
+    /* Decompose the next chunk of pending transactions into the model.
+     */
+    void loadMore(int count)
+    {
+        if (vPendingTx.empty())
+            return;
+        LOCK2(cs_main, wallet->cs_wallet);
+        while (count > 0 && !vPendingTx.empty()) {
+            uint256 hash = vPendingTx.back();
+            vPendingTx.pop_back();
+            std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
+            if (mi == wallet->mapWallet.end())
+                continue;
+            QList<TransactionRecord> toInsert = TransactionRecord::decomposeTransaction(wallet, mi->second);
+            if (toInsert.isEmpty())
+                continue;
+            QList<TransactionRecord>::iterator lower = qLowerBound(
+                    cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
+            int insert_idx = (lower - cachedWallet.begin());
+            parent->beginInsertRows(QModelIndex(), insert_idx, insert_idx + toInsert.size() - 1);
+            foreach (const TransactionRecord& rec, toInsert) {
+                cachedWallet.insert(insert_idx, rec);
+                insert_idx += 1;
             }
+            parent->endInsertRows();
+            count--;
         }
     }
 
@@ -92,6 +167,15 @@ public:
     {
         qDebug() << "TransactionTablePriv::updateWallet : " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
+        // If this transaction is still waiting to be decomposed, drop it from
+        // the backlog; whatever we do below supersedes the lazy load.
+        bool fWasPending = false;
+        std::vector<uint256>::iterator pit = std::lower_bound(vPendingTx.begin(), vPendingTx.end(), hash);
+        if (pit != vPendingTx.end() && *pit == hash) {
+            vPendingTx.erase(pit);
+            fWasPending = true;
+        }
+
         // Find bounds of this transaction in model
         QList<TransactionRecord>::iterator lower = qLowerBound(
                 cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
@@ -143,7 +227,8 @@ public:
                 break;
             case CT_DELETED:
                 if (!inModel) {
-                    qWarning() << "TransactionTablePriv::updateWallet : Warning: Got CT_DELETED, but transaction is not in model";
+                    if (!fWasPending)
+                        qWarning() << "TransactionTablePriv::updateWallet : Warning: Got CT_DELETED, but transaction is not in model";
                     break;
                 }
                 // Removed -- remove entire transaction from table
@@ -261,6 +346,18 @@ int TransactionTableModel::columnCount(const QModelIndex& parent) const
     return columns.length();
 }
 
+bool TransactionTableModel::canFetchMore(const QModelIndex& parent) const
+{
+    Q_UNUSED(parent);
+    return priv->hasPending();
+}
+
+void TransactionTableModel::fetchMore(const QModelIndex& parent)
+{
+    Q_UNUSED(parent);
+    priv->loadMore(TransactionTablePriv::LOAD_CHUNK);
+}
+
 QString TransactionTableModel::formatTxStatus(const TransactionRecord* wtx) const
 {
     QString status;
@@ -47,7 +47,8 @@ WalletModel::WalletModel(CWallet* wallet, OptionsModel* optionsModel, QObject* p
                                                                                          cachedUnconfirmedBalance(0),
                                                                                          cachedImmatureBalance(0),
                                                                                          cachedEncryptionStatus(Unencrypted),
-                                                                                         cachedNumBlocks(0)
+                                                                                         cachedNumBlocks(0),
+                                                                                         cachedBalanceEpoch(0)
 {
     fHaveWatchOnly = wallet->HaveWatchOnly();
     fForceCheckBalanceChanged = false;
@@ -133,6 +134,14 @@ void WalletModel::updateStatus()
 
 void WalletModel::pollBalanceChanged()
 {
+    // The wallet bumps its balance epoch whenever anything that can change
+    // an aggregate happens (new transaction, erase, new tip), so when the
+    // epoch is unchanged there is nothing to do and no lock to take.
+    uint64_t newBalanceEpoch = wallet->GetBalanceEpoch();
+    if (!fForceCheckBalanceChanged && newBalanceEpoch == cachedBalanceEpoch &&
+        nDarksendRounds == cachedDarksendRounds && cachedTxLocks == nCompleteTXLocks)
+        return;
+
     // Get required locks upfront. This avoids the GUI from getting stuck on
     // periodical polls if the core is holding the locks for a longer time -
     // for example, during a wallet rescan.
@@ -143,8 +152,9 @@ void WalletModel::pollBalanceChanged()
     if (!lockWallet)
         return;
     bool cachedNumBlocksChanged = chainActive.Height() != cachedNumBlocks;
-    if (fForceCheckBalanceChanged || chainActive.Height() != cachedNumBlocks || nDarksendRounds != cachedDarksendRounds || cachedTxLocks != nCompleteTXLocks) {
+    if (fForceCheckBalanceChanged || newBalanceEpoch != cachedBalanceEpoch || chainActive.Height() != cachedNumBlocks || nDarksendRounds != cachedDarksendRounds || cachedTxLocks != nCompleteTXLocks) {
         fForceCheckBalanceChanged = false;
+        cachedBalanceEpoch = newBalanceEpoch;
 
         // Balance and number of transactions might have changed
         cachedNumBlocks = chainActive.Height();
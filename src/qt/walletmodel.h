@@ -266,6 +266,7 @@ private:
     int cachedNumBlocks;
     int cachedTxLocks;
     int cachedDarksendRounds;
+    uint64_t cachedBalanceEpoch;
 
     QTimer* pollTimer;
 
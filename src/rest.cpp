@@ -4,6 +4,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "main.h"
+#include "clientversion.h"
+#include "compressor.h"
+#include "consensus/consensus.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "rpcserver.h"
@@ -92,6 +95,87 @@ static bool ParseHashStr(const string& strReq, uint256& v)
     return true;
 }
 
+//! Upper bound on the number of blocks a single /rest/blockrange request may ask for.
+static const unsigned int MAX_REST_BLOCKRANGE_COUNT = 2000;
+
+/**
+ * Read the serialized size of the block at pos from the length field
+ * WriteBlockToDisk put directly in front of the block data, without
+ * touching the block itself.
+ */
+static bool ReadRawBlockSizeFromDisk(const CDiskBlockPos& pos, unsigned int& nSizeRet)
+{
+    if (pos.nPos < 4)
+        return false;
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+
+    if (fseek(filein.Get(), pos.nPos - 4, SEEK_SET) != 0)
+        return false;
+    if (fread((char*)&nSizeRet, 1, sizeof(nSizeRet), filein.Get()) != sizeof(nSizeRet))
+        return false;
+
+    // For -compressblockfiles records the on-disk length is not the raw
+    // serialized size; the caller has to fall back to deserializing.
+    unsigned char chFirst = 0;
+    if (fread((char*)&chFirst, 1, 1, filein.Get()) != 1)
+        return false;
+    if (chFirst == COMPRESSED_BLOCK_MARKER)
+        return false;
+
+    return nSizeRet >= 80 && nSizeRet <= MAX_BLOCK_SERIALIZED_SIZE;
+}
+
+/**
+ * Copy the serialized block at pos straight out of its block file region.
+ * Block files are append-only, so a region referenced by the index is
+ * immutable and can be read without cs_main and without deserializing.
+ */
+static bool ReadRawBlockFromDisk(std::string& rawBlock, const CDiskBlockPos& pos)
+{
+    if (pos.nPos < 4)
+        return false;
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+
+    unsigned int nSize = 0;
+    if (fseek(filein.Get(), pos.nPos - 4, SEEK_SET) != 0)
+        return false;
+    if (fread((char*)&nSize, 1, sizeof(nSize), filein.Get()) != sizeof(nSize))
+        return false;
+    if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+        return false;
+
+    rawBlock.resize(nSize);
+    if (fread(&rawBlock[0], 1, nSize, filein.Get()) != nSize)
+        return false;
+
+    // A -compressblockfiles record must not be served verbatim.
+    return (unsigned char)rawBlock[0] != COMPRESSED_BLOCK_MARKER;
+}
+
+/**
+ * Serialize the block at pos the way it would appear raw on disk. Used when
+ * the on-disk record is in the -compressblockfiles format and cannot be
+ * copied verbatim; the file region itself is still immutable, so no lock
+ * is needed.
+ */
+static bool ReadSerializedBlockFromDisk(std::string& rawBlock, const CDiskBlockPos& pos, int nHeight)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pos, nHeight, Params().GetConsensus()))
+        return false;
+
+    CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+    ssBlock << block;
+    rawBlock.assign(ssBlock.begin(), ssBlock.end());
+    return true;
+}
+
 static bool rest_block(AcceptedConnection* conn,
     string& strReq,
     map<string, string>& mapHeaders,
@@ -106,7 +190,6 @@ static bool rest_block(AcceptedConnection* conn,
     if (!ParseHashStr(hashStr, hash))
         throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     const Consensus::Params consensusParams = Params().GetConsensus();
     CBlockIndex* pblockindex = NULL;
     {
@@ -115,28 +198,36 @@ static bool rest_block(AcceptedConnection* conn,
             throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
 
         pblockindex = mapBlockIndex[hash];
-        if (!ReadBlockFromDisk(block, pblockindex, consensusParams))
-            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
+        // Serve the already-serialized bytes straight from the block file,
+        // skipping the deserialize/re-serialize round trip. Blocks stored
+        // in the -compressblockfiles format have to take the slow path.
+        string binaryBlock;
+        if (!ReadRawBlockFromDisk(binaryBlock, pblockindex->GetBlockPos()) &&
+            !ReadSerializedBlockFromDisk(binaryBlock, pblockindex->GetBlockPos(), pblockindex->nHeight))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
         conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryBlock.size(), "application/octet-stream") << binaryBlock << std::flush;
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        string binaryBlock;
+        if (!ReadRawBlockFromDisk(binaryBlock, pblockindex->GetBlockPos()) &&
+            !ReadSerializedBlockFromDisk(binaryBlock, pblockindex->GetBlockPos(), pblockindex->nHeight))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        string strHex = HexStr(binaryBlock.begin(), binaryBlock.end()) + "\n";
         conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
         return true;
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
+        std::shared_ptr<const CBlock> pblock = FetchBlockShared(pblockindex, consensusParams);
+        if (!pblock)
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        UniValue objBlock = blockToJSON(*pblock, pblockindex, showTxDetails);
         string strJSON = objBlock.write() + "\n";
         conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
         return true;
@@ -167,6 +258,87 @@ static bool rest_block_notxdetails(AcceptedConnection* conn,
     return rest_block(conn, strReq, mapHeaders, fRun, false);
 }
 
+// /rest/blockrange/<start-height>/<count>.bin
+// Streams up to <count> consecutive blocks of the active chain, each framed
+// as a 4-byte little-endian length followed by the raw serialized block, so
+// bulk consumers can pull ranges at disk speed with a single request.
+static bool rest_blockrange(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& mapHeaders,
+    bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    if (path.size() != 2)
+        throw RESTERR(HTTP_BAD_REQUEST, "No start height and count specified. Use /rest/blockrange/<height>/<count>.bin");
+
+    int32_t nStart = 0;
+    int32_t nCount = 0;
+    if (!ParseInt32(path[0], &nStart) || !ParseInt32(path[1], &nCount) || nStart < 0 || nCount < 1)
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid height or count: " + params[0]);
+    if ((unsigned int)nCount > MAX_REST_BLOCKRANGE_COUNT)
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Count is limited to %u blocks per request", MAX_REST_BLOCKRANGE_COUNT));
+
+    std::vector<std::pair<CDiskBlockPos, int> > vPos;
+    {
+        LOCK(cs_main);
+        if (nStart > chainActive.Height())
+            throw RESTERR(HTTP_NOT_FOUND, "Start height after current tip");
+
+        for (int nHeight = nStart; nHeight <= chainActive.Height() && (int)vPos.size() < nCount; nHeight++)
+            vPos.push_back(std::make_pair(chainActive[nHeight]->GetBlockPos(), nHeight));
+    }
+
+    switch (rf) {
+    case RF_BINARY: {
+        // First pass over the on-disk length fields only, so the reply can
+        // carry a Content-Length; then stream the file regions one block at
+        // a time, keeping memory use at one block regardless of range size.
+        // Blocks stored in the -compressblockfiles format have no raw
+        // region and are decompressed and re-serialized in both passes.
+        size_t nTotalLen = 0;
+        for (unsigned int i = 0; i < vPos.size(); i++) {
+            unsigned int nSize = 0;
+            if (ReadRawBlockSizeFromDisk(vPos[i].first, nSize)) {
+                nTotalLen += 4 + nSize;
+            } else {
+                string rawBlock;
+                if (!ReadSerializedBlockFromDisk(rawBlock, vPos[i].first, vPos[i].second))
+                    throw RESTERR(HTTP_INTERNAL_SERVER_ERROR, "Block not available");
+                nTotalLen += 4 + rawBlock.size();
+            }
+        }
+
+        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, nTotalLen, "application/octet-stream");
+        for (unsigned int i = 0; i < vPos.size(); i++) {
+            string rawBlock;
+            if (!ReadRawBlockFromDisk(rawBlock, vPos[i].first) &&
+                !ReadSerializedBlockFromDisk(rawBlock, vPos[i].first, vPos[i].second))
+                return false; // header already sent; drop the connection
+            unsigned char szLen[4];
+            szLen[0] = rawBlock.size() & 0xff;
+            szLen[1] = (rawBlock.size() >> 8) & 0xff;
+            szLen[2] = (rawBlock.size() >> 16) & 0xff;
+            szLen[3] = (rawBlock.size() >> 24) & 0xff;
+            conn->stream().write((const char*)szLen, sizeof(szLen));
+            conn->stream().write(rawBlock.data(), rawBlock.size());
+        }
+        conn->stream() << std::flush;
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: .bin)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_tx(AcceptedConnection* conn,
     string& strReq,
     map<string, string>& mapHeaders,
@@ -227,6 +399,7 @@ static const struct {
         bool fRun);
 } uri_prefixes[] = {
     {"/rest/tx/", rest_tx},
+    {"/rest/blockrange/", rest_blockrange},
     {"/rest/block/notxdetails/", rest_block_notxdetails},
     {"/rest/block/", rest_block_extended},
 };
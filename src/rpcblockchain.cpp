@@ -7,12 +7,19 @@
 
 #include "checkpoints.h"
 #include "consensus/validation.h"
+#include "jsonwriter.h"
 #include "main.h"
 #include "primitives/transaction.h"
+#include "lux/storageresults.h"
 #include "rpcserver.h"
 #include "sync.h"
+#include "txdb.h"
 #include "util.h"
 
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
 #include <stdint.h>
 
 #include "univalue/univalue.h"
@@ -20,6 +27,7 @@
 using namespace std;
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
+extern void TxToWriter(const CTransaction& tx, const uint256 hashBlock, JSONWriter& w);
 void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 int getBlockTimeByHeight(int nHeight);
 
@@ -68,10 +76,48 @@ CBlockIndex* GetLastBlockOfType(const int nPoS) // 0: PoW; 1: PoS
     return NULL;
 }
 
+// Decoded tx-detail arrays for getblock verbosity 2, keyed by block hash.
+// The entries are chain-state invariant (TxToJSON with a null block hash emits
+// no confirmations), so they never go stale; explorers hammer the same few
+// fresh blocks, hence a small LRU is enough.
+static CCriticalSection cs_blockTxJSONCache;
+static std::list<std::pair<uint256, UniValue> > listBlockTxJSONCache;
+static const size_t MAX_BLOCK_TX_JSON_CACHE = 16;
+
+static UniValue BlockTxDetailsJSON(const CBlock& block, const uint256& hash)
+{
+    {
+        LOCK(cs_blockTxJSONCache);
+        for (std::list<std::pair<uint256, UniValue> >::iterator it = listBlockTxJSONCache.begin(); it != listBlockTxJSONCache.end(); ++it) {
+            if (it->first == hash) {
+                listBlockTxJSONCache.splice(listBlockTxJSONCache.begin(), listBlockTxJSONCache, it);
+                return it->second;
+            }
+        }
+    }
+
+    UniValue txs(UniValue::VARR);
+    txs.reserve(block.vtx.size());
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        UniValue objTx(UniValue::VOBJ);
+        TxToJSON(tx, uint256(), objTx);
+        txs.push_back(std::move(objTx));
+    }
+
+    {
+        LOCK(cs_blockTxJSONCache);
+        listBlockTxJSONCache.push_front(std::make_pair(hash, txs));
+        if (listBlockTxJSONCache.size() > MAX_BLOCK_TX_JSON_CACHE)
+            listBlockTxJSONCache.pop_back();
+    }
+    return txs;
+}
+
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
 {
     UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", block.GetHash(blockindex->nHeight >= Params().SwitchPhi2Block()).GetHex()));
+    uint256 hash = block.GetHash(blockindex->nHeight >= Params().SwitchPhi2Block());
+    result.push_back(Pair("hash", hash.GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
@@ -84,15 +130,14 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.push_back(Pair("stateroot", block.hashStateRoot.GetHex()));
     result.push_back(Pair("utxoroot", block.hashUTXORoot.GetHex()));
     UniValue txs(UniValue::VARR);
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        if (txDetails) {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(tx, uint256(), objTx);
-            txs.push_back(objTx);
-        } else
+    if (txDetails) {
+        txs = BlockTxDetailsJSON(block, hash);
+    } else {
+        txs.reserve(block.vtx.size());
+        BOOST_FOREACH (const CTransaction& tx, block.vtx)
             txs.push_back(tx.GetHash().GetHex());
     }
-    result.push_back(Pair("tx", txs));
+    result.push_back(Pair("tx", std::move(txs)));
     result.push_back(Pair("time", block.GetBlockTime()));
     result.push_back(Pair("nonce", (uint64_t)block.nNonce));
     result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
@@ -108,6 +153,103 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+// Streaming port of blockToJSON, serializing straight into the reply buffer.
+void blockToWriter(const CBlock& block, const CBlockIndex* blockindex, JSONWriter& w, bool txDetails = false)
+{
+    w.BeginObject();
+    w.Key("hash");
+    w.String(block.GetHash(blockindex->nHeight >= Params().SwitchPhi2Block()).GetHex());
+    int confirmations = -1;
+    // Only report confirmations if the block is on the main chain
+    if (chainActive.Contains(blockindex))
+        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    w.Key("confirmations");
+    w.Int(confirmations);
+    w.Key("size");
+    w.Int((int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    w.Key("height");
+    w.Int(blockindex->nHeight);
+    w.Key("version");
+    w.Int(block.nVersion);
+    w.Key("merkleroot");
+    w.String(block.hashMerkleRoot.GetHex());
+    w.Key("stateroot");
+    w.String(block.hashStateRoot.GetHex());
+    w.Key("utxoroot");
+    w.String(block.hashUTXORoot.GetHex());
+    w.Key("tx");
+    w.BeginArray();
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        if (txDetails) {
+            w.BeginObject();
+            TxToWriter(tx, uint256(), w);
+            w.EndObject();
+        } else
+            w.String(tx.GetHash().GetHex());
+    }
+    w.EndArray();
+    w.Key("time");
+    w.Int(block.GetBlockTime());
+    w.Key("nonce");
+    w.Int((uint64_t)block.nNonce);
+    w.Key("bits");
+    w.String(strprintf("%08x", block.nBits));
+    w.Key("difficulty");
+    w.Double(GetDifficulty(blockindex));
+    w.Key("flags");
+    w.String(strprintf("%s%s", blockindex->IsProofOfStake()?"proof-of-stake":"proof-of-work", blockindex->GeneratedStakeModifier()?" stake-modifier":""));
+    w.Key("chainwork");
+    w.String(blockindex->nChainWork.GetHex());
+
+    if (blockindex->pprev) {
+        w.Key("previousblockhash");
+        w.String(blockindex->pprev->GetBlockHash().GetHex());
+    }
+    CBlockIndex* pnext = chainActive.Next(blockindex);
+    if (pnext) {
+        w.Key("nextblockhash");
+        w.String(pnext->GetBlockHash().GetHex());
+    }
+    w.EndObject();
+}
+
+/** Streaming counterpart of getblock for the verbose case. Returns false when
+ * the call should fall back to the regular UniValue path (hex mode, malformed
+ * params, unknown block), which keeps every error surfaced through the one
+ * existing reporting path.
+ */
+bool GetBlockStreaming(const UniValue& params, const UniValue& id, std::string& strReply)
+{
+    if (params.size() < 1 || params.size() > 2 || !params[0].isStr())
+        return false;
+    if (params.size() > 1 && !(params[1].isBool() && params[1].get_bool()))
+        return false;
+
+    LOCK(cs_main);
+
+    uint256 hash(params[0].get_str());
+    if (mapBlockIndex.count(hash) == 0)
+        return false;
+
+    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    std::shared_ptr<const CBlock> pblock = FetchBlockShared(pblockindex, Params().GetConsensus());
+    if (!pblock)
+        return false;
+    const CBlock& block = *pblock;
+
+    // A txid entry costs 67 bytes; the fixed fields fit well inside the slack.
+    JSONWriter w(strReply, block.vtx.size() * 67 + 2048);
+    w.BeginObject();
+    w.Key("result");
+    blockToWriter(block, pblockindex, w);
+    w.Key("error");
+    w.Null();
+    w.Key("id");
+    w.Raw(id.write());
+    w.EndObject();
+    strReply += "\n";
+    return true;
+}
 
 UniValue blockHeaderToJSON(const CBlock& block, const CBlockIndex* blockindex)
 {
@@ -199,14 +341,12 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
             "\nExamples\n" +
             HelpExampleCli("getrawmempool", "true") + HelpExampleRpc("getrawmempool", "true"));
 
-    LOCK(cs_main);
-
     bool fVerbose = false;
     if (params.size() > 0)
         fVerbose = params[0].get_bool();
 
     if (fVerbose) {
-        LOCK(mempool.cs);
+        LOCK2(cs_main, mempool.cs);
         UniValue o(UniValue::VOBJ);
         BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx) {
             const uint256& hash = e.GetTx().GetHash();
@@ -235,12 +375,13 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
         }
         return o;
     } else {
-        vector<uint256> vtxid;
-        mempool.queryHashes(vtxid);
+        // Enumerate from the shared snapshot so polling clients don't
+        // serialize behind transaction acceptance (or each other).
+        CTxMemPool::SnapshotPtr snap = mempool.GetSnapshot();
 
         UniValue a(UniValue::VARR);
-        BOOST_FOREACH (const uint256& hash, vtxid)
-            a.push_back(hash.ToString());
+        BOOST_FOREACH (const TxMempoolInfo& txinfo, *snap)
+            a.push_back(txinfo.tx->GetHash().ToString());
 
         return a;
     }
@@ -329,12 +470,13 @@ UniValue getblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
-            "getblock \"hash\" ( verbose )\n"
-            "\nIf verbose is false, returns a string that is serialized, hex-encoded data for block 'hash'.\n"
-            "If verbose is true, returns an Object with information about block <hash>.\n"
+            "getblock \"hash\" ( verbosity )\n"
+            "\nIf verbosity is 0 (or false), returns a string that is serialized, hex-encoded data for block 'hash'.\n"
+            "If verbosity is 1 (or true), returns an Object with information about block <hash>.\n"
+            "If verbosity is 2, the tx field additionally contains decoded transactions.\n"
             "\nArguments:\n"
             "1. \"hash\"          (string, required) The block hash\n"
-            "2. verbose           (boolean, optional, default=true) true for a json object, false for the hex encoded data\n"
+            "2. verbosity         (numeric, optional, default=1) 0 for hex encoded data, 1 for a json object, 2 to include decoded transaction data\n"
             "\nResult (for verbose = true):\n"
             "{\n"
             "  \"hash\" : \"hash\",     (string) the block hash (same as provided)\n"
@@ -364,27 +506,28 @@ UniValue getblock(const UniValue& params, bool fHelp)
     std::string strHash = params[0].get_str();
     uint256 hash(strHash);
 
-    bool fVerbose = true;
+    int nVerbosity = 1;
     if (params.size() > 1)
-        fVerbose = params[1].get_bool();
+        nVerbosity = params[1].isNum() ? params[1].get_int() : (params[1].get_bool() ? 1 : 0);
 
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+    std::shared_ptr<const CBlock> pblock = FetchBlockShared(pblockindex, Params().GetConsensus());
+    if (!pblock)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    const CBlock& block = *pblock;
 
-    if (!fVerbose) {
+    if (nVerbosity <= 0) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
         ssBlock << block;
         std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex);
+    return blockToJSON(block, pblockindex, nVerbosity >= 2);
 }
 
 UniValue getstorage(const UniValue& params, bool fHelp)
@@ -502,6 +645,167 @@ UniValue listcontracts(const UniValue& params, bool fHelp)
         return result;
 }
 
+UniValue searchlogs(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 2 || params.size() > 4)
+        throw runtime_error(
+            "searchlogs fromBlock toBlock ( address topics )\n"
+            "\nSearch contract event logs. Requires -logevents to be enabled.\n"
+            "Blocks are pre-filtered through the per-block logs bloom index, so\n"
+            "only blocks that may contain a match are read from disk.\n"
+            "\nArguments:\n"
+            "1. fromBlock   (numeric, required) The first block height to search\n"
+            "2. toBlock     (numeric, required) The last block height to search, -1 for the chain tip\n"
+            "3. address     (object, optional) {\"addresses\":[\"hex\",...]} Contract addresses, any of which must have emitted the log\n"
+            "4. topics      (object, optional) {\"topics\":[\"hex\",...]} Topics that must all appear in a matching log\n"
+            "\nResult:\n"
+            "[                              (array, one entry per matching receipt)\n"
+            "  {\n"
+            "    \"blockHash\" : \"hash\",      (string) The block hash\n"
+            "    \"blockNumber\" : n,         (numeric) The block height\n"
+            "    \"transactionHash\" : \"id\",  (string) The transaction hash\n"
+            "    \"transactionIndex\" : n,    (numeric) Index of the transaction in the block\n"
+            "    \"from\" : \"hex\",            (string) The sender\n"
+            "    \"to\" : \"hex\",              (string) The recipient\n"
+            "    \"cumulativeGasUsed\" : n,   (numeric) Gas used by the block up to this transaction\n"
+            "    \"gasUsed\" : n,             (numeric) Gas used by this transaction\n"
+            "    \"contractAddress\" : \"hex\", (string) The contract the logs came from\n"
+            "    \"log\" : [                  (array) The matching log entries\n"
+            "      {\"address\": \"hex\", \"topics\": [\"hex\", ...], \"data\": \"hex\"}\n"
+            "      ,...\n"
+            "    ]\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("searchlogs", "0 100 '{\"addresses\":[\"12ae42729af478ca92c8c66773a3e32115717be4\"]}' '{\"topics\":[\"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"]}'") +
+            HelpExampleRpc("searchlogs", "0, 100, {\"addresses\":[\"12ae42729af478ca92c8c66773a3e32115717be4\"]}, {\"topics\":[\"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"]}"));
+
+    if (!fLogEvents)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled, add -logevents to enable it");
+
+    LOCK(cs_main);
+
+    int fromBlock = params[0].get_int();
+    int toBlock = params[1].get_int();
+    if (toBlock < 0)
+        toBlock = chainActive.Height();
+    fromBlock = std::max(fromBlock, 0);
+    toBlock = std::min(toBlock, chainActive.Height());
+    if (fromBlock > toBlock)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "fromBlock greater than toBlock");
+
+    std::vector<dev::Address> vAddresses;
+    if (params.size() > 2 && !params[2].isNull()) {
+        const UniValue& addrArr = find_value(params[2].get_obj(), "addresses").get_array();
+        for (size_t i = 0; i < addrArr.size(); i++) {
+            const std::string& strAddr = addrArr[i].get_str();
+            if (strAddr.size() != 40 || !CheckHex(strAddr))
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+            vAddresses.push_back(dev::Address(strAddr));
+        }
+    }
+
+    std::vector<dev::h256> vTopics;
+    if (params.size() > 3 && !params[3].isNull()) {
+        const UniValue& topicArr = find_value(params[3].get_obj(), "topics").get_array();
+        for (size_t i = 0; i < topicArr.size(); i++) {
+            const std::string& strTopic = topicArr[i].get_str();
+            if (strTopic.size() != 64 || !CheckHex(strTopic))
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect topic");
+            vTopics.push_back(dev::h256(strTopic));
+        }
+    }
+
+    // The bloom probes can be hashed once for the whole scan.
+    std::vector<dev::h256> vAddressHashes;
+    for (const dev::Address& addr : vAddresses)
+        vAddressHashes.push_back(dev::sha3(addr.ref()));
+    std::vector<dev::h256> vTopicHashes;
+    for (const dev::h256& topic : vTopics)
+        vTopicHashes.push_back(dev::sha3(topic.ref()));
+
+    UniValue result(UniValue::VARR);
+    for (int nHeight = fromBlock; nHeight <= toBlock; nHeight++) {
+        CBlockIndex* pblockindex = chainActive[nHeight];
+
+        // No stored bloom means the block produced no logs at all.
+        std::vector<unsigned char> vBloom;
+        if (!pblocktree->ReadLogsBloom(pblockindex->GetBlockHash(), vBloom))
+            continue;
+        dev::eth::LogBloom bloom;
+        if (vBloom.size() == bloom.size)
+            memcpy(bloom.data(), vBloom.data(), bloom.size);
+
+        bool fMaybeMatch = true;
+        if (!vAddressHashes.empty()) {
+            fMaybeMatch = false;
+            for (const dev::h256& hash : vAddressHashes)
+                if (bloom.containsBloom<3>(hash)) {
+                    fMaybeMatch = true;
+                    break;
+                }
+        }
+        if (fMaybeMatch)
+            for (const dev::h256& hash : vTopicHashes)
+                if (!bloom.containsBloom<3>(hash)) {
+                    fMaybeMatch = false;
+                    break;
+                }
+        if (!fMaybeMatch)
+            continue;
+
+        // Deliberately not FetchBlockShared: a range scan would only churn
+        // the small shared cache without ever hitting it.
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+        for (const CTransaction& tx : block.vtx) {
+            std::vector<TransactionReceiptInfo> receipts = pstorageresult->getResult(uintToh256(tx.GetHash()));
+            for (const TransactionReceiptInfo& receipt : receipts) {
+                UniValue logEntries(UniValue::VARR);
+                for (const dev::eth::LogEntry& log : receipt.logs) {
+                    if (!vAddresses.empty() && std::find(vAddresses.begin(), vAddresses.end(), log.address) == vAddresses.end())
+                        continue;
+                    bool fTopicsMatch = true;
+                    for (const dev::h256& topic : vTopics)
+                        if (std::find(log.topics.begin(), log.topics.end(), topic) == log.topics.end()) {
+                            fTopicsMatch = false;
+                            break;
+                        }
+                    if (!fTopicsMatch)
+                        continue;
+                    UniValue logEntry(UniValue::VOBJ);
+                    logEntry.push_back(Pair("address", log.address.hex()));
+                    UniValue topics(UniValue::VARR);
+                    for (const dev::h256& topic : log.topics)
+                        topics.push_back(topic.hex());
+                    logEntry.push_back(Pair("topics", topics));
+                    logEntry.push_back(Pair("data", dev::toHex(log.data)));
+                    logEntries.push_back(logEntry);
+                }
+                if (logEntries.empty())
+                    continue;
+
+                UniValue obj(UniValue::VOBJ);
+                obj.push_back(Pair("blockHash", receipt.blockHash.GetHex()));
+                obj.push_back(Pair("blockNumber", (int64_t)receipt.blockNumber));
+                obj.push_back(Pair("transactionHash", receipt.transactionHash.GetHex()));
+                obj.push_back(Pair("transactionIndex", (int64_t)receipt.transactionIndex));
+                obj.push_back(Pair("from", receipt.from.hex()));
+                obj.push_back(Pair("to", receipt.to.hex()));
+                obj.push_back(Pair("cumulativeGasUsed", (int64_t)receipt.cumulativeGasUsed));
+                obj.push_back(Pair("gasUsed", (int64_t)receipt.gasUsed));
+                obj.push_back(Pair("contractAddress", receipt.contractAddress.hex()));
+                obj.push_back(Pair("log", logEntries));
+                result.push_back(obj);
+            }
+        }
+    }
+    return result;
+}
+
 UniValue pruneblockchain(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -601,6 +905,49 @@ UniValue getaccountinfo(const UniValue& params, bool fHelp)
     return result;
 }
 
+UniValue getevminfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+                "getevminfo\n"
+                "\nReturns statistics about the EVM state databases, including the shared\n"
+                "trie node and contract code cache controlled by -evmcachesize.\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"stateroot\": \"hash\",        (string) The current state trie root\n"
+                "  \"utxoroot\": \"hash\",         (string) The current UTXO trie root\n"
+                "  \"cache\": {\n"
+                "    \"size\": n,                (numeric) Configured cache capacity in bytes\n"
+                "    \"used\": n,                (numeric) Bytes currently cached\n"
+                "    \"entries\": n,             (numeric) Number of cached nodes\n"
+                "    \"hits\": n,                (numeric) Cache hits since startup\n"
+                "    \"misses\": n,              (numeric) Cache misses since startup\n"
+                "    \"hitrate\": x.xxx          (numeric) hits / (hits + misses)\n"
+                "  }\n"
+                "}\n"
+                "\nExamples:\n"
+                + HelpExampleCli("getevminfo", "")
+                + HelpExampleRpc("getevminfo", ""));
+
+    LOCK(cs_main);
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("stateroot", globalState->rootHash().hex()));
+    result.push_back(Pair("utxoroot", globalState->rootHashUTXO().hex()));
+
+    dev::OverlayDBCacheStats stats = dev::overlayDBCacheStats();
+    UniValue cache(UniValue::VOBJ);
+    cache.push_back(Pair("size", (uint64_t)stats.capacity));
+    cache.push_back(Pair("used", (uint64_t)stats.memory));
+    cache.push_back(Pair("entries", (uint64_t)stats.entries));
+    cache.push_back(Pair("hits", stats.hits));
+    cache.push_back(Pair("misses", stats.misses));
+    uint64_t nLookups = stats.hits + stats.misses;
+    cache.push_back(Pair("hitrate", nLookups ? (double)stats.hits / nLookups : 0.0));
+    result.push_back(Pair("cache", cache));
+    return result;
+}
+
 UniValue getblockheader(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -637,11 +984,12 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+    std::shared_ptr<const CBlock> pblock = FetchBlockShared(pblockindex, Params().GetConsensus());
+    if (!pblock)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    const CBlock& block = *pblock;
 
     if (!fVerbose) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
@@ -668,6 +1016,7 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
             "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"utxo_set_hash\": \"hash\",     (string, optional) The rolling UTXO set hash, if -utxosethash is enabled\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n" +
@@ -686,11 +1035,278 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
         ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
         ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        if (fUtxoSetHash && utxoSetHash.IsValid())
+            ret.push_back(Pair("utxo_set_hash", utxoSetHash.GetHash().GetHex()));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
     }
     return ret;
 }
 
+//! Per-block aggregates for getblockstats. Workers fill these plain
+//! accumulators; JSON is only produced for the final, tiny result.
+struct CBlockStatsEntry {
+    int nHeight;
+    int64_t nTime;
+    uint64_t nTxs;
+    uint64_t nSize;
+    uint64_t nSigOps;
+    CAmount nTotalOut;
+    CAmount nTotalFee;
+    CAmount nMinFeeRate;
+    CAmount nMaxFeeRate;
+    CAmount feeRatePercentiles[5]; //!< 10/25/50/75/90th, weighted by tx size
+    int64_t nUtxoDelta;
+    bool fOk;
+
+    CBlockStatsEntry() : nHeight(0), nTime(0), nTxs(0), nSize(0), nSigOps(0), nTotalOut(0), nTotalFee(0), nMinFeeRate(-1), nMaxFeeRate(0), nUtxoDelta(0), fOk(false)
+    {
+        for (int i = 0; i < 5; i++)
+            feeRatePercentiles[i] = 0;
+    }
+};
+
+/** Compute stats for every nStride-th entry of vIndex starting at nOffset.
+ *  Block and undo reads go straight to the block files, so workers need no
+ *  locks; the CBlockIndex pointers were snapshotted under cs_main and the
+ *  entries themselves never move. */
+static void BlockStatsWorker(const std::vector<CBlockIndex*>& vIndex, size_t nOffset, size_t nStride, std::vector<CBlockStatsEntry>& vStats)
+{
+    const Consensus::Params& consensus = Params().GetConsensus();
+    for (size_t i = nOffset; i < vIndex.size(); i += nStride) {
+        CBlockIndex* pindex = vIndex[i];
+        CBlockStatsEntry& entry = vStats[i];
+        entry.nHeight = pindex->nHeight;
+        entry.nTime = pindex->GetBlockTime();
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensus))
+            continue; // entry.fOk stays false
+
+        CBlockUndo blockUndo;
+        bool fHaveUndo = false;
+        if (pindex->pprev && !pindex->GetUndoPos().IsNull())
+            fHaveUndo = blockUndo.ReadFromDisk(pindex->GetUndoPos(), pindex->pprev->GetBlockHash()) &&
+                        blockUndo.vtxundo.size() + 1 == block.vtx.size();
+
+        entry.nTxs = block.vtx.size();
+        entry.nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+
+        std::vector<std::pair<CAmount, uint64_t> > vFeeRates; // (feerate, tx size)
+        vFeeRates.reserve(block.vtx.size());
+        uint64_t nFeeSize = 0;
+
+        for (size_t n = 0; n < block.vtx.size(); n++) {
+            const CTransaction& tx = block.vtx[n];
+            entry.nSigOps += GetLegacySigOpCount(tx);
+            BOOST_FOREACH (const CTxOut& txout, tx.vout) {
+                entry.nTotalOut += txout.nValue;
+                if (!txout.IsNull() && !txout.scriptPubKey.IsUnspendable())
+                    entry.nUtxoDelta++;
+            }
+            if (tx.IsCoinBase())
+                continue;
+            entry.nUtxoDelta -= (int64_t)tx.vin.size();
+            // Coinstakes mint their reward inside the transaction, so a fee
+            // derived from prevouts would come out negative; skip them.
+            if (tx.IsCoinStake() || !fHaveUndo || n == 0)
+                continue;
+            const CTxUndo& txundo = blockUndo.vtxundo[n - 1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                continue;
+            CAmount nValueIn = 0;
+            BOOST_FOREACH (const CTxInUndo& in, txundo.vprevout)
+                nValueIn += in.txout.nValue;
+            CAmount nFee = nValueIn - tx.GetValueOut();
+            if (nFee < 0)
+                continue;
+            uint64_t nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+            CAmount nFeeRate = nTxSize ? nFee * 1000 / nTxSize : 0;
+            entry.nTotalFee += nFee;
+            if (entry.nMinFeeRate < 0 || nFeeRate < entry.nMinFeeRate)
+                entry.nMinFeeRate = nFeeRate;
+            if (nFeeRate > entry.nMaxFeeRate)
+                entry.nMaxFeeRate = nFeeRate;
+            vFeeRates.push_back(std::make_pair(nFeeRate, nTxSize));
+            nFeeSize += nTxSize;
+        }
+
+        if (!vFeeRates.empty() && nFeeSize > 0) {
+            std::sort(vFeeRates.begin(), vFeeRates.end());
+            static const double vPercentiles[5] = {0.10, 0.25, 0.50, 0.75, 0.90};
+            uint64_t nCumSize = 0;
+            size_t p = 0;
+            for (size_t j = 0; j < vFeeRates.size() && p < 5; j++) {
+                nCumSize += vFeeRates[j].second;
+                while (p < 5 && (double)nCumSize >= vPercentiles[p] * nFeeSize) {
+                    entry.feeRatePercentiles[p] = vFeeRates[j].first;
+                    p++;
+                }
+            }
+        }
+        if (entry.nMinFeeRate < 0)
+            entry.nMinFeeRate = 0;
+        entry.fOk = true;
+    }
+}
+
+UniValue getblockstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getblockstats height ( count )\n"
+            "\nComputes per-block statistics (fees, feerate percentiles, size, sigops,\n"
+            "UTXO delta) for a range of blocks directly from the block and undo files.\n"
+            "The range is processed by multiple worker threads.\n"
+            "\nArguments:\n"
+            "1. height            (numeric, required) The height of the first block\n"
+            "2. count             (numeric, optional, default=1) Number of blocks, capped to the chain tip\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"height\": n,          (numeric) Block height\n"
+            "    \"time\": ttt,          (numeric) Block time in seconds since epoch\n"
+            "    \"txs\": n,             (numeric) Number of transactions\n"
+            "    \"total_size\": n,      (numeric) Serialized block size\n"
+            "    \"sigops\": n,          (numeric) Legacy sigop count\n"
+            "    \"total_out\": x.xxx,   (numeric) Total output value\n"
+            "    \"total_fee\": x.xxx,   (numeric) Total fees (coinstakes excluded)\n"
+            "    \"minfeerate\": n,      (numeric) Minimum feerate, in satoshis per kB\n"
+            "    \"maxfeerate\": n,      (numeric) Maximum feerate, in satoshis per kB\n"
+            "    \"feerate_percentiles\": [n,n,n,n,n], (array) 10th/25th/50th/75th/90th percentile feerates, weighted by tx size\n"
+            "    \"utxo_increase\": n,   (numeric) Change in number of unspent outputs\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getblockstats", "100000 1000") + HelpExampleRpc("getblockstats", "100000, 1000"));
+
+    static const int MAX_BLOCKSTATS_RANGE = 100000;
+
+    int nStart = params[0].get_int();
+    int nCount = 1;
+    if (params.size() > 1)
+        nCount = params[1].get_int();
+    if (nCount < 1 || nCount > MAX_BLOCKSTATS_RANGE)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count out of range (1-%d)", MAX_BLOCKSTATS_RANGE));
+
+    std::vector<CBlockIndex*> vIndex;
+    {
+        LOCK(cs_main);
+        if (nStart < 0 || nStart > chainActive.Height())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+        nCount = std::min(nCount, chainActive.Height() - nStart + 1);
+        vIndex.reserve(nCount);
+        for (int h = nStart; h < nStart + nCount; h++)
+            vIndex.push_back(chainActive[h]);
+    }
+
+    std::vector<CBlockStatsEntry> vStats(vIndex.size());
+    size_t nThreads = std::max<size_t>(1, std::min<size_t>(boost::thread::hardware_concurrency(), std::min<size_t>(vIndex.size(), 8)));
+    if (nThreads <= 1) {
+        BlockStatsWorker(vIndex, 0, 1, vStats);
+    } else {
+        boost::thread_group workers;
+        for (size_t t = 0; t < nThreads; t++)
+            workers.create_thread(boost::bind(&BlockStatsWorker, boost::cref(vIndex), t, nThreads, boost::ref(vStats)));
+        workers.join_all();
+    }
+
+    UniValue ret(UniValue::VARR);
+    BOOST_FOREACH (const CBlockStatsEntry& entry, vStats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("height", entry.nHeight));
+        if (!entry.fOk) {
+            obj.push_back(Pair("error", "block data unavailable"));
+            ret.push_back(obj);
+            continue;
+        }
+        obj.push_back(Pair("time", entry.nTime));
+        obj.push_back(Pair("txs", entry.nTxs));
+        obj.push_back(Pair("total_size", entry.nSize));
+        obj.push_back(Pair("sigops", entry.nSigOps));
+        obj.push_back(Pair("total_out", ValueFromAmount(entry.nTotalOut)));
+        obj.push_back(Pair("total_fee", ValueFromAmount(entry.nTotalFee)));
+        obj.push_back(Pair("minfeerate", entry.nMinFeeRate));
+        obj.push_back(Pair("maxfeerate", entry.nMaxFeeRate));
+        UniValue percentiles(UniValue::VARR);
+        for (int i = 0; i < 5; i++)
+            percentiles.push_back(entry.feeRatePercentiles[i]);
+        obj.push_back(Pair("feerate_percentiles", percentiles));
+        obj.push_back(Pair("utxo_increase", entry.nUtxoDelta));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites a hash-committed snapshot of the chainstate to disk. The\n"
+            "snapshot can bootstrap a new node through loadtxoutset instead of a\n"
+            "full sync. Note the node is blocked while the set is serialized.\n"
+            "\nArguments:\n"
+            "1. \"path\"   (string, required) The output file; relative paths are under the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins\": n,             (numeric) the number of coin records written\n"
+            "  \"base_hash\": \"hex\",     (string) the hash of the block the snapshot commits to\n"
+            "  \"base_height\": n        (numeric) the height of that block\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") + HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+
+    std::string strError;
+    int nHeight = 0;
+    uint64_t nCoins = 0;
+    uint256 hashBase;
+    if (!DumpUTXOSnapshot(params[0].get_str(), strError, nHeight, nCoins, hashBase))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins", (int64_t)nCoins));
+    ret.push_back(Pair("base_hash", hashBase.GetHex()));
+    ret.push_back(Pair("base_height", nHeight));
+    return ret;
+}
+
+UniValue loadtxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nReplaces the chainstate with a snapshot written by dumptxoutset and\n"
+            "moves the active chain to the snapshot's base block, after which the\n"
+            "node syncs forward from there. The header chain must already contain\n"
+            "the base block.\n"
+            "\nWARNING: the snapshot is trusted. Blocks below its base are neither\n"
+            "revalidated nor available on disk afterwards, and a load failure\n"
+            "leaves a chainstate that must be rebuilt with -reindex.\n"
+            "\nArguments:\n"
+            "1. \"path\"   (string, required) The snapshot file; relative paths are under the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins\": n,             (numeric) the number of coin records loaded\n"
+            "  \"base_hash\": \"hex\",     (string) the hash of the new tip\n"
+            "  \"base_height\": n        (numeric) the height of the new tip\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("loadtxoutset", "\"utxo.dat\"") + HelpExampleRpc("loadtxoutset", "\"utxo.dat\""));
+
+    std::string strError;
+    int nHeight = 0;
+    uint64_t nCoins = 0;
+    uint256 hashBase;
+    if (!LoadUTXOSnapshot(params[0].get_str(), strError, nHeight, nCoins, hashBase))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins", (int64_t)nCoins));
+    ret.push_back(Pair("base_hash", hashBase.GetHex()));
+    ret.push_back(Pair("base_height", nHeight));
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -817,6 +1433,25 @@ static UniValue BIP9SoftForkDesc(const Consensus::Params& consensusParams, Conse
     return rv;
 }
 
+//! Collect internal leveldb statistics for one database into a JSON object;
+//! getProperty wraps the database's property query.
+static UniValue LevelDBStatsToJSON(boost::function<bool(const std::string&, std::string&)> getProperty)
+{
+    UniValue obj(UniValue::VOBJ);
+    UniValue files(UniValue::VARR);
+    for (int nLevel = 0;; nLevel++) {
+        std::string strValue;
+        if (!getProperty(strprintf("leveldb.num-files-at-level%d", nLevel), strValue))
+            break;
+        files.push_back(atoi(strValue.c_str()));
+    }
+    obj.push_back(Pair("files_at_level", files));
+    std::string strStats;
+    if (getProperty("leveldb.stats", strStats))
+        obj.push_back(Pair("stats", strStats));
+    return obj;
+}
+
 UniValue getblockchaininfo(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -841,6 +1476,12 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "        \"timeout\": xx          (numeric) the median time past of a block at which the deployment is considered failed if not yet locked in\n"
             "     }\n"
             "  }\n"
+            "  \"leveldb\": {                 (object) internal statistics of the leveldb databases\n"
+            "     \"chainstate\": {           (object) one entry per database (chainstate, blockindex, storageresults)\n"
+            "        \"files_at_level\": [..],(array) number of sstable files at each level\n"
+            "        \"stats\": \"xxxx\"        (string) compaction and read statistics\n"
+            "     }\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getblockchaininfo", "")
@@ -865,6 +1506,15 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
     bip9_softforks.push_back(Pair("segwit", BIP9SoftForkDesc(consensusParams, Consensus::DEPLOYMENT_SEGWIT)));
     obj.push_back(Pair("bip9_softforks", bip9_softforks));
 
+    UniValue dbstats(UniValue::VOBJ);
+    if (pcoinsdbview)
+        dbstats.push_back(Pair("chainstate", LevelDBStatsToJSON(boost::bind(&CCoinsViewDB::GetDbProperty, pcoinsdbview, _1, _2))));
+    if (pblocktree)
+        dbstats.push_back(Pair("blockindex", LevelDBStatsToJSON(boost::bind(&CLevelDBWrapper::GetProperty, pblocktree, _1, _2))));
+    if (pstorageresult)
+        dbstats.push_back(Pair("storageresults", LevelDBStatsToJSON(boost::bind(&StorageResults::GetProperty, pstorageresult, _1, _2))));
+    obj.push_back(Pair("leveldb", dbstats));
+
     return obj;
 }
 
@@ -978,15 +1628,23 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "{\n"
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
+            "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) Maximum memory usage for the mempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) Minimum feerate (" + CURRENCY_UNIT + " per KB) for tx to be accepted\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getmempoolinfo", "") + HelpExampleRpc("getmempoolinfo", ""));
 
     LOCK(cs_main);
 
+    size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+
     UniValue ret(UniValue::VOBJ);
     ret.push_back(Pair("size", (int64_t)mempool.size()));
     ret.push_back(Pair("bytes", (int64_t)mempool.GetTotalTxSize()));
+    ret.push_back(Pair("usage", (int64_t)mempool.DynamicMemoryUsage()));
+    ret.push_back(Pair("maxmempool", (int64_t)maxmempool));
+    ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
 
     return ret;
 }
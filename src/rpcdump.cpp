@@ -16,10 +16,13 @@
 #include "utiltime.h"
 #include "wallet.h"
 
+#include <atomic>
 #include <fstream>
 #include <secp256k1.h>
 #include <stdint.h>
 
+#include <boost/thread.hpp>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/filesystem.hpp>
@@ -104,6 +107,7 @@ UniValue importprivkey(const UniValue& params, bool fHelp)
         LOCK2(cs_main, pwalletMain->cs_wallet);
 
         EnsureWalletIsUnlocked();
+        EnsureWalletIsWritable();
 
         string strSecret = params[0].get_str();
         string strLabel = "";
@@ -192,6 +196,8 @@ UniValue importaddress(const UniValue& params, bool fHelp)
 
     LOCK2(cs_main, pwalletMain->cs_wallet);
 
+    EnsureWalletIsWritable();
+
     CScript script;
 
     CTxDestination dest = DecodeDestination(params[0].get_str());
@@ -239,6 +245,89 @@ UniValue importaddress(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+UniValue importaddresses(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "importaddresses [\"address\",...] ( \"label\" rescan )\n"
+            "\nAdds a batch of addresses or scripts (in hex) that can be watched as if they were in your wallet but cannot be used to spend.\n"
+            "Unlike calling importaddress repeatedly, the wallet is rescanned at most once, after the whole batch is registered.\n"
+            "\nArguments:\n"
+            "1. \"addresses\"        (array, required) The addresses and/or hex scripts to watch\n"
+            "2. \"label\"            (string, optional, default=\"\") An optional label applied to every address\n"
+            "3. rescan               (boolean, optional, default=true) Rescan the wallet for transactions\n"
+            "\nNote: This call can take minutes to complete if rescan is true.\n"
+            "\nExamples:\n"
+            "\nImport two addresses with a single rescan\n" +
+            HelpExampleCli("importaddresses", "\"[\\\"myaddress1\\\",\\\"myaddress2\\\"]\"") +
+            "\nImport a batch without rescan\n" + HelpExampleCli("importaddresses", "\"[\\\"myaddress1\\\",\\\"myaddress2\\\"]\" \"deposits\" false") +
+            "\nAs a JSON-RPC call\n" + HelpExampleRpc("importaddresses", "[\"myaddress1\",\"myaddress2\"], \"deposits\", false"));
+
+    UniValue addresses = params[0].get_array();
+
+    string strLabel = "";
+    if (params.size() > 1)
+        strLabel = params[1].get_str();
+
+    // Whether to perform rescan after import
+    bool fRescan = true;
+    if (params.size() > 2)
+        fRescan = params[2].get_bool();
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    EnsureWalletIsWritable();
+
+    // Parse the whole batch before touching the wallet, so a bad entry
+    // doesn't leave a partial import behind.
+    std::vector<CScript> vScripts;
+    std::vector<CTxDestination> vDests;
+    vScripts.reserve(addresses.size());
+    vDests.reserve(addresses.size());
+    for (unsigned int i = 0; i < addresses.size(); i++) {
+        const std::string& strAddress = addresses[i].get_str();
+        CScript script;
+        CTxDestination dest = DecodeDestination(strAddress);
+        if (IsValidDestination(dest)) {
+            script = GetScriptForDestination(dest);
+        } else if (IsHex(strAddress)) {
+            std::vector<unsigned char> data(ParseHex(strAddress));
+            script = CScript(data.begin(), data.end());
+        } else {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("Invalid LUX address or script: %s", strAddress));
+        }
+        if (::IsMine(*pwalletMain, script) == ISMINE_SPENDABLE)
+            throw JSONRPCError(RPC_WALLET_ERROR, strprintf("The wallet already contains the private key for this address or script: %s", strAddress));
+        vScripts.push_back(script);
+        vDests.push_back(dest);
+    }
+
+    bool fAdded = false;
+    for (unsigned int i = 0; i < vScripts.size(); i++) {
+        // add to address book or update label
+        if (IsValidDestination(vDests[i]))
+            pwalletMain->SetAddressBook(vDests[i], strLabel, "receive");
+
+        // Don't throw error in case an address is already there
+        if (pwalletMain->HaveWatchOnly(vScripts[i]))
+            continue;
+
+        if (!pwalletMain->AddWatchOnly(vScripts[i]))
+            throw JSONRPCError(RPC_WALLET_ERROR, "Error adding address to wallet");
+        fAdded = true;
+    }
+
+    if (fAdded) {
+        pwalletMain->MarkDirty();
+        if (fRescan) {
+            pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+            pwalletMain->ReacceptWalletTransactions();
+        }
+    }
+
+    return NullUniValue;
+}
+
 UniValue importwallet(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -256,6 +345,7 @@ UniValue importwallet(const UniValue& params, bool fHelp)
     LOCK2(cs_main, pwalletMain->cs_wallet);
 
     EnsureWalletIsUnlocked();
+    EnsureWalletIsWritable();
 
     ifstream file;
     file.open(params[0].get_str().c_str(), std::ios::in | std::ios::ate);
@@ -542,3 +632,116 @@ UniValue bip38decrypt(const UniValue& params, bool fHelp)
 
     return result;
 }
+
+UniValue bip38decryptbatch(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "bip38decryptbatch \"passphrase\" [\"encryptedkey\",...]\n"
+            "\nDecrypts a batch of password protected private keys in parallel across cores,\n"
+            "imports them and rescans the chain once at the end.\n"
+            "\nArguments:\n"
+            "1. \"passphrase\"      (string, required) The passphrase the keys are encrypted with\n"
+            "2. \"encryptedkeys\"   (array, required) The encrypted private keys\n"
+
+            "\nResult:\n"
+            "[                    (array) one entry per key, in input order\n"
+            "  {\n"
+            "    \"privatekey\": \"key\",      (string) The decrypted private key\n"
+            "    \"Address\": \"address\"     (string) The key's address\n"
+            "  }\n"
+            "]\n"
+            "\nExamples:\n");
+
+    string strPassphrase = params[0].get_str();
+    UniValue keys = params[1].get_array();
+    if (keys.empty())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Empty array of encrypted keys");
+
+    std::vector<std::string> vstrKeys;
+    for (unsigned int i = 0; i < keys.size(); i++)
+        vstrKeys.push_back(keys[i].get_str());
+
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        EnsureWalletIsUnlocked();
+    }
+
+    // Decrypt outside the wallet locks; each key costs a full scrypt pass,
+    // so spread the batch across cores.
+    const size_t nKeys = vstrKeys.size();
+    std::vector<uint256> vPrivKeys(nKeys);
+    std::vector<char> vfCompressed(nKeys, 0);
+    std::vector<char> vfDecrypted(nKeys, 0);
+    std::atomic<size_t> nNext(0);
+    int nThreads = std::max(1, std::min((int)nKeys, GetNumCores()));
+    boost::thread_group group;
+    for (int n = 0; n < nThreads; n++) {
+        group.create_thread([&] {
+            size_t i;
+            while ((i = nNext.fetch_add(1)) < nKeys) {
+                uint256 privKey;
+                bool fCompressed = false;
+                if (BIP38_Decrypt(strPassphrase, vstrKeys[i], privKey, fCompressed)) {
+                    vPrivKeys[i] = privKey;
+                    vfCompressed[i] = fCompressed;
+                    vfDecrypted[i] = 1;
+                }
+            }
+        });
+    }
+    group.join_all();
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    EnsureWalletIsUnlocked();
+
+    UniValue results(UniValue::VARR);
+    results.reserve(nKeys);
+    bool fAdded = false;
+    pwalletMain->MarkDirty();
+    for (size_t i = 0; i < nKeys; i++) {
+        UniValue result(UniValue::VOBJ);
+        if (!vfDecrypted[i]) {
+            result.push_back(Pair("error", "Failed To Decrypt"));
+            results.push_back(std::move(result));
+            continue;
+        }
+        result.push_back(Pair("privatekey", HexStr(vPrivKeys[i])));
+
+        CKey key;
+        key.Set(vPrivKeys[i].begin(), vPrivKeys[i].end(), vfCompressed[i]);
+        if (!key.IsValid()) {
+            result.push_back(Pair("error", "Private Key Not Valid"));
+            results.push_back(std::move(result));
+            continue;
+        }
+
+        CPubKey pubkey = key.GetPubKey();
+        assert(key.VerifyPubKey(pubkey));
+        result.push_back(Pair("Address", EncodeDestination(pubkey.GetID())));
+        CKeyID vchAddress = pubkey.GetID();
+
+        // Don't throw in case a key is already there; report it and keep going
+        if (pwalletMain->HaveKey(vchAddress)) {
+            result.push_back(Pair("error", "Key already held by wallet"));
+            results.push_back(std::move(result));
+            continue;
+        }
+
+        pwalletMain->SetAddressBook(vchAddress, "", "receive");
+        pwalletMain->mapKeyMetadata[vchAddress].nCreateTime = 1;
+        if (!pwalletMain->AddKeyPubKey(key, pubkey))
+            throw JSONRPCError(RPC_WALLET_ERROR, "Error adding key to wallet");
+        fAdded = true;
+        results.push_back(std::move(result));
+    }
+
+    // whenever a key is imported, we need to scan the whole chain; once for
+    // the whole batch
+    if (fAdded) {
+        pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
+        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+    }
+
+    return results;
+}
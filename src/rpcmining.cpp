@@ -548,9 +548,21 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     // Cache whether the last invocation was with segwit support, to avoid returning
     // a segwit-block to a non-segwit caller.
     static bool fLastTemplateSupportsSegwit = true;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
-        fLastTemplateSupportsSegwit != fSupportsSegwit) {
+    bool fRebuild = pindexPrev != chainActive.Tip() ||
+        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60) ||
+        fLastTemplateSupportsSegwit != fSupportsSegwit;
+    if (!fRebuild && pblocktemplate &&
+        mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) {
+        // Same tip, only new transactions: append them to the cached template
+        // instead of running a full reselection. A full rebuild still happens
+        // when the tip changes or once a minute, to pick up better-paying
+        // replacements, contract transactions and evictions.
+        if (BlockAssembler(Params()).AppendNewTransactions(pblocktemplate.get()))
+            nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+        else
+            fRebuild = true;
+    }
+    if (fRebuild) {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = NULL;
 
@@ -1019,6 +1031,42 @@ UniValue estimatefee(const UniValue& params, bool fHelp)
     return ValueFromAmount(feeRate.GetFeePerK());
 }
 
+UniValue estimatefeepercentile(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "estimatefeepercentile nblocks percentile\n"
+            "\nEstimates the approximate fee per kilobyte needed for a transaction\n"
+            "to begin confirmation within nblocks blocks with the given\n"
+            "confirmation probability.\n"
+            "\nArguments:\n"
+            "1. nblocks     (numeric)\n"
+            "2. percentile  (numeric) required confirmation probability, 0.5 to 0.99\n"
+            "\nResult:\n"
+            "n :    (numeric) estimated fee-per-kilobyte\n"
+            "\n"
+            "-1.0 is returned if not enough transactions and\n"
+            "blocks have been observed to make an estimate.\n"
+            "\nExample:\n" +
+            HelpExampleCli("estimatefeepercentile", "6 0.8"));
+
+    RPCTypeCheck(params, boost::assign::list_of(UniValue::VNUM)(UniValue::VNUM));
+
+    int nBlocks = params[0].get_int();
+    if (nBlocks < 1)
+        nBlocks = 1;
+
+    double successPct = params[1].get_real();
+    if (successPct < 0.5 || successPct > 0.99)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Percentile must be between 0.5 and 0.99");
+
+    CFeeRate feeRate = mempool.estimateFeePercentile(nBlocks, successPct);
+    if (feeRate == CFeeRate(0))
+        return -1.0;
+
+    return ValueFromAmount(feeRate.GetFeePerK());
+}
+
 UniValue estimatepriority(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
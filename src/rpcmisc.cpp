@@ -5,8 +5,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "addrman.h"
 #include "base58.h"
 #include "clientversion.h"
+#include "core_memusage.h"
+#include "perf.h"
+#include "script/sigcache.h"
+#include "sync.h"
 #include "init.h"
 #include "main.h"
 #include "stake.h"
@@ -22,6 +27,7 @@
 #include "walletdb.h"
 #endif
 
+#include <atomic>
 #include <stdint.h>
 
 #include <boost/assign/list_of.hpp>
@@ -120,6 +126,126 @@ UniValue getinfo(const UniValue& params, bool fHelp)
     return obj;
 }
 
+#if defined(__linux__)
+//! Read a kB-denominated field (e.g. "VmRSS") from /proc/self/status.
+static bool ReadProcStatusKB(const char* pszField, int64_t& nKiB)
+{
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file)
+        return false;
+    char szLine[256];
+    size_t nFieldLen = strlen(pszField);
+    bool fFound = false;
+    while (fgets(szLine, sizeof(szLine), file)) {
+        if (strncmp(szLine, pszField, nFieldLen) == 0 && szLine[nFieldLen] == ':') {
+            nKiB = atoll(szLine + nFieldLen + 1);
+            fFound = true;
+            break;
+        }
+    }
+    fclose(file);
+    return fFound;
+}
+#endif
+
+UniValue getmemoryinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns a per-component breakdown of dynamic memory usage, in bytes.\n"
+            "The figures are estimates from the memusage accounting, not allocator\n"
+            "measurements; \"peak\" is the largest total observed by this call.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"components\": {\n"
+            "    \"mempool\": n,           (numeric) transaction memory pool\n"
+            "    \"utxo_cache\": n,        (numeric) in-memory coins cache\n"
+            "    \"block_index\": n,       (numeric) mapBlockIndex and CBlockIndex entries\n"
+            "    \"sig_cache\": n,         (numeric) signature verification cache\n"
+            "    \"addrman\": n,           (numeric) peer address manager tables\n"
+            "    \"net_send_buffers\": n,  (numeric) queued outbound messages, all peers\n"
+            "    \"net_recv_buffers\": n,  (numeric) buffered inbound messages, all peers\n"
+            "    \"wallet\": n,            (numeric) in-memory wallet maps (if enabled)\n"
+            "    \"evm_cache\": n          (numeric) shared EVM trie node/code cache\n"
+            "  },\n"
+            "  \"total\": n,               (numeric) sum of the components above\n"
+            "  \"peak_total\": n,          (numeric) largest total seen since startup (sampled)\n"
+            "  \"vm_rss\": n,              (numeric, linux only) resident set size of the process\n"
+            "  \"vm_peak\": n              (numeric, linux only) peak virtual memory of the process\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getmemoryinfo", "") + HelpExampleRpc("getmemoryinfo", ""));
+
+    UniValue components(UniValue::VOBJ);
+    uint64_t nTotal = 0;
+
+    {
+        LOCK(cs_main);
+        uint64_t nMempool = mempool.DynamicMemoryUsage();
+        uint64_t nCoins = pcoinsTip ? pcoinsTip->DynamicMemoryUsage() : 0;
+        uint64_t nBlockIndex = memusage::DynamicUsage(mapBlockIndex) +
+                               mapBlockIndex.size() * memusage::MallocUsage(sizeof(CBlockIndex));
+        components.push_back(Pair("mempool", nMempool));
+        components.push_back(Pair("utxo_cache", nCoins));
+        components.push_back(Pair("block_index", nBlockIndex));
+        nTotal += nMempool + nCoins + nBlockIndex;
+    }
+
+    uint64_t nSigCache = SignatureCacheDynamicUsage();
+    uint64_t nAddrman = addrman.DynamicMemoryUsage();
+    components.push_back(Pair("sig_cache", nSigCache));
+    components.push_back(Pair("addrman", nAddrman));
+    nTotal += nSigCache + nAddrman;
+
+    uint64_t nSendBuffers = 0;
+    uint64_t nRecvBuffers = 0;
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes) {
+            nSendBuffers += pnode->nSendSize;
+            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+            if (lockRecv)
+                nRecvBuffers += pnode->GetTotalRecvSize();
+        }
+    }
+    components.push_back(Pair("net_send_buffers", nSendBuffers));
+    components.push_back(Pair("net_recv_buffers", nRecvBuffers));
+    nTotal += nSendBuffers + nRecvBuffers;
+
+#ifdef ENABLE_WALLET
+    if (pwalletMain) {
+        uint64_t nWallet = pwalletMain->DynamicMemoryUsage();
+        components.push_back(Pair("wallet", nWallet));
+        nTotal += nWallet;
+    }
+#endif
+
+    uint64_t nEVMCache = dev::overlayDBCacheStats().memory;
+    components.push_back(Pair("evm_cache", nEVMCache));
+    nTotal += nEVMCache;
+
+    static std::atomic<uint64_t> nPeakTotal(0);
+    uint64_t nPeak = nPeakTotal.load();
+    while (nTotal > nPeak && !nPeakTotal.compare_exchange_weak(nPeak, nTotal)) {
+    }
+    if (nTotal > nPeak)
+        nPeak = nTotal;
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("components", components));
+    obj.push_back(Pair("total", nTotal));
+    obj.push_back(Pair("peak_total", nPeak));
+#if defined(__linux__)
+    int64_t nKiB = 0;
+    if (ReadProcStatusKB("VmRSS", nKiB))
+        obj.push_back(Pair("vm_rss", nKiB * 1024));
+    if (ReadProcStatusKB("VmPeak", nKiB))
+        obj.push_back(Pair("vm_peak", nKiB * 1024));
+#endif
+    return obj;
+}
+
 #ifdef ENABLE_WALLET
 class DescribeAddressVisitor : public boost::static_visitor<UniValue>
 {
@@ -558,6 +684,75 @@ UniValue verifymessage(const UniValue& params, bool fHelp)
     return (pubkey.GetID() == *keyID);
 }
 
+UniValue getlockstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getlockstats ( reset )\n"
+            "\nReturns per-lock wait and hold time statistics (requires a build configured with --enable-lockstats).\n"
+            "\nArguments:\n"
+            "1. reset      (boolean, optional, default=false) Zero the statistics after reading them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"cs_main\": {\n"
+            "    \"count\": n,                     (numeric) Number of acquisitions\n"
+            "    \"wait_total_us\": n,             (numeric) Total time spent waiting for the lock\n"
+            "    \"wait_max_us\": n,               (numeric) Longest single wait\n"
+            "    \"wait_max_site\": \"file:line\",  (string) Acquisition site of the longest wait\n"
+            "    \"hold_total_us\": n,             (numeric) Total time the lock was held\n"
+            "    \"hold_max_us\": n,               (numeric) Longest single hold\n"
+            "    \"wait_histogram_us_pow2\": [n],  (array) Waits per power-of-two microsecond bucket\n"
+            "    \"hold_histogram_us_pow2\": [n]   (array) Holds per power-of-two microsecond bucket\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getlockstats", "") + HelpExampleRpc("getlockstats", "true"));
+
+#ifdef DEBUG_LOCKSTATS
+    bool fReset = false;
+    if (params.size() > 0)
+        fReset = params[0].get_bool();
+
+    return LockStatsToJSON(fReset);
+#else
+    throw runtime_error("lock statistics were not compiled in, rebuild with --enable-lockstats");
+#endif
+}
+
+UniValue getperfstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getperfstats ( reset )\n"
+            "\nReturns timing counters for the instrumented hot paths (requires -perfstats).\n"
+            "\nArguments:\n"
+            "1. reset      (boolean, optional, default=false) Zero the counters after reading them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"ConnectBlock\": {\n"
+            "    \"count\": n,               (numeric) Number of samples\n"
+            "    \"total_us\": n,            (numeric) Total time spent, in microseconds\n"
+            "    \"avg_us\": n,              (numeric) Mean duration\n"
+            "    \"min_us\": n,              (numeric) Fastest sample\n"
+            "    \"max_us\": n,              (numeric) Slowest sample\n"
+            "    \"histogram_us_pow2\": [n]  (array) Sample counts per power-of-two microsecond bucket\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getperfstats", "") + HelpExampleRpc("getperfstats", "true"));
+
+    if (!fPerfStats)
+        throw runtime_error("perf counters are disabled, start with -perfstats to collect them");
+
+    bool fReset = false;
+    if (params.size() > 0)
+        fReset = params[0].get_bool();
+
+    return PerfStatsToJSON(fReset);
+}
+
 UniValue setmocktime(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -579,6 +774,187 @@ UniValue setmocktime(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+static bool GetIndexKeyFromAddress(const std::string& strAddress, uint160& hashBytes, unsigned char& type)
+{
+    CTxDestination dest = DecodeDestination(strAddress);
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        hashBytes = *keyID;
+        type = ADDRESS_INDEX_TYPE_PUBKEYHASH;
+        return true;
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        hashBytes = *scriptID;
+        type = ADDRESS_INDEX_TYPE_SCRIPTHASH;
+        return true;
+    }
+    return false;
+}
+
+UniValue getaddresstxids(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "getaddresstxids \"address\" ( start end )\n"
+            "\nReturns the txids touching an address in block order (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"  (string, required) the LUX address\n"
+            "2. start      (numeric, optional) first block height to include\n"
+            "3. end        (numeric, optional) last block height to include\n"
+            "\nResult:\n"
+            "[\n"
+            "  \"txid\"      (string) the transaction id\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddresstxids", "\"LcUP7ZzuTvyDiDSoVMEDQnYXKKmGyy2VGc\" 10000 20000") + HelpExampleRpc("getaddresstxids", "\"LcUP7ZzuTvyDiDSoVMEDQnYXKKmGyy2VGc\""));
+
+    uint160 hashBytes;
+    unsigned char type;
+    if (!GetIndexKeyFromAddress(params[0].get_str(), hashBytes, type))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+
+    int start = params.size() > 1 ? params[1].get_int() : 0;
+    int end = params.size() > 2 ? params[2].get_int() : 0;
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!GetAddressIndex(hashBytes, type, addressIndex, start, end))
+        throw JSONRPCError(RPC_MISC_ERROR, "No information available for address (is -addressindex enabled?)");
+
+    // Entries are height-then-position ordered, so all the entries of one
+    // transaction are adjacent and duplicates collapse with a single compare.
+    UniValue result(UniValue::VARR);
+    uint256 lastTxid;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
+        if (it->first.txhash != lastTxid) {
+            lastTxid = it->first.txhash;
+            result.push_back(lastTxid.GetHex());
+        }
+    }
+    return result;
+}
+
+UniValue getaddressdeltas(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "getaddressdeltas \"address\" ( start end )\n"
+            "\nReturns all balance changes for an address in block order (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"  (string, required) the LUX address\n"
+            "2. start      (numeric, optional) first block height to include\n"
+            "3. end        (numeric, optional) last block height to include\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"satoshis\": n,     (numeric) the delta, negative for spends\n"
+            "    \"txid\": \"hash\",    (string) the transaction id\n"
+            "    \"index\": n,        (numeric) the input or output index\n"
+            "    \"blockindex\": n,   (numeric) position of the transaction in its block\n"
+            "    \"height\": n,       (numeric) the block height\n"
+            "    \"spending\": true|false (boolean) true for an input, false for an output\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressdeltas", "\"LcUP7ZzuTvyDiDSoVMEDQnYXKKmGyy2VGc\" 10000 20000") + HelpExampleRpc("getaddressdeltas", "\"LcUP7ZzuTvyDiDSoVMEDQnYXKKmGyy2VGc\""));
+
+    uint160 hashBytes;
+    unsigned char type;
+    if (!GetIndexKeyFromAddress(params[0].get_str(), hashBytes, type))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+
+    int start = params.size() > 1 ? params[1].get_int() : 0;
+    int end = params.size() > 2 ? params[2].get_int() : 0;
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!GetAddressIndex(hashBytes, type, addressIndex, start, end))
+        throw JSONRPCError(RPC_MISC_ERROR, "No information available for address (is -addressindex enabled?)");
+
+    UniValue result(UniValue::VARR);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
+        UniValue delta(UniValue::VOBJ);
+        delta.push_back(Pair("satoshis", it->second));
+        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
+        delta.push_back(Pair("index", (int)it->first.index));
+        delta.push_back(Pair("blockindex", (int)it->first.txindex));
+        delta.push_back(Pair("height", it->first.blockHeight));
+        delta.push_back(Pair("spending", it->first.spending));
+        result.push_back(delta);
+    }
+    return result;
+}
+
+UniValue getaddressbalance(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance \"address\"\n"
+            "\nReturns the balance of an address from the index (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"  (string, required) the LUX address\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": n,  (numeric) the current balance in satoshis\n"
+            "  \"received\": n  (numeric) the total received in satoshis, including change\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressbalance", "\"LcUP7ZzuTvyDiDSoVMEDQnYXKKmGyy2VGc\"") + HelpExampleRpc("getaddressbalance", "\"LcUP7ZzuTvyDiDSoVMEDQnYXKKmGyy2VGc\""));
+
+    uint160 hashBytes;
+    unsigned char type;
+    if (!GetIndexKeyFromAddress(params[0].get_str(), hashBytes, type))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!GetAddressIndex(hashBytes, type, addressIndex))
+        throw JSONRPCError(RPC_MISC_ERROR, "No information available for address (is -addressindex enabled?)");
+
+    CAmount balance = 0;
+    CAmount received = 0;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
+        if (it->second > 0)
+            received += it->second;
+        balance += it->second;
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("balance", balance));
+    result.push_back(Pair("received", received));
+    return result;
+}
+
+UniValue getspentinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "getspentinfo \"txid\" index\n"
+            "\nReturns the transaction that spent an output (requires -spentindex).\n"
+            "\nArguments:\n"
+            "1. \"txid\"  (string, required) the transaction id of the output\n"
+            "2. index   (numeric, required) the output index\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\": \"hash\",  (string) the spending transaction id\n"
+            "  \"index\": n,      (numeric) the spending input index\n"
+            "  \"height\": n      (numeric) the height of the spending block\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getspentinfo", "\"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\" 0") + HelpExampleRpc("getspentinfo", "\"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", 0"));
+
+    uint256 txid;
+    txid.SetHex(params[0].get_str());
+    CSpentIndexKey key(txid, params[1].get_int());
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info (is -spentindex enabled?)");
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("txid", value.txid.GetHex()));
+    result.push_back(Pair("index", (int)value.inputIndex));
+    result.push_back(Pair("height", value.blockHeight));
+    return result;
+}
+
 #ifdef ENABLE_WALLET
 UniValue getstakingstatus(const UniValue& params, bool fHelp)
 {
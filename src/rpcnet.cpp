@@ -97,6 +97,7 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"banscore\": n,             (numeric) The ban score\n"
             "    \"synced_headers\": n,       (numeric) The last header we have in common with this peer\n"
             "    \"synced_blocks\": n,        (numeric) The last block we have in common with this peer\n"
+            "    \"blocklatency\": n,         (numeric) Smoothed block request-to-delivery latency in milliseconds, 0 if none delivered\n"
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
@@ -142,6 +143,7 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             obj.push_back(Pair("banscore", statestats.nMisbehavior));
             obj.push_back(Pair("synced_headers", statestats.nSyncHeight));
             obj.push_back(Pair("synced_blocks", statestats.nCommonHeight));
+            obj.push_back(Pair("blocklatency", statestats.nBlockLatencyMs));
             UniValue heights(UniValue::VARR);
             BOOST_FOREACH (int height, statestats.vHeightInFlight) {
                 heights.push_back(height);
@@ -298,7 +300,22 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
             "{\n"
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
-            "  \"timemillis\": t        (numeric) Total cpu time\n"
+            "  \"timemillis\": t,       (numeric) Total cpu time\n"
+            "  \"uploadtarget\":\n"
+            "  {\n"
+            "    \"timeframe\": n,                         (numeric) Length of the measuring timeframe in seconds\n"
+            "    \"target\": n,                            (numeric) Target in bytes\n"
+            "    \"target_reached\": true|false,           (boolean) True if target is reached\n"
+            "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
+            "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
+            "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"blockdownload\":\n"
+            "  {\n"
+            "    \"stalldisconnects\": n,                  (numeric) Peers disconnected for stalling the download window\n"
+            "    \"timeoutdisconnects\": n,                (numeric) Peers disconnected for exceeding the block download timeout\n"
+            "    \"reassigned\": n                         (numeric) Stalled critical block requests reassigned to another peer\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getnettotals", "") + HelpExampleRpc("getnettotals", ""));
@@ -307,6 +324,23 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     obj.push_back(Pair("totalbytesrecv", CNode::GetTotalBytesRecv()));
     obj.push_back(Pair("totalbytessent", CNode::GetTotalBytesSent()));
     obj.push_back(Pair("timemillis", GetTimeMillis()));
+
+    UniValue outboundLimit(UniValue::VOBJ);
+    outboundLimit.push_back(Pair("timeframe", (uint64_t)(60 * 60 * 24)));
+    outboundLimit.push_back(Pair("target", CNode::GetMaxOutboundTarget()));
+    outboundLimit.push_back(Pair("target_reached", CNode::OutboundTargetReached(false)));
+    outboundLimit.push_back(Pair("serve_historical_blocks", !CNode::OutboundTargetReached(true)));
+    outboundLimit.push_back(Pair("bytes_left_in_cycle", CNode::GetOutboundTargetBytesLeft()));
+    outboundLimit.push_back(Pair("time_left_in_cycle", CNode::GetMaxOutboundTimeLeftInCycle()));
+    obj.push_back(Pair("uploadtarget", outboundLimit));
+
+    int64_t nStallDisconnects, nTimeoutDisconnects, nReassigned;
+    GetBlockFetchStats(nStallDisconnects, nTimeoutDisconnects, nReassigned);
+    UniValue blockDownload(UniValue::VOBJ);
+    blockDownload.push_back(Pair("stalldisconnects", nStallDisconnects));
+    blockDownload.push_back(Pair("timeoutdisconnects", nTimeoutDisconnects));
+    blockDownload.push_back(Pair("reassigned", nReassigned));
+    obj.push_back(Pair("blockdownload", blockDownload));
     return obj;
 }
 
@@ -469,6 +503,66 @@ UniValue setban(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+UniValue importbanlist(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "importbanlist [\"ip(/netmask)\",...] (bantime) (absolute)\n"
+            "\nBans a list of IPs/Subnets in one operation. Intended for bulk threat-feed\n"
+            "imports: the whole list is applied under one lock with a single rebuild of\n"
+            "the ban matcher, instead of one setban call per entry.\n"
+
+            "\nArguments:\n"
+            "1. \"subnets\"      (array, required) Array of IP/Subnet strings (a missing netmask means /32 = single ip)\n"
+            "2. \"bantime\"      (numeric, optional) time in seconds how long (or until when if [absolute] is set) the ips are banned (0 or empty means using the default time of 24h which can also be overwritten by the -bantime startup argument)\n"
+            "3. \"absolute\"     (boolean, optional) If set, the bantime must be a absolute timestamp in seconds since epoch (Jan 1 1970 GMT)\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"added\": n,     (numeric) Number of subnets imported\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("importbanlist", "\"[\\\"192.168.0.0/24\\\",\\\"10.1.2.3\\\"]\" 86400")
+            + HelpExampleRpc("importbanlist", "[\"192.168.0.0/24\",\"10.1.2.3\"], 86400"));
+
+    const UniValue& subnets = params[0].get_array();
+
+    std::vector<CSubNet> vSubNets;
+    vSubNets.reserve(subnets.size());
+    for (unsigned int i = 0; i < subnets.size(); i++) {
+        const std::string& strSubnet = subnets[i].get_str();
+        CSubNet subNet = (strSubnet.find("/") != string::npos)
+                             ? CSubNet(strSubnet)
+                             : CSubNet(CNetAddr(strSubnet));
+        if (!subNet.IsValid())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Error: Invalid IP/Subnet: %s", strSubnet));
+        vSubNets.push_back(subNet);
+    }
+
+    int64_t banTime = 0; //use standard bantime if not specified
+    if (params.size() >= 2 && !params[1].isNull())
+        banTime = params[1].get_int64();
+
+    bool absolute = false;
+    if (params.size() == 3)
+        absolute = params[2].get_bool();
+
+    CNode::BanList(vSubNets, BanReasonManually, banTime, absolute);
+
+    //disconnect possible nodes
+    BOOST_FOREACH (const CSubNet& subNet, vSubNets) {
+        while (CNode* bannedNode = FindNode(subNet))
+            bannedNode->CloseSocketDisconnect();
+    }
+
+    DumpBanlist(); //store banlist to disk
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("added", (uint64_t)vSubNets.size()));
+    return ret;
+}
+
 UniValue listbanned(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
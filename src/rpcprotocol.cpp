@@ -217,26 +217,26 @@ int ReadHTTPHeaders(std::basic_istream<char>& stream, map<string, string>& mapHe
 int ReadHTTPMessage(std::basic_istream<char>& stream, map<string, string>& mapHeadersRet, string& strMessageRet, int nProto, size_t max_size)
 {
     mapHeadersRet.clear();
-    strMessageRet = "";
+    strMessageRet.clear();
 
     // Read header
     int nLen = ReadHTTPHeaders(stream, mapHeadersRet);
     if (nLen < 0 || (size_t)nLen > max_size)
         return HTTP_INTERNAL_SERVER_ERROR;
 
-    // Read message
+    // Read message directly into the caller's buffer, growing in
+    // POST_READ_SIZE steps so a dropped connection with a huge
+    // Content-Length never commits the full allocation up front
     if (nLen > 0) {
-        vector<char> vch;
         size_t ptr = 0;
         while (ptr < (size_t)nLen) {
             size_t bytes_to_read = std::min((size_t)nLen - ptr, POST_READ_SIZE);
-            vch.resize(ptr + bytes_to_read);
-            stream.read(&vch[ptr], bytes_to_read);
+            strMessageRet.resize(ptr + bytes_to_read);
+            stream.read(&strMessageRet[ptr], bytes_to_read);
             if (!stream) // Connection lost while reading
                 return HTTP_INTERNAL_SERVER_ERROR;
             ptr += bytes_to_read;
         }
-        strMessageRet = string(vch.begin(), vch.end());
     }
 
     string sConHdr = mapHeadersRet["connection"];
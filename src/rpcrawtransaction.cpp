@@ -9,6 +9,7 @@
 #include "consensus/validation.h"
 #include "core_io.h"
 #include "init.h"
+#include "jsonwriter.h"
 #include "keystore.h"
 #include "main.h"
 #include "net.h"
@@ -66,6 +67,7 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
     entry.push_back(Pair("version", tx.nVersion));
     entry.push_back(Pair("locktime", (int64_t)tx.nLockTime));
     UniValue vin(UniValue::VARR);
+    vin.reserve(tx.vin.size());
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
         const CTxIn& txin = tx.vin[i];
         UniValue in(UniValue::VOBJ);
@@ -77,7 +79,7 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
             UniValue o(UniValue::VOBJ);
             o.push_back(Pair("asm", txin.scriptSig.ToString()));
             o.push_back(Pair("hex", HexStr(txin.scriptSig.begin(), txin.scriptSig.end())));
-            in.push_back(Pair("scriptSig", o));
+            in.push_back(Pair("scriptSig", std::move(o)));
         }
         if (!tx.wit.IsNull()) {
             if (!tx.wit.vtxinwit[i].IsNull()) {
@@ -86,15 +88,16 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
                     std::vector<unsigned char> item = tx.wit.vtxinwit[i].scriptWitness.stack[j];
                     txinwitness.push_back(HexStr(item.begin(), item.end()));
                 }
-                in.push_back(Pair("txinwitness", txinwitness));
+                in.push_back(Pair("txinwitness", std::move(txinwitness)));
             }
 
         }
         in.push_back(Pair("sequence", (int64_t)txin.nSequence));
-        vin.push_back(in);
+        vin.push_back(std::move(in));
     }
-    entry.push_back(Pair("vin", vin));
+    entry.push_back(Pair("vin", std::move(vin)));
     UniValue vout(UniValue::VARR);
+    vout.reserve(tx.vout.size());
     for (unsigned int i = 0; i < tx.vout.size(); i++) {
         const CTxOut& txout = tx.vout[i];
         UniValue out(UniValue::VOBJ);
@@ -102,10 +105,10 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
         out.push_back(Pair("n", (int64_t)i));
         UniValue o(UniValue::VOBJ);
         ScriptPubKeyToJSON(txout.scriptPubKey, o, true);
-        out.push_back(Pair("scriptPubKey", o));
-        vout.push_back(out);
+        out.push_back(Pair("scriptPubKey", std::move(o)));
+        vout.push_back(std::move(out));
     }
-    entry.push_back(Pair("vout", vout));
+    entry.push_back(Pair("vout", std::move(vout)));
 
     if (hashBlock != uint256()) {
         entry.push_back(Pair("blockhash", hashBlock.GetHex()));
@@ -121,6 +124,169 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
     }
 }
 
+void ScriptPubKeyToWriter(const CScript& scriptPubKey, JSONWriter& w, bool fIncludeHex)
+{
+    txnouttype type;
+    vector<CTxDestination> addresses;
+    int nRequired;
+
+    w.BeginObject();
+    w.Key("asm");
+    w.String(scriptPubKey.ToString());
+    if (fIncludeHex) {
+        w.Key("hex");
+        w.String(HexStr(scriptPubKey.begin(), scriptPubKey.end()));
+    }
+
+    if (!ExtractDestinations(scriptPubKey, type, addresses, nRequired)) {
+        w.Key("type");
+        w.String(GetTxnOutputType(type));
+        w.EndObject();
+        return;
+    }
+
+    w.Key("reqSigs");
+    w.Int(nRequired);
+    w.Key("type");
+    w.String(GetTxnOutputType(type));
+
+    w.Key("addresses");
+    w.BeginArray();
+    BOOST_FOREACH (const CTxDestination& addr, addresses)
+        w.String(EncodeDestination(addr));
+    w.EndArray();
+    w.EndObject();
+}
+
+// Streaming port of TxToJSON; like it, appends fields to an object the caller
+// has already opened, so "hex" and friends can precede the shared layout.
+void TxToWriter(const CTransaction& tx, const uint256 hashBlock, JSONWriter& w)
+{
+    w.Key("txid");
+    w.String(tx.GetHash().GetHex());
+    w.Key("hash");
+    w.String(tx.GetWitnessHash().GetHex());
+    w.Key("size");
+    w.Int((int)::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+    w.Key("vsize");
+    w.Int((int)::GetVirtualTransactionSize(tx));
+    w.Key("version");
+    w.Int(tx.nVersion);
+    w.Key("locktime");
+    w.Int((int64_t)tx.nLockTime);
+    w.Key("vin");
+    w.BeginArray();
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        const CTxIn& txin = tx.vin[i];
+        w.BeginObject();
+        if (tx.IsCoinBase()) {
+            w.Key("coinbase");
+            w.String(HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+        } else {
+            w.Key("txid");
+            w.String(txin.prevout.hash.GetHex());
+            w.Key("vout");
+            w.Int((int64_t)txin.prevout.n);
+            w.Key("scriptSig");
+            w.BeginObject();
+            w.Key("asm");
+            w.String(txin.scriptSig.ToString());
+            w.Key("hex");
+            w.String(HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+            w.EndObject();
+        }
+        if (!tx.wit.IsNull()) {
+            if (!tx.wit.vtxinwit[i].IsNull()) {
+                w.Key("txinwitness");
+                w.BeginArray();
+                for (unsigned int j = 0; j < tx.wit.vtxinwit[i].scriptWitness.stack.size(); j++) {
+                    const std::vector<unsigned char>& item = tx.wit.vtxinwit[i].scriptWitness.stack[j];
+                    w.String(HexStr(item.begin(), item.end()));
+                }
+                w.EndArray();
+            }
+        }
+        w.Key("sequence");
+        w.Int((int64_t)txin.nSequence);
+        w.EndObject();
+    }
+    w.EndArray();
+    w.Key("vout");
+    w.BeginArray();
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        const CTxOut& txout = tx.vout[i];
+        w.BeginObject();
+        w.Key("value");
+        w.Raw(ValueFromAmount(txout.nValue).getValStr());
+        w.Key("n");
+        w.Int((int64_t)i);
+        w.Key("scriptPubKey");
+        ScriptPubKeyToWriter(txout.scriptPubKey, w, true);
+        w.EndObject();
+    }
+    w.EndArray();
+
+    if (hashBlock != uint256()) {
+        w.Key("blockhash");
+        w.String(hashBlock.GetHex());
+        CBlockIndex* pindex = LookupBlockIndex(hashBlock);
+        if (pindex) {
+            if (chainActive.Contains(pindex)) {
+                w.Key("confirmations");
+                w.Int(1 + chainActive.Height() - pindex->nHeight);
+                w.Key("time");
+                w.Int(pindex->GetBlockTime());
+                w.Key("blocktime");
+                w.Int(pindex->GetBlockTime());
+            } else {
+                w.Key("confirmations");
+                w.Int(0);
+            }
+        }
+    }
+}
+
+/** Streaming counterpart of getrawtransaction for the verbose case. Returns
+ * false when the call should fall back to the regular UniValue path (hex
+ * mode, malformed params, unknown transaction), which keeps every error
+ * surfaced through the one existing reporting path.
+ */
+bool GetRawTransactionStreaming(const UniValue& params, const UniValue& id, std::string& strReply)
+{
+    if (params.size() != 2 || !params[0].isStr() || !params[1].isNum())
+        return false;
+    if (params[1].get_int() == 0)
+        return false;
+
+    LOCK(cs_main);
+
+    uint256 hash;
+    hash.SetHex(params[0].get_str());
+
+    CTransaction tx;
+    uint256 hashBlock = uint256();
+    if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
+        return false;
+
+    string strHex = EncodeHexTx(tx);
+
+    JSONWriter w(strReply, strHex.size() * 3 + 1024);
+    w.BeginObject();
+    w.Key("result");
+    w.BeginObject();
+    w.Key("hex");
+    w.String(strHex);
+    TxToWriter(tx, hashBlock, w);
+    w.EndObject();
+    w.Key("error");
+    w.Null();
+    w.Key("id");
+    w.Raw(id.write());
+    w.EndObject();
+    strReply += "\n";
+    return true;
+}
+
 UniValue getrawtransaction(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -212,12 +378,119 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
     return result;
 }
 
+UniValue getrawtransactions(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getrawtransactions [\"txid\",...] ( verbose )\n"
+            "\nBatch form of getrawtransaction: looks up several transactions in\n"
+            "one call, reading the transaction index in file order. Requires\n"
+            "-txindex for transactions that are not in the mempool.\n"
+            "\nArguments:\n"
+            "1. [\"txid\",...]  (array, required) The transaction ids\n"
+            "2. verbose       (numeric, optional, default=0) If 0, return hex strings, other return json objects\n"
+            "\nResult:\n"
+            "[                 (array, same order as the input; null for unknown transactions)\n"
+            "  \"data\"|{...}    (string or object) as in getrawtransaction\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getrawtransactions", "'[\"mytxid\"]'") + HelpExampleRpc("getrawtransactions", "[\"mytxid\"], 1"));
+
+    UniValue txids = params[0].get_array();
+
+    bool fVerbose = false;
+    if (params.size() > 1)
+        fVerbose = (params[1].get_int() != 0);
+
+    std::vector<uint256> vhash;
+    vhash.reserve(txids.size());
+    for (unsigned int i = 0; i < txids.size(); i++)
+        vhash.push_back(ParseHashV(txids[i], "txid"));
+
+    std::vector<CTransactionRef> vtx;
+    std::vector<uint256> vhashBlock;
+    GetTransactions(vhash, vtx, vhashBlock);
+
+    LOCK(cs_main); // TxToJSON reads the block index for confirmations
+
+    UniValue ret(UniValue::VARR);
+    for (size_t i = 0; i < vtx.size(); i++) {
+        if (!vtx[i]) {
+            ret.push_back(NullUniValue);
+            continue;
+        }
+        string strHex = EncodeHexTx(*vtx[i]);
+        if (!fVerbose) {
+            ret.push_back(strHex);
+            continue;
+        }
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("hex", strHex));
+        TxToJSON(*vtx[i], vhashBlock[i], entry);
+        ret.push_back(entry);
+    }
+    return ret;
+}
+
 #ifdef ENABLE_WALLET
+//! Format one unspent output the way listunspent always has.
+static UniValue UnspentEntry(const CWalletTx* tx, int i, int nDepth, bool fSpendable)
+{
+    CTxDestination address;
+    const CScript& scriptPubKey = tx->vout[i].scriptPubKey;
+    bool fValidAddress = ExtractDestination(scriptPubKey, address);
+
+    UniValue entry(UniValue::VOBJ);
+    entry.push_back(Pair("txid", tx->GetHash().GetHex()));
+    entry.push_back(Pair("vout", i));
+
+    if (fValidAddress) {
+        entry.push_back(Pair("address", EncodeDestination(address)));
+
+        if (pwalletMain->mapAddressBook.count(address)) {
+            entry.push_back(Pair("account", pwalletMain->mapAddressBook[address].name));
+        }
+
+        if (scriptPubKey.IsPayToScriptHash()) {
+            const CScriptID& hash = boost::get<CScriptID>(address);
+            CScript redeemScript;
+            if (pwalletMain->GetCScript(hash, redeemScript)) {
+                entry.push_back(Pair("redeemScript", HexStr(redeemScript.begin(), redeemScript.end())));
+            }
+        }
+    }
+
+    entry.push_back(Pair("scriptPubKey", HexStr(scriptPubKey.begin(), scriptPubKey.end())));
+    entry.push_back(Pair("amount", ValueFromAmount(tx->vout[i].nValue)));
+    entry.push_back(Pair("confirmations", nDepth));
+    entry.push_back(Pair("spendable", fSpendable));
+    return entry;
+}
+
+/**
+ * Server-held listunspent snapshots for cursor pagination.  A snapshot
+ * freezes the filtered outpoint list the moment the first page is built, so
+ * a sweep iterating page by page sees a consistent set even while the
+ * wallet keeps accepting transactions; only the outpoint list is stored
+ * (16 bytes more than the 36-byte key per entry would be), never the
+ * materialized JSON.  Snapshots expire on exhaustion or after a timeout.
+ */
+struct CUnspentSnapshot {
+    std::vector<COutPoint> vOutpoints;
+    int64_t nCreateTime;
+};
+static CCriticalSection cs_unspentSnapshots;
+static std::map<uint64_t, CUnspentSnapshot> mapUnspentSnapshots;
+static uint64_t nNextUnspentSnapshotId = 1;
+static const size_t MAX_UNSPENT_SNAPSHOTS = 16;
+static const int64_t UNSPENT_SNAPSHOT_TIMEOUT = 10 * 60;
+
 UniValue listunspent(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 3)
+    if (fHelp || params.size() > 4)
         throw runtime_error(
-            "listunspent ( minconf maxconf  [\"address\",...] )\n"
+            "listunspent ( minconf maxconf  [\"address\",...] query_options )\n"
             "\nReturns array of unspent transaction outputs\n"
             "with between minconf and maxconf (inclusive) confirmations.\n"
             "Optionally filter to only include txouts paid to specified addresses.\n"
@@ -229,6 +502,12 @@ UniValue listunspent(const UniValue& params, bool fHelp)
             "      \"address\"   (string) lux address\n"
             "      ,...\n"
             "    ]\n"
+            "4. query_options    (json object, optional) with the keys:\n"
+            "    \"minimumAmount\"  (numeric or string, default=0) Minimum output value\n"
+            "    \"maximumAmount\"  (numeric or string, default=unlimited) Maximum output value\n"
+            "    \"maximumCount\"   (numeric, default=0 meaning all) Page size; switches the result to an\n"
+            "                       object with \"unspents\" and \"cursor\", paging over a stable snapshot\n"
+            "    \"cursor\"         (string) Cursor from a previous page; empty result cursor means done\n"
             "\nResult\n"
             "[                   (array of json object)\n"
             "  {\n"
@@ -245,9 +524,9 @@ UniValue listunspent(const UniValue& params, bool fHelp)
             "]\n"
 
             "\nExamples\n" +
-            HelpExampleCli("listunspent", "") + HelpExampleCli("listunspent", "6 9999999 \"[\\\"1PGFqEzfmQch1gKD3ra4k18PNj3tTUUSqg\\\",\\\"1LtvqCaApEdUGFkpKMM4MstjcaL4dKg8SP\\\"]\"") + HelpExampleRpc("listunspent", "6, 9999999 \"[\\\"1PGFqEzfmQch1gKD3ra4k18PNj3tTUUSqg\\\",\\\"1LtvqCaApEdUGFkpKMM4MstjcaL4dKg8SP\\\"]\""));
+            HelpExampleCli("listunspent", "") + HelpExampleCli("listunspent", "6 9999999 \"[\\\"1PGFqEzfmQch1gKD3ra4k18PNj3tTUUSqg\\\",\\\"1LtvqCaApEdUGFkpKMM4MstjcaL4dKg8SP\\\"]\"") + HelpExampleRpc("listunspent", "6, 9999999 \"[\\\"1PGFqEzfmQch1gKD3ra4k18PNj3tTUUSqg\\\",\\\"1LtvqCaApEdUGFkpKMM4MstjcaL4dKg8SP\\\"]\"") + HelpExampleCli("listunspent", "1 9999999 \"[]\" \"{\\\"maximumCount\\\":1000}\""));
 
-    RPCTypeCheck(params, list_of(UniValue::VNUM)(UniValue::VNUM)(UniValue::VARR));
+    RPCTypeCheck(params, list_of(UniValue::VNUM)(UniValue::VNUM)(UniValue::VARR)(UniValue::VOBJ));
 
     int nMinDepth = 1;
     if (params.size() > 0)
@@ -258,7 +537,7 @@ UniValue listunspent(const UniValue& params, bool fHelp)
         nMaxDepth = params[1].get_int();
 
     std::set<CTxDestination> destinations;
-    if (!params[2].isNull()) {
+    if (params.size() > 2 && !params[2].isNull()) {
         UniValue inputs = params[2].get_array();
         for (unsigned int idx = 0; idx < inputs.size(); idx++) {
             const UniValue& input = inputs[idx];
@@ -272,50 +551,113 @@ UniValue listunspent(const UniValue& params, bool fHelp)
         }
     }
 
-    UniValue results(UniValue::VARR);
-    vector<COutput> vecOutputs;
-    assert(pwalletMain != NULL);
-    LOCK2(cs_main, pwalletMain->cs_wallet);
-    pwalletMain->AvailableCoins(vecOutputs, false);
-    BOOST_FOREACH (const COutput& out, vecOutputs) {
-        if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
-            continue;
+    CAmount nMinimumAmount = 0;
+    CAmount nMaximumAmount = MAX_MONEY;
+    size_t nMaximumCount = 0;
+    std::string strCursor;
+    if (params.size() > 3 && !params[3].isNull()) {
+        const UniValue& options = params[3].get_obj();
+        if (options.exists("minimumAmount"))
+            nMinimumAmount = AmountFromValue(options["minimumAmount"]);
+        if (options.exists("maximumAmount"))
+            nMaximumAmount = AmountFromValue(options["maximumAmount"]);
+        if (options.exists("maximumCount"))
+            nMaximumCount = options["maximumCount"].get_int();
+        if (options.exists("cursor"))
+            strCursor = options["cursor"].get_str();
+    }
 
-        CTxDestination address;
-        const CScript& scriptPubKey = out.tx->vout[out.i].scriptPubKey;
-        bool fValidAddress = ExtractDestination(scriptPubKey, address);
+    assert(pwalletMain != NULL);
 
-        if (destinations.size() && (!fValidAddress || !destinations.count(address)))
-            continue;
+    if (nMaximumCount == 0 && strCursor.empty()) {
+        // Legacy one-shot form; amount bounds are still applied server-side.
+        UniValue results(UniValue::VARR);
+        vector<COutput> vecOutputs;
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        pwalletMain->AvailableCoins(vecOutputs, false);
+        BOOST_FOREACH (const COutput& out, vecOutputs) {
+            if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
+                continue;
+
+            const CAmount& nValue = out.tx->vout[out.i].nValue;
+            if (nValue < nMinimumAmount || nValue > nMaximumAmount)
+                continue;
+
+            CTxDestination address;
+            if (destinations.size() &&
+                (!ExtractDestination(out.tx->vout[out.i].scriptPubKey, address) || !destinations.count(address)))
+                continue;
+
+            results.push_back(UnspentEntry(out.tx, out.i, out.nDepth, out.fSpendable));
+        }
+        return results;
+    }
 
-        UniValue entry(UniValue::VOBJ);
-        entry.push_back(Pair("txid", out.tx->GetHash().GetHex()));
-        entry.push_back(Pair("vout", out.i));
+    // Paginated form: resolve or create the snapshot this cursor walks.
+    uint64_t nSnapshotId = 0;
+    size_t nOffset = 0;
+    if (!strCursor.empty()) {
+        size_t nSep = strCursor.find(':');
+        int64_t nId = 0, nPos = 0;
+        if (nSep == std::string::npos ||
+            !ParseInt64(strCursor.substr(0, nSep), &nId) ||
+            !ParseInt64(strCursor.substr(nSep + 1), &nPos) ||
+            nId <= 0 || nPos < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        nSnapshotId = nId;
+        nOffset = nPos;
+    }
 
-        if (fValidAddress) {
-            entry.push_back(Pair("address", EncodeDestination(address)));
+    UniValue unspents(UniValue::VARR);
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    LOCK(cs_unspentSnapshots);
 
-            if (pwalletMain->mapAddressBook.count(address)) {
-                entry.push_back(Pair("account", pwalletMain->mapAddressBook[address].name));
-            }
+    // Expire abandoned snapshots before possibly adding a new one.
+    for (std::map<uint64_t, CUnspentSnapshot>::iterator it = mapUnspentSnapshots.begin(); it != mapUnspentSnapshots.end();) {
+        if (it->second.nCreateTime + UNSPENT_SNAPSHOT_TIMEOUT < GetTime())
+            mapUnspentSnapshots.erase(it++);
+        else
+            ++it;
+    }
 
-            if (scriptPubKey.IsPayToScriptHash()) {
-                const CScriptID& hash = boost::get<CScriptID>(address);
-                CScript redeemScript;
-                if (pwalletMain->GetCScript(hash, redeemScript)) {
-                    entry.push_back(Pair("redeemScript", HexStr(redeemScript.begin(), redeemScript.end())));
-                }
-            }
-        }
+    if (strCursor.empty()) {
+        if (mapUnspentSnapshots.size() >= MAX_UNSPENT_SNAPSHOTS)
+            mapUnspentSnapshots.erase(mapUnspentSnapshots.begin());
+        nSnapshotId = nNextUnspentSnapshotId++;
+        CUnspentSnapshot& snapshot = mapUnspentSnapshots[nSnapshotId];
+        snapshot.nCreateTime = GetTime();
+
+        // Freeze the filtered outpoint list; the wallet walks its UTXO
+        // index (the destination buckets when an address filter is given)
+        // and applies every filter before anything is materialized.
+        pwalletMain->FilterUnspentOutpoints(destinations, nMinimumAmount, nMaximumAmount, nMinDepth, nMaxDepth, snapshot.vOutpoints);
+    } else if (!mapUnspentSnapshots.count(nSnapshotId)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown or expired cursor");
+    }
 
-        entry.push_back(Pair("scriptPubKey", HexStr(scriptPubKey.begin(), scriptPubKey.end())));
-        entry.push_back(Pair("amount", ValueFromAmount(out.tx->vout[out.i].nValue)));
-        entry.push_back(Pair("confirmations", out.nDepth));
-        entry.push_back(Pair("spendable", out.fSpendable));
-        results.push_back(entry);
+    CUnspentSnapshot& snapshot = mapUnspentSnapshots[nSnapshotId];
+    if (nOffset > snapshot.vOutpoints.size())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor past end of snapshot");
+    size_t nEnd = nMaximumCount ? std::min(snapshot.vOutpoints.size(), nOffset + nMaximumCount) : snapshot.vOutpoints.size();
+    for (size_t pos = nOffset; pos < nEnd; pos++) {
+        const COutPoint& outpoint = snapshot.vOutpoints[pos];
+        std::map<uint256, CWalletTx>::const_iterator mi = pwalletMain->mapWallet.find(outpoint.hash);
+        if (mi == pwalletMain->mapWallet.end())
+            continue;
+        const CWalletTx& wtx = mi->second;
+        bool fSpendable = (pwalletMain->IsMine(wtx.vout[outpoint.n]) & ISMINE_SPENDABLE) != 0;
+        unspents.push_back(UnspentEntry(&wtx, outpoint.n, wtx.GetDepthInMainChain(false), fSpendable));
     }
 
-    return results;
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("unspents", unspents));
+    if (nEnd >= snapshot.vOutpoints.size()) {
+        mapUnspentSnapshots.erase(nSnapshotId);
+        result.push_back(Pair("cursor", ""));
+    } else {
+        result.push_back(Pair("cursor", strprintf("%llu:%llu", (unsigned long long)nSnapshotId, (unsigned long long)nEnd)));
+    }
+    return result;
 }
 #endif
 
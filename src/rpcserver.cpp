@@ -182,7 +182,7 @@ string CRPCTable::help(string strCommand) const
     set<rpcfn_type> setDone;
     vector<pair<string, const CRPCCommand*> > vCommands;
 
-    for (map<string, const CRPCCommand*>::const_iterator mi = mapCommands.begin(); mi != mapCommands.end(); ++mi)
+    for (std::unordered_map<string, const CRPCCommand*>::const_iterator mi = mapCommands.begin(); mi != mapCommands.end(); ++mi)
         vCommands.push_back(make_pair(mi->second->category + mi->first, mi->second));
     sort(vCommands.begin(), vCommands.end());
 
@@ -270,6 +270,9 @@ static const CRPCCommand vRPCCommands[] =
         //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------
         /* Overall control/query calls */
         {"control", "getinfo", &getinfo, true, false, false}, /* uses wallet if enabled */
+        {"control", "getmemoryinfo", &getmemoryinfo, true, false, false},
+        {"control", "getlockstats", &getlockstats, true, true, false},
+        {"control", "getperfstats", &getperfstats, true, true, false},
         {"control", "help", &help, true, true, false},
         {"control", "stop", &stop, true, true, false},
 
@@ -283,6 +286,7 @@ static const CRPCCommand vRPCCommands[] =
         {"network", "getpeerinfo", &getpeerinfo, true, false, false},
         {"network", "ping", &ping, true, false, false},
         {"network", "setban", &setban, true, false, false},
+        {"network", "importbanlist", &importbanlist, true, false, false},
         {"network", "listbanned", &listbanned, true, false, false},
         {"network", "clearbanned", &clearbanned, true, false, false},
         {"network", "switchnetwork", &switchnetwork, true, false, false },
@@ -293,6 +297,7 @@ static const CRPCCommand vRPCCommands[] =
         {"blockchain", "getblockcount", &getblockcount, true, false, false},
         {"blockchain", "getblock", &getblock, true, false, false},
         {"blockchain", "getblockhash", &getblockhash, true, false, false},
+        {"blockchain", "getblockstats", &getblockstats, true, false, false},
         {"blockchain", "getblockhashes", &getblockhashes, true, false, false},
         {"blockchain", "getblockheader", &getblockheader, false, false, false},
         {"blockchain", "getchaintips", &getchaintips, true, false, false},
@@ -301,15 +306,23 @@ static const CRPCCommand vRPCCommands[] =
         {"blockchain", "getrawmempool", &getrawmempool, true, false, false},
         {"blockchain", "gettxout", &gettxout, true, false, false},
         {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false},
+        {"blockchain", "dumptxoutset", &dumptxoutset, true, false, false},
+        {"blockchain", "loadtxoutset", &loadtxoutset, true, false, false},
+        {"blockchain", "getaddresstxids", &getaddresstxids, true, false, false},
+        {"blockchain", "getaddressdeltas", &getaddressdeltas, true, false, false},
+        {"blockchain", "getaddressbalance", &getaddressbalance, true, false, false},
+        {"blockchain", "getspentinfo", &getspentinfo, true, false, false},
         {"blockchain", "verifychain", &verifychain, true, false, false},
         {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
         {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
 
         /*Smart Contract*/
         {"blockchain", "getaccountinfo", &getaccountinfo,true, true, false },
+        {"blockchain", "getevminfo", &getevminfo,true, true, false },
         {"blockchain", "getstorage", &getstorage,true, true, false },
         {"blockchain", "callcontract", &callcontract,true, true, false },
         {"blockchain", "listcontracts", &listcontracts,true, true, false },
+        {"blockchain", "searchlogs", &searchlogs,true, false, false },
         {"blockchain", "createcontract", &createcontract,true, true, false },
         {"blockchain", "sendtocontract", &sendtocontract,true, true, false },
         {"blockchain", "pruneblockchain", &pruneblockchain,true, true, false },
@@ -335,6 +348,7 @@ static const CRPCCommand vRPCCommands[] =
         {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true, false, false},
         {"rawtransactions", "decodescript", &decodescript, true, false, false},
         {"rawtransactions", "getrawtransaction", &getrawtransaction, true, false, false},
+        {"rawtransactions", "getrawtransactions", &getrawtransactions, true, false, false},
         {"rawtransactions", "sendrawtransaction", &sendrawtransaction, false, false, false},
         {"rawtransactions", "signrawtransaction", &signrawtransaction, false, false, false}, /* uses wallet if enabled */
         {"rawtransactions", "gethexaddress", &gethexaddress, false, false, false},
@@ -346,6 +360,7 @@ static const CRPCCommand vRPCCommands[] =
         {"util", "validateaddress", &validateaddress, true, false, false}, /* uses wallet if enabled */
         {"util", "verifymessage", &verifymessage, true, false, false},
         {"util", "estimatefee", &estimatefee, true, true, false},
+        {"util", "estimatefeepercentile", &estimatefeepercentile, true, true, false},
         {"util", "estimatepriority", &estimatepriority, true, true, false},
         {"util", "estimatesmartfee", &estimatesmartfee, true, true, false},
         {"util", "estimatesmartpriority", &estimatesmartpriority, true, true, false},
@@ -374,6 +389,7 @@ static const CRPCCommand vRPCCommands[] =
         {"wallet", "dumpwallet", &dumpwallet, true, false, true},
         {"wallet", "bip38encrypt", &bip38encrypt, true, false, true},
         {"wallet", "bip38decrypt", &bip38decrypt, true, false, true},
+        {"wallet", "bip38decryptbatch", &bip38decryptbatch, true, false, true},
         {"wallet", "encryptwallet", &encryptwallet, true, false, true},
         {"wallet", "getaccountaddress", &getaccountaddress, true, false, true},
         {"wallet", "getaccount", &getaccount, true, false, true},
@@ -390,6 +406,7 @@ static const CRPCCommand vRPCCommands[] =
         {"wallet", "importprivkey", &importprivkey, true, false, true},
         {"wallet", "importwallet", &importwallet, true, false, true},
         {"wallet", "importaddress", &importaddress, true, false, true},
+        {"wallet", "importaddresses", &importaddresses, true, false, true},
         {"wallet", "keypoolrefill", &keypoolrefill, true, false, true},
         {"wallet", "listaccounts", &listaccounts, false, false, true},
         {"wallet", "listaddressgroupings", &listaddressgroupings, false, false, true},
@@ -415,6 +432,49 @@ static const CRPCCommand vRPCCommands[] =
 #endif // ENABLE_WALLET
 };
 
+/**
+ * Declarative positional parameter type signatures for the busiest methods,
+ * one character per position:
+ *   s = string, n = numeric, b = boolean, a = array, o = object, . = any
+ * Positions past the end of the signature are not checked; methods without an
+ * entry fall through to the per-handler checks, which remain the backstop in
+ * all cases. Compiled into mapParamSpecs by the CRPCTable constructor so
+ * execute() can reject a mistyped request before dispatch.
+ */
+static const struct {
+    const char* name;
+    const char* spec;
+} vRPCParamSpecs[] = {
+    {"estimatefee", "n"},
+    {"getbalance", "snb"},
+    {"getbestblockhash", ""},
+    {"getblock", "s."}, // verbosity takes a bool or a number
+    {"getblockcount", ""},
+    {"getblockhash", "n"},
+    {"getblockheader", "sb"},
+    {"getblockstats", "nn"},
+    {"getrawtransaction", "sn"},
+    {"gettransaction", "sbn"},
+    {"gettxout", "sn"},
+    {"listtransactions", "snnb"},
+    {"listunspent", "nna"},
+    {"sendrawtransaction", "sb"},
+    {"sendtoaddress", "snss"},
+    {"validateaddress", "s"},
+};
+
+static UniValue::VType ParamSpecType(char ch)
+{
+    switch (ch) {
+    case 's': return UniValue::VSTR;
+    case 'n': return UniValue::VNUM;
+    case 'b': return UniValue::VBOOL;
+    case 'a': return UniValue::VARR;
+    case 'o': return UniValue::VOBJ;
+    default:  return UniValue::VNULL; // '.', matches anything
+    }
+}
+
 CRPCTable::CRPCTable()
 {
     unsigned int vcidx;
@@ -424,11 +484,17 @@ CRPCTable::CRPCTable()
         pcmd = &vRPCCommands[vcidx];
         mapCommands[pcmd->name] = pcmd;
     }
+
+    for (vcidx = 0; vcidx < (sizeof(vRPCParamSpecs) / sizeof(vRPCParamSpecs[0])); vcidx++) {
+        std::vector<UniValue::VType>& vTypes = mapParamSpecs[vRPCParamSpecs[vcidx].name];
+        for (const char* pch = vRPCParamSpecs[vcidx].spec; *pch; pch++)
+            vTypes.push_back(ParamSpecType(*pch));
+    }
 }
 
 const CRPCCommand* CRPCTable::operator[](string name) const
 {
-    map<string, const CRPCCommand*>::const_iterator it = mapCommands.find(name);
+    std::unordered_map<string, const CRPCCommand*>::const_iterator it = mapCommands.find(name);
     if (it == mapCommands.end())
         return NULL;
     return (*it).second;
@@ -877,7 +943,91 @@ void JSONRequest::parse(const UniValue& valRequest)
 }
 
 
-static UniValue JSONRPCExecOne(const UniValue& req)
+/**
+ * Admission control for the HTTP worker pools.  One verifychain or import
+ * rescan used to be able to occupy every worker thread at once and starve
+ * trivial health checks like getblockcount; each class below instead gets
+ * its own bounded queue and dedicated workers.  "scan" covers calls that
+ * walk large parts of the chainstate, the block files or the wallet
+ * history; "rescan" covers the reindex-class calls that run for minutes,
+ * with a deeper queue timeout since their callers expect to wait.
+ * -rpcheavythreads overrides the "scan" thread count; 0 disables the
+ * classes and serves everything from the regular pool, as before.
+ */
+static const CRPCAdmissionClass vRPCAdmissionClasses[] = {
+    //  name    threads  depth  queue timeout
+    {  "scan",       2,    16,    60 * 1000},
+    {"rescan",       1,     4,   600 * 1000},
+};
+
+static const struct {
+    const char* name;
+    const char* cls;
+} vRPCMethodClasses[] = {
+    {"dumptxoutset", "scan"},
+    {"getaddressdeltas", "scan"},
+    {"getaddresstxids", "scan"},
+    {"getblock", "scan"},
+    {"getblockstats", "scan"},
+    {"getrawtransactions", "scan"},
+    {"gettxoutsetinfo", "scan"},
+    {"listsinceblock", "scan"},
+    {"listtransactions", "scan"},
+    {"loadtxoutset", "scan"},
+    {"searchlogs", "scan"},
+    {"importaddress", "rescan"},
+    {"importprivkey", "rescan"},
+    {"importwallet", "rescan"},
+    {"verifychain", "rescan"},
+};
+
+const std::vector<CRPCAdmissionClass>& RPCAdmissionClasses()
+{
+    static std::vector<CRPCAdmissionClass> vClasses;
+    static bool fBuilt = false;
+    if (!fBuilt) {
+        int64_t nScanThreads = GetArg("-rpcheavythreads", vRPCAdmissionClasses[0].nThreads);
+        if (nScanThreads > 0) {
+            for (size_t i = 0; i < sizeof(vRPCAdmissionClasses) / sizeof(vRPCAdmissionClasses[0]); i++) {
+                CRPCAdmissionClass cls = vRPCAdmissionClasses[i];
+                if (cls.name == "scan")
+                    cls.nThreads = (int)nScanThreads;
+                vClasses.push_back(cls);
+            }
+        }
+        fBuilt = true;
+    }
+    return vClasses;
+}
+
+std::string RPCMethodAdmissionClass(const std::string& strMethod)
+{
+    for (size_t i = 0; i < sizeof(vRPCMethodClasses) / sizeof(vRPCMethodClasses[0]); i++)
+        if (strMethod == vRPCMethodClasses[i].name)
+            return vRPCMethodClasses[i].cls;
+    return std::string();
+}
+
+bool RPCExecuteStreaming(const JSONRequest& jreq, std::string& strReply)
+{
+    // Only the replies that actually get large are worth a streaming port;
+    // every handler falls back (returns false) for parameter shapes or
+    // errors it does not cover, so behavior is unchanged there.
+    if (jreq.strMethod != "getblock" && jreq.strMethod != "getrawtransaction")
+        return false;
+
+    // Run the same gatekeeping the UniValue path gets from execute().
+    const CRPCCommand* pcmd = tableRPC[jreq.strMethod];
+    if (!pcmd)
+        return false;
+    g_rpcSignals.PreCommand(*pcmd);
+
+    if (jreq.strMethod == "getblock")
+        return GetBlockStreaming(jreq.params, jreq.id, strReply);
+    return GetRawTransactionStreaming(jreq.params, jreq.id, strReply);
+}
+
+UniValue JSONRPCExecOne(const UniValue& req)
 {
     UniValue rpc_result(UniValue::VOBJ);
 
@@ -973,10 +1123,11 @@ static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
 void ServiceConnection(AcceptedConnection* conn)
 {
     bool fRun = true;
+    // reused across keep-alive requests so their capacity survives the loop
+    map<string, string> mapHeaders;
+    string strRequest, strMethod, strURI;
     while (fRun && !ShutdownRequested()) {
         int nProto = 0;
-        map<string, string> mapHeaders;
-        string strRequest, strMethod, strURI;
 
         // Read HTTP request line
         if (!ReadHTTPRequestLine(conn->stream(), nProto, strMethod, strURI))
@@ -1012,6 +1163,19 @@ UniValue CRPCTable::execute(const std::string& strMethod, const UniValue& params
     const CRPCCommand* pcmd = tableRPC[strMethod];
     if (!pcmd)
         throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+
+    // Precompiled positional type check: reject mistyped requests before
+    // dispatch instead of deep inside the handler.
+    std::unordered_map<string, std::vector<UniValue::VType> >::const_iterator itSpec = mapParamSpecs.find(strMethod);
+    if (itSpec != mapParamSpecs.end()) {
+        const std::vector<UniValue::VType>& vTypes = itSpec->second;
+        for (size_t i = 0; i < params.size() && i < vTypes.size(); i++) {
+            if (vTypes[i] != UniValue::VNULL && params[i].type() != vTypes[i] && !params[i].isNull())
+                throw JSONRPCError(RPC_TYPE_ERROR, strprintf("Expected type %s, got %s",
+                    uvTypeName(vTypes[i]), uvTypeName(params[i].type())));
+        }
+    }
+
     g_rpcSignals.PreCommand(*pcmd);
 
     try {
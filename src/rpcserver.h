@@ -14,6 +14,8 @@
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/function.hpp>
 
@@ -173,7 +175,10 @@ void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
 class CRPCTable
 {
 private:
-    std::map<std::string, const CRPCCommand*> mapCommands;
+    std::unordered_map<std::string, const CRPCCommand*> mapCommands;
+    //! Positional parameter type signatures, compiled once at construction
+    //! from a declarative table; consulted by execute() before dispatch.
+    std::unordered_map<std::string, std::vector<UniValue::VType> > mapParamSpecs;
 
 public:
     CRPCTable();
@@ -220,6 +225,7 @@ extern std::string HelpExampleCli(std::string methodname, std::string args);
 extern std::string HelpExampleRpc(std::string methodname, std::string args);
 
 extern void EnsureWalletIsUnlocked();
+extern void EnsureWalletIsWritable();
 
 extern UniValue getconnectioncount(const UniValue& params, bool fHelp); // in rpcnet.cpp
 extern UniValue getpeerinfo(const UniValue& params, bool fHelp);
@@ -229,24 +235,29 @@ extern UniValue addnode(const UniValue& params, bool fHelp);
 extern UniValue getaddednodeinfo(const UniValue& params, bool fHelp);
 extern UniValue getnettotals(const UniValue& params, bool fHelp);
 extern UniValue setban(const UniValue& params, bool fHelp);
+extern UniValue importbanlist(const UniValue& params, bool fHelp);
 extern UniValue listbanned(const UniValue& params, bool fHelp);
 extern UniValue clearbanned(const UniValue& params, bool fHelp);
 
 extern UniValue dumpprivkey(const UniValue& params, bool fHelp); // in rpcdump.cpp
 extern UniValue importprivkey(const UniValue& params, bool fHelp);
 extern UniValue importaddress(const UniValue& params, bool fHelp);
+extern UniValue importaddresses(const UniValue& params, bool fHelp);
 extern UniValue dumpwallet(const UniValue& params, bool fHelp);
 extern UniValue importwallet(const UniValue& params, bool fHelp);
 extern UniValue bip38encrypt(const UniValue& params, bool fHelp);
 extern UniValue bip38decrypt(const UniValue& params, bool fHelp);
+extern UniValue bip38decryptbatch(const UniValue& params, bool fHelp);
 
 extern UniValue dumpprivkey(const UniValue& params, bool fHelp); // in rpcdump.cpp
 extern UniValue importprivkey(const UniValue& params, bool fHelp);
 extern UniValue importaddress(const UniValue& params, bool fHelp);
+extern UniValue importaddresses(const UniValue& params, bool fHelp);
 extern UniValue dumpwallet(const UniValue& params, bool fHelp);
 extern UniValue importwallet(const UniValue& params, bool fHelp);
 extern UniValue bip38encrypt(const UniValue& params, bool fHelp);
 extern UniValue bip38decrypt(const UniValue& params, bool fHelp);
+extern UniValue bip38decryptbatch(const UniValue& params, bool fHelp);
 extern UniValue setstakesplitthreshold(const UniValue& params, bool fHelp);
 extern UniValue getstakesplitthreshold(const UniValue& params, bool fHelp);
 extern UniValue getgenerate(const UniValue& params, bool fHelp); // in rpcmining.cpp
@@ -260,6 +271,7 @@ extern UniValue getwork(const UniValue& params, bool fHelp);
 
 extern UniValue submitblock(const UniValue& params, bool fHelp);
 extern UniValue estimatefee(const UniValue& params, bool fHelp);
+extern UniValue estimatefeepercentile(const UniValue& params, bool fHelp);
 extern UniValue estimatepriority(const UniValue& params, bool fHelp);
 extern UniValue estimatesmartfee(const UniValue& params, bool fHelp);
 extern UniValue estimatesmartpriority(const UniValue& params, bool fHelp);
@@ -299,10 +311,13 @@ extern UniValue walletlock(const UniValue& params, bool fHelp);
 extern UniValue encryptwallet(const UniValue& params, bool fHelp);
 extern UniValue validateaddress(const UniValue& params, bool fHelp);
 extern UniValue getinfo(const UniValue& params, bool fHelp);
+extern UniValue getmemoryinfo(const UniValue& params, bool fHelp);
 extern UniValue getwalletinfo(const UniValue& params, bool fHelp);
 extern UniValue getblockchaininfo(const UniValue& params, bool fHelp);
 extern UniValue getnetworkinfo(const UniValue& params, bool fHelp);
 extern UniValue setmocktime(const UniValue& params, bool fHelp);
+extern UniValue getperfstats(const UniValue& params, bool fHelp);
+extern UniValue getlockstats(const UniValue& params, bool fHelp);
 extern UniValue reservebalance(const UniValue& params, bool fHelp);
 extern UniValue multisend(const UniValue& params, bool fHelp);
 extern UniValue autocombinerewards(const UniValue& params, bool fHelp);
@@ -312,6 +327,7 @@ extern UniValue createcontract(const UniValue& params, bool fHelp);
 extern UniValue sendtocontract(const UniValue& params, bool fHelp);
 
 extern UniValue getrawtransaction(const UniValue& params, bool fHelp); // in rcprawtransaction.cpp
+extern UniValue getrawtransactions(const UniValue& params, bool fHelp);
 extern UniValue listunspent(const UniValue& params, bool fHelp);
 extern UniValue lockunspent(const UniValue& params, bool fHelp);
 extern UniValue listlockunspent(const UniValue& params, bool fHelp);
@@ -331,10 +347,17 @@ extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
+extern UniValue getblockstats(const UniValue& params, bool fHelp);
 extern UniValue getblock(const UniValue& params, bool fHelp);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp);
+extern UniValue dumptxoutset(const UniValue& params, bool fHelp);
+extern UniValue loadtxoutset(const UniValue& params, bool fHelp);
 extern UniValue gettxout(const UniValue& params, bool fHelp);
+extern UniValue getaddresstxids(const UniValue& params, bool fHelp);
+extern UniValue getaddressdeltas(const UniValue& params, bool fHelp);
+extern UniValue getaddressbalance(const UniValue& params, bool fHelp);
+extern UniValue getspentinfo(const UniValue& params, bool fHelp);
 extern UniValue verifychain(const UniValue& params, bool fHelp);
 extern UniValue getchaintips(const UniValue& params, bool fHelp);
 extern UniValue switchnetwork(const UniValue& params, bool fHelp);
@@ -344,6 +367,7 @@ extern UniValue darksend(const UniValue& params, bool fHelp);
 extern UniValue spork(const UniValue& params, bool fHelp);
 extern UniValue masternode(const UniValue& params, bool fHelp);
 extern UniValue getaccountinfo(const UniValue& params, bool fHelp);
+extern UniValue getevminfo(const UniValue& params, bool fHelp);
 //extern UniValue masternodelist(const UniValue& params, bool fHelp);
 //extern UniValue mnbudget(const UniValue& params, bool fHelp);
 //extern UniValue mnbudgetvoteraw(const UniValue& params, bool fHelp);
@@ -353,6 +377,7 @@ extern UniValue getaccountinfo(const UniValue& params, bool fHelp);
 
 extern UniValue getstorage(const UniValue& params, bool fHelp);
 extern UniValue listcontracts(const UniValue& params, bool fHelp);
+extern UniValue searchlogs(const UniValue& params, bool fHelp);
 extern UniValue pruneblockchain(const UniValue& params, bool fHelp);
 
 // in rest.cpp
@@ -361,5 +386,33 @@ extern bool HTTPReq_REST(AcceptedConnection* conn,
     std::map<std::string, std::string>& mapHeaders,
     bool fRun);
 std::string JSONRPCExecBatch(const UniValue& vReq);
+UniValue JSONRPCExecOne(const UniValue& req);
+/** Admission class for RPC methods dispatched to the HTTP worker pools.
+ * Methods sharing a class share its bounded queue and dedicated worker
+ * threads, so a burst of them can only exhaust their own class and trivial
+ * calls always find a free worker on the default pool. The class
+ * definitions and the method assignments live next to the dispatch table in
+ * rpcserver.cpp.
+ */
+struct CRPCAdmissionClass {
+    std::string name;        //!< class name as returned by RPCMethodAdmissionClass
+    int nThreads;            //!< dedicated worker threads
+    int nQueueDepth;         //!< queued calls beyond this are rejected outright
+    int64_t nQueueTimeoutMs; //!< queued calls older than this are answered 503
+};
+/** The configured admission classes; empty when -rpcheavythreads=0. */
+const std::vector<CRPCAdmissionClass>& RPCAdmissionClasses();
+/** Admission class name of a method; empty for the default pool. */
+std::string RPCMethodAdmissionClass(const std::string& strMethod);
+/** Serialize the reply for methods with a streaming (JSONWriter) port,
+ * appending the complete JSON-RPC envelope to strReply. Returns false when
+ * the method or parameter shape is not covered and the UniValue path must
+ * run instead.
+ */
+bool RPCExecuteStreaming(const JSONRequest& jreq, std::string& strReply);
+
+// in rpcblockchain.cpp / rpcrawtransaction.cpp
+bool GetBlockStreaming(const UniValue& params, const UniValue& id, std::string& strReply);
+bool GetRawTransactionStreaming(const UniValue& params, const UniValue& id, std::string& strReply);
 
 #endif // BITCOIN_RPCSERVER_H
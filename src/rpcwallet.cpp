@@ -59,6 +59,12 @@ void EnsureWalletIsUnlocked()
         throw JSONRPCError(RPC_WALLET_UNLOCK_NEEDED, "Error: Please enter the wallet passphrase with walletpassphrase first.");
 }
 
+void EnsureWalletIsWritable()
+{
+    if (pwalletMain->fReadOnly)
+        throw JSONRPCError(RPC_WALLET_ERROR, "Error: Wallet is opened in read-only mode (-walletreadonly).");
+}
+
 void WalletTxToJSON(const CWalletTx& wtx, UniValue& entry)
 {
     int confirms = wtx.GetDepthInMainChain(false);
@@ -1728,19 +1734,24 @@ UniValue gettransaction(const UniValue& params, bool fHelp)
 
 UniValue backupwallet(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 1)
+    if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
-            "backupwallet \"destination\"\n"
+            "backupwallet \"destination\" ( incremental )\n"
             "\nSafely copies wallet.dat to destination, which can be a directory or a path with filename.\n"
+            "If incremental is true and the wallet uses the record-log format, only the records\n"
+            "appended since the previous backup to that destination are copied; the destination\n"
+            "remains a complete wallet file either way. Berkeley DB wallets are always copied in full.\n"
             "\nArguments:\n"
             "1. \"destination\"   (string) The destination directory or file\n"
+            "2. incremental     (boolean, optional, default=false) Append only new records to an existing backup\n"
             "\nExamples:\n" +
             HelpExampleCli("backupwallet", "\"backup.dat\"") + HelpExampleRpc("backupwallet", "\"backup.dat\""));
 
     LOCK2(cs_main, pwalletMain->cs_wallet);
 
     string strDest = params[0].get_str();
-    if (!BackupWallet(*pwalletMain, strDest))
+    bool fIncremental = params.size() > 1 ? params[1].get_bool() : false;
+    if (!BackupWallet(*pwalletMain, strDest, fIncremental))
         throw JSONRPCError(RPC_WALLET_ERROR, "Error: Wallet backup failed!");
 
     return NullUniValue;
@@ -1761,6 +1772,8 @@ UniValue keypoolrefill(const UniValue& params, bool fHelp)
 
     LOCK2(cs_main, pwalletMain->cs_wallet);
 
+    EnsureWalletIsWritable();
+
     // 0 is interpreted by TopUpKeyPool() as the default keypool size given by -keypool
     unsigned int kpSize = 0;
     if (params.size() > 0) {
@@ -2513,8 +2526,6 @@ UniValue callcontract(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_VERIFY_ERROR, "Smart contracts hardfork is not active yet. Activation block number - " + std::to_string(Params().FirstSCBlock()));
     }
 
-    LOCK(cs_main);
-
     std::string strAddr = params[0].get_str();
     std::string data = params[1].get_str();
 
@@ -2525,8 +2536,13 @@ UniValue callcontract(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
 
     dev::Address addrAccount(strAddr);
-    if(!globalState->addressInUse(addrAccount))
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+    {
+        // only the existence check needs the validation state; the call itself
+        // runs against the published snapshot without cs_main
+        LOCK(cs_main);
+        if(!globalState->addressInUse(addrAccount))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+    }
 
     dev::Address senderAddress;
     if(params.size() == 3){
@@ -2546,7 +2562,7 @@ UniValue callcontract(const UniValue& params, bool fHelp)
     }
 
 
-    std::vector<ResultExecute> execResults = CallContract(addrAccount, ParseHex(data), senderAddress, gasLimit);
+    std::vector<ResultExecute> execResults = CallContractReadOnly(addrAccount, ParseHex(data), senderAddress, gasLimit);
 
     if(fRecordLogOpcodes){
         writeVMlog(execResults);
@@ -5,6 +5,8 @@
 #include "scheduler.h"
 #include "reverselock.h"
 #include "random.h"
+#include "util.h"
+#include "utiltime.h"
 #include <assert.h>
 #include <boost/bind.hpp>
 #include <utility>
@@ -63,15 +65,38 @@ void CScheduler::serviceQueue()
             if (shouldStop() || taskQueue.empty())
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            // Among everything that is due, run the highest priority class
+            // first; the front of the queue is due whenever we get here.
+            boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+            std::multimap<boost::chrono::system_clock::time_point, Task>::iterator itBest = taskQueue.begin();
+            for (std::multimap<boost::chrono::system_clock::time_point, Task>::iterator it = taskQueue.begin();
+                 it != taskQueue.end() && it->first <= now; ++it) {
+                if (it->second.prio < itBest->second.prio)
+                    itBest = it;
+            }
+            Task task = itBest->second;
+            taskQueue.erase(itBest);
 
+            int64_t nStart = GetTimeMillis();
             {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
 
-                f();
+                task.f();
+            }
+            int64_t nElapsed = GetTimeMillis() - nStart;
+            TaskStats& stats = mapTaskStats[task.strName];
+            stats.nRuns++;
+            stats.nTotalMillis += nElapsed;
+            if (nElapsed > stats.nMaxMillis)
+                stats.nMaxMillis = nElapsed;
+            if (task.nBudgetMillis > 0 && nElapsed > task.nBudgetMillis) {
+                stats.nOverruns++;
+                LogPrintf("CScheduler : task %s overran its budget, took %dms (budget %dms)\n",
+                          task.strName, nElapsed, task.nBudgetMillis);
+            } else {
+                LogPrint("scheduler", "task %s took %dms\n", task.strName, nElapsed);
             }
         } catch (...) {
             --nThreadsServicingQueue;
@@ -94,29 +119,41 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::scheduler(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::scheduler(CScheduler::Function f, boost::chrono::system_clock::time_point t,
+                           const std::string& strName, Priority prio, int64_t nBudgetMillis)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        Task task;
+        task.f = f;
+        task.strName = strName;
+        task.prio = prio;
+        task.nBudgetMillis = nBudgetMillis;
+        taskQueue.insert(std::make_pair(t, task));
     }
     newTaskScheduled.notify_one();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds,
+                                 const std::string& strName, Priority prio, int64_t nBudgetMillis)
 {
-    scheduler(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    scheduler(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds),
+              strName, prio, nBudgetMillis);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds,
+                   const std::string& strName, CScheduler::Priority prio, int64_t nBudgetMillis)
 {
     f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds, strName, prio, nBudgetMillis),
+                       deltaMilliSeconds, strName, prio, nBudgetMillis);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds,
+                               const std::string& strName, Priority prio, int64_t nBudgetMillis)
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds, strName, prio, nBudgetMillis),
+                    deltaMilliSeconds, strName, prio, nBudgetMillis);
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
@@ -129,4 +166,10 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
         last = taskQueue.rbegin()->first;
     }
     return result;
+}
+
+void CScheduler::getTaskStats(std::map<std::string, TaskStats>& mapStatsOut) const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    mapStatsOut = mapTaskStats;
 }
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
 #include <map>
+#include <string>
 
 #include <sync.h>
 
@@ -43,18 +44,42 @@ public:
 
     typedef boost::function<void(void)> Function;
 
-    // Call func at/after time t
-    void scheduler(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    // Priority classes. When several tasks are due at once, a servicing
+    // thread picks the highest class first; within a class, the earliest
+    // due time wins. Run the queue with more than one thread so a slow
+    // low-priority task cannot delay a due high-priority one.
+    enum Priority {
+        PRIO_HIGH = 0,
+        PRIO_NORMAL,
+        PRIO_LOW
+    };
+
+    // Per-task runtime accounting, keyed by the name given at scheduling
+    // time. An overrun is a run that exceeded the task's budget.
+    struct TaskStats {
+        uint64_t nRuns;
+        uint64_t nOverruns;
+        int64_t nTotalMillis;
+        int64_t nMaxMillis;
+        TaskStats() : nRuns(0), nOverruns(0), nTotalMillis(0), nMaxMillis(0) {}
+    };
+
+    // Call func at/after time t. strName keys the runtime metrics;
+    // nBudgetMillis is the overrun threshold (0 = no overrun detection).
+    void scheduler(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now(),
+                   const std::string& strName = "task", Priority prio = PRIO_NORMAL, int64_t nBudgetMillis = 0);
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds,
+                         const std::string& strName = "task", Priority prio = PRIO_NORMAL, int64_t nBudgetMillis = 0);
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds,
+                       const std::string& strName = "task", Priority prio = PRIO_NORMAL, int64_t nBudgetMillis = 0);
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -72,8 +97,18 @@ public:
     size_t getQueueInfo(boost::chrono::system_clock::time_point &first,
                         boost::chrono::system_clock::time_point &last) const;
 
+    // Snapshot of the per-task runtime metrics.
+    void getTaskStats(std::map<std::string, TaskStats>& mapStatsOut) const;
+
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task {
+        Function f;
+        std::string strName;
+        Priority prio;
+        int64_t nBudgetMillis;
+    };
+    std::multimap<boost::chrono::system_clock::time_point, Task> taskQueue;
+    std::map<std::string, TaskStats> mapTaskStats;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
@@ -268,6 +268,9 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
     opcodetype opcode;
     valtype vchPushValue;
     vector<bool> vfExec;
+    // Number of false entries on vfExec, maintained incrementally so the
+    // per-opcode executability test is O(1) instead of a scan of vfExec.
+    unsigned int nExecFalseDepth = 0;
     vector<valtype> altstack;
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
     if (script.size() > MAX_SCRIPT_SIZE)
@@ -275,11 +278,15 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
     int nOpCount = 0;
     bool fRequireMinimal = (flags & SCRIPT_VERIFY_MINIMALDATA) != 0;
 
+    // Typical scripts only push a handful of elements; reserving up front
+    // avoids the doubling reallocations of the first few push_backs.
+    stack.reserve(stack.size() + 8);
+
     try
     {
         while (pc < pend)
         {
-            bool fExec = !count(vfExec.begin(), vfExec.end(), false);
+            bool fExec = (nExecFalseDepth == 0);
 
             //
             // Read instruction
@@ -463,6 +470,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                         popstack(stack);
                     }
                     vfExec.push_back(fValue);
+                    if (!fValue)
+                        nExecFalseDepth++;
                 }
                 break;
 
@@ -470,6 +479,10 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 {
                     if (vfExec.empty())
                         return set_error(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+                    if (vfExec.back())
+                        nExecFalseDepth++;
+                    else
+                        nExecFalseDepth--;
                     vfExec.back() = !vfExec.back();
                 }
                 break;
@@ -478,6 +491,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 {
                     if (vfExec.empty())
                         return set_error(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+                    if (!vfExec.back())
+                        nExecFalseDepth--;
                     vfExec.pop_back();
                 }
                 break;
@@ -1070,6 +1085,29 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
 
 namespace {
 
+/** Serialize the passed scriptCode, skipping OP_CODESEPARATORs */
+template<typename S>
+void SerializeScriptCodeStripped(S &s, const CScript &scriptCode) {
+    CScript::const_iterator it = scriptCode.begin();
+    CScript::const_iterator itBegin = it;
+    opcodetype opcode;
+    unsigned int nCodeSeparators = 0;
+    while (scriptCode.GetOp(it, opcode)) {
+        if (opcode == OP_CODESEPARATOR)
+            nCodeSeparators++;
+    }
+    ::WriteCompactSize(s, scriptCode.size() - nCodeSeparators);
+    it = itBegin;
+    while (scriptCode.GetOp(it, opcode)) {
+        if (opcode == OP_CODESEPARATOR) {
+            s.write((char*)&itBegin[0], it-itBegin-1);
+            itBegin = it;
+        }
+    }
+    if (itBegin != scriptCode.end())
+        s.write((char*)&itBegin[0], it-itBegin);
+}
+
 /**
  * Wrapper that serializes like CTransaction, but with the modifications
  *  required for the signature hash done in-place
@@ -1093,24 +1131,7 @@ public:
     /** Serialize the passed scriptCode, skipping OP_CODESEPARATORs */
     template<typename S>
     void SerializeScriptCode(S &s, int nType, int nVersion) const {
-        CScript::const_iterator it = scriptCode.begin();
-        CScript::const_iterator itBegin = it;
-        opcodetype opcode;
-        unsigned int nCodeSeparators = 0;
-        while (scriptCode.GetOp(it, opcode)) {
-            if (opcode == OP_CODESEPARATOR)
-                nCodeSeparators++;
-        }
-        ::WriteCompactSize(s, scriptCode.size() - nCodeSeparators);
-        it = itBegin;
-        while (scriptCode.GetOp(it, opcode)) {
-            if (opcode == OP_CODESEPARATOR) {
-                s.write((char*)&itBegin[0], it-itBegin-1);
-                itBegin = it;
-            }
-        }
-        if (itBegin != scriptCode.end())
-            s.write((char*)&itBegin[0], it-itBegin);
+        SerializeScriptCodeStripped(s, scriptCode);
     }
 
     /** Serialize an input of txTo */
@@ -1201,6 +1222,37 @@ PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
         hashOutputs = GetOutputsHash(txTo);
         ready = true;
     }
+
+    // Legacy SIGHASH_ALL midstates. Without ANYONECANPAY/SINGLE/NONE every
+    // field except the signed input's scriptCode serializes identically for
+    // all inputs, so the blanked serialization and the hash state up to each
+    // input's script field can be shared across the whole transaction.
+    CDataStream ss(SER_GETHASH, 0);
+    ss << txTo.nVersion;
+    ss << txTo.nTime;
+    WriteCompactSize(ss, txTo.vin.size());
+    vLegacyScriptPos.reserve(txTo.vin.size());
+    for (const auto& txin : txTo.vin) {
+        ss << txin.prevout;
+        vLegacyScriptPos.push_back(ss.size());
+        ss << CScriptBase(); // blanked scriptSig: a single zero length byte
+        ss << txin.nSequence;
+    }
+    WriteCompactSize(ss, txTo.vout.size());
+    for (const auto& txout : txTo.vout)
+        ss << txout;
+    ss << txTo.nLockTime;
+    vchLegacyBlank.assign(ss.begin(), ss.end());
+
+    CSHA256 sha;
+    size_t nHashed = 0;
+    vLegacyMidstate.reserve(txTo.vin.size());
+    for (size_t pos : vLegacyScriptPos) {
+        sha.Write(&vchLegacyBlank[nHashed], pos - nHashed);
+        nHashed = pos;
+        vLegacyMidstate.push_back(sha);
+    }
+    legacyReady = true;
 }
 
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
@@ -1262,6 +1314,27 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
         }
     }
 
+    // Fast path for the overwhelmingly common SIGHASH_ALL case: splice the
+    // scriptCode into the cached blanked serialization at this input's script
+    // field and resume the inner SHA256 from the cached midstate, instead of
+    // re-serializing the whole transaction for every input.
+    if (cache && cache->legacyReady && !(nHashType & SIGHASH_ANYONECANPAY) &&
+        (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        CDataStream sc(SER_GETHASH, 0);
+        SerializeScriptCodeStripped(sc, scriptCode);
+        CSHA256 sha = cache->vLegacyMidstate[nIn];
+        if (!sc.empty())
+            sha.Write((const unsigned char*)&sc[0], sc.size());
+        size_t pos = cache->vLegacyScriptPos[nIn] + 1; // skip the blank script's length byte
+        sha.Write(&cache->vchLegacyBlank[pos], cache->vchLegacyBlank.size() - pos);
+        uint32_t nHashTypeLE = htole32((uint32_t)nHashType);
+        sha.Write((const unsigned char*)&nHashTypeLE, 4);
+        uint256 hash;
+        sha.Finalize(hash.begin());
+        CSHA256().Write(hash.begin(), 32).Finalize(hash.begin());
+        return hash;
+    }
+
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
@@ -1379,6 +1452,8 @@ bool TransactionSignatureChecker::CheckSequence(const CScriptNum& nSequence) con
     return true;
 }
 
+static bool VerifyPubKeyHashFastPath(const valtype& vchSig, const valtype& vchPubKey, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror);
+
 static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion, const std::vector<unsigned char>& program, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
 {
     vector<vector<unsigned char> > stack;
@@ -1403,7 +1478,12 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
                 return set_error(serror, SCRIPT_ERR_WITNESS_PROGRAM_MISMATCH); // 2 items in witness
             }
             scriptPubKey << OP_DUP << OP_HASH160 << program << OP_EQUALVERIFY << OP_CHECKSIG;
-            stack = witness.stack;
+            // The script is fully determined by the template, so verify the
+            // two witness items directly instead of dispatching through the
+            // interpreter. Oversize items fail first, as below.
+            if (witness.stack[0].size() > MAX_SCRIPT_ELEMENT_SIZE || witness.stack[1].size() > MAX_SCRIPT_ELEMENT_SIZE)
+                return set_error(serror, SCRIPT_ERR_PUSH_SIZE);
+            return VerifyPubKeyHashFastPath(witness.stack[0], witness.stack[1], scriptPubKey, flags, checker, SIGVERSION_WITNESS_V0, serror);
         } else {
             return set_error(serror, SCRIPT_ERR_WITNESS_PROGRAM_WRONG_LENGTH);
         }
@@ -1432,6 +1512,63 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
     return true;
 }
 
+/**
+ * Matcher for the standard pay-to-pubkey-hash spend:
+ *   scriptPubKey: OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+ *   scriptSig:    <sig> <pubkey> as exactly two direct pushes
+ * Only direct pushes of 2..75 bytes are accepted; those are minimal for
+ * every length, so the fast path never has to reason about
+ * SCRIPT_VERIFY_MINIMALDATA.
+ */
+static bool IsP2PKHSpend(const CScript& scriptSig, const CScript& scriptPubKey, valtype& vchSig, valtype& vchPubKey)
+{
+    if (scriptPubKey.size() != 25 || scriptPubKey[0] != OP_DUP || scriptPubKey[1] != OP_HASH160 ||
+        scriptPubKey[2] != 20 || scriptPubKey[23] != OP_EQUALVERIFY || scriptPubKey[24] != OP_CHECKSIG)
+        return false;
+
+    CScript::const_iterator pc = scriptSig.begin();
+    opcodetype opcode;
+    if (!scriptSig.GetOp(pc, opcode, vchSig) || opcode < 2 || opcode > 75)
+        return false;
+    if (!scriptSig.GetOp(pc, opcode, vchPubKey) || opcode < 2 || opcode > 75)
+        return false;
+    return pc == scriptSig.end();
+}
+
+/**
+ * Evaluate a pay-to-pubkey-hash spend directly against the 25-byte template
+ * in scriptPubKey, skipping the interpreter loop and its per-push stack
+ * allocations. Used for bare P2PKH (SIGVERSION_BASE, matched by
+ * IsP2PKHSpend) and for version-0 20-byte witness programs
+ * (SIGVERSION_WITNESS_V0, where the caller has rebuilt the template). The
+ * checks run in interpreter order — hash compare first, then signature and
+ * pubkey encoding — so both the outcome and the reported script error are
+ * exactly those full evaluation would produce.
+ */
+static bool VerifyPubKeyHashFastPath(const valtype& vchSig, const valtype& vchPubKey, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
+{
+    valtype vchHash(20);
+    CHash160().Write(begin_ptr(vchPubKey), vchPubKey.size()).Finalize(begin_ptr(vchHash));
+    if (!std::equal(vchHash.begin(), vchHash.end(), scriptPubKey.begin() + 3))
+        return set_error(serror, SCRIPT_ERR_EQUALVERIFY);
+
+    if (!CheckSignatureEncoding(vchSig, flags, serror) || !CheckPubKeyEncoding(vchPubKey, flags, sigversion, serror)) {
+        // serror is set
+        return false;
+    }
+
+    // The signature cannot occur as a push inside the 25-byte template, so
+    // the FindAndDelete of OP_CHECKSIG is a no-op here and scriptCode is
+    // the scriptPubKey itself.
+    if (!checker.CheckSig(vchSig, vchPubKey, scriptPubKey, sigversion)) {
+        if ((flags & SCRIPT_VERIFY_NULLFAIL) && vchSig.size())
+            return set_error(serror, SCRIPT_ERR_SIG_NULLFAIL);
+        return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+    }
+
+    return set_success(serror);
+}
+
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
 {
     static const CScriptWitness emptyWitness;
@@ -1446,6 +1583,14 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
         return set_error(serror, SCRIPT_ERR_SIG_PUSHONLY);
     }
 
+    // Fast path for the dominant output type. Anything that does not match
+    // the template exactly (or carries witness data) takes the interpreter.
+    {
+        valtype vchSig, vchPubKey;
+        if (witness->IsNull() && IsP2PKHSpend(scriptSig, scriptPubKey, vchSig, vchPubKey))
+            return VerifyPubKeyHashFastPath(vchSig, vchPubKey, scriptPubKey, flags, checker, SIGVERSION_BASE, serror);
+    }
+
     vector<vector<unsigned char> > stack, stackCopy;
     if (!EvalScript(stack, scriptSig, flags, checker, SIGVERSION_BASE, serror))
         // serror is set
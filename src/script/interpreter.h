@@ -7,6 +7,7 @@
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
 #include "script_error.h"
+#include "crypto/sha256.h"
 #include "primitives/transaction.h"
 
 #include <vector>
@@ -125,6 +126,16 @@ struct PrecomputedTransactionData
     uint256 hashPrevouts, hashSequence, hashOutputs;
     bool ready = false;
 
+    /** Legacy SIGHASH_ALL midstates: the transaction serialized with every
+     *  scriptSig blanked, the offset of each input's (empty) script field in
+     *  that serialization, and the inner-SHA256 state up to that offset.
+     *  SignatureHash() splices the real scriptCode in at the offset instead of
+     *  re-serializing the whole transaction for every input. */
+    std::vector<unsigned char> vchLegacyBlank;
+    std::vector<size_t> vLegacyScriptPos;
+    std::vector<CSHA256> vLegacyMidstate;
+    bool legacyReady = false;
+
     explicit PrecomputedTransactionData(const CTransaction& tx);
 };
 
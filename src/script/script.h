@@ -412,8 +412,14 @@ private:
  *  of vectors in cases where they normally contain a small number of small elements.
  * Tests in October 2015 showed use of this reduced dbcache memory usage by 23%
  *  and made an initial sync 13% faster.
+ *
+ * Upstream sizes the inline buffer at 28 bytes, enough for P2PKH (25), P2SH
+ * (23) and witness program (22/34) outputs. On this chain every coinstake and
+ * coinbase output is P2PK (35 bytes), so those all spilled to the heap; 36
+ * keeps them inline too and keeps sizeof a multiple of 8. See
+ * bench/prevector.cpp for the size distribution this was measured against.
  */
-typedef prevector<28, unsigned char> CScriptBase;
+typedef prevector<36, unsigned char> CScriptBase;
 
 /** Serialized script, used inside transaction inputs and outputs */
 class CScript : public CScriptBase
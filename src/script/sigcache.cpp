@@ -5,72 +5,160 @@
 
 #include "sigcache.h"
 
+#include "crypto/sha256.h"
+#include "memusage.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
+
+#include <atomic>
+#include <limits>
+#include <set>
 
 namespace {
 
+//! Current byte budget; the sentinel means "not set yet, use -maxsigcachesize".
+std::atomic<size_t> nSigCacheMaxBytes(std::numeric_limits<size_t>::max());
+std::atomic<uint64_t> nSigCacheLookups(0);
+std::atomic<uint64_t> nSigCacheHits(0);
+
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
- * again when accepted into the block chain)
+ * again when accepted into the block chain).
+ *
+ * The cache is sharded so that concurrent AcceptToMemoryPool and block
+ * validation threads hash into independent sets guarded by independent
+ * locks, instead of serializing on one global mutex. Entries are stored
+ * as a salted hash of (sighash, signature, pubkey), which both shrinks
+ * the per-entry footprint and prevents an attacker from precomputing a
+ * set of colliding valid entries against a known cache layout.
  */
 class CSignatureCache
 {
 private:
-     //! sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
-    std::set< sigdata_type> setValid;
-    boost::shared_mutex cs_sigcache;
+    //! Number of independently locked shards; must be a power of two.
+    static const unsigned int SIGCACHE_SHARDS = 16;
+    //! Approximate memory usage of one std::set node holding a uint256.
+    static const size_t SIGCACHE_ENTRY_OVERHEAD = 96;
+
+    //! Per-instance salt, so entries cannot be precomputed offline.
+    uint256 nonce;
+    std::set<uint256> setValid[SIGCACHE_SHARDS];
+    boost::shared_mutex cs_sigcache[SIGCACHE_SHARDS];
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey) const
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(&pubKey[0], pubKey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    static unsigned int ShardFor(const uint256& entry)
+    {
+        return entry.begin()[0] & (SIGCACHE_SHARDS - 1);
+    }
 
 public:
-    bool
-    Get(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    CSignatureCache()
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        GetRandBytes(nonce.begin(), 32);
+    }
 
-        sigdata_type k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
-        return false;
+    bool
+    Get(const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    {
+        uint256 entry;
+        ComputeEntry(entry, hash, vchSig, pubKey);
+        const unsigned int nShard = ShardFor(entry);
+
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache[nShard]);
+        nSigCacheLookups++;
+        bool fHit = setValid[nShard].count(entry) != 0;
+        if (fHit)
+            nSigCacheHits++;
+        return fHit;
     }
 
-    void Set(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    void Set(const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
     {
-        size_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+        size_t nMaxCacheSize = GetSignatureCacheSize();
         if (nMaxCacheSize <= 0) return;
+        size_t nMaxShardEntries = nMaxCacheSize / SIGCACHE_ENTRY_OVERHEAD / SIGCACHE_SHARDS;
+
+        uint256 entry;
+        ComputeEntry(entry, hash, vchSig, pubKey);
+        const unsigned int nShard = ShardFor(entry);
 
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache[nShard]);
 
-        while (static_cast<size_t>(setValid.size()) > nMaxCacheSize)
-        {
+        while (setValid[nShard].size() > nMaxShardEntries) {
             // Evict a random entry. Random because that helps
             // foil would-be DoS attackers who might try to pre-generate
             // and re-use a set of valid signatures just-slightly-greater
             // than our cache size.
             uint256 randomHash = GetRandHash();
-            std::set<sigdata_type>::iterator it = setValid.lower_bound(sigdata_type(randomHash));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
+            std::set<uint256>::iterator it = setValid[nShard].lower_bound(randomHash);
+            if (it == setValid[nShard].end())
+                it = setValid[nShard].begin();
+            setValid[nShard].erase(it);
         }
 
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+        setValid[nShard].insert(entry);
+    }
+
+    size_t DynamicMemoryUsage()
+    {
+        size_t nUsage = 0;
+        for (unsigned int i = 0; i < SIGCACHE_SHARDS; i++) {
+            boost::shared_lock<boost::shared_mutex> lock(cs_sigcache[i]);
+            nUsage += memusage::DynamicUsage(setValid[i]);
+        }
+        return nUsage;
     }
 };
 
+//! Lazily constructed so the nonce is drawn after the RNG is warmed up.
+CSignatureCache& StaticSignatureCache()
+{
+    static CSignatureCache signatureCache;
+    return signatureCache;
+}
+
+}
+
+void SetSignatureCacheSize(size_t nBytes)
+{
+    nSigCacheMaxBytes = nBytes;
+}
+
+size_t GetSignatureCacheSize()
+{
+    size_t nBytes = nSigCacheMaxBytes;
+    if (nBytes == std::numeric_limits<size_t>::max())
+        nBytes = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t)1 << 20);
+    return nBytes;
+}
+
+uint64_t GetSignatureCacheLookups()
+{
+    return nSigCacheLookups;
+}
+
+uint64_t GetSignatureCacheHits()
+{
+    return nSigCacheHits;
+}
+
+size_t SignatureCacheDynamicUsage()
+{
+    return StaticSignatureCache().DynamicMemoryUsage();
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
+    CSignatureCache& signatureCache = StaticSignatureCache();
 
     if (signatureCache.Get(sighash, vchSig, pubkey))
         return true;
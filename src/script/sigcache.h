@@ -16,6 +16,15 @@ static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 40;
 
 class CPubKey;
 
+/** Runtime-adjustable signature cache budget (bytes) plus lookup telemetry,
+ *  consumed by the cache rebalancer in main.cpp. The budget defaults to
+ *  -maxsigcachesize until the first SetSignatureCacheSize call. */
+void SetSignatureCacheSize(size_t nBytes);
+size_t GetSignatureCacheSize();
+uint64_t GetSignatureCacheLookups();
+uint64_t GetSignatureCacheHits();
+size_t SignatureCacheDynamicUsage();
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
@@ -12,6 +12,10 @@
 
 
 #include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include <unordered_map>
 
 /////////////////////////////////////////////////////////// lux
 #include <lux/luxstate.h>
@@ -51,7 +55,7 @@ const char* GetTxnOutputType(txnouttype t)
 /**
  * Return public keys or hashes from scriptPubKey, for 'standard' transaction types.
  */
-bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsigned char> >& vSolutionsRet, bool contractConsensus)
+static bool SolverTemplateMatch(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsigned char> >& vSolutionsRet, bool contractConsensus)
 {
     //contractConsesus is true when evaluating if a contract tx is "standard" for consensus purposes
     //It is false in all other cases, so to prevent a particular contract tx from being broadcast on mempool, but allowed in blocks,
@@ -285,6 +289,61 @@ bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsi
     return false;
 }
 
+namespace {
+/** Memoized Solver result for one scriptPubKey. Scripts are immutable, so
+ *  entries never go stale; the map is bounded purely for memory. */
+struct CSolverCacheEntry {
+    bool fOk;
+    txnouttype type;
+    std::vector<std::vector<unsigned char> > vSolutions;
+};
+
+struct CScriptBytesHasher {
+    size_t operator()(const CScript& script) const
+    {
+        return boost::hash_range(script.begin(), script.end());
+    }
+};
+
+static const size_t MAX_SOLVER_CACHE_SIZE = 50000;
+boost::shared_mutex cs_solverCache;
+std::unordered_map<CScript, CSolverCacheEntry, CScriptBytesHasher> mapSolverCache;
+} // anon namespace
+
+bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsigned char> >& vSolutionsRet, bool contractConsensus)
+{
+    // The contract-consensus evaluation applies different gas and version
+    // rules to the same script, so only the common policy path is memoized.
+    if (contractConsensus)
+        return SolverTemplateMatch(scriptPubKey, typeRet, vSolutionsRet, contractConsensus);
+
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_solverCache);
+        std::unordered_map<CScript, CSolverCacheEntry, CScriptBytesHasher>::const_iterator it = mapSolverCache.find(scriptPubKey);
+        if (it != mapSolverCache.end()) {
+            typeRet = it->second.type;
+            vSolutionsRet = it->second.vSolutions;
+            return it->second.fOk;
+        }
+    }
+
+    bool fOk = SolverTemplateMatch(scriptPubKey, typeRet, vSolutionsRet, false);
+
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_solverCache);
+        // Wholesale flush when full: the working set (mempool scripts plus
+        // recent blocks) repopulates within seconds and stays well under the
+        // bound, so eviction machinery isn't worth its bookkeeping.
+        if (mapSolverCache.size() >= MAX_SOLVER_CACHE_SIZE)
+            mapSolverCache.clear();
+        CSolverCacheEntry& entry = mapSolverCache[scriptPubKey];
+        entry.fOk = fOk;
+        entry.type = typeRet;
+        entry.vSolutions = vSolutionsRet;
+    }
+    return fOk;
+}
+
 bool ExtractDestination(const CScript& scriptPubKey, CTxDestination& addressRet, txnouttype *typeRet)
 {
     vector<valtype> vSolutions;
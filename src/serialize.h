@@ -431,6 +431,7 @@ I ReadVarInt(Stream& is)
 
 #define FLATDATA(obj) REF(CFlatData((char*)&(obj), (char*)&(obj) + sizeof(obj)))
 #define VARINT(obj) REF(WrapVarInt(REF(obj)))
+#define COMPACTSIZE(obj) REF(CCompactSize(REF(obj)))
 #define LIMITED_STRING(obj, n) REF(LimitedString<n>(REF(obj)))
 
 /** 
@@ -506,6 +507,32 @@ public:
     }
 };
 
+class CCompactSize
+{
+protected:
+    uint64_t& n;
+
+public:
+    CCompactSize(uint64_t& nIn) : n(nIn) {}
+
+    unsigned int GetSerializeSize(int, int) const
+    {
+        return GetSizeOfCompactSize(n);
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int, int) const
+    {
+        WriteCompactSize<Stream>(s, n);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int, int)
+    {
+        n = ReadCompactSize<Stream>(s);
+    }
+};
+
 template <size_t Limit>
 class LimitedString
 {
@@ -584,6 +611,29 @@ void Unserialize_impl(Stream& is, prevector<N, T>& v, int nType, int nVersion, c
 template<typename Stream, unsigned int N, typename T>
 inline void Unserialize(Stream& is, prevector<N, T>& v, int nType, int nVersion);
 
+/**
+ * Element types whose serialized form is byte-for-byte their in-memory
+ * representation (raw write, no length prefix, no endian conversion).
+ * Vectors of such types are read and written in bulk instead of
+ * element-by-element; the flag is a compile-time constant, so the branch
+ * in the vector paths folds away. The hash types are marked here rather
+ * than in uint256.h because that header does not include this one.
+ */
+template <typename T>
+struct TSerializeAsBytes {
+    static const bool value = false;
+};
+class uint160;
+class uint256;
+template <>
+struct TSerializeAsBytes<uint160> {
+    static const bool value = true;
+};
+template <>
+struct TSerializeAsBytes<uint256> {
+    static const bool value = true;
+};
+
 /**
  * vector
  * vectors of unsigned char are a special case and are intended to be serialized as a single opaque blob.
@@ -801,6 +851,8 @@ unsigned int GetSerializeSize_impl(const std::vector<T, A>& v, int nType, int nV
 template <typename T, typename A, typename V>
 unsigned int GetSerializeSize_impl(const std::vector<T, A>& v, int nType, int nVersion, const V&)
 {
+    if (TSerializeAsBytes<T>::value)
+        return (GetSizeOfCompactSize(v.size()) + v.size() * sizeof(T));
     unsigned int nSize = GetSizeOfCompactSize(v.size());
     for (typename std::vector<T, A>::const_iterator vi = v.begin(); vi != v.end(); ++vi)
         nSize += GetSerializeSize((*vi), nType, nVersion);
@@ -826,6 +878,12 @@ template <typename Stream, typename T, typename A, typename V>
 void Serialize_impl(Stream& os, const std::vector<T, A>& v, int nType, int nVersion, const V&)
 {
     WriteCompactSize(os, v.size());
+    if (TSerializeAsBytes<T>::value) {
+        // Bulk path: the serialized form is the element bytes back to back
+        if (!v.empty())
+            os.write((char*)&v[0], v.size() * sizeof(T));
+        return;
+    }
     for (typename std::vector<T, A>::const_iterator vi = v.begin(); vi != v.end(); ++vi)
         ::Serialize(os, (*vi), nType, nVersion);
 }
@@ -857,6 +915,17 @@ void Unserialize_impl(Stream& is, std::vector<T, A>& v, int nType, int nVersion,
 {
     v.clear();
     unsigned int nSize = ReadCompactSize(is);
+    if (TSerializeAsBytes<T>::value) {
+        // Bulk path; still chunked so a bogus size cannot allocate at will
+        unsigned int i = 0;
+        while (i < nSize) {
+            unsigned int blk = std::min(nSize - i, (unsigned int)(1 + 4999999 / sizeof(T)));
+            v.resize(i + blk);
+            is.read((char*)&v[i], blk * sizeof(T));
+            i += blk;
+        }
+        return;
+    }
     unsigned int i = 0;
     unsigned int nMid = 0;
     while (nMid < nSize) {
@@ -879,22 +948,23 @@ inline void Unserialize(Stream& is, std::vector<T, A>& v, int nType, int nVersio
 /**
  * others derived from vector
  */
+// the prevector specialization below must stay in sync with CScriptBase
 inline unsigned int GetSerializeSize(const CScript& v, int nType, int nVersion)
 {
-    return GetSerializeSize((const prevector<28,unsigned char>&)v, nType, nVersion);
+    return GetSerializeSize((const prevector<36,unsigned char>&)v, nType, nVersion);
 }
 
 template <typename Stream>
 void Serialize(Stream& os, const CScript& v, int nType, int nVersion)
 {
-    Serialize(os, (const prevector<28,unsigned char>&)v, nType, nVersion);
+    Serialize(os, (const prevector<36,unsigned char>&)v, nType, nVersion);
 }
 
 template <typename Stream>
 void Unserialize(Stream& is, CScript& v, int nType, int nVersion)
 {
     //TODO: replace prevector with CScriptBase
-    Unserialize(is, (prevector<28,unsigned char>&)v, nType, nVersion);
+    Unserialize(is, (prevector<36,unsigned char>&)v, nType, nVersion);
 }
 
 
@@ -0,0 +1,89 @@
+// Copyright (c) 2015-2017 The Lux developers                      -*- c++ -*-
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SPENTINDEX_H
+#define BITCOIN_SPENTINDEX_H
+
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+/** Outpoint being looked up in the -spentindex. */
+struct CSpentIndexKey {
+    uint256 txid;
+    unsigned int outputIndex;
+
+    CSpentIndexKey()
+    {
+        SetNull();
+    }
+
+    CSpentIndexKey(const uint256& t, unsigned int i) : txid(t), outputIndex(i)
+    {
+    }
+
+    void SetNull()
+    {
+        txid.SetNull();
+        outputIndex = 0;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(outputIndex);
+    }
+};
+
+/** Where and by what an outpoint was spent, plus the funding details. */
+struct CSpentIndexValue {
+    uint256 txid;
+    unsigned int inputIndex;
+    int blockHeight;
+    CAmount satoshis;
+    unsigned char addressType;
+    uint160 addressHash;
+
+    CSpentIndexValue()
+    {
+        SetNull();
+    }
+
+    CSpentIndexValue(const uint256& t, unsigned int i, int h, CAmount s, unsigned char type, const uint160& hash) : txid(t), inputIndex(i), blockHeight(h), satoshis(s), addressType(type), addressHash(hash)
+    {
+    }
+
+    void SetNull()
+    {
+        txid.SetNull();
+        inputIndex = 0;
+        blockHeight = 0;
+        satoshis = 0;
+        addressType = 0;
+        addressHash.SetNull();
+    }
+
+    bool IsNull() const
+    {
+        return txid.IsNull();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(inputIndex);
+        READWRITE(blockHeight);
+        READWRITE(satoshis);
+        READWRITE(addressType);
+        READWRITE(addressHash);
+    }
+};
+
+#endif // BITCOIN_SPENTINDEX_H
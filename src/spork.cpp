@@ -17,6 +17,9 @@
 #include "main.h"
 #include <boost/lexical_cast.hpp>
 
+#include <atomic>
+#include <limits>
+
 using namespace std;
 using namespace boost;
 
@@ -27,6 +30,42 @@ std::map<uint256, CSporkMessage> mapSporks;
 std::map<int, CSporkMessage> mapSporksActive;
 CSporkManager sporkManager;
 
+boost::signals2::signal<void(int nSporkID, int64_t nValue)> NotifySporkChanged;
+
+//! Cache sentinel: no signed spork seen, fall back to the compiled-in default.
+static const int64_t SPORK_VALUE_UNSET = std::numeric_limits<int64_t>::min();
+
+/** Dense per-ID cache of the active spork values. The hot checks in the
+ *  validation paths are a single relaxed atomic load; the maps are only
+ *  touched on the (rare) spork message path.
+ */
+static std::atomic<int64_t> sporkCache[SPORK_CACHE_SIZE];
+
+static struct SporkCacheInitializer {
+    SporkCacheInitializer() {
+        for (int i = 0; i < SPORK_CACHE_SIZE; i++)
+            sporkCache[i].store(SPORK_VALUE_UNSET, std::memory_order_relaxed);
+    }
+} sporkCacheInitializer;
+
+//! The compiled-in default value of a spork, or -1 for unknown IDs.
+static int64_t GetSporkDefault(int nSporkID) {
+    if (nSporkID == SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT) return SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT_DEFAULT;
+    if (nSporkID == SPORK_2_MAX_VALUE) return SPORK_2_MAX_VALUE_DEFAULT;
+    if (nSporkID == SPORK_3_REPLAY_BLOCKS) return SPORK_3_REPLAY_BLOCKS_DEFAULT;
+    if (nSporkID == SPORK_5_REPLAY_BLOCKS) return SPORK_5_REPLAY_BLOCKS_DEFAULT;
+    if (nSporkID == SPORK_6_RECONSIDER_BLOCKS) return SPORK_6_RECONSIDER_BLOCKS_DEFAULT;
+    if (nSporkID == SPORK_7_INSTANTX) return SPORK_7_INSTANTX_DEFAULT;
+    return -1;
+}
+
+//! Update the dense cache and fire the change-notification hook.
+static void SetSporkCachedValue(int nSporkID, int64_t nValue) {
+    if (nSporkID >= SPORK_CACHE_FIRST && nSporkID <= SPORK_END)
+        sporkCache[nSporkID - SPORK_CACHE_FIRST].store(nValue, std::memory_order_relaxed);
+    NotifySporkChanged(nSporkID, nValue);
+}
+
 void ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, bool& isSporkCommand) {
     if (strCommand == "spork") {
         isSporkCommand = true;
@@ -58,6 +97,7 @@ void ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRec
 
         mapSporks[hash] = spork;
         mapSporksActive[spork.nSporkID] = spork;
+        SetSporkCachedValue(spork.nSporkID, spork.nValue);
         sporkManager.Relay(spork);
 
         //does a task if needed
@@ -75,21 +115,25 @@ void ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRec
     }
 }
 
-// grab the spork, otherwise say it's off
-bool IsSporkActive(int nSporkID) {
-    int64_t r = -1;
-
-    if (mapSporksActive.count(nSporkID)) {
+//! Current value of a spork: the dense cache for IDs it covers, the active
+//! map for stray IDs, the compiled-in default (-1 if unknown) otherwise.
+static int64_t GetSporkValueOrDefault(int nSporkID) {
+    int64_t r = SPORK_VALUE_UNSET;
+    if (nSporkID >= SPORK_CACHE_FIRST && nSporkID <= SPORK_END)
+        r = sporkCache[nSporkID - SPORK_CACHE_FIRST].load(std::memory_order_relaxed);
+    else if (mapSporksActive.count(nSporkID))
         r = mapSporksActive[nSporkID].nValue;
-    } else {
-        if (nSporkID == SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT) r = SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_2_MAX_VALUE) r = SPORK_2_MAX_VALUE_DEFAULT;
-        if (nSporkID == SPORK_3_REPLAY_BLOCKS) r = SPORK_3_REPLAY_BLOCKS_DEFAULT;
-        if (nSporkID == SPORK_5_REPLAY_BLOCKS) r = SPORK_5_REPLAY_BLOCKS_DEFAULT;
-        if (nSporkID == SPORK_6_RECONSIDER_BLOCKS) r = SPORK_6_RECONSIDER_BLOCKS_DEFAULT;
-        if (nSporkID == SPORK_7_INSTANTX) r = SPORK_7_INSTANTX_DEFAULT;
+
+    if (r == SPORK_VALUE_UNSET) {
+        r = GetSporkDefault(nSporkID);
         if (r == -1 && fDebug) LogPrintf("GetSpork::Unknown Spork %d\n", nSporkID);
     }
+    return r;
+}
+
+// grab the spork, otherwise say it's off
+bool IsSporkActive(int nSporkID) {
+    int64_t r = GetSporkValueOrDefault(nSporkID);
     if (r == -1) r = 4070908800; //return 2099-1-1 by default
 
     return r < GetTime();
@@ -97,18 +141,8 @@ bool IsSporkActive(int nSporkID) {
 
 // grab the value of the spork on the network, or the default
 int GetSporkValue(int nSporkID) {
-    int r = 0;
-    if (mapSporksActive.count(nSporkID)) {
-        r = mapSporksActive[nSporkID].nValue;
-    } else {
-        if (nSporkID == SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT) r = SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT_DEFAULT;
-        if (nSporkID == SPORK_2_MAX_VALUE) r = SPORK_2_MAX_VALUE_DEFAULT;
-        if (nSporkID == SPORK_3_REPLAY_BLOCKS) r = SPORK_3_REPLAY_BLOCKS_DEFAULT;
-        if (nSporkID == SPORK_5_REPLAY_BLOCKS) r = SPORK_5_REPLAY_BLOCKS_DEFAULT;
-        if (nSporkID == SPORK_6_RECONSIDER_BLOCKS) r = SPORK_6_RECONSIDER_BLOCKS_DEFAULT;
-        if (nSporkID == SPORK_7_INSTANTX) r = SPORK_7_INSTANTX_DEFAULT;
-        if (r == 0 && fDebug) LogPrintf("GetSpork::Unknown Spork %d\n", nSporkID);
-    }
+    int64_t r = GetSporkValueOrDefault(nSporkID);
+    if (r == -1) r = 0;
 
     return r;
 }
@@ -200,6 +234,7 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue) {
         Relay(msg);
         mapSporks[msg.GetHash()] = msg;
         mapSporksActive[nSporkID] = msg;
+        SetSporkCachedValue(nSporkID, nValue);
         return true;
     }
 
@@ -20,6 +20,10 @@ using namespace boost;
 
 #define SPORK_START                                           10001
 #define SPORK_END                                             10007
+
+// The dense spork value cache covers this contiguous ID range
+#define SPORK_CACHE_FIRST                                     10000
+#define SPORK_CACHE_SIZE                                      (SPORK_END - SPORK_CACHE_FIRST + 1)
 // Don't ever reuse these IDs for other sporks
 #define SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT               10000
 #define SPORK_2_MAX_VALUE                                     10002
@@ -47,6 +51,7 @@ class CSporkManager;
 #include "protocol.h"
 #include "darksend.h"
 #include <boost/lexical_cast.hpp>
+#include <boost/signals2/signal.hpp>
 
 using namespace std;
 using namespace boost;
@@ -58,6 +63,9 @@ extern std::map<uint256, CSporkMessage> mapSporks;
 extern std::map<int, CSporkMessage> mapSporksActive;
 extern CSporkManager sporkManager;
 
+/** Fired with the ID and new value whenever a spork's cached value changes. */
+extern boost::signals2::signal<void(int nSporkID, int64_t nValue)> NotifySporkChanged;
+
 void ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, bool &isSporkCommand);
 int GetSporkValue(int nSporkID);
 bool IsSporkActive(int nSporkID);
@@ -7,11 +7,13 @@
 
 #include "db.h"
 #include "stake.h"
+#include "crypto/common.h"
 #include "init.h"
 #include "chainparams.h"
 #include "policy/policy.h"
 #include "main.h"
 #include "miner.h"
+#include "perf.h"
 #include "wallet.h"
 #include "masternode.h"
 #include "utilmoneystr.h"
@@ -68,6 +70,14 @@ Stake::Stake()
     , nStakeMinAge(0)
     , nHashInterval(0)
     , nReserveBalance(0)
+    , setStakeCandidates()
+    , hashCandidateTip(0)
+    , nCandidateGeneration(0)
+    , nCandidateTargetAmount(0)
+    , fSweepValid(false)
+    , hashSweepTip(0)
+    , nSweepWindowEnd(0)
+    , nNextKernelTime(0)
     , mapStakes()
     , mapHashedBlocks()
     , mapProofOfStake()
@@ -198,6 +208,18 @@ bool Stake::ComputeNextModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeM
         return true;
     }
 
+    // The modifier is a pure function of the prev-block ancestry, so reuse
+    // a memoized result when several blocks build on the same parent.
+    const uint256 hashPrev = pindexPrev->GetBlockHash();
+    {
+        auto const mi = mapModifierCache.find(hashPrev);
+        if (mi != mapModifierCache.end()) {
+            nStakeModifier = mi->second.first;
+            fGeneratedStakeModifier = mi->second.second;
+            return true;
+        }
+    }
+
     // First find current stake modifier and its generation block time
     // if it's not old enough, return the same stake modifier
     int64_t nModifierTime = 0;
@@ -210,8 +232,11 @@ bool Stake::ComputeNextModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeM
 #   endif
 
     auto const nPrevRounds = pindexPrev->GetBlockTime() / GetInterval();
-    if (nModifierTime / GetInterval() >= nPrevRounds)
+    if (nModifierTime / GetInterval() >= nPrevRounds) {
+        if (mapModifierCache.size() > 4096) mapModifierCache.clear();
+        mapModifierCache[hashPrev] = std::make_pair(nStakeModifier, false);
         return true;
+    }
 
     // Sort candidate blocks by timestamp
     vector< pair<int64_t, uint256> > vSortedCandidates;
@@ -282,6 +307,8 @@ bool Stake::ComputeNextModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeM
 
     nStakeModifier = nStakeModifierNew;
     fGeneratedStakeModifier = true;
+    if (mapModifierCache.size() > 4096) mapModifierCache.clear();
+    mapModifierCache[hashPrev] = std::make_pair(nStakeModifier, true);
     return true;
 }
 
@@ -354,7 +381,7 @@ bool MultiplyStakeTarget(uint256& bnTarget, int nModifierHeight, int64_t nModifi
 }
 
 //instead of looping outside and reinitializing variables many times, we will give a nTimeTx and also search interval so that we can do all the hashing here
-bool Stake::CheckHash(const CBlockIndex* pindexPrev, unsigned int nBits, const CBlock& blockFrom, const CTransaction& txPrev, const COutPoint& prevout, unsigned int& nTimeTx, uint256& hashProofOfStake) {
+bool Stake::CheckHash(const CBlockIndex* pindexPrev, unsigned int nBits, const CBlock& blockFrom, const CTransaction& txPrev, const COutPoint& prevout, unsigned int& nTimeTx, uint256& hashProofOfStake, unsigned int nSearchWindow) {
     if (pindexPrev == nullptr)
         return false;
 
@@ -390,42 +417,47 @@ bool Stake::CheckHash(const CBlockIndex* pindexPrev, unsigned int nBits, const C
     int nStakeModifierHeight = pindexPrev->nHeight;
     int64_t nStakeModifierTime = pindexPrev->nTime;
 
-    // Calculate hash
+    // Serialize the kernel preimage once.  Only the nTimeTx field differs
+    // across the search window, so every further candidate timestamp is a
+    // 4-byte patch plus one hash instead of a full reserialization.
     CDataStream ss(SER_GETHASH, 0);
     ss << nStakeModifier << nTimeBlockFrom << txPrev.nTime << prevout.hash << prevout.n << nTimeTx;
+    const size_t nTimePos = ss.size() - sizeof(nTimeTx);
     if (ENABLE_ADVANCED_STAKING && (GetBoolArg("-regtest", false) || nStakeModifierHeight >= ADVANCED_STAKING_HEIGHT)) {
         ss << nHashInterval << nSelectionPeriod << nStakeMinAge << nStakeSplitThreshold
            << bnWeight << nStakeModifierTime;
     }
-    hashProofOfStake = Hash(ss.begin(), ss.end());
 
-    if (fDebug) {
-#       if 0
-        LogPrintf("%s: using modifier 0x%016x at height=%d timestamp=%s for block from timestamp=%s\n", __func__,
-                  nStakeModifier, nStakeModifierHeight,
-                  DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nStakeModifierTime).c_str(),
-                  DateTimeStrFormat("%Y-%m-%d %H:%M:%S", blockFrom.GetBlockTime()).c_str());
-        LogPrintf("%s: check modifier=0x%016x nTimeBlockFrom=%u nTimeTxPrev=%u nPrevout=%u nTimeTx=%u hashProof=%s\n", __func__,
-                  nStakeModifier,
-                  blockFrom.GetBlockTime(), txPrev.nTime, prevout.n, nTimeTx,
-                  hashProofOfStake.ToString());
-#       endif
-        DEBUG_DUMP_STAKING_INFO_CheckHash();
-    }
+    if (nSearchWindow < 1)
+        nSearchWindow = 1;
+    unsigned int nTryTime = nTimeTx;
+    for (unsigned int n = 0; n < nSearchWindow; n++, nTryTime--) {
+        // the same protocol limits as for the starting timestamp
+        if (nTryTime < txPrev.nTime || GetStakeAge(nTimeBlockFrom) > nTryTime)
+            break;
 
-    if (Params().NetworkID() == CBaseChainParams::MAIN && hashProofOfStake > bnTarget && nStakeModifierHeight < 174453 && nStakeModifierHeight <= LAST_MULTIPLIED_BLOCK) {
-        DEBUG_DUMP_MULTIFIER();
-        if (!MultiplyStakeTarget(bnTarget, nStakeModifierHeight, nStakeModifierTime, nValueIn)) {
-#           if 1
-            return false;
-#           else
-            return error("%s: cant adjust stake target %s, %d, %d", __func__, bnTarget.GetHex(), nStakeModifierHeight, nStakeModifierTime);
-#           endif
+        WriteLE32((unsigned char*)&ss[nTimePos], nTryTime);
+        hashProofOfStake = Hash(ss.begin(), ss.end());
+
+        if (fDebug) {
+            DEBUG_DUMP_STAKING_INFO_CheckHash();
         }
-    }
 
-    // Now check if proof-of-stake hash meets target protocol
-    return !(hashProofOfStake > bnTarget);
+        uint256 bnTargetTry = bnTarget;
+        if (Params().NetworkID() == CBaseChainParams::MAIN && hashProofOfStake > bnTargetTry && nStakeModifierHeight < 174453 && nStakeModifierHeight <= LAST_MULTIPLIED_BLOCK) {
+            DEBUG_DUMP_MULTIFIER();
+            if (!MultiplyStakeTarget(bnTargetTry, nStakeModifierHeight, nStakeModifierTime, nValueIn)) {
+                continue;
+            }
+        }
+
+        // Now check if proof-of-stake hash meets target protocol
+        if (!(hashProofOfStake > bnTargetTry)) {
+            nTimeTx = nTryTime;
+            return true;
+        }
+    }
+    return false;
 }
 
 // Check kernel hash target and coinstake signature
@@ -488,27 +520,45 @@ unsigned int Stake::GetModifierChecksum(const CBlockIndex* pindex) {
     return hashChecksum.Get64();
 }
 
+// Hard checkpoints of stake modifiers to ensure they are deterministic.
+// Compiled into a sorted flat table so a lookup is a binary search with no
+// allocation or node-based map behind it; heights past the last entry (the
+// steady state once synced) bail out on a single compare.
+namespace {
+struct ModifierCheckpoint {
+    int nHeight;
+    unsigned int nChecksum;
+};
+constexpr ModifierCheckpoint vnModifierCheckpoints[] = {
+    {0,      0xfd11f4e7u}, {1,      0x6bf176c7u}, {10,     0xc533c5deu}, {20,     0x722262a0u},
+    {30,     0xdd0abd8au}, {90,     0x0308db9cu}, {409,    0xa9e2be4au}, {410,    0xc23d7dd1u},
+    {1141,   0xe81ae310u}, {1144,   0x6543da9du}, {1154,   0x8d110f11u}, {2914,   0x4fc1bc8du},
+    {2915,   0xf5c77be4u}, {2916,   0x838297bau}, {2991,   0x6873f1efu}, {3000,   0xffc1801fu},
+    {3001,   0x4b76d1f9u}, {3035,   0x5cd70041u}, {3036,   0xc689f15au}, {3040,   0x19e1fa9eu},
+    {3046,   0xa53146c5u}, {3277,   0x992f3f6cu}, {3278,   0x9db692d0u}, {3288,   0x96fb270du},
+    {3438,   0x2ea722b2u}, {4003,   0xdf3987e9u}, {4012,   0x205080bcu}, {4025,   0x19ebed80u},
+    {4034,   0xd02dd7ecu}, {4045,   0x4b753d54u}, {4053,   0xe7265e2au}, {10004,  0x09b6b5e1u},
+    {10016,  0x05be852du}, {10023,  0x4dcc3f34u}, {10036,  0x5c16bf7du}, {10049,  0x3b542151u},
+    {19998,  0x52052da4u}, {20338,  0x3174b362u}, {20547,  0x5e94b5acu}, {20555,  0x5d77d04au},
+    {33742,  0x998c4a1bu}, {127733, 0x92aa36acu}, {129248, 0x680b9ce2u}, {130092, 0x202cab1fu},
+    {130775, 0x09694eb8u}, {130780, 0x02e5287fu}, {131465, 0x515203adu}, {132136, 0x81b5ef99u},
+    {132137, 0xb14a3a42u}, {135072, 0xea90da6au}, {139756, 0xb3d7fb47u}, {141584, 0xeee6259fu},
+    {143866, 0xcd2ed8ddu}, {151181, 0xc2377de7u}, {151659, 0x2bb1e741u}, {151660, 0xade7324du},
+};
+constexpr size_t nModifierCheckpoints = sizeof(vnModifierCheckpoints) / sizeof(vnModifierCheckpoints[0]);
+
+inline bool operator<(const ModifierCheckpoint& cp, int nHeight) { return cp.nHeight < nHeight; }
+}
+
 // Check stake modifier hard checkpoints
 bool Stake::CheckModifierCheckpoints(int nHeight, unsigned int nStakeModifierChecksum) {
     if (!IsTestNet()) return true; // Testnet has no checkpoints
 
-    // Hard checkpoints of stake modifiers to ensure they are deterministic
-    static std::map<int, unsigned int> mapStakeModifierCheckpoints = boost::assign::map_list_of(0, 0xfd11f4e7u)
-        (1,    0x6bf176c7u) (10,   0xc533c5deu) (20,   0x722262a0u) (30,   0xdd0abd8au) (90,   0x0308db9cu)
-        (409,  0xa9e2be4au) (410,  0xc23d7dd1u) (1141, 0xe81ae310u) (1144, 0x6543da9du) (1154, 0x8d110f11u)
-        (2914, 0x4fc1bc8du) (2916, 0x838297bau) (2915, 0xf5c77be4u) (2991, 0x6873f1efu) (3000, 0xffc1801fu)
-        (3001, 0x4b76d1f9u) (3035, 0x5cd70041u) (3036, 0xc689f15au) (3040, 0x19e1fa9eu) (3046, 0xa53146c5u)
-        (3277, 0x992f3f6cu) (3278, 0x9db692d0u) (3288, 0x96fb270du) (3438, 0x2ea722b2u) (4003, 0xdf3987e9u)
-        (4012, 0x205080bcu) (4025, 0x19ebed80u) (4034, 0xd02dd7ecu) (4045, 0x4b753d54u) (4053, 0xe7265e2au)
-        (10004,  0x09b6b5e1u) (10016,  0x05be852du) (10023,  0x4dcc3f34u) (10036,  0x5c16bf7du) (10049,  0x3b542151u)
-        (19998,  0x52052da4u) (20338,  0x3174b362u) (20547,  0x5e94b5acu) (20555,  0x5d77d04au) (33742,  0x998c4a1bu)
-        (127733, 0x92aa36acu) (129248, 0x680b9ce2u) (130092, 0x202cab1fu) (130775, 0x09694eb8u) (130780, 0x02e5287fu)
-        (131465, 0x515203adu) (132137, 0xb14a3a42u) (132136, 0x81b5ef99u) (135072, 0xea90da6au) (139756, 0xb3d7fb47u)
-        (141584, 0xeee6259fu) (143866, 0xcd2ed8ddu) (151181, 0xc2377de7u) (151659, 0x2bb1e741u) (151660, 0xade7324du)
-        ;
-    if (mapStakeModifierCheckpoints.count(nHeight)) {
-        return nStakeModifierChecksum == mapStakeModifierCheckpoints[nHeight];
-    }
+    if (nHeight > vnModifierCheckpoints[nModifierCheckpoints - 1].nHeight)
+        return true;
+    const ModifierCheckpoint* it = std::lower_bound(vnModifierCheckpoints, vnModifierCheckpoints + nModifierCheckpoints, nHeight);
+    if (it != vnModifierCheckpoints + nModifierCheckpoints && it->nHeight == nHeight)
+        return nStakeModifierChecksum == it->nChecksum;
     return true;
 }
 
@@ -622,8 +672,23 @@ bool Stake::SelectStakeCoins(CWallet* wallet, std::set <std::pair<const CWalletT
     if (nSelectionPeriod < Params().StakingRoundPeriod()) {
         nSelectionPeriod = Params().StakingRoundPeriod();
     }
-    if (nTime - nLastSelectTime < nSelectionPeriod) {
-        return false;
+
+    // Reuse the cached candidate set while nothing it depends on has moved:
+    // the tip (confirmation depth and maturity), the wallet's unspent-output
+    // set (coins received or spent) and the target amount.  The selection
+    // period is kept as a staleness bound so the age filter still refreshes.
+    uint256 hashTip(0);
+    {
+        LOCK(cs_main);
+        auto const tip = chainActive.Tip();
+        if (tip) hashTip = tip->GetBlockHash();
+    }
+    auto const nGeneration = wallet->GetUTXOSetGeneration();
+    if (!setStakeCandidates.empty() && hashTip == hashCandidateTip &&
+        nGeneration == nCandidateGeneration && targetAmount == nCandidateTargetAmount &&
+        nTime - nLastSelectTime < nSelectionPeriod) {
+        stakecoins = setStakeCandidates;
+        return true;
     }
 
     int64_t selectedAmount = 0;
@@ -648,9 +713,14 @@ bool Stake::SelectStakeCoins(CWallet* wallet, std::set <std::pair<const CWalletT
         selectedAmount += out.tx->vout[out.i].nValue;
     }
     if (!stakecoins.empty()) {
+        setStakeCandidates = stakecoins;
+        hashCandidateTip = hashTip;
+        nCandidateGeneration = nGeneration;
+        nCandidateTargetAmount = targetAmount;
         nLastSelectTime = nTime;
         return true;
     }
+    setStakeCandidates.clear();
     return false;
 }
 
@@ -713,7 +783,8 @@ bool Stake::CreateCoinStake(CWallet* wallet, const CKeyStore& keystore, unsigned
         nTxNewTime = GetAdjustedTime();
 
         //iterates each utxo inside of CheckStakeKernelHash()
-        if (CheckHash(pindex->pprev, nBits, block, *pcoin.first, prevoutStake, nTxNewTime, hashProofOfStake)) {
+        unsigned int nSearchWindow = (unsigned int)std::max((int64_t)1, std::min(nSearchInterval, (int64_t)nHashInterval));
+        if (CheckHash(pindex->pprev, nBits, block, *pcoin.first, prevoutStake, nTxNewTime, hashProofOfStake, nSearchWindow)) {
             //Double check that this will pass time requirements
             if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
                 LogPrintf("%s: stake found, but it is too far in the past \n", __func__);
@@ -888,7 +959,115 @@ bool Stake::CreateBlockStake(CWallet* wallet, CBlock* block) {
     return result;
 }
 
+// Sweep the future timestamp window for the current tip in one pass and
+// cache the earliest candidate hit.  The kernel inputs (modifier, candidate
+// set, targets) are fixed once the tip is known, so each candidate's
+// preimage is serialized once and every timestamp in the window is a 4-byte
+// patch plus one hash — the same trick CheckHash uses downwards, applied
+// forwards.  Between tips the staking thread then only wakes when the
+// scheduled time arrives instead of rebuilding a block template per second.
+// Returns true when GenBlockStake should run now (a hit is due, or the
+// schedule cannot be trusted and we fall back to polling).
+bool Stake::SweepKernelSchedule(CWallet* wallet) {
+    unsigned int nNow = GetAdjustedTime();
+
+    const CBlockIndex* tip = nullptr;
+    uint256 hashTip(0);
+    unsigned int nBits = 0;
+    unsigned int nTimeFloor = 0;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+        if (!tip) return true;
+        hashTip = tip->GetBlockHash();
+        nBits = GetNextWorkRequired(tip, nullptr, Params().GetConsensus(), true);
+        nTimeFloor = tip->GetMedianTimePast() + 1;
+    }
+
+    if (fSweepValid && hashTip == hashSweepTip && nNow < nSweepWindowEnd) {
+        return nNextKernelTime != 0 && nNow >= nNextKernelTime;
+    }
+
+    fSweepValid = false;
+    hashSweepTip = hashTip;
+    nNextKernelTime = 0;
+
+    // The historical stake-target multiplier kicks in per-hash on old
+    // mainnet heights; a fixed-target sweep cannot model it, so poll there.
+    if (Params().NetworkID() == CBaseChainParams::MAIN && tip->nHeight < LAST_MULTIPLIED_BLOCK)
+        return true;
+
+    int64_t nBalance = wallet->GetBalance();
+    if (mapArgs.count("-reservebalance") && !ParseMoney(mapArgs["-reservebalance"], nReserveBalance))
+        return true;
+    if (nBalance <= nReserveBalance)
+        return true;
+
+    std::set< pair<const CWalletTx*, unsigned int> > stakeCoins;
+    if (!SelectStakeCoins(wallet, stakeCoins, nBalance - nReserveBalance))
+        return true;
+
+    // Same member clamps CheckHash applies before serializing.
+    if (nHashInterval < Params().StakingInterval())
+        nHashInterval = Params().StakingInterval();
+    if (nSelectionPeriod < Params().StakingRoundPeriod())
+        nSelectionPeriod = Params().StakingRoundPeriod();
+    if (nStakeMinAge < Params().StakingMinAge())
+        nStakeMinAge = Params().StakingMinAge();
+
+    uint64_t nStakeModifier = tip->nStakeModifier;
+    int64_t nStakeModifierTime = tip->nTime;
+    const bool fAdvanced = ENABLE_ADVANCED_STAKING &&
+        (GetBoolArg("-regtest", false) || tip->nHeight >= ADVANCED_STAKING_HEIGHT);
+
+    unsigned int nSweepEnd = nNow + nSelectionPeriod;
+    BOOST_FOREACH(PAIRTYPE(const CWalletTx*, unsigned int) pcoin, stakeCoins) {
+        CBlockIndex* pindex = LookupBlockIndex(pcoin.first->hashBlock);
+        if (!pindex || pindex->pprev == nullptr)
+            continue;
+
+        const CTransaction& txPrev = *pcoin.first;
+        const COutPoint prevout(txPrev.GetHash(), pcoin.second);
+        unsigned int nTimeBlockFrom = pindex->GetBlockHeader().GetBlockTime();
+
+        uint256 bnTarget;
+        bnTarget.SetCompact(nBits);
+        uint256 bnWeight = uint256(txPrev.vout[prevout.n].nValue);
+        bnTarget *= bnWeight;
+
+        CDataStream ss(SER_GETHASH, 0);
+        ss << nStakeModifier << nTimeBlockFrom << txPrev.nTime << prevout.hash << prevout.n << nNow;
+        const size_t nTimePos = ss.size() - sizeof(nNow);
+        if (fAdvanced) {
+            ss << nHashInterval << nSelectionPeriod << nStakeMinAge << nStakeSplitThreshold
+               << bnWeight << nStakeModifierTime;
+        }
+
+        unsigned int nTimeMin = std::max(std::max(nNow, nTimeFloor),
+                                         std::max(txPrev.nTime, GetStakeAge(nTimeBlockFrom)));
+        for (unsigned int nTryTime = nTimeMin; nTryTime < nSweepEnd; nTryTime++) {
+            if (nNextKernelTime != 0 && nTryTime >= nNextKernelTime)
+                break; // an earlier candidate already hits first
+            WriteLE32((unsigned char*)&ss[nTimePos], nTryTime);
+            if (!(Hash(ss.begin(), ss.end()) > bnTarget)) {
+                nNextKernelTime = nTryTime;
+                break;
+            }
+        }
+    }
+
+    nSweepWindowEnd = nSweepEnd;
+    fSweepValid = true;
+    if (fDebug) {
+        LogPrint("stake", "%s: swept %u candidates to +%us, next kernel %s\n", __func__,
+                 (unsigned int)stakeCoins.size(), nSweepEnd - nNow,
+                 nNextKernelTime ? strprintf("in %ds", (int)nNextKernelTime - (int)nNow) : "none");
+    }
+    return nNextKernelTime != 0 && nNow >= nNextKernelTime;
+}
+
 bool Stake::GenBlockStake(CWallet* wallet, const CReserveKey& key, unsigned int& extra) {
+    CPerfScope perfscope("GenBlockStake");
     CBlockIndex* tip = nullptr;
     {
         LOCK(cs_main);
@@ -996,6 +1175,13 @@ void Stake::StakingThread(CWallet* wallet) {
 #if defined(DEBUG_DUMP_STAKING_THREAD) && defined(DEBUG_DUMP_STAKING_INFO)
             DEBUG_DUMP_STAKING_THREAD();
 #endif
+            static bool fSweep = GetBoolArg("-stakesweep", true);
+            if (nCanStake && fSweep && !SweepKernelSchedule(wallet)) {
+                // No kernel due yet for this tip; idle until the scheduled
+                // time arrives or a new tip invalidates the sweep.
+                MilliSleep(1000);
+                continue;
+            }
             if (nCanStake && GenBlockStake(wallet, reserve, extra)) {
                 MilliSleep(1500);
             } else {
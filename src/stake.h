@@ -53,6 +53,30 @@ class Stake : StakeKernel
 
     CAmount nReserveBalance;
     
+    // Cached kernel candidate set (see SelectStakeCoins): rebuilt only when
+    // the chain tip, the wallet's unspent-output set or the target amount
+    // changes, so each staking round hashes candidates instead of rescanning
+    // the whole wallet.
+    std::set<std::pair<const CWalletTx*, unsigned int> > setStakeCandidates;
+    uint256 hashCandidateTip;
+    uint64_t nCandidateGeneration;
+    int64_t nCandidateTargetAmount;
+
+    // Memoized ComputeNextModifier results keyed by the prev-block hash, so
+    // competing blocks on the same parent (common during sync and reorgs) do
+    // not redo the candidate walk and 64-round selection.
+    std::map<uint256, std::pair<uint64_t, bool> > mapModifierCache;
+
+    // Kernel schedule for the current tip (see SweepKernelSchedule): the
+    // whole future timestamp window is swept once per tip and only the
+    // earliest hit is kept, so the staking thread sleeps until that time
+    // instead of re-running the candidate loop every second.  nNextKernelTime
+    // is 0 when no candidate hits inside the swept window.
+    bool fSweepValid;
+    uint256 hashSweepTip;
+    unsigned int nSweepWindowEnd;
+    unsigned int nNextKernelTime;
+
     std::map<COutPoint, unsigned int> mapStakes;
     std::map<unsigned int, unsigned int> mapHashedBlocks;
     std::map<uint256, uint256> mapProofOfStake;
@@ -61,6 +85,7 @@ class Stake : StakeKernel
 private:
 
     bool SelectStakeCoins(CWallet *wallet, std::set<std::pair<const CWalletTx*, unsigned int> >& stakecoins, const int64_t targetAmount);
+    bool SweepKernelSchedule(CWallet *wallet);
     bool CreateCoinStake(CWallet *wallet, const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, CMutableTransaction& txNew, unsigned int& nTxNewTime);
 
     bool GenBlockStake(CWallet *wallet, const CReserveKey &key, unsigned int &extra);
@@ -80,8 +105,11 @@ public:
     bool ComputeNextModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
     //!<DuzyDoc>: Stake::CheckHash - check whether stake kernel meets hash target
-    //!<DuzyDoc>:       Sets hashProofOfStake on success return
-    bool CheckHash(const CBlockIndex* pindexPrev, unsigned int nBits, const CBlock &blockFrom, const CTransaction &txPrev, const COutPoint &prevout, unsigned int& nTimeTx, uint256& hashProofOfStake);
+    //!<DuzyDoc>:       Sets hashProofOfStake and nTimeTx on success return.
+    //!<DuzyDoc>:       nSearchWindow > 1 tries that many timestamps, from
+    //!<DuzyDoc>:       nTimeTx downwards, reusing one serialized preimage
+    //!<DuzyDoc>:       (validation must keep the default single try).
+    bool CheckHash(const CBlockIndex* pindexPrev, unsigned int nBits, const CBlock &blockFrom, const CTransaction &txPrev, const COutPoint &prevout, unsigned int& nTimeTx, uint256& hashProofOfStake, unsigned int nSearchWindow = 1);
 
     //!<DuzyDoc>: Stake::CheckProof - check kernel hash target and coinstake signature
     //!<DuzyDoc>:       Sets hashProofOfStake on success return
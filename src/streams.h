@@ -289,6 +289,58 @@ public:
 };
 
 
+/** Read-only stream over an externally owned memory buffer.
+ *
+ * Unlike CDataStream, construction does not copy the underlying bytes;
+ * the caller must keep the buffer alive for the lifetime of the stream.
+ * This is used to deserialize directly out of memory-mapped block files
+ * without an intermediate buffer copy.
+ */
+class CMemoryViewStream
+{
+private:
+    const char* pch;
+    size_t nSize;
+    size_t nReadPos;
+    int nType;
+    int nVersion;
+
+public:
+    CMemoryViewStream(const char* pchIn, size_t nSizeIn, int nTypeIn, int nVersionIn) : pch(pchIn), nSize(nSizeIn), nReadPos(0), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    size_t size() const { return nSize - nReadPos; }
+    bool eof() const { return size() == 0; }
+
+    int GetType() { return nType; }
+    int GetVersion() { return nVersion; }
+
+    CMemoryViewStream& read(char* pchDest, size_t nSizeReq)
+    {
+        if (nSizeReq > size())
+            throw std::ios_base::failure("CMemoryViewStream::read() : end of data");
+        memcpy(pchDest, pch + nReadPos, nSizeReq);
+        nReadPos += nSizeReq;
+        return (*this);
+    }
+
+    CMemoryViewStream& ignore(size_t nSizeReq)
+    {
+        if (nSizeReq > size())
+            throw std::ios_base::failure("CMemoryViewStream::ignore() : end of data");
+        nReadPos += nSizeReq;
+        return (*this);
+    }
+
+    template <typename T>
+    CMemoryViewStream& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+
 /** Non-refcounted RAII wrapper for FILE*
  *
  * Will automatically close the file when it goes out of scope if not null.
@@ -150,3 +150,113 @@ void AssertLockHeldInternal(const char* pszName, const char* pszFile, int nLine,
 }
 
 #endif /* DEBUG_LOCKORDER */
+
+#ifdef DEBUG_LOCKSTATS
+//
+// Lock contention statistics.
+// Every RAII acquisition records how long the thread waited for the lock
+// and how long it held it, aggregated per lock name into power-of-two
+// microsecond histograms and read back through the getlockstats RPC.
+// Recording uses its own plain boost mutex: it must never go through the
+// instrumented LOCK machinery itself.
+//
+
+#include "univalue/univalue.h"
+
+#include "utiltime.h"
+
+#include <map>
+
+namespace {
+
+static const int LOCKSTAT_BUCKETS = 32;
+
+struct CLockStat {
+    uint64_t nCount;
+    int64_t nWaitTotalUs;
+    int64_t nWaitMaxUs;
+    int64_t nHoldTotalUs;
+    int64_t nHoldMaxUs;
+    uint64_t vWaitBuckets[LOCKSTAT_BUCKETS];
+    uint64_t vHoldBuckets[LOCKSTAT_BUCKETS];
+    std::string strMaxWaitSite;
+
+    CLockStat() : nCount(0), nWaitTotalUs(0), nWaitMaxUs(0), nHoldTotalUs(0), nHoldMaxUs(0)
+    {
+        memset(vWaitBuckets, 0, sizeof(vWaitBuckets));
+        memset(vHoldBuckets, 0, sizeof(vHoldBuckets));
+    }
+};
+
+static int Bucket(int64_t nUs)
+{
+    int nBucket = 0;
+    while (nBucket < LOCKSTAT_BUCKETS - 1 && nUs >= ((int64_t)2 << nBucket))
+        nBucket++;
+    return nBucket;
+}
+
+static void PushHistogram(UniValue& entry, const char* pszKey, const uint64_t* vBuckets)
+{
+    UniValue histogram(UniValue::VARR);
+    int nLast = LOCKSTAT_BUCKETS - 1;
+    while (nLast > 0 && vBuckets[nLast] == 0)
+        nLast--;
+    for (int i = 0; i <= nLast; i++)
+        histogram.push_back(vBuckets[i]);
+    entry.push_back(Pair(pszKey, histogram));
+}
+
+boost::mutex mutexLockStats;
+std::map<std::string, CLockStat> mapLockStats;
+
+} // anon namespace
+
+int64_t LockStatsNow()
+{
+    return GetTimeMicros();
+}
+
+void LockStatsRecord(const char* pszName, const char* pszFile, int nLine, int64_t nWaitUs, int64_t nHoldUs)
+{
+    if (nWaitUs < 0) nWaitUs = 0;
+    if (nHoldUs < 0) nHoldUs = 0;
+
+    boost::unique_lock<boost::mutex> lock(mutexLockStats);
+    CLockStat& stat = mapLockStats[pszName];
+    stat.nCount++;
+    stat.nWaitTotalUs += nWaitUs;
+    stat.nHoldTotalUs += nHoldUs;
+    if (nHoldUs > stat.nHoldMaxUs)
+        stat.nHoldMaxUs = nHoldUs;
+    if (nWaitUs > stat.nWaitMaxUs) {
+        stat.nWaitMaxUs = nWaitUs;
+        stat.strMaxWaitSite = strprintf("%s:%d", pszFile, nLine);
+    }
+    stat.vWaitBuckets[Bucket(nWaitUs)]++;
+    stat.vHoldBuckets[Bucket(nHoldUs)]++;
+}
+
+UniValue LockStatsToJSON(bool fReset)
+{
+    UniValue result(UniValue::VOBJ);
+    boost::unique_lock<boost::mutex> lock(mutexLockStats);
+    for (std::map<std::string, CLockStat>::const_iterator it = mapLockStats.begin(); it != mapLockStats.end(); ++it) {
+        const CLockStat& stat = it->second;
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("count", stat.nCount));
+        entry.push_back(Pair("wait_total_us", stat.nWaitTotalUs));
+        entry.push_back(Pair("wait_max_us", stat.nWaitMaxUs));
+        entry.push_back(Pair("wait_max_site", stat.strMaxWaitSite));
+        entry.push_back(Pair("hold_total_us", stat.nHoldTotalUs));
+        entry.push_back(Pair("hold_max_us", stat.nHoldMaxUs));
+        PushHistogram(entry, "wait_histogram_us_pow2", stat.vWaitBuckets);
+        PushHistogram(entry, "hold_histogram_us_pow2", stat.vHoldBuckets);
+        result.push_back(Pair(it->first, entry));
+    }
+    if (fReset)
+        mapLockStats.clear();
+    return result;
+}
+
+#endif /* DEBUG_LOCKSTATS */
@@ -104,16 +104,38 @@ void static inline AssertLockHeldInternal(const char* pszName, const char* pszFi
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+#ifdef DEBUG_LOCKSTATS
+class UniValue;
+//! Microsecond clock for the lock statistics, kept out of line so this
+//! header does not pull in utiltime.h.
+int64_t LockStatsNow();
+//! Record one acquisition of the named lock: time spent waiting for it
+//! and time it was held. Aggregated per lock name into pow2 histograms.
+void LockStatsRecord(const char* pszName, const char* pszFile, int nLine, int64_t nWaitUs, int64_t nHoldUs);
+//! Snapshot the per-lock statistics as JSON; optionally zero them.
+UniValue LockStatsToJSON(bool fReset);
+#endif
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+#ifdef DEBUG_LOCKSTATS
+    const char* pszLockName;
+    const char* pszLockFile;
+    int nLockLine;
+    int64_t nWaitUs;
+    int64_t nAcquiredAt;
+#endif
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+#ifdef DEBUG_LOCKSTATS
+        int64_t nWaitStart = LockStatsNow();
+#endif
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -121,6 +143,13 @@ private:
             lock.lock();
 #ifdef DEBUG_LOCKCONTENTION
         }
+#endif
+#ifdef DEBUG_LOCKSTATS
+        nAcquiredAt = LockStatsNow();
+        nWaitUs = nAcquiredAt - nWaitStart;
+        pszLockName = pszName;
+        pszLockFile = pszFile;
+        nLockLine = nLine;
 #endif
     }
 
@@ -130,12 +159,28 @@ private:
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+#ifdef DEBUG_LOCKSTATS
+        else {
+            nAcquiredAt = LockStatsNow();
+            nWaitUs = 0;
+            pszLockName = pszName;
+            pszLockFile = pszFile;
+            nLockLine = nLine;
+        }
+#endif
         return lock.owns_lock();
     }
 
 public:
     CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) : lock(mutexIn, boost::defer_lock)
     {
+#ifdef DEBUG_LOCKSTATS
+        pszLockName = NULL;
+        pszLockFile = NULL;
+        nLockLine = 0;
+        nWaitUs = 0;
+        nAcquiredAt = 0;
+#endif
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
         else
@@ -144,6 +189,10 @@ public:
 
     ~CMutexLock()
     {
+#ifdef DEBUG_LOCKSTATS
+        if (lock.owns_lock() && pszLockName)
+            LockStatsRecord(pszLockName, pszLockFile, nLockLine, nWaitUs, LockStatsNow() - nAcquiredAt);
+#endif
         if (lock.owns_lock())
             LeaveCritical();
     }
@@ -17,6 +17,7 @@
 #include "util.h"
 
 #include <stdint.h>
+#include <unordered_map>
 
 #include <boost/assign/list_of.hpp> // for 'map_list_of()'
 #include <boost/date_time/posix_time/posix_time_types.hpp>
@@ -30,9 +31,11 @@ extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
+    int64_t nTimeExpire;
+    size_t nListPos;
 };
-extern std::map<uint256, COrphanTx> mapOrphanTransactions;
-extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+extern std::unordered_map<uint256, COrphanTx, SaltedTxidHasher> mapOrphanTransactions;
+extern std::unordered_map<uint256, std::set<uint256>, SaltedTxidHasher> mapOrphanTransactionsByPrev;
 
 CService ip(uint32_t i)
 {
@@ -108,10 +111,10 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
 
 CTransaction RandomOrphan()
 {
-    std::map<uint256, COrphanTx>::iterator it;
-    it = mapOrphanTransactions.lower_bound(GetRandHash());
+    auto it = mapOrphanTransactions.begin();
     if (it == mapOrphanTransactions.end())
-        it = mapOrphanTransactions.begin();
+        return CTransaction();
+    std::advance(it, GetRand(mapOrphanTransactions.size()));
     return it->second.tx;
 }
 
@@ -9,6 +9,7 @@
 #include "keystore.h"
 #include "main.h"
 #include "primitives/transaction.h"
+#include "random.h"
 #include "rpcserver.h"
 #include "script/script.h"
 #include "script/script_error.h"
@@ -1427,4 +1428,198 @@ BOOST_AUTO_TEST_CASE(script_FindAndDelete)
     BOOST_CHECK(s == expect);
 }
 
+static bool RefCastToBool(const std::vector<unsigned char>& vch)
+{
+    for (unsigned int i = 0; i < vch.size(); i++) {
+        if (vch[i] != 0) {
+            if (i == vch.size() - 1 && vch[i] == 0x80)
+                return false;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * The generic path VerifyScript takes when no template fast path applies,
+ * rebuilt from EvalScript for the spend shapes this test generates: bare
+ * scripts under SIGVERSION_BASE plus version-0 20-byte witness programs.
+ * Differential oracle for the P2PKH/P2WPKH fast paths in interpreter.cpp.
+ */
+static bool ReferenceVerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness& witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    *serror = SCRIPT_ERR_UNKNOWN_ERROR;
+    if ((flags & SCRIPT_VERIFY_SIGPUSHONLY) && !scriptSig.IsPushOnly()) {
+        *serror = SCRIPT_ERR_SIG_PUSHONLY;
+        return false;
+    }
+    std::vector<std::vector<unsigned char> > stack;
+    if (!EvalScript(stack, scriptSig, flags, checker, SIGVERSION_BASE, serror))
+        return false;
+    if (!EvalScript(stack, scriptPubKey, flags, checker, SIGVERSION_BASE, serror))
+        return false;
+    if (stack.empty() || !RefCastToBool(stack.back())) {
+        *serror = SCRIPT_ERR_EVAL_FALSE;
+        return false;
+    }
+
+    bool hadWitness = false;
+    int witnessversion;
+    std::vector<unsigned char> witnessprogram;
+    if ((flags & SCRIPT_VERIFY_WITNESS) && scriptPubKey.IsWitnessProgram(witnessversion, witnessprogram)) {
+        hadWitness = true;
+        if (scriptSig.size() != 0) {
+            *serror = SCRIPT_ERR_WITNESS_MALLEATED;
+            return false;
+        }
+        BOOST_REQUIRE(witnessversion == 0 && witnessprogram.size() == 20);
+        if (witness.stack.size() != 2) {
+            *serror = SCRIPT_ERR_WITNESS_PROGRAM_MISMATCH;
+            return false;
+        }
+        CScript witScript;
+        witScript << OP_DUP << OP_HASH160 << witnessprogram << OP_EQUALVERIFY << OP_CHECKSIG;
+        std::vector<std::vector<unsigned char> > witStack = witness.stack;
+        for (unsigned int i = 0; i < witStack.size(); i++) {
+            if (witStack[i].size() > MAX_SCRIPT_ELEMENT_SIZE) {
+                *serror = SCRIPT_ERR_PUSH_SIZE;
+                return false;
+            }
+        }
+        if (!EvalScript(witStack, witScript, flags, checker, SIGVERSION_WITNESS_V0, serror))
+            return false;
+        if (witStack.size() != 1) {
+            *serror = SCRIPT_ERR_CLEANSTACK;
+            return false;
+        }
+        if (!RefCastToBool(witStack.back())) {
+            *serror = SCRIPT_ERR_EVAL_FALSE;
+            return false;
+        }
+        stack.resize(1);
+    }
+
+    if (flags & SCRIPT_VERIFY_CLEANSTACK) {
+        if (stack.size() != 1) {
+            *serror = SCRIPT_ERR_CLEANSTACK;
+            return false;
+        }
+    }
+    if ((flags & SCRIPT_VERIFY_WITNESS) && !hadWitness && !witness.IsNull()) {
+        *serror = SCRIPT_ERR_WITNESS_UNEXPECTED;
+        return false;
+    }
+    *serror = SCRIPT_ERR_OK;
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(script_fastpath_differential)
+{
+    // Drive randomly mutated P2PKH and P2WPKH spends through VerifyScript
+    // (which takes the template fast paths) and through the reference
+    // interpreter path above; outcome and script error must agree on every
+    // input.
+    seed_insecure_rand(true);
+
+    const unsigned int flagsets[] = {
+        SCRIPT_VERIFY_NONE,
+        SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC,
+        SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG | SCRIPT_VERIFY_LOW_S | SCRIPT_VERIFY_NULLFAIL,
+        SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_WITNESS,
+        SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_STRICTENC | SCRIPT_VERIFY_WITNESS_PUBKEYTYPE | SCRIPT_VERIFY_NULLFAIL,
+        SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK | SCRIPT_VERIFY_MINIMALDATA | SCRIPT_VERIFY_DERSIG,
+    };
+
+    for (int i = 0; i < 200; i++) {
+        CKey key;
+        key.MakeNewKey(insecure_rand() & 1);
+        CPubKey pubkey = key.GetPubKey();
+        std::vector<unsigned char> vchPubKey(pubkey.begin(), pubkey.end());
+        uint160 pubkeyhash = Hash160(vchPubKey);
+
+        bool fSegwit = (insecure_rand() & 1) && pubkey.IsCompressed();
+        unsigned int flags = flagsets[insecure_rand() % ARRAYLEN(flagsets)];
+        if (fSegwit)
+            flags |= SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_WITNESS;
+
+        CScript scriptPubKey;
+        if (fSegwit)
+            scriptPubKey << OP_0 << ToByteVector(pubkeyhash);
+        else
+            scriptPubKey << OP_DUP << OP_HASH160 << ToByteVector(pubkeyhash) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+        CAmount nValue = 1000 + (insecure_rand() % 100000);
+        CMutableTransaction txCredit = BuildCreditingTransaction(scriptPubKey, nValue);
+        CMutableTransaction tx = BuildSpendingTransaction(CScript(), CScriptWitness(), txCredit);
+
+        CScript scriptCode;
+        scriptCode << OP_DUP << OP_HASH160 << ToByteVector(pubkeyhash) << OP_EQUALVERIFY << OP_CHECKSIG;
+        uint256 hash = SignatureHash(scriptCode, tx, 0, SIGHASH_ALL, nValue, fSegwit ? SIGVERSION_WITNESS_V0 : SIGVERSION_BASE);
+        std::vector<unsigned char> vchSig;
+        BOOST_CHECK(key.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+
+        // Mutate some spends so the failure branches get compared too.
+        std::string strMutation = "valid";
+        switch (insecure_rand() % 8) {
+        case 0: // corrupt a signature byte
+            vchSig[insecure_rand() % (vchSig.size() - 1)] ^= 1 + (insecure_rand() % 255);
+            strMutation = "corrupt-sig";
+            break;
+        case 1: // signature from the wrong key
+        {
+            CKey keyWrong;
+            keyWrong.MakeNewKey(true);
+            vchSig.clear();
+            BOOST_CHECK(keyWrong.Sign(hash, vchSig));
+            vchSig.push_back((unsigned char)SIGHASH_ALL);
+            strMutation = "wrong-key-sig";
+            break;
+        }
+        case 2: // wrong pubkey for the committed hash
+        {
+            CKey keyWrong;
+            keyWrong.MakeNewKey(pubkey.IsCompressed());
+            CPubKey pubkeyWrong = keyWrong.GetPubKey();
+            vchPubKey.assign(pubkeyWrong.begin(), pubkeyWrong.end());
+            strMutation = "wrong-pubkey";
+            break;
+        }
+        case 3: // high-S encoding
+            vchSig.pop_back();
+            NegateSignatureS(vchSig);
+            vchSig.push_back((unsigned char)SIGHASH_ALL);
+            strMutation = "high-s-sig";
+            break;
+        case 4: // truncated pubkey
+            vchPubKey.resize(vchPubKey.size() / 2);
+            strMutation = "truncated-pubkey";
+            break;
+        default:
+            break;
+        }
+        if (fSegwit && (insecure_rand() % 8) == 0) {
+            vchSig.clear(); // empty witness signature
+            strMutation += "+empty-sig";
+        }
+
+        CScript scriptSig;
+        CScriptWitness witness;
+        if (fSegwit) {
+            witness.stack.push_back(vchSig);
+            witness.stack.push_back(vchPubKey);
+        } else {
+            scriptSig << vchSig << vchPubKey;
+        }
+        tx = BuildSpendingTransaction(scriptSig, witness, txCredit);
+
+        ScriptError err, errRef;
+        bool fRet = VerifyScript(scriptSig, scriptPubKey, &witness, flags, MutableTransactionSignatureChecker(&tx, 0, nValue), &err);
+        bool fRetRef = ReferenceVerifyScript(scriptSig, scriptPubKey, witness, flags, MutableTransactionSignatureChecker(&tx, 0, nValue), &errRef);
+        std::string strCase = strprintf("%s %s flags=%#x iter=%d", fSegwit ? "p2wpkh" : "p2pkh", strMutation, flags, i);
+        BOOST_CHECK_MESSAGE(fRet == fRetRef, strCase + strprintf(": result %d vs reference %d", fRet, fRetRef));
+        BOOST_CHECK_MESSAGE(err == errRef, strCase + ": " + FormatScriptError(err) + " vs reference " + FormatScriptError(errRef));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,51 @@
+// Copyright (c) 2015-2017 The Lux developers                      -*- c++ -*-
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TRACE_H
+#define BITCOIN_TRACE_H
+
+#include "uint256.h"
+#include "util.h"
+#include "utiltime.h"
+
+/**
+ * Per-transaction correlation spans. The txid itself is the trace id, so
+ * spans emitted from different subsystems (net receive, mempool accept,
+ * relay, wallet sync, zmq publish) join up without threading a context
+ * object through every call between them. Each span is one line in the
+ * "trace" log category; with -binlog the records carry microsecond
+ * timestamps, so the latency of each hop is the difference between
+ * consecutive span timestamps for one id. Stages whose cost is measured at
+ * the call site attach an explicit duration instead.
+ */
+static inline void TraceTxSpan(const char* stage, const uint256& txid)
+{
+    if (!fTxTrace) return;
+    LogPrint("trace", "txtrace id=%s stage=%s\n", txid.ToString(), stage);
+}
+
+static inline void TraceTxSpan(const char* stage, const uint256& txid, int64_t nDurationUs)
+{
+    if (!fTxTrace) return;
+    LogPrint("trace", "txtrace id=%s stage=%s dur=%dus\n", txid.ToString(), stage, nDurationUs);
+}
+
+/** Emits one span with the scope's wall time on exit; mirrors CPerfScope. */
+class CTxTraceScope
+{
+public:
+    CTxTraceScope(const char* stageIn, const uint256& txidIn) : stage(stageIn), txid(txidIn), nStart(fTxTrace ? GetTimeMicros() : 0) {}
+    ~CTxTraceScope()
+    {
+        if (fTxTrace)
+            TraceTxSpan(stage, txid, GetTimeMicros() - nStart);
+    }
+
+private:
+    const char* stage;
+    uint256 txid;
+    int64_t nStart;
+};
+
+#endif // BITCOIN_TRACE_H
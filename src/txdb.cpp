@@ -9,6 +9,7 @@
 #include "pow.h"
 #include "stake.h"
 
+#include <atomic>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -30,10 +31,15 @@ void static BatchWriteHashBestChain(CLevelDBBatch& batch, const uint256& hash)
     batch.Write('B', hash);
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, "chainstate")
 {
 }
 
+bool CCoinsViewDB::GetDbProperty(const std::string& strProperty, std::string& strValue) const
+{
+    return db.GetProperty(strProperty, strValue);
+}
+
 bool CCoinsViewDB::GetCoins(const uint256& txid, CCoins& coins) const
 {
     return db.Read(make_pair('c', txid), coins);
@@ -57,23 +63,129 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
     CLevelDBBatch batch;
     size_t count = 0;
     size_t changed = 0;
+    size_t nBatches = 1;
+    bool fMarkerWritten = false;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            BatchWriteCoins(batch, it->first, it->second.coins);
-            changed++;
+            // A FRESH entry was never persisted; if it has also been fully
+            // spent there is nothing on disk to erase, so don't write a
+            // tombstone for it. This makes short-lived coins (created and
+            // spent between two flushes) free at the database layer.
+            if (!((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned())) {
+                BatchWriteCoins(batch, it->first, it->second.coins);
+                changed++;
+            }
         }
         count++;
         CCoinsMap::iterator itOld = it++;
         mapCoins.erase(itOld);
+        // Stream the flush to LevelDB in bounded chunks instead of one giant
+        // batch; a multi-gigabyte dbcache used to stall here for seconds while
+        // LevelDB copied the whole batch. The 'F' marker is committed with the
+        // first partial chunk and only removed once the final chunk (with the
+        // new best block) lands, so an interrupted flush is detectable at
+        // startup.
+        if (batch.SizeEstimate() > DBCOINS_BATCH_SIZE) {
+            if (!fMarkerWritten) {
+                batch.Write('F', hashBlock);
+                fMarkerWritten = true;
+            }
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+            nBatches++;
+        }
     }
+    if (fMarkerWritten)
+        batch.Erase('F');
     if (hashBlock != uint256(0))
         BatchWriteHashBestChain(batch, hashBlock);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database in %u batches...\n", (unsigned int)changed, (unsigned int)count, (unsigned int)nBatches);
     return db.WriteBatch(batch);
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
+bool CCoinsViewDB::WasFlushInterrupted() const
+{
+    return db.Exists('F');
+}
+
+bool CCoinsViewDB::WriteSnapshot(CAutoFile& fileout, const uint256& hashBlock, uint64_t& nCoins) const
+{
+    /* Same const-cast as GetStats: read-only use of the iterator. The
+       iterator pins a point-in-time view of the database, so both passes
+       below see the same coin set. */
+    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+
+    // First pass: the record count goes in front of the records.
+    nCoins = 0;
+    for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        leveldb::Slice slKey = pcursor->key();
+        if (slKey.size() > 0 && slKey.data()[0] == 'c')
+            nCoins++;
+    }
+    fileout << nCoins;
+
+    // Second pass: stream the records and build the commitment over them.
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << hashBlock;
+    for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'c')
+                continue;
+            uint256 txhash;
+            ssKey >> txhash;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CCoins coins;
+            ssValue >> coins;
+            fileout << txhash << coins;
+            ss << txhash << coins;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    fileout << ss.GetHash();
+    return true;
+}
+
+bool CCoinsViewDB::EraseAllCoins()
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(db.NewIterator());
+    CLevelDBBatch batch;
+    size_t nBatched = 0;
+    for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'c')
+                continue;
+            uint256 txhash;
+            ssKey >> txhash;
+            batch.Erase(make_pair('c', txhash));
+            if (++nBatched >= 100000) {
+                if (!db.WriteBatch(batch))
+                    return false;
+                batch.Clear();
+                nBatched = 0;
+            }
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return db.WriteBatch(batch, true);
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, "blockindex")
 {
 }
 
@@ -191,6 +303,56 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
     return true;
 }
 
+bool CCoinsViewDB::WriteUtxoSetHash(const uint256& hash, const uint256& hashBlock)
+{
+    return db.Write('M', std::make_pair(hash, hashBlock));
+}
+
+bool CCoinsViewDB::ReadUtxoSetHash(uint256& hash, uint256& hashBlock) const
+{
+    std::pair<uint256, uint256> value;
+    if (!db.Read('M', value))
+        return false;
+    hash = value.first;
+    hashBlock = value.second;
+    return true;
+}
+
+bool CCoinsViewDB::ComputeUtxoSetHash(CUtxoSetHasher& hasher) const
+{
+    /* Same const-cast as GetStats: read-only use of the iterator. */
+    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+    pcursor->SeekToFirst();
+
+    hasher.SetHash(uint256(0));
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType == 'c') {
+                leveldb::Slice slValue = pcursor->value();
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                CCoins coins;
+                ssValue >> coins;
+                uint256 txhash;
+                ssKey >> txhash;
+                for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                    if (!coins.vout[i].IsNull())
+                        hasher.Add(CUtxoSetHasher::CoinHash(COutPoint(txhash, i), coins.vout[i], coins.nHeight, coins.fCoinBase, coins.fCoinStake));
+                }
+            }
+            pcursor->Next();
+        } catch (std::exception& e) {
+            hasher.Invalidate();
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
 bool CBlockTreeDB::ReadTxIndex(const uint256& txid, CDiskTxPos& pos)
 {
     return Read(make_pair('t', txid), pos);
@@ -204,6 +366,96 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Write(make_pair('a', it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Erase(make_pair('a', it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(const uint160& addressHash, unsigned char type, std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, int start, int end)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    // Entries for one script are contiguous and height-ordered (the key
+    // stores the height big-endian), so paging is a seek plus a bounded scan.
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    if (start > 0)
+        ssKeySet << make_pair('a', CAddressIndexIteratorHeightKey(type, addressHash, start));
+    else
+        ssKeySet << make_pair('a', CAddressIndexIteratorKey(type, addressHash));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'a')
+                break;
+            CAddressIndexKey indexKey;
+            ssKey >> indexKey;
+            if (indexKey.type != type || indexKey.hashBytes != addressHash)
+                break;
+            if (end > 0 && indexKey.blockHeight > end)
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            vect.push_back(make_pair(indexKey, nValue));
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it = vect.begin(); it != vect.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair('p', it->first));
+        else
+            batch.Write(make_pair('p', it->first), it->second);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return Read(make_pair('p', key), value);
+}
+
+bool CBlockTreeDB::ReadLogsBloom(const uint256& hashBlock, std::vector<unsigned char>& vBloom)
+{
+    return Read(make_pair('g', hashBlock), vBloom);
+}
+
+bool CBlockTreeDB::WriteLogsBloom(const uint256& hashBlock, const std::vector<unsigned char>& vBloom)
+{
+    return Write(make_pair('g', hashBlock), vBloom);
+}
+
+bool CBlockTreeDB::EraseLogsBloom(const uint256& hashBlock)
+{
+    return Erase(make_pair('g', hashBlock));
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -218,6 +470,46 @@ bool CBlockTreeDB::ReadFlag(const std::string& name, bool& fValue)
     return true;
 }
 
+namespace
+{
+//! Number of raw disk index records gathered before a parallel decode pass
+static const size_t LOAD_INDEX_BATCH = 10000;
+
+//! One decoded disk index record plus the precomputed values the serial
+//! link phase needs: the (expensive, PHI) block hash and the PoW check.
+struct CLoadedBlockIndex {
+    CDiskBlockIndex diskindex;
+    uint256 hash;
+    bool fPoWOk;
+    bool fGood;
+    std::string strError;
+
+    CLoadedBlockIndex() : fPoWOk(false), fGood(false) {}
+};
+
+void DecodeBlockIndexWorker(const std::vector<std::string>* pvRaw, std::vector<CLoadedBlockIndex>* pvOut, std::atomic<size_t>* pnNext, int nLastPOWBlock)
+{
+    RenameThread("lux-loadindex");
+    while (true) {
+        size_t i = pnNext->fetch_add(1);
+        if (i >= pvRaw->size())
+            break;
+        CLoadedBlockIndex& out = (*pvOut)[i];
+        try {
+            const std::string& vch = (*pvRaw)[i];
+            CDataStream ssValue(vch.data(), vch.data() + vch.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> out.diskindex;
+            out.hash = out.diskindex.GetBlockHash();
+            bool isPoW = (out.diskindex.nNonce != 0) && out.diskindex.nHeight <= nLastPOWBlock;
+            out.fPoWOk = !isPoW || CheckProofOfWork(out.hash, out.diskindex.nBits, Params().GetConsensus());
+            out.fGood = true;
+        } catch (std::exception& e) {
+            out.strError = e.what();
+        }
+    }
+}
+} // anon namespace
+
 bool CBlockTreeDB::LoadBlockIndexGuts()
 {
     boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
@@ -232,81 +524,114 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     int nFirstDiscarded = INT_MAX;
     CLevelDBBatch batch;
 
+    // The per-record work here is dominated by the PHI block hash (and the
+    // PoW check on early blocks), both pure functions of the record. Gather
+    // the raw records in batches and let worker threads deserialize and
+    // hash them; only the linking into mapBlockIndex stays serial, so
+    // startup stops scaling with chain height times a single core.
+    const int nLastPOWBlock = Params().LAST_POW_BLOCK();
+    const int nThreads = std::max(1, std::min(GetNumCores(), 8));
+
+    std::vector<std::string> vRaw;
+    vRaw.reserve(LOAD_INDEX_BATCH);
+    bool fDone = false;
+
     // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    while (!fDone) {
         boost::this_thread::interruption_point();
-        try {
+
+        // Gather a batch of raw 'b' records
+        vRaw.clear();
+        while (pcursor->Valid() && vRaw.size() < LOAD_INDEX_BATCH) {
             leveldb::Slice slKey = pcursor->key();
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
             ssKey >> chType;
-            if (chType == 'b') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CDiskBlockIndex diskindex;
-                ssValue >> diskindex;
-
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-                pindexNew->hashStateRoot  = diskindex.hashStateRoot; // lux
-                pindexNew->hashUTXORoot   = diskindex.hashUTXORoot; // lux
-
-                // Proof Of Stake
-                pindexNew->nMint = diskindex.nMint;
-                pindexNew->nMoneySupply = diskindex.nMoneySupply;
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->nStakeModifier = diskindex.nStakeModifier;
-                pindexNew->prevoutStake = diskindex.prevoutStake;
-                pindexNew->nStakeTime = diskindex.nStakeTime;
-                pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
-
-                bool isPoW = (diskindex.nNonce != 0) && pindexNew->nHeight <= Params().LAST_POW_BLOCK();
-                if (isPoW) {
-                    auto const &hash(pindexNew->GetBlockHash());
-                    if (!CheckProofOfWork(hash, pindexNew->nBits, Params().GetConsensus())) {
-                        unsigned int nBits = pindexPrev ? pindexPrev->nBits : 0;
-                        return error("%s: CheckProofOfWork failed: %d %s (%d, %d)", __func__, pindexNew->nHeight, hash.GetHex(), pindexNew->nBits, nBits);
-                    }
-                } else {
-                    stake->MarkStake(pindexNew->prevoutStake, pindexNew->nStakeTime);
-                    auto const &hash(pindexNew->GetBlockHash());
-                    uint256 proof;
-                    if (pindexNew->hashProofOfStake == 0) {
-                        LogPrint("debug", "skip invalid indexed orphan block %d %s with empty data\n", pindexNew->nHeight, hash.GetHex());
-                        nDiscarded++;
-                        nFirstDiscarded = diskindex.nHeight < nFirstDiscarded ? diskindex.nHeight : nFirstDiscarded;
-                        batch.Erase(make_pair('b', hash));
-                        pcursor->Next();
-                        continue;
-                    } else if (stake->GetProof(hash, proof)) {
-                        if (proof != pindexNew->hashProofOfStake)
-                            return error("%s: diverged stake %s, %s (block %s)\n", __func__, 
-                                         pindexNew->hashProofOfStake.GetHex(), proof.GetHex(), hash.GetHex());
-                    } else {
-                        stake->SetProof(hash, pindexNew->hashProofOfStake);
-                    }
-                }
+            if (chType != 'b') {
+                fDone = true; // finished loading block index
+                break;
+            }
+            vRaw.push_back(pcursor->value().ToString());
+            pcursor->Next();
+        }
+        if (!pcursor->Valid())
+            fDone = true;
+        if (vRaw.empty())
+            break;
+
+        // Deserialize, hash and PoW-check the batch in parallel
+        std::vector<CLoadedBlockIndex> vEntries(vRaw.size());
+        std::atomic<size_t> nNext(0);
+        if (nThreads > 1 && vRaw.size() > 256) {
+            boost::thread_group group;
+            for (int n = 0; n < nThreads - 1; n++)
+                group.create_thread(boost::bind(DecodeBlockIndexWorker, &vRaw, &vEntries, &nNext, nLastPOWBlock));
+            DecodeBlockIndexWorker(&vRaw, &vEntries, &nNext, nLastPOWBlock);
+            group.join_all();
+        } else {
+            DecodeBlockIndexWorker(&vRaw, &vEntries, &nNext, nLastPOWBlock);
+        }
 
-                pindexPrev = pindexNew;
-                pcursor->Next();
+        // Link the decoded entries into mapBlockIndex, in disk order
+        for (size_t i = 0; i < vEntries.size(); i++) {
+            const CLoadedBlockIndex& entry = vEntries[i];
+            if (!entry.fGood)
+                return error("%s : Deserialize or I/O error - %s", __func__, entry.strError);
+            const CDiskBlockIndex& diskindex = entry.diskindex;
+            const uint256& hash = entry.hash;
+
+            // Construct block index object
+            CBlockIndex* pindexNew = InsertBlockIndex(hash);
+            pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+            pindexNew->hashStateRoot  = diskindex.hashStateRoot; // lux
+            pindexNew->hashUTXORoot   = diskindex.hashUTXORoot; // lux
+
+            // Proof Of Stake
+            pindexNew->nMint = diskindex.nMint;
+            pindexNew->nMoneySupply = diskindex.nMoneySupply;
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->nStakeModifier = diskindex.nStakeModifier;
+            pindexNew->prevoutStake = diskindex.prevoutStake;
+            pindexNew->nStakeTime = diskindex.nStakeTime;
+            pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+
+            bool isPoW = (diskindex.nNonce != 0) && pindexNew->nHeight <= nLastPOWBlock;
+            if (isPoW) {
+                if (!entry.fPoWOk) {
+                    unsigned int nBits = pindexPrev ? pindexPrev->nBits : 0;
+                    return error("%s: CheckProofOfWork failed: %d %s (%d, %d)", __func__, pindexNew->nHeight, hash.GetHex(), pindexNew->nBits, nBits);
+                }
             } else {
-                break; // if shutdown requested or finished loading block index
+                stake->MarkStake(pindexNew->prevoutStake, pindexNew->nStakeTime);
+                uint256 proof;
+                if (pindexNew->hashProofOfStake == 0) {
+                    LogPrint("debug", "skip invalid indexed orphan block %d %s with empty data\n", pindexNew->nHeight, hash.GetHex());
+                    nDiscarded++;
+                    nFirstDiscarded = diskindex.nHeight < nFirstDiscarded ? diskindex.nHeight : nFirstDiscarded;
+                    batch.Erase(make_pair('b', hash));
+                    continue;
+                } else if (stake->GetProof(hash, proof)) {
+                    if (proof != pindexNew->hashProofOfStake)
+                        return error("%s: diverged stake %s, %s (block %s)\n", __func__,
+                                     pindexNew->hashProofOfStake.GetHex(), proof.GetHex(), hash.GetHex());
+                } else {
+                    stake->SetProof(hash, pindexNew->hashProofOfStake);
+                }
             }
-        } catch (std::exception& e) {
-            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+
+            pindexPrev = pindexNew;
         }
     }
 
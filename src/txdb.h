@@ -6,14 +6,17 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
 #include "leveldbwrapper.h"
 #include "main.h"
+#include "spentindex.h"
 
 #include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
+class CAutoFile;
 class CCoins;
 class uint256;
 
@@ -23,6 +26,8 @@ static const int64_t nDefaultDbCache = 100;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 4096 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! max. size of an individual LevelDB commit while flushing the coin cache (bytes)
+static const size_t DBCOINS_BATCH_SIZE = 1 << 24;
 
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
@@ -38,6 +43,20 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+    //! Whether a previous multi-batch flush left its mid-flush marker behind.
+    bool WasFlushInterrupted() const;
+    //! Stream every coin entry (record count, records, commitment hash) to a
+    //! snapshot file; the caller has already written the snapshot header.
+    bool WriteSnapshot(CAutoFile& fileout, const uint256& hashBlock, uint64_t& nCoins) const;
+    //! Delete every coin entry, leaving the other chainstate records alone.
+    bool EraseAllCoins();
+    //! Forward a leveldb property query to the underlying database.
+    bool GetDbProperty(const std::string& strProperty, std::string& strValue) const;
+    //! Persist the rolling UTXO set hash together with the best block it matches.
+    bool WriteUtxoSetHash(const uint256& hash, const uint256& hashBlock);
+    bool ReadUtxoSetHash(uint256& hash, uint256& hashBlock) const;
+    //! Rebuild the rolling UTXO set hash with a full scan of the coin records.
+    bool ComputeUtxoSetHash(CUtxoSetHasher& hasher) const;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -60,6 +79,20 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    //! -addressindex: per-script deltas keyed for in-order iteration, and
+    //! -spentindex: outpoint -> spending transaction. Both are maintained
+    //! by ConnectBlock/DisconnectBlock alongside the transaction index.
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect);
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect);
+    bool ReadAddressIndex(const uint160& addressHash, unsigned char type, std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, int start = 0, int end = 0);
+    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vect);
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+    //! Per-block logs bloom (address+topics, Ethereum layout); only written
+    //! for blocks that produced contract logs, so a missing key means the
+    //! block can be skipped when filtering events.
+    bool ReadLogsBloom(const uint256& hashBlock, std::vector<unsigned char>& vBloom);
+    bool WriteLogsBloom(const uint256& hashBlock, const std::vector<unsigned char>& vBloom);
+    bool EraseLogsBloom(const uint256& hashBlock);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool LoadBlockIndexGuts();
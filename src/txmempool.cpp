@@ -350,7 +350,7 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(const CFeeRate& _minReasonableRelayFee) :
-    nTransactionsUpdated(0)
+    nTransactionsUpdated(0), nSnapshotTxUpdated(0)
 {
     _clear(); //lock free clear
 
@@ -844,6 +844,33 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
     return ret;
 }
 
+CTxMemPool::SnapshotPtr CTxMemPool::GetSnapshot() const
+{
+    SnapshotPtr cur = std::atomic_load(&snapshot);
+    // Reading the update counter unlocked is a benign race: at worst we
+    // serve a snapshot one interval staler than intended.
+    if (cur && nTransactionsUpdated - nSnapshotTxUpdated < SNAPSHOT_REBUILD_INTERVAL)
+        return cur;
+
+    TRY_LOCK(cs, lockPool);
+    if (!lockPool) {
+        // A writer holds cs; serve the stale snapshot rather than block.
+        if (cur)
+            return cur;
+        return std::make_shared<const std::vector<TxMempoolInfo> >();
+    }
+
+    auto iters = GetSortedDepthAndScore();
+    auto fresh = std::make_shared<std::vector<TxMempoolInfo> >();
+    fresh->reserve(iters.size());
+    for (auto it : iters)
+        fresh->push_back(GetInfo(it));
+    nSnapshotTxUpdated = nTransactionsUpdated;
+    SnapshotPtr published(fresh);
+    std::atomic_store(&snapshot, published);
+    return published;
+}
+
 CTransactionRef CTxMemPool::get(const uint256& hash) const
 {
     LOCK(cs);
@@ -867,6 +894,11 @@ CFeeRate CTxMemPool::estimateFee(int nBlocks) const
     LOCK(cs);
     return minerPolicyEstimator->estimateFee(nBlocks);
 }
+CFeeRate CTxMemPool::estimateFeePercentile(int nBlocks, double successPct) const
+{
+    LOCK(cs);
+    return minerPolicyEstimator->estimateFeePercentile(nBlocks, successPct);
+}
 CFeeRate CTxMemPool::estimateSmartFee(int nBlocks, int *answerFoundAtBlocks) const
 {
     LOCK(cs);
@@ -1147,4 +1179,3 @@ bool CTxMemPool::TransactionWithinChainLimit(const uint256& txid, size_t chainLi
        it->GetCountWithDescendants() < chainLimit);
 }
 
-SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -400,19 +400,6 @@ enum class MemPoolRemovalReason {
     REPLACED     //! Removed for replacement
 };
 
-class SaltedTxidHasher
-{
-private:
-    /** Salt */
-    const uint64_t k0, k1;
-
-public:
-    SaltedTxidHasher();
-
-    size_t operator()(const uint256& txid) const {
-        return SipHashUint256(k0, k1, txid);
-    }
-};
 
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
@@ -508,6 +495,9 @@ private:
     mutable bool blockSinceLastRollingFeeBump;
     mutable double rollingMinimumFeeRate; //!< minimum fee to get into the pool, decreases exponentially
 
+    mutable std::shared_ptr<const std::vector<TxMempoolInfo> > snapshot; //!< last published snapshot, swapped atomically
+    mutable unsigned int nSnapshotTxUpdated;                             //!< nTransactionsUpdated when snapshot was built
+
     void trackPackageRemoved(const CFeeRate& rate);
 
 public:
@@ -718,6 +708,18 @@ public:
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
+    /** A point-in-time copy of the mempool contents, sorted by depth and
+     *  score, shared immutably between readers. */
+    typedef std::shared_ptr<const std::vector<TxMempoolInfo> > SnapshotPtr;
+
+    /** Snapshots are rebuilt at most once per this many transaction updates. */
+    static const unsigned int SNAPSHOT_REBUILD_INTERVAL = 16;
+
+    /** Return a recent immutable snapshot of the mempool without blocking
+     *  writers: if cs is contended, the previously published (slightly
+     *  stale) snapshot is returned instead of waiting on the lock. */
+    SnapshotPtr GetSnapshot() const;
+
     /** Estimate fee rate needed to get into the next nBlocks
      *  If no answer can be given at nBlocks, return an estimate
      *  at the lowest number of blocks where one can be given
@@ -727,6 +729,10 @@ public:
     /** Estimate fee rate needed to get into the next nBlocks */
     CFeeRate estimateFee(int nBlocks) const;
 
+    /** Estimate fee rate needed to get into the next nBlocks with a
+     *  caller-chosen confirmation probability (0.5 - 0.99) */
+    CFeeRate estimateFeePercentile(int nBlocks, double successPct) const;
+
     /** Estimate priority needed to get into the next nBlocks
      *  If no answer can be given at nBlocks, return an estimate
      *  at the lowest number of blocks where one can be given
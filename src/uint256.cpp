@@ -115,11 +115,19 @@ base_uint<BITS>& base_uint<BITS>::operator/=(const base_uint& b)
 template <unsigned int BITS>
 int base_uint<BITS>::CompareTo(const base_uint<BITS>& b) const
 {
-    for (int i = WIDTH - 1; i >= 0; i--) {
-        if (pn[i] < b.pn[i])
-            return -1;
-        if (pn[i] > b.pn[i])
-            return 1;
+    int i = WIDTH - 1;
+    if (WIDTH & 1) {
+        if (pn[i] != b.pn[i])
+            return pn[i] < b.pn[i] ? -1 : 1;
+        i--;
+    }
+    // Compare a 64-bit word per step, most significant first; target and
+    // stake-hash comparisons almost always decide on the first word.
+    for (; i > 0; i -= 2) {
+        uint64_t va = ((uint64_t)pn[i] << 32) | pn[i - 1];
+        uint64_t vb = ((uint64_t)b.pn[i] << 32) | b.pn[i - 1];
+        if (va != vb)
+            return va < vb ? -1 : 1;
     }
     return 0;
 }
@@ -131,11 +139,7 @@ bool base_uint<BITS>::EqualTo(uint64_t b) const
         if (pn[i])
             return false;
     }
-    if (pn[1] != (b >> 32))
-        return false;
-    if (pn[0] != (b & 0xfffffffful))
-        return false;
-    return true;
+    return (((uint64_t)pn[1] << 32) | pn[0]) == b;
 }
 
 template <unsigned int BITS>
@@ -214,11 +218,15 @@ unsigned int base_uint<BITS>::bits() const
 {
     for (int pos = WIDTH - 1; pos >= 0; pos--) {
         if (pn[pos]) {
+#if defined(__GNUC__)
+            return 32 * pos + 32 - __builtin_clz(pn[pos]);
+#else
             for (int bits = 31; bits > 0; bits--) {
                 if (pn[pos] & 1 << bits)
                     return 32 * pos + bits + 1;
             }
             return 32 * pos + 1;
+#endif
         }
     }
     return 0;
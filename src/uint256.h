@@ -155,18 +155,39 @@ public:
 
     base_uint& operator+=(const base_uint& b)
     {
+#if defined(__SIZEOF_INT128__)
+        // Add two limbs at a time; the 128-bit intermediate carries between steps.
+        unsigned __int128 n = 0;
+        int i = 0;
+        for (; i + 1 < WIDTH; i += 2) {
+            n += ((uint64_t)pn[i + 1] << 32) | pn[i];
+            n += ((uint64_t)b.pn[i + 1] << 32) | b.pn[i];
+            pn[i] = (uint32_t)n;
+            pn[i + 1] = (uint32_t)(n >> 32);
+            n >>= 64;
+        }
+        if (i < WIDTH)
+            pn[i] = (uint32_t)((uint64_t)n + pn[i] + b.pn[i]);
+#else
         uint64_t carry = 0;
         for (int i = 0; i < WIDTH; i++) {
             uint64_t n = carry + pn[i] + b.pn[i];
             pn[i] = n & 0xffffffff;
             carry = n >> 32;
         }
+#endif
         return *this;
     }
 
     base_uint& operator-=(const base_uint& b)
     {
-        *this += -b;
+        // Subtract directly with a borrow chain instead of negating b first.
+        uint64_t borrow = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            uint64_t n = (uint64_t)pn[i] - b.pn[i] - borrow;
+            pn[i] = (uint32_t)n;
+            borrow = (n >> 32) & 1;
+        }
         return *this;
     }
 
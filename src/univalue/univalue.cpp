@@ -97,6 +97,14 @@ bool UniValue::setStr(const string& val_)
     return true;
 }
 
+bool UniValue::setStr(string&& val_)
+{
+    clear();
+    typ = VSTR;
+    val = std::move(val_);
+    return true;
+}
+
 bool UniValue::setArray()
 {
     clear();
@@ -120,6 +128,15 @@ bool UniValue::push_back(const UniValue& val)
     return true;
 }
 
+bool UniValue::push_back(UniValue&& val)
+{
+    if (typ != VARR)
+        return false;
+
+    values.push_back(std::move(val));
+    return true;
+}
+
 bool UniValue::push_backV(const std::vector<UniValue>& vec)
 {
     if (typ != VARR)
@@ -140,6 +157,24 @@ bool UniValue::pushKV(const std::string& key, const UniValue& val)
     return true;
 }
 
+bool UniValue::pushKV(const std::string& key, UniValue&& val)
+{
+    if (typ != VOBJ)
+        return false;
+
+    keys.push_back(key);
+    values.push_back(std::move(val));
+    return true;
+}
+
+void UniValue::reserve(size_t n)
+{
+    if (typ == VOBJ)
+        keys.reserve(n);
+    if (typ == VOBJ || typ == VARR)
+        values.reserve(n);
+}
+
 bool UniValue::pushKVs(const UniValue& obj)
 {
     if (typ != VOBJ || obj.typ != VOBJ)
@@ -42,6 +42,9 @@ public:
     UniValue(const std::string& val_) {
         setStr(val_);
     }
+    UniValue(std::string&& val_) {
+        setStr(std::move(val_));
+    }
     UniValue(const char *val_) {
         std::string s(val_);
         setStr(s);
@@ -58,9 +61,13 @@ public:
     bool setInt(int val) { return setInt((int64_t)val); }
     bool setFloat(double val);
     bool setStr(const std::string& val);
+    bool setStr(std::string&& val);
     bool setArray();
     bool setObject();
 
+    //! Pre-size the value/key vectors of an array or object about to be filled.
+    void reserve(size_t n);
+
     enum VType getType() const { return typ; }
     const std::string& getValStr() const { return val; }
     bool empty() const { return (values.size() == 0); }
@@ -83,10 +90,16 @@ public:
     bool isObject() const { return (typ == VOBJ); }
 
     bool push_back(const UniValue& val);
+    bool push_back(UniValue&& val);
     bool push_back(const std::string& val_) {
         UniValue tmpVal(VSTR, val_);
         return push_back(tmpVal);
     }
+    bool push_back(std::string&& val_) {
+        UniValue tmpVal(VSTR);
+        tmpVal.val = std::move(val_);
+        return push_back(std::move(tmpVal));
+    }
     bool push_back(const char *val_) {
         std::string s(val_);
         return push_back(s);
@@ -94,10 +107,16 @@ public:
     bool push_backV(const std::vector<UniValue>& vec);
 
     bool pushKV(const std::string& key, const UniValue& val);
+    bool pushKV(const std::string& key, UniValue&& val);
     bool pushKV(const std::string& key, const std::string& val) {
         UniValue tmpVal(VSTR, val);
         return pushKV(key, tmpVal);
     }
+    bool pushKV(const std::string& key, std::string&& val_) {
+        UniValue tmpVal(VSTR);
+        tmpVal.val = std::move(val_);
+        return pushKV(key, std::move(tmpVal));
+    }
     bool pushKV(const std::string& key, const char *val_) {
         std::string val(val_);
         return pushKV(key, val);
@@ -153,7 +172,7 @@ public:
 
     enum VType type() const { return getType(); }
     bool push_back(std::pair<std::string,UniValue> pear) {
-        return pushKV(pear.first, pear.second);
+        return pushKV(pear.first, std::move(pear.second));
     }
     friend const UniValue& find_value( const UniValue& obj, const std::string& name);
 };
@@ -217,6 +236,12 @@ static inline std::pair<std::string,UniValue> Pair(const char *cKey, const UniVa
     return std::make_pair(key, uVal);
 }
 
+static inline std::pair<std::string,UniValue> Pair(const char *cKey, UniValue&& uVal)
+{
+    std::string key(cKey);
+    return std::make_pair(key, std::move(uVal));
+}
+
 static inline std::pair<std::string,UniValue> Pair(std::string key, const UniValue& uVal)
 {
     return std::make_pair(key, uVal);
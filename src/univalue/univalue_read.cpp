@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <string.h>
+#include <utility>
 #include <vector>
 #include <stdio.h>
 #include "univalue.h"
@@ -114,8 +115,8 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
     case '8':
     case '9': {
         // part 1: int
-        string numStr;
-
+        // build directly into tokenVal; its capacity is reused across
+        // tokens, so steady-state number parsing does not allocate
         const char *first = raw;
 
         const char *firstDigit = first;
@@ -124,49 +125,48 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
         if ((*firstDigit == '0') && json_isdigit(firstDigit[1]))
             return JTOK_ERR;
 
-        numStr += *raw;                       // copy first char
+        tokenVal += *raw;                     // copy first char
         raw++;
 
         if ((*first == '-') && (!json_isdigit(*raw)))
             return JTOK_ERR;
 
         while ((*raw) && json_isdigit(*raw)) {     // copy digits
-            numStr += *raw;
+            tokenVal += *raw;
             raw++;
         }
 
         // part 2: frac
         if (*raw == '.') {
-            numStr += *raw;                   // copy .
+            tokenVal += *raw;                 // copy .
             raw++;
 
             if (!json_isdigit(*raw))
                 return JTOK_ERR;
             while ((*raw) && json_isdigit(*raw)) { // copy digits
-                numStr += *raw;
+                tokenVal += *raw;
                 raw++;
             }
         }
 
         // part 3: exp
         if (*raw == 'e' || *raw == 'E') {
-            numStr += *raw;                   // copy E
+            tokenVal += *raw;                 // copy E
             raw++;
 
             if (*raw == '-' || *raw == '+') { // copy +/-
-                numStr += *raw;
+                tokenVal += *raw;
                 raw++;
             }
 
             if (!json_isdigit(*raw))
                 return JTOK_ERR;
             while ((*raw) && json_isdigit(*raw)) { // copy digits
-                numStr += *raw;
+                tokenVal += *raw;
                 raw++;
             }
         }
 
-        tokenVal = numStr;
         consumed = (raw - rawStart);
         return JTOK_NUMBER;
         }
@@ -174,8 +174,8 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
     case '"': {
         raw++;                                // skip "
 
-        string valStr;
-        JSONUTF8StringFilter writer(valStr);
+        // filter writes straight into tokenVal; no per-string temporary
+        JSONUTF8StringFilter writer(tokenVal);
 
         while (*raw) {
             if ((unsigned char)*raw < 0x20)
@@ -224,7 +224,6 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
 
         if (!writer.finalize())
             return JTOK_ERR;
-        tokenVal = valStr;
         consumed = (raw - rawStart);
         return JTOK_STRING;
         }
@@ -312,9 +311,8 @@ bool UniValue::read(const char *raw)
                     setArray();
                 stack.push_back(this);
             } else {
-                UniValue tmpVal(utyp);
                 UniValue *top = stack.back();
-                top->values.push_back(tmpVal);
+                top->values.push_back(UniValue(utyp));
 
                 UniValue *newTop = &(top->values.back());
                 stack.push_back(newTop);
@@ -389,7 +387,7 @@ bool UniValue::read(const char *raw)
             }
 
             UniValue *top = stack.back();
-            top->values.push_back(tmpVal);
+            top->values.push_back(std::move(tmpVal));
 
             setExpect(NOT_VALUE);
             break;
@@ -399,9 +397,11 @@ bool UniValue::read(const char *raw)
             if (!stack.size())
                 return false;
 
-            UniValue tmpVal(VNUM, tokenVal);
+            // steal the token text; getJsonToken clears tokenVal anyway
+            UniValue tmpVal(VNUM);
+            tmpVal.val = std::move(tokenVal);
             UniValue *top = stack.back();
-            top->values.push_back(tmpVal);
+            top->values.push_back(std::move(tmpVal));
 
             setExpect(NOT_VALUE);
             break;
@@ -414,12 +414,13 @@ bool UniValue::read(const char *raw)
             UniValue *top = stack.back();
 
             if (expect(OBJ_NAME)) {
-                top->keys.push_back(tokenVal);
+                top->keys.push_back(std::move(tokenVal));
                 clearExpect(OBJ_NAME);
                 setExpect(COLON);
             } else {
-                UniValue tmpVal(VSTR, tokenVal);
-                top->values.push_back(tmpVal);
+                UniValue tmpVal(VSTR);
+                tmpVal.val = std::move(tokenVal);
+                top->values.push_back(std::move(tmpVal));
             }
 
             setExpect(NOT_VALUE);
@@ -12,6 +12,7 @@
 #include "util.h"
 
 #include "allocators.h"
+#include "binlog.h"
 #include "chainparamsbase.h"
 #include "random.h"
 #include "serialize.h"
@@ -40,6 +41,11 @@
 
 #endif // __linux__
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include <algorithm>
 #include <fcntl.h>
 #include <sys/resource.h>
@@ -126,6 +132,7 @@ string strBudgetMode = "";
 map<string, string> mapArgs;
 map<string, vector<string> > mapMultiArgs;
 bool fDebug = false;
+bool fTxTrace = false;
 bool fDebugMnSecurity = false;
 bool fPrintToConsole = false;
 bool fPrintToDebugLog = true;
@@ -228,6 +235,11 @@ static void DebugPrintInit()
 bool LogAcceptCategory(const char* category)
 {
     if (category != NULL) {
+        // The binary event log is cheap enough to capture every category;
+        // the reader filters after the fact instead of the node up front.
+        if (fBinaryLog)
+            return true;
+
         if (!fDebug)
             return false;
 
@@ -261,6 +273,19 @@ bool LogAcceptCategory(const char* category)
 
 int LogPrintStr(const std::string& str, bool useVMLog)
 {
+    return LogPrintStr(NULL, str, useVMLog);
+}
+
+int LogPrintStr(const char* category, const std::string& str, bool useVMLog)
+{
+    // -binlog replaces debug.log entirely: no per-line mutex, no unbuffered
+    // write, just an append into the calling thread's ring buffer. The VM
+    // log and console output keep their usual paths.
+    if (fBinaryLog && !useVMLog && !fPrintToConsole) {
+        BinaryLogWrite(category, str);
+        return str.size();
+    }
+
 //////////////////////////////// // lux
     FILE* file = fileout;
     if(useVMLog){
@@ -617,6 +642,21 @@ void FileCommit(FILE* fileout)
 #endif
 }
 
+/**
+ * Ask the OS to start writing back the dirty pages of fileout without
+ * waiting for them. Spreading writeback out this way keeps the eventual
+ * FileCommit() from having to push a whole burst of data at once.
+ * Advisory: platforms without an async writeback primitive just flush
+ * the stdio buffer.
+ */
+void FileWriteBackHint(FILE* fileout)
+{
+    fflush(fileout);
+#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+    sync_file_range(fileno(fileout), 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
 bool TruncateFile(FILE* file, unsigned int length)
 {
 #if defined(WIN32)
@@ -788,6 +828,49 @@ void RenameThread(const char* name)
 #endif
 }
 
+// Pin the calling thread to the CPUs of one NUMA node. Topology detection
+// reads the kernel's cpulist for the node, so there is no library dependency;
+// on platforms without that interface this is a no-op returning false.
+// Memory placement follows automatically from the default first-touch policy:
+// caches populated by pinned threads are allocated on their node.
+bool BindThreadToNumaNode(int nNode)
+{
+#ifdef __linux__
+    char pszPath[64];
+    snprintf(pszPath, sizeof(pszPath), "/sys/devices/system/node/node%d/cpulist", nNode);
+    FILE* file = fopen(pszPath, "r");
+    if (!file)
+        return false;
+    char pszList[512];
+    bool fRead = fgets(pszList, sizeof(pszList), file) != NULL;
+    fclose(file);
+    if (!fRead)
+        return false;
+
+    // The cpulist is comma-separated ranges, e.g. "0-7,16-23".
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    int nCpus = 0;
+    for (char* psz = strtok(pszList, ","); psz != NULL; psz = strtok(NULL, ",")) {
+        int nFirst = -1, nLast = -1;
+        if (sscanf(psz, "%d-%d", &nFirst, &nLast) < 1)
+            continue;
+        if (nLast < nFirst)
+            nLast = nFirst;
+        for (int cpu = nFirst; cpu <= nLast && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &cpuset);
+            nCpus++;
+        }
+    }
+    if (nCpus == 0)
+        return false;
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#else
+    (void)nNode;
+    return false;
+#endif
+}
+
 void SetupEnvironment()
 {
 // On most POSIX systems (e.g. Linux, but not BSD) the environment's locale
@@ -807,6 +890,15 @@ void SetupEnvironment()
     boost::filesystem::path::imbue(loc);
 }
 
+int GetNumCores()
+{
+#if BOOST_VERSION >= 105600
+    return boost::thread::physical_concurrency();
+#else // Must fall back to hardware_concurrency, which unfortunately counts virtual cores
+    return boost::thread::hardware_concurrency();
+#endif
+}
+
 void SetThreadPriority(int nPriority)
 {
 #ifdef WIN32
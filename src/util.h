@@ -49,6 +49,8 @@ extern std::string strBudgetMode;
 extern std::map<std::string, std::string> mapArgs;
 extern std::map<std::string, std::vector<std::string> > mapMultiArgs;
 extern bool fDebug;
+//! Set from -txtrace; see trace.h
+extern bool fTxTrace;
 extern bool fDebugMnSecurity;
 extern bool fPrintToConsole;
 extern bool fPrintToDebugLog;
@@ -60,10 +62,19 @@ extern volatile bool fReopenDebugLog;
 
 void SetupEnvironment();
 
+/**
+ * Return the number of physical cores available on the current system.
+ * @note This does not count virtual cores, such as those provided by HyperThreading
+ * when boost is newer than 1.56.
+ */
+int GetNumCores();
+
 /** Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
 /** Send a string to the log output */
 int LogPrintStr(const std::string& str, bool useVMLog = false);
+/** As above, keeping the category so -binlog can record it as a structured event */
+int LogPrintStr(const char* category, const std::string& str, bool useVMLog = false);
 
 #define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
 
@@ -78,7 +89,7 @@ int LogPrintStr(const std::string& str, bool useVMLog = false);
     {                                                                                           \
         try {                                                                                   \
             if (!LogAcceptCategory(category)) return 0;                                         \
-            LogPrintStr(tfm::format(format, TINYFORMAT_PASSARGS(n)));                           \
+            LogPrintStr(category, tfm::format(format, TINYFORMAT_PASSARGS(n)));                 \
         } catch (std::runtime_error &e) {                                                       \
             /* Original format string will have newline so don't add one here */                \
             LogPrintStr("ERROR \"" + std::string(e.what()) + "\" while formatting log message: "\
@@ -108,7 +119,7 @@ TINYFORMAT_FOREACH_ARGNUM(MAKE_ERROR_AND_LOG_FUNC)
 static inline int LogPrint(const char* category, const char* format)
 {
     if (!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(format);
+    return LogPrintStr(category, std::string(format));
 }
 static inline bool error(const char* format)
 {
@@ -119,6 +130,7 @@ static inline bool error(const char* format)
 void PrintExceptionContinue(std::exception* pex, const char* pszThread);
 void ParseParameters(int argc, const char* const argv[]);
 void FileCommit(FILE* fileout);
+void FileWriteBackHint(FILE* fileout);
 bool TruncateFile(FILE* file, unsigned int length);
 int RaiseFileDescriptorLimit(int nMinFD);
 void AllocateFileRange(FILE* file, unsigned int offset, unsigned int length);
@@ -212,6 +224,8 @@ bool SoftSetBoolArg(const std::string& strArg, bool fValue);
 
 void SetThreadPriority(int nPriority);
 void RenameThread(const char* name);
+/** Pin the calling thread to the CPUs of a NUMA node (Linux only; false if unsupported). */
+bool BindThreadToNumaNode(int nNode);
 
 inline uint32_t ByteReverse(uint32_t value)
 {
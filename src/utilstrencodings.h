@@ -74,10 +74,22 @@ std::string HexStr(const T itbegin, const T itend, bool fSpaces = false)
     std::string rv;
     static const char hexmap[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+    if (!fSpaces) {
+        // Common case (txids, scripts): size the output exactly and write
+        // into it directly, instead of growing it two characters at a time.
+        rv.resize((itend - itbegin) * 2);
+        size_t pos = 0;
+        for (T it = itbegin; it < itend; ++it) {
+            unsigned char val = (unsigned char)(*it);
+            rv[pos++] = hexmap[val >> 4];
+            rv[pos++] = hexmap[val & 15];
+        }
+        return rv;
+    }
     rv.reserve((itend - itbegin) * 3);
     for (T it = itbegin; it < itend; ++it) {
         unsigned char val = (unsigned char)(*it);
-        if (fSpaces && it != itbegin)
+        if (it != itbegin)
             rv.push_back(' ');
         rv.push_back(hexmap[val >> 4]);
         rv.push_back(hexmap[val & 15]);
@@ -5,8 +5,105 @@
 
 #include "validationinterface.h"
 
+#include "perf.h"
+#include "primitives/block.h"
+#include "sync.h"
+#include "trace.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
 static CMainSignals g_signals;
 
+bool fQueuedNotifications = false;
+
+namespace {
+
+enum NotificationType {
+    NOTIFY_SYNC_TRANSACTION,
+    NOTIFY_SET_BEST_CHAIN,
+    NOTIFY_INVENTORY,
+};
+
+struct CQueuedNotification {
+    NotificationType type;
+    CTransaction tx;
+    boost::shared_ptr<const CBlock> pblock;
+    CBlockLocator locator;
+    uint256 hash;
+    int64_t nQueuedTime;
+
+    CQueuedNotification() : type(NOTIFY_INVENTORY), nQueuedTime(0) {}
+};
+
+//! Backpressure bound: wallet events cannot be dropped, so a poster finding
+//! the queue full waits for the drain thread instead.
+static const size_t MAX_QUEUED_NOTIFICATIONS = 10000;
+
+CWaitableCriticalSection csNotifyQueue;
+CConditionVariable cvNotifyWork;    // signalled when an event is queued
+CConditionVariable cvNotifyDrained; // signalled when the queue empties
+std::deque<CQueuedNotification> queueNotifications;
+bool fNotifierRunning = false;
+int nNotificationsInFlight = 0;
+
+//! SyncTransaction events for one block share a single copy of it. The
+//! pointer check is backed by a cheap field compare in case a later stack
+//! frame reuses the same address for a different block.
+const CBlock* pLastQueuedBlock = NULL;
+boost::shared_ptr<const CBlock> pLastQueuedBlockCopy;
+
+void DeliverNotification(const CQueuedNotification& notification)
+{
+    if (fPerfStats)
+        PerfRecord(notification.type == NOTIFY_SYNC_TRANSACTION ? "NotifyQueueLag.SyncTransaction" :
+                   notification.type == NOTIFY_SET_BEST_CHAIN ? "NotifyQueueLag.SetBestChain" : "NotifyQueueLag.Inventory",
+                   GetTimeMicros() - notification.nQueuedTime);
+    switch (notification.type) {
+    case NOTIFY_SYNC_TRANSACTION: {
+        CPerfScope perfscope("NotifyDeliver.SyncTransaction");
+        CTxTraceScope tracescope("wallet.sync", notification.tx.GetHash());
+        g_signals.SyncTransaction(notification.tx, notification.pblock.get());
+        break;
+    }
+    case NOTIFY_SET_BEST_CHAIN: {
+        CPerfScope perfscope("NotifyDeliver.SetBestChain");
+        g_signals.SetBestChain(notification.locator);
+        break;
+    }
+    case NOTIFY_INVENTORY: {
+        CPerfScope perfscope("NotifyDeliver.Inventory");
+        g_signals.Inventory(notification.hash);
+        break;
+    }
+    }
+}
+
+//! Returns false when the notifier is not running; the caller delivers inline.
+bool EnqueueNotification(CQueuedNotification& notification)
+{
+    boost::unique_lock<boost::mutex> lock(csNotifyQueue);
+    if (!fNotifierRunning)
+        return false;
+    while (queueNotifications.size() >= MAX_QUEUED_NOTIFICATIONS && fNotifierRunning)
+        cvNotifyDrained.wait(lock);
+    if (!fNotifierRunning)
+        return false;
+    notification.nQueuedTime = GetTimeMicros();
+    queueNotifications.push_back(CQueuedNotification());
+    std::swap(queueNotifications.back(), notification);
+    cvNotifyWork.notify_one();
+    return true;
+}
+
+} // anon namespace
+
 CMainSignals &GetMainSignals() {
     return g_signals;
 }
@@ -52,5 +149,101 @@ void UnregisterAllValidationInterfaces() {
 }
 
 void SyncWithWallets(const CTransaction &tx, const CBlock *pblock = NULL) {
+    if (fQueuedNotifications) {
+        CQueuedNotification notification;
+        notification.type = NOTIFY_SYNC_TRANSACTION;
+        notification.tx = tx;
+        if (pblock) {
+            if (pblock == pLastQueuedBlock && pLastQueuedBlockCopy &&
+                pLastQueuedBlockCopy->hashMerkleRoot == pblock->hashMerkleRoot) {
+                notification.pblock = pLastQueuedBlockCopy;
+            } else {
+                notification.pblock = boost::shared_ptr<const CBlock>(new CBlock(*pblock));
+                pLastQueuedBlock = pblock;
+                pLastQueuedBlockCopy = notification.pblock;
+            }
+        }
+        if (EnqueueNotification(notification))
+            return;
+    }
+    CTxTraceScope tracescope("wallet.sync", tx.GetHash());
     g_signals.SyncTransaction(tx, pblock);
 }
+
+void NotifySetBestChain(const CBlockLocator &locator) {
+    if (fQueuedNotifications) {
+        CQueuedNotification notification;
+        notification.type = NOTIFY_SET_BEST_CHAIN;
+        notification.locator = locator;
+        if (EnqueueNotification(notification))
+            return;
+    }
+    g_signals.SetBestChain(locator);
+}
+
+void NotifyInventory(const uint256 &hash) {
+    if (fQueuedNotifications) {
+        CQueuedNotification notification;
+        notification.type = NOTIFY_INVENTORY;
+        notification.hash = hash;
+        if (EnqueueNotification(notification))
+            return;
+    }
+    g_signals.Inventory(hash);
+}
+
+void ThreadValidationNotifier() {
+    RenameThread("lux-notifier");
+    LogPrintf("ThreadValidationNotifier started\n");
+    {
+        boost::unique_lock<boost::mutex> lock(csNotifyQueue);
+        fNotifierRunning = true;
+    }
+    try {
+        while (true) {
+            CQueuedNotification notification;
+            {
+                boost::unique_lock<boost::mutex> lock(csNotifyQueue);
+                while (queueNotifications.empty()) {
+                    cvNotifyWork.wait(lock);
+                    boost::this_thread::interruption_point();
+                }
+                std::swap(notification, queueNotifications.front());
+                queueNotifications.pop_front();
+                nNotificationsInFlight++;
+            }
+            boost::this_thread::interruption_point();
+            DeliverNotification(notification);
+            {
+                boost::unique_lock<boost::mutex> lock(csNotifyQueue);
+                nNotificationsInFlight--;
+                if (queueNotifications.empty() && nNotificationsInFlight == 0)
+                    cvNotifyDrained.notify_all();
+                else if (queueNotifications.size() == MAX_QUEUED_NOTIFICATIONS - 1)
+                    cvNotifyDrained.notify_all(); // wake posters blocked on backpressure
+            }
+        }
+    } catch (const boost::thread_interrupted&) {
+        // Deliver what is already queued so the wallet does not lose events
+        // accepted before shutdown, then fall back to inline dispatch.
+        std::deque<CQueuedNotification> queueRemaining;
+        {
+            boost::unique_lock<boost::mutex> lock(csNotifyQueue);
+            fNotifierRunning = false;
+            nNotificationsInFlight = 0;
+            std::swap(queueRemaining, queueNotifications);
+            cvNotifyWork.notify_all();
+            cvNotifyDrained.notify_all();
+        }
+        BOOST_FOREACH (const CQueuedNotification& notification, queueRemaining)
+            DeliverNotification(notification);
+        LogPrintf("ThreadValidationNotifier exiting, %u queued events flushed\n", queueRemaining.size());
+        throw;
+    }
+}
+
+void SyncWithValidationInterfaceQueue() {
+    boost::unique_lock<boost::mutex> lock(csNotifyQueue);
+    while (fNotifierRunning && !(queueNotifications.empty() && nNotificationsInFlight == 0))
+        cvNotifyDrained.wait(lock);
+}
@@ -39,6 +39,27 @@ void UnregisterAllValidationInterfaces();
 /** Push an updated transaction to all registered wallets */
 void SyncWithWallets(const CTransaction &tx, const CBlock *pblock);
 
+//! Set from -asyncnotify; while true, validation posts listener events to a
+//! bounded queue drained by the notification thread instead of running the
+//! wallet, ZMQ and GUI handlers inline under cs_main.
+extern bool fQueuedNotifications;
+
+/** Tell listeners about a new active chain; queued under -asyncnotify. */
+void NotifySetBestChain(const CBlockLocator &locator);
+
+/** Tell listeners about an inventory item; queued under -asyncnotify. */
+void NotifyInventory(const uint256 &hash);
+
+/** Drain the notification queue; started from init when -asyncnotify is set. */
+void ThreadValidationNotifier();
+
+/**
+ * Block until every notification queued so far has been delivered. Callers
+ * that need synchronous semantics (e.g. a rescan about to re-read history
+ * the queue may still be feeding to the wallet) run this barrier first.
+ */
+void SyncWithValidationInterfaceQueue();
+
 class CValidationInterface {
 protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindex) {}
@@ -10,6 +10,7 @@
 #include "base58.h"
 #include "checkpoints.h"
 #include "coincontrol.h"
+#include "core_memusage.h"
 #include "consensus/validation.h"
 #include "stake.h"
 #include "net.h"
@@ -166,9 +167,92 @@ CPubKey CWallet::GenerateNewKey(bool internal)
     return pubkey;
 }
 
+/**
+ * Cheap shape test for the script templates the IsMine cache enumerates
+ * exhaustively: P2PK, P2PKH and P2SH.  For these a cache miss means
+ * ISMINE_NO; anything else still goes through the script solver.
+ */
+static bool IsCachedScriptShape(const CScript& script)
+{
+    // P2PKH: OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+    if (script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 &&
+        script[2] == 20 && script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG)
+        return true;
+    // P2SH: OP_HASH160 <20 bytes> OP_EQUAL
+    if (script.IsPayToScriptHash())
+        return true;
+    // P2PK: <33 or 65 byte pubkey> OP_CHECKSIG
+    if ((script.size() == 35 && script[0] == 33 && script[34] == OP_CHECKSIG) ||
+        (script.size() == 67 && script[0] == 65 && script[66] == OP_CHECKSIG))
+        return true;
+    return false;
+}
+
+void CWallet::MarkScriptCacheDirty() const
+{
+    LOCK(cs_scriptCache);
+    fScriptCacheDirty = true;
+}
+
+void CWallet::RebuildScriptCache() const
+{
+    AssertLockHeld(cs_scriptCache);
+    mapScriptIsMine.clear();
+
+    BOOST_FOREACH (const CKeyID& keyID, GetKeys()) {
+        CPubKey pubkey;
+        if (GetPubKey(keyID, pubkey)) {
+            CScript scriptPubKey = CScript() << ToByteVector(pubkey) << OP_CHECKSIG;
+            isminetype mine = ::IsMine(*this, scriptPubKey);
+            if (mine != ISMINE_NO)
+                mapScriptIsMine[scriptPubKey] = mine;
+        }
+        CScript scriptHash = GetScriptForDestination(keyID);
+        isminetype mine = ::IsMine(*this, scriptHash);
+        if (mine != ISMINE_NO)
+            mapScriptIsMine[scriptHash] = mine;
+    }
+
+    std::set<CScriptID> setScripts;
+    GetCScripts(setScripts);
+    BOOST_FOREACH (const CScriptID& scriptID, setScripts) {
+        CScript scriptPubKey = GetScriptForDestination(scriptID);
+        isminetype mine = ::IsMine(*this, scriptPubKey);
+        if (mine != ISMINE_NO)
+            mapScriptIsMine[scriptPubKey] = mine;
+    }
+
+    std::set<CScript> setWatch;
+    GetWatchOnly(setWatch);
+    BOOST_FOREACH (const CScript& scriptPubKey, setWatch) {
+        isminetype mine = ::IsMine(*this, scriptPubKey);
+        if (mine != ISMINE_NO)
+            mapScriptIsMine[scriptPubKey] = mine;
+    }
+
+    fScriptCacheDirty = false;
+}
+
+isminetype CWallet::IsMineCached(const CScript& scriptPubKey) const
+{
+    {
+        LOCK(cs_scriptCache);
+        if (fScriptCacheDirty)
+            RebuildScriptCache();
+        std::map<CScript, isminetype>::const_iterator it = mapScriptIsMine.find(scriptPubKey);
+        if (it != mapScriptIsMine.end())
+            return it->second;
+        if (IsCachedScriptShape(scriptPubKey))
+            return ISMINE_NO;
+    }
+    // Rare shapes (bare multisig, nonstandard, witness) take the solver.
+    return ::IsMine(*this, scriptPubKey);
+}
+
 bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey& pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
+    MarkScriptCacheDirty();
     if (!CCryptoKeyStore::AddKeyPubKey(secret, pubkey))
         return false;
 
@@ -189,6 +273,7 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey& pubkey)
 bool CWallet::AddCryptedKey(const CPubKey& vchPubKey,
     const vector<unsigned char>& vchCryptedSecret)
 {
+    MarkScriptCacheDirty();
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
     if (!fFileBacked)
@@ -217,11 +302,13 @@ bool CWallet::LoadKeyMetadata(const CPubKey& pubkey, const CKeyMetadata& meta)
 
 bool CWallet::LoadCryptedKey(const CPubKey& vchPubKey, const std::vector<unsigned char>& vchCryptedSecret)
 {
+    MarkScriptCacheDirty();
     return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
 }
 
 bool CWallet::AddCScript(const CScript& redeemScript)
 {
+    MarkScriptCacheDirty();
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
     if (!fFileBacked)
@@ -241,11 +328,13 @@ bool CWallet::LoadCScript(const CScript& redeemScript)
         return true;
     }
 
+    MarkScriptCacheDirty();
     return CCryptoKeyStore::AddCScript(redeemScript);
 }
 
 bool CWallet::AddWatchOnly(const CScript& dest)
 {
+    MarkScriptCacheDirty();
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
     nTimeFirstKey = 1; // No birthday information for watch-only keys.
@@ -258,6 +347,7 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 bool CWallet::RemoveWatchOnly(const CScript& dest)
 {
     AssertLockHeld(cs_wallet);
+    MarkScriptCacheDirty();
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
     if (!HaveWatchOnly())
@@ -271,6 +361,7 @@ bool CWallet::RemoveWatchOnly(const CScript& dest)
 
 bool CWallet::LoadWatchOnly(const CScript& dest)
 {
+    MarkScriptCacheDirty();
     return CCryptoKeyStore::AddWatchOnly(dest);
 }
 
@@ -353,6 +444,10 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 
 void CWallet::SetBestChain(const CBlockLocator& loc)
 {
+    if (fReadOnly)
+        return;
+    // depth-dependent aggregates (unconfirmed, immature) change with the tip
+    InvalidateBalanceCaches();
     CWalletDB walletdb(strWalletFile);
     walletdb.WriteBestBlock(loc);
 }
@@ -472,12 +567,55 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(make_pair(outpoint, wtxid));
+    if (setWalletUTXO.erase(outpoint)) {
+        nUTXOSetGeneration++;
+        map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(outpoint.hash);
+        if (mit != mapWallet.end() && outpoint.n < mit->second.vout.size()) {
+            std::map<CAmount, std::set<COutPoint> >::iterator dit = mapDenomUTXO.find(mit->second.vout[outpoint.n].nValue);
+            if (dit != mapDenomUTXO.end())
+                dit->second.erase(outpoint);
+            CTxDestination dest;
+            if (ExtractDestination(mit->second.vout[outpoint.n].scriptPubKey, dest)) {
+                std::map<CTxDestination, std::set<COutPoint> >::iterator ait = mapAddressUTXO.find(dest);
+                if (ait != mapAddressUTXO.end())
+                    ait->second.erase(outpoint);
+            }
+        }
+    }
 
     pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
     SyncMetaData(range);
 }
 
+void CWallet::RebuildWalletUTXOSet()
+{
+    AssertLockHeld(cs_wallet);
+    setWalletUTXO.clear();
+    mapDenomUTXO.clear();
+    mapAddressUTXO.clear();
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+        const CWalletTx& wtx = it->second;
+        for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+            if (IsMine(wtx.vout[i]) != ISMINE_NO && !IsSpent(it->first, i)) {
+                setWalletUTXO.insert(COutPoint(it->first, i));
+                if (IsDenominatedAmount(wtx.vout[i].nValue))
+                    mapDenomUTXO[wtx.vout[i].nValue].insert(COutPoint(it->first, i));
+                CTxDestination dest;
+                if (ExtractDestination(wtx.vout[i].scriptPubKey, dest))
+                    mapAddressUTXO[dest].insert(COutPoint(it->first, i));
+            }
+        }
+    }
+    nUTXOSetGeneration++;
+}
+
+uint64_t CWallet::GetUTXOSetGeneration() const
+{
+    LOCK(cs_wallet);
+    return nUTXOSetGeneration;
+}
+
 
 void CWallet::AddToSpends(const uint256& wtxid)
 {
@@ -520,7 +658,7 @@ bool CWallet::GetVinAndKeysFromOutput(COutput out, CTxIn& txinRet, CPubKey& pubK
 
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
-    if (IsCrypted())
+    if (IsCrypted() || fReadOnly)
         return false;
 
     CKeyingMaterial _vMasterKey;
@@ -689,18 +827,39 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
             item.second.MarkDirty();
+        // Key imports change which outputs count as ours, so recompute the
+        // unspent-output set from scratch.
+        RebuildWalletUTXOSet();
+        InvalidateBalanceCaches();
     }
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, bool fFlushOnClose)
 {
+    if (fReadOnly && !fFromLoadWallet)
+        return false;
+
     CWalletDB walletdb(strWalletFile, "r+", fFlushOnClose);
     uint256 hash = wtxIn.GetHash();
 
+    InvalidateBalanceCaches();
+
     if (fFromLoadWallet) {
         mapWallet[hash] = wtxIn;
         mapWallet[hash].BindWallet(this);
         AddToSpends(hash);
+        const CWalletTx& wtx = mapWallet[hash];
+        for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+            if (IsMine(wtx.vout[i]) != ISMINE_NO && !IsSpent(hash, i)) {
+                if (setWalletUTXO.insert(COutPoint(hash, i)).second)
+                    nUTXOSetGeneration++;
+                if (IsDenominatedAmount(wtx.vout[i].nValue))
+                    mapDenomUTXO[wtx.vout[i].nValue].insert(COutPoint(hash, i));
+                CTxDestination dest;
+                if (ExtractDestination(wtx.vout[i].scriptPubKey, dest))
+                    mapAddressUTXO[dest].insert(COutPoint(hash, i));
+            }
+        }
     } else {
         LOCK(cs_wallet);
         // Inserts only if not already there, returns tx inserted or tx found
@@ -751,6 +910,17 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, bool fFl
                         wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+            for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+                if (IsMine(wtx.vout[i]) != ISMINE_NO && !IsSpent(hash, i)) {
+                    if (setWalletUTXO.insert(COutPoint(hash, i)).second)
+                        nUTXOSetGeneration++;
+                    if (IsDenominatedAmount(wtx.vout[i].nValue))
+                        mapDenomUTXO[wtx.vout[i].nValue].insert(COutPoint(hash, i));
+                    CTxDestination dest;
+                    if (ExtractDestination(wtx.vout[i].scriptPubKey, dest))
+                        mapAddressUTXO[dest].insert(COutPoint(hash, i));
+                }
+            }
         }
 
         bool fUpdated = false;
@@ -829,6 +999,13 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
 
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 {
+    // A transaction arriving in a block means the tip moved, which changes
+    // confirmation depths, so the depth-dependent aggregates have to be
+    // recomputed even if the transaction is not ours. Loose mempool
+    // transactions only matter if AddToWallet below takes them.
+    if (pblock)
+        InvalidateBalanceCaches();
+
     LOCK2(cs_main, cs_wallet);
     if (!AddToWalletIfInvolvingMe(tx, pblock, true))
         return; // Not one of ours
@@ -848,8 +1025,27 @@ void CWallet::EraseFromWallet(const uint256& hash)
         return;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(hash);
+        for (std::set<COutPoint>::iterator it = setWalletUTXO.lower_bound(COutPoint(hash, 0));
+             it != setWalletUTXO.end() && it->hash == hash;) {
+            if (mit != mapWallet.end() && it->n < mit->second.vout.size()) {
+                std::map<CAmount, std::set<COutPoint> >::iterator dit = mapDenomUTXO.find(mit->second.vout[it->n].nValue);
+                if (dit != mapDenomUTXO.end())
+                    dit->second.erase(*it);
+                CTxDestination dest;
+                if (ExtractDestination(mit->second.vout[it->n].scriptPubKey, dest)) {
+                    std::map<CTxDestination, std::set<COutPoint> >::iterator ait = mapAddressUTXO.find(dest);
+                    if (ait != mapAddressUTXO.end())
+                        ait->second.erase(*it);
+                }
+            }
+            setWalletUTXO.erase(it++);
+            nUTXOSetGeneration++;
+        }
+        if (mapWallet.erase(hash)) {
             CWalletDB(strWalletFile).EraseTx(hash);
+            InvalidateBalanceCaches();
+        }
     }
     return;
 }
@@ -1152,6 +1348,176 @@ bool CWalletTx::WriteToDisk()
 }
 
 
+namespace {
+/**
+ * Shared state for the parallel rescan pipeline.  Worker threads claim block
+ * positions, read and deserialize the blocks from disk and match outputs
+ * against the key store; the merge loop consumes the results strictly in
+ * height order.  Workers stay at most RESCAN_LOOKAHEAD blocks ahead of the
+ * merge position so memory use stays bounded.
+ */
+struct CRescanPipeline {
+    std::vector<CBlockIndex*> vBlocks; //!< snapshot of the scan range, in height order
+    size_t nNext;                      //!< next position a worker should claim
+    size_t nMergePos;                  //!< next position the merge loop needs
+    bool fStop;                        //!< set on abort/shutdown to release the workers
+    std::map<size_t, std::pair<CBlock, std::vector<unsigned int> > > mapReady; //!< position -> (block, matched tx indices)
+    CWaitableCriticalSection cs;
+    CConditionVariable condReady; //!< signalled when a result is delivered
+    CConditionVariable condSpace; //!< signalled when the merge position advances
+
+    CRescanPipeline() : nNext(0), nMergePos(0), fStop(false) {}
+};
+
+static const size_t RESCAN_LOOKAHEAD = 64;
+
+void RescanWorker(CWallet* pwallet, CRescanPipeline* pipe)
+{
+    RenameThread("lux-rescan");
+    while (true) {
+        size_t nPos;
+        {
+            boost::unique_lock<boost::mutex> lock(pipe->cs);
+            while (!pipe->fStop && pipe->nNext < pipe->vBlocks.size() &&
+                   pipe->nNext >= pipe->nMergePos + RESCAN_LOOKAHEAD)
+                pipe->condSpace.wait(lock);
+            if (pipe->fStop || pipe->nNext >= pipe->vBlocks.size())
+                return;
+            nPos = pipe->nNext++;
+        }
+
+        CBlock block;
+        ReadBlockFromDisk(block, pipe->vBlocks[nPos], Params().GetConsensus());
+
+        // Match outputs against the key store here, off cs_wallet.  Spends of
+        // wallet outputs depend on what earlier blocks added to the wallet,
+        // so those are detected by the merge loop in height order.
+        std::vector<unsigned int> vMatched;
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            BOOST_FOREACH (const CTxOut& txout, block.vtx[i].vout) {
+                if (pwallet->IsMine(txout) != ISMINE_NO) {
+                    vMatched.push_back(i);
+                    break;
+                }
+            }
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(pipe->cs);
+            std::pair<CBlock, std::vector<unsigned int> >& result = pipe->mapReady[nPos];
+            result.first = block;
+            result.second.swap(vMatched);
+            pipe->condReady.notify_all();
+        }
+    }
+}
+} // anon namespace
+
+int CWallet::ScanForWalletTransactionsParallel(CBlockIndex* pindexStart, bool fUpdate, int nThreads)
+{
+    int ret = 0;
+    int64_t nNow = GetTime();
+
+    CRescanPipeline pipe;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindex = pindexStart;
+        // no need to read and scan block, if block was created before
+        // our wallet birthday (as adjusted for block time variability)
+        while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
+            pindex = chainActive.Next(pindex);
+        for (; pindex; pindex = chainActive.Next(pindex))
+            pipe.vBlocks.push_back(pindex);
+    }
+    if (pipe.vBlocks.empty())
+        return 0;
+
+    fAbortRescan = false;
+    ShowProgress(_("Rescanning..."), 0);
+    LogPrintf("Rescanning %u blocks with %d threads...\n", pipe.vBlocks.size(), nThreads);
+
+    boost::thread_group workers;
+    for (int i = 0; i < nThreads; i++)
+        workers.create_thread(boost::bind(&RescanWorker, this, &pipe));
+
+    int dProgressStart = pipe.vBlocks.front()->nHeight;
+    int dProgressTotal = pipe.vBlocks.back()->nHeight - dProgressStart;
+    int dProgressShowPrev = 0;
+
+    for (size_t nPos = 0; nPos < pipe.vBlocks.size() && !fAbortRescan && !ShutdownRequested(); nPos++) {
+        CBlockIndex* pindex = pipe.vBlocks[nPos];
+
+        CBlock block;
+        std::vector<unsigned int> vMatched;
+        {
+            boost::unique_lock<boost::mutex> lock(pipe.cs);
+            while (!pipe.mapReady.count(nPos))
+                pipe.condReady.wait(lock);
+            std::pair<CBlock, std::vector<unsigned int> >& result = pipe.mapReady[nPos];
+            block = result.first;
+            vMatched.swap(result.second);
+            pipe.mapReady.erase(nPos);
+            pipe.nMergePos = nPos + 1;
+            pipe.condSpace.notify_all();
+        }
+
+        {
+            LOCK(cs_wallet);
+            unsigned int nNextMatched = 0;
+            for (unsigned int i = 0; i < block.vtx.size(); i++) {
+                CTransaction& tx = block.vtx[i];
+                while (nNextMatched < vMatched.size() && vMatched[nNextMatched] < i)
+                    nNextMatched++;
+                bool fCandidate = (nNextMatched < vMatched.size() && vMatched[nNextMatched] == i);
+                // The workers only matched outputs; a transaction is also
+                // interesting if we already have it or if it spends an output
+                // of a transaction we have (superset of IsFromMe).
+                if (!fCandidate)
+                    fCandidate = mapWallet.count(tx.GetHash()) != 0;
+                if (!fCandidate) {
+                    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+                        if (mapWallet.count(txin.prevout.hash)) {
+                            fCandidate = true;
+                            break;
+                        }
+                    }
+                }
+                if (fCandidate && AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                    ret++;
+            }
+        }
+
+        if (dProgressTotal > 0 && pindex->nHeight % 100 == 0) {
+            int dProgressShow = std::min(99, (int)(((pindex->nHeight - dProgressStart) * 100) / dProgressTotal));
+            dProgressShow = std::max(1, dProgressShow);
+            if (dProgressShowPrev != dProgressShow) {
+                dProgressShowPrev = dProgressShow;
+                ShowProgress(_("Rescanning..."), dProgressShow);
+            }
+        }
+        if (GetTime() >= nNow + 60) {
+            nNow = GetTime();
+            LogPrintf("Still rescanning. At block %d. Progress=%d\n", pindex->nHeight, dProgressShowPrev);
+        }
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(pipe.cs);
+        pipe.fStop = true;
+        pipe.condSpace.notify_all();
+    }
+    workers.join_all();
+
+    if (fAbortRescan) {
+        LogPrintf("Rescan aborted. Progress=%d\n", dProgressShowPrev);
+    } else if (ShutdownRequested()) {
+        LogPrintf("Rescan interrupted by shutdown request. Progress=%d\n", dProgressShowPrev);
+    }
+
+    ShowProgress(_("Rescanning..."), 100);
+    return ret;
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1159,9 +1525,19 @@ bool CWalletTx::WriteToDisk()
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
+    // Let any queued wallet notifications land before re-reading history.
+    SyncWithValidationInterfaceQueue();
+
     int ret = 0;
     int64_t nNow = GetTime();
 
+    int nThreads = GetArg("-rescanthreads", 0);
+    if (nThreads <= 0)
+        nThreads = GetNumCores();
+    nThreads = std::max(1, std::min(nThreads, 16));
+    if (nThreads > 1)
+        return ScanForWalletTransactionsParallel(pindexStart, fUpdate, nThreads);
+
     CBlockIndex* pindex = pindexStart;
     {
         //LOCK2(cs_main, cs_wallet);
@@ -1233,6 +1609,8 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 
 void CWallet::ReacceptWalletTransactions()
 {
+    if (fReadOnly)
+        return;
     LOCK2(cs_main, cs_wallet);
     std::map<int64_t, CWalletTx*> mapSorted;
 
@@ -1343,21 +1721,117 @@ void CWallet::ResendWalletTransactions()
  */
 
 
-CAmount CWallet::GetBalance() const
+size_t CWallet::DynamicMemoryUsage() const
+{
+    LOCK(cs_wallet);
+    size_t nUsage = memusage::DynamicUsage(mapWallet) + memusage::DynamicUsage(mapAddressBook);
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        nUsage += RecursiveDynamicUsage(static_cast<const CTransaction&>(it->second));
+    nUsage += memusage::DynamicUsage(setWalletUTXO);
+    return nUsage;
+}
+
+CAmount CWallet::ComputeBalance(BalanceCacheKind kind) const
 {
+    AssertLockHeld(cs_wallet);
     CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+    if (kind == BAL_AVAILABLE) {
+        // Fully spent transactions contribute no available credit, so walking
+        // the unspent-output set visits exactly the transactions that matter.
+        uint256 lastTxid;
+        for (std::set<COutPoint>::const_iterator it = setWalletUTXO.begin(); it != setWalletUTXO.end(); ++it) {
+            if (it->hash == lastTxid)
+                continue;
+            lastTxid = it->hash;
+            map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(it->hash);
+            if (mi == mapWallet.end())
+                continue;
+            const CWalletTx* pcoin = &(*mi).second;
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableCredit();
         }
+        return nTotal;
+    }
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+        const CWalletTx* pcoin = &(*it).second;
+        switch (kind) {
+        case BAL_UNCONFIRMED:
+            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
+                nTotal += pcoin->GetAvailableCredit();
+            break;
+        case BAL_IMMATURE:
+            nTotal += pcoin->GetImmatureCredit();
+            break;
+        case BAL_WATCH_AVAILABLE:
+            if (pcoin->IsTrusted())
+                nTotal += pcoin->GetAvailableWatchOnlyCredit();
+            break;
+        case BAL_WATCH_UNCONFIRMED:
+            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
+                nTotal += pcoin->GetAvailableWatchOnlyCredit();
+            break;
+        case BAL_WATCH_IMMATURE:
+            nTotal += pcoin->GetImmatureWatchOnlyCredit();
+            break;
+        default:
+            break;
+        }
     }
+    return nTotal;
+}
+
+CAmount CWallet::GetCachedBalance(BalanceCacheKind kind) const
+{
+    const uint64_t nEpoch = nBalanceEpoch.load(std::memory_order_acquire);
+    if (nBalanceCacheEpoch[kind].load(std::memory_order_acquire) == nEpoch)
+        return nBalanceCache[kind].load(std::memory_order_relaxed);
 
+    CAmount nTotal;
+    {
+        LOCK2(cs_main, cs_wallet);
+        nTotal = ComputeBalance(kind);
+        nBalanceCache[kind].store(nTotal, std::memory_order_relaxed);
+        nBalanceCacheEpoch[kind].store(nEpoch, std::memory_order_release);
+    }
     return nTotal;
 }
 
+void CWallet::VerifyBalanceCaches() const
+{
+    // One aggregate per call, round-robin, so a run over all kinds is spread
+    // across several scheduler ticks instead of stalling the wallet at once.
+    static unsigned int nKindRotor = 0;
+    const BalanceCacheKind kind = (BalanceCacheKind)(nKindRotor++ % BAL_CACHE_KINDS);
+
+    const uint64_t nEpoch = nBalanceEpoch.load(std::memory_order_acquire);
+    if (nBalanceCacheEpoch[kind].load(std::memory_order_acquire) != nEpoch)
+        return; // nothing cached at this epoch; the next caller recomputes anyway
+    const CAmount nCached = nBalanceCache[kind].load(std::memory_order_relaxed);
+
+    CAmount nRecomputed;
+    {
+        TRY_LOCK(cs_main, lockMain);
+        if (!lockMain)
+            return;
+        TRY_LOCK(cs_wallet, lockWallet);
+        if (!lockWallet)
+            return;
+        if (nBalanceEpoch.load(std::memory_order_acquire) != nEpoch)
+            return; // wallet changed while we were acquiring the locks
+        nRecomputed = ComputeBalance(kind);
+    }
+    if (nRecomputed != nCached) {
+        LogPrintf("CWallet::VerifyBalanceCaches : cached aggregate %d is %s but recomputes to %s, invalidating\n",
+                  (int)kind, FormatMoney(nCached), FormatMoney(nRecomputed));
+        InvalidateBalanceCaches();
+    }
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetCachedBalance(BAL_AVAILABLE);
+}
+
 CAmount CWallet::GetAnonymizableBalance() const
 {
     CAmount nTotal = 0;
@@ -1531,71 +2005,27 @@ CAmount CWallet::GetDenominatedBalance(bool onlyDenom, bool onlyUnconfirmed) con
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetCachedBalance(BAL_UNCONFIRMED);
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetCachedBalance(BAL_IMMATURE);
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetCachedBalance(BAL_WATCH_AVAILABLE);
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetCachedBalance(BAL_WATCH_UNCONFIRMED);
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetCachedBalance(BAL_WATCH_IMMATURE);
 }
 
 /**
@@ -1603,58 +2033,148 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
  */
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl* coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseIX) const
 {
+    if (nCoinType == ONLY_DENOMINATED) {
+        // The denominated subset has its own bucket index.
+        AvailableDenominatedCoins(vCoins, fOnlyConfirmed, coinControl, fUseIX);
+        return;
+    }
+
     vCoins.clear();
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        // Walk the unspent-output set instead of the full history; the per-tx
+        // checks only run once per transaction with unspent outputs.
+        const CWalletTx* pcoin = NULL;
+        uint256 wtxid;
+        int nDepth = 0;
+        bool fSuitableTx = false;
+        for (std::set<COutPoint>::const_iterator it = setWalletUTXO.begin(); it != setWalletUTXO.end(); ++it) {
+            if (pcoin == NULL || it->hash != wtxid) {
+                wtxid = it->hash;
+                fSuitableTx = false;
+                map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(wtxid);
+                if (mi == mapWallet.end())
+                    continue;
+                pcoin = &(*mi).second;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                if (!CheckFinalTx(*pcoin))
+                    continue;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
+
+                if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
 
-            if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+                nDepth = pcoin->GetDepthInMainChain(false);
+                // do not use IX for inputs that have less then 6 blockchain confirmations
+                if (fUseIX && nDepth < 6)
+                    continue;
+
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !pcoin->InMempool())
+                    continue;
+
+                fSuitableTx = true;
+            }
+            if (!fSuitableTx)
                 continue;
 
-            const int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then 6 blockchain confirmations
-            if (fUseIX && nDepth < 6)
+            const unsigned int i = it->n;
+            if (i >= pcoin->vout.size())
                 continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
+            bool found = false;
+            if (nCoinType == ONLY_DENOMINATED) {
+                //should make this a vector
+                found = IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if (nCoinType == ONLY_NONDENOMINATED || nCoinType == ONLY_NONDENOMINATED_NOTMN) {
+                // Do not use collateral or denominated amounts.
+                found = !IsCollateralAmount(pcoin->vout[i].nValue);
+                if (found) found = !IsDenominatedAmount(pcoin->vout[i].nValue);
+                if (found && nCoinType == ONLY_NONDENOMINATED_NOTMN) // do not use Hot MN funds
+                    found = (pcoin->vout[i].nValue != GetMNCollateral(chainActive.Height()) * COIN);
+            } else {
+                found = true;
+            }
+            if (!found) continue;
+
+            isminetype mine = IsMine(pcoin->vout[i]);
+            if (mine && !(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+                !IsLockedCoin(wtxid, i) && pcoin->vout[i].nValue > 0 &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected(wtxid, i))) {
+                COutput output(pcoin, i, nDepth, mine);
+#               if defined(DEBUG_DUMP_STAKING_INFO)&&defined(DEBUG_DUMP_AvailableCoins_Coin)
+                DEBUG_DUMP_AvailableCoins_Coin();
+#               endif
+                vCoins.push_back(output);
+            }
+        }
+    }
+}
+
+void CWallet::AvailableDenominatedCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl* coinControl, bool fUseIX) const
+{
+    vCoins.clear();
+
+    {
+        LOCK2(cs_main, cs_wallet);
+        // Walk the per-denomination buckets (largest denomination first)
+        // instead of filtering the whole unspent set; outpoints in a bucket
+        // are sorted by txid, so the per-tx checks run once per transaction.
+        BOOST_FOREACH (int64_t d, darkSendDenominations) {
+            std::map<CAmount, std::set<COutPoint> >::const_iterator dit = mapDenomUTXO.find(d);
+            if (dit == mapDenomUTXO.end())
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if (nCoinType == ONLY_DENOMINATED) {
-                    //should make this a vector
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if (nCoinType == ONLY_NONDENOMINATED || nCoinType == ONLY_NONDENOMINATED_NOTMN) {
-                    // Do not use collateral or denominated amounts.
-                    found = !IsCollateralAmount(pcoin->vout[i].nValue);
-                    if (found) found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if (found && nCoinType == ONLY_NONDENOMINATED_NOTMN) // do not use Hot MN funds
-                        found = (pcoin->vout[i].nValue != GetMNCollateral(chainActive.Height()) * COIN);
-                } else {
-                    found = true;
+            const CWalletTx* pcoin = NULL;
+            uint256 wtxid;
+            int nDepth = 0;
+            bool fSuitableTx = false;
+            for (std::set<COutPoint>::const_iterator it = dit->second.begin(); it != dit->second.end(); ++it) {
+                if (pcoin == NULL || it->hash != wtxid) {
+                    wtxid = it->hash;
+                    fSuitableTx = false;
+                    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(wtxid);
+                    if (mi == mapWallet.end())
+                        continue;
+                    pcoin = &(*mi).second;
+
+                    if (!CheckFinalTx(*pcoin))
+                        continue;
+
+                    if (fOnlyConfirmed && !pcoin->IsTrusted())
+                        continue;
+
+                    if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+                        continue;
+
+                    nDepth = pcoin->GetDepthInMainChain(false);
+                    // do not use IX for inputs that have less then 6 blockchain confirmations
+                    if (fUseIX && nDepth < 6)
+                        continue;
+
+                    // We should not consider coins which aren't at least in our mempool
+                    // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                    if (nDepth == 0 && !pcoin->InMempool())
+                        continue;
+
+                    fSuitableTx = true;
                 }
-                if (!found) continue;
+                if (!fSuitableTx)
+                    continue;
+
+                const unsigned int i = it->n;
+                if (i >= pcoin->vout.size() || pcoin->vout[i].nValue != d)
+                    continue;
 
                 isminetype mine = IsMine(pcoin->vout[i]);
                 if (mine && !(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    !IsLockedCoin((*it).first, i) && pcoin->vout[i].nValue > 0 &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected((*it).first, i))) {
-                    COutput output(pcoin, i, nDepth, mine);
-#                   if defined(DEBUG_DUMP_STAKING_INFO)&&defined(DEBUG_DUMP_AvailableCoins_Coin)
-                    DEBUG_DUMP_AvailableCoins_Coin();
-#                   endif
-                    vCoins.push_back(output);
+                    !IsLockedCoin(wtxid, i) &&
+                    (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected(wtxid, i))) {
+                    vCoins.push_back(COutput(pcoin, i, nDepth, mine));
                 }
             }
         }
@@ -1667,71 +2187,182 @@ void CWallet::AvailableCoinsMN(vector<COutput>& vCoins, bool fOnlyConfirmed, con
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        const CWalletTx* pcoin = NULL;
+        uint256 wtxid;
+        int nDepth = 0;
+        bool fSuitableTx = false;
+        for (std::set<COutPoint>::const_iterator it = setWalletUTXO.begin(); it != setWalletUTXO.end(); ++it) {
+            if (pcoin == NULL || it->hash != wtxid) {
+                wtxid = it->hash;
+                fSuitableTx = false;
+                map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(wtxid);
+                if (mi == mapWallet.end())
+                    continue;
+                pcoin = &(*mi).second;
 
-            if (!IsFinalTx(*pcoin))
-                continue;
+                if (!IsFinalTx(*pcoin))
+                    continue;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+                if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
+
+                if (pcoin->IsCoinStake() && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
+
+                nDepth = pcoin->GetDepthInMainChain();
+                if (nDepth <= 0) // LuxNOTE: coincontrol fix / ignore 0 confirm
+                    continue;
+
+                // do not use IX for inputs that have less then 6 blockchain confirmations
+                if (useIX && nDepth < 6)
+                    continue;
+
+                fSuitableTx = true;
+            }
+            if (!fSuitableTx)
                 continue;
 
-            if (pcoin->IsCoinStake() && pcoin->GetBlocksToMaturity() > 0)
+            const unsigned int i = it->n;
+            if (i >= pcoin->vout.size())
                 continue;
 
-            const int nDepth = pcoin->GetDepthInMainChain();
-            if (nDepth <= 0) // LuxNOTE: coincontrol fix / ignore 0 confirm
+            bool found = false;
+            if(coin_type == ONLY_DENOMINATED) {
+                //should make this a vector
+                found = IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if(coin_type == ONLY_NONDENOMINATED || coin_type == ONLY_NONDENOMINATED_NOTMN) {
+                found = true;
+                if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
+                found = !IsDenominatedAmount(pcoin->vout[i].nValue);
+                if(found && coin_type == ONLY_NONDENOMINATED_NOTMN) found = (pcoin->vout[i].nValue != GetMNCollateral(chainActive.Height()) * COIN); // do not use MN funds
+            } else {
+                found = true;
+            }
+            if(!found) continue;
+
+            bool mine = IsMine(pcoin->vout[i]);
+
+            if (!(IsSpent(wtxid, i)) &&
+                !IsLockedCoin(wtxid, i) && pcoin->vout[i].nValue > 0 &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected(wtxid, i)))
+                vCoins.push_back(COutput(pcoin, i, nDepth, mine));
+        }
+    }
+}
+
+void CWallet::AvailableCoinsForDestination(const CTxDestination& dest, vector<COutput>& vCoins, bool fOnlyConfirmed) const
+{
+    vCoins.clear();
+
+    {
+        LOCK2(cs_main, cs_wallet);
+        // Walk only this destination's bucket; outpoints in a bucket are
+        // sorted by txid, so the per-tx checks run once per transaction.
+        std::map<CTxDestination, std::set<COutPoint> >::const_iterator ait = mapAddressUTXO.find(dest);
+        if (ait == mapAddressUTXO.end())
+            return;
+
+        const CWalletTx* pcoin = NULL;
+        uint256 wtxid;
+        int nDepth = 0;
+        bool fSuitableTx = false;
+        for (std::set<COutPoint>::const_iterator it = ait->second.begin(); it != ait->second.end(); ++it) {
+            if (pcoin == NULL || it->hash != wtxid) {
+                wtxid = it->hash;
+                fSuitableTx = false;
+                map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(wtxid);
+                if (mi == mapWallet.end())
+                    continue;
+                pcoin = &(*mi).second;
+
+                if (!CheckFinalTx(*pcoin))
+                    continue;
+
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
+
+                if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
+
+                nDepth = pcoin->GetDepthInMainChain(false);
+
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !pcoin->InMempool())
+                    continue;
+
+                fSuitableTx = true;
+            }
+            if (!fSuitableTx)
                 continue;
 
-            // do not use IX for inputs that have less then 6 blockchain confirmations
-            if (useIX && nDepth < 6)
+            const unsigned int i = it->n;
+            if (i >= pcoin->vout.size())
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if(coin_type == ONLY_DENOMINATED) {
-                    //should make this a vector
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if(coin_type == ONLY_NONDENOMINATED || coin_type == ONLY_NONDENOMINATED_NOTMN) {
-                    found = true;
-                    if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if(found && coin_type == ONLY_NONDENOMINATED_NOTMN) found = (pcoin->vout[i].nValue != GetMNCollateral(chainActive.Height()) * COIN); // do not use MN funds
-                } else {
-                    found = true;
-                }
-                if(!found) continue;
+            isminetype mine = IsMine(pcoin->vout[i]);
+            if (mine && !(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+                !IsLockedCoin(wtxid, i) && pcoin->vout[i].nValue > 0)
+                vCoins.push_back(COutput(pcoin, i, nDepth, mine));
+        }
+    }
+}
 
-                bool mine = IsMine(pcoin->vout[i]);
+void CWallet::FilterUnspentOutpoints(const std::set<CTxDestination>& destinations, CAmount nMinimumAmount, CAmount nMaximumAmount, int nMinDepth, int nMaxDepth, std::vector<COutPoint>& vOutpointsRet) const
+{
+    vOutpointsRet.clear();
 
-                if (!(IsSpent(wtxid, i)) &&
-                    !IsLockedCoin((*it).first, i) && pcoin->vout[i].nValue > 0 &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected((*it).first, i)))
-                    vCoins.push_back(COutput(pcoin, i, nDepth, mine));
-            }
+    LOCK2(cs_main, cs_wallet);
+    std::vector<const std::set<COutPoint>*> vSources;
+    if (!destinations.empty()) {
+        BOOST_FOREACH (const CTxDestination& dest, destinations) {
+            std::map<CTxDestination, std::set<COutPoint> >::const_iterator ait = mapAddressUTXO.find(dest);
+            if (ait != mapAddressUTXO.end())
+                vSources.push_back(&ait->second);
         }
+    } else {
+        vSources.push_back(&setWalletUTXO);
     }
+
+    BOOST_FOREACH (const std::set<COutPoint>* psource, vSources) {
+        BOOST_FOREACH (const COutPoint& outpoint, *psource) {
+            map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(outpoint.hash);
+            if (mi == mapWallet.end())
+                continue;
+            const CWalletTx& wtx = mi->second;
+            if (outpoint.n >= wtx.vout.size() || IsSpent(outpoint.hash, outpoint.n))
+                continue;
+            if (!(IsMine(wtx.vout[outpoint.n]) & ISMINE_ALL))
+                continue;
+            const CAmount& nValue = wtx.vout[outpoint.n].nValue;
+            if (nValue < nMinimumAmount || nValue > nMaximumAmount)
+                continue;
+            int nDepth = wtx.GetDepthInMainChain(false);
+            if (nDepth < nMinDepth || nDepth > nMaxDepth)
+                continue;
+            vOutpointsRet.push_back(outpoint);
+        }
+    }
+    std::sort(vOutpointsRet.begin(), vOutpointsRet.end());
 }
 
 map<CTxDestination, vector<COutput> > CWallet::AvailableCoinsByAddress(bool fConfirmed, CAmount maxCoinValue)
 {
-    vector<COutput> vCoins;
-    AvailableCoins(vCoins, fConfirmed);
-
     map<CTxDestination, vector<COutput> > mapCoins;
-    BOOST_FOREACH (COutput out, vCoins) {
-        if (maxCoinValue > 0 && out.tx->vout[out.i].nValue > maxCoinValue)
-            continue;
 
-        CTxDestination address;
-        if (!ExtractDestination(out.tx->vout[out.i].scriptPubKey, address))
-            continue;
+    LOCK2(cs_main, cs_wallet);
+    for (std::map<CTxDestination, std::set<COutPoint> >::const_iterator ait = mapAddressUTXO.begin(); ait != mapAddressUTXO.end(); ++ait) {
+        vector<COutput> vCoins;
+        AvailableCoinsForDestination(ait->first, vCoins, fConfirmed);
 
-        mapCoins[address].push_back(out);
+        BOOST_FOREACH (const COutput& out, vCoins) {
+            if (maxCoinValue > 0 && out.tx->vout[out.i].nValue > maxCoinValue)
+                continue;
+            mapCoins[ait->first].push_back(out);
+        }
     }
 
     return mapCoins;
@@ -1776,6 +2407,81 @@ static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*, un
     }
 }
 
+/**
+ * Branch and bound: depth-first search over the value-sorted (descending)
+ * candidate list for a subset whose total lands in
+ * [nTargetValue, nTargetValue + nCostOfChange], i.e. one that funds the
+ * payment without producing a change output.  The search prunes branches
+ * that cannot reach the target with the coins remaining and branches that
+ * overshoot the window, keeps the solution with the least excess over the
+ * target (the waste that would be burned to fee), and gives up after a
+ * fixed number of steps so pathological wallets fall back to the
+ * stochastic approximation above.
+ */
+static bool SelectCoinsBnB(const vector<pair<CAmount, pair<const CWalletTx*, unsigned int> > >& vValue, const CAmount& nTargetValue, const CAmount& nCostOfChange, vector<char>& vfBest, CAmount& nBest)
+{
+    static const int BNB_MAX_ITERATIONS = 100000;
+
+    // vRemaining[i] is the total value of vValue[i..end), used to prune
+    // subtrees that can no longer reach the target.
+    vector<CAmount> vRemaining(vValue.size() + 1, 0);
+    for (int i = (int)vValue.size() - 1; i >= 0; i--)
+        vRemaining[i] = vRemaining[i + 1] + vValue[i].first;
+
+    if (vRemaining[0] < nTargetValue)
+        return false;
+
+    vector<char> vfIncluded(vValue.size(), false);
+    bool fFoundBest = false;
+    nBest = 0;
+    CAmount nSelected = 0;
+    size_t nDepth = 0;
+
+    for (int nStep = 0; nStep < BNB_MAX_ITERATIONS; nStep++) {
+        bool fBacktrack = false;
+        if (nSelected + vRemaining[nDepth] < nTargetValue) {
+            fBacktrack = true; // cannot reach the target from here
+        } else if (nSelected > nTargetValue + nCostOfChange) {
+            fBacktrack = true; // overshot the changeless window
+        } else if (nSelected >= nTargetValue) {
+            // Inside the window; adding more coins only increases the waste.
+            if (!fFoundBest || nSelected < nBest) {
+                fFoundBest = true;
+                nBest = nSelected;
+                vfBest.assign(vValue.size(), false);
+                for (size_t i = 0; i < nDepth; i++)
+                    vfBest[i] = vfIncluded[i];
+                if (nBest == nTargetValue)
+                    break; // perfect match, nothing can beat this
+            }
+            fBacktrack = true;
+        } else if (nDepth >= vValue.size()) {
+            fBacktrack = true;
+        } else {
+            // Explore the inclusion branch first.
+            vfIncluded[nDepth] = true;
+            nSelected += vValue[nDepth].first;
+            nDepth++;
+            continue;
+        }
+
+        if (fBacktrack) {
+            // Walk back to the most recent included coin and take its
+            // exclusion branch instead.
+            while (nDepth > 0 && !vfIncluded[nDepth - 1])
+                nDepth--;
+            if (nDepth == 0)
+                break; // whole tree explored
+            nDepth--;
+            vfIncluded[nDepth] = false;
+            nSelected -= vValue[nDepth].first;
+            nDepth++;
+        }
+    }
+
+    return fFoundBest;
+}
+
 
 // TODO: find appropriate place for this sort function
 // move denoms down
@@ -1887,11 +2593,29 @@ bool CWallet::SelectCoinsMinConf(const std::string &account, const CAmount& nTar
         break;
     }
 
-    // Solve subset sum by stochastic approximation
     sort(vValue.rbegin(), vValue.rend(), CompareValueOnly());
     vector<char> vfBest;
     CAmount nBest;
 
+    // Try branch and bound first: an exact subset within CENT of the target
+    // needs no change output, which keeps the UTXO set small and saves the
+    // fee for the change output in a later spend.
+    if (SelectCoinsBnB(vValue, nTargetValue, CENT, vfBest, nBest)) {
+        // Anything in coinLowestLarger is at least nTargetValue + CENT, so
+        // the branch-and-bound solution always has less excess.
+        string s = "CWallet::SelectCoinsMinConf branch-and-bound subset: ";
+        for (unsigned int i = 0; i < vValue.size(); i++) {
+            if (vfBest[i]) {
+                setCoinsRet.insert(vValue[i].second);
+                nValueRet += vValue[i].first;
+                s += FormatMoney(vValue[i].first) + " ";
+            }
+        }
+        LogPrintf("%s - total %s\n", s, FormatMoney(nBest));
+        return true;
+    }
+
+    // Solve subset sum by stochastic approximation
     ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest, 1000);
     if (nBest != nTargetValue && nTotalLower >= nTargetValue + CENT)
         ApproximateBestSubset(vValue, nTotalLower, nTargetValue + CENT, vfBest, nBest, 1000);
@@ -2315,12 +3039,41 @@ OutputType CWallet::TransactionChangeType(const std::vector<std::pair<CScript, C
     return g_address_type;
 }
 
+/**
+ * Worker for the parallel signing stage of CreateTransaction: inputs are
+ * claimed with an atomic counter and signed independently. Only reads the
+ * const transaction and the wallet keystore (which takes cs_KeyStore per
+ * key fetch), so workers never contend on cs_wallet.
+ */
+static void SignTransactionWorker(const CWallet* pwallet, const CTransaction* ptxConst,
+                                  const std::vector<std::pair<const CWalletTx*, unsigned int> >* pvCoins,
+                                  std::vector<SignatureData>* pvSigData,
+                                  std::atomic<unsigned int>* pnNext, std::atomic<bool>* pfFailed)
+{
+    RenameThread("lux-sign");
+    while (!pfFailed->load()) {
+        unsigned int nIn = pnNext->fetch_add(1);
+        if (nIn >= pvCoins->size())
+            break;
+        const CWalletTx* pcoin = (*pvCoins)[nIn].first;
+        unsigned int n = (*pvCoins)[nIn].second;
+        if (!ProduceSignature(TransactionSignatureCreator(pwallet, ptxConst, nIn, pcoin->vout[n].nValue, SIGHASH_ALL),
+                              pcoin->vout[n].scriptPubKey, (*pvSigData)[nIn]))
+            pfFailed->store(true);
+    }
+}
+
 bool CWallet::CreateTransaction(const vector<pair<CScript, CAmount> >& vecSend, CWalletTx& wtxNew, CReserveKey& reservekey, CAmount& nFeeRet, std::string& strFailReason, const CCoinControl* coinControl, AvailableCoinsType coin_type, bool useIX, CAmount nFeePay, CAmount nGasFee)
 {
 #   if defined(DEBUG_DUMP_STAKING_INFO) && defined(DEBUG_DUMP_CreateTransaction_1)
     DEBUG_DUMP_CreateTransaction_1();
 #   endif
 
+    if (fReadOnly) {
+        strFailReason = _("Wallet is opened in read-only mode");
+        return false;
+    }
+
     if (useIX && nFeePay < CENT) nFeePay = CENT;
 
     CAmount nValue = 0;
@@ -2506,22 +3259,31 @@ bool CWallet::CreateTransaction(const vector<pair<CScript, CAmount> >& vecSend,
                 BOOST_FOREACH (const PAIRTYPE(const CWalletTx*, unsigned int) & coin, setCoins)
                     txNew.vin.push_back(CTxIn(coin.first->GetHash(), coin.second));
 
-                // Sign
-                int nIn = 0;
+                // Sign. Each input is independent, so consolidation
+                // transactions with hundreds of inputs are signed across a
+                // worker pool; the scriptSigs are applied in input order
+                // afterwards.
                 CTransaction txNewConst(txNew);
-                BOOST_FOREACH (const PAIRTYPE(const CWalletTx*, unsigned int) & coin, setCoins) {
-                    bool signSuccess;
-                    const CScript& scriptPubKey = coin.first->vout[coin.second].scriptPubKey;
-                    SignatureData sigdata;
-                    signSuccess = ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, coin.first->vout[coin.second].nValue, SIGHASH_ALL), scriptPubKey, sigdata);
-                    if (!signSuccess) {
-                        strFailReason = _("Signing transaction failed");
-                        return false;
-                    } else {
-                        UpdateTransaction(txNew, nIn, sigdata);
-                    }
-                    nIn++;
+                std::vector<std::pair<const CWalletTx*, unsigned int> > vSignCoins(setCoins.begin(), setCoins.end());
+                std::vector<SignatureData> vSigData(vSignCoins.size());
+                std::atomic<unsigned int> nNextIn(0);
+                std::atomic<bool> fSignFailed(false);
+                int nSignThreads = std::min((int)vSignCoins.size() / 4, GetNumCores());
+                if (nSignThreads > 1) {
+                    boost::thread_group signGroup;
+                    for (int i = 0; i < nSignThreads - 1; i++)
+                        signGroup.create_thread(boost::bind(SignTransactionWorker, this, &txNewConst, &vSignCoins, &vSigData, &nNextIn, &fSignFailed));
+                    SignTransactionWorker(this, &txNewConst, &vSignCoins, &vSigData, &nNextIn, &fSignFailed);
+                    signGroup.join_all();
+                } else {
+                    SignTransactionWorker(this, &txNewConst, &vSignCoins, &vSigData, &nNextIn, &fSignFailed);
+                }
+                if (fSignFailed.load()) {
+                    strFailReason = _("Signing transaction failed");
+                    return false;
                 }
+                for (unsigned int nIn = 0; nIn < vSignCoins.size(); nIn++)
+                    UpdateTransaction(txNew, nIn, vSigData[nIn]);
 
                 // Embed the constructed transaction data in wtxNew.
                 *static_cast<CTransaction*>(&wtxNew) = CTransaction(txNew);
@@ -2580,6 +3342,10 @@ bool CWallet::CreateTransaction(CScript scriptPubKey, const CAmount& nValue, CWa
  */
 bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey, std::string strCommand)
 {
+    if (fReadOnly) {
+        LogPrintf("CommitTransaction() : refused, wallet is read-only\n");
+        return false;
+    }
     {
         LOCK2(cs_main, cs_wallet);
 #       if defined(DEBUG_DUMP_STAKING_INFO)&&defined(DEBUG_DUMP_CommitTransaction)
@@ -2613,6 +3379,11 @@ bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey, std:
                 delete pwalletdb;
         }
 
+        // Durability barrier: the signed transaction is about to be
+        // broadcast, so force any journalled wallet writes to disk first.
+        if (fFileBacked)
+            DBFlushBarrier();
+
         // Track how many getdata requests our transaction gets
         mapRequestCount[wtxNew.GetHash()] = 0;
 
@@ -2845,6 +3616,8 @@ DBErrors CWallet::ZapWalletTx(std::vector<CWalletTx>& vWtx)
 
 bool CWallet::SetAddressBook(const CTxDestination& address, const string& strName, const string& strPurpose)
 {
+    if (fReadOnly)
+        return false;
     bool fUpdated = false;
     {
         LOCK(cs_wallet); // mapAddressBook
@@ -2865,6 +3638,8 @@ bool CWallet::SetAddressBook(const CTxDestination& address, const string& strNam
 
 bool CWallet::DelAddressBook(const CTxDestination& address)
 {
+    if (fReadOnly)
+        return false;
     {
         LOCK(cs_wallet); // mapAddressBook
 
@@ -2958,7 +3733,7 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
     {
         LOCK(cs_wallet);
 
-        if (IsLocked())
+        if (IsLocked() || fReadOnly)
             return false;
 
         // Top up key pool
@@ -3803,10 +4578,24 @@ int CMerkleTx::GetDepthInMainChainINTERNAL(const CBlockIndex*& pindexRet) const
         return 0;
     AssertLockHeld(cs_main);
 
+    // Depth only changes when the tip (or the tx's recorded block) does;
+    // answer repeated queries from the per-tx cache.
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    if (pindexTip != NULL && pindexCachedTip == pindexTip && hashCachedBlock == hashBlock) {
+        if (nCachedDepth > 0)
+            pindexRet = pindexCachedBlock;
+        return nCachedDepth;
+    }
+
     // Find the block it claims to be in
     CBlockIndex* pindex = LookupBlockIndex(hashBlock);
-    if (!pindex || !chainActive.Contains(pindex))
+    if (!pindex || !chainActive.Contains(pindex)) {
+        pindexCachedTip = pindexTip;
+        pindexCachedBlock = NULL;
+        hashCachedBlock = hashBlock;
+        nCachedDepth = 0;
         return 0;
+    }
 
     // Make sure the merkle branch connects to this block
     if (!fMerkleVerified) {
@@ -3815,8 +4604,12 @@ int CMerkleTx::GetDepthInMainChainINTERNAL(const CBlockIndex*& pindexRet) const
         fMerkleVerified = true;
     }
 
+    pindexCachedTip = pindexTip;
+    pindexCachedBlock = pindex;
+    hashCachedBlock = hashBlock;
+    nCachedDepth = chainActive.Height() - pindex->nHeight + 1;
     pindexRet = pindex;
-    return chainActive.Height() - pindex->nHeight + 1;
+    return nCachedDepth;
 }
 
 int CMerkleTx::GetDepthInMainChain(const CBlockIndex*& pindexRet, bool enableIX) const
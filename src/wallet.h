@@ -195,6 +195,15 @@ public:
     // memory only
     mutable bool fMerkleVerified;
 
+    // memory only: cached GetDepthInMainChain result, valid while the chain
+    // tip and the tx's recorded block stay the same. Depth queries run per
+    // staking round, coin selection and balance sum; the cache answers the
+    // repeats without a block-index lookup.
+    mutable const CBlockIndex* pindexCachedTip;
+    mutable const CBlockIndex* pindexCachedBlock;
+    mutable uint256 hashCachedBlock;
+    mutable int nCachedDepth;
+
 
     CMerkleTx()
     {
@@ -211,6 +220,10 @@ public:
         hashBlock = 0;
         nIndex = -1;
         fMerkleVerified = false;
+        pindexCachedTip = NULL;
+        pindexCachedBlock = NULL;
+        hashCachedBlock = 0;
+        nCachedDepth = 0;
     }
 
     ADD_SERIALIZE_METHODS;
@@ -288,6 +301,74 @@ class CWallet : public CCryptoKeyStore, public CValidationInterface
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
+    /**
+     * Outpoints of our own outputs that no wallet transaction has been seen
+     * spending yet.  Maintained by AddToWallet/AddToSpends and rebuilt by
+     * MarkDirty (key imports change what counts as ours), so AvailableCoins
+     * and GetBalance walk the unspent set instead of the whole history.
+     * Entries can go stale and are re-checked with IsSpent/IsMine on use.
+     */
+    std::set<COutPoint> setWalletUTXO;
+    //! Bumped whenever setWalletUTXO changes; lets the staking code detect
+    //! that its cached candidate set is stale without rescanning the wallet.
+    uint64_t nUTXOSetGeneration;
+    void RebuildWalletUTXOSet();
+
+    /**
+     * The subset of setWalletUTXO holding an exact darksend denomination,
+     * bucketed by denomination value and maintained in the same places, so
+     * each mixing round only looks at the outputs it could actually use
+     * instead of filtering the whole unspent set.
+     */
+    std::map<CAmount, std::set<COutPoint> > mapDenomUTXO;
+
+    /**
+     * setWalletUTXO bucketed by output destination, maintained in the same
+     * places, so address-scoped queries (coin control's grouped view, the
+     * payout scripts) touch only the outputs of the address they ask about
+     * instead of extracting the destination of every unspent output.
+     * Outputs whose script has no extractable destination are not indexed.
+     */
+    std::map<CTxDestination, std::set<COutPoint> > mapAddressUTXO;
+
+    /**
+     * Balance aggregates cached across GUI polls.  nBalanceEpoch is bumped
+     * by everything that can change an aggregate (transaction added or
+     * erased, MarkDirty, a new chain tip); a getter whose cached epoch
+     * still matches returns its stored total without taking cs_wallet, so
+     * the periodic balance poll costs nothing while the wallet is idle.
+     */
+    enum BalanceCacheKind {
+        BAL_AVAILABLE = 0,
+        BAL_UNCONFIRMED,
+        BAL_IMMATURE,
+        BAL_WATCH_AVAILABLE,
+        BAL_WATCH_UNCONFIRMED,
+        BAL_WATCH_IMMATURE,
+        BAL_CACHE_KINDS
+    };
+    mutable std::atomic<uint64_t> nBalanceEpoch;
+    mutable std::atomic<uint64_t> nBalanceCacheEpoch[BAL_CACHE_KINDS];
+    mutable std::atomic<CAmount> nBalanceCache[BAL_CACHE_KINDS];
+    void InvalidateBalanceCaches() const { nBalanceEpoch.fetch_add(1, std::memory_order_release); }
+    CAmount ComputeBalance(BalanceCacheKind kind) const;
+    CAmount GetCachedBalance(BalanceCacheKind kind) const;
+
+    /**
+     * Precomputed set of scriptPubKeys we are involved in: P2PK and P2PKH
+     * for every key, the P2SH wrapper of every stored script and every
+     * watch-only script, each mapped to its isminetype.  IsMine probes this
+     * for common script shapes instead of running the script solver on every
+     * output of every incoming transaction; rare shapes (bare multisig,
+     * nonstandard, witness) still take the solver.  Guarded by cs_scriptCache
+     * and rebuilt lazily after any key store change.
+     */
+    mutable CCriticalSection cs_scriptCache;
+    mutable std::map<CScript, isminetype> mapScriptIsMine;
+    mutable bool fScriptCacheDirty;
+    void MarkScriptCacheDirty() const;
+    void RebuildScriptCache() const;
+
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
 public:
@@ -314,6 +395,11 @@ public:
     mutable CCriticalSection cs_wallet;
 
     bool fFileBacked;
+    //! Opened as an immutable query-only snapshot (-walletreadonly). Every
+    //! write path refuses, the wallet is not registered for chain
+    //! notifications and no background maintenance runs, so nothing mutates
+    //! it after load and query RPCs never wait on a writer holding cs_wallet.
+    bool fReadOnly;
     bool fWalletUnlockAnonymizeOnly;
     std::string strWalletFile;
 
@@ -367,6 +453,7 @@ public:
         nWalletVersion = FEATURE_BASE;
         nWalletMaxVersion = FEATURE_BASE;
         fFileBacked = false;
+        fReadOnly = false;
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
         nOrderPosNext = 0;
@@ -374,6 +461,11 @@ public:
         nLastResend = 0;
         nTimeFirstKey = 0;
         fWalletUnlockAnonymizeOnly = false;
+        fScriptCacheDirty = true;
+        nUTXOSetGeneration = 0;
+        nBalanceEpoch = 1;
+        for (int i = 0; i < BAL_CACHE_KINDS; i++)
+            nBalanceCacheEpoch[i] = 0;
 
         //MultiSend
         vMultiSend.clear();
@@ -429,7 +521,16 @@ public:
     }
 
     void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed = true, const CCoinControl* coinControl = NULL, bool fIncludeZeroValue = false, AvailableCoinsType nCoinType = ALL_COINS, bool fUseIX = false) const;
+    //! ONLY_DENOMINATED selection via the per-denomination buckets (largest denomination first).
+    void AvailableDenominatedCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed = true, const CCoinControl* coinControl = NULL, bool fUseIX = false) const;
     void AvailableCoinsMN(std::vector<COutput>& vCoins, bool fOnlyConfirmed=true, const CCoinControl *coinControl = NULL, AvailableCoinsType coin_type=ALL_COINS, bool useIX = false) const;
+    //! Spendable outputs of a single destination via the per-address buckets; O(outputs of that address).
+    void AvailableCoinsForDestination(const CTxDestination& dest, std::vector<COutput>& vCoins, bool fOnlyConfirmed = true) const;
+    //! Filtered outpoint enumeration over the UTXO index: destination set
+    //! (empty = every destination), amount range and depth range are all
+    //! applied here, so callers paging through a large wallet never touch
+    //! outputs their filter rejects.  Result is sorted by outpoint.
+    void FilterUnspentOutpoints(const std::set<CTxDestination>& destinations, CAmount nMinimumAmount, CAmount nMaximumAmount, int nMinDepth, int nMaxDepth, std::vector<COutPoint>& vOutpointsRet) const;
     std::map<CTxDestination, std::vector<COutput> > AvailableCoinsByAddress(bool fConfirmed = true, CAmount maxCoinValue = 0);
     bool SelectCoinsMinConf(const std::string &account, const CAmount& nTargetValue, int nConfMine, int nConfTheirs, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*, unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
 
@@ -461,7 +562,11 @@ public:
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey& pubkey);
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
-    bool LoadKey(const CKey& key, const CPubKey& pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
+    bool LoadKey(const CKey& key, const CPubKey& pubkey)
+    {
+        MarkScriptCacheDirty();
+        return CCryptoKeyStore::AddKeyPubKey(key, pubkey);
+    }
     //! Load metadata (used by LoadWallet)
     bool LoadKeyMetadata(const CPubKey& pubkey, const CKeyMetadata& metadata);
 
@@ -531,9 +636,19 @@ public:
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    int ScanForWalletTransactionsParallel(CBlockIndex* pindexStart, bool fUpdate, int nThreads);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions();
+    uint64_t GetUTXOSetGeneration() const;
+    //! Current balance-cache epoch; lock-free, for the GUI's balance poll.
+    uint64_t GetBalanceEpoch() const { return nBalanceEpoch.load(std::memory_order_acquire); }
+    //! Scheduled cross-check of one cached balance aggregate against a full
+    //! recomputation; a mismatch means an invalidation was missed somewhere.
+    void VerifyBalanceCaches() const;
     CAmount GetBalance() const;
+    //! Approximate dynamic memory usage of the in-memory wallet maps
+    //! (diagnostics only; walks every transaction).
+    size_t DynamicMemoryUsage() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
     CAmount GetAnonymizableBalance() const;
@@ -604,7 +719,8 @@ public:
     bool IsDenominatedAmount(int64_t nInputAmount) const;
 
     isminetype IsMine(const CTxIn& txin) const;
-    isminetype IsMine(const CTxOut& txout) const { return ::IsMine(*this, txout.scriptPubKey); }
+    isminetype IsMine(const CTxOut& txout) const { return IsMineCached(txout.scriptPubKey); }
+    isminetype IsMineCached(const CScript& scriptPubKey) const;
     bool IsMine(const CTransaction& tx) const
     {
         BOOST_FOREACH (const CTxOut& txout, tx.vout)
@@ -322,7 +322,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
         if (ret == DB_NOTFOUND)
             break;
         else if (ret != 0) {
-            pcursor->close();
+            CloseCursor(pcursor);
             throw runtime_error("CWalletDB::ListAccountCreditDebit() : error scanning DB");
         }
 
@@ -341,7 +341,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
         entries.push_back(acentry);
     }
 
-    pcursor->close();
+    CloseCursor(pcursor);
 }
 
 DBErrors CWalletDB::ReorderTransactions(CWallet* pwallet)
@@ -776,7 +776,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             if (!strErr.empty())
                 LogPrintf("%s\n", strErr);
         }
-        pcursor->close();
+        CloseCursor(pcursor);
     } catch (boost::thread_interrupted) {
         throw;
     } catch (...) {
@@ -863,7 +863,7 @@ DBErrors CWalletDB::FindWalletTx(CWallet* pwallet, vector<uint256>& vTxHash, vec
                 vWtx.push_back(wtx);
             }
         }
-        pcursor->close();
+        CloseCursor(pcursor);
     } catch (boost::thread_interrupted) {
         throw;
     } catch (...) {
@@ -948,10 +948,33 @@ void ThreadFlushWalletDB(const string& strFile)
     }
 }
 
-bool BackupWallet(const CWallet& wallet, const string& strDest)
+bool BackupWallet(const CWallet& wallet, const string& strDest, bool fIncremental)
 {
     if (!wallet.fFileBacked)
         return false;
+
+    // Append-log wallets have no environment to quiesce, and their backups
+    // can be brought up to date by appending only the new tail — see
+    // CWalletRecordLog::BackupTo. Either way the destination stays a
+    // complete, directly loadable wallet file.
+    {
+        filesystem::path pathSrc = GetDataDir() / wallet.strWalletFile;
+        if (CWalletRecordLog::IsLogFile(pathSrc.string())) {
+            CWalletRecordLog* plog = CWalletRecordLog::Get(wallet.strWalletFile);
+
+            filesystem::path pathDest(strDest);
+            if (filesystem::is_directory(pathDest))
+                pathDest /= wallet.strWalletFile;
+            bool fOk = plog->BackupTo(pathDest.string(), fIncremental);
+            plog->Release();
+            if (fOk)
+                LogPrintf("copied %s to %s\n", wallet.strWalletFile, pathDest.string());
+            else
+                LogPrintf("error copying %s to %s\n", wallet.strWalletFile, pathDest.string());
+            return fOk;
+        }
+    }
+
     while (true) {
         {
             LOCK(bitdb.cs_db);
@@ -194,7 +194,7 @@ private:
     bool WriteAccountingEntry(const uint64_t nAccEntryNum, const CAccountingEntry& acentry);
 };
 
-bool BackupWallet(const CWallet& wallet, const std::string& strDest);
+bool BackupWallet(const CWallet& wallet, const std::string& strDest, bool fIncremental = false);
 
 void MaybeFlushWalletDB();
 
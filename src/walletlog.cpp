@@ -0,0 +1,598 @@
+// Copyright (c) 2015-2018 The LUX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "walletlog.h"
+
+#include "hash.h"
+#include "random.h"
+#include "util.h"
+
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+
+using namespace std;
+
+//! File magic; the trailing byte is the format version.
+static const unsigned char LOG_MAGIC[8] = {'L', 'U', 'X', 'W', 'L', 'O', 'G', 1};
+
+static const unsigned char LOG_OP_WRITE = 1;
+static const unsigned char LOG_OP_ERASE = 2;
+//! Backup marker: empty key, 8 random bytes as value; no effect on the map.
+static const unsigned char LOG_OP_MARK = 3;
+
+static const size_t LOG_MARKER_ID_BYTES = 8;
+
+//! Compact the file once more than half of it is dead weight (and it is
+//! big enough for the rewrite to matter).
+static const size_t LOG_COMPACT_MIN_BYTES = 1 << 20;
+
+static CCriticalSection cs_walletLogs;
+static map<string, CWalletRecordLog*> mapWalletLogs;
+
+static unsigned int LogChecksum(const unsigned char* p, size_t n)
+{
+    return MurmurHash3(0x574c4f47 /*WLOG*/, vector<unsigned char>(p, p + n));
+}
+
+static void WriteLE32Buf(unsigned char* p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static uint32_t ReadLE32Buf(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+//! op + key length + value length + payloads + checksum
+static size_t RecordSize(size_t nKeyLen, size_t nValueLen)
+{
+    return 1 + 4 + 4 + nKeyLen + nValueLen + 4;
+}
+
+CWalletRecordLog::CWalletRecordLog(const string& strFileIn)
+    : strFile(strFileIn), file(NULL), nFileBytes(0), nObsoleteBytes(0), nUseCount(0), fTxnActive(false)
+{
+}
+
+string CWalletRecordLog::GetPath() const
+{
+    return (GetDataDir() / strFile).string();
+}
+
+bool CWalletRecordLog::IsLogFile(const string& strPath)
+{
+    FILE* f = fopen(strPath.c_str(), "rb");
+    if (!f)
+        return false;
+    unsigned char magic[sizeof(LOG_MAGIC)];
+    bool fMatch = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                  memcmp(magic, LOG_MAGIC, sizeof(magic)) == 0;
+    fclose(f);
+    return fMatch;
+}
+
+CWalletRecordLog* CWalletRecordLog::Get(const string& strFile)
+{
+    LOCK(cs_walletLogs);
+    CWalletRecordLog*& plog = mapWalletLogs[strFile];
+    if (plog == NULL)
+        plog = new CWalletRecordLog(strFile);
+    {
+        LOCK(plog->cs_log);
+        plog->nUseCount++;
+    }
+    return plog;
+}
+
+bool CWalletRecordLog::LoadFile(string& strError)
+{
+    const string strPath = GetPath();
+    mapRecords.clear();
+    nFileBytes = 0;
+    nObsoleteBytes = 0;
+
+    const unsigned char* pBuf = NULL;
+    size_t nLen = 0;
+    vector<unsigned char> vFallback;
+#ifndef WIN32
+    void* pMap = MAP_FAILED;
+    int fd = open(strPath.c_str(), O_RDONLY);
+    if (fd == -1) {
+        strError = strprintf("cannot open wallet log %s", strPath);
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        strError = strprintf("cannot stat wallet log %s", strPath);
+        return false;
+    }
+    nLen = sb.st_size;
+    if (nLen > 0) {
+        pMap = mmap(NULL, nLen, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pMap != MAP_FAILED)
+            pBuf = (const unsigned char*)pMap;
+    }
+    close(fd);
+#endif
+    if (pBuf == NULL && nLen > 0) {
+        // mmap unavailable: fall back to one sequential read
+        FILE* f = fopen(strPath.c_str(), "rb");
+        if (!f) {
+            strError = strprintf("cannot open wallet log %s", strPath);
+            return false;
+        }
+        vFallback.resize(nLen);
+        if (fread(&vFallback[0], 1, nLen, f) != nLen) {
+            fclose(f);
+            strError = strprintf("cannot read wallet log %s", strPath);
+            return false;
+        }
+        fclose(f);
+        pBuf = &vFallback[0];
+    }
+
+    bool fOk = true;
+    size_t nGoodOffset = 0;
+    if (nLen < sizeof(LOG_MAGIC) || memcmp(pBuf, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) {
+        strError = strprintf("wallet log %s has a bad header", strPath);
+        fOk = false;
+    } else {
+        size_t nPos = sizeof(LOG_MAGIC);
+        nGoodOffset = nPos;
+        while (nPos < nLen) {
+            if (nLen - nPos < 1 + 4 + 4)
+                break; // partial trailing record (interrupted write)
+            const unsigned char nOp = pBuf[nPos];
+            const uint32_t nKeyLen = ReadLE32Buf(pBuf + nPos + 1);
+            const uint32_t nValueLen = ReadLE32Buf(pBuf + nPos + 5);
+            const size_t nRecSize = RecordSize(nKeyLen, nValueLen);
+            if (nOp != LOG_OP_WRITE && nOp != LOG_OP_ERASE && nOp != LOG_OP_MARK)
+                break;
+            if (nRecSize > nLen - nPos)
+                break;
+            const unsigned int nCheck = ReadLE32Buf(pBuf + nPos + nRecSize - 4);
+            if (nCheck != LogChecksum(pBuf + nPos, nRecSize - 4))
+                break;
+            LogKey key(pBuf + nPos + 9, pBuf + nPos + 9 + nKeyLen);
+            LogValue value(pBuf + nPos + 9 + nKeyLen, pBuf + nPos + 9 + nKeyLen + nValueLen);
+            ApplyOp(nOp, key, value, nRecSize);
+            nPos += nRecSize;
+            nGoodOffset = nPos;
+        }
+        if (nGoodOffset != nLen)
+            LogPrintf("CWalletRecordLog : %s has %u trailing bytes after the last valid record, truncating\n",
+                strFile, (unsigned int)(nLen - nGoodOffset));
+        nFileBytes = nGoodOffset;
+    }
+
+#ifndef WIN32
+    if (pMap != MAP_FAILED)
+        munmap(pMap, nLen);
+#endif
+    if (!fOk)
+        return false;
+
+    if (nGoodOffset != nLen) {
+        // Drop the partial record so the append handle starts on a boundary
+        boost::filesystem::resize_file(strPath, nGoodOffset);
+    }
+    return true;
+}
+
+bool CWalletRecordLog::Open(bool fCreate, string& strError)
+{
+    LOCK(cs_log);
+    if (file != NULL)
+        return true; // already open via another CDB instance
+
+    const string strPath = GetPath();
+    if (!boost::filesystem::exists(strPath)) {
+        if (!fCreate) {
+            strError = strprintf("wallet log %s does not exist", strPath);
+            return false;
+        }
+        FILE* f = fopen(strPath.c_str(), "wb");
+        if (!f || fwrite(LOG_MAGIC, 1, sizeof(LOG_MAGIC), f) != sizeof(LOG_MAGIC)) {
+            if (f)
+                fclose(f);
+            strError = strprintf("cannot create wallet log %s", strPath);
+            return false;
+        }
+        FileCommit(f);
+        fclose(f);
+        mapRecords.clear();
+        nFileBytes = sizeof(LOG_MAGIC);
+        nObsoleteBytes = 0;
+    } else if (!LoadFile(strError)) {
+        return false;
+    }
+
+    file = fopen(strPath.c_str(), "ab");
+    if (!file) {
+        strError = strprintf("cannot open wallet log %s for append", strPath);
+        return false;
+    }
+    LogPrint("db", "CWalletRecordLog : opened %s, %u records, %u bytes (%u obsolete)\n",
+        strFile, (unsigned int)mapRecords.size(), (unsigned int)nFileBytes, (unsigned int)nObsoleteBytes);
+    return true;
+}
+
+void CWalletRecordLog::ApplyOp(unsigned char nOp, const LogKey& key, const LogValue& value, size_t nDiskSize)
+{
+    if (nOp == LOG_OP_MARK) {
+        // Markers carry no data; they are dead weight for compaction purposes
+        nObsoleteBytes += nDiskSize;
+        return;
+    }
+    map<LogKey, LogRecord>::iterator it = mapRecords.find(key);
+    if (nOp == LOG_OP_WRITE) {
+        if (it != mapRecords.end())
+            nObsoleteBytes += it->second.nDiskSize;
+        LogRecord& rec = mapRecords[key];
+        rec.value = value;
+        rec.nDiskSize = nDiskSize;
+    } else {
+        if (it != mapRecords.end()) {
+            nObsoleteBytes += it->second.nDiskSize;
+            mapRecords.erase(it);
+        }
+        // The erase record itself is dead weight as soon as it lands
+        nObsoleteBytes += nDiskSize;
+    }
+}
+
+bool CWalletRecordLog::AppendOp(unsigned char nOp, const LogKey& key, const LogValue& value)
+{
+    const size_t nRecSize = RecordSize(key.size(), value.size());
+    vector<unsigned char> vRec(nRecSize);
+    vRec[0] = nOp;
+    WriteLE32Buf(&vRec[1], key.size());
+    WriteLE32Buf(&vRec[5], value.size());
+    if (!key.empty())
+        memcpy(&vRec[9], &key[0], key.size());
+    if (!value.empty())
+        memcpy(&vRec[9 + key.size()], &value[0], value.size());
+    WriteLE32Buf(&vRec[nRecSize - 4], LogChecksum(&vRec[0], nRecSize - 4));
+
+    bool fOk = fwrite(&vRec[0], 1, nRecSize, file) == nRecSize && fflush(file) == 0;
+    // Clear memory in case it was a private key
+    memset(&vRec[0], 0, nRecSize);
+    if (fOk)
+        nFileBytes += nRecSize;
+    return fOk;
+}
+
+bool CWalletRecordLog::Read(const LogKey& key, LogValue& value) const
+{
+    LOCK(cs_log);
+    map<LogKey, LogRecord>::const_iterator it = mapRecords.find(key);
+    if (it == mapRecords.end())
+        return false;
+    value = it->second.value;
+    return true;
+}
+
+bool CWalletRecordLog::Exists(const LogKey& key) const
+{
+    LOCK(cs_log);
+    return mapRecords.count(key) != 0;
+}
+
+bool CWalletRecordLog::Write(const LogKey& key, const LogValue& value, bool fOverwrite)
+{
+    LOCK(cs_log);
+    if (file == NULL)
+        return false;
+    if (!fOverwrite && mapRecords.count(key))
+        return false;
+    if (fTxnActive) {
+        LogOp op;
+        op.nOp = LOG_OP_WRITE;
+        op.key = key;
+        op.value = value;
+        vTxnOps.push_back(op);
+    } else if (!AppendOp(LOG_OP_WRITE, key, value)) {
+        return false;
+    }
+    ApplyOp(LOG_OP_WRITE, key, value, RecordSize(key.size(), value.size()));
+    return true;
+}
+
+bool CWalletRecordLog::Erase(const LogKey& key)
+{
+    LOCK(cs_log);
+    if (file == NULL)
+        return false;
+    if (!mapRecords.count(key))
+        return true; // matches the DB_NOTFOUND-is-success convention
+    if (fTxnActive) {
+        LogOp op;
+        op.nOp = LOG_OP_ERASE;
+        op.key = key;
+        vTxnOps.push_back(op);
+    } else if (!AppendOp(LOG_OP_ERASE, key, LogValue())) {
+        return false;
+    }
+    ApplyOp(LOG_OP_ERASE, key, LogValue(), RecordSize(key.size(), 0));
+    return true;
+}
+
+CWalletRecordLog::Cursor* CWalletRecordLog::NewCursor() const
+{
+    LOCK(cs_log);
+    Cursor* pcursor = new Cursor();
+    pcursor->vKeys.reserve(mapRecords.size());
+    for (map<LogKey, LogRecord>::const_iterator it = mapRecords.begin(); it != mapRecords.end(); ++it)
+        pcursor->vKeys.push_back(it->first);
+    return pcursor;
+}
+
+void CWalletRecordLog::CursorSeek(Cursor* pcursor, const LogKey& seek) const
+{
+    pcursor->nPos = std::lower_bound(pcursor->vKeys.begin(), pcursor->vKeys.end(), seek) - pcursor->vKeys.begin();
+}
+
+bool CWalletRecordLog::CursorNext(Cursor* pcursor, LogKey& key, LogValue& value) const
+{
+    LOCK(cs_log);
+    while (pcursor->nPos < pcursor->vKeys.size()) {
+        map<LogKey, LogRecord>::const_iterator it = mapRecords.find(pcursor->vKeys[pcursor->nPos]);
+        pcursor->nPos++;
+        if (it == mapRecords.end())
+            continue; // erased since the snapshot was taken
+        key = it->first;
+        value = it->second.value;
+        return true;
+    }
+    return false;
+}
+
+bool CWalletRecordLog::TxnBegin()
+{
+    LOCK(cs_log);
+    if (file == NULL || fTxnActive)
+        return false;
+    fTxnActive = true;
+    return true;
+}
+
+bool CWalletRecordLog::TxnCommit()
+{
+    LOCK(cs_log);
+    if (!fTxnActive)
+        return false;
+    bool fOk = true;
+    for (size_t i = 0; i < vTxnOps.size() && fOk; i++)
+        fOk = AppendOp(vTxnOps[i].nOp, vTxnOps[i].key, vTxnOps[i].value);
+    vTxnOps.clear();
+    fTxnActive = false;
+    if (!fOk) {
+        // The map may now be ahead of the file; fall back to the file
+        string strError;
+        LoadFile(strError);
+    }
+    return fOk;
+}
+
+bool CWalletRecordLog::TxnAbort()
+{
+    LOCK(cs_log);
+    if (!fTxnActive)
+        return false;
+    vTxnOps.clear();
+    fTxnActive = false;
+    // Buffered ops were already applied to the map so reads inside the
+    // transaction saw them; aborting means reverting to the on-disk state.
+    string strError;
+    return LoadFile(strError);
+}
+
+void CWalletRecordLog::Flush()
+{
+    LOCK(cs_log);
+    if (file == NULL || fTxnActive)
+        return;
+    fflush(file);
+    FileCommit(file);
+}
+
+bool CWalletRecordLog::CompactLocked()
+{
+    AssertLockHeld(cs_log);
+    if (file == NULL || fTxnActive)
+        return false;
+
+    const string strPath = GetPath();
+    const string strPathNew = strPath + ".compact";
+    FILE* fNew = fopen(strPathNew.c_str(), "wb");
+    if (!fNew)
+        return false;
+
+    bool fOk = fwrite(LOG_MAGIC, 1, sizeof(LOG_MAGIC), fNew) == sizeof(LOG_MAGIC);
+    size_t nNewBytes = sizeof(LOG_MAGIC);
+    FILE* fOld = file;
+    file = fNew; // AppendOp writes to the handle in 'file'
+    size_t nOldFileBytes = nFileBytes;
+    nFileBytes = nNewBytes;
+    for (map<LogKey, LogRecord>::iterator it = mapRecords.begin(); it != mapRecords.end() && fOk; ++it) {
+        fOk = AppendOp(LOG_OP_WRITE, it->first, it->second.value);
+        it->second.nDiskSize = RecordSize(it->first.size(), it->second.value.size());
+    }
+    if (fOk) {
+        FileCommit(fNew);
+        fclose(fNew);
+        fclose(fOld);
+        fOk = RenameOver(boost::filesystem::path(strPathNew), boost::filesystem::path(strPath));
+        file = fopen(strPath.c_str(), "ab");
+        if (fOk && file != NULL) {
+            nObsoleteBytes = 0;
+            LogPrint("db", "CWalletRecordLog : compacted %s, %u -> %u bytes\n",
+                strFile, (unsigned int)nOldFileBytes, (unsigned int)nFileBytes);
+            return true;
+        }
+    } else {
+        file = fOld;
+        nFileBytes = nOldFileBytes;
+        fclose(fNew);
+        boost::filesystem::remove(strPathNew);
+        return false;
+    }
+    // Rename or reopen failed: reload whatever is on disk
+    string strError;
+    if (file == NULL)
+        file = fopen(strPath.c_str(), "ab");
+    LoadFile(strError);
+    return false;
+}
+
+bool CWalletRecordLog::Compact()
+{
+    LOCK(cs_log);
+    return CompactLocked();
+}
+
+bool CWalletRecordLog::AppendMarkerLocked()
+{
+    AssertLockHeld(cs_log);
+    LogValue vchId(LOG_MARKER_ID_BYTES);
+    GetRandBytes(&vchId[0], vchId.size());
+    if (!AppendOp(LOG_OP_MARK, LogKey(), vchId))
+        return false;
+    nObsoleteBytes += RecordSize(0, vchId.size());
+    FileCommit(file);
+    return true;
+}
+
+bool CWalletRecordLog::IncrementalBackupLocked(const string& strDestPath)
+{
+    AssertLockHeld(cs_log);
+    const size_t nMarkSize = RecordSize(0, LOG_MARKER_ID_BYTES);
+
+    // The destination must end with a marker record whose bytes appear at
+    // the same offset in our file; the marker id is random, so a match
+    // proves the destination is a prefix of this log (compaction would have
+    // rewritten the file and moved or dropped the marker).
+    FILE* fDst = fopen(strDestPath.c_str(), "rb");
+    if (!fDst)
+        return false;
+    fseek(fDst, 0, SEEK_END);
+    const long nDestSize = ftell(fDst);
+    vector<unsigned char> vchDestTail(nMarkSize);
+    bool fOk = nDestSize >= (long)(sizeof(LOG_MAGIC) + nMarkSize) && (size_t)nDestSize <= nFileBytes &&
+               fseek(fDst, nDestSize - nMarkSize, SEEK_SET) == 0 &&
+               fread(&vchDestTail[0], 1, nMarkSize, fDst) == nMarkSize;
+    fclose(fDst);
+    if (!fOk)
+        return false;
+    if (vchDestTail[0] != LOG_OP_MARK ||
+        ReadLE32Buf(&vchDestTail[1]) != 0 ||
+        ReadLE32Buf(&vchDestTail[5]) != LOG_MARKER_ID_BYTES ||
+        ReadLE32Buf(&vchDestTail[nMarkSize - 4]) != LogChecksum(&vchDestTail[0], nMarkSize - 4))
+        return false;
+
+    FILE* fSrc = fopen(GetPath().c_str(), "rb");
+    if (!fSrc)
+        return false;
+    vector<unsigned char> vchSrcTail(nMarkSize);
+    fOk = fseek(fSrc, nDestSize - nMarkSize, SEEK_SET) == 0 &&
+          fread(&vchSrcTail[0], 1, nMarkSize, fSrc) == nMarkSize &&
+          memcmp(&vchSrcTail[0], &vchDestTail[0], nMarkSize) == 0;
+    if (!fOk) {
+        fclose(fSrc);
+        return false;
+    }
+
+    // Place a fresh marker so the next incremental run has a new checkpoint,
+    // then append everything past the destination's end (marker included).
+    if (!AppendMarkerLocked()) {
+        fclose(fSrc);
+        return false;
+    }
+    fDst = fopen(strDestPath.c_str(), "ab");
+    if (!fDst) {
+        fclose(fSrc);
+        return false;
+    }
+    size_t nRemain = nFileBytes - nDestSize;
+    const size_t nAppended = nRemain;
+    vector<unsigned char> vchBuf(65536);
+    fOk = fseek(fSrc, nDestSize, SEEK_SET) == 0;
+    while (fOk && nRemain > 0) {
+        size_t nChunk = std::min(nRemain, vchBuf.size());
+        fOk = fread(&vchBuf[0], 1, nChunk, fSrc) == nChunk &&
+              fwrite(&vchBuf[0], 1, nChunk, fDst) == nChunk;
+        nRemain -= nChunk;
+    }
+    memset(&vchBuf[0], 0, vchBuf.size());
+    fclose(fSrc);
+    if (fOk)
+        FileCommit(fDst);
+    fclose(fDst);
+    if (fOk)
+        LogPrint("db", "CWalletRecordLog : incremental backup of %s to %s, %u of %u bytes copied\n",
+            strFile, strDestPath, (unsigned int)nAppended, (unsigned int)nFileBytes);
+    return fOk;
+}
+
+bool CWalletRecordLog::BackupTo(const string& strDestPath, bool fIncremental)
+{
+    LOCK(cs_log);
+    if (file == NULL || fTxnActive)
+        return false;
+    fflush(file);
+    FileCommit(file);
+
+    if (fIncremental && IncrementalBackupLocked(strDestPath))
+        return true;
+
+    // Full copy. The marker goes in first so a later incremental run can
+    // verify the destination against this file.
+    if (!AppendMarkerLocked())
+        return false;
+    FILE* fSrc = fopen(GetPath().c_str(), "rb");
+    if (!fSrc)
+        return false;
+    FILE* fDst = fopen(strDestPath.c_str(), "wb");
+    if (!fDst) {
+        fclose(fSrc);
+        return false;
+    }
+    size_t nRemain = nFileBytes;
+    vector<unsigned char> vchBuf(65536);
+    bool fOk = true;
+    while (fOk && nRemain > 0) {
+        size_t nChunk = std::min(nRemain, vchBuf.size());
+        fOk = fread(&vchBuf[0], 1, nChunk, fSrc) == nChunk &&
+              fwrite(&vchBuf[0], 1, nChunk, fDst) == nChunk;
+        nRemain -= nChunk;
+    }
+    memset(&vchBuf[0], 0, vchBuf.size());
+    fclose(fSrc);
+    if (fOk)
+        FileCommit(fDst);
+    fclose(fDst);
+    return fOk;
+}
+
+void CWalletRecordLog::Release()
+{
+    LOCK(cs_log);
+    nUseCount--;
+    if (nUseCount == 0 && file != NULL &&
+        nFileBytes > LOG_COMPACT_MIN_BYTES && nObsoleteBytes * 2 > nFileBytes)
+        CompactLocked();
+}
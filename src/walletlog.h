@@ -0,0 +1,115 @@
+// Copyright (c) 2015-2018 The LUX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_WALLETLOG_H
+#define BITCOIN_WALLETLOG_H
+
+#include "sync.h"
+
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only record log backend for CDB, selectable per wallet file.
+ *
+ * The whole key/value set lives in memory (the wallet loads it all anyway);
+ * every Write/Erase appends one checksummed record to the log file, and the
+ * file is replayed with a single sequential mmap pass on open — no
+ * environment locks and no page cache double-buffering against the OS.
+ * Records carry the same serialized bytes CWalletDB would hand to Berkeley
+ * DB, so record semantics (including iteration in key order) are preserved.
+ *
+ * Superseded bytes accumulate in the file until Compact() rewrites it from
+ * the live map; compaction runs automatically when the last user releases a
+ * log that is mostly dead weight.
+ */
+class CWalletRecordLog
+{
+public:
+    typedef std::vector<unsigned char> LogKey;
+    typedef std::vector<unsigned char> LogValue;
+
+    //! Iteration snapshot; keys are visited in lexicographic (BDB btree) order.
+    struct Cursor {
+        std::vector<LogKey> vKeys;
+        size_t nPos;
+        Cursor() : nPos(0) {}
+    };
+
+private:
+    struct LogRecord {
+        LogValue value;
+        //! On-disk size of the record that last wrote this key, so the
+        //! obsolete-byte count stays exact when it is overwritten.
+        size_t nDiskSize;
+        LogRecord() : nDiskSize(0) {}
+    };
+
+    struct LogOp {
+        unsigned char nOp;
+        LogKey key;
+        LogValue value;
+    };
+
+    mutable CCriticalSection cs_log;
+    std::string strFile;  //!< file name relative to the data directory
+    FILE* file;
+    std::map<LogKey, LogRecord> mapRecords;
+    size_t nFileBytes;
+    size_t nObsoleteBytes;
+    int nUseCount;
+    bool fTxnActive;
+    std::vector<LogOp> vTxnOps;
+
+    explicit CWalletRecordLog(const std::string& strFileIn);
+    std::string GetPath() const;
+    bool LoadFile(std::string& strError);
+    bool AppendOp(unsigned char nOp, const LogKey& key, const LogValue& value);
+    void ApplyOp(unsigned char nOp, const LogKey& key, const LogValue& value, size_t nDiskSize);
+    bool CompactLocked();
+    bool AppendMarkerLocked();
+    bool IncrementalBackupLocked(const std::string& strDestPath);
+
+public:
+    //! True if the file starts with the record-log magic.
+    static bool IsLogFile(const std::string& strPath);
+    //! Shared per-file instance; call Release() when done with it.
+    static CWalletRecordLog* Get(const std::string& strFile);
+
+    bool Open(bool fCreate, std::string& strError);
+    bool IsOpen() const { return file != NULL; }
+    void Release();
+
+    bool Read(const LogKey& key, LogValue& value) const;
+    bool Write(const LogKey& key, const LogValue& value, bool fOverwrite);
+    bool Erase(const LogKey& key);
+    bool Exists(const LogKey& key) const;
+
+    Cursor* NewCursor() const;
+    //! Position the cursor at the first key >= seek (DB_SET_RANGE semantics).
+    void CursorSeek(Cursor* pcursor, const LogKey& seek) const;
+    //! Copy out the record at the cursor and advance; false when exhausted.
+    bool CursorNext(Cursor* pcursor, LogKey& key, LogValue& value) const;
+
+    bool TxnBegin();
+    bool TxnCommit();
+    bool TxnAbort();
+
+    void Flush();
+    //! Rewrite the file from the live map, dropping superseded records.
+    bool Compact();
+
+    /**
+     * Copy the log to strDestPath. Every backup ends with a marker record
+     * carrying a random id; when fIncremental is set and the destination is
+     * a marker-terminated prefix of this file (verified by matching the
+     * marker bytes at the same offset), only the tail appended since that
+     * backup is copied. Falls back to a full copy otherwise, so the
+     * destination is always a complete, directly loadable wallet file.
+     */
+    bool BackupTo(const std::string& strDestPath, bool fIncremental);
+};
+
+#endif // BITCOIN_WALLETLOG_H
@@ -8,14 +8,22 @@
 #include "version.h"
 #include "main.h"
 #include "streams.h"
+#include "trace.h"
 #include "util.h"
 
+#include <boost/bind.hpp>
+
+//! Cap on queued notifications; a wedged publish thread (e.g. a stuck
+//! subscriber during a long reorg) drops the oldest events rather than
+//! stalling validation. Subscribers detect the gap via the sequence number.
+static const size_t MAX_ZMQ_QUEUE_DEPTH = 10000;
+
 void zmqError(const char *str)
 {
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL), pthreadPublish(NULL), fStopPublish(false)
 {
 }
 
@@ -105,6 +113,9 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    fStopPublish = false;
+    pthreadPublish = new boost::thread(boost::bind(&CZMQNotificationInterface::ThreadPublish, this));
+
     return true;
 }
 
@@ -112,6 +123,21 @@ bool CZMQNotificationInterface::Initialize()
 void CZMQNotificationInterface::Shutdown()
 {
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
+
+    // Stop the publish thread before tearing the sockets down; it drains
+    // whatever is still queued so subscribers see the final blocks.
+    if (pthreadPublish)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(csPublishQueue);
+            fStopPublish = true;
+        }
+        condPublishQueue.notify_one();
+        pthreadPublish->join();
+        delete pthreadPublish;
+        pthreadPublish = NULL;
+    }
+
     if (pcontext)
     {
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
@@ -126,7 +152,60 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+void CZMQNotificationInterface::EnqueueEvent(const CZMQEvent& event)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csPublishQueue);
+        if (queuePublish.size() >= MAX_ZMQ_QUEUE_DEPTH)
+        {
+            LogPrint("zmq", "zmq: Publish queue full, dropping oldest event\n");
+            queuePublish.pop_front();
+        }
+        queuePublish.push_back(event);
+    }
+    condPublishQueue.notify_one();
+}
+
+// Publish thread: drains the event queue and performs the serialization,
+// disk reads and socket sends that used to run on the validation thread.
+// All notifiers are driven from this one thread, so the per-notifier
+// sequence numbers stay strictly ordered.
+void CZMQNotificationInterface::ThreadPublish()
+{
+    RenameThread("lux-zmqpub");
+
+    std::deque<CZMQEvent> events;
+    while (true)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(csPublishQueue);
+            while (queuePublish.empty() && !fStopPublish)
+                condPublishQueue.wait(lock);
+            if (queuePublish.empty() && fStopPublish)
+                break;
+            events.swap(queuePublish);
+        }
+
+        for (std::deque<CZMQEvent>::const_iterator it = events.begin(); it != events.end(); ++it)
+        {
+            switch (it->type)
+            {
+            case CZMQEvent::EVENT_BLOCK:
+                DispatchBlock(it->pindex);
+                break;
+            case CZMQEvent::EVENT_TRANSACTION:
+                DispatchTransaction(it->tx);
+                break;
+            case CZMQEvent::EVENT_TRANSACTIONLOCK:
+                DispatchTransactionLock(it->tx);
+                break;
+            }
+        }
+        events.clear();
+    }
+}
+
+void CZMQNotificationInterface::DispatchBlock(const CBlockIndex *pindex)
 {
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
@@ -143,8 +222,9 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
     }
 }
 
-void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+void CZMQNotificationInterface::DispatchTransaction(const CTransaction &tx)
 {
+    CTxTraceScope tracescope("zmq.publish", tx.GetHash());
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
@@ -160,7 +240,7 @@ void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CB
     }
 }
 
-void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
+void CZMQNotificationInterface::DispatchTransactionLock(const CTransaction &tx)
 {
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
@@ -176,3 +256,27 @@ void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
         }
     }
 }
+
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    CZMQEvent event;
+    event.type = CZMQEvent::EVENT_BLOCK;
+    event.pindex = pindex;
+    EnqueueEvent(event);
+}
+
+void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+{
+    CZMQEvent event;
+    event.type = CZMQEvent::EVENT_TRANSACTION;
+    event.tx = tx;
+    EnqueueEvent(event);
+}
+
+void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
+{
+    CZMQEvent event;
+    event.type = CZMQEvent::EVENT_TRANSACTIONLOCK;
+    event.tx = tx;
+    EnqueueEvent(event);
+}
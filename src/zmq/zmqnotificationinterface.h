@@ -5,10 +5,15 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include "primitives/transaction.h"
+#include "sync.h"
 #include "validationinterface.h"
+#include <deque>
 #include <string>
 #include <map>
 
+#include <boost/thread.hpp>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
@@ -31,8 +36,40 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    //! A queued notification, handed from the validation thread to the
+    //! publish thread. Block events carry the index pointer only (block
+    //! index entries live until shutdown); the disk read for rawblock
+    //! happens on the publish thread.
+    struct CZMQEvent
+    {
+        enum EventType
+        {
+            EVENT_BLOCK,
+            EVENT_TRANSACTION,
+            EVENT_TRANSACTIONLOCK,
+        };
+
+        EventType type;
+        const CBlockIndex* pindex;
+        CTransaction tx;
+
+        CZMQEvent() : type(EVENT_BLOCK), pindex(NULL) {}
+    };
+
+    void EnqueueEvent(const CZMQEvent& event);
+    void ThreadPublish();
+    void DispatchBlock(const CBlockIndex* pindex);
+    void DispatchTransaction(const CTransaction& tx);
+    void DispatchTransactionLock(const CTransaction& tx);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    boost::thread* pthreadPublish;
+    CWaitableCriticalSection csPublishQueue;
+    CConditionVariable condPublishQueue;
+    std::deque<CZMQEvent> queuePublish;
+    bool fStopPublish;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H